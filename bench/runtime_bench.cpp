@@ -0,0 +1,198 @@
+// Microbenchmarks of the runtime string and Vec against std::string and
+// std::vector. Vec pushes use the same inline fast path compiled code emits:
+// store while length < capacity, call pallas_vec_grow otherwise.
+//
+//   pallas_runtime_bench [iterations]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "runtime/arena.h"
+#include "runtime/str.h"
+#include "runtime/vec.h"
+
+namespace {
+
+// Keeps results alive without a volatile store in every loop.
+std::uint64_t sink = 0;
+
+template <typename F>
+double best_ns_per_op(std::uint64_t ops, F&& run) {
+    double best = 1e300;
+    for (int round = 0; round < 5; ++round) {
+        auto start = std::chrono::steady_clock::now();
+        run();
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count() / static_cast<double>(ops));
+    }
+    return best;
+}
+
+void report(const char* name, double pallas, double standard) {
+    std::printf("%-34s %9.2f ns %9.2f ns %7.2fx\n", name, pallas, standard, standard / pallas);
+}
+
+inline void push(PallasVec* vec, std::uint64_t value, PallasArena* arena) {
+    if (vec->length == vec->capacity) {
+        pallas_vec_grow(vec, sizeof(value), arena);
+    }
+    std::memcpy(vec->data + vec->length++ * sizeof(value), &value, sizeof(value));
+}
+
+void bench_vec(std::uint64_t n) {
+    double pallas = best_ns_per_op(n, [&] {
+        PallasVec vec{};
+        for (std::uint64_t i = 0; i < n; ++i) {
+            push(&vec, i, nullptr);
+        }
+        sink += vec.length;
+        pallas_vec_free(&vec);
+    });
+    double standard = best_ns_per_op(n, [&] {
+        std::vector<std::uint64_t> vec;
+        for (std::uint64_t i = 0; i < n; ++i) {
+            vec.push_back(i);
+        }
+        sink += vec.size();
+    });
+    report("Vec push", pallas, standard);
+
+    pallas = best_ns_per_op(n, [&] {
+        PallasVec vec{};
+        pallas_vec_reserve(&vec, sizeof(std::uint64_t), n, nullptr);
+        for (std::uint64_t i = 0; i < n; ++i) {
+            push(&vec, i, nullptr);
+        }
+        sink += vec.length;
+        pallas_vec_free(&vec);
+    });
+    standard = best_ns_per_op(n, [&] {
+        std::vector<std::uint64_t> vec;
+        vec.reserve(n);
+        for (std::uint64_t i = 0; i < n; ++i) {
+            vec.push_back(i);
+        }
+        sink += vec.size();
+    });
+    report("Vec push after reserve", pallas, standard);
+
+    // Many short Vecs: where inline storage and arenas pay off.
+    constexpr std::uint64_t kShort = 8;
+    std::uint64_t vecs = std::max<std::uint64_t>(n / kShort, 1);
+    pallas = best_ns_per_op(vecs * kShort, [&] {
+        alignas(16) std::byte storage[pallas::runtime::kVecInlineHeader + kShort * 8];
+        for (std::uint64_t v = 0; v < vecs; ++v) {
+            PallasVec vec{};
+            pallas_vec_init_inline(&vec, storage, kShort, sizeof(std::uint64_t));
+            for (std::uint64_t i = 0; i < kShort; ++i) {
+                push(&vec, i ^ v, nullptr);
+            }
+            sink += vec.length;
+            pallas_vec_free(&vec);
+        }
+    });
+    standard = best_ns_per_op(vecs * kShort, [&] {
+        for (std::uint64_t v = 0; v < vecs; ++v) {
+            std::vector<std::uint64_t> vec;
+            for (std::uint64_t i = 0; i < kShort; ++i) {
+                vec.push_back(i ^ v);
+            }
+            sink += vec.size();
+        }
+    });
+    report("8-element Vecs, inline storage", pallas, standard);
+
+    pallas = best_ns_per_op(vecs * kShort, [&] {
+        PallasArena arena;
+        pallas_arena_init(&arena, pallas::runtime::kArenaDefaultCapacity);
+        for (std::uint64_t v = 0; v < vecs; ++v) {
+            PallasVec vec{};
+            for (std::uint64_t i = 0; i < kShort; ++i) {
+                push(&vec, i ^ v, &arena);
+            }
+            sink += vec.length;
+            if (v % 64 == 63) {
+                pallas_arena_free_all(&arena);
+            }
+        }
+        pallas_arena_release(&arena);
+    });
+    report("8-element Vecs, arena", pallas, standard);
+}
+
+void bench_string(std::uint64_t n) {
+    const char* words[] = {"id", "pallas", "short string", "twenty-two bytes long!"};
+    double pallas = best_ns_per_op(n, [&] {
+        for (std::uint64_t i = 0; i < n; ++i) {
+            PallasString s{};
+            const char* word = words[i % 4];
+            pallas_string_assign(&s, word, std::strlen(word), nullptr);
+            sink += pallas::runtime::string_length(&s);
+            pallas_string_free(&s);
+        }
+    });
+    double standard = best_ns_per_op(n, [&] {
+        for (std::uint64_t i = 0; i < n; ++i) {
+            std::string s(words[i % 4]);
+            sink += s.size();
+        }
+    });
+    report("short string (<= 22 bytes)", pallas, standard);
+
+    const char* piece = "0123456789";
+    pallas = best_ns_per_op(n, [&] {
+        PallasString s{};
+        for (std::uint64_t i = 0; i < n; ++i) {
+            pallas_string_append(&s, piece, 10, nullptr);
+        }
+        sink += pallas::runtime::string_length(&s);
+        pallas_string_free(&s);
+    });
+    standard = best_ns_per_op(n, [&] {
+        std::string s;
+        for (std::uint64_t i = 0; i < n; ++i) {
+            s.append(piece, 10);
+        }
+        sink += s.size();
+    });
+    report("append 10 bytes", pallas, standard);
+
+    PallasString text{};
+    std::string standard_text;
+    for (int i = 0; i < 100; ++i) {
+        pallas_string_append(&text, piece, 10, nullptr);
+        standard_text.append(piece, 10);
+    }
+    pallas = best_ns_per_op(n, [&] {
+        PallasString slice{};
+        for (std::uint64_t i = 0; i < n; ++i) {
+            std::uint64_t begin = i % 900;
+            pallas_string_slice(&slice, &text, begin, begin + 16, nullptr);
+            sink += pallas::runtime::string_length(&slice);
+        }
+        pallas_string_free(&slice);
+    });
+    standard = best_ns_per_op(n, [&] {
+        for (std::uint64_t i = 0; i < n; ++i) {
+            std::string slice = standard_text.substr(i % 900, 16);
+            sink += slice.size();
+        }
+    });
+    report("16-byte slice of a 1000-byte string", pallas, standard);
+    pallas_string_free(&text);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    std::uint64_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    std::printf("%-34s %12s %12s %8s\n", "", "pallas", "std", "speedup");
+    bench_vec(n);
+    bench_string(n);
+    return sink == 0 ? 1 : 0;
+}
@@ -0,0 +1,413 @@
+// Compile-time scaling of each compiler stage. Generates programs that grow
+// along one axis at a time, compiles each size in process with tracing on,
+// and fits the exponent k of time ~ size^k per stage on a log-log scale.
+// Exponents are independent of the machine, so they can be checked against
+// recorded baselines. Programs that import other files are written to a
+// temporary directory and compiled like palc does: each file on its own, then
+// linked.
+//
+//   pallas_scaling_bench [--check baseline] [--record baseline] [--axis name]
+//
+// --check fails (exit 1) when a stage grows faster than kMaxExponent or more
+// than kBaselineSlack above its recorded exponent.
+
+#include <unistd.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "frontend/const_eval.h"
+#include "frontend/diagnostics.h"
+#include "frontend/parser.h"
+#include "frontend/scanner.h"
+#include "middle/layout.h"
+#include "middle/link.h"
+#include "middle/lower.h"
+#include "middle/passes.h"
+#include "backend/x86_64.h"
+#include "support/trace.h"
+
+using namespace pallas;
+
+namespace {
+
+constexpr double kMaxExponent = 1.3;
+constexpr double kBaselineSlack = 0.2;
+// Stages faster than this at the largest size are timer noise, not checked.
+constexpr double kMinCheckedMs = 2.0;
+constexpr int kRepeats = 5;
+constexpr int kDoublings = 4;  // sizes base, 2 base, 4 base, 8 base
+
+const char* const kStages[] = {"scan",  "parse",    "resolve", "const-eval",  "layout",
+                               "lower", "optimize", "link",    "x86-codegen"};
+
+struct Axis {
+    const char* name;
+    std::size_t base;
+    bool frontend_only;  // the program does not lower (generics)
+    std::function<std::string(std::size_t)> generate;
+    // For programs that import others: file i of those, imported as "module<i>".
+    std::function<std::string(std::size_t)> module = nullptr;
+};
+
+std::string number(std::size_t n) {
+    return std::to_string(n);
+}
+
+const std::vector<Axis>& axes() {
+    static const std::vector<Axis> all = {
+        {"functions", 400, false,
+         [](std::size_t n) {
+             std::string out;
+             for (std::size_t i = 0; i < n; ++i) {
+                 out += "fn" + number(i) + "(x: i32): i32 {\n    y: i32 = x * " +
+                        number(i % 7 + 1) + ";\n    if (y > 10) { y -= 3; }\n    return y + " +
+                        number(i) + ";\n}\n";
+             }
+             out += "main(): i32 { return fn0(1) + fn" + number(n - 1) + "(2); }\n";
+             return out;
+         }},
+        {"body-length", 400, false,
+         [](std::size_t n) {
+             std::string out = "main(): i32 {\n    t: i32 = 1;\n";
+             for (std::size_t i = 0; i < n; ++i) {
+                 out += "    t = (t ^ " + number(i) + ") * 3 + 1;\n";
+                 if (i % 8 == 0) {
+                     out += "    if (t > 1000) { t = t - 999; }\n";
+                 }
+             }
+             return out + "    return t;\n}\n";
+         }},
+        // Deep enough for each stage to take milliseconds. The largest depth,
+        // 3200, still compiles at twice that on an 8 MB stack.
+        {"nesting-depth", 400, false,
+         [](std::size_t n) {
+             std::string out = "main(): i32 {\n    a: i32 = 2;\n    x: i32 = ";
+             for (std::size_t i = 0; i < n; ++i) {
+                 out += "(" + number(i % 10) + (i % 2 == 0 ? " + " : " * ");
+             }
+             out += "a";
+             out.append(n, ')');
+             return out + ";\n    return x;\n}\n";
+         }},
+        {"identifier-length", 512, false,
+         [](std::size_t n) {
+             std::string out = "main(): i32 {\n    t: i32 = 0;\n";
+             for (std::size_t i = 0; i < 64; ++i) {
+                 std::string name = "v" + number(i) + std::string(n, 'x');
+                 out += "    " + name + ": i32 = " + number(i) + ";\n";
+                 out += "    t = t + " + name + " * " + name + ";\n";
+             }
+             return out + "    return t;\n}\n";
+         }},
+        {"generic-instantiations", 200, true,
+         [](std::size_t n) {
+             std::string out = "struct Box<T> { item: T; count: i32; }\n";
+             for (std::size_t i = 0; i < n; ++i) {
+                 out += "struct S" + number(i) + " { a: i32; b: i" + number(8 << (i % 4)) +
+                        "; }\n";
+                 out += "struct U" + number(i) + " { box: Box<S" + number(i) + ">; }\n";
+             }
+             return out;
+         }},
+        {"imports", 100, false,
+         [](std::size_t n) {
+             std::string out;
+             for (std::size_t i = 0; i < n; ++i) {
+                 out += "import \"module" + number(i) + "\";\n";
+             }
+             out += "main(): i32 {\n    t: i32 = 0;\n";
+             for (std::size_t i = 0; i < n; ++i) {
+                 out += "    t = t + fn" + number(i) + "(t);\n";
+             }
+             return out + "    return t;\n}\n";
+         },
+         [](std::size_t i) {
+             return "struct P" + number(i) + " { a: i32; b: i32; }\n"
+                    "fn" + number(i) + "(x: i32): i32 {\n    p: P" + number(i) + ";\n"
+                    "    p.a = x * " + number(i % 7 + 1) + ";\n    p.b = " + number(i) +
+                    ";\n    return p.a + p.b;\n}\n";
+         }},
+        {"match-arms", 100, false,
+         [](std::size_t n) {
+             std::string out = "@noinline\npick(x: i32): i32 {\n    t: i32 = 0;\n"
+                               "    match (x) {\n";
+             for (std::size_t i = 0; i < n; ++i) {
+                 out += "        " + number(i * 3) + " => { t = " + number(i) + "; }\n";
+             }
+             return out + "    }\n    return t;\n}\nmain(): i32 { return pick(9); }\n";
+         }},
+    };
+    return all;
+}
+
+// Constant evaluation, layout and lowering of one parsed file. Null after
+// errors or for front-end-only programs.
+std::unique_ptr<middle::Module> lower_file(frontend::ModuleAST& ast, bool frontend_only,
+                                           middle::LowerOptions options,
+                                           frontend::Diagnostics& diagnostics) {
+    frontend::ConstEvaluator consts(ast, &diagnostics);
+    consts.evaluate_all();
+    consts.resolve_array_sizes(ast);
+    middle::LayoutEngine layout(ast, &diagnostics);
+    layout.compute_all();
+    if (frontend_only || !diagnostics.all().empty()) {
+        return nullptr;
+    }
+    auto module = middle::lower_module(ast, consts, layout, &diagnostics, std::move(options));
+    return diagnostics.all().empty() ? std::move(module) : nullptr;
+}
+
+bool optimize(middle::Module& module, bool scalarize) {
+    middle::PassManager passes;
+    middle::build_pipeline(passes, 2);
+    if (scalarize) {
+        middle::add_pass_by_name(passes, "scalarize");
+    }
+    return passes.run(module);
+}
+
+// The program `source` imports, as separately optimized modules with their
+// summaries. Their declarations go into `ast` and `options`.
+bool compile_imports(frontend::ModuleAST& ast, const std::filesystem::path& directory,
+                     std::vector<std::string>& sources, middle::LowerOptions& options,
+                     std::vector<middle::LinkUnit>& units, frontend::Diagnostics& diagnostics) {
+    std::vector<std::string> paths;
+    for (const auto& decl : ast.decls) {
+        if (decl->kind == frontend::NodeType::NODE_IMPORT) {
+            paths.push_back(static_cast<const frontend::ImportAST&>(*decl).path + ".pal");
+        }
+    }
+    sources.reserve(paths.size());
+    {
+        support::TraceScope trace("resolve");
+        for (const std::string& path : paths) {
+            std::ifstream file(directory / path);
+            if (!file) {
+                std::fprintf(stderr, "cannot open import '%s'\n", path.c_str());
+                return false;
+            }
+            std::stringstream buffer;
+            buffer << file.rdbuf();
+            sources.push_back(buffer.str());
+            frontend::Scanner scanner(sources.back(), &diagnostics);
+            frontend::Parser parser(scanner.get_tokens(), &diagnostics);
+            auto imported = parser.parse_module();
+            frontend::import_declarations(ast, *imported, options.imported);
+        }
+    }
+    for (std::size_t i = 0; i < paths.size() && diagnostics.all().empty(); ++i) {
+        frontend::Scanner scanner(sources[i], &diagnostics);
+        frontend::Parser parser(scanner.get_tokens(), &diagnostics);
+        auto file = parser.parse_module();
+        auto module = lower_file(*file, false, {}, diagnostics);
+        if (module == nullptr || !optimize(*module, false)) {
+            return false;
+        }
+        middle::ModuleSummary summary = middle::summarize_module(*module, paths[i]);
+        units.push_back({std::move(module), std::move(summary)});
+    }
+    return diagnostics.all().empty();
+}
+
+// Compiles `source` once with tracing on and adds each stage's time to
+// `ms`. Its imports are read from `directory`. Returns false, with the
+// diagnostics printed, if it does not compile.
+bool compile(const std::string& source, bool frontend_only,
+             const std::filesystem::path& directory, std::map<std::string, double>& ms) {
+    support::start_tracing();
+    frontend::Diagnostics diagnostics;
+    bool ok = true;
+    {
+        frontend::Scanner scanner(source, &diagnostics);
+        frontend::Parser parser(scanner.get_tokens(), &diagnostics);
+        auto ast = parser.parse_module();
+        std::vector<std::string> sources;  // of the imported files, which the trees use
+        std::vector<middle::LinkUnit> units;
+        middle::LowerOptions options;
+        ok = compile_imports(*ast, directory, sources, options, units, diagnostics);
+        auto module = ok ? lower_file(*ast, frontend_only, std::move(options), diagnostics)
+                         : nullptr;
+        std::string error;
+        if (module != nullptr && units.empty()) {
+            ok = optimize(*module, true);
+        } else if (module != nullptr && optimize(*module, false)) {
+            middle::ModuleSummary summary = middle::summarize_module(*module, "main");
+            units.push_back({std::move(module), std::move(summary)});
+            module = middle::link_modules(std::move(units), {}, &error);
+            middle::PassManager passes;
+            middle::add_pass_by_name(passes, "scalarize");
+            ok = module != nullptr && passes.run(*module);
+        } else if (module != nullptr) {
+            ok = false;
+        }
+        ok = ok && (module == nullptr ||
+                    !backend::emit_x86_object(*module, &error).empty());
+        if (!error.empty()) {
+            std::fprintf(stderr, "%s\n", error.c_str());
+        }
+    }
+    support::stop_tracing();
+    if (!ok || !diagnostics.all().empty()) {
+        diagnostics.print();
+        return false;
+    }
+    for (const support::TraceEvent& e : support::trace_events()) {
+        ms[e.name] += static_cast<double>(e.duration_ns) / 1e6;
+    }
+    return true;
+}
+
+// Least-squares slope of log(ms) over log(size).
+double exponent(const std::vector<double>& sizes, const std::vector<double>& ms) {
+    double mx = 0.0;
+    double my = 0.0;
+    for (std::size_t i = 0; i < sizes.size(); ++i) {
+        mx += std::log(sizes[i]);
+        my += std::log(std::max(ms[i], 1e-6));
+    }
+    mx /= static_cast<double>(sizes.size());
+    my /= static_cast<double>(sizes.size());
+    double num = 0.0;
+    double den = 0.0;
+    for (std::size_t i = 0; i < sizes.size(); ++i) {
+        double dx = std::log(sizes[i]) - mx;
+        num += dx * (std::log(std::max(ms[i], 1e-6)) - my);
+        den += dx * dx;
+    }
+    return num / den;
+}
+
+std::map<std::string, double> read_baseline(const std::string& path) {
+    std::map<std::string, double> baseline;
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::istringstream fields(line);
+        std::string axis;
+        std::string stage;
+        double k = 0.0;
+        if (fields >> axis >> stage >> k) {
+            baseline[axis + " " + stage] = k;
+        }
+    }
+    return baseline;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    std::string check;
+    std::string record;
+    std::string only;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if ((arg == "--check" || arg == "--record" || arg == "--axis") && i + 1 < argc) {
+            (arg == "--check" ? check : arg == "--record" ? record : only) = argv[++i];
+        } else {
+            std::fprintf(stderr, "usage: pallas_scaling_bench [--check file] [--record file] "
+                                 "[--axis name]\n");
+            return 2;
+        }
+    }
+    std::map<std::string, double> baseline;
+    if (!check.empty()) {
+        baseline = read_baseline(check);
+        if (baseline.empty()) {
+            std::fprintf(stderr, "no baselines in '%s'\n", check.c_str());
+            return 2;
+        }
+    }
+
+    std::string recorded = "# axis stage exponent (pallas_scaling_bench --record)\n";
+    int failures = 0;
+    std::printf("%-24s %-12s %10s %10s %10s %10s %9s\n", "axis", "stage", "ms (1x)", "2x", "4x",
+                "8x", "exponent");
+    for (const Axis& axis : axes()) {
+        if (!only.empty() && only != axis.name) {
+            continue;
+        }
+        std::vector<double> sizes;
+        std::vector<std::string> sources;
+        for (int step = 0; step < kDoublings; ++step) {
+            sizes.push_back(static_cast<double>(axis.base << step));
+            sources.push_back(axis.generate(axis.base << step));
+        }
+        // The files the programs import; the smaller programs import a prefix.
+        std::filesystem::path directory = std::filesystem::temp_directory_path() /
+                                          ("pallas_scaling_bench_" + std::to_string(getpid()));
+        if (axis.module) {
+            std::filesystem::create_directories(directory);
+            for (std::size_t i = 0; i < axis.base << (kDoublings - 1); ++i) {
+                std::ofstream(directory / ("module" + number(i) + ".pal")) << axis.module(i);
+            }
+        }
+        // Best time per stage and size. Each round compiles every size once,
+        // so a slow spell of the machine does not land on a single size.
+        std::map<std::string, std::vector<double>> stage_ms;
+        for (int run = 0; run < kRepeats; ++run) {
+            for (int step = 0; step < kDoublings; ++step) {
+                std::map<std::string, double> ms;
+                if (!compile(sources[step], axis.frontend_only, directory, ms)) {
+                    std::fprintf(stderr, "%s: the program of size %zu does not compile\n",
+                                 axis.name, axis.base << step);
+                    std::filesystem::remove_all(directory);
+                    return 2;
+                }
+                for (const char* stage : kStages) {
+                    std::vector<double>& best = stage_ms[stage];
+                    best.resize(kDoublings, std::numeric_limits<double>::infinity());
+                    best[step] = std::min(best[step], ms[stage]);
+                }
+            }
+        }
+        std::filesystem::remove_all(directory);
+        for (const char* stage : kStages) {
+            const std::vector<double>& ms = stage_ms[stage];
+            if (ms.back() == 0.0) {
+                continue;  // not run for this axis
+            }
+            double k = exponent(sizes, ms);
+            bool checked = ms.back() >= kMinCheckedMs;
+            std::string key = std::string(axis.name) + " " + stage;
+            const char* verdict = "";
+            if (checked && !check.empty()) {
+                auto known = baseline.find(key);
+                if (k > kMaxExponent) {
+                    verdict = "  SUPERLINEAR";
+                } else if (known != baseline.end() && k > known->second + kBaselineSlack) {
+                    verdict = "  REGRESSED";
+                }
+                failures += *verdict != '\0';
+            }
+            std::printf("%-24s %-12s %10.3f %10.3f %10.3f %10.3f %9s%s\n", axis.name, stage,
+                        ms[0], ms[1], ms[2], ms[3],
+                        checked ? std::to_string(k).substr(0, 4).c_str() : "-", verdict);
+            if (checked) {
+                char line[128];
+                std::snprintf(line, sizeof(line), "%s %s %.2f\n", axis.name, stage, k);
+                recorded += line;
+            }
+        }
+    }
+    if (!record.empty()) {
+        std::ofstream(record) << recorded;
+    }
+    if (failures > 0) {
+        std::printf("%d stage%s scale%s worse than allowed\n", failures, failures > 1 ? "s" : "",
+                    failures > 1 ? "" : "s");
+        return 1;
+    }
+    return 0;
+}
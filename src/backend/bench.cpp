@@ -0,0 +1,392 @@
+#include "bench.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <unordered_map>
+#include "codegen.h"
+#include "runtime/alloc.h"
+#include "support/trace.h"
+
+namespace pallas::backend {
+
+namespace {
+
+constexpr std::uint64_t kMaxIterations = 1'000'000'000'000;
+
+// Seconds `count` calls of `name` took, or a negative value after a failure.
+double timed(LoopRunner& runner, const std::string& name, std::uint64_t count,
+             std::string* error) {
+    auto start = std::chrono::steady_clock::now();
+    if (!runner.run(name, count, error)) {
+        return -1.0;
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Warms `name` up and returns the number of calls that take about one sample
+// time, or 0 after a failure.
+std::uint64_t calibrate(LoopRunner& runner, const std::string& name, const BenchOptions& options,
+                        std::string* error) {
+    // The first call compiles the function.
+    if (timed(runner, name, 1, error) < 0.0) {
+        return 0;
+    }
+    std::uint64_t count = 1;
+    double spent = 0.0;
+    double per_call = 0.0;
+    for (;;) {
+        double seconds = timed(runner, name, count, error);
+        if (seconds < 0.0) {
+            return 0;
+        }
+        spent += seconds;
+        per_call = seconds / static_cast<double>(count);
+        if (spent >= options.warmup_seconds && seconds >= options.sample_seconds / 2) {
+            break;
+        }
+        // Toward a full sample, but never more than 100 times longer at once:
+        // the first, short runs say little about the cost of a call.
+        double wanted = options.sample_seconds / std::max(per_call, 1e-12);
+        auto limit = static_cast<double>(std::min(count * 100, kMaxIterations));
+        count = std::max(count, static_cast<std::uint64_t>(std::min(wanted, limit)));
+    }
+    double calls = std::round(options.sample_seconds / std::max(per_call, 1e-12));
+    return std::clamp<std::uint64_t>(static_cast<std::uint64_t>(calls), 1, kMaxIterations);
+}
+
+// The value at fraction `q` of the sorted `values`, interpolated linearly.
+double quantile(const std::vector<double>& values, double q) {
+    double position = q * static_cast<double>(values.size() - 1);
+    auto below = static_cast<std::size_t>(position);
+    std::size_t above = std::min(below + 1, values.size() - 1);
+    double fraction = position - static_cast<double>(below);
+    return values[below] + (values[above] - values[below]) * fraction;
+}
+
+std::string format(const char* pattern, double value) {
+    char text[64];
+    std::snprintf(text, sizeof(text), pattern, value);
+    return text;
+}
+
+std::string number(double value) {
+    return format("%.6g", value);
+}
+
+std::string escape(const std::string& text) {
+    std::string out;
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out.push_back('\\');
+        }
+        out.push_back(c);
+    }
+    return out;
+}
+
+// Just enough JSON for bench_json's output: objects, arrays, strings without
+// escapes other than \" and \\, and numbers.
+class JsonReader {
+  public:
+    explicit JsonReader(const std::string& text) : text(text) {}
+
+    bool read(std::vector<BenchResult>* results, std::string* error) {
+        bool ok = object([&](const std::string& key) {
+            if (key != "benchmarks") {
+                return skip();
+            }
+            return array([&] {
+                BenchResult result;
+                if (!object([&](const std::string& field) { return read_field(field, result); })) {
+                    return false;
+                }
+                results->push_back(std::move(result));
+                return true;
+            });
+        });
+        if (!ok) {
+            *error = "malformed benchmark results at offset " + std::to_string(at);
+        }
+        return ok;
+    }
+
+  private:
+    const std::string& text;
+    std::size_t at = 0;
+
+    void space() {
+        while (at < text.size() && std::isspace(static_cast<unsigned char>(text[at]))) {
+            ++at;
+        }
+    }
+
+    bool peek(char c) {
+        space();
+        return at < text.size() && text[at] == c;
+    }
+
+    bool consume(char c) {
+        if (peek(c)) {
+            ++at;
+            return true;
+        }
+        return false;
+    }
+
+    bool string(std::string* out) {
+        if (!consume('"')) {
+            return false;
+        }
+        for (; at < text.size() && text[at] != '"'; ++at) {
+            if (text[at] == '\\' && at + 1 < text.size()) {
+                ++at;
+            }
+            out->push_back(text[at]);
+        }
+        return consume('"');
+    }
+
+    bool number(double* out) {
+        space();
+        const char* start = text.c_str() + at;
+        char* end = nullptr;
+        *out = std::strtod(start, &end);
+        at += static_cast<std::size_t>(end - start);
+        return end != start;
+    }
+
+    template <typename Member>
+    bool object(Member member) {
+        if (!consume('{')) {
+            return false;
+        }
+        if (consume('}')) {
+            return true;
+        }
+        do {
+            std::string key;
+            if (!string(&key) || !consume(':') || !member(key)) {
+                return false;
+            }
+        } while (consume(','));
+        return consume('}');
+    }
+
+    template <typename Element>
+    bool array(Element element) {
+        if (!consume('[')) {
+            return false;
+        }
+        if (consume(']')) {
+            return true;
+        }
+        do {
+            if (!element()) {
+                return false;
+            }
+        } while (consume(','));
+        return consume(']');
+    }
+
+    bool skip() {
+        if (peek('{')) {
+            return object([&](const std::string&) { return skip(); });
+        }
+        if (peek('[')) {
+            return array([&] { return skip(); });
+        }
+        if (peek('"')) {
+            std::string ignored;
+            return string(&ignored);
+        }
+        double ignored = 0.0;
+        return number(&ignored);
+    }
+
+    bool read_field(const std::string& key, BenchResult& result) {
+        if (key == "name") {
+            return string(&result.name);
+        }
+        static const std::unordered_map<std::string, double BenchResult::*> kFields = {
+            {"ns_per_op", &BenchResult::ns_per_op},
+            {"median_ns_per_op", &BenchResult::median_ns_per_op},
+            {"min_ns_per_op", &BenchResult::min_ns_per_op},
+            {"stddev_ns_per_op", &BenchResult::stddev_ns_per_op},
+            {"allocs_per_op", &BenchResult::allocs_per_op},
+            {"bytes_per_op", &BenchResult::bytes_per_op},
+        };
+        double value = 0.0;
+        auto found = kFields.find(key);
+        if (found != kFields.end()) {
+            return number(&(result.*found->second));
+        }
+        if (key == "iterations" || key == "samples" || key == "outliers") {
+            if (!number(&value)) {
+                return false;
+            }
+            if (key == "iterations") {
+                result.iterations = static_cast<std::uint64_t>(value);
+            } else if (key == "samples") {
+                result.samples = static_cast<unsigned>(value);
+            } else {
+                result.outliers = static_cast<unsigned>(value);
+            }
+            return true;
+        }
+        return skip();
+    }
+};
+
+}  // namespace
+
+void summarize_samples(std::vector<double> ns, BenchResult* result) {
+    result->samples = static_cast<unsigned>(ns.size());
+    result->outliers = 0;
+    if (ns.empty()) {
+        return;
+    }
+    std::sort(ns.begin(), ns.end());
+    result->median_ns_per_op = quantile(ns, 0.5);
+    result->min_ns_per_op = ns.front();
+    double q1 = quantile(ns, 0.25);
+    double q3 = quantile(ns, 0.75);
+    double low = q1 - 1.5 * (q3 - q1);
+    double high = q3 + 1.5 * (q3 - q1);
+    std::vector<double> kept;
+    for (double sample : ns) {
+        if (sample >= low && sample <= high) {
+            kept.push_back(sample);
+        }
+    }
+    result->outliers = static_cast<unsigned>(ns.size() - kept.size());
+    double sum = 0.0;
+    for (double sample : kept) {
+        sum += sample;
+    }
+    double mean = sum / static_cast<double>(kept.size());
+    double squares = 0.0;
+    for (double sample : kept) {
+        squares += (sample - mean) * (sample - mean);
+    }
+    result->ns_per_op = mean;
+    result->stddev_ns_per_op =
+        kept.size() > 1 ? std::sqrt(squares / static_cast<double>(kept.size() - 1)) : 0.0;
+}
+
+bool run_benchmarks(const middle::Module& module, const BenchOptions& options,
+                    std::vector<BenchResult>* results, std::string* error) {
+    std::vector<std::string> names;
+    for (const auto& fn : module.functions) {
+        bool defined =
+            (fn->flags & middle::FUNCTION_EXTERN) == 0 && fn->entry() != middle::kNoBlock;
+        if ((fn->flags & middle::FUNCTION_BENCH) != 0 && defined &&
+            fn->name.find(options.filter) != std::string::npos) {
+            names.push_back(fn->name);
+        }
+    }
+    if (names.empty()) {
+        return true;
+    }
+    CodegenOptions codegen_options;
+    codegen_options.opt_level = options.opt_level;
+    codegen_options.count_allocations = true;
+    std::unique_ptr<LoopRunner> runner = LoopRunner::create(module, names, codegen_options, error);
+    if (runner == nullptr) {
+        return false;
+    }
+    for (const std::string& name : names) {
+        support::TraceScope trace("bench", name);
+        BenchResult result;
+        result.name = name;
+        result.iterations = calibrate(*runner, name, options, error);
+        if (result.iterations == 0) {
+            *error = "@" + name + ": " + *error;
+            return false;
+        }
+        std::vector<double> ns;
+        runtime::AllocationCounters counters;
+        runtime::AllocationCounters* previous = runtime::count_allocations(&counters);
+        for (unsigned i = 0; i < std::max(options.samples, 1u); ++i) {
+            double seconds = timed(*runner, name, result.iterations, error);
+            if (seconds < 0.0) {
+                runtime::count_allocations(previous);
+                *error = "@" + name + ": " + *error;
+                return false;
+            }
+            ns.push_back(seconds * 1e9 / static_cast<double>(result.iterations));
+        }
+        runtime::count_allocations(previous);
+        double calls = static_cast<double>(result.iterations) * static_cast<double>(ns.size());
+        result.allocs_per_op = static_cast<double>(counters.allocations) / calls;
+        result.bytes_per_op = static_cast<double>(counters.bytes) / calls;
+        summarize_samples(std::move(ns), &result);
+        results->push_back(std::move(result));
+    }
+    return true;
+}
+
+std::string bench_json(const std::vector<BenchResult>& results, const std::string& file,
+                       int opt_level) {
+    std::string out = "{\n  \"file\": \"" + escape(file) + "\",\n  \"opt_level\": " +
+                      std::to_string(opt_level) + ",\n  \"benchmarks\": [";
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const BenchResult& r = results[i];
+        out += i == 0 ? "\n" : ",\n";
+        out += "    {\"name\": \"" + escape(r.name) + "\", \"iterations\": " +
+               std::to_string(r.iterations) + ", \"samples\": " + std::to_string(r.samples) +
+               ", \"outliers\": " + std::to_string(r.outliers) + ",\n     \"ns_per_op\": " +
+               number(r.ns_per_op) + ", \"median_ns_per_op\": " + number(r.median_ns_per_op) +
+               ", \"min_ns_per_op\": " + number(r.min_ns_per_op) +
+               ",\n     \"stddev_ns_per_op\": " + number(r.stddev_ns_per_op) +
+               ", \"allocs_per_op\": " + number(r.allocs_per_op) +
+               ", \"bytes_per_op\": " + number(r.bytes_per_op) + "}";
+    }
+    out += results.empty() ? "]\n}\n" : "\n  ]\n}\n";
+    return out;
+}
+
+bool parse_bench_json(const std::string& text, std::vector<BenchResult>* results,
+                      std::string* error) {
+    return JsonReader(text).read(results, error);
+}
+
+std::string bench_table(const std::vector<BenchResult>& results,
+                        const std::vector<BenchResult>* baseline) {
+    std::size_t width = 9;
+    for (const BenchResult& r : results) {
+        width = std::max(width, r.name.size());
+    }
+    auto pad = [](std::string text, std::size_t size) {
+        return text.size() < size ? text + std::string(size - text.size(), ' ') : text;
+    };
+    auto right = [](std::string text, std::size_t size) {
+        return text.size() < size ? std::string(size - text.size(), ' ') + text : text;
+    };
+    std::string out = pad("benchmark", width) + right("ns/op", 14) + right("+/-", 8) +
+                      right("allocs/op", 12) + right("bytes/op", 12) + right("calls", 14);
+    out += baseline != nullptr ? right("change", 10) + "\n" : "\n";
+    for (const BenchResult& r : results) {
+        double spread = r.ns_per_op > 0.0 ? 100.0 * r.stddev_ns_per_op / r.ns_per_op : 0.0;
+        out += pad(r.name, width) + right(format("%.2f", r.ns_per_op), 14) +
+               right(format("%.1f%%", spread), 8) + right(format("%.2f", r.allocs_per_op), 12) +
+               right(format("%.1f", r.bytes_per_op), 12) +
+               right(std::to_string(r.iterations), 14);
+        if (baseline != nullptr) {
+            auto old = std::find_if(baseline->begin(), baseline->end(),
+                                    [&](const BenchResult& b) { return b.name == r.name; });
+            std::string change = "new";
+            if (old != baseline->end() && old->ns_per_op > 0.0) {
+                change = format("%+.1f%%", 100.0 * (r.ns_per_op / old->ns_per_op - 1.0));
+            }
+            out += right(change, 10);
+        }
+        out += '\n';
+    }
+    return out;
+}
+
+}  // namespace pallas::backend
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "middle/ir.h"
+
+namespace pallas::backend {
+
+// Benchmarks: functions marked @bench, measured by `palc bench` the way tests
+// are run. Each is compiled once with the JIT and then called in loops of a
+// calibrated length: after a warmup, the iteration count is chosen so that one
+// sample takes about `sample_seconds`, then `samples` samples are timed.
+// Samples outside Tukey's fences (1.5 interquartile ranges beyond the
+// quartiles) are dropped as outliers before the mean and deviation are taken.
+// Heap allocations are counted over the timed samples.
+
+struct BenchOptions {
+    int opt_level = 2;
+    std::string filter;  // only benchmarks whose name contains this
+    unsigned samples = 20;
+    double sample_seconds = 0.01;
+    double warmup_seconds = 0.05;
+};
+
+struct BenchResult {
+    std::string name;
+    std::uint64_t iterations = 0;  // calls per sample
+    unsigned samples = 0;
+    unsigned outliers = 0;
+    double ns_per_op = 0.0;  // mean of the samples kept
+    double median_ns_per_op = 0.0;
+    double min_ns_per_op = 0.0;
+    double stddev_ns_per_op = 0.0;
+    double allocs_per_op = 0.0;
+    double bytes_per_op = 0.0;
+};
+
+// The statistics of `ns` (nanoseconds per call, one per sample) as run_benchmarks
+// reports them; `name`, `iterations` and the allocation figures are left alone.
+void summarize_samples(std::vector<double> ns, BenchResult* result);
+
+// Measures every @bench function of `module` that the filter selects, in
+// module order. False with `error` when the module cannot be compiled or a
+// benchmark fails a runtime check.
+bool run_benchmarks(const middle::Module& module, const BenchOptions& options,
+                    std::vector<BenchResult>* results, std::string* error);
+
+// Results as JSON, for comparison across runs:
+//
+//   {
+//     "file": "lib.pal",
+//     "opt_level": 2,
+//     "benchmarks": [
+//       {"name": "sum", "iterations": 81920, "samples": 20, "outliers": 1,
+//        "ns_per_op": 121.5, "median_ns_per_op": 120.9, "min_ns_per_op": 119.7,
+//        "stddev_ns_per_op": 1.8, "allocs_per_op": 0, "bytes_per_op": 0},
+//       ...
+//     ]
+//   }
+std::string bench_json(const std::vector<BenchResult>& results, const std::string& file,
+                       int opt_level);
+
+// Reads back the benchmarks of bench_json's output. Unknown keys are ignored.
+bool parse_bench_json(const std::string& text, std::vector<BenchResult>* results,
+                      std::string* error);
+
+// A table with one line per benchmark; with a baseline, the change in ns/op
+// of the benchmarks it also has.
+std::string bench_table(const std::vector<BenchResult>& results,
+                        const std::vector<BenchResult>* baseline = nullptr);
+
+}  // namespace pallas::backend
@@ -0,0 +1,1223 @@
+#include "codegen.h"
+
+#ifdef PALLAS_HAVE_LLVM
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <csetjmp>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <llvm/CodeGen/ParallelCG.h>
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/InlineAsm.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/IR/MDBuilder.h>
+#include <llvm/IR/Verifier.h>
+#include <llvm/MC/TargetRegistry.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Target/TargetMachine.h>
+#include "middle/passes.h"
+#include "middle/profile.h"
+#include "runtime/alloc.h"
+#include "runtime/arena.h"
+#include "runtime/bench.h"
+#include "runtime/format.h"
+#include "runtime/heap_profile.h"
+#include "runtime/panic.h"
+#include "runtime/profile.h"
+#include "runtime/str.h"
+#include "runtime/vec.h"
+#include "support/trace.h"
+
+namespace pallas::backend {
+
+using middle::BlockId;
+using middle::CmpPredicate;
+using middle::Function;
+using middle::Inst;
+using middle::IRType;
+using middle::IRTypeKind;
+using middle::kNoValue;
+using middle::Opcode;
+using middle::SymbolId;
+using middle::ValueId;
+
+namespace {
+
+// The JIT calls `entry` through this wrapper, which returns the result as the
+// interpreter encodes it.
+constexpr const char* kEntryWrapper = "pallas.run";
+// LoopRunner calls function f through a loop named this followed by f.
+constexpr const char* kLoopPrefix = "pallas.loop.";
+
+void initialize_llvm() {
+    static std::once_flag once;
+    std::call_once(once, [] {
+        llvm::InitializeNativeTarget();
+        llvm::InitializeNativeTargetAsmPrinter();
+    });
+}
+
+llvm::CodeGenOpt::Level codegen_level(int opt_level) {
+    switch (opt_level) {
+        case 0: return llvm::CodeGenOpt::None;
+        case 1: return llvm::CodeGenOpt::Less;
+        case 2: return llvm::CodeGenOpt::Default;
+        default: return llvm::CodeGenOpt::Aggressive;
+    }
+}
+
+llvm::Instruction::BinaryOps binary_op(Opcode op) {
+    switch (op) {
+        case Opcode::OP_ADD: return llvm::Instruction::Add;
+        case Opcode::OP_SUB: return llvm::Instruction::Sub;
+        case Opcode::OP_MUL: return llvm::Instruction::Mul;
+        case Opcode::OP_SDIV: return llvm::Instruction::SDiv;
+        case Opcode::OP_UDIV: return llvm::Instruction::UDiv;
+        case Opcode::OP_SREM: return llvm::Instruction::SRem;
+        case Opcode::OP_UREM: return llvm::Instruction::URem;
+        case Opcode::OP_AND: return llvm::Instruction::And;
+        case Opcode::OP_OR: return llvm::Instruction::Or;
+        case Opcode::OP_XOR: return llvm::Instruction::Xor;
+        case Opcode::OP_SHL: return llvm::Instruction::Shl;
+        case Opcode::OP_LSHR: return llvm::Instruction::LShr;
+        case Opcode::OP_ASHR: return llvm::Instruction::AShr;
+        case Opcode::OP_FADD: return llvm::Instruction::FAdd;
+        case Opcode::OP_FSUB: return llvm::Instruction::FSub;
+        case Opcode::OP_FMUL: return llvm::Instruction::FMul;
+        case Opcode::OP_FDIV: return llvm::Instruction::FDiv;
+        default: return llvm::Instruction::FRem;
+    }
+}
+
+llvm::Instruction::CastOps cast_op(Opcode op) {
+    switch (op) {
+        case Opcode::OP_TRUNC: return llvm::Instruction::Trunc;
+        case Opcode::OP_ZEXT: return llvm::Instruction::ZExt;
+        case Opcode::OP_SEXT: return llvm::Instruction::SExt;
+        case Opcode::OP_FPTOSI: return llvm::Instruction::FPToSI;
+        case Opcode::OP_FPTOUI: return llvm::Instruction::FPToUI;
+        case Opcode::OP_SITOFP: return llvm::Instruction::SIToFP;
+        case Opcode::OP_UITOFP: return llvm::Instruction::UIToFP;
+        case Opcode::OP_FPEXT: return llvm::Instruction::FPExt;
+        case Opcode::OP_FPTRUNC: return llvm::Instruction::FPTrunc;
+        case Opcode::OP_PTRTOINT: return llvm::Instruction::PtrToInt;
+        default: return llvm::Instruction::IntToPtr;
+    }
+}
+
+llvm::CmpInst::Predicate predicate(CmpPredicate pred) {
+    switch (pred) {
+        case CmpPredicate::CMP_EQ: return llvm::CmpInst::ICMP_EQ;
+        case CmpPredicate::CMP_NE: return llvm::CmpInst::ICMP_NE;
+        case CmpPredicate::CMP_SLT: return llvm::CmpInst::ICMP_SLT;
+        case CmpPredicate::CMP_SLE: return llvm::CmpInst::ICMP_SLE;
+        case CmpPredicate::CMP_SGT: return llvm::CmpInst::ICMP_SGT;
+        case CmpPredicate::CMP_SGE: return llvm::CmpInst::ICMP_SGE;
+        case CmpPredicate::CMP_ULT: return llvm::CmpInst::ICMP_ULT;
+        case CmpPredicate::CMP_ULE: return llvm::CmpInst::ICMP_ULE;
+        case CmpPredicate::CMP_UGT: return llvm::CmpInst::ICMP_UGT;
+        case CmpPredicate::CMP_UGE: return llvm::CmpInst::ICMP_UGE;
+        case CmpPredicate::CMP_OEQ: return llvm::CmpInst::FCMP_OEQ;
+        case CmpPredicate::CMP_ONE: return llvm::CmpInst::FCMP_ONE;
+        case CmpPredicate::CMP_OLT: return llvm::CmpInst::FCMP_OLT;
+        case CmpPredicate::CMP_OLE: return llvm::CmpInst::FCMP_OLE;
+        case CmpPredicate::CMP_OGT: return llvm::CmpInst::FCMP_OGT;
+        default: return llvm::CmpInst::FCMP_OGE;
+    }
+}
+
+// Translates one IR module into one LLVM module.
+class Translator {
+  public:
+    Translator(const middle::Module& source, llvm::LLVMContext& context,
+               bool count_allocations = false)
+        : source(source), context(context), builder(context),
+          count_allocations(count_allocations) {}
+
+    std::unique_ptr<llvm::Module> translate(std::string* error_out) {
+        support::TraceScope trace("llvm-translate");
+        target = std::make_unique<llvm::Module>("pallas", context);
+        for (const middle::Global& global : source.globals) {
+            auto* data = llvm::ConstantDataArray::getString(context, global.bytes, false);
+            auto* variable = new llvm::GlobalVariable(
+                *target, data->getType(), global.constant, llvm::GlobalValue::InternalLinkage,
+                data, source.symbol_name(global.symbol));
+            variable->setAlignment(llvm::Align(16));
+            symbols[global.symbol] = llvm::ConstantExpr::getPointerCast(variable, pointer_type());
+        }
+        for (const auto& fn : source.functions) {
+            declare(*fn);
+        }
+        for (std::size_t i = 0; i < source.functions.size() && error.empty(); ++i) {
+            const Function& fn = *source.functions[i];
+            if ((fn.flags & middle::FUNCTION_EXTERN) == 0 && fn.entry() != middle::kNoBlock) {
+                support::TraceScope function_trace("llvm-translate-function", fn.name);
+                function_trace.set_items(fn.instruction_count());
+                define(fn, functions[i]);
+            }
+        }
+        std::string broken;
+        llvm::raw_string_ostream message(broken);
+        if (error.empty() && llvm::verifyModule(*target, &message)) {
+            error = "invalid LLVM IR: " + message.str();
+        }
+        if (!error.empty()) {
+            *error_out = error;
+            return nullptr;
+        }
+        return std::move(target);
+    }
+
+  private:
+    const middle::Module& source;
+    llvm::LLVMContext& context;
+    llvm::IRBuilder<> builder;
+    std::unique_ptr<llvm::Module> target;
+    bool count_allocations;  // new and delete call the runtime (runtime/alloc.h)
+    std::vector<llvm::Function*> functions;  // parallel to source.functions
+    std::unordered_map<SymbolId, llvm::Constant*> symbols;
+    llvm::FunctionCallee calloc_fn;
+    llvm::FunctionCallee free_fn;
+    llvm::FunctionCallee new_fn;
+    llvm::FunctionCallee delete_fn;
+    llvm::FunctionCallee bounds_fail_fn;
+    std::string error;
+
+    // State of the function being defined.
+    const Function* fn = nullptr;
+    std::vector<llvm::Value*> values;
+    std::vector<llvm::BasicBlock*> blocks;
+    // The IR block every LLVM block was emitted for; bounds checks and
+    // switches on non-constant cases split one IR block into several.
+    std::unordered_map<llvm::BasicBlock*, BlockId> origin;
+    std::vector<std::pair<ValueId, llvm::PHINode*>> phis;
+
+    bool fail(const std::string& msg) {
+        if (error.empty()) {
+            error = msg;
+        }
+        return false;
+    }
+
+    llvm::Type* pointer_type() { return llvm::Type::getInt8PtrTy(context); }
+
+    llvm::Type* type(IRType t) {
+        llvm::Type* scalar = nullptr;
+        switch (t.kind) {
+            case IRTypeKind::IR_VOID: return llvm::Type::getVoidTy(context);
+            case IRTypeKind::IR_F32: scalar = llvm::Type::getFloatTy(context); break;
+            case IRTypeKind::IR_F64: scalar = llvm::Type::getDoubleTy(context); break;
+            case IRTypeKind::IR_PTR: scalar = pointer_type(); break;
+            default: scalar = llvm::Type::getIntNTy(context, middle::type_bits(t)); break;
+        }
+        return t.is_vector() ? llvm::FixedVectorType::get(scalar, t.lanes) : scalar;
+    }
+
+    void declare(const Function& f) {
+        std::vector<llvm::Type*> params;
+        for (std::size_t i = 0; i < f.num_args(); ++i) {
+            params.push_back(type(f.inst(f.arg(i)).type));
+        }
+        auto* signature = llvm::FunctionType::get(type(f.return_type), params, false);
+        // Compiler-generated helpers (`pallas.*`) and functions internalized by
+        // whole-program optimization stay private to the object.
+        bool helper = (f.name.starts_with("pallas.") || (f.flags & middle::FUNCTION_INTERNAL)) &&
+                      (f.flags & middle::FUNCTION_EXTERN) == 0;
+        auto* out = llvm::Function::Create(signature,
+                                           helper ? llvm::GlobalValue::InternalLinkage
+                                                  : llvm::GlobalValue::ExternalLinkage,
+                                           f.name, *target);
+        out->addFnAttr(llvm::Attribute::NoUnwind);
+        if ((f.flags & middle::FUNCTION_INLINE) != 0) {
+            out->addFnAttr(llvm::Attribute::AlwaysInline);
+        } else if ((f.flags & middle::FUNCTION_NOINLINE) != 0) {
+            out->addFnAttr(llvm::Attribute::NoInline);
+        }
+        functions.push_back(out);
+        SymbolId symbol = source.find_symbol(f.name);
+        if (symbol != middle::kNoSymbol) {
+            symbols[symbol] = llvm::ConstantExpr::getPointerCast(out, pointer_type());
+        }
+    }
+
+    llvm::FunctionCallee runtime(llvm::FunctionCallee& cached, const char* name,
+                                 llvm::Type* ret, std::initializer_list<llvm::Type*> params) {
+        if (!cached) {
+            cached = target->getOrInsertFunction(name, llvm::FunctionType::get(ret, params, false));
+        }
+        return cached;
+    }
+
+    // An empty assembly statement that claims to change `value` and to touch
+    // memory: free at run time, opaque to the optimizer. The value goes
+    // through a general-purpose register as an integer of its size.
+    llvm::Value* black_box(llvm::Value* value) {
+        llvm::Type* type = value->getType();
+        llvm::Type* i64 = builder.getInt64Ty();
+        llvm::Value* bits = value;
+        if (type->isPointerTy()) {
+            bits = builder.CreatePtrToInt(value, i64);
+        } else if (type->isFloatingPointTy()) {
+            bits = builder.CreateBitCast(value, builder.getIntNTy(type->getPrimitiveSizeInBits()));
+        }
+        auto* asm_type = llvm::FunctionType::get(bits->getType(), {bits->getType()}, false);
+        auto* statement = llvm::InlineAsm::get(asm_type, "", "=r,0,~{memory}", true);
+        llvm::Value* out = builder.CreateCall(asm_type, statement, {bits});
+        if (type->isPointerTy()) {
+            return builder.CreateIntToPtr(out, type);
+        }
+        return type->isFloatingPointTy() ? builder.CreateBitCast(out, type) : out;
+    }
+
+    llvm::Value* constant(const Inst& inst) {
+        llvm::Type* t = type(inst.type);
+        switch (inst.type.kind) {
+            case IRTypeKind::IR_F32:
+            case IRTypeKind::IR_F64:
+                return llvm::ConstantFP::get(t, std::bit_cast<double>(inst.imm));
+            case IRTypeKind::IR_PTR:
+                if (inst.imm == 0 && !inst.type.is_vector()) {
+                    return llvm::ConstantPointerNull::get(llvm::cast<llvm::PointerType>(t));
+                }
+                return llvm::ConstantExpr::getIntToPtr(
+                    llvm::ConstantInt::get(llvm::Type::getInt64Ty(context), inst.imm), t);
+            default:
+                // Constants hold 64 bits; wider ones are sign-extended.
+                return llvm::ConstantInt::get(t, inst.imm, inst.type.kind == IRTypeKind::IR_I128);
+        }
+    }
+
+    llvm::Value* value(ValueId v) {
+        if (values[v] != nullptr) {
+            return values[v];
+        }
+        const Inst& inst = fn->inst(v);
+        switch (inst.op) {
+            case Opcode::OP_CONST: values[v] = constant(inst); break;
+            case Opcode::OP_UNDEF: values[v] = llvm::UndefValue::get(type(inst.type)); break;
+            case Opcode::OP_GLOBAL: {
+                auto found = symbols.find(inst.aux);
+                if (found == symbols.end()) {
+                    fail("reference to unknown symbol '@" + source.symbol_name(inst.aux) + "'");
+                    return llvm::UndefValue::get(pointer_type());
+                }
+                values[v] = found->second;
+                break;
+            }
+            default:
+                fail("use of %" + std::to_string(v) + " before its definition in '@" + fn->name +
+                     "'");
+                return llvm::UndefValue::get(type(inst.type));
+        }
+        return values[v];
+    }
+
+    llvm::Value* operand(ValueId v, std::uint32_t i) { return value(fn->operand(v, i)); }
+
+    llvm::Value* address(ValueId v, std::uint32_t i, IRType pointee) {
+        return builder.CreateBitCast(operand(v, i), type(pointee)->getPointerTo());
+    }
+
+    static llvm::Align alignment(IRType t) {
+        return llvm::Align(std::max<std::uint64_t>(middle::type_size(t.element()), 1));
+    }
+
+    void define(const Function& f, llvm::Function* out) {
+        fn = &f;
+        values.assign(f.num_values(), nullptr);
+        blocks.assign(f.num_blocks(), nullptr);
+        origin.clear();
+        phis.clear();
+        for (std::size_t i = 0; i < f.num_args(); ++i) {
+            values[f.arg(i)] = out->getArg(static_cast<unsigned>(i));
+        }
+        if (!f.profile.empty()) {
+            out->setEntryCount(f.profile.entry_count);
+            if (f.profile.entry_count == 0) {
+                out->addFnAttr(llvm::Attribute::Cold);
+            }
+        }
+        // Reverse postorder puts every definition before its uses; blocks the
+        // profile shows cold go last.
+        middle::CFGInfo cfg(f);
+        std::vector<BlockId> layout = middle::code_layout(f, cfg);
+        for (BlockId b : layout) {
+            blocks[b] = llvm::BasicBlock::Create(context, "", out);
+            origin[blocks[b]] = b;
+        }
+        for (BlockId b : layout) {
+            builder.SetInsertPoint(blocks[b]);
+            for (ValueId v = f.block(b).first; v != kNoValue; v = f.inst(v).next) {
+                if (!emit(v, b)) {
+                    return;
+                }
+            }
+        }
+        // Incoming values follow the LLVM predecessors, once per edge.
+        for (auto [v, phi] : phis) {
+            std::span<const BlockId> from = f.targets(v);
+            for (llvm::BasicBlock* pred : llvm::predecessors(phi->getParent())) {
+                BlockId b = origin[pred];
+                std::uint32_t i = 0;
+                while (i < from.size() && from[i] != b) {
+                    ++i;
+                }
+                if (i == from.size()) {
+                    fail("phi in '@" + f.name + "' has no value for the incoming edge");
+                    return;
+                }
+                phi->addIncoming(operand(v, i), pred);
+            }
+        }
+    }
+
+    llvm::BasicBlock* split(BlockId b) {
+        llvm::BasicBlock* next =
+            llvm::BasicBlock::Create(context, "", builder.GetInsertBlock()->getParent());
+        origin[next] = b;
+        return next;
+    }
+
+    bool emit(ValueId v, BlockId b) {
+        const Inst& inst = fn->inst(v);
+        llvm::Value* result = nullptr;
+        switch (inst.op) {
+            case Opcode::OP_PHI: {
+                llvm::PHINode* phi = builder.CreatePHI(type(inst.type), inst.num_targets);
+                phis.emplace_back(v, phi);
+                result = phi;
+                break;
+            }
+            case Opcode::OP_ADD:
+            case Opcode::OP_SUB:
+            case Opcode::OP_MUL:
+            case Opcode::OP_SDIV:
+            case Opcode::OP_UDIV:
+            case Opcode::OP_SREM:
+            case Opcode::OP_UREM:
+            case Opcode::OP_AND:
+            case Opcode::OP_OR:
+            case Opcode::OP_XOR:
+            case Opcode::OP_SHL:
+            case Opcode::OP_LSHR:
+            case Opcode::OP_ASHR:
+            case Opcode::OP_FADD:
+            case Opcode::OP_FSUB:
+            case Opcode::OP_FMUL:
+            case Opcode::OP_FDIV:
+            case Opcode::OP_FREM: {
+                llvm::Value* a = operand(v, 0);
+                llvm::Value* c = operand(v, 1);
+                if (inst.type.kind == IRTypeKind::IR_PTR && !inst.type.is_vector()) {
+                    // Pointers take part in arithmetic as 64-bit integers.
+                    llvm::Type* i64 = llvm::Type::getInt64Ty(context);
+                    result = builder.CreateBinOp(binary_op(inst.op), builder.CreatePtrToInt(a, i64),
+                                                 builder.CreatePtrToInt(c, i64));
+                    result = builder.CreateIntToPtr(result, pointer_type());
+                } else {
+                    result = builder.CreateBinOp(binary_op(inst.op), a, c);
+                }
+                break;
+            }
+            case Opcode::OP_FNEG:
+                result = builder.CreateFNeg(operand(v, 0));
+                break;
+            case Opcode::OP_ICMP:
+                result = builder.CreateICmp(predicate(static_cast<CmpPredicate>(inst.aux)),
+                                            operand(v, 0), operand(v, 1));
+                break;
+            case Opcode::OP_FCMP:
+                result = builder.CreateFCmp(predicate(static_cast<CmpPredicate>(inst.aux)),
+                                            operand(v, 0), operand(v, 1));
+                break;
+            case Opcode::OP_TRUNC:
+            case Opcode::OP_ZEXT:
+            case Opcode::OP_SEXT:
+            case Opcode::OP_FPTOSI:
+            case Opcode::OP_FPTOUI:
+            case Opcode::OP_SITOFP:
+            case Opcode::OP_UITOFP:
+            case Opcode::OP_FPEXT:
+            case Opcode::OP_FPTRUNC:
+            case Opcode::OP_PTRTOINT:
+            case Opcode::OP_INTTOPTR:
+                result = builder.CreateCast(cast_op(inst.op), operand(v, 0), type(inst.type));
+                break;
+            case Opcode::OP_SELECT:
+                result = builder.CreateSelect(operand(v, 0), operand(v, 1), operand(v, 2));
+                break;
+            case Opcode::OP_SPLAT:
+                result = builder.CreateVectorSplat(inst.type.lanes, operand(v, 0));
+                break;
+            case Opcode::OP_EXTRACT:
+                result = builder.CreateExtractElement(operand(v, 0), operand(v, 1));
+                break;
+            case Opcode::OP_INSERT:
+                result = builder.CreateInsertElement(operand(v, 0), operand(v, 1), operand(v, 2));
+                break;
+            case Opcode::OP_ALLOCA: {
+                llvm::Align align(std::max<std::uint32_t>(inst.aux, 1));
+                llvm::AllocaInst* slot = builder.CreateAlloca(
+                    llvm::ArrayType::get(builder.getInt8Ty(), inst.imm));
+                slot->setAlignment(align);
+                result = builder.CreatePointerCast(slot, pointer_type());
+                builder.CreateMemSet(result, builder.getInt8(0), inst.imm, align);
+                break;
+            }
+            case Opcode::OP_LOAD:
+                result = builder.CreateAlignedLoad(type(inst.type), address(v, 0, inst.type),
+                                                   alignment(inst.type));
+                break;
+            case Opcode::OP_STORE: {
+                IRType stored = fn->inst(fn->operand(v, 0)).type;
+                builder.CreateAlignedStore(operand(v, 0), address(v, 1, stored), alignment(stored));
+                break;
+            }
+            case Opcode::OP_PTRADD:
+                result = builder.CreateGEP(builder.getInt8Ty(), operand(v, 0), operand(v, 1));
+                break;
+            case Opcode::OP_NEW: {
+                // Zeroed, and never a null pointer for zero bytes.
+                llvm::Type* i64 = builder.getInt64Ty();
+                llvm::Value* size = builder.CreateZExtOrTrunc(operand(v, 0), i64);
+                if (count_allocations) {
+                    result = builder.CreateCall(
+                        runtime(new_fn, "pallas_new", pointer_type(), {i64}), {size});
+                    break;
+                }
+                size = builder.CreateBinaryIntrinsic(llvm::Intrinsic::umax, size,
+                                                     builder.getInt64(1));
+                result = builder.CreateCall(
+                    runtime(calloc_fn, "calloc", pointer_type(), {i64, i64}),
+                    {builder.getInt64(1), size});
+                break;
+            }
+            case Opcode::OP_DELETE:
+                if (count_allocations) {
+                    builder.CreateCall(runtime(delete_fn, "pallas_delete", builder.getVoidTy(),
+                                               {pointer_type()}),
+                                       {operand(v, 0)});
+                    break;
+                }
+                builder.CreateCall(runtime(free_fn, "free", builder.getVoidTy(), {pointer_type()}),
+                                   {operand(v, 0)});
+                break;
+            case Opcode::OP_BOUNDS_CHECK: {
+                llvm::Value* index = operand(v, 0);
+                llvm::Value* length = operand(v, 1);
+                llvm::BasicBlock* fail_block = split(b);
+                llvm::BasicBlock* next = split(b);
+                llvm::MDNode* weights = llvm::MDBuilder(context).createBranchWeights(1, 1 << 20);
+                builder.CreateCondBr(builder.CreateICmpUGE(index, length), fail_block, next,
+                                     weights);
+                builder.SetInsertPoint(fail_block);
+                llvm::Type* i64 = builder.getInt64Ty();
+                llvm::FunctionCallee callee = runtime(bounds_fail_fn, "pallas_bounds_fail",
+                                                      builder.getVoidTy(), {i64, i64});
+                if (auto* decl = llvm::dyn_cast<llvm::Function>(callee.getCallee())) {
+                    decl->setDoesNotReturn();
+                    decl->addFnAttr(llvm::Attribute::Cold);
+                    decl->setDoesNotThrow();
+                }
+                builder.CreateCall(callee, {builder.CreateZExtOrTrunc(index, i64),
+                                            builder.CreateZExtOrTrunc(length, i64)});
+                builder.CreateUnreachable();
+                builder.SetInsertPoint(next);
+                break;
+            }
+            case Opcode::OP_CALL: {
+                const Function* callee = source.function_for(inst.aux);
+                if (callee == nullptr) {
+                    return fail("call to unknown function '@" + source.symbol_name(inst.aux) +
+                                "'");
+                }
+                std::vector<llvm::Value*> args;
+                for (std::uint32_t i = 0; i < inst.num_operands; ++i) {
+                    args.push_back(operand(v, i));
+                }
+                if (callee->name.starts_with("pallas_black_box_") && args.size() == 1) {
+                    result = black_box(args[0]);
+                    break;
+                }
+                llvm::Function* target_fn = target->getFunction(callee->name);
+                llvm::CallInst* call = builder.CreateCall(target_fn, args);
+                if (!target_fn->getReturnType()->isVoidTy()) {
+                    result = call;
+                }
+                break;
+            }
+            case Opcode::OP_BR:
+                builder.CreateBr(blocks[fn->targets(v)[0]]);
+                break;
+            case Opcode::OP_COND_BR: {
+                llvm::Value* condition = operand(v, 0);
+                if (!condition->getType()->isIntegerTy(1)) {
+                    condition = builder.CreateTrunc(condition, builder.getInt1Ty());
+                }
+                const std::vector<std::uint64_t>* counts = branch_counts(v);
+                builder.CreateCondBr(condition, blocks[fn->targets(v)[0]],
+                                     blocks[fn->targets(v)[1]],
+                                     counts != nullptr ? branch_weights(*counts) : nullptr);
+                break;
+            }
+            case Opcode::OP_SWITCH:
+                emit_switch(v, b);
+                break;
+            case Opcode::OP_RET:
+                if (inst.num_operands == 0 || fn->return_type.kind == IRTypeKind::IR_VOID) {
+                    builder.CreateRetVoid();
+                } else {
+                    builder.CreateRet(operand(v, 0));
+                }
+                break;
+            case Opcode::OP_UNREACHABLE:
+                builder.CreateUnreachable();
+                break;
+            default:
+                return fail(std::string("cannot translate '") + middle::opcode_name(inst.op) +
+                            "' in '@" + fn->name + "'");
+        }
+        values[v] = result;
+        return error.empty();
+    }
+
+    // Profile counts of the edges of a branch, if they match its successors.
+    const std::vector<std::uint64_t>* branch_counts(ValueId v) const {
+        auto found = fn->profile.branch_weights.find(v);
+        if (found == fn->profile.branch_weights.end() ||
+            found->second.size() != fn->targets(v).size()) {
+            return nullptr;
+        }
+        return &found->second;
+    }
+
+    // Branch weight metadata holds 32-bit weights; larger counts are scaled down.
+    llvm::MDNode* branch_weights(const std::vector<std::uint64_t>& counts) {
+        std::uint64_t largest = *std::max_element(counts.begin(), counts.end());
+        std::uint64_t divisor = (largest >> 32) + 1;
+        llvm::SmallVector<std::uint32_t, 8> weights;
+        for (std::uint64_t count : counts) {
+            weights.push_back(static_cast<std::uint32_t>(count / divisor));
+        }
+        return llvm::MDBuilder(context).createBranchWeights(weights);
+    }
+
+    // Constant, distinct cases become an LLVM switch, which codegen lowers to
+    // jump tables and search trees; anything else a chain of comparisons in
+    // which the first equal case wins.
+    void emit_switch(ValueId v, BlockId b) {
+        std::span<const BlockId> targets = fn->targets(v);
+        llvm::Value* scrutinee = operand(v, 0);
+        std::uint32_t count = fn->num_operands(v);
+        bool constant = true;
+        for (std::uint32_t i = 1; i < count; ++i) {
+            constant &= llvm::isa<llvm::ConstantInt>(operand(v, i));
+        }
+        if (constant) {
+            llvm::SwitchInst* out = builder.CreateSwitch(scrutinee, blocks[targets[0]], count - 1);
+            llvm::SmallPtrSet<llvm::ConstantInt*, 16> seen;
+            const std::vector<std::uint64_t>* counts = branch_counts(v);
+            std::vector<std::uint64_t> weights;
+            if (counts != nullptr) {
+                weights.push_back((*counts)[0]);
+            }
+            for (std::uint32_t i = 1; i < count; ++i) {
+                auto* key = llvm::cast<llvm::ConstantInt>(operand(v, i));
+                if (seen.insert(key).second) {
+                    out->addCase(key, blocks[targets[i]]);
+                    if (counts != nullptr) {
+                        weights.push_back((*counts)[i]);
+                    }
+                }
+            }
+            if (counts != nullptr) {
+                out->setMetadata(llvm::LLVMContext::MD_prof, branch_weights(weights));
+            }
+            return;
+        }
+        for (std::uint32_t i = 1; i < count; ++i) {
+            llvm::BasicBlock* next = split(b);
+            builder.CreateCondBr(builder.CreateICmpEQ(scrutinee, operand(v, i)),
+                                 blocks[targets[i]], next);
+            builder.SetInsertPoint(next);
+        }
+        builder.CreateBr(blocks[targets[0]]);
+    }
+};
+
+llvm::OptimizationLevel optimization_level(int opt_level) {
+    switch (opt_level) {
+        case 1: return llvm::OptimizationLevel::O1;
+        case 2: return llvm::OptimizationLevel::O2;
+        default: return llvm::OptimizationLevel::O3;
+    }
+}
+
+void optimize(llvm::Module& module, llvm::TargetMachine* machine, int opt_level) {
+    // A lazy JIT partition holds a single function, which the trace names.
+    std::string_view single;
+    std::size_t defined = 0;
+    std::size_t instructions = 0;
+    if (support::tracing()) {
+        for (const llvm::Function& f : module) {
+            if (!f.isDeclaration()) {
+                single = f.getName();
+                defined++;
+                instructions += f.getInstructionCount();
+            }
+        }
+    }
+    support::TraceScope trace("llvm-optimize", defined == 1 ? single : std::string_view());
+    trace.set_items(instructions);
+    llvm::LoopAnalysisManager loops;
+    llvm::FunctionAnalysisManager functions;
+    llvm::CGSCCAnalysisManager sccs;
+    llvm::ModuleAnalysisManager modules;
+    llvm::PassBuilder builder(machine);
+    builder.registerModuleAnalyses(modules);
+    builder.registerCGSCCAnalyses(sccs);
+    builder.registerFunctionAnalyses(functions);
+    builder.registerLoopAnalyses(loops);
+    builder.crossRegisterProxies(loops, functions, sccs, modules);
+    llvm::ModulePassManager passes =
+        opt_level <= 0 ? builder.buildO0DefaultPipeline(llvm::OptimizationLevel::O0)
+                       : builder.buildPerModuleDefaultPipeline(optimization_level(opt_level));
+    passes.run(module, modules);
+}
+
+// Objects are built for the baseline CPU so they run on any machine of the
+// host's architecture.
+std::unique_ptr<llvm::TargetMachine> object_machine(int opt_level, std::string* error) {
+    std::string triple = llvm::sys::getDefaultTargetTriple();
+    const llvm::Target* target = llvm::TargetRegistry::lookupTarget(triple, *error);
+    if (target == nullptr) {
+        return nullptr;
+    }
+    return std::unique_ptr<llvm::TargetMachine>(
+        target->createTargetMachine(triple, "generic", "", llvm::TargetOptions(),
+                                    llvm::Reloc::PIC_, llvm::None, codegen_level(opt_level)));
+}
+
+// Translates and optimizes `module` for `machine`.
+std::unique_ptr<llvm::Module> compile(const middle::Module& module, llvm::LLVMContext& context,
+                                      llvm::TargetMachine& machine,
+                                      const CodegenOptions& options, std::string* error) {
+    Translator translator(module, context, options.count_allocations);
+    std::unique_ptr<llvm::Module> out = translator.translate(error);
+    if (out != nullptr) {
+        out->setTargetTriple(machine.getTargetTriple().str());
+        out->setDataLayout(machine.createDataLayout());
+        optimize(*out, &machine, options.opt_level);
+    }
+    return out;
+}
+
+std::string partition_path(const std::string& path, unsigned index) {
+    if (index == 0) {
+        return path;
+    }
+    std::size_t slash = path.find_last_of('/');
+    std::size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+        dot = path.size();
+    }
+    return path.substr(0, dot) + "." + std::to_string(index) + path.substr(dot);
+}
+
+bool add_entry_wrapper(llvm::Module& module, const std::string& entry, std::string* error) {
+    llvm::Function* callee = module.getFunction(entry);
+    if (callee == nullptr || callee->isDeclaration() || callee->arg_size() != 0) {
+        *error = "'@" + entry + "' must be defined and take no arguments";
+        return false;
+    }
+    llvm::LLVMContext& context = module.getContext();
+    llvm::Type* i64 = llvm::Type::getInt64Ty(context);
+    auto* wrapper = llvm::Function::Create(llvm::FunctionType::get(i64, false),
+                                           llvm::GlobalValue::ExternalLinkage, kEntryWrapper,
+                                           module);
+    llvm::IRBuilder<> builder(llvm::BasicBlock::Create(context, "", wrapper));
+    llvm::Value* result = builder.CreateCall(callee);
+    llvm::Type* type = callee->getReturnType();
+    if (type->isVoidTy()) {
+        result = builder.getInt64(0);
+    } else if (type->isFloatingPointTy()) {
+        result = builder.CreateBitCast(builder.CreateFPExt(result, builder.getDoubleTy()), i64);
+    } else if (type->isPointerTy()) {
+        result = builder.CreatePtrToInt(result, i64);
+    } else {
+        result = builder.CreateZExtOrTrunc(result, i64);
+    }
+    builder.CreateRet(result);
+    return true;
+}
+
+// Defines kLoopPrefix + `name`(i64 count), which calls `name` count times.
+bool add_loop_wrapper(llvm::Module& module, const std::string& name, std::string* error) {
+    llvm::Function* callee = module.getFunction(name);
+    if (callee == nullptr || callee->isDeclaration() || callee->arg_size() != 0) {
+        *error = "'@" + name + "' must be defined and take no arguments";
+        return false;
+    }
+    llvm::LLVMContext& context = module.getContext();
+    llvm::IRBuilder<> builder(context);
+    auto* loop = llvm::Function::Create(
+        llvm::FunctionType::get(builder.getVoidTy(), {builder.getInt64Ty()}, false),
+        llvm::GlobalValue::ExternalLinkage, kLoopPrefix + name, module);
+    auto* entry = llvm::BasicBlock::Create(context, "", loop);
+    auto* body = llvm::BasicBlock::Create(context, "", loop);
+    auto* done = llvm::BasicBlock::Create(context, "", loop);
+    llvm::Value* count = loop->getArg(0);
+    builder.SetInsertPoint(entry);
+    builder.CreateCondBr(builder.CreateICmpEQ(count, builder.getInt64(0)), done, body);
+    builder.SetInsertPoint(body);
+    llvm::PHINode* i = builder.CreatePHI(builder.getInt64Ty(), 2);
+    builder.CreateCall(callee);
+    llvm::Value* next = builder.CreateAdd(i, builder.getInt64(1));
+    i->addIncoming(builder.getInt64(0), entry);
+    i->addIncoming(next, body);
+    builder.CreateCondBr(builder.CreateICmpEQ(next, count), done, body);
+    builder.SetInsertPoint(done);
+    builder.CreateRetVoid();
+    return true;
+}
+
+thread_local std::jmp_buf* panic_target = nullptr;
+thread_local std::string* panic_message = nullptr;
+
+[[noreturn]] void unwind_to_host(const char* message) {
+    *panic_message = message;
+    std::longjmp(*panic_target, 1);
+}
+
+// Kept apart from run_jit so that no object with a destructor lives in a
+// frame that longjmp skips. Floats are returned as double bits.
+template <typename Result>
+bool call_entry(Result (*entry)(), std::uint64_t* value, std::string* error) {
+    std::jmp_buf target;
+    panic_target = &target;
+    panic_message = error;
+    runtime::PanicHandler previous = runtime::set_panic_handler(unwind_to_host);
+    if (setjmp(target) != 0) {
+        runtime::set_panic_handler(previous);
+        return false;
+    }
+    if constexpr (std::is_floating_point_v<Result>) {
+        *value = std::bit_cast<std::uint64_t>(static_cast<double>(entry()));
+    } else {
+        *value = static_cast<std::uint64_t>(entry());
+    }
+    runtime::flush_output();
+    runtime::set_panic_handler(previous);
+    return true;
+}
+
+// call_entry for the loops of LoopRunner.
+bool call_loop(void (*loop)(std::uint64_t), std::uint64_t count, std::string* error) {
+    std::jmp_buf target;
+    panic_target = &target;
+    panic_message = error;
+    runtime::PanicHandler previous = runtime::set_panic_handler(unwind_to_host);
+    if (setjmp(target) != 0) {
+        runtime::set_panic_handler(previous);
+        return false;
+    }
+    loop(count);
+    runtime::flush_output();
+    runtime::set_panic_handler(previous);
+    return true;
+}
+
+template <typename T>
+bool check(llvm::Expected<T>& value, std::string* error) {
+    if (!value) {
+        *error = llvm::toString(value.takeError());
+        return false;
+    }
+    return true;
+}
+
+bool check(llvm::Error value, std::string* error) {
+    if (value) {
+        *error = llvm::toString(std::move(value));
+        return false;
+    }
+    return true;
+}
+
+// Resolves the C library from the process and the runtime, which is linked
+// into palc but whose symbols are not exported, by address.
+bool add_host_symbols(llvm::orc::LLJIT& jit, std::string* error) {
+    llvm::orc::JITDylib& library = jit.getMainJITDylib();
+    auto process = llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+        jit.getDataLayout().getGlobalPrefix());
+    if (!check(process, error)) {
+        return false;
+    }
+    library.addGenerator(std::move(*process));
+    llvm::orc::SymbolMap runtime_symbols;
+    auto define = [&](const char* name, auto* address) {
+        runtime_symbols[jit.mangleAndIntern(name)] = llvm::JITEvaluatedSymbol(
+            llvm::pointerToJITTargetAddress(address), llvm::JITSymbolFlags::Exported);
+    };
+    define("pallas_arena_init", &pallas_arena_init);
+    define("pallas_arena_alloc", &pallas_arena_alloc);
+    define("pallas_arena_free_all", &pallas_arena_free_all);
+    define("pallas_arena_release", &pallas_arena_release);
+    define("pallas_bounds_fail", &pallas_bounds_fail);
+    define("pallas_profile_write", &pallas_profile_write);
+    define("pallas_heap_profile_start", &pallas_heap_profile_start);
+    define("pallas_heap_profile_stop", &pallas_heap_profile_stop);
+    define("pallas_heap_new", &pallas_heap_new);
+    define("pallas_heap_delete", &pallas_heap_delete);
+    define("pallas_heap_arena_init", &pallas_heap_arena_init);
+    define("pallas_heap_arena_alloc", &pallas_heap_arena_alloc);
+    define("pallas_format_i64", &pallas_format_i64);
+    define("pallas_format_u64", &pallas_format_u64);
+    define("pallas_format_i128", &pallas_format_i128);
+    define("pallas_format_u128", &pallas_format_u128);
+    define("pallas_format_f64", &pallas_format_f64);
+    define("pallas_format_f32", &pallas_format_f32);
+    define("pallas_format_string", &pallas_format_string);
+    define("pallas_output_reserve", &pallas_output_reserve);
+    define("pallas_output_commit", &pallas_output_commit);
+    define("pallas_string_assign", &pallas_string_assign);
+    define("pallas_string_append", &pallas_string_append);
+    define("pallas_string_prepare", &pallas_string_prepare);
+    define("pallas_string_commit", &pallas_string_commit);
+    define("pallas_string_slice", &pallas_string_slice);
+    define("pallas_string_free", &pallas_string_free);
+    define("pallas_vec_grow", &pallas_vec_grow);
+    define("pallas_vec_reserve", &pallas_vec_reserve);
+    define("pallas_vec_init_inline", &pallas_vec_init_inline);
+    define("pallas_vec_free", &pallas_vec_free);
+    define("pallas_new", &pallas_new);
+    define("pallas_delete", &pallas_delete);
+    define("pallas_black_box_u64", &pallas_black_box_u64);
+    define("pallas_black_box_f64", &pallas_black_box_f64);
+    define("pallas_black_box_f32", &pallas_black_box_f32);
+    define("pallas_black_box_ptr", &pallas_black_box_ptr);
+    return check(library.define(llvm::orc::absoluteSymbols(std::move(runtime_symbols))), error);
+}
+
+}  // namespace
+
+bool llvm_available() {
+    return true;
+}
+
+std::string emit_llvm_ir(const middle::Module& module, const CodegenOptions& options,
+                         std::string* error) {
+    initialize_llvm();
+    std::unique_ptr<llvm::TargetMachine> machine = object_machine(options.opt_level, error);
+    if (machine == nullptr) {
+        return {};
+    }
+    llvm::LLVMContext context;
+    std::unique_ptr<llvm::Module> out = compile(module, context, *machine, options, error);
+    if (out == nullptr) {
+        return {};
+    }
+    std::string text;
+    llvm::raw_string_ostream stream(text);
+    out->print(stream, nullptr);
+    return stream.str();
+}
+
+bool emit_object(const middle::Module& module, const std::string& path,
+                 const CodegenOptions& options, std::vector<std::string>* written,
+                 std::string* error) {
+    initialize_llvm();
+    std::unique_ptr<llvm::TargetMachine> machine = object_machine(options.opt_level, error);
+    if (machine == nullptr) {
+        return false;
+    }
+    llvm::LLVMContext context;
+    std::unique_ptr<llvm::Module> out = compile(module, context, *machine, options, error);
+    if (out == nullptr) {
+        return false;
+    }
+    std::size_t defined = 0;
+    for (const llvm::Function& f : *out) {
+        defined += !f.isDeclaration();
+    }
+    auto partitions = static_cast<unsigned>(std::clamp<std::size_t>(
+        defined / kMinFunctionsPerPartition, 1, std::max(options.partitions, 1u)));
+
+    std::vector<std::unique_ptr<llvm::raw_fd_ostream>> files;
+    for (unsigned i = 0; i < partitions; ++i) {
+        std::string name = partition_path(path, i);
+        std::error_code code;
+        files.push_back(std::make_unique<llvm::raw_fd_ostream>(name, code, llvm::sys::fs::OF_None));
+        if (code) {
+            *error = "cannot write '" + name + "': " + code.message();
+            return false;
+        }
+        written->push_back(name);
+    }
+    support::TraceScope trace("llvm-emit");
+    if (partitions == 1) {
+        llvm::legacy::PassManager passes;
+        if (machine->addPassesToEmitFile(passes, *files[0], nullptr, llvm::CGFT_ObjectFile)) {
+            *error = "the target cannot emit object files";
+            return false;
+        }
+        passes.run(*out);
+        return true;
+    }
+    std::vector<llvm::raw_pwrite_stream*> streams;
+    for (auto& file : files) {
+        streams.push_back(file.get());
+    }
+    // The first machine was created for the same target, so these cannot fail.
+    llvm::splitCodeGen(*out, streams, {},
+                       [&] {
+                           std::string ignored;
+                           return object_machine(options.opt_level, &ignored);
+                       },
+                       llvm::CGFT_ObjectFile);
+    return true;
+}
+
+namespace {
+
+// A JIT for the host CPU holding `ir`, which compiles every function on its
+// first call.
+std::unique_ptr<llvm::orc::LLLazyJIT> lazy_jit(std::unique_ptr<llvm::Module> ir,
+                                               std::unique_ptr<llvm::LLVMContext> context,
+                                               int opt_level, std::string* error) {
+    auto machine_builder = llvm::orc::JITTargetMachineBuilder::detectHost();
+    if (!check(machine_builder, error)) {
+        return nullptr;
+    }
+    machine_builder->setCodeGenOptLevel(codegen_level(opt_level));
+    auto machine = machine_builder->createTargetMachine();
+    if (!check(machine, error)) {
+        return nullptr;
+    }
+    auto jit = llvm::orc::LLLazyJITBuilder()
+                   .setJITTargetMachineBuilder(std::move(*machine_builder))
+                   .create();
+    if (!check(jit, error)) {
+        return nullptr;
+    }
+    // The on-demand layer hands every function to this transform on its first
+    // call, alone in its module, so only the code that runs is optimized.
+    std::shared_ptr<llvm::TargetMachine> optimizer(std::move(*machine));
+    (*jit)->getIRTransformLayer().setTransform(
+        [optimizer, opt_level](llvm::orc::ThreadSafeModule partition,
+                               llvm::orc::MaterializationResponsibility&) {
+            partition.withModuleDo(
+                [&](llvm::Module& m) { optimize(m, optimizer.get(), opt_level); });
+            return llvm::Expected<llvm::orc::ThreadSafeModule>(std::move(partition));
+        });
+
+    if (!add_host_symbols(**jit, error)) {
+        return nullptr;
+    }
+
+    ir->setDataLayout((*jit)->getDataLayout());
+    ir->setTargetTriple((*jit)->getTargetTriple().str());
+    if (!check((*jit)->addLazyIRModule(
+                   llvm::orc::ThreadSafeModule(std::move(ir), std::move(context))),
+               error)) {
+        return nullptr;
+    }
+    return std::move(*jit);
+}
+
+}  // namespace
+
+RunResult run_jit(const middle::Module& module, const CodegenOptions& options,
+                  const std::string& entry) {
+    RunResult result;
+    initialize_llvm();
+    auto context = std::make_unique<llvm::LLVMContext>();
+    Translator translator(module, *context, options.count_allocations);
+    std::unique_ptr<llvm::Module> ir = translator.translate(&result.error);
+    if (ir == nullptr || !add_entry_wrapper(*ir, entry, &result.error)) {
+        return result;
+    }
+    auto jit = lazy_jit(std::move(ir), std::move(context), options.opt_level, &result.error);
+    if (jit == nullptr) {
+        return result;
+    }
+    auto start = std::chrono::steady_clock::now();
+    auto symbol = jit->lookup(kEntryWrapper);
+    if (!check(symbol, &result.error)) {
+        return result;
+    }
+    auto* function = llvm::jitTargetAddressToFunction<std::uint64_t (*)()>(symbol->getAddress());
+    result.ok = call_entry(function, &result.value, &result.error);
+    result.seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+struct LoopRunner::State {
+    std::unique_ptr<llvm::orc::LLLazyJIT> jit;
+    std::unordered_map<std::string, void (*)(std::uint64_t)> loops;
+};
+
+LoopRunner::LoopRunner() : state(std::make_unique<State>()) {}
+
+LoopRunner::~LoopRunner() = default;
+
+std::unique_ptr<LoopRunner> LoopRunner::create(const middle::Module& module,
+                                               const std::vector<std::string>& functions,
+                                               const CodegenOptions& options,
+                                               std::string* error) {
+    initialize_llvm();
+    auto context = std::make_unique<llvm::LLVMContext>();
+    Translator translator(module, *context, options.count_allocations);
+    std::unique_ptr<llvm::Module> ir = translator.translate(error);
+    if (ir == nullptr) {
+        return nullptr;
+    }
+    for (const std::string& name : functions) {
+        if (!add_loop_wrapper(*ir, name, error)) {
+            return nullptr;
+        }
+    }
+    std::unique_ptr<LoopRunner> runner(new LoopRunner());
+    runner->state->jit = lazy_jit(std::move(ir), std::move(context), options.opt_level, error);
+    if (runner->state->jit == nullptr) {
+        return nullptr;
+    }
+    for (const std::string& name : functions) {
+        auto symbol = runner->state->jit->lookup(kLoopPrefix + name);
+        if (!check(symbol, error)) {
+            return nullptr;
+        }
+        runner->state->loops[name] =
+            llvm::jitTargetAddressToFunction<void (*)(std::uint64_t)>(symbol->getAddress());
+    }
+    return runner;
+}
+
+bool LoopRunner::run(const std::string& function, std::uint64_t count, std::string* error) {
+    auto found = state->loops.find(function);
+    if (found == state->loops.end()) {
+        *error = "'@" + function + "' was not loaded";
+        return false;
+    }
+    return call_loop(found->second, count, error);
+}
+
+RunResult run_object(const middle::Module& module, const std::string& object,
+                     const std::string& entry) {
+    RunResult result;
+    const Function* callee = module.find_function(entry);
+    if (callee == nullptr || (callee->flags & middle::FUNCTION_EXTERN) != 0 ||
+        callee->num_args() != 0) {
+        result.error = "'@" + entry + "' must be defined and take no arguments";
+        return result;
+    }
+    initialize_llvm();
+    auto jit = llvm::orc::LLJITBuilder().create();
+    if (!check(jit, &result.error) || !add_host_symbols(**jit, &result.error)) {
+        return result;
+    }
+    auto buffer = llvm::MemoryBuffer::getMemBufferCopy(object, "pallas.o");
+    if (!check((*jit)->addObjectFile(std::move(buffer)), &result.error)) {
+        return result;
+    }
+    auto start = std::chrono::steady_clock::now();
+    auto symbol = (*jit)->lookup(entry);
+    if (!check(symbol, &result.error)) {
+        return result;
+    }
+    llvm::JITTargetAddress address = symbol->getAddress();
+    switch (callee->return_type.kind) {
+        case IRTypeKind::IR_F32:
+            result.ok = call_entry(llvm::jitTargetAddressToFunction<float (*)()>(address),
+                                   &result.value, &result.error);
+            break;
+        case IRTypeKind::IR_F64:
+            result.ok = call_entry(llvm::jitTargetAddressToFunction<double (*)()>(address),
+                                   &result.value, &result.error);
+            break;
+        default:
+            // Integers come back zero-extended to 64 bits, void leaves garbage.
+            result.ok = call_entry(llvm::jitTargetAddressToFunction<std::uint64_t (*)()>(address),
+                                   &result.value, &result.error);
+            if (callee->return_type.kind == IRTypeKind::IR_VOID) {
+                result.value = 0;
+            }
+            break;
+    }
+    result.seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+}  // namespace pallas::backend
+
+#else  // !PALLAS_HAVE_LLVM
+
+namespace pallas::backend {
+
+namespace {
+
+constexpr const char* kNoLLVM = "palc was built without LLVM";
+
+}  // namespace
+
+bool llvm_available() {
+    return false;
+}
+
+std::string emit_llvm_ir(const middle::Module&, const CodegenOptions&, std::string* error) {
+    *error = kNoLLVM;
+    return {};
+}
+
+bool emit_object(const middle::Module&, const std::string&, const CodegenOptions&,
+                 std::vector<std::string>*, std::string* error) {
+    *error = kNoLLVM;
+    return false;
+}
+
+RunResult run_jit(const middle::Module&, const CodegenOptions&, const std::string&) {
+    RunResult result;
+    result.error = kNoLLVM;
+    return result;
+}
+
+RunResult run_object(const middle::Module&, const std::string&, const std::string&) {
+    RunResult result;
+    result.error = kNoLLVM;
+    return result;
+}
+
+struct LoopRunner::State {};
+
+LoopRunner::LoopRunner() = default;
+
+LoopRunner::~LoopRunner() = default;
+
+std::unique_ptr<LoopRunner> LoopRunner::create(const middle::Module&,
+                                               const std::vector<std::string>&,
+                                               const CodegenOptions&, std::string* error) {
+    *error = kNoLLVM;
+    return nullptr;
+}
+
+bool LoopRunner::run(const std::string&, std::uint64_t, std::string* error) {
+    *error = kNoLLVM;
+    return false;
+}
+
+}  // namespace pallas::backend
+
+#endif  // PALLAS_HAVE_LLVM
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "middle/ir.h"
+
+namespace pallas::backend {
+
+struct CodegenOptions {
+    // LLVM optimization level, 0 to 3, applied on top of the IR pipeline.
+    int opt_level = 0;
+    // Object emission splits modules with at least kMinFunctionsPerPartition
+    // functions per partition into this many objects, generated in parallel.
+    unsigned partitions = 1;
+    // `new` and `delete` call pallas_new and pallas_delete, which count
+    // allocations (runtime/alloc.h), instead of calloc and free.
+    bool count_allocations = false;
+};
+
+constexpr std::size_t kMinFunctionsPerPartition = 8;
+
+struct RunResult {
+    bool ok = false;
+    std::uint64_t value = 0;  // return value bits, zero-extended; floats as double bits
+    std::string error;
+    double seconds = 0.0;     // wall time of the call, including lazy compilation
+};
+
+// Whether palc was built with LLVM; without it every entry point below fails.
+bool llvm_available();
+
+// Translates IR into LLVM IR for the host: integer and float types map
+// directly, `ptr` becomes `i8*` and is cast at loads and stores, and stack
+// slots are zeroed like the interpreter's. `new`/`delete` call calloc and
+// free, a failed bounds check calls pallas_bounds_fail (runtime/panic.h), and
+// arena blocks call the pallas_arena_* runtime. Calls to pallas_black_box_*
+// (runtime/bench.h) become empty inline assembly. Blocks are emitted in
+// reverse postorder; unreachable ones are dropped.
+//
+// Returns the optimized module as text, or an empty string and `error`.
+std::string emit_llvm_ir(const middle::Module& module, const CodegenOptions& options,
+                         std::string* error);
+
+// Writes a relocatable object for the generic CPU of the host architecture.
+// With several partitions the module is split by function and each part is
+// compiled on its own thread; part i > 0 goes to `path` with ".i" inserted
+// before the extension. The written files are appended to `written`. Link
+// them with the runtime (pallas_core) to get a program.
+bool emit_object(const middle::Module& module, const std::string& path,
+                 const CodegenOptions& options, std::vector<std::string>* written,
+                 std::string* error);
+
+// Calls `entry`, which takes no arguments, through an ORC JIT for the host
+// CPU. Functions are compiled lazily on their first call, each optimized at
+// the requested level as it is compiled, so execution starts before the rest
+// of the module is compiled. A failed runtime check ends the call with an
+// error instead of the process.
+RunResult run_jit(const middle::Module& module, const CodegenOptions& options,
+                  const std::string& entry = "main");
+
+// Loads an object compiled from `module` by another backend (emit_x86_object)
+// into the JIT, links it against the C library and the runtime, and calls
+// `entry` like run_jit. `module` supplies the entry's return type.
+RunResult run_object(const middle::Module& module, const std::string& object,
+                     const std::string& entry = "main");
+
+// Functions of a module loaded into the JIT once and called many times over
+// (palc bench). Each of `functions`, which take no arguments, gets a loop that
+// calls it, so a run costs one call from the host however long it is. As with
+// run_jit, functions are compiled and optimized on their first call.
+class LoopRunner {
+  public:
+    ~LoopRunner();
+
+    // Null with `error` set when the module cannot be compiled or one of
+    // `functions` is not defined.
+    static std::unique_ptr<LoopRunner> create(const middle::Module& module,
+                                              const std::vector<std::string>& functions,
+                                              const CodegenOptions& options, std::string* error);
+
+    // Calls `function` `count` times in a row. False with `error` when a
+    // runtime check failed.
+    bool run(const std::string& function, std::uint64_t count, std::string* error);
+
+  private:
+    LoopRunner();
+
+    struct State;
+    std::unique_ptr<State> state;
+};
+
+}  // namespace pallas::backend
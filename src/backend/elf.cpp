@@ -0,0 +1,244 @@
+#include "elf.h"
+#include <cstring>
+
+namespace pallas::backend {
+
+namespace {
+
+// The ELF64 structures, laid out without padding.
+struct FileHeader {
+    std::uint8_t ident[16];
+    std::uint16_t type;
+    std::uint16_t machine;
+    std::uint32_t version;
+    std::uint64_t entry;
+    std::uint64_t phoff;
+    std::uint64_t shoff;
+    std::uint32_t flags;
+    std::uint16_t ehsize;
+    std::uint16_t phentsize;
+    std::uint16_t phnum;
+    std::uint16_t shentsize;
+    std::uint16_t shnum;
+    std::uint16_t shstrndx;
+};
+
+struct SectionHeader {
+    std::uint32_t name;
+    std::uint32_t type;
+    std::uint64_t flags;
+    std::uint64_t addr;
+    std::uint64_t offset;
+    std::uint64_t size;
+    std::uint32_t link;
+    std::uint32_t info;
+    std::uint64_t addralign;
+    std::uint64_t entsize;
+};
+
+struct Symbol {
+    std::uint32_t name;
+    std::uint8_t info;
+    std::uint8_t other;
+    std::uint16_t shndx;
+    std::uint64_t value;
+    std::uint64_t size;
+};
+
+struct Rela {
+    std::uint64_t offset;
+    std::uint64_t info;
+    std::int64_t addend;
+};
+
+static_assert(sizeof(FileHeader) == 64 && sizeof(SectionHeader) == 64);
+static_assert(sizeof(Symbol) == 24 && sizeof(Rela) == 24);
+
+constexpr std::uint32_t kProgBits = 1;
+constexpr std::uint32_t kSymTab = 2;
+constexpr std::uint32_t kStrTab = 3;
+constexpr std::uint32_t kRela = 4;
+constexpr std::uint64_t kWrite = 1;
+constexpr std::uint64_t kAlloc = 2;
+constexpr std::uint64_t kExec = 4;
+constexpr std::uint64_t kInfoLink = 0x40;
+
+// Section indices in the written file.
+enum : std::uint16_t {
+    INDEX_NULL,
+    INDEX_TEXT,
+    INDEX_DATA,
+    INDEX_RODATA,
+    INDEX_RELA_TEXT,
+    INDEX_SYMTAB,
+    INDEX_STRTAB,
+    INDEX_SHSTRTAB,
+    INDEX_NOTE_STACK,
+    SECTION_COUNT,
+};
+
+class StringTable {
+  public:
+    StringTable() : bytes(1, '\0') {}
+    std::uint32_t add(const std::string& s) {
+        auto offset = static_cast<std::uint32_t>(bytes.size());
+        bytes.append(s);
+        bytes.push_back('\0');
+        return offset;
+    }
+    const std::string& contents() const { return bytes; }
+
+  private:
+    std::string bytes;
+};
+
+template <typename T>
+void append(std::string& out, const T& value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void align_to(std::string& out, std::size_t align) {
+    out.resize((out.size() + align - 1) / align * align, '\0');
+}
+
+std::uint16_t section_index(ObjectSection section) {
+    switch (section) {
+        case ObjectSection::SECTION_TEXT: return INDEX_TEXT;
+        case ObjectSection::SECTION_DATA: return INDEX_DATA;
+        case ObjectSection::SECTION_RODATA: return INDEX_RODATA;
+        default: return 0;
+    }
+}
+
+}  // namespace
+
+std::uint32_t ObjectFile::symbol(const std::string& name) {
+    auto [it, added] = symbol_index.emplace(name, static_cast<std::uint32_t>(symbols.size()));
+    if (added) {
+        ObjectSymbol symbol;
+        symbol.name = name;
+        symbols.push_back(symbol);
+    }
+    return it->second;
+}
+
+void ObjectFile::define(std::uint32_t symbol, ObjectSection section, std::uint64_t value,
+                        std::uint64_t size, bool global, bool function) {
+    ObjectSymbol& s = symbols[symbol];
+    s.section = section;
+    s.value = value;
+    s.size = size;
+    s.global = global;
+    s.function = function;
+}
+
+void ObjectFile::relocate(std::uint64_t offset, std::uint32_t symbol, std::uint32_t type,
+                          std::int64_t addend) {
+    relocs.push_back({offset, symbol, type, addend});
+}
+
+std::string ObjectFile::serialize() const {
+    // Symbol 0 is null; locals (undefined symbols are global) come first.
+    std::vector<std::uint32_t> file_index(symbols.size());
+    std::vector<std::uint32_t> order;
+    for (int pass = 0; pass < 2; ++pass) {
+        for (std::uint32_t i = 0; i < symbols.size(); ++i) {
+            bool local = !symbols[i].global &&
+                         symbols[i].section != ObjectSection::SECTION_UNDEFINED;
+            if (local == (pass == 0)) {
+                file_index[i] = static_cast<std::uint32_t>(order.size() + 1);
+                order.push_back(i);
+            }
+        }
+    }
+    std::uint32_t first_global = 1;
+    for (std::uint32_t i : order) {
+        first_global += !symbols[i].global &&
+                        symbols[i].section != ObjectSection::SECTION_UNDEFINED;
+    }
+
+    StringTable strings;
+    std::string symtab;
+    append(symtab, Symbol{});
+    for (std::uint32_t i : order) {
+        const ObjectSymbol& s = symbols[i];
+        bool defined = s.section != ObjectSection::SECTION_UNDEFINED;
+        bool global = s.global || !defined;
+        Symbol out{};
+        out.name = strings.add(s.name);
+        std::uint8_t type = !defined ? 0 : s.function ? 2 : 1;  // NOTYPE, FUNC, OBJECT
+        out.info = static_cast<std::uint8_t>((global ? 1 : 0) << 4 | type);
+        out.shndx = section_index(s.section);
+        out.value = s.value;
+        out.size = s.size;
+        append(symtab, out);
+    }
+    std::string rela;
+    for (const ObjectRelocation& r : relocs) {
+        Rela out{};
+        out.offset = r.offset;
+        out.info = std::uint64_t{file_index[r.symbol]} << 32 | r.type;
+        out.addend = r.addend;
+        append(rela, out);
+    }
+
+    StringTable names;
+    SectionHeader headers[SECTION_COUNT] = {};
+    std::string out(sizeof(FileHeader), '\0');
+    auto place = [&](std::uint16_t index, const char* name, std::uint32_t type,
+                     std::uint64_t flags, const void* bytes, std::size_t size,
+                     std::uint64_t align) {
+        align_to(out, align);
+        SectionHeader& h = headers[index];
+        h.name = names.add(name);
+        h.type = type;
+        h.flags = flags;
+        h.offset = out.size();
+        h.size = size;
+        h.addralign = align;
+        out.append(static_cast<const char*>(bytes), size);
+    };
+    place(INDEX_TEXT, ".text", kProgBits, kAlloc | kExec, text.data(), text.size(), 16);
+    place(INDEX_DATA, ".data", kProgBits, kAlloc | kWrite, data.data(), data.size(), 16);
+    place(INDEX_RODATA, ".rodata", kProgBits, kAlloc, rodata.data(), rodata.size(), 16);
+    place(INDEX_RELA_TEXT, ".rela.text", kRela, kInfoLink, rela.data(), rela.size(), 8);
+    headers[INDEX_RELA_TEXT].link = INDEX_SYMTAB;
+    headers[INDEX_RELA_TEXT].info = INDEX_TEXT;
+    headers[INDEX_RELA_TEXT].entsize = sizeof(Rela);
+    place(INDEX_SYMTAB, ".symtab", kSymTab, 0, symtab.data(), symtab.size(), 8);
+    headers[INDEX_SYMTAB].link = INDEX_STRTAB;
+    headers[INDEX_SYMTAB].info = first_global;
+    headers[INDEX_SYMTAB].entsize = sizeof(Symbol);
+    place(INDEX_STRTAB, ".strtab", kStrTab, 0, strings.contents().data(),
+          strings.contents().size(), 1);
+    std::uint32_t note_name = names.add(".note.GNU-stack");
+    place(INDEX_SHSTRTAB, ".shstrtab", kStrTab, 0, nullptr, 0, 1);
+    // .shstrtab holds its own name, so it is written once all names are known.
+    headers[INDEX_SHSTRTAB].name = names.add(".shstrtab");
+    headers[INDEX_SHSTRTAB].size = names.contents().size();
+    out.append(names.contents());
+    headers[INDEX_NOTE_STACK].name = note_name;
+    headers[INDEX_NOTE_STACK].type = kProgBits;
+    headers[INDEX_NOTE_STACK].offset = out.size();
+    headers[INDEX_NOTE_STACK].addralign = 1;
+
+    align_to(out, 8);
+    FileHeader file{};
+    const std::uint8_t ident[] = {0x7f, 'E', 'L', 'F', 2, 1, 1};  // 64-bit, LSB, version 1
+    std::memcpy(file.ident, ident, sizeof(ident));
+    file.type = 1;      // ET_REL
+    file.machine = 62;  // EM_X86_64
+    file.version = 1;
+    file.shoff = out.size();
+    file.ehsize = sizeof(FileHeader);
+    file.shentsize = sizeof(SectionHeader);
+    file.shnum = SECTION_COUNT;
+    file.shstrndx = INDEX_SHSTRTAB;
+    std::memcpy(out.data(), &file, sizeof(file));
+    for (const SectionHeader& h : headers) {
+        append(out, h);
+    }
+    return out;
+}
+
+}  // namespace pallas::backend
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace pallas::backend {
+
+// x86-64 relocation types used by the direct backend.
+constexpr std::uint32_t kRelocPC32 = 2;      // S + A - P
+constexpr std::uint32_t kRelocPLT32 = 4;     // L + A - P, calls
+constexpr std::uint32_t kRelocGOTPCREL = 9;  // G + GOT + A - P, addresses of functions
+
+enum class ObjectSection : std::uint8_t {
+    SECTION_UNDEFINED,
+    SECTION_TEXT,
+    SECTION_DATA,
+    SECTION_RODATA,
+};
+
+struct ObjectSymbol {
+    std::string name;
+    ObjectSection section = ObjectSection::SECTION_UNDEFINED;
+    std::uint64_t value = 0;  // offset in the section
+    std::uint64_t size = 0;
+    bool global = true;
+    bool function = false;
+};
+
+struct ObjectRelocation {
+    std::uint64_t offset = 0;  // in .text
+    std::uint32_t symbol = 0;
+    std::uint32_t type = 0;
+    std::int64_t addend = 0;
+};
+
+// An ELF64 relocatable object for x86-64 being assembled in memory: code in
+// .text, mutable globals in .data, constant ones in .rodata, and relocations
+// against named symbols, which may stay undefined for the linker to resolve.
+class ObjectFile {
+  public:
+    std::vector<std::uint8_t> text;
+    std::vector<std::uint8_t> data;
+    std::vector<std::uint8_t> rodata;
+
+    // Index of the symbol with this name, added as undefined on first use.
+    std::uint32_t symbol(const std::string& name);
+    void define(std::uint32_t symbol, ObjectSection section, std::uint64_t value,
+                std::uint64_t size, bool global, bool function);
+    const ObjectSymbol& symbol_info(std::uint32_t symbol) const { return symbols[symbol]; }
+    void relocate(std::uint64_t offset, std::uint32_t symbol, std::uint32_t type,
+                  std::int64_t addend);
+    const std::vector<ObjectRelocation>& relocations() const { return relocs; }
+
+    // The file contents. Local symbols are written before global ones, as ELF
+    // requires, and a .note.GNU-stack section marks the stack non-executable.
+    std::string serialize() const;
+
+  private:
+    std::vector<ObjectSymbol> symbols;
+    std::unordered_map<std::string, std::uint32_t> symbol_index;
+    std::vector<ObjectRelocation> relocs;
+};
+
+}  // namespace pallas::backend
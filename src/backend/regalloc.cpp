@@ -0,0 +1,168 @@
+#include "regalloc.h"
+#include <algorithm>
+
+namespace pallas::backend {
+
+using middle::BlockId;
+using middle::kNoValue;
+using middle::Opcode;
+using middle::ValueId;
+
+std::vector<LiveInterval> build_intervals(const middle::Function& fn, const middle::CFGInfo& cfg,
+                                          const std::vector<BlockId>& order,
+                                          const std::vector<std::uint8_t>& reg_class,
+                                          const std::vector<bool>& clobbers,
+                                          CodePositions* positions) {
+    positions->value.assign(fn.num_values(), 0);
+    positions->block_start.assign(fn.num_blocks(), 0);
+    positions->block_end.assign(fn.num_blocks(), 0);
+    std::vector<std::uint32_t> calls;
+    std::uint32_t pos = 2;
+    for (BlockId b : order) {
+        positions->block_start[b] = pos;
+        pos += 2;
+        for (ValueId v = fn.block(b).first; v != kNoValue; v = fn.inst(v).next) {
+            if (fn.inst(v).op == Opcode::OP_PHI) {
+                positions->value[v] = positions->block_start[b];
+                continue;
+            }
+            positions->value[v] = pos;
+            if (clobbers[v]) {
+                calls.push_back(pos);
+            }
+            pos += 2;
+        }
+        positions->block_end[b] = pos;
+        pos += 2;
+    }
+
+    std::vector<std::uint32_t> start(positions->value);
+    std::vector<std::uint32_t> end(fn.num_values(), 0);
+    std::vector<bool> defined(fn.num_values(), false);
+    auto extend = [&](ValueId v, std::uint32_t at) {
+        if (reg_class[v] != kNoRegClass) {
+            end[v] = std::max(end[v], at);
+        }
+    };
+    for (std::size_t i = 0; i < fn.num_args(); ++i) {
+        defined[fn.arg(i)] = true;
+    }
+    middle::Liveness liveness(fn, cfg);
+    for (BlockId b : order) {
+        for (ValueId v = fn.block(b).first; v != kNoValue; v = fn.inst(v).next) {
+            const middle::Inst& inst = fn.inst(v);
+            defined[v] = true;
+            end[v] = std::max(end[v], positions->value[v]);
+            for (std::uint32_t i = 0; i < inst.num_operands; ++i) {
+                ValueId op = fn.operand(v, i);
+                extend(op, inst.op == Opcode::OP_PHI ? positions->block_end[fn.targets(v)[i]]
+                                                     : positions->value[v]);
+            }
+            if (inst.op == Opcode::OP_PHI) {
+                // A phi is written by the moves at the end of each predecessor.
+                for (BlockId pred : fn.targets(v)) {
+                    if (!cfg.reachable(pred)) {
+                        continue;
+                    }
+                    start[v] = std::min(start[v], positions->block_end[pred]);
+                    end[v] = std::max(end[v], positions->block_end[pred]);
+                }
+            }
+        }
+        // Values used further on, or around a loop.
+        for (ValueId v : liveness.live_out_values(b)) {
+            extend(v, positions->block_end[b]);
+        }
+    }
+
+    std::vector<LiveInterval> intervals;
+    for (ValueId v = 0; v < fn.num_values(); ++v) {
+        if (!defined[v] || reg_class[v] == kNoRegClass) {
+            continue;
+        }
+        LiveInterval interval;
+        interval.value = v;
+        interval.start = start[v];
+        interval.end = end[v];
+        interval.reg_class = reg_class[v];
+        // A call at the first position defines the value, one at the last uses it.
+        auto call = std::upper_bound(calls.begin(), calls.end(), interval.start);
+        interval.crosses_call = call != calls.end() && *call < interval.end;
+        intervals.push_back(interval);
+    }
+    return intervals;
+}
+
+RegisterAssignment linear_scan(std::vector<LiveInterval> intervals,
+                               std::span<const RegisterClass> classes, std::size_t num_values) {
+    RegisterAssignment out;
+    out.reg.assign(num_values, -1);
+    out.slot.assign(num_values, -1);
+    auto by_start = [](const LiveInterval& a, const LiveInterval& b) { return a.start < b.start; };
+    std::stable_sort(intervals.begin(), intervals.end(), by_start);
+
+    // Active intervals, ordered by end position.
+    std::vector<const LiveInterval*> active;
+    std::vector<std::vector<bool>> busy(classes.size(), std::vector<bool>(32, false));
+    auto spill = [&](ValueId v) {
+        out.reg[v] = -1;
+        out.slot[v] = static_cast<std::int32_t>(out.spill_slots++);
+    };
+    auto activate = [&](const LiveInterval& interval) {
+        auto at = std::upper_bound(active.begin(), active.end(), interval.end,
+                                   [](std::uint32_t end, const LiveInterval* a) {
+                                       return end < a->end;
+                                   });
+        active.insert(at, &interval);
+    };
+
+    for (const LiveInterval& current : intervals) {
+        // Expire the intervals that ended before this one starts.
+        std::size_t expired = 0;
+        while (expired < active.size() && active[expired]->end < current.start) {
+            const LiveInterval* old = active[expired++];
+            busy[old->reg_class][static_cast<std::size_t>(out.reg[old->value])] = false;
+        }
+        active.erase(active.begin(), active.begin() + static_cast<std::ptrdiff_t>(expired));
+
+        const RegisterClass& cls = classes[current.reg_class];
+        auto usable = [&](std::uint8_t reg) {
+            return !current.crosses_call || (cls.callee_saved >> reg & 1) != 0;
+        };
+        int chosen = -1;
+        for (std::uint8_t reg : cls.registers) {
+            if (usable(reg) && !busy[current.reg_class][reg]) {
+                chosen = reg;
+                break;
+            }
+        }
+        if (chosen >= 0) {
+            busy[current.reg_class][static_cast<std::size_t>(chosen)] = true;
+            out.reg[current.value] = chosen;
+            activate(current);
+            continue;
+        }
+        // Steal the register of the active interval that ends last, if that
+        // is later than this one.
+        auto victim = active.end();
+        for (auto it = active.begin(); it != active.end(); ++it) {
+            const LiveInterval& other = **it;
+            if (other.reg_class == current.reg_class &&
+                usable(static_cast<std::uint8_t>(out.reg[other.value])) &&
+                (victim == active.end() || other.end >= (*victim)->end)) {
+                victim = it;
+            }
+        }
+        if (victim != active.end() && (*victim)->end > current.end) {
+            out.reg[current.value] = out.reg[(*victim)->value];
+            spill((*victim)->value);
+            active.erase(victim);
+            activate(current);
+        } else {
+            spill(current.value);
+        }
+    }
+    return out;
+}
+
+}  // namespace pallas::backend
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+#include "middle/passes.h"
+
+namespace pallas::backend {
+
+constexpr std::uint8_t kNoRegClass = 0xff;
+
+// Numbering of a function's code for register allocation. Blocks follow
+// reverse postorder; each block gets a position on entry (where its phis are
+// defined), two per instruction, and one on exit (where the moves of its
+// outgoing edges go). Arguments are defined at position 0.
+struct CodePositions {
+    std::vector<std::uint32_t> value;        // per instruction; phis: their block's entry
+    std::vector<std::uint32_t> block_start;  // per block
+    std::vector<std::uint32_t> block_end;
+};
+
+// The positions where one value is live, as a single range from its
+// definition to its last use (uses on loop back edges included). A phi's
+// range starts at the end of its earliest predecessor, where it is first
+// written.
+struct LiveInterval {
+    middle::ValueId value = middle::kNoValue;
+    std::uint32_t start = 0;
+    std::uint32_t end = 0;
+    std::uint8_t reg_class = 0;
+    // Live across an instruction that clobbers the caller-saved registers.
+    bool crosses_call = false;
+};
+
+struct RegisterClass {
+    // Allocatable registers in order of preference.
+    std::vector<std::uint8_t> registers;
+    // Bit r is set when register r survives calls.
+    std::uint32_t callee_saved = 0;
+};
+
+struct RegisterAssignment {
+    // Per value: the register, or -1 for values in a spill slot or without an interval.
+    std::vector<int> reg;
+    // Per value: the spill slot, or -1.
+    std::vector<std::int32_t> slot;
+    std::uint32_t spill_slots = 0;
+};
+
+// Intervals for the values with a register class (`reg_class[v]` is
+// kNoRegClass for the others); `clobbers[v]` marks calls. Positions follow
+// `order`, the reachable blocks as they will be emitted, each after its
+// immediate dominator.
+std::vector<LiveInterval> build_intervals(const middle::Function& fn, const middle::CFGInfo& cfg,
+                                          const std::vector<middle::BlockId>& order,
+                                          const std::vector<std::uint8_t>& reg_class,
+                                          const std::vector<bool>& clobbers,
+                                          CodePositions* positions);
+
+// Linear-scan allocation (Poletto and Sarkar): intervals are visited by start
+// position and take a free register of their class, a callee-saved one if
+// they cross a call. When none is free, whichever of the new interval and the
+// active ones ends last is spilled for its whole lifetime. An interval that
+// ends where another starts keeps its register until then, so an
+// instruction's result never shares a register with its operands.
+RegisterAssignment linear_scan(std::vector<LiveInterval> intervals,
+                               std::span<const RegisterClass> classes, std::size_t num_values);
+
+}  // namespace pallas::backend
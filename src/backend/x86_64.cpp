@@ -0,0 +1,1373 @@
+#include "x86_64.h"
+#include <algorithm>
+#include <bit>
+#include <map>
+#include <optional>
+#include <vector>
+#include "elf.h"
+#include "middle/parallel.h"
+#include "middle/passes.h"
+#include "middle/profile.h"
+#include "regalloc.h"
+#include "support/trace.h"
+#include "x86_asm.h"
+
+namespace pallas::backend {
+
+using middle::BlockId;
+using middle::CmpPredicate;
+using middle::Function;
+using middle::Inst;
+using middle::IRType;
+using middle::IRTypeKind;
+using middle::kNoValue;
+using middle::Opcode;
+using middle::SymbolId;
+using middle::ValueId;
+using namespace x86;
+
+namespace {
+
+constexpr std::uint8_t kIntClass = 0;
+constexpr std::uint8_t kFloatClass = 1;
+
+// Scratch registers, never allocated: rax, rcx, rdx and r11 for integers (rax
+// also carries results and copies between stack slots, r11 breaks cycles of
+// moves), xmm14 and xmm15 for floats.
+constexpr Reg kCycleTemp = R11;
+constexpr Xmm kFloatCycleTemp = XMM14;
+
+constexpr Reg kIntArgs[] = {RDI, RSI, RDX, RCX, R8, R9};
+constexpr std::size_t kFloatArgs = 8;
+
+const RegisterClass kClasses[] = {
+    // Caller-saved registers first, so that callee-saved ones, which cost a
+    // push and a pop, are only used for values that live across calls.
+    {{RSI, RDI, R8, R9, R10, RBX, R12, R13, R14, R15},
+     1u << RBX | 1u << R12 | 1u << R13 | 1u << R14 | 1u << R15},
+    {{XMM0, XMM1, XMM2, XMM3, XMM4, XMM5, XMM6, XMM7, XMM8, XMM9, XMM10, XMM11, XMM12, XMM13},
+     0},
+};
+
+// Where a value lives between instructions.
+struct Location {
+    enum Kind : std::uint8_t { LOC_NONE, LOC_GPR, LOC_XMM, LOC_STACK };
+    Kind kind = LOC_NONE;
+    std::uint8_t reg = 0;
+    std::int32_t offset = 0;  // from rbp
+    bool operator==(const Location&) const = default;
+};
+
+Location gpr(Reg reg) {
+    return {Location::LOC_GPR, reg, 0};
+}
+
+Location xmm(Xmm reg) {
+    return {Location::LOC_XMM, reg, 0};
+}
+
+Location stack(std::int32_t offset) {
+    return {Location::LOC_STACK, 0, offset};
+}
+
+struct Move {
+    Location dst;
+    Location src;
+    bool fp = false;
+};
+
+bool is_fp(IRType type) {
+    return type.kind == IRTypeKind::IR_F32 || type.kind == IRTypeKind::IR_F64;
+}
+
+bool is_double(IRType type) {
+    return type.kind == IRTypeKind::IR_F64;
+}
+
+// Values with no location of their own: materialized at every use.
+bool is_rematerialized(Opcode op) {
+    return op == Opcode::OP_CONST || op == Opcode::OP_UNDEF || op == Opcode::OP_GLOBAL ||
+           op == Opcode::OP_ALLOCA;
+}
+
+std::uint64_t mask_to(std::uint64_t bits, unsigned width) {
+    return width >= 64 ? bits : bits & ((std::uint64_t{1} << width) - 1);
+}
+
+std::int64_t sign_extend(std::uint64_t bits, unsigned width) {
+    if (width >= 64) {
+        return static_cast<std::int64_t>(bits);
+    }
+    unsigned shift = 64 - width;
+    return static_cast<std::int64_t>(bits << shift) >> shift;
+}
+
+bool fits_int32(std::int64_t value) {
+    return value >= INT32_MIN && value <= INT32_MAX;
+}
+
+bool is_signed(CmpPredicate pred) {
+    return pred == CmpPredicate::CMP_SLT || pred == CmpPredicate::CMP_SLE ||
+           pred == CmpPredicate::CMP_SGT || pred == CmpPredicate::CMP_SGE;
+}
+
+Cond condition(CmpPredicate pred) {
+    switch (pred) {
+        case CmpPredicate::CMP_EQ: return COND_E;
+        case CmpPredicate::CMP_NE: return COND_NE;
+        case CmpPredicate::CMP_SLT: return COND_L;
+        case CmpPredicate::CMP_SLE: return COND_LE;
+        case CmpPredicate::CMP_SGT: return COND_G;
+        case CmpPredicate::CMP_SGE: return COND_GE;
+        case CmpPredicate::CMP_ULT: return COND_B;
+        case CmpPredicate::CMP_ULE: return COND_BE;
+        case CmpPredicate::CMP_UGT: return COND_A;
+        default: return COND_AE;
+    }
+}
+
+// Stack slots are whole words, so that zeroing them needs no byte stores.
+std::uint64_t slot_size(const Function& fn, ValueId alloca) {
+    return (std::max<std::uint64_t>(fn.inst(alloca).imm, 1) + 7) / 8 * 8;
+}
+
+// Where the values of a function live and how large its frame is. Planning a
+// frame reads nothing but the function, so the frames of a module are planned
+// in parallel and the functions then emitted one after another.
+struct Frame {
+    std::vector<BlockId> order;  // reverse postorder, the blocks the profile shows cold last
+    std::vector<Location> locations;
+    std::vector<std::int32_t> alloca_offsets;
+    std::vector<bool> fused;  // compares emitted by the branch that uses them
+    std::vector<Reg> saved;   // callee-saved registers pushed by the prologue
+    std::int32_t bytes = 0;   // below the saved registers
+    std::string error;
+};
+
+// Assigns registers and lays out the frame of one function.
+class FramePlanner {
+  public:
+    explicit FramePlanner(const Function& fn) : fn(fn) {}
+
+    Frame plan() {
+        middle::CFGInfo cfg(fn);
+        frame.order = middle::code_layout(fn, cfg);
+        allocate(cfg);
+        return std::move(frame);
+    }
+
+  private:
+    const Function& fn;
+    Frame frame;
+
+    bool fail(const std::string& msg) {
+        if (frame.error.empty()) {
+            frame.error = msg;
+        }
+        return false;
+    }
+
+    bool supported(IRType t) {
+        if (t.is_vector()) {
+            return fail("vector operations in '@" + fn.name +
+                        "' are not supported by the x86-64 backend; run the scalarize pass");
+        }
+        if (t.kind == IRTypeKind::IR_I128) {
+            return fail("i128 in '@" + fn.name + "' is not supported by the x86-64 backend");
+        }
+        return true;
+    }
+
+    bool can_fuse(ValueId v) const {
+        const Inst& i = fn.inst(v);
+        if (i.op != Opcode::OP_ICMP || i.next == kNoValue || fn.count_uses(v) != 1) {
+            return false;
+        }
+        const Inst& user = fn.inst(i.next);
+        return user.op == Opcode::OP_COND_BR && fn.operand(i.next, 0) == v;
+    }
+
+    bool allocate(const middle::CFGInfo& cfg) {
+        std::size_t n = fn.num_values();
+        std::vector<std::uint8_t> reg_class(n, kNoRegClass);
+        std::vector<bool> clobbers(n, false);
+        frame.fused.assign(n, false);
+        for (ValueId v = 0; v < n; ++v) {
+            const Inst& i = fn.inst(v);
+            bool placed = i.op == Opcode::OP_ARG || i.block != middle::kNoBlock;
+            if (!placed) {
+                continue;
+            }
+            for (std::uint32_t k = 0; k < i.num_operands; ++k) {
+                if (!supported(fn.inst(fn.operand(v, k)).type)) {
+                    return false;
+                }
+            }
+            if (!supported(i.type)) {
+                return false;
+            }
+            clobbers[v] = i.op == Opcode::OP_CALL || i.op == Opcode::OP_NEW ||
+                          i.op == Opcode::OP_DELETE || i.op == Opcode::OP_FREM;
+            frame.fused[v] = can_fuse(v);
+            if (i.type.kind == IRTypeKind::IR_VOID || i.op == Opcode::OP_ALLOCA ||
+                frame.fused[v]) {
+                continue;
+            }
+            reg_class[v] = is_fp(i.type) ? kFloatClass : kIntClass;
+        }
+        CodePositions positions;
+        std::vector<LiveInterval> intervals =
+            build_intervals(fn, cfg, frame.order, reg_class, clobbers, &positions);
+        RegisterAssignment assignment = linear_scan(std::move(intervals), kClasses, n);
+
+        std::uint32_t used = 0;
+        for (ValueId v = 0; v < n; ++v) {
+            if (reg_class[v] == kIntClass && assignment.reg[v] >= 0) {
+                used |= 1u << assignment.reg[v];
+            }
+        }
+        for (Reg reg : {RBX, R12, R13, R14, R15}) {
+            if ((used >> reg & 1) != 0) {
+                frame.saved.push_back(reg);
+            }
+        }
+        // Below the saved registers: spill slots, then stack slots.
+        auto saved_bytes = static_cast<std::int32_t>(8 * frame.saved.size());
+        frame.locations.assign(n, Location{});
+        for (ValueId v = 0; v < n; ++v) {
+            if (assignment.reg[v] >= 0) {
+                auto reg = static_cast<std::uint8_t>(assignment.reg[v]);
+                frame.locations[v] = reg_class[v] == kFloatClass ? xmm(static_cast<Xmm>(reg))
+                                                                 : gpr(static_cast<Reg>(reg));
+            } else if (assignment.slot[v] >= 0) {
+                frame.locations[v] = stack(-(saved_bytes + 8 * (assignment.slot[v] + 1)));
+            }
+        }
+        std::int64_t depth = saved_bytes + 8 * static_cast<std::int64_t>(assignment.spill_slots);
+        frame.alloca_offsets.assign(n, 0);
+        for (BlockId b : cfg.rpo()) {
+            for (ValueId v = fn.block(b).first; v != kNoValue; v = fn.inst(v).next) {
+                if (fn.inst(v).op != Opcode::OP_ALLOCA) {
+                    continue;
+                }
+                std::int64_t align = std::clamp<std::int64_t>(fn.inst(v).aux, 8, 16);
+                depth += static_cast<std::int64_t>(slot_size(fn, v));
+                depth = (depth + align - 1) / align * align;
+                frame.alloca_offsets[v] = static_cast<std::int32_t>(-depth);
+            }
+        }
+        if (depth > INT32_MAX / 2) {
+            return fail("stack frame of '@" + fn.name + "' is too large");
+        }
+        frame.bytes = static_cast<std::int32_t>((depth + 15) / 16 * 16) - saved_bytes;
+        return true;
+    }
+};
+
+// Compiles a module function by function into one object.
+class Compiler {
+  public:
+    Compiler(const middle::Module& source, unsigned threads)
+        : source(source), threads(threads), as(object) {}
+
+    std::string compile(std::string* error_out) {
+        support::TraceScope trace("x86-codegen");
+        for (const middle::Global& global : source.globals) {
+            bool constant = global.constant;
+            std::vector<std::uint8_t>& section = constant ? object.rodata : object.data;
+            section.resize((section.size() + 15) / 16 * 16, 0);
+            std::uint64_t at = section.size();
+            section.insert(section.end(), global.bytes.begin(), global.bytes.end());
+            object.define(object.symbol(source.symbol_name(global.symbol)),
+                          constant ? ObjectSection::SECTION_RODATA : ObjectSection::SECTION_DATA,
+                          at, global.bytes.size(), false, false);
+        }
+        // Float constants are addressed relative to the start of .rodata.
+        pool_symbol = object.symbol("pallas.rodata");
+        object.define(pool_symbol, ObjectSection::SECTION_RODATA, 0, 0, false, false);
+        std::vector<const Function*> functions;
+        for (const auto& f : source.functions) {
+            if ((f->flags & middle::FUNCTION_EXTERN) == 0 && f->entry() != middle::kNoBlock) {
+                functions.push_back(f.get());
+            }
+        }
+        std::vector<Frame> frames(functions.size());
+        middle::parallel_for(functions.size(), middle::thread_count(threads),
+                             [&](std::size_t index, unsigned) {
+                                 const Function& f = *functions[index];
+                                 support::TraceScope frame_trace("x86-frame", f.name);
+                                 frame_trace.set_items(f.instruction_count());
+                                 frames[index] = FramePlanner(f).plan();
+                             });
+        std::size_t instructions = 0;
+        for (std::size_t index = 0; index < functions.size(); ++index) {
+            const Function& f = *functions[index];
+            support::TraceScope function_trace("x86-function", f.name);
+            function_trace.set_items(f.instruction_count());
+            instructions += f.instruction_count();
+            if (!compile_function(f, std::move(frames[index]))) {
+                break;
+            }
+        }
+        trace.set_items(instructions);
+        if (!error.empty()) {
+            *error_out = error;
+            return {};
+        }
+        return object.serialize();
+    }
+
+  private:
+    const middle::Module& source;
+    unsigned threads;
+    ObjectFile object;
+    Assembler as;
+    std::uint32_t pool_symbol = 0;
+    std::map<std::pair<std::uint64_t, bool>, std::int32_t> pool;
+    std::string error;
+
+    // State of the function being compiled.
+    const Function* fn = nullptr;
+    std::vector<Location> locations;
+    std::vector<std::int32_t> alloca_offsets;
+    std::vector<bool> fused;  // compares emitted by the branch that uses them
+    std::vector<Label> labels;
+    std::vector<Reg> saved;   // callee-saved registers pushed by the prologue
+    std::int32_t frame_bytes = 0;
+    BlockId next_block = middle::kNoBlock;
+    struct BoundsFailure {
+        Label label;
+        ValueId index;
+        ValueId length;
+    };
+    std::vector<BoundsFailure> failures;
+
+    bool fail(const std::string& msg) {
+        if (error.empty()) {
+            error = msg;
+        }
+        return false;
+    }
+
+    const Inst& inst(ValueId v) const { return fn->inst(v); }
+    IRType type(ValueId v) const { return fn->inst(v).type; }
+    unsigned bits(ValueId v) const { return middle::type_bits(type(v)); }
+
+    bool supported(IRType t) {
+        if (t.is_vector()) {
+            return fail("vector operations in '@" + fn->name +
+                        "' are not supported by the x86-64 backend; run the scalarize pass");
+        }
+        if (t.kind == IRTypeKind::IR_I128) {
+            return fail("i128 in '@" + fn->name + "' is not supported by the x86-64 backend");
+        }
+        return true;
+    }
+
+    // ---- Operands ----
+
+    std::int32_t constant_offset(std::uint64_t double_bits, bool dbl) {
+        auto [it, added] = pool.emplace(std::make_pair(double_bits, dbl), 0);
+        if (added) {
+            std::vector<std::uint8_t>& data = object.rodata;
+            std::size_t size = dbl ? 8 : 4;
+            data.resize((data.size() + size - 1) / size * size, 0);
+            it->second = static_cast<std::int32_t>(data.size());
+            std::uint64_t raw = double_bits;
+            if (!dbl) {
+                raw = std::bit_cast<std::uint32_t>(
+                    static_cast<float>(std::bit_cast<double>(double_bits)));
+            }
+            for (std::size_t i = 0; i < size; ++i) {
+                data.push_back(static_cast<std::uint8_t>(raw >> (8 * i)));
+            }
+        }
+        return it->second;
+    }
+
+    void load_constant(Xmm dst, double value, bool dbl) {
+        as.load_sse_symbol(dst, pool_symbol,
+                           constant_offset(std::bit_cast<std::uint64_t>(value), dbl), dbl);
+    }
+
+    void address_of(Reg dst, SymbolId symbol) {
+        const std::string& name = source.symbol_name(symbol);
+        if (source.find_global(symbol) != nullptr) {
+            as.lea_symbol(dst, object.symbol(name));
+            return;
+        }
+        const Function* target = source.function_for(symbol);
+        if (target == nullptr) {
+            fail("reference to unknown symbol '@" + name + "'");
+            return;
+        }
+        if ((target->flags & middle::FUNCTION_EXTERN) == 0 && target->entry() != middle::kNoBlock) {
+            as.lea_symbol(dst, object.symbol(name));
+        } else {
+            as.load_got(dst, object.symbol(name));  // may live in a shared library
+        }
+    }
+
+    void load_int(Reg dst, ValueId v) {
+        const Inst& i = inst(v);
+        switch (i.op) {
+            case Opcode::OP_CONST: as.mov_imm(dst, mask_to(i.imm, bits(v))); return;
+            case Opcode::OP_UNDEF: as.mov_imm(dst, 0); return;
+            case Opcode::OP_GLOBAL: address_of(dst, i.aux); return;
+            case Opcode::OP_ALLOCA: as.lea(dst, Mem{RBP, alloca_offsets[v]}); return;
+            default: break;
+        }
+        const Location& at = locations[v];
+        if (at.kind == Location::LOC_GPR) {
+            if (at.reg != dst) {
+                as.mov(dst, static_cast<Reg>(at.reg));
+            }
+        } else if (at.kind == Location::LOC_STACK) {
+            as.load(dst, Mem{RBP, at.offset}, 8);
+        } else {
+            fail("use of %" + std::to_string(v) + " without a location in '@" + fn->name + "'");
+        }
+    }
+
+    // The register holding an integer operand: its own, or `scratch`.
+    Reg int_operand(ValueId v, Reg scratch) {
+        if (!is_rematerialized(inst(v).op) && locations[v].kind == Location::LOC_GPR) {
+            return static_cast<Reg>(locations[v].reg);
+        }
+        load_int(scratch, v);
+        return scratch;
+    }
+
+    void load_float(Xmm dst, ValueId v) {
+        const Inst& i = inst(v);
+        if (i.op == Opcode::OP_CONST) {
+            as.load_sse_symbol(dst, pool_symbol, constant_offset(i.imm, is_double(i.type)),
+                               is_double(i.type));
+            return;
+        }
+        if (i.op == Opcode::OP_UNDEF) {
+            as.xorps(dst, dst);
+            return;
+        }
+        const Location& at = locations[v];
+        if (at.kind == Location::LOC_XMM) {
+            if (at.reg != dst) {
+                as.movs(dst, static_cast<Xmm>(at.reg));
+            }
+        } else if (at.kind == Location::LOC_STACK) {
+            as.load_sse(dst, Mem{RBP, at.offset}, true);
+        } else {
+            fail("use of %" + std::to_string(v) + " without a location in '@" + fn->name + "'");
+        }
+    }
+
+    Xmm float_operand(ValueId v, Xmm scratch) {
+        if (inst(v).op != Opcode::OP_CONST && locations[v].kind == Location::LOC_XMM) {
+            return static_cast<Xmm>(locations[v].reg);
+        }
+        load_float(scratch, v);
+        return scratch;
+    }
+
+    // Results are computed in their register, or in rax / xmm15 and stored to
+    // their spill slot by finish_*.
+    Reg target(ValueId v) const {
+        return locations[v].kind == Location::LOC_GPR ? static_cast<Reg>(locations[v].reg) : RAX;
+    }
+
+    Xmm float_target(ValueId v) const {
+        return locations[v].kind == Location::LOC_XMM ? static_cast<Xmm>(locations[v].reg) : XMM15;
+    }
+
+    void finish_int(ValueId v, Reg result) {
+        const Location& at = locations[v];
+        if (at.kind == Location::LOC_STACK) {
+            as.store(Mem{RBP, at.offset}, result, 8);
+        } else if (at.kind == Location::LOC_GPR && at.reg != result) {
+            as.mov(static_cast<Reg>(at.reg), result);
+        }
+    }
+
+    void finish_float(ValueId v, Xmm result) {
+        const Location& at = locations[v];
+        if (at.kind == Location::LOC_STACK) {
+            as.store_sse(Mem{RBP, at.offset}, result, true);
+        } else if (at.kind == Location::LOC_XMM && at.reg != result) {
+            as.movs(static_cast<Xmm>(at.reg), result);
+        }
+    }
+
+    // Integers are kept zero-extended to 64 bits.
+    void normalize(Reg r, unsigned width) {
+        switch (width) {
+            case 1: as.alu_imm(ALU_AND, r, 1, false); break;
+            case 8: as.extend(r, r, 1, false); break;
+            case 16: as.extend(r, r, 2, false); break;
+            case 32: as.mov(r, r, false); break;
+            default: break;
+        }
+    }
+
+    void sign_extend_in_place(Reg r, unsigned width) {
+        switch (width) {
+            case 1: as.neg(r); break;
+            case 8: as.extend(r, r, 1, true); break;
+            case 16: as.extend(r, r, 2, true); break;
+            case 32: as.extend(r, r, 4, true); break;
+            default: break;
+        }
+    }
+
+    // An immediate for an arithmetic operand: only the low `width` bits of the
+    // result matter, so narrow constants always fit.
+    std::optional<std::int32_t> immediate(ValueId v) const {
+        const Inst& i = inst(v);
+        if (i.op != Opcode::OP_CONST) {
+            return std::nullopt;
+        }
+        std::uint64_t value = mask_to(i.imm, bits(v));
+        if (bits(v) <= 32) {
+            return static_cast<std::int32_t>(static_cast<std::uint32_t>(value));
+        }
+        if (fits_int32(static_cast<std::int64_t>(value))) {
+            return static_cast<std::int32_t>(value);
+        }
+        return std::nullopt;
+    }
+
+    Mem address(ValueId pointer) {
+        if (inst(pointer).op == Opcode::OP_ALLOCA) {
+            return Mem{RBP, alloca_offsets[pointer]};
+        }
+        return Mem{int_operand(pointer, R11), 0};
+    }
+
+    // ---- Moves ----
+
+    void emit_move(const Move& m) {
+        using K = Location::Kind;
+        if (m.dst.kind == K::LOC_STACK && m.src.kind == K::LOC_STACK) {
+            as.load(RAX, Mem{RBP, m.src.offset}, 8);
+            as.store(Mem{RBP, m.dst.offset}, RAX, 8);
+        } else if (m.dst.kind == K::LOC_STACK) {
+            if (m.src.kind == K::LOC_XMM) {
+                as.store_sse(Mem{RBP, m.dst.offset}, static_cast<Xmm>(m.src.reg), true);
+            } else {
+                as.store(Mem{RBP, m.dst.offset}, static_cast<Reg>(m.src.reg), 8);
+            }
+        } else if (m.src.kind == K::LOC_STACK) {
+            if (m.dst.kind == K::LOC_XMM) {
+                as.load_sse(static_cast<Xmm>(m.dst.reg), Mem{RBP, m.src.offset}, true);
+            } else {
+                as.load(static_cast<Reg>(m.dst.reg), Mem{RBP, m.src.offset}, 8);
+            }
+        } else if (m.dst.kind == K::LOC_XMM) {
+            as.movs(static_cast<Xmm>(m.dst.reg), static_cast<Xmm>(m.src.reg));
+        } else {
+            as.mov(static_cast<Reg>(m.dst.reg), static_cast<Reg>(m.src.reg));
+        }
+    }
+
+    // Performs the moves as if in parallel: a move waits until no other one
+    // still reads its destination, and a cycle is broken by copying one
+    // destination to a temporary.
+    void resolve(std::vector<Move> moves) {
+        std::erase_if(moves, [](const Move& m) { return m.dst == m.src; });
+        while (!moves.empty()) {
+            auto ready = std::find_if(moves.begin(), moves.end(), [&](const Move& m) {
+                return std::none_of(moves.begin(), moves.end(),
+                                    [&](const Move& other) { return other.src == m.dst; });
+            });
+            if (ready != moves.end()) {
+                emit_move(*ready);
+                moves.erase(ready);
+                continue;
+            }
+            Location blocked = moves.front().dst;
+            Location temp = moves.front().fp ? xmm(kFloatCycleTemp) : gpr(kCycleTemp);
+            emit_move({temp, blocked, moves.front().fp});
+            for (Move& m : moves) {
+                if (m.src == blocked) {
+                    m.src = temp;
+                }
+            }
+        }
+    }
+
+    // Materializes `v` (a constant, address or undef) into a location.
+    void materialize(const Location& dst, ValueId v) {
+        if (is_fp(type(v))) {
+            Xmm reg = dst.kind == Location::LOC_XMM ? static_cast<Xmm>(dst.reg) : XMM15;
+            load_float(reg, v);
+            if (dst.kind == Location::LOC_STACK) {
+                as.store_sse(Mem{RBP, dst.offset}, reg, true);
+            }
+            return;
+        }
+        Reg reg = dst.kind == Location::LOC_GPR ? static_cast<Reg>(dst.reg) : RAX;
+        load_int(reg, v);
+        if (dst.kind == Location::LOC_STACK) {
+            as.store(Mem{RBP, dst.offset}, reg, 8);
+        }
+    }
+
+    // Copies the values flowing into the successor's phis along one edge.
+    void edge_moves(BlockId from, BlockId to) {
+        std::vector<Move> moves;
+        std::vector<std::pair<Location, ValueId>> late;
+        for (ValueId phi = fn->block(to).first; phi != kNoValue && inst(phi).op == Opcode::OP_PHI;
+             phi = inst(phi).next) {
+            std::span<const BlockId> incoming = fn->targets(phi);
+            auto entry = std::find(incoming.begin(), incoming.end(), from);
+            if (entry == incoming.end() || locations[phi].kind == Location::LOC_NONE) {
+                continue;
+            }
+            ValueId value = fn->operand(phi, static_cast<std::uint32_t>(entry - incoming.begin()));
+            if (is_rematerialized(inst(value).op)) {
+                late.emplace_back(locations[phi], value);
+            } else {
+                moves.push_back({locations[phi], locations[value], is_fp(type(phi))});
+            }
+        }
+        resolve(std::move(moves));
+        for (const auto& [dst, value] : late) {
+            materialize(dst, value);
+        }
+    }
+
+    bool has_phis(BlockId b) const {
+        ValueId first = fn->block(b).first;
+        return first != kNoValue && inst(first).op == Opcode::OP_PHI;
+    }
+
+    void jump(BlockId to) {
+        if (to != next_block) {
+            as.jmp(labels[to]);
+        }
+    }
+
+    // ---- Calls ----
+
+    // Calls `symbol` with the System V calling convention and stores the
+    // result into `result`, if any.
+    void call(std::uint32_t symbol, const std::vector<ValueId>& args, ValueId result,
+              bool variadic) {
+        std::vector<Move> moves;
+        std::vector<std::pair<Location, ValueId>> late;
+        std::vector<ValueId> on_stack;
+        std::size_t ints = 0;
+        std::size_t floats = 0;
+        for (ValueId arg : args) {
+            Location dst;
+            if (is_fp(type(arg)) && floats < kFloatArgs) {
+                dst = xmm(static_cast<Xmm>(floats++));
+            } else if (!is_fp(type(arg)) && ints < std::size(kIntArgs)) {
+                dst = gpr(kIntArgs[ints++]);
+            } else {
+                on_stack.push_back(arg);
+                continue;
+            }
+            if (is_rematerialized(inst(arg).op)) {
+                late.emplace_back(dst, arg);
+            } else {
+                moves.push_back({dst, locations[arg], is_fp(type(arg))});
+            }
+        }
+        // The stack stays 16-byte aligned at the call.
+        auto stack_bytes = static_cast<std::int32_t>(8 * (on_stack.size() + on_stack.size() % 2));
+        if (on_stack.size() % 2 != 0) {
+            as.alu_imm(ALU_SUB, RSP, 8);
+        }
+        for (auto it = on_stack.rbegin(); it != on_stack.rend(); ++it) {
+            if (is_fp(type(*it))) {
+                as.movq_from_xmm(RAX, float_operand(*it, XMM15));
+            } else {
+                load_int(RAX, *it);
+            }
+            as.push(RAX);
+        }
+        resolve(std::move(moves));
+        for (const auto& [dst, value] : late) {
+            materialize(dst, value);
+        }
+        if (variadic) {
+            as.mov_imm(RAX, floats);  // vector registers used, for varargs callees
+        }
+        as.call(symbol);
+        if (stack_bytes != 0) {
+            as.alu_imm(ALU_ADD, RSP, stack_bytes);
+        }
+        if (result == kNoValue || type(result).kind == IRTypeKind::IR_VOID) {
+            return;
+        }
+        if (is_fp(type(result))) {
+            finish_float(result, XMM0);
+        } else {
+            // C callees leave the upper bits of narrow results undefined.
+            normalize(RAX, bits(result));
+            finish_int(result, RAX);
+        }
+    }
+
+    // ---- Instructions ----
+
+    bool compile_function(const Function& f, Frame frame) {
+        fn = &f;
+        if (!frame.error.empty()) {
+            return fail(frame.error);
+        }
+        const std::vector<BlockId>& order = frame.order;
+        locations = std::move(frame.locations);
+        alloca_offsets = std::move(frame.alloca_offsets);
+        fused = std::move(frame.fused);
+        saved = std::move(frame.saved);
+        frame_bytes = frame.bytes;
+        labels.assign(f.num_blocks(), 0);
+        for (BlockId b : order) {
+            labels[b] = as.new_label();
+        }
+        failures.clear();
+        while (object.text.size() % 16 != 0) {
+            object.text.push_back(0xcc);
+        }
+        std::uint64_t start = as.offset();
+        as.push(RBP);
+        as.mov(RBP, RSP);
+        for (Reg reg : saved) {
+            as.push(reg);
+        }
+        if (frame_bytes != 0) {
+            as.alu_imm(ALU_SUB, RSP, frame_bytes);
+        }
+        move_arguments();
+
+        for (std::size_t i = 0; i < order.size() && error.empty(); ++i) {
+            BlockId b = order[i];
+            next_block = i + 1 < order.size() ? order[i + 1] : middle::kNoBlock;
+            as.bind(labels[b]);
+            for (ValueId v = f.block(b).first; v != kNoValue && error.empty(); v = inst(v).next) {
+                emit(v, b);
+            }
+        }
+        // Failed bounds checks jump here, out of the hot path.
+        for (const BoundsFailure& failure : failures) {
+            as.bind(failure.label);
+            load_int(RAX, failure.index);
+            load_int(RCX, failure.length);
+            as.mov(RDI, RAX);
+            as.mov(RSI, RCX);
+            as.call(object.symbol("pallas_bounds_fail"));
+            as.ud2();
+        }
+        as.finish();
+        bool helper = f.name.starts_with("pallas.") || (f.flags & middle::FUNCTION_INTERNAL) != 0;
+        object.define(object.symbol(f.name), ObjectSection::SECTION_TEXT, start,
+                      as.offset() - start, !helper, true);
+        return error.empty();
+    }
+
+    void move_arguments() {
+        std::vector<Move> moves;
+        std::size_t ints = 0;
+        std::size_t floats = 0;
+        std::int32_t stack_offset = 16;  // above the saved rbp and the return address
+        for (std::size_t i = 0; i < fn->num_args(); ++i) {
+            ValueId arg = fn->arg(i);
+            bool fp = is_fp(type(arg));
+            Location src;
+            if (fp && floats < kFloatArgs) {
+                src = xmm(static_cast<Xmm>(floats++));
+            } else if (!fp && ints < std::size(kIntArgs)) {
+                src = gpr(kIntArgs[ints++]);
+            } else {
+                src = stack(stack_offset);
+                stack_offset += 8;
+            }
+            if (locations[arg].kind != Location::LOC_NONE) {
+                moves.push_back({locations[arg], src, fp});
+            }
+        }
+        resolve(std::move(moves));
+        // Arguments from C callers may carry garbage above their width.
+        for (std::size_t i = 0; i < fn->num_args(); ++i) {
+            ValueId arg = fn->arg(i);
+            if (!is_fp(type(arg)) && bits(arg) < 64 && locations[arg].kind != Location::LOC_NONE) {
+                Reg reg = target(arg);
+                load_int(reg, arg);
+                normalize(reg, bits(arg));
+                finish_int(arg, reg);
+            }
+        }
+    }
+
+    void epilogue() {
+        if (saved.empty()) {
+            as.mov(RSP, RBP);
+        } else {
+            as.lea(RSP, Mem{RBP, -static_cast<std::int32_t>(8 * saved.size())});
+            for (auto it = saved.rbegin(); it != saved.rend(); ++it) {
+                as.pop(*it);
+            }
+        }
+        as.pop(RBP);
+        as.ret();
+    }
+
+    // Sets the flags for an integer comparison and returns the condition
+    // that holds when it is true.
+    Cond compare(ValueId v) {
+        auto pred = static_cast<CmpPredicate>(inst(v).aux);
+        ValueId a = fn->operand(v, 0);
+        ValueId b = fn->operand(v, 1);
+        unsigned width = bits(a);
+        if (is_signed(pred) && width < 64) {
+            load_int(RAX, a);
+            sign_extend_in_place(RAX, width);
+            if (inst(b).op == Opcode::OP_CONST) {
+                std::int64_t value = sign_extend(inst(b).imm, width);
+                if (fits_int32(value)) {
+                    as.alu_imm(ALU_CMP, RAX, static_cast<std::int32_t>(value));
+                    return condition(pred);
+                }
+            }
+            load_int(RCX, b);
+            sign_extend_in_place(RCX, width);
+            as.alu(ALU_CMP, RAX, RCX);
+            return condition(pred);
+        }
+        Reg ra = int_operand(a, RAX);
+        if (inst(b).op == Opcode::OP_CONST) {
+            // The immediate is sign-extended, the operand zero-extended.
+            std::uint64_t value = mask_to(inst(b).imm, width);
+            bool fits = is_signed(pred) ? fits_int32(static_cast<std::int64_t>(value))
+                                        : value <= static_cast<std::uint64_t>(INT32_MAX);
+            if (fits) {
+                as.alu_imm(ALU_CMP, ra, static_cast<std::int32_t>(value));
+                return condition(pred);
+            }
+        }
+        as.alu(ALU_CMP, ra, int_operand(b, RCX));
+        return condition(pred);
+    }
+
+    void emit_float_compare(ValueId v) {
+        auto pred = static_cast<CmpPredicate>(inst(v).aux);
+        ValueId a = fn->operand(v, 0);
+        ValueId b = fn->operand(v, 1);
+        bool dbl = is_double(type(a));
+        Xmm xa = float_operand(a, XMM15);
+        Xmm xb = float_operand(b, XMM14);
+        Reg t = target(v);
+        // Unordered operands set ZF, PF and CF: `above` conditions are false
+        // for them, and so is `not equal`, but `equal` needs a parity check.
+        switch (pred) {
+            case CmpPredicate::CMP_OEQ:
+                as.ucomi(xa, xb, dbl);
+                as.setcc(COND_E, t);
+                as.setcc(COND_NP, RCX);
+                as.alu(ALU_AND, t, RCX, false);
+                break;
+            case CmpPredicate::CMP_ONE:
+                as.ucomi(xa, xb, dbl);
+                as.setcc(COND_NE, t);
+                break;
+            case CmpPredicate::CMP_OLT:
+                as.ucomi(xb, xa, dbl);
+                as.setcc(COND_A, t);
+                break;
+            case CmpPredicate::CMP_OLE:
+                as.ucomi(xb, xa, dbl);
+                as.setcc(COND_AE, t);
+                break;
+            case CmpPredicate::CMP_OGT:
+                as.ucomi(xa, xb, dbl);
+                as.setcc(COND_A, t);
+                break;
+            default:
+                as.ucomi(xa, xb, dbl);
+                as.setcc(COND_AE, t);
+                break;
+        }
+        finish_int(v, t);
+    }
+
+    void emit_int_binary(ValueId v) {
+        const Inst& i = inst(v);
+        ValueId a = fn->operand(v, 0);
+        ValueId b = fn->operand(v, 1);
+        unsigned width = bits(v);
+        switch (i.op) {
+            case Opcode::OP_SDIV:
+            case Opcode::OP_UDIV:
+            case Opcode::OP_SREM:
+            case Opcode::OP_UREM: {
+                bool sign = i.op == Opcode::OP_SDIV || i.op == Opcode::OP_SREM;
+                load_int(RCX, b);
+                load_int(RAX, a);
+                if (sign) {
+                    sign_extend_in_place(RAX, width);
+                    sign_extend_in_place(RCX, width);
+                    as.cqo();
+                } else {
+                    as.mov_imm(RDX, 0);
+                }
+                as.div(RCX, sign);
+                Reg t = target(v);
+                Reg result = i.op == Opcode::OP_SDIV || i.op == Opcode::OP_UDIV ? RAX : RDX;
+                if (t != result) {
+                    as.mov(t, result);
+                }
+                normalize(t, width);
+                finish_int(v, t);
+                return;
+            }
+            case Opcode::OP_SHL:
+            case Opcode::OP_LSHR:
+            case Opcode::OP_ASHR: {
+                Reg t = target(v);
+                load_int(t, a);
+                ShiftOp op = i.op == Opcode::OP_SHL    ? SHIFT_SHL
+                             : i.op == Opcode::OP_LSHR ? SHIFT_SHR
+                                                       : SHIFT_SAR;
+                if (op == SHIFT_SAR) {
+                    sign_extend_in_place(t, width);
+                }
+                if (inst(b).op == Opcode::OP_CONST) {
+                    as.shift_imm(op, t, static_cast<std::uint8_t>(inst(b).imm & 63));
+                } else {
+                    load_int(RCX, b);
+                    as.shift_cl(op, t);
+                }
+                normalize(t, width);
+                finish_int(v, t);
+                return;
+            }
+            default: break;
+        }
+        Reg t = target(v);
+        load_int(t, a);
+        std::optional<std::int32_t> imm = immediate(b);
+        if (i.op == Opcode::OP_MUL) {
+            as.imul(t, int_operand(b, RCX));
+        } else {
+            AluOp op = i.op == Opcode::OP_ADD   ? ALU_ADD
+                       : i.op == Opcode::OP_SUB ? ALU_SUB
+                       : i.op == Opcode::OP_AND ? ALU_AND
+                       : i.op == Opcode::OP_OR  ? ALU_OR
+                                                : ALU_XOR;
+            if (imm) {
+                as.alu_imm(op, t, *imm);
+            } else {
+                as.alu(op, t, int_operand(b, RCX));
+            }
+        }
+        normalize(t, width);
+        finish_int(v, t);
+    }
+
+    void emit_float_binary(ValueId v) {
+        const Inst& i = inst(v);
+        bool dbl = is_double(i.type);
+        if (i.op == Opcode::OP_FREM) {
+            call(object.symbol(dbl ? "fmod" : "fmodf"),
+                 {fn->operand(v, 0), fn->operand(v, 1)}, v, false);
+            return;
+        }
+        SseOp op = i.op == Opcode::OP_FADD   ? SSE_ADD
+                   : i.op == Opcode::OP_FSUB ? SSE_SUB
+                   : i.op == Opcode::OP_FMUL ? SSE_MUL
+                                             : SSE_DIV;
+        Xmm t = float_target(v);
+        load_float(t, fn->operand(v, 0));
+        as.sse(op, t, float_operand(fn->operand(v, 1), XMM14), dbl);
+        finish_float(v, t);
+    }
+
+    void emit_cast(ValueId v) {
+        const Inst& i = inst(v);
+        ValueId a = fn->operand(v, 0);
+        unsigned from = bits(a);
+        unsigned to = middle::type_bits(i.type);
+        switch (i.op) {
+            case Opcode::OP_TRUNC:
+            case Opcode::OP_ZEXT:
+            case Opcode::OP_SEXT:
+            case Opcode::OP_PTRTOINT:
+            case Opcode::OP_INTTOPTR: {
+                Reg t = target(v);
+                load_int(t, a);
+                if (i.op == Opcode::OP_SEXT) {
+                    sign_extend_in_place(t, from);
+                }
+                normalize(t, to);
+                finish_int(v, t);
+                return;
+            }
+            case Opcode::OP_FPTOSI:
+            case Opcode::OP_FPTOUI: {
+                bool dbl = is_double(type(a));
+                Xmm x = float_operand(a, XMM15);
+                Reg t = target(v);
+                if (i.op == Opcode::OP_FPTOSI || to < 64) {
+                    as.cvt_float_to_int(t, x, dbl);
+                } else {
+                    // Values of 2^63 and above are converted less 2^63.
+                    Label big = as.new_label();
+                    Label done = as.new_label();
+                    load_constant(XMM14, 9223372036854775808.0, dbl);
+                    as.ucomi(x, XMM14, dbl);
+                    as.jcc(COND_AE, big);
+                    as.cvt_float_to_int(t, x, dbl);
+                    as.jmp(done);
+                    as.bind(big);
+                    if (x != XMM15) {
+                        as.movs(XMM15, x);
+                    }
+                    as.sse(SSE_SUB, XMM15, XMM14, dbl);
+                    as.cvt_float_to_int(t, XMM15, dbl);
+                    as.mov_imm(RCX, std::uint64_t{1} << 63);
+                    as.alu(ALU_XOR, t, RCX);
+                    as.bind(done);
+                }
+                normalize(t, to);
+                finish_int(v, t);
+                return;
+            }
+            case Opcode::OP_SITOFP:
+            case Opcode::OP_UITOFP: {
+                bool dbl = is_double(i.type);
+                Xmm t = float_target(v);
+                load_int(RAX, a);
+                if (i.op == Opcode::OP_SITOFP) {
+                    sign_extend_in_place(RAX, from);
+                    as.cvt_int_to_float(t, RAX, dbl);
+                } else if (from < 64) {
+                    as.cvt_int_to_float(t, RAX, dbl);
+                } else {
+                    // With the top bit set: halve, keeping the low bit for
+                    // rounding, convert and double.
+                    Label big = as.new_label();
+                    Label done = as.new_label();
+                    as.test(RAX, RAX);
+                    as.jcc(COND_S, big);
+                    as.cvt_int_to_float(t, RAX, dbl);
+                    as.jmp(done);
+                    as.bind(big);
+                    as.mov(RCX, RAX);
+                    as.shift_imm(SHIFT_SHR, RCX, 1);
+                    as.alu_imm(ALU_AND, RAX, 1);
+                    as.alu(ALU_OR, RCX, RAX);
+                    as.cvt_int_to_float(t, RCX, dbl);
+                    as.sse(SSE_ADD, t, t, dbl);
+                    as.bind(done);
+                }
+                finish_float(v, t);
+                return;
+            }
+            default: {
+                // fpext, fptrunc
+                Xmm t = float_target(v);
+                as.cvt_float_to_float(t, float_operand(a, XMM15), is_double(type(a)));
+                finish_float(v, t);
+                return;
+            }
+        }
+    }
+
+    void zero_stack_slot(ValueId v) {
+        std::int32_t offset = alloca_offsets[v];
+        auto bytes = static_cast<std::int32_t>(slot_size(*fn, v));
+        if (bytes <= 64) {
+            for (std::int32_t at = 0; at < bytes; at += 8) {
+                as.store_imm32(Mem{RBP, offset + at}, 0);
+            }
+            return;
+        }
+        Label loop = as.new_label();
+        as.lea(R11, Mem{RBP, offset});
+        as.mov_imm(RCX, static_cast<std::uint64_t>(bytes / 8));
+        as.mov_imm(RAX, 0);
+        as.bind(loop);
+        as.store(Mem{R11, 0}, RAX, 8);
+        as.alu_imm(ALU_ADD, R11, 8);
+        as.alu_imm(ALU_SUB, RCX, 1);
+        as.jcc(COND_NE, loop);
+    }
+
+    void emit_branch(ValueId v, BlockId b) {
+        BlockId on_true = fn->targets(v)[0];
+        BlockId on_false = fn->targets(v)[1];
+        ValueId condition_value = fn->operand(v, 0);
+        Cond cond = COND_NE;
+        if (fused[condition_value]) {
+            cond = compare(condition_value);
+        } else {
+            Reg r = int_operand(condition_value, RAX);
+            as.test(r, r);
+        }
+        if (!has_phis(on_true)) {
+            as.jcc(cond, labels[on_true]);
+            edge_moves(b, on_false);
+            jump(on_false);
+            return;
+        }
+        Label taken = as.new_label();
+        as.jcc(cond, taken);
+        edge_moves(b, on_false);
+        as.jmp(labels[on_false]);
+        as.bind(taken);
+        edge_moves(b, on_true);
+        jump(on_true);
+    }
+
+    // A chain of comparisons in which the first equal case wins; edges into
+    // blocks with phis get their moves out of line.
+    void emit_switch(ValueId v, BlockId b) {
+        std::span<const BlockId> targets = fn->targets(v);
+        ValueId scrutinee = fn->operand(v, 0);
+        Reg r = int_operand(scrutinee, RAX);
+        unsigned width = bits(scrutinee);
+        std::vector<std::pair<Label, BlockId>> edges;
+        for (std::uint32_t i = 1; i < fn->num_operands(v); ++i) {
+            ValueId key = fn->operand(v, i);
+            std::uint64_t value = mask_to(inst(key).imm, width);
+            bool small = value <= static_cast<std::uint64_t>(INT32_MAX);
+            if (inst(key).op == Opcode::OP_CONST && small) {
+                as.alu_imm(ALU_CMP, r, static_cast<std::int32_t>(value));
+            } else {
+                as.alu(ALU_CMP, r, int_operand(key, RCX));
+            }
+            Label to = labels[targets[i]];
+            if (has_phis(targets[i])) {
+                to = as.new_label();
+                edges.emplace_back(to, targets[i]);
+            }
+            as.jcc(COND_E, to);
+        }
+        edge_moves(b, targets[0]);
+        if (edges.empty()) {
+            jump(targets[0]);
+            return;
+        }
+        as.jmp(labels[targets[0]]);
+        for (std::size_t i = 0; i < edges.size(); ++i) {
+            as.bind(edges[i].first);
+            edge_moves(b, edges[i].second);
+            if (i + 1 < edges.size()) {
+                as.jmp(labels[edges[i].second]);
+            } else {
+                jump(edges[i].second);
+            }
+        }
+    }
+
+    void emit(ValueId v, BlockId b) {
+        const Inst& i = inst(v);
+        switch (i.op) {
+            case Opcode::OP_PHI:
+                break;  // written on the incoming edges
+            case Opcode::OP_ADD:
+            case Opcode::OP_SUB:
+            case Opcode::OP_MUL:
+            case Opcode::OP_SDIV:
+            case Opcode::OP_UDIV:
+            case Opcode::OP_SREM:
+            case Opcode::OP_UREM:
+            case Opcode::OP_AND:
+            case Opcode::OP_OR:
+            case Opcode::OP_XOR:
+            case Opcode::OP_SHL:
+            case Opcode::OP_LSHR:
+            case Opcode::OP_ASHR:
+                emit_int_binary(v);
+                break;
+            case Opcode::OP_FADD:
+            case Opcode::OP_FSUB:
+            case Opcode::OP_FMUL:
+            case Opcode::OP_FDIV:
+            case Opcode::OP_FREM:
+                emit_float_binary(v);
+                break;
+            case Opcode::OP_FNEG: {
+                bool dbl = is_double(i.type);
+                Xmm t = float_target(v);
+                load_float(t, fn->operand(v, 0));
+                load_constant(XMM14, -0.0, dbl);
+                as.xorps(t, XMM14);
+                finish_float(v, t);
+                break;
+            }
+            case Opcode::OP_ICMP:
+                if (!fused[v]) {
+                    Cond cond = compare(v);
+                    Reg t = target(v);
+                    as.setcc(cond, t);
+                    finish_int(v, t);
+                }
+                break;
+            case Opcode::OP_FCMP:
+                emit_float_compare(v);
+                break;
+            case Opcode::OP_TRUNC:
+            case Opcode::OP_ZEXT:
+            case Opcode::OP_SEXT:
+            case Opcode::OP_FPTOSI:
+            case Opcode::OP_FPTOUI:
+            case Opcode::OP_SITOFP:
+            case Opcode::OP_UITOFP:
+            case Opcode::OP_FPEXT:
+            case Opcode::OP_FPTRUNC:
+            case Opcode::OP_PTRTOINT:
+            case Opcode::OP_INTTOPTR:
+                emit_cast(v);
+                break;
+            case Opcode::OP_SELECT: {
+                ValueId condition_value = fn->operand(v, 0);
+                if (is_fp(i.type)) {
+                    Xmm t = float_target(v);
+                    load_float(t, fn->operand(v, 2));
+                    Reg c = int_operand(condition_value, RAX);
+                    Label skip = as.new_label();
+                    as.test(c, c);
+                    as.jcc(COND_E, skip);
+                    load_float(t, fn->operand(v, 1));
+                    as.bind(skip);
+                    finish_float(v, t);
+                    break;
+                }
+                Reg t = target(v);
+                load_int(t, fn->operand(v, 2));
+                Reg if_true = int_operand(fn->operand(v, 1), RCX);
+                Reg c = int_operand(condition_value, RDX);
+                as.test(c, c);
+                as.cmov(COND_NE, t, if_true);
+                finish_int(v, t);
+                break;
+            }
+            case Opcode::OP_ALLOCA:
+                zero_stack_slot(v);
+                break;
+            case Opcode::OP_LOAD: {
+                if (is_fp(i.type)) {
+                    Xmm t = float_target(v);
+                    as.load_sse(t, address(fn->operand(v, 0)), is_double(i.type));
+                    finish_float(v, t);
+                } else {
+                    Reg t = target(v);
+                    as.load(t, address(fn->operand(v, 0)),
+                            static_cast<unsigned>(middle::type_size(i.type)));
+                    finish_int(v, t);
+                }
+                break;
+            }
+            case Opcode::OP_STORE: {
+                ValueId value = fn->operand(v, 0);
+                if (is_fp(type(value))) {
+                    Xmm x = float_operand(value, XMM15);
+                    as.store_sse(address(fn->operand(v, 1)), x, is_double(type(value)));
+                } else {
+                    Reg r = int_operand(value, RAX);
+                    as.store(address(fn->operand(v, 1)), r,
+                             static_cast<unsigned>(middle::type_size(type(value))));
+                }
+                break;
+            }
+            case Opcode::OP_PTRADD: {
+                ValueId base = fn->operand(v, 0);
+                ValueId offset = fn->operand(v, 1);
+                Reg t = target(v);
+                std::optional<std::int32_t> imm = immediate(offset);
+                bool non_negative = imm && *imm >= 0;
+                if (inst(base).op == Opcode::OP_ALLOCA && non_negative) {
+                    as.lea(t, Mem{RBP, alloca_offsets[base] + *imm});
+                } else {
+                    load_int(t, base);
+                    if (non_negative) {
+                        as.alu_imm(ALU_ADD, t, *imm);
+                    } else {
+                        as.alu(ALU_ADD, t, int_operand(offset, RCX));
+                    }
+                }
+                finish_int(v, t);
+                break;
+            }
+            case Opcode::OP_NEW: {
+                // calloc(1, max(size, 1)): zeroed, and never null for zero bytes.
+                load_int(RAX, fn->operand(v, 0));
+                as.mov_imm(RCX, 1);
+                as.test(RAX, RAX);
+                as.cmov(COND_E, RAX, RCX);
+                as.mov(RSI, RAX);
+                as.mov_imm(RDI, 1);
+                as.call(object.symbol("calloc"));
+                finish_int(v, RAX);
+                break;
+            }
+            case Opcode::OP_DELETE:
+                load_int(RDI, fn->operand(v, 0));
+                as.call(object.symbol("free"));
+                break;
+            case Opcode::OP_BOUNDS_CHECK: {
+                ValueId index = fn->operand(v, 0);
+                ValueId length = fn->operand(v, 1);
+                Reg r = int_operand(index, RAX);
+                as.alu(ALU_CMP, r, int_operand(length, RCX));
+                Label failed = as.new_label();
+                as.jcc(COND_AE, failed);
+                failures.push_back({failed, index, length});
+                break;
+            }
+            case Opcode::OP_CALL: {
+                const Function* callee = source.function_for(i.aux);
+                if (callee == nullptr) {
+                    fail("call to unknown function '@" + source.symbol_name(i.aux) + "'");
+                    break;
+                }
+                std::vector<ValueId> args;
+                for (std::uint32_t k = 0; k < i.num_operands; ++k) {
+                    args.push_back(fn->operand(v, k));
+                }
+                call(object.symbol(callee->name), args, v,
+                     (callee->flags & middle::FUNCTION_EXTERN) != 0);
+                break;
+            }
+            case Opcode::OP_BR:
+                edge_moves(b, fn->targets(v)[0]);
+                jump(fn->targets(v)[0]);
+                break;
+            case Opcode::OP_COND_BR:
+                emit_branch(v, b);
+                break;
+            case Opcode::OP_SWITCH:
+                emit_switch(v, b);
+                break;
+            case Opcode::OP_RET:
+                if (i.num_operands != 0 && fn->return_type.kind != IRTypeKind::IR_VOID) {
+                    ValueId value = fn->operand(v, 0);
+                    if (is_fp(type(value))) {
+                        load_float(XMM0, value);
+                    } else {
+                        load_int(RAX, value);
+                    }
+                }
+                epilogue();
+                break;
+            case Opcode::OP_UNREACHABLE:
+                as.ud2();
+                break;
+            default:
+                fail(std::string("cannot compile '") + middle::opcode_name(i.op) + "' in '@" +
+                     fn->name + "'");
+                break;
+        }
+    }
+};
+
+}  // namespace
+
+std::string emit_x86_object(const middle::Module& module, std::string* error,
+                            unsigned threads) {
+    return Compiler(module, threads).compile(error);
+}
+
+}  // namespace pallas::backend
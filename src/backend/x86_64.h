@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+#include "middle/ir.h"
+
+namespace pallas::backend {
+
+// Compiles a module straight to an x86-64 ELF relocatable object, without
+// LLVM, for fast debug builds. Instructions are selected one at a time with
+// no optimization of their own; values live in registers picked by linear
+// scan (regalloc.h) or in spill slots, and calls follow the System V ABI, so
+// the object links with C code and the runtime (pallas_core) like the LLVM
+// backend's. Vector operations are not supported: run the scalarize pass
+// first. i128 is not supported.
+//
+// Registers are assigned to the functions on up to `threads` threads (0 means
+// one per hardware thread); the object is the same for any count.
+// Returns the object file contents, or an empty string and `error`.
+std::string emit_x86_object(const middle::Module& module, std::string* error,
+                            unsigned threads = 1);
+
+}  // namespace pallas::backend
@@ -0,0 +1,343 @@
+#include "x86_asm.h"
+
+namespace pallas::backend::x86 {
+
+namespace {
+
+bool fits_int8(std::int64_t value) {
+    return value >= -128 && value <= 127;
+}
+
+std::uint8_t sse_prefix(bool dbl) {
+    return dbl ? 0xf2 : 0xf3;
+}
+
+// Second opcode bytes of movzx/movsx from 8 and 16 bits.
+std::uint8_t byte_load(bool sign) {
+    return sign ? 0xbe : 0xb6;
+}
+
+std::uint8_t word_load(bool sign) {
+    return sign ? 0xbf : 0xb7;
+}
+
+}  // namespace
+
+Label Assembler::new_label() {
+    labels.push_back(-1);
+    return static_cast<Label>(labels.size() - 1);
+}
+
+void Assembler::bind(Label label) {
+    labels[label] = static_cast<std::int64_t>(code.size());
+}
+
+void Assembler::jmp(Label label) {
+    byte(0xe9);
+    fixups.emplace_back(code.size(), label);
+    imm32(0);
+}
+
+void Assembler::jcc(Cond cond, Label label) {
+    byte(0x0f);
+    byte(static_cast<std::uint8_t>(0x80 | cond));
+    fixups.emplace_back(code.size(), label);
+    imm32(0);
+}
+
+void Assembler::finish() {
+    for (auto [at, label] : fixups) {
+        auto rel = static_cast<std::uint32_t>(labels[label] - static_cast<std::int64_t>(at + 4));
+        for (int i = 0; i < 4; ++i) {
+            code[at + i] = static_cast<std::uint8_t>(rel >> (8 * i));
+        }
+    }
+    fixups.clear();
+}
+
+void Assembler::imm32(std::uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        byte(static_cast<std::uint8_t>(value >> (8 * i)));
+    }
+}
+
+void Assembler::rex(bool wide, std::uint8_t reg, std::uint8_t base, bool force) {
+    auto prefix = static_cast<std::uint8_t>(0x40 | (wide ? 8 : 0) | (reg >> 3) << 2 | (base >> 3));
+    if (prefix != 0x40 || force) {
+        byte(prefix);
+    }
+}
+
+void Assembler::op_rr(std::uint8_t prefix, bool wide, std::initializer_list<std::uint8_t> opcode,
+                      std::uint8_t reg, std::uint8_t rm, bool byte_regs) {
+    if (prefix != 0) {
+        byte(prefix);
+    }
+    // Without REX, byte registers 4-7 are ah/ch/dh/bh rather than spl..dil.
+    rex(wide, reg, rm, byte_regs && rm >= 4 && rm < 8);
+    for (std::uint8_t b : opcode) {
+        byte(b);
+    }
+    byte(static_cast<std::uint8_t>(0xc0 | (reg & 7) << 3 | (rm & 7)));
+}
+
+void Assembler::op_rm(std::uint8_t prefix, bool wide, std::initializer_list<std::uint8_t> opcode,
+                      std::uint8_t reg, Mem mem, bool byte_reg) {
+    if (prefix != 0) {
+        byte(prefix);
+    }
+    rex(wide, reg, mem.base, byte_reg && reg >= 4 && reg < 8);
+    for (std::uint8_t b : opcode) {
+        byte(b);
+    }
+    // rbp and r13 as base always need a displacement; rsp and r12 need a SIB.
+    std::uint8_t mod = 2;
+    if (mem.disp == 0 && (mem.base & 7) != RBP) {
+        mod = 0;
+    } else if (fits_int8(mem.disp)) {
+        mod = 1;
+    }
+    byte(static_cast<std::uint8_t>(mod << 6 | (reg & 7) << 3 | (mem.base & 7)));
+    if ((mem.base & 7) == RSP) {
+        byte(0x24);
+    }
+    if (mod == 1) {
+        byte(static_cast<std::uint8_t>(mem.disp));
+    } else if (mod == 2) {
+        imm32(static_cast<std::uint32_t>(mem.disp));
+    }
+}
+
+void Assembler::op_rip(std::uint8_t prefix, bool wide, std::initializer_list<std::uint8_t> opcode,
+                       std::uint8_t reg, std::uint32_t symbol, std::uint32_t type,
+                       std::int32_t offset) {
+    if (prefix != 0) {
+        byte(prefix);
+    }
+    rex(wide, reg, 0);
+    for (std::uint8_t b : opcode) {
+        byte(b);
+    }
+    byte(static_cast<std::uint8_t>((reg & 7) << 3 | 5));
+    // The displacement is relative to the end of the instruction.
+    object.relocate(code.size(), symbol, type, offset - 4);
+    imm32(0);
+}
+
+void Assembler::mov(Reg dst, Reg src, bool wide) {
+    op_rr(0, wide, {0x89}, src, dst);
+}
+
+void Assembler::mov_imm(Reg dst, std::uint64_t value) {
+    // Never `xor`: callers materialize constants between a compare and its use.
+    if (value <= 0xffffffffu) {
+        rex(false, 0, dst);
+        byte(static_cast<std::uint8_t>(0xb8 | (dst & 7)));
+        imm32(static_cast<std::uint32_t>(value));
+    } else if (static_cast<std::int64_t>(value) < 0 &&
+               static_cast<std::int64_t>(value) >= INT32_MIN) {
+        op_rr(0, true, {0xc7}, 0, dst);
+        imm32(static_cast<std::uint32_t>(value));
+    } else {
+        rex(true, 0, dst);
+        byte(static_cast<std::uint8_t>(0xb8 | (dst & 7)));
+        imm32(static_cast<std::uint32_t>(value));
+        imm32(static_cast<std::uint32_t>(value >> 32));
+    }
+}
+
+void Assembler::load(Reg dst, Mem src, unsigned bytes, bool sign) {
+    switch (bytes) {
+        case 1: op_rm(0, sign, {0x0f, byte_load(sign)}, dst, src); break;
+        case 2: op_rm(0, sign, {0x0f, word_load(sign)}, dst, src); break;
+        case 4: op_rm(0, sign, {static_cast<std::uint8_t>(sign ? 0x63 : 0x8b)}, dst, src); break;
+        default: op_rm(0, true, {0x8b}, dst, src); break;
+    }
+}
+
+void Assembler::store(Mem dst, Reg src, unsigned bytes) {
+    switch (bytes) {
+        case 1: op_rm(0, false, {0x88}, src, dst, true); break;
+        case 2: op_rm(0x66, false, {0x89}, src, dst); break;
+        case 4: op_rm(0, false, {0x89}, src, dst); break;
+        default: op_rm(0, true, {0x89}, src, dst); break;
+    }
+}
+
+void Assembler::store_imm32(Mem dst, std::int32_t value) {
+    op_rm(0, true, {0xc7}, 0, dst);
+    imm32(static_cast<std::uint32_t>(value));
+}
+
+void Assembler::lea(Reg dst, Mem src) {
+    op_rm(0, true, {0x8d}, dst, src);
+}
+
+void Assembler::lea_symbol(Reg dst, std::uint32_t symbol) {
+    op_rip(0, true, {0x8d}, dst, symbol, kRelocPC32);
+}
+
+void Assembler::load_got(Reg dst, std::uint32_t symbol) {
+    op_rip(0, true, {0x8b}, dst, symbol, kRelocGOTPCREL);
+}
+
+void Assembler::alu(AluOp op, Reg dst, Reg src, bool wide) {
+    op_rr(0, wide, {static_cast<std::uint8_t>(op << 3 | 1)}, src, dst);
+}
+
+void Assembler::alu_imm(AluOp op, Reg dst, std::int32_t value, bool wide) {
+    if (fits_int8(value)) {
+        op_rr(0, wide, {0x83}, op, dst);
+        byte(static_cast<std::uint8_t>(value));
+    } else {
+        op_rr(0, wide, {0x81}, op, dst);
+        imm32(static_cast<std::uint32_t>(value));
+    }
+}
+
+void Assembler::alu_mem(AluOp op, Reg dst, Mem src) {
+    op_rm(0, true, {static_cast<std::uint8_t>(op << 3 | 3)}, dst, src);
+}
+
+void Assembler::test(Reg a, Reg b, bool wide) {
+    op_rr(0, wide, {0x85}, b, a);
+}
+
+void Assembler::imul(Reg dst, Reg src) {
+    op_rr(0, true, {0x0f, 0xaf}, dst, src);
+}
+
+void Assembler::div(Reg src, bool sign) {
+    op_rr(0, true, {0xf7}, sign ? 7 : 6, src);
+}
+
+void Assembler::cqo() {
+    byte(0x48);
+    byte(0x99);
+}
+
+void Assembler::shift_cl(ShiftOp op, Reg dst) {
+    op_rr(0, true, {0xd3}, op, dst);
+}
+
+void Assembler::shift_imm(ShiftOp op, Reg dst, std::uint8_t amount) {
+    op_rr(0, true, {0xc1}, op, dst);
+    byte(amount);
+}
+
+void Assembler::neg(Reg dst) {
+    op_rr(0, true, {0xf7}, 3, dst);
+}
+
+void Assembler::not_(Reg dst) {
+    op_rr(0, true, {0xf7}, 2, dst);
+}
+
+void Assembler::extend(Reg dst, Reg src, unsigned bytes, bool sign) {
+    switch (bytes) {
+        case 1:
+            op_rr(0, sign, {0x0f, byte_load(sign)}, dst, src, true);
+            break;
+        case 2: op_rr(0, sign, {0x0f, word_load(sign)}, dst, src); break;
+        case 4:
+            if (sign) {
+                op_rr(0, true, {0x63}, dst, src);
+            } else {
+                mov(dst, src, false);
+            }
+            break;
+        default:
+            if (dst != src) {
+                mov(dst, src);
+            }
+            break;
+    }
+}
+
+void Assembler::setcc(Cond cond, Reg dst) {
+    op_rr(0, false, {0x0f, static_cast<std::uint8_t>(0x90 | cond)}, 0, dst, true);
+    extend(dst, dst, 1, false);
+}
+
+void Assembler::cmov(Cond cond, Reg dst, Reg src) {
+    op_rr(0, true, {0x0f, static_cast<std::uint8_t>(0x40 | cond)}, dst, src);
+}
+
+void Assembler::call(std::uint32_t symbol) {
+    byte(0xe8);
+    object.relocate(code.size(), symbol, kRelocPLT32, -4);
+    imm32(0);
+}
+
+void Assembler::call_reg(Reg target) {
+    op_rr(0, false, {0xff}, 2, target);
+}
+
+void Assembler::ret() {
+    byte(0xc3);
+}
+
+void Assembler::push(Reg reg) {
+    rex(false, 0, reg);
+    byte(static_cast<std::uint8_t>(0x50 | (reg & 7)));
+}
+
+void Assembler::pop(Reg reg) {
+    rex(false, 0, reg);
+    byte(static_cast<std::uint8_t>(0x58 | (reg & 7)));
+}
+
+void Assembler::ud2() {
+    byte(0x0f);
+    byte(0x0b);
+}
+
+void Assembler::movs(Xmm dst, Xmm src) {
+    op_rr(0, false, {0x0f, 0x28}, dst, src);
+}
+
+void Assembler::load_sse(Xmm dst, Mem src, bool dbl) {
+    op_rm(sse_prefix(dbl), false, {0x0f, 0x10}, dst, src);
+}
+
+void Assembler::load_sse_symbol(Xmm dst, std::uint32_t symbol, std::int32_t offset, bool dbl) {
+    op_rip(sse_prefix(dbl), false, {0x0f, 0x10}, dst, symbol, kRelocPC32, offset);
+}
+
+void Assembler::store_sse(Mem dst, Xmm src, bool dbl) {
+    op_rm(sse_prefix(dbl), false, {0x0f, 0x11}, src, dst);
+}
+
+void Assembler::sse(SseOp op, Xmm dst, Xmm src, bool dbl) {
+    op_rr(sse_prefix(dbl), false, {0x0f, op}, dst, src);
+}
+
+void Assembler::xorps(Xmm dst, Xmm src) {
+    op_rr(0, false, {0x0f, 0x57}, dst, src);
+}
+
+void Assembler::ucomi(Xmm a, Xmm b, bool dbl) {
+    op_rr(dbl ? 0x66 : 0, false, {0x0f, 0x2e}, a, b);
+}
+
+void Assembler::movq_to_xmm(Xmm dst, Reg src) {
+    op_rr(0x66, true, {0x0f, 0x6e}, dst, src);
+}
+
+void Assembler::movq_from_xmm(Reg dst, Xmm src) {
+    op_rr(0x66, true, {0x0f, 0x7e}, src, dst);
+}
+
+void Assembler::cvt_int_to_float(Xmm dst, Reg src, bool dbl) {
+    op_rr(sse_prefix(dbl), true, {0x0f, 0x2a}, dst, src);
+}
+
+void Assembler::cvt_float_to_int(Reg dst, Xmm src, bool dbl) {
+    op_rr(sse_prefix(dbl), true, {0x0f, 0x2c}, dst, src);
+}
+
+void Assembler::cvt_float_to_float(Xmm dst, Xmm src, bool from_dbl) {
+    op_rr(sse_prefix(from_dbl), false, {0x0f, 0x5a}, dst, src);
+}
+
+}  // namespace pallas::backend::x86
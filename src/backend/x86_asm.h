@@ -0,0 +1,157 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "elf.h"
+
+namespace pallas::backend::x86 {
+
+// General-purpose and SSE registers, by their encoding.
+enum Reg : std::uint8_t {
+    RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+    R8, R9, R10, R11, R12, R13, R14, R15,
+};
+
+enum Xmm : std::uint8_t {
+    XMM0, XMM1, XMM2, XMM3, XMM4, XMM5, XMM6, XMM7,
+    XMM8, XMM9, XMM10, XMM11, XMM12, XMM13, XMM14, XMM15,
+};
+
+// Condition codes, by their encoding in jcc/setcc/cmovcc.
+enum Cond : std::uint8_t {
+    COND_O = 0x0,
+    COND_NO = 0x1,
+    COND_B = 0x2,   // unsigned <
+    COND_AE = 0x3,  // unsigned >=
+    COND_E = 0x4,
+    COND_NE = 0x5,
+    COND_BE = 0x6,  // unsigned <=
+    COND_A = 0x7,   // unsigned >
+    COND_S = 0x8,
+    COND_P = 0xa,
+    COND_NP = 0xb,
+    COND_L = 0xc,   // signed <
+    COND_GE = 0xd,
+    COND_LE = 0xe,
+    COND_G = 0xf,
+};
+
+// [base + disp]
+struct Mem {
+    Reg base = RBP;
+    std::int32_t disp = 0;
+};
+
+enum AluOp : std::uint8_t {
+    ALU_ADD = 0,
+    ALU_OR = 1,
+    ALU_AND = 4,
+    ALU_SUB = 5,
+    ALU_XOR = 6,
+    ALU_CMP = 7,
+};
+
+enum ShiftOp : std::uint8_t {
+    SHIFT_SHL = 4,
+    SHIFT_SHR = 5,
+    SHIFT_SAR = 7,
+};
+
+// Scalar SSE arithmetic, by opcode.
+enum SseOp : std::uint8_t {
+    SSE_ADD = 0x58,
+    SSE_MUL = 0x59,
+    SSE_SUB = 0x5c,
+    SSE_DIV = 0x5e,
+};
+
+using Label = std::uint32_t;
+
+// Encodes x86-64 instructions into the .text of an ObjectFile. Operand order
+// follows Intel syntax: destination first. `wide` selects 64-bit operands,
+// `dbl` double rather than single precision. Jumps to labels use 32-bit
+// displacements and are patched by finish().
+class Assembler {
+  public:
+    explicit Assembler(ObjectFile& object) : object(object), code(object.text) {}
+
+    std::uint64_t offset() const { return code.size(); }
+
+    Label new_label();
+    void bind(Label label);
+    void jmp(Label label);
+    void jcc(Cond cond, Label label);
+    // Patches jumps to labels bound since the last call.
+    void finish();
+
+    void mov(Reg dst, Reg src, bool wide = true);
+    void mov_imm(Reg dst, std::uint64_t value);
+    // Loads of 1, 2 and 4 bytes zero-extend; `sign` sign-extends to 64 bits.
+    void load(Reg dst, Mem src, unsigned bytes, bool sign = false);
+    void store(Mem dst, Reg src, unsigned bytes);
+    void store_imm32(Mem dst, std::int32_t value);  // 8 bytes, sign-extended
+    void lea(Reg dst, Mem src);
+    // lea dst, [rip + symbol]
+    void lea_symbol(Reg dst, std::uint32_t symbol);
+    // mov dst, [rip + symbol@GOTPCREL]
+    void load_got(Reg dst, std::uint32_t symbol);
+
+    void alu(AluOp op, Reg dst, Reg src, bool wide = true);
+    void alu_imm(AluOp op, Reg dst, std::int32_t value, bool wide = true);
+    void alu_mem(AluOp op, Reg dst, Mem src);  // 64-bit
+    void test(Reg a, Reg b, bool wide = true);
+    void imul(Reg dst, Reg src);
+    void div(Reg src, bool sign);  // rdx:rax / src
+    void cqo();
+    void shift_cl(ShiftOp op, Reg dst);
+    void shift_imm(ShiftOp op, Reg dst, std::uint8_t amount);
+    void neg(Reg dst);
+    void not_(Reg dst);
+    // Zero- or sign-extends the low `bytes` of src into dst.
+    void extend(Reg dst, Reg src, unsigned bytes, bool sign);
+    void setcc(Cond cond, Reg dst);  // dst = cond ? 1 : 0, whole register
+    void cmov(Cond cond, Reg dst, Reg src);
+
+    void call(std::uint32_t symbol);
+    void call_reg(Reg target);
+    void ret();
+    void push(Reg reg);
+    void pop(Reg reg);
+    void ud2();
+
+    void movs(Xmm dst, Xmm src);  // the whole register
+    void load_sse(Xmm dst, Mem src, bool dbl);
+    // movsd/movss dst, [rip + symbol + offset]
+    void load_sse_symbol(Xmm dst, std::uint32_t symbol, std::int32_t offset, bool dbl);
+    void store_sse(Mem dst, Xmm src, bool dbl);
+    void sse(SseOp op, Xmm dst, Xmm src, bool dbl);
+    void xorps(Xmm dst, Xmm src);
+    void ucomi(Xmm a, Xmm b, bool dbl);
+    void movq_to_xmm(Xmm dst, Reg src);
+    void movq_from_xmm(Reg dst, Xmm src);
+    void cvt_int_to_float(Xmm dst, Reg src, bool dbl);    // signed 64-bit source
+    void cvt_float_to_int(Reg dst, Xmm src, bool dbl);    // truncating, 64-bit result
+    void cvt_float_to_float(Xmm dst, Xmm src, bool from_dbl);
+
+  private:
+    ObjectFile& object;
+    std::vector<std::uint8_t>& code;
+    std::vector<std::int64_t> labels;  // offset, or -1 while unbound
+    std::vector<std::pair<std::uint64_t, Label>> fixups;
+
+    void byte(std::uint8_t b) { code.push_back(b); }
+    void imm32(std::uint32_t value);
+    void rex(bool wide, std::uint8_t reg, std::uint8_t base, bool force = false);
+    // prefix, REX, opcode and a register-direct ModRM
+    void op_rr(std::uint8_t prefix, bool wide, std::initializer_list<std::uint8_t> opcode,
+               std::uint8_t reg, std::uint8_t rm, bool byte_regs = false);
+    // prefix, REX, opcode and a [base + disp] ModRM
+    void op_rm(std::uint8_t prefix, bool wide, std::initializer_list<std::uint8_t> opcode,
+               std::uint8_t reg, Mem mem, bool byte_reg = false);
+    // prefix, REX, opcode and a [rip + symbol] ModRM with a relocation
+    void op_rip(std::uint8_t prefix, bool wide, std::initializer_list<std::uint8_t> opcode,
+                std::uint8_t reg, std::uint32_t symbol, std::uint32_t type,
+                std::int32_t offset = 0);
+};
+
+}  // namespace pallas::backend::x86
@@ -1 +1,178 @@
 #include "ast.h"
+
+namespace pallas::frontend {
+
+std::shared_ptr<Type> make_type(TypeKind kind, std::string name) {
+    auto t = std::make_shared<Type>();
+    t->kind = kind;
+    t->name = std::move(name);
+    return t;
+}
+
+std::shared_ptr<Type> make_pointer(std::shared_ptr<Type> element) {
+    auto t = make_type(TypeKind::TYPE_POINTER);
+    t->element = std::move(element);
+    return t;
+}
+
+bool is_integer(TypeKind kind) {
+    switch (kind) {
+        case TypeKind::TYPE_I8:
+        case TypeKind::TYPE_I16:
+        case TypeKind::TYPE_I32:
+        case TypeKind::TYPE_I64:
+        case TypeKind::TYPE_I128:
+        case TypeKind::TYPE_U8:
+        case TypeKind::TYPE_U16:
+        case TypeKind::TYPE_U32:
+        case TypeKind::TYPE_U64:
+        case TypeKind::TYPE_U128:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool is_signed(TypeKind kind) {
+    switch (kind) {
+        case TypeKind::TYPE_I8:
+        case TypeKind::TYPE_I16:
+        case TypeKind::TYPE_I32:
+        case TypeKind::TYPE_I64:
+        case TypeKind::TYPE_I128:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool is_float(TypeKind kind) {
+    return kind == TypeKind::TYPE_F32 || kind == TypeKind::TYPE_F64;
+}
+
+unsigned integer_bits(TypeKind kind) {
+    switch (kind) {
+        case TypeKind::TYPE_I8:
+        case TypeKind::TYPE_U8:
+        case TypeKind::TYPE_CHAR:
+            return 8;
+        case TypeKind::TYPE_I16:
+        case TypeKind::TYPE_U16:
+            return 16;
+        case TypeKind::TYPE_I32:
+        case TypeKind::TYPE_U32:
+            return 32;
+        case TypeKind::TYPE_I64:
+        case TypeKind::TYPE_U64:
+            return 64;
+        case TypeKind::TYPE_I128:
+        case TypeKind::TYPE_U128:
+            return 128;
+        case TypeKind::TYPE_BOOL:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+TypeKind primitive_from_name(const std::string& name) {
+    if (name == "i8") return TypeKind::TYPE_I8;
+    if (name == "i16") return TypeKind::TYPE_I16;
+    if (name == "i32") return TypeKind::TYPE_I32;
+    if (name == "i64" || name == "int") return TypeKind::TYPE_I64;
+    if (name == "i128") return TypeKind::TYPE_I128;
+    if (name == "u8") return TypeKind::TYPE_U8;
+    if (name == "u16") return TypeKind::TYPE_U16;
+    if (name == "u32") return TypeKind::TYPE_U32;
+    if (name == "u64" || name == "uint") return TypeKind::TYPE_U64;
+    if (name == "u128") return TypeKind::TYPE_U128;
+    if (name == "f32" || name == "float") return TypeKind::TYPE_F32;
+    if (name == "f64" || name == "double") return TypeKind::TYPE_F64;
+    if (name == "bool") return TypeKind::TYPE_BOOL;
+    if (name == "char") return TypeKind::TYPE_CHAR;
+    if (name == "string") return TypeKind::TYPE_STRING;
+    if (name == "void") return TypeKind::TYPE_VOID;
+    return TypeKind::TYPE_UNKNOWN;
+}
+
+const Attribute* find_attribute(const std::vector<Attribute>& attributes, const std::string& name) {
+    for (const Attribute& attr : attributes) {
+        if (attr.name == name) {
+            return &attr;
+        }
+    }
+    return nullptr;
+}
+
+std::string type_to_string(const Type& type) {
+    switch (type.kind) {
+        case TypeKind::TYPE_VOID: return "void";
+        case TypeKind::TYPE_BOOL: return "bool";
+        case TypeKind::TYPE_I8: return "i8";
+        case TypeKind::TYPE_I16: return "i16";
+        case TypeKind::TYPE_I32: return "i32";
+        case TypeKind::TYPE_I64: return "i64";
+        case TypeKind::TYPE_I128: return "i128";
+        case TypeKind::TYPE_U8: return "u8";
+        case TypeKind::TYPE_U16: return "u16";
+        case TypeKind::TYPE_U32: return "u32";
+        case TypeKind::TYPE_U64: return "u64";
+        case TypeKind::TYPE_U128: return "u128";
+        case TypeKind::TYPE_F32: return "f32";
+        case TypeKind::TYPE_F64: return "f64";
+        case TypeKind::TYPE_CHAR: return "char";
+        case TypeKind::TYPE_STRING: return "string";
+        case TypeKind::TYPE_POINTER:
+            return (type.element ? type_to_string(*type.element) : "?") + "*";
+        case TypeKind::TYPE_REFERENCE:
+            return (type.element ? type_to_string(*type.element) : "?") + "&";
+        case TypeKind::TYPE_ARRAY: {
+            std::string out = type.soa ? "@soa " : "";
+            out += type.element ? type_to_string(*type.element) : "?";
+            out.push_back('[');
+            if (type.size_known) {
+                out.append(std::to_string(type.array_size));
+            }
+            out.push_back(']');
+            return out;
+        }
+        case TypeKind::TYPE_FUNCTION: return "fn";
+        case TypeKind::TYPE_STRUCT:
+        case TypeKind::TYPE_CLASS:
+        case TypeKind::TYPE_UNKNOWN:
+        default: {
+            std::string out = type.name.empty() ? "<unknown>" : type.name;
+            if (!type.args.empty()) {
+                out.push_back('<');
+                for (std::size_t i = 0; i < type.args.size(); ++i) {
+                    if (i != 0) {
+                        out.append(", ");
+                    }
+                    out.append(type_to_string(*type.args[i]));
+                }
+                out.push_back('>');
+            }
+            return out;
+        }
+    }
+}
+
+void import_declarations(ModuleAST& into, ModuleAST& from,
+                         std::unordered_set<const StmtAST*>& imported) {
+    for (std::unique_ptr<StmtAST>& decl : from.decls) {
+        switch (decl->kind) {
+            case NodeType::NODE_FUNCTION:
+            case NodeType::NODE_STRUCT:
+            case NodeType::NODE_TYPE_ALIAS:
+            case NodeType::NODE_CONST:
+                imported.insert(decl.get());
+                into.decls.push_back(std::move(decl));
+                break;
+            default:
+                break;
+        }
+    }
+    std::erase(from.decls, nullptr);
+}
+
+}  // namespace pallas::frontend
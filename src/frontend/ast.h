@@ -1,92 +1,270 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <memory>
 #include <string>
+#include <unordered_set>
 #include <vector>
+#include "scanner.h"
 
 namespace pallas::frontend {
 
+struct SourceLocation {
+    std::size_t offset = 0;
+    std::size_t line = 0;
+    std::size_t column = 0;
+};
+
+enum class TypeKind {
+    TYPE_VOID,
+    TYPE_BOOL,
+    TYPE_I8,
+    TYPE_I16,
+    TYPE_I32,
+    TYPE_I64,
+    TYPE_I128,
+    TYPE_U8,
+    TYPE_U16,
+    TYPE_U32,
+    TYPE_U64,
+    TYPE_U128,
+    TYPE_F32,
+    TYPE_F64,
+    TYPE_CHAR,
+    TYPE_STRING,
+    TYPE_POINTER,
+    TYPE_REFERENCE,
+    TYPE_ARRAY,
+    TYPE_STRUCT,
+    TYPE_CLASS,
+    TYPE_FUNCTION,
+    TYPE_UNKNOWN,
+};
+
+class ExprAST;
+
+// A type as written in the source. Named types (structs, classes, aliases and
+// generic parameters) are TYPE_UNKNOWN with a name until they are resolved.
+struct Type {
+    TypeKind kind = TypeKind::TYPE_UNKNOWN;
+    std::string name;
+    std::shared_ptr<Type> element;            // pointee, referent or array element
+    std::vector<std::shared_ptr<Type>> args;  // generic arguments, e.g. Vec<T>
+    std::shared_ptr<ExprAST> size_expr;       // array size as written
+    std::uint64_t array_size = 0;
+    bool size_known = false;
+    bool soa = false;  // array of structs stored as one array per field (@soa)
+};
+
+std::shared_ptr<Type> make_type(TypeKind kind, std::string name = "");
+std::shared_ptr<Type> make_pointer(std::shared_ptr<Type> element);
+std::string type_to_string(const Type& type);
+bool is_integer(TypeKind kind);
+bool is_signed(TypeKind kind);
+bool is_float(TypeKind kind);
+unsigned integer_bits(TypeKind kind);
+TypeKind primitive_from_name(const std::string& name);
+
+enum class ExprKind {
+    EXPR_NUMBER,
+    EXPR_BOOL,
+    EXPR_CHAR,
+    EXPR_STRING,
+    EXPR_INTERPOLATION,
+    EXPR_NULL,
+    EXPR_VARIABLE,
+    EXPR_UNARY,
+    EXPR_BINARY,
+    EXPR_ASSIGN,
+    EXPR_CALL,
+    EXPR_INDEX,
+    EXPR_MEMBER,
+    EXPR_NEW,
+    EXPR_DELETE,
+    EXPR_CAST,
+    EXPR_ARRAY,
+    EXPR_LAMBDA,
+};
+
 class ExprAST {
   public:
+    explicit ExprAST(ExprKind kind, SourceLocation loc = {}) : kind(kind), loc(loc) {}
     virtual ~ExprAST() = default;
+
+    ExprKind kind;
+    SourceLocation loc;
+    std::shared_ptr<Type> type;  // filled in by semantic analysis
 };
 
 class NumberExprAST : public ExprAST {
-    double val;
+  public:
+    NumberExprAST(std::string text, bool is_float, SourceLocation loc = {})
+        : ExprAST(ExprKind::EXPR_NUMBER, loc), text(std::move(text)), is_float(is_float) {}
+
+    std::string text;
+    bool is_float;
+};
+
+class BoolExprAST : public ExprAST {
+  public:
+    BoolExprAST(bool value, SourceLocation loc = {})
+        : ExprAST(ExprKind::EXPR_BOOL, loc), value(value) {}
+
+    bool value;
+};
 
+class CharExprAST : public ExprAST {
   public:
-    NumberExprAST(double val) : val(val) {}
+    CharExprAST(char value, SourceLocation loc = {})
+        : ExprAST(ExprKind::EXPR_CHAR, loc), value(value) {}
+
+    char value;
 };
+
+class StringExprAST : public ExprAST {
+  public:
+    StringExprAST(std::string value, SourceLocation loc = {})
+        : ExprAST(ExprKind::EXPR_STRING, loc), value(std::move(value)) {}
+
+    std::string value;  // escapes already decoded
+};
+
+// "text ${expr} text": the literal text around the expressions, one more
+// fragment than there are parts.
+class InterpolationExprAST : public ExprAST {
+  public:
+    InterpolationExprAST(std::vector<std::string> fragments,
+                         std::vector<std::unique_ptr<ExprAST>> parts, SourceLocation loc = {})
+        : ExprAST(ExprKind::EXPR_INTERPOLATION, loc),
+          fragments(std::move(fragments)),
+          parts(std::move(parts)) {}
+
+    std::vector<std::string> fragments;  // escapes already decoded
+    std::vector<std::unique_ptr<ExprAST>> parts;
+};
+
+class NullExprAST : public ExprAST {
+  public:
+    explicit NullExprAST(SourceLocation loc = {}) : ExprAST(ExprKind::EXPR_NULL, loc) {}
+};
+
 class VariableExprAST : public ExprAST {
+  public:
+    VariableExprAST(std::string name, SourceLocation loc = {})
+        : ExprAST(ExprKind::EXPR_VARIABLE, loc), name(std::move(name)) {}
+
     std::string name;
+};
 
+// Prefix operators (!, -, ~, ++, --) and postfix ++/-- (postfix == true).
+class UnaryExprAST : public ExprAST {
   public:
-    VariableExprAST(const std::string& name) : name(name) {}
+    UnaryExprAST(TokenType op, std::unique_ptr<ExprAST> operand, bool postfix = false,
+                 SourceLocation loc = {})
+        : ExprAST(ExprKind::EXPR_UNARY, loc),
+          op(op),
+          operand(std::move(operand)),
+          postfix(postfix) {}
+
+    TokenType op;
+    std::unique_ptr<ExprAST> operand;
+    bool postfix;
 };
+
 class BinaryExprAST : public ExprAST {
-    char Op;
-    std::unique_ptr<ExprAST> LHS, RHS;
+  public:
+    BinaryExprAST(TokenType op, std::unique_ptr<ExprAST> lhs, std::unique_ptr<ExprAST> rhs,
+                  SourceLocation loc = {})
+        : ExprAST(ExprKind::EXPR_BINARY, loc), op(op), lhs(std::move(lhs)), rhs(std::move(rhs)) {}
+
+    TokenType op;
+    std::unique_ptr<ExprAST> lhs, rhs;
+};
 
+// Plain and compound assignment; op is TOKEN_ASSIGN, TOKEN_PLUS_ASSIGN, ...
+class AssignExprAST : public ExprAST {
   public:
-    BinaryExprAST(char Op, std::unique_ptr<ExprAST> LHS, std::unique_ptr<ExprAST> RHS)
-        : Op(Op), LHS(std::move(LHS)), RHS(std::move(RHS)) {}
+    AssignExprAST(TokenType op, std::unique_ptr<ExprAST> target, std::unique_ptr<ExprAST> value,
+                  SourceLocation loc = {})
+        : ExprAST(ExprKind::EXPR_ASSIGN, loc),
+          op(op),
+          target(std::move(target)),
+          value(std::move(value)) {}
+
+    TokenType op;
+    std::unique_ptr<ExprAST> target, value;
 };
 
 class CallExprAST : public ExprAST {
-    std::string callee;
+  public:
+    CallExprAST(std::unique_ptr<ExprAST> callee, std::vector<std::shared_ptr<Type>> type_args,
+                std::vector<std::unique_ptr<ExprAST>> args, SourceLocation loc = {})
+        : ExprAST(ExprKind::EXPR_CALL, loc),
+          callee(std::move(callee)),
+          type_args(std::move(type_args)),
+          args(std::move(args)) {}
+
+    std::unique_ptr<ExprAST> callee;  // VariableExprAST or MemberExprAST
+    std::vector<std::shared_ptr<Type>> type_args;
     std::vector<std::unique_ptr<ExprAST>> args;
+};
 
+class IndexExprAST : public ExprAST {
   public:
-    CallExprAST(const std::string& callee, std::vector<std::unique_ptr<ExprAST>> args)
-        : callee(callee), args(std::move(args)) {}
+    IndexExprAST(std::unique_ptr<ExprAST> base, std::unique_ptr<ExprAST> index,
+                 SourceLocation loc = {})
+        : ExprAST(ExprKind::EXPR_INDEX, loc), base(std::move(base)), index(std::move(index)) {}
+
+    std::unique_ptr<ExprAST> base, index;
 };
-class PrototypeAST {
-    std::string name;
-    std::vector<std::string> args;
 
+class MemberExprAST : public ExprAST {
   public:
-    PrototypeAST(const std::string& name, std::vector<std::string> args)
-        : name(name), args(std::move(args)) {}
-    const std::string& getName() const { return name; }
+    MemberExprAST(std::unique_ptr<ExprAST> base, std::string member, SourceLocation loc = {})
+        : ExprAST(ExprKind::EXPR_MEMBER, loc), base(std::move(base)), member(std::move(member)) {}
+
+    std::unique_ptr<ExprAST> base;
+    std::string member;
 };
-class FunctionAST {
-    std::unique_ptr<PrototypeAST> proto;
-    std::unique_ptr<ExprAST> body;
 
+// new T, new T(args), new T[count] and new(arena) T(args).
+class NewExprAST : public ExprAST {
   public:
-    FunctionAST(std::unique_ptr<PrototypeAST> proto, std::unique_ptr<ExprAST> body)
-        : proto(std::move(proto)), body(std::move(body)) {}
+    NewExprAST(std::shared_ptr<Type> allocated, SourceLocation loc = {})
+        : ExprAST(ExprKind::EXPR_NEW, loc), allocated(std::move(allocated)) {}
+
+    std::shared_ptr<Type> allocated;
+    std::unique_ptr<ExprAST> arena;  // explicit arena, if any
+    std::unique_ptr<ExprAST> count;  // array form
+    std::vector<std::unique_ptr<ExprAST>> args;
+    bool has_args = false;
 };
 
-enum class TypeKind {
-    TYPE_VOID,
-    TYPE_BOOL,
-    TYPE_I8,
-    TYPE_I16,
-    TYPE_I32,
-    TYPE_I64,
-    TYPE_I128,
-    TYPE_U8,
-    TYPE_U16,
-    TYPE_U32,
-    TYPE_U64,
-    TYPE_U128,
-    TYPE_F32,
-    TYPE_F64,
-    TYPE_CHAR,
-    TYPE_STRING,
-    TYPE_POINTER,
-    TYPE_ARRAY,
-    TYPE_STRUCT,
-    TYPE_CLASS,
-    TYPE_FUNCTION,
-    TYPE_UNKNOWN,
+class DeleteExprAST : public ExprAST {
+  public:
+    DeleteExprAST(std::unique_ptr<ExprAST> operand, SourceLocation loc = {})
+        : ExprAST(ExprKind::EXPR_DELETE, loc), operand(std::move(operand)) {}
+
+    std::unique_ptr<ExprAST> operand;
 };
 
-struct Type {
-    TypeKind kind;
-    std::string name;
+class CastExprAST : public ExprAST {
+  public:
+    CastExprAST(std::shared_ptr<Type> target, std::unique_ptr<ExprAST> operand,
+                SourceLocation loc = {})
+        : ExprAST(ExprKind::EXPR_CAST, loc), target(std::move(target)), operand(std::move(operand)) {}
+
+    std::shared_ptr<Type> target;
+    std::unique_ptr<ExprAST> operand;
+};
+
+class ArrayExprAST : public ExprAST {
+  public:
+    ArrayExprAST(std::vector<std::unique_ptr<ExprAST>> elements, SourceLocation loc = {})
+        : ExprAST(ExprKind::EXPR_ARRAY, loc), elements(std::move(elements)) {}
+
+    std::vector<std::unique_ptr<ExprAST>> elements;
 };
 
 enum class NodeType {
@@ -99,5 +277,264 @@ enum class NodeType {
     NODE_BREAK,
     NODE_VAR_DECL,
     NODE_CONST,
+    NODE_EXPR,
+    NODE_IF,
+    NODE_WHILE,
+    NODE_FOR,
+    NODE_RANGE_FOR,
+    NODE_MATCH,
+    NODE_ARENA,
+    NODE_STRUCT,
+    NODE_IMPORT,
+    NODE_TYPE_ALIAS,
+};
+
+// @name or @name(args) in front of a declaration or field.
+struct Attribute {
+    std::string name;
+    std::vector<std::unique_ptr<ExprAST>> args;
+    SourceLocation loc;
 };
+
+const Attribute* find_attribute(const std::vector<Attribute>& attributes, const std::string& name);
+
+// Statements and declarations share one hierarchy; kind says which one it is.
+class StmtAST {
+  public:
+    explicit StmtAST(NodeType kind, SourceLocation loc = {}) : kind(kind), loc(loc) {}
+    virtual ~StmtAST() = default;
+
+    NodeType kind;
+    SourceLocation loc;
+    std::vector<Attribute> attributes;
+};
+
+class BlockStmtAST : public StmtAST {
+  public:
+    explicit BlockStmtAST(SourceLocation loc = {}) : StmtAST(NodeType::NODE_BLOCK, loc) {}
+
+    std::vector<std::unique_ptr<StmtAST>> statements;
+};
+
+class ExprStmtAST : public StmtAST {
+  public:
+    ExprStmtAST(std::unique_ptr<ExprAST> expr, SourceLocation loc = {})
+        : StmtAST(NodeType::NODE_EXPR, loc), expr(std::move(expr)) {}
+
+    std::unique_ptr<ExprAST> expr;
+};
+
+class ReturnStmtAST : public StmtAST {
+  public:
+    ReturnStmtAST(std::unique_ptr<ExprAST> value, SourceLocation loc = {})
+        : StmtAST(NodeType::NODE_RETURN, loc), value(std::move(value)) {}
+
+    std::unique_ptr<ExprAST> value;  // null for a bare return
+};
+
+// Variable declarations (locals and globals) and const declarations
+// (kind == NODE_CONST).
+class VarDeclAST : public StmtAST {
+  public:
+    VarDeclAST(NodeType kind, std::string name, std::shared_ptr<Type> type,
+               std::unique_ptr<ExprAST> init, SourceLocation loc = {})
+        : StmtAST(kind, loc), name(std::move(name)), type(std::move(type)), init(std::move(init)) {}
+
+    bool is_const() const { return kind == NodeType::NODE_CONST; }
+
+    std::string name;
+    std::shared_ptr<Type> type;  // null when inferred from the initializer
+    std::unique_ptr<ExprAST> init;
+};
+
+class IfStmtAST : public StmtAST {
+  public:
+    IfStmtAST(std::unique_ptr<ExprAST> cond, std::unique_ptr<StmtAST> then_branch,
+              std::unique_ptr<StmtAST> else_branch, SourceLocation loc = {})
+        : StmtAST(NodeType::NODE_IF, loc),
+          cond(std::move(cond)),
+          then_branch(std::move(then_branch)),
+          else_branch(std::move(else_branch)) {}
+
+    std::unique_ptr<ExprAST> cond;
+    std::unique_ptr<StmtAST> then_branch;
+    std::unique_ptr<StmtAST> else_branch;
+};
+
+class WhileStmtAST : public StmtAST {
+  public:
+    WhileStmtAST(std::unique_ptr<ExprAST> cond, std::unique_ptr<StmtAST> body,
+                 SourceLocation loc = {})
+        : StmtAST(NodeType::NODE_WHILE, loc), cond(std::move(cond)), body(std::move(body)) {}
+
+    std::unique_ptr<ExprAST> cond;
+    std::unique_ptr<StmtAST> body;
+};
+
+class ForStmtAST : public StmtAST {
+  public:
+    explicit ForStmtAST(SourceLocation loc = {}) : StmtAST(NodeType::NODE_FOR, loc) {}
+
+    std::unique_ptr<StmtAST> init;  // VarDeclAST or ExprStmtAST, may be null
+    std::unique_ptr<ExprAST> cond;
+    std::unique_ptr<ExprAST> step;
+    std::unique_ptr<StmtAST> body;
+};
+
+class RangeForStmtAST : public StmtAST {
+  public:
+    RangeForStmtAST(std::string var, std::unique_ptr<ExprAST> range, std::unique_ptr<StmtAST> body,
+                    SourceLocation loc = {})
+        : StmtAST(NodeType::NODE_RANGE_FOR, loc),
+          var(std::move(var)),
+          range(std::move(range)),
+          body(std::move(body)) {}
+
+    std::string var;
+    std::unique_ptr<ExprAST> range;
+    std::unique_ptr<StmtAST> body;
+    std::shared_ptr<Type> var_type;  // filled in by semantic analysis
+};
+
+enum class PatternKind {
+    PATTERN_LITERAL,
+    PATTERN_WILDCARD,
+    PATTERN_IDENTIFIER,
+};
+
+struct MatchArm {
+    PatternKind pattern = PatternKind::PATTERN_WILDCARD;
+    std::unique_ptr<ExprAST> literal;  // PATTERN_LITERAL
+    std::string binding;               // PATTERN_IDENTIFIER
+    std::unique_ptr<BlockStmtAST> body;
+    SourceLocation loc;
+};
+
+class MatchStmtAST : public StmtAST {
+  public:
+    MatchStmtAST(std::unique_ptr<ExprAST> scrutinee, SourceLocation loc = {})
+        : StmtAST(NodeType::NODE_MATCH, loc), scrutinee(std::move(scrutinee)) {}
+
+    std::unique_ptr<ExprAST> scrutinee;
+    std::vector<MatchArm> arms;
+};
+
+class ArenaStmtAST : public StmtAST {
+  public:
+    ArenaStmtAST(std::unique_ptr<ExprAST> capacity, std::unique_ptr<BlockStmtAST> body,
+                 SourceLocation loc = {})
+        : StmtAST(NodeType::NODE_ARENA, loc), capacity(std::move(capacity)), body(std::move(body)) {}
+
+    std::unique_ptr<ExprAST> capacity;  // may be null
+    std::unique_ptr<BlockStmtAST> body;
+};
+
+struct Param {
+    std::string name;
+    std::shared_ptr<Type> type;
+    SourceLocation loc;
+};
+
+struct TypeParam {
+    std::string name;
+    std::shared_ptr<Type> default_type;
+};
+
+enum class FunctionKind {
+    FUNCTION_FREE,
+    FUNCTION_METHOD,
+    FUNCTION_CONSTRUCTOR,
+    FUNCTION_DESTRUCTOR,
+};
+
+class PrototypeAST {
+  public:
+    PrototypeAST(std::string name, std::vector<Param> params, std::shared_ptr<Type> return_type)
+        : name(std::move(name)), params(std::move(params)), return_type(std::move(return_type)) {}
+    const std::string& get_name() const { return name; }
+
+    std::string name;
+    std::vector<Param> params;
+    std::shared_ptr<Type> return_type;  // void when omitted
+    std::vector<TypeParam> type_params;
+    FunctionKind function_kind = FunctionKind::FUNCTION_FREE;
+    SourceLocation loc;
+};
+
+class FunctionAST : public StmtAST {
+  public:
+    FunctionAST(std::unique_ptr<PrototypeAST> proto, std::unique_ptr<BlockStmtAST> body,
+                SourceLocation loc = {})
+        : StmtAST(NodeType::NODE_FUNCTION, loc), proto(std::move(proto)), body(std::move(body)) {}
+
+    std::unique_ptr<PrototypeAST> proto;
+    std::unique_ptr<BlockStmtAST> body;
+};
+
+// (params): T { body }
+class LambdaExprAST : public ExprAST {
+  public:
+    LambdaExprAST(std::unique_ptr<FunctionAST> function, SourceLocation loc = {})
+        : ExprAST(ExprKind::EXPR_LAMBDA, loc), function(std::move(function)) {}
+
+    std::unique_ptr<FunctionAST> function;
+};
+
+enum class Visibility {
+    VISIBILITY_PUBLIC,
+    VISIBILITY_PRIVATE,
+};
+
+struct FieldDecl {
+    std::string name;
+    std::shared_ptr<Type> type;
+    Visibility visibility = Visibility::VISIBILITY_PUBLIC;
+    SourceLocation loc;
+    std::vector<Attribute> attributes;
+};
+
+// struct and class declarations; classes may also carry methods.
+class StructDeclAST : public StmtAST {
+  public:
+    StructDeclAST(std::string name, bool is_class, SourceLocation loc = {})
+        : StmtAST(NodeType::NODE_STRUCT, loc), name(std::move(name)), is_class(is_class) {}
+
+    std::string name;
+    bool is_class;
+    std::vector<TypeParam> type_params;
+    std::vector<FieldDecl> fields;
+    std::vector<std::unique_ptr<FunctionAST>> methods;
+};
+
+class ImportAST : public StmtAST {
+  public:
+    ImportAST(std::string path, SourceLocation loc = {})
+        : StmtAST(NodeType::NODE_IMPORT, loc), path(std::move(path)) {}
+
+    std::string path;
+};
+
+class TypeAliasAST : public StmtAST {
+  public:
+    TypeAliasAST(std::string name, std::shared_ptr<Type> aliased, SourceLocation loc = {})
+        : StmtAST(NodeType::NODE_TYPE_ALIAS, loc), name(std::move(name)), aliased(std::move(aliased)) {}
+
+    std::string name;
+    std::vector<TypeParam> type_params;
+    std::shared_ptr<Type> aliased;
+};
+
+// NODE_ROOT: one parsed source file.
+class ModuleAST {
+  public:
+    std::vector<std::unique_ptr<StmtAST>> decls;
+};
+
+// Moves the declarations of `from` that an importing module can use into
+// `into`: functions, structs and classes, type aliases and constants, adding
+// each to `imported`. Imports and module variables, which stay private to their
+// module, are left behind.
+void import_declarations(ModuleAST& into, ModuleAST& from,
+                         std::unordered_set<const StmtAST*>& imported);
+
 }  // namespace pallas::frontend
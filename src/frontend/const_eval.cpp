@@ -0,0 +1,1491 @@
+#include "const_eval.h"
+#include <cmath>
+#include <utility>
+#include "support/trace.h"
+
+namespace pallas::frontend {
+
+namespace {
+
+u128 normalize(TypeKind kind, u128 raw) {
+    if (kind == TypeKind::TYPE_BOOL) {
+        return raw != 0 ? 1 : 0;
+    }
+    unsigned bits = integer_bits(kind);
+    if (bits == 0 || bits >= 128) {
+        return raw;
+    }
+    u128 mask = (static_cast<u128>(1) << bits) - 1;
+    u128 v = raw & mask;
+    if (is_signed(kind) && ((v >> (bits - 1)) & 1) != 0) {
+        v |= ~mask;
+    }
+    return v;
+}
+
+bool fits_signed(i128 v, unsigned bits) {
+    if (bits >= 128) {
+        return true;
+    }
+    i128 hi = (static_cast<i128>(1) << (bits - 1)) - 1;
+    i128 lo = -hi - 1;
+    return v >= lo && v <= hi;
+}
+
+bool fits_unsigned(u128 v, unsigned bits) {
+    if (bits >= 128) {
+        return true;
+    }
+    return v <= (static_cast<u128>(1) << bits) - 1;
+}
+
+bool fits(TypeKind kind, u128 magnitude, bool negative) {
+    unsigned bits = integer_bits(kind);
+    if (is_signed(kind)) {
+        u128 limit = static_cast<u128>(1) << (bits - 1);  // |min|
+        return negative ? magnitude <= limit : magnitude < limit;
+    }
+    return !negative || magnitude == 0 ? fits_unsigned(magnitude, bits) : false;
+}
+
+std::string u128_to_string(u128 v) {
+    if (v == 0) {
+        return "0";
+    }
+    std::string out;
+    while (v != 0) {
+        out.push_back(static_cast<char>('0' + static_cast<int>(v % 10)));
+        v /= 10;
+    }
+    return {out.rbegin(), out.rend()};
+}
+
+std::string kind_name(TypeKind kind) {
+    Type t;
+    t.kind = kind;
+    return type_to_string(t);
+}
+
+const char* op_text(TokenType op) {
+    switch (op) {
+        case TokenType::TOKEN_PLUS: return "+";
+        case TokenType::TOKEN_MINUS: return "-";
+        case TokenType::TOKEN_STAR: return "*";
+        case TokenType::TOKEN_SLASH: return "/";
+        case TokenType::TOKEN_PERCENT: return "%";
+        case TokenType::TOKEN_LEFT_SHIFT: return "<<";
+        case TokenType::TOKEN_RIGHT_SHIFT: return ">>";
+        case TokenType::TOKEN_AMPERSAND: return "&";
+        case TokenType::TOKEN_PIPE: return "|";
+        case TokenType::TOKEN_CARET: return "^";
+        default: return "?";
+    }
+}
+
+bool is_comparison(TokenType op) {
+    switch (op) {
+        case TokenType::TOKEN_EQUAL:
+        case TokenType::TOKEN_NOT_EQUAL:
+        case TokenType::TOKEN_LESS:
+        case TokenType::TOKEN_LESS_EQUAL:
+        case TokenType::TOKEN_GREATER:
+        case TokenType::TOKEN_GREATER_EQUAL:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool is_shift(TokenType op) {
+    return op == TokenType::TOKEN_LEFT_SHIFT || op == TokenType::TOKEN_RIGHT_SHIFT;
+}
+
+bool is_untyped_literal(const ExprAST& expr) {
+    if (expr.kind == ExprKind::EXPR_NUMBER) {
+        return true;
+    }
+    if (expr.kind == ExprKind::EXPR_UNARY) {
+        const auto& u = static_cast<const UnaryExprAST&>(expr);
+        return u.op == TokenType::TOKEN_MINUS && u.operand->kind == ExprKind::EXPR_NUMBER;
+    }
+    return false;
+}
+
+bool is_scalar(TypeKind kind) {
+    return is_integer(kind) || is_float(kind) || kind == TypeKind::TYPE_BOOL ||
+           kind == TypeKind::TYPE_CHAR || kind == TypeKind::TYPE_STRING;
+}
+
+std::size_t value_size(const ConstValue& v) {
+    if (v.type == TypeKind::TYPE_STRING) {
+        return sizeof(std::string) + v.text.size();
+    }
+    if (v.type == TypeKind::TYPE_F32) {
+        return 4;
+    }
+    if (v.type == TypeKind::TYPE_F64) {
+        return 8;
+    }
+    unsigned bits = integer_bits(v.type);
+    return bits <= 8 ? 1 : bits / 8;
+}
+
+TokenType compound_to_binary(TokenType op) {
+    switch (op) {
+        case TokenType::TOKEN_PLUS_ASSIGN: return TokenType::TOKEN_PLUS;
+        case TokenType::TOKEN_MINUS_ASSIGN: return TokenType::TOKEN_MINUS;
+        case TokenType::TOKEN_STAR_ASSIGN: return TokenType::TOKEN_STAR;
+        case TokenType::TOKEN_SLASH_ASSIGN: return TokenType::TOKEN_SLASH;
+        default: return op;
+    }
+}
+
+}  // namespace
+
+ConstValue ConstValue::make_int(TypeKind type, u128 raw) {
+    ConstValue v;
+    v.type = type;
+    v.bits = normalize(type, raw);
+    return v;
+}
+
+ConstValue ConstValue::make_bool(bool value) {
+    ConstValue v;
+    v.type = TypeKind::TYPE_BOOL;
+    v.bits = value ? 1 : 0;
+    return v;
+}
+
+ConstValue ConstValue::make_float(TypeKind type, double value) {
+    ConstValue v;
+    v.type = type;
+    v.real = type == TypeKind::TYPE_F32 ? static_cast<double>(static_cast<float>(value)) : value;
+    return v;
+}
+
+ConstValue ConstValue::make_string(std::string value) {
+    ConstValue v;
+    v.type = TypeKind::TYPE_STRING;
+    v.text = std::move(value);
+    return v;
+}
+
+std::string ConstValue::to_string() const {
+    if (type == TypeKind::TYPE_BOOL) {
+        return bits != 0 ? "true" : "false";
+    }
+    if (type == TypeKind::TYPE_CHAR) {
+        return std::string("'") + static_cast<char>(bits) + "'";
+    }
+    if (type == TypeKind::TYPE_STRING) {
+        return "\"" + text + "\"";
+    }
+    if (type == TypeKind::TYPE_POINTER) {
+        return "null";
+    }
+    if (is_float(type)) {
+        std::string out = std::to_string(real);
+        return out;
+    }
+    if (is_signed(type) && as_signed() < 0) {
+        return "-" + u128_to_string(static_cast<u128>(0) - bits);
+    }
+    return u128_to_string(bits);
+}
+
+bool operator==(const ConstValue& a, const ConstValue& b) {
+    if (a.type != b.type) {
+        return false;
+    }
+    if (is_float(a.type)) {
+        return a.real == b.real;
+    }
+    if (a.type == TypeKind::TYPE_STRING) {
+        return a.text == b.text;
+    }
+    return a.bits == b.bits;
+}
+
+ConstEvaluator::ConstEvaluator(const ModuleAST& module, Diagnostics* diagnostics,
+                               ConstEvalLimits limits)
+    : module(module), diagnostics(diagnostics), limits(limits) {
+    for (const auto& decl : module.decls) {
+        if (decl->kind == NodeType::NODE_CONST) {
+            const auto* var = static_cast<const VarDeclAST*>(decl.get());
+            ConstEntry entry;
+            entry.decl = var;
+            consts.emplace(var->name, entry);
+        } else if (decl->kind == NodeType::NODE_FUNCTION) {
+            const auto* fn = static_cast<const FunctionAST*>(decl.get());
+            functions.emplace(fn->proto->name, fn);
+        }
+    }
+}
+
+void ConstEvaluator::report(ErrorCode code, const std::string& msg, SourceLocation loc) {
+    if (quiet > 0) {
+        return;
+    }
+    error_count++;
+    if (diagnostics != nullptr) {
+        diagnostics->report(Severity::Error, code, msg, "", loc.offset, 0, loc.line, loc.column);
+    }
+}
+
+bool ConstEvaluator::step(SourceLocation loc) {
+    if (++eval_stats.steps <= limits.max_steps) {
+        return true;
+    }
+    if (!budget_reported && quiet == 0) {
+        budget_reported = true;
+        report(ErrorCode::E305_CONST_BUDGET_EXCEEDED,
+               "constant evaluation exceeded the step limit of " +
+                   std::to_string(limits.max_steps),
+               loc);
+    }
+    return false;
+}
+
+bool ConstEvaluator::reserve_memory(std::size_t bytes, SourceLocation loc) {
+    if (memory_used + bytes > limits.max_memory_bytes) {
+        report(ErrorCode::E305_CONST_BUDGET_EXCEEDED,
+               "constant evaluation exceeded the memory limit of " +
+                   std::to_string(limits.max_memory_bytes) + " bytes",
+               loc);
+        return false;
+    }
+    memory_used += bytes;
+    if (memory_used > eval_stats.peak_memory_bytes) {
+        eval_stats.peak_memory_bytes = memory_used;
+    }
+    return true;
+}
+
+void ConstEvaluator::push_scope() {
+    frames.back().scopes.emplace_back();
+}
+
+void ConstEvaluator::pop_scope() {
+    for (const auto& [name, local] : frames.back().scopes.back()) {
+        memory_used -= value_size(local.value);
+    }
+    frames.back().scopes.pop_back();
+}
+
+ConstEvaluator::Local* ConstEvaluator::lookup_local(const std::string& name) {
+    if (frames.empty()) {
+        return nullptr;
+    }
+    auto& scopes = frames.back().scopes;
+    for (auto it = scopes.rbegin(); it != scopes.rend(); ++it) {
+        auto found = it->find(name);
+        if (found != it->end()) {
+            return &found->second;
+        }
+    }
+    return nullptr;
+}
+
+bool ConstEvaluator::declare_local(const std::string& name, ConstValue value, bool is_const,
+                                   SourceLocation loc) {
+    if (!reserve_memory(value_size(value), loc)) {
+        return false;
+    }
+    auto& scope = frames.back().scopes.back();
+    auto existing = scope.find(name);
+    if (existing != scope.end()) {
+        memory_used -= value_size(existing->second.value);
+    }
+    scope[name] = Local{std::move(value), is_const};
+    return true;
+}
+
+std::optional<ConstValue> ConstEvaluator::evaluate_const(const std::string& name) {
+    auto it = consts.find(name);
+    if (it == consts.end()) {
+        report(ErrorCode::E301_NOT_CONSTANT, "'" + name + "' is not a constant", {});
+        return std::nullopt;
+    }
+    ConstEntry& entry = it->second;
+    switch (entry.state) {
+        case ConstState::Done:
+            eval_stats.const_cache_hits++;
+            return entry.value;
+        case ConstState::Failed:
+            return std::nullopt;
+        case ConstState::InProgress:
+            report(ErrorCode::E304_CONST_CYCLE, "constant '" + name + "' depends on itself",
+                   entry.decl->loc);
+            return std::nullopt;
+        case ConstState::Unevaluated:
+            break;
+    }
+
+    entry.state = ConstState::InProgress;
+    const VarDeclAST& decl = *entry.decl;
+    // Const initializers never see the locals of whatever is being evaluated.
+    std::vector<Frame> saved;
+    saved.swap(frames);
+    std::optional<ConstValue> value;
+    if (decl.type && !is_scalar(decl.type->kind)) {
+        report(ErrorCode::E301_NOT_CONSTANT,
+               "constant '" + name + "' has non-scalar type '" + type_to_string(*decl.type) + "'",
+               decl.loc);
+    } else {
+        value = eval(*decl.init, decl.type.get());
+        if (value && decl.type && value->type != decl.type->kind) {
+            report(ErrorCode::E307_CONST_TYPE_MISMATCH,
+                   "constant '" + name + "' has type '" + type_to_string(*decl.type) +
+                       "' but its initializer has type '" + kind_name(value->type) + "'",
+                   decl.init->loc);
+            value.reset();
+        }
+    }
+    frames.swap(saved);
+
+    // The entry may have been looked up again through a cycle; re-find it.
+    ConstEntry& done = consts.find(name)->second;
+    if (value) {
+        done.state = ConstState::Done;
+        done.value = *value;
+    } else {
+        done.state = ConstState::Failed;
+    }
+    return value;
+}
+
+std::optional<ConstValue> ConstEvaluator::evaluate(const ExprAST& expr, const Type* expected) {
+    return eval(expr, expected);
+}
+
+void ConstEvaluator::evaluate_all() {
+    support::TraceScope trace("const-eval");
+    for (const auto& decl : module.decls) {
+        if (decl->kind == NodeType::NODE_CONST) {
+            evaluate_const(static_cast<const VarDeclAST&>(*decl).name);
+        }
+    }
+}
+
+std::optional<ConstValue> ConstEvaluator::eval(const ExprAST& expr, const Type* expected) {
+    if (!step(expr.loc)) {
+        return std::nullopt;
+    }
+    switch (expr.kind) {
+        case ExprKind::EXPR_NUMBER:
+            return eval_number(static_cast<const NumberExprAST&>(expr), expected);
+        case ExprKind::EXPR_BOOL:
+            return ConstValue::make_bool(static_cast<const BoolExprAST&>(expr).value);
+        case ExprKind::EXPR_CHAR:
+            return ConstValue::make_int(
+                TypeKind::TYPE_CHAR,
+                static_cast<unsigned char>(static_cast<const CharExprAST&>(expr).value));
+        case ExprKind::EXPR_STRING:
+            return ConstValue::make_string(static_cast<const StringExprAST&>(expr).value);
+        case ExprKind::EXPR_NULL:
+            // The one constant pointer, and only where a pointer is expected.
+            if (expected != nullptr && expected->kind == TypeKind::TYPE_POINTER) {
+                return ConstValue::make_int(TypeKind::TYPE_POINTER, 0);
+            }
+            report(ErrorCode::E307_CONST_TYPE_MISMATCH,
+                   "'null' is a constant only where a pointer is expected", expr.loc);
+            return std::nullopt;
+        case ExprKind::EXPR_VARIABLE:
+            return eval_variable(static_cast<const VariableExprAST&>(expr));
+        case ExprKind::EXPR_UNARY:
+            return eval_unary(static_cast<const UnaryExprAST&>(expr), expected);
+        case ExprKind::EXPR_BINARY:
+            return eval_binary(static_cast<const BinaryExprAST&>(expr), expected);
+        case ExprKind::EXPR_ASSIGN:
+            return eval_assign(static_cast<const AssignExprAST&>(expr));
+        case ExprKind::EXPR_CALL:
+            return eval_call(static_cast<const CallExprAST&>(expr));
+        case ExprKind::EXPR_CAST:
+            return eval_cast(static_cast<const CastExprAST&>(expr));
+        default:
+            report(ErrorCode::E301_NOT_CONSTANT, "expression is not a compile-time constant",
+                   expr.loc);
+            return std::nullopt;
+    }
+}
+
+std::optional<ConstValue> ConstEvaluator::eval_number(const NumberExprAST& expr,
+                                                      const Type* expected) {
+    TypeKind hint = expected != nullptr ? expected->kind : TypeKind::TYPE_UNKNOWN;
+    if (expr.is_float || is_float(hint)) {
+        TypeKind kind = hint == TypeKind::TYPE_F32 ? TypeKind::TYPE_F32 : TypeKind::TYPE_F64;
+        return ConstValue::make_float(kind, std::strtod(expr.text.c_str(), nullptr));
+    }
+
+    const std::string& text = expr.text;
+    unsigned base = 10;
+    std::size_t i = 0;
+    if (text.size() > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X')) {
+        base = 16;
+        i = 2;
+    }
+    u128 value = 0;
+    for (; i < text.size(); ++i) {
+        char c = text[i];
+        unsigned digit = 0;
+        if (c >= '0' && c <= '9') {
+            digit = c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            digit = c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+            digit = c - 'A' + 10;
+        } else {
+            continue;
+        }
+        u128 next = 0;
+        if (__builtin_mul_overflow(value, static_cast<u128>(base), &next) ||
+            __builtin_add_overflow(next, static_cast<u128>(digit), &next)) {
+            report(ErrorCode::E302_CONST_OVERFLOW, "integer literal '" + text + "' is too large",
+                   expr.loc);
+            return std::nullopt;
+        }
+        value = next;
+    }
+
+    TypeKind kind = is_integer(hint) ? hint : TypeKind::TYPE_I64;
+    if (!fits(kind, value, false)) {
+        report(ErrorCode::E302_CONST_OVERFLOW,
+               "literal " + text + " does not fit in '" + kind_name(kind) + "'", expr.loc);
+        return std::nullopt;
+    }
+    return ConstValue::make_int(kind, value);
+}
+
+std::optional<ConstValue> ConstEvaluator::eval_variable(const VariableExprAST& expr) {
+    if (Local* local = lookup_local(expr.name)) {
+        return local->value;
+    }
+    if (consts.count(expr.name) != 0) {
+        auto value = evaluate_const(expr.name);
+        return value;
+    }
+    report(ErrorCode::E301_NOT_CONSTANT, "'" + expr.name + "' is not a compile-time constant",
+           expr.loc);
+    return std::nullopt;
+}
+
+std::optional<ConstValue> ConstEvaluator::eval_unary(const UnaryExprAST& expr,
+                                                     const Type* expected) {
+    if (expr.op == TokenType::TOKEN_PLUS_PLUS || expr.op == TokenType::TOKEN_MINUS_MINUS) {
+        if (expr.operand->kind != ExprKind::EXPR_VARIABLE) {
+            report(ErrorCode::E301_NOT_CONSTANT, "expression is not a compile-time constant",
+                   expr.loc);
+            return std::nullopt;
+        }
+        const auto& var = static_cast<const VariableExprAST&>(*expr.operand);
+        Local* local = lookup_local(var.name);
+        if (local == nullptr || local->is_const) {
+            report(ErrorCode::E301_NOT_CONSTANT,
+                   "cannot modify '" + var.name + "' in a constant context", expr.loc);
+            return std::nullopt;
+        }
+        if (!is_integer(local->value.type)) {
+            report(ErrorCode::E307_CONST_TYPE_MISMATCH,
+                   "'++' and '--' need an integer operand, found '" +
+                       kind_name(local->value.type) + "'",
+                   expr.loc);
+            return std::nullopt;
+        }
+        ConstValue old = local->value;
+        TokenType op =
+            expr.op == TokenType::TOKEN_PLUS_PLUS ? TokenType::TOKEN_PLUS : TokenType::TOKEN_MINUS;
+        auto updated = apply_integer(op, old, ConstValue::make_int(old.type, 1), expr.loc);
+        if (!updated) {
+            return std::nullopt;
+        }
+        // Re-lookup: apply_integer does not touch locals, but keep the pattern safe.
+        lookup_local(var.name)->value = *updated;
+        return expr.postfix ? old : *updated;
+    }
+
+    if (expr.op == TokenType::TOKEN_MINUS && expr.operand->kind == ExprKind::EXPR_NUMBER &&
+        !static_cast<const NumberExprAST&>(*expr.operand).is_float &&
+        (expected == nullptr || !is_float(expected->kind))) {
+        // Negative literals are checked as a whole so that -128 fits in i8.
+        TypeKind kind =
+            expected != nullptr && is_integer(expected->kind) ? expected->kind : TypeKind::TYPE_I64;
+        Type magnitude_type;
+        magnitude_type.kind = TypeKind::TYPE_U128;
+        auto magnitude = eval_number(static_cast<const NumberExprAST&>(*expr.operand),
+                                     &magnitude_type);
+        if (!magnitude) {
+            return std::nullopt;
+        }
+        if (!fits(kind, magnitude->bits, true)) {
+            report(ErrorCode::E302_CONST_OVERFLOW,
+                   "literal -" + static_cast<const NumberExprAST&>(*expr.operand).text +
+                       " does not fit in '" + kind_name(kind) + "'",
+                   expr.loc);
+            return std::nullopt;
+        }
+        return ConstValue::make_int(kind, static_cast<u128>(0) - magnitude->bits);
+    }
+
+    auto operand = eval(*expr.operand, expected);
+    if (!operand) {
+        return std::nullopt;
+    }
+    TypeKind kind = operand->type;
+    switch (expr.op) {
+        case TokenType::TOKEN_MINUS:
+            if (is_float(kind)) {
+                return ConstValue::make_float(kind, -operand->real);
+            }
+            if (is_integer(kind)) {
+                return apply_integer(TokenType::TOKEN_MINUS, ConstValue::make_int(kind, 0),
+                                     *operand, expr.loc);
+            }
+            break;
+        case TokenType::TOKEN_LOGICAL_NOT:
+            if (kind == TypeKind::TYPE_BOOL) {
+                return ConstValue::make_bool(!operand->as_bool());
+            }
+            break;
+        case TokenType::TOKEN_TILDE:
+            if (is_integer(kind)) {
+                return ConstValue::make_int(kind, ~operand->bits);
+            }
+            break;
+        default:
+            break;
+    }
+    report(ErrorCode::E307_CONST_TYPE_MISMATCH,
+           "invalid operand type '" + kind_name(kind) + "' for unary operator", expr.loc);
+    return std::nullopt;
+}
+
+std::optional<ConstValue> ConstEvaluator::eval_binary(const BinaryExprAST& expr,
+                                                      const Type* expected) {
+    if (expr.op == TokenType::TOKEN_LOGICAL_AND || expr.op == TokenType::TOKEN_LOGICAL_OR) {
+        auto lhs = eval(*expr.lhs, nullptr);
+        if (!lhs) {
+            return std::nullopt;
+        }
+        if (lhs->type != TypeKind::TYPE_BOOL) {
+            report(ErrorCode::E307_CONST_TYPE_MISMATCH,
+                   "logical operator needs 'bool', found '" + kind_name(lhs->type) + "'",
+                   expr.lhs->loc);
+            return std::nullopt;
+        }
+        bool is_and = expr.op == TokenType::TOKEN_LOGICAL_AND;
+        if (lhs->as_bool() != is_and) {
+            return lhs;
+        }
+        auto rhs = eval(*expr.rhs, nullptr);
+        if (rhs && rhs->type != TypeKind::TYPE_BOOL) {
+            report(ErrorCode::E307_CONST_TYPE_MISMATCH,
+                   "logical operator needs 'bool', found '" + kind_name(rhs->type) + "'",
+                   expr.rhs->loc);
+            return std::nullopt;
+        }
+        return rhs;
+    }
+
+    const Type* hint = is_comparison(expr.op) ? nullptr : expected;
+    if (hint != nullptr && !is_scalar(hint->kind)) {
+        hint = nullptr;
+    }
+    std::optional<ConstValue> lhs;
+    std::optional<ConstValue> rhs;
+    if (is_shift(expr.op)) {
+        lhs = eval(*expr.lhs, hint);
+        if (!lhs) {
+            return std::nullopt;
+        }
+        rhs = eval(*expr.rhs, nullptr);
+    } else if (is_untyped_literal(*expr.lhs) && !is_untyped_literal(*expr.rhs)) {
+        // Let the literal take the type of the other operand.
+        rhs = eval(*expr.rhs, hint);
+        if (!rhs) {
+            return std::nullopt;
+        }
+        Type rhs_type;
+        rhs_type.kind = rhs->type;
+        lhs = eval(*expr.lhs, &rhs_type);
+    } else {
+        lhs = eval(*expr.lhs, hint);
+        if (!lhs) {
+            return std::nullopt;
+        }
+        Type lhs_type;
+        lhs_type.kind = lhs->type;
+        rhs = eval(*expr.rhs, &lhs_type);
+    }
+    if (!lhs || !rhs) {
+        return std::nullopt;
+    }
+    return apply_binary(expr.op, *lhs, *rhs, expr.loc);
+}
+
+std::optional<ConstValue> ConstEvaluator::apply_binary(TokenType op, const ConstValue& lhs,
+                                                       const ConstValue& rhs, SourceLocation loc) {
+    if (!is_shift(op) && lhs.type != rhs.type) {
+        report(ErrorCode::E307_CONST_TYPE_MISMATCH,
+               "mismatched types '" + kind_name(lhs.type) + "' and '" + kind_name(rhs.type) + "'",
+               loc);
+        return std::nullopt;
+    }
+    TypeKind kind = lhs.type;
+
+    if (is_integer(kind)) {
+        return apply_integer(op, lhs, rhs, loc);
+    }
+
+    if (is_float(kind)) {
+        double a = lhs.real;
+        double b = rhs.real;
+        switch (op) {
+            case TokenType::TOKEN_PLUS: return ConstValue::make_float(kind, a + b);
+            case TokenType::TOKEN_MINUS: return ConstValue::make_float(kind, a - b);
+            case TokenType::TOKEN_STAR: return ConstValue::make_float(kind, a * b);
+            case TokenType::TOKEN_SLASH: return ConstValue::make_float(kind, a / b);
+            case TokenType::TOKEN_PERCENT: return ConstValue::make_float(kind, std::fmod(a, b));
+            case TokenType::TOKEN_EQUAL: return ConstValue::make_bool(a == b);
+            case TokenType::TOKEN_NOT_EQUAL: return ConstValue::make_bool(a != b);
+            case TokenType::TOKEN_LESS: return ConstValue::make_bool(a < b);
+            case TokenType::TOKEN_LESS_EQUAL: return ConstValue::make_bool(a <= b);
+            case TokenType::TOKEN_GREATER: return ConstValue::make_bool(a > b);
+            case TokenType::TOKEN_GREATER_EQUAL: return ConstValue::make_bool(a >= b);
+            default: break;
+        }
+    } else if (kind == TypeKind::TYPE_BOOL || kind == TypeKind::TYPE_CHAR) {
+        switch (op) {
+            case TokenType::TOKEN_EQUAL: return ConstValue::make_bool(lhs.bits == rhs.bits);
+            case TokenType::TOKEN_NOT_EQUAL: return ConstValue::make_bool(lhs.bits != rhs.bits);
+            default: break;
+        }
+        if (kind == TypeKind::TYPE_CHAR) {
+            switch (op) {
+                case TokenType::TOKEN_LESS: return ConstValue::make_bool(lhs.bits < rhs.bits);
+                case TokenType::TOKEN_LESS_EQUAL: return ConstValue::make_bool(lhs.bits <= rhs.bits);
+                case TokenType::TOKEN_GREATER: return ConstValue::make_bool(lhs.bits > rhs.bits);
+                case TokenType::TOKEN_GREATER_EQUAL:
+                    return ConstValue::make_bool(lhs.bits >= rhs.bits);
+                default: break;
+            }
+        } else {
+            switch (op) {
+                case TokenType::TOKEN_AMPERSAND: return ConstValue::make_bool(lhs.bits & rhs.bits);
+                case TokenType::TOKEN_PIPE: return ConstValue::make_bool(lhs.bits | rhs.bits);
+                case TokenType::TOKEN_CARET: return ConstValue::make_bool(lhs.bits ^ rhs.bits);
+                default: break;
+            }
+        }
+    } else if (kind == TypeKind::TYPE_STRING) {
+        switch (op) {
+            case TokenType::TOKEN_PLUS: {
+                std::size_t size = lhs.text.size() + rhs.text.size();
+                if (size > limits.max_memory_bytes) {
+                    report(ErrorCode::E305_CONST_BUDGET_EXCEEDED,
+                           "constant string exceeds the memory limit of " +
+                               std::to_string(limits.max_memory_bytes) + " bytes",
+                           loc);
+                    return std::nullopt;
+                }
+                return ConstValue::make_string(lhs.text + rhs.text);
+            }
+            case TokenType::TOKEN_EQUAL: return ConstValue::make_bool(lhs.text == rhs.text);
+            case TokenType::TOKEN_NOT_EQUAL: return ConstValue::make_bool(lhs.text != rhs.text);
+            default: break;
+        }
+    }
+    report(ErrorCode::E307_CONST_TYPE_MISMATCH,
+           "invalid operand type '" + kind_name(kind) + "' for binary operator", loc);
+    return std::nullopt;
+}
+
+std::optional<ConstValue> ConstEvaluator::apply_integer(TokenType op, const ConstValue& lhs,
+                                                        const ConstValue& rhs, SourceLocation loc) {
+    TypeKind kind = lhs.type;
+    unsigned bits = integer_bits(kind);
+    bool sign = is_signed(kind);
+
+    auto overflow = [&]() -> std::optional<ConstValue> {
+        report(ErrorCode::E302_CONST_OVERFLOW,
+               "result of " + lhs.to_string() + " " + op_text(op) + " " + rhs.to_string() +
+                   " overflows '" + kind_name(kind) + "'",
+               loc);
+        return std::nullopt;
+    };
+
+    if (is_comparison(op)) {
+        bool result = false;
+        bool lt = sign ? lhs.as_signed() < rhs.as_signed() : lhs.bits < rhs.bits;
+        bool eq = lhs.bits == rhs.bits;
+        switch (op) {
+            case TokenType::TOKEN_EQUAL: result = eq; break;
+            case TokenType::TOKEN_NOT_EQUAL: result = !eq; break;
+            case TokenType::TOKEN_LESS: result = lt; break;
+            case TokenType::TOKEN_LESS_EQUAL: result = lt || eq; break;
+            case TokenType::TOKEN_GREATER: result = !lt && !eq; break;
+            case TokenType::TOKEN_GREATER_EQUAL: result = !lt; break;
+            default: break;
+        }
+        return ConstValue::make_bool(result);
+    }
+
+    switch (op) {
+        case TokenType::TOKEN_PLUS:
+        case TokenType::TOKEN_MINUS:
+        case TokenType::TOKEN_STAR: {
+            if (sign) {
+                i128 a = lhs.as_signed();
+                i128 b = rhs.as_signed();
+                i128 r = 0;
+                bool ovf = op == TokenType::TOKEN_PLUS    ? __builtin_add_overflow(a, b, &r)
+                           : op == TokenType::TOKEN_MINUS ? __builtin_sub_overflow(a, b, &r)
+                                                          : __builtin_mul_overflow(a, b, &r);
+                if (ovf || !fits_signed(r, bits)) {
+                    return overflow();
+                }
+                return ConstValue::make_int(kind, static_cast<u128>(r));
+            }
+            u128 a = lhs.bits;
+            u128 b = rhs.bits;
+            u128 r = 0;
+            bool ovf = op == TokenType::TOKEN_PLUS    ? __builtin_add_overflow(a, b, &r)
+                       : op == TokenType::TOKEN_MINUS ? __builtin_sub_overflow(a, b, &r)
+                                                      : __builtin_mul_overflow(a, b, &r);
+            if (ovf || !fits_unsigned(r, bits)) {
+                return overflow();
+            }
+            return ConstValue::make_int(kind, r);
+        }
+        case TokenType::TOKEN_SLASH:
+        case TokenType::TOKEN_PERCENT: {
+            if (rhs.bits == 0) {
+                report(ErrorCode::E303_CONST_DIVISION_BY_ZERO,
+                       std::string(op == TokenType::TOKEN_SLASH ? "division" : "remainder") +
+                           " by zero in constant expression",
+                       loc);
+                return std::nullopt;
+            }
+            bool div = op == TokenType::TOKEN_SLASH;
+            if (sign) {
+                i128 a = lhs.as_signed();
+                i128 b = rhs.as_signed();
+                i128 min = bits >= 128 ? static_cast<i128>(static_cast<u128>(1) << 127)
+                                       : -(static_cast<i128>(1) << (bits - 1));
+                if (a == min && b == -1) {
+                    return overflow();
+                }
+                return ConstValue::make_int(kind, static_cast<u128>(div ? a / b : a % b));
+            }
+            return ConstValue::make_int(kind, div ? lhs.bits / rhs.bits : lhs.bits % rhs.bits);
+        }
+        case TokenType::TOKEN_AMPERSAND:
+            return ConstValue::make_int(kind, lhs.bits & rhs.bits);
+        case TokenType::TOKEN_PIPE:
+            return ConstValue::make_int(kind, lhs.bits | rhs.bits);
+        case TokenType::TOKEN_CARET:
+            return ConstValue::make_int(kind, lhs.bits ^ rhs.bits);
+        case TokenType::TOKEN_LEFT_SHIFT:
+        case TokenType::TOKEN_RIGHT_SHIFT: {
+            if (!is_integer(rhs.type)) {
+                report(ErrorCode::E307_CONST_TYPE_MISMATCH,
+                       "shift amount must be an integer, found '" + kind_name(rhs.type) + "'",
+                       loc);
+                return std::nullopt;
+            }
+            if ((is_signed(rhs.type) && rhs.as_signed() < 0) || rhs.bits >= bits) {
+                report(ErrorCode::E302_CONST_OVERFLOW,
+                       "shift amount " + rhs.to_string() + " is out of range for '" +
+                           kind_name(kind) + "'",
+                       loc);
+                return std::nullopt;
+            }
+            auto amount = static_cast<unsigned>(rhs.bits);
+            if (op == TokenType::TOKEN_LEFT_SHIFT) {
+                return ConstValue::make_int(kind, lhs.bits << amount);
+            }
+            if (sign) {
+                return ConstValue::make_int(kind, static_cast<u128>(lhs.as_signed() >> amount));
+            }
+            return ConstValue::make_int(kind, lhs.bits >> amount);
+        }
+        default:
+            break;
+    }
+    report(ErrorCode::E307_CONST_TYPE_MISMATCH,
+           "invalid operand type '" + kind_name(kind) + "' for binary operator", loc);
+    return std::nullopt;
+}
+
+std::optional<ConstValue> ConstEvaluator::eval_assign(const AssignExprAST& expr) {
+    if (expr.target->kind != ExprKind::EXPR_VARIABLE) {
+        report(ErrorCode::E301_NOT_CONSTANT, "expression is not a compile-time constant",
+               expr.loc);
+        return std::nullopt;
+    }
+    const auto& var = static_cast<const VariableExprAST&>(*expr.target);
+    Local* local = lookup_local(var.name);
+    if (local == nullptr || local->is_const) {
+        report(ErrorCode::E301_NOT_CONSTANT,
+               "cannot assign to '" + var.name + "' in a constant context", expr.loc);
+        return std::nullopt;
+    }
+    Type target_type;
+    target_type.kind = local->value.type;
+    auto value = eval(*expr.value, &target_type);
+    if (!value) {
+        return std::nullopt;
+    }
+    local = lookup_local(var.name);
+    if (expr.op != TokenType::TOKEN_ASSIGN) {
+        value = apply_binary(compound_to_binary(expr.op), local->value, *value, expr.loc);
+        if (!value) {
+            return std::nullopt;
+        }
+    } else if (value->type != local->value.type) {
+        report(ErrorCode::E307_CONST_TYPE_MISMATCH,
+               "cannot assign '" + kind_name(value->type) + "' to '" + var.name + "' of type '" +
+                   kind_name(local->value.type) + "'",
+               expr.loc);
+        return std::nullopt;
+    }
+    std::size_t old_size = value_size(local->value);
+    std::size_t new_size = value_size(*value);
+    if (new_size > old_size && !reserve_memory(new_size - old_size, expr.loc)) {
+        return std::nullopt;
+    }
+    if (new_size < old_size) {
+        memory_used -= old_size - new_size;
+    }
+    local->value = *value;
+    return value;
+}
+
+std::optional<ConstValue> ConstEvaluator::eval_call(const CallExprAST& expr) {
+    if (expr.callee->kind != ExprKind::EXPR_VARIABLE || !expr.type_args.empty()) {
+        report(ErrorCode::E301_NOT_CONSTANT, "call cannot be evaluated at compile time", expr.loc);
+        return std::nullopt;
+    }
+    const std::string& name = static_cast<const VariableExprAST&>(*expr.callee).name;
+    auto fn_it = functions.find(name);
+    if (fn_it == functions.end()) {
+        report(ErrorCode::E301_NOT_CONSTANT,
+               "'" + name + "' is not a function that can be evaluated at compile time", expr.loc);
+        return std::nullopt;
+    }
+    const FunctionAST& fn = *fn_it->second;
+    const PrototypeAST& proto = *fn.proto;
+    if (!proto.type_params.empty()) {
+        report(ErrorCode::E301_NOT_CONSTANT,
+               "generic function '" + name + "' cannot be evaluated at compile time", expr.loc);
+        return std::nullopt;
+    }
+    if (proto.params.size() != expr.args.size()) {
+        report(ErrorCode::E307_CONST_TYPE_MISMATCH,
+               "'" + name + "' expects " + std::to_string(proto.params.size()) +
+                   " arguments, found " + std::to_string(expr.args.size()),
+               expr.loc);
+        return std::nullopt;
+    }
+
+    std::vector<ConstValue> args;
+    args.reserve(expr.args.size());
+    std::string key = name;
+    for (std::size_t i = 0; i < expr.args.size(); ++i) {
+        const Type& param_type = *proto.params[i].type;
+        if (!is_scalar(param_type.kind)) {
+            report(ErrorCode::E301_NOT_CONSTANT,
+                   "'" + name + "' takes a parameter of type '" + type_to_string(param_type) +
+                       "' and cannot be evaluated at compile time",
+                   expr.loc);
+            return std::nullopt;
+        }
+        auto arg = eval(*expr.args[i], &param_type);
+        if (!arg) {
+            return std::nullopt;
+        }
+        if (arg->type != param_type.kind) {
+            report(ErrorCode::E307_CONST_TYPE_MISMATCH,
+                   "argument " + std::to_string(i + 1) + " of '" + name + "' expects '" +
+                       type_to_string(param_type) + "', found '" + kind_name(arg->type) + "'",
+                   expr.args[i]->loc);
+            return std::nullopt;
+        }
+        key.push_back('\x1f');
+        key.append(std::to_string(static_cast<int>(arg->type)));
+        key.push_back(':');
+        key.append(is_float(arg->type) ? std::to_string(arg->real)
+                   : arg->type == TypeKind::TYPE_STRING ? arg->text
+                                                        : u128_to_string(arg->bits));
+        args.push_back(std::move(*arg));
+    }
+
+    auto cached = call_cache.find(key);
+    if (cached != call_cache.end()) {
+        eval_stats.call_cache_hits++;
+        return cached->second;
+    }
+
+    if (frames.size() >= limits.max_call_depth) {
+        report(ErrorCode::E305_CONST_BUDGET_EXCEEDED,
+               "constant evaluation exceeded the call depth limit of " +
+                   std::to_string(limits.max_call_depth),
+               expr.loc);
+        return std::nullopt;
+    }
+
+    Frame frame;
+    frame.proto = &proto;
+    frames.push_back(std::move(frame));
+    push_scope();
+    bool ok = true;
+    for (std::size_t i = 0; i < args.size() && ok; ++i) {
+        ok = declare_local(proto.params[i].name, std::move(args[i]), false, expr.loc);
+    }
+    Flow flow = ok ? exec_block(*fn.body) : Flow::Error;
+    pop_scope();
+    frames.pop_back();
+
+    if (flow == Flow::Error) {
+        return std::nullopt;
+    }
+    TypeKind ret = proto.return_type->kind;
+    ConstValue result;
+    if (flow == Flow::Return) {
+        result = std::move(return_value);
+    } else if (ret != TypeKind::TYPE_VOID) {
+        report(ErrorCode::E301_NOT_CONSTANT, "'" + name + "' finished without returning a value",
+               expr.loc);
+        return std::nullopt;
+    } else {
+        result.type = TypeKind::TYPE_VOID;
+    }
+    call_cache.emplace(std::move(key), result);
+    return result;
+}
+
+std::optional<ConstValue> ConstEvaluator::eval_cast(const CastExprAST& expr) {
+    TypeKind target = expr.target->kind;
+    if (!is_scalar(target) || target == TypeKind::TYPE_STRING) {
+        report(ErrorCode::E301_NOT_CONSTANT,
+               "cast to '" + type_to_string(*expr.target) + "' is not a compile-time constant",
+               expr.loc);
+        return std::nullopt;
+    }
+    auto value = eval(*expr.operand, nullptr);
+    if (!value) {
+        return std::nullopt;
+    }
+    return convert(*value, target, expr.loc);
+}
+
+std::optional<ConstValue> ConstEvaluator::convert(const ConstValue& value, TypeKind target,
+                                                  SourceLocation loc) {
+    TypeKind from = value.type;
+    if (from == target) {
+        return value;
+    }
+    bool from_int = is_integer(from) || from == TypeKind::TYPE_CHAR || from == TypeKind::TYPE_BOOL;
+    bool to_int = is_integer(target) || target == TypeKind::TYPE_CHAR;
+
+    if (from_int && to_int) {
+        return ConstValue::make_int(target, value.bits);
+    }
+    if (from_int && target == TypeKind::TYPE_BOOL) {
+        return ConstValue::make_bool(value.bits != 0);
+    }
+    if (from_int && is_float(target)) {
+        double d = is_signed(from) ? static_cast<double>(value.as_signed())
+                                   : static_cast<double>(value.bits);
+        return ConstValue::make_float(target, d);
+    }
+    if (is_float(from) && is_float(target)) {
+        return ConstValue::make_float(target, value.real);
+    }
+    if (is_float(from) && to_int) {
+        double d = std::trunc(value.real);
+        unsigned bits = integer_bits(target);
+        bool ok = std::isfinite(d);
+        if (ok && is_signed(target)) {
+            double limit = std::ldexp(1.0, static_cast<int>(bits) - 1);
+            ok = d >= -limit && d < limit;
+        } else if (ok) {
+            ok = d >= 0 && d < std::ldexp(1.0, static_cast<int>(bits));
+        }
+        if (!ok) {
+            report(ErrorCode::E302_CONST_OVERFLOW,
+                   "value " + value.to_string() + " is out of range for '" + kind_name(target) +
+                       "'",
+                   loc);
+            return std::nullopt;
+        }
+        if (d < 0) {
+            return ConstValue::make_int(target, static_cast<u128>(static_cast<i128>(d)));
+        }
+        return ConstValue::make_int(target, static_cast<u128>(d));
+    }
+    report(ErrorCode::E307_CONST_TYPE_MISMATCH,
+           "cannot cast '" + kind_name(from) + "' to '" + kind_name(target) + "'", loc);
+    return std::nullopt;
+}
+
+ConstEvaluator::Flow ConstEvaluator::exec(const StmtAST& stmt) {
+    if (!step(stmt.loc)) {
+        return Flow::Error;
+    }
+    switch (stmt.kind) {
+        case NodeType::NODE_BLOCK:
+            return exec_block(static_cast<const BlockStmtAST&>(stmt));
+        case NodeType::NODE_VAR_DECL:
+        case NodeType::NODE_CONST:
+            return exec_var_decl(static_cast<const VarDeclAST&>(stmt));
+        case NodeType::NODE_EXPR:
+            return eval(*static_cast<const ExprStmtAST&>(stmt).expr, nullptr) ? Flow::Normal
+                                                                              : Flow::Error;
+        case NodeType::NODE_RETURN: {
+            const auto& ret = static_cast<const ReturnStmtAST&>(stmt);
+            const PrototypeAST* proto = frames.back().proto;
+            if (!ret.value) {
+                return_value = ConstValue();
+                return_value.type = TypeKind::TYPE_VOID;
+                return Flow::Return;
+            }
+            auto value = eval(*ret.value, proto->return_type.get());
+            if (!value) {
+                return Flow::Error;
+            }
+            if (value->type != proto->return_type->kind) {
+                report(ErrorCode::E307_CONST_TYPE_MISMATCH,
+                       "'" + proto->name + "' returns '" + type_to_string(*proto->return_type) +
+                           "', found '" + kind_name(value->type) + "'",
+                       ret.value->loc);
+                return Flow::Error;
+            }
+            return_value = std::move(*value);
+            return Flow::Return;
+        }
+        case NodeType::NODE_IF: {
+            const auto& s = static_cast<const IfStmtAST&>(stmt);
+            auto cond = eval(*s.cond, nullptr);
+            if (!cond) {
+                return Flow::Error;
+            }
+            if (cond->type != TypeKind::TYPE_BOOL) {
+                report(ErrorCode::E307_CONST_TYPE_MISMATCH,
+                       "condition must be 'bool', found '" + kind_name(cond->type) + "'",
+                       s.cond->loc);
+                return Flow::Error;
+            }
+            if (cond->as_bool()) {
+                return exec(*s.then_branch);
+            }
+            return s.else_branch ? exec(*s.else_branch) : Flow::Normal;
+        }
+        case NodeType::NODE_WHILE: {
+            const auto& s = static_cast<const WhileStmtAST&>(stmt);
+            for (;;) {
+                auto cond = eval(*s.cond, nullptr);
+                if (!cond) {
+                    return Flow::Error;
+                }
+                if (cond->type != TypeKind::TYPE_BOOL) {
+                    report(ErrorCode::E307_CONST_TYPE_MISMATCH,
+                           "condition must be 'bool', found '" + kind_name(cond->type) + "'",
+                           s.cond->loc);
+                    return Flow::Error;
+                }
+                if (!cond->as_bool()) {
+                    return Flow::Normal;
+                }
+                Flow flow = exec(*s.body);
+                if (flow == Flow::Break) {
+                    return Flow::Normal;
+                }
+                if (flow == Flow::Return || flow == Flow::Error) {
+                    return flow;
+                }
+            }
+        }
+        case NodeType::NODE_FOR: {
+            const auto& s = static_cast<const ForStmtAST&>(stmt);
+            push_scope();
+            Flow result = Flow::Normal;
+            if (s.init) {
+                result = exec(*s.init);
+            }
+            while (result == Flow::Normal) {
+                if (s.cond) {
+                    auto cond = eval(*s.cond, nullptr);
+                    if (!cond) {
+                        result = Flow::Error;
+                        break;
+                    }
+                    if (cond->type != TypeKind::TYPE_BOOL) {
+                        report(ErrorCode::E307_CONST_TYPE_MISMATCH,
+                               "condition must be 'bool', found '" + kind_name(cond->type) + "'",
+                               s.cond->loc);
+                        result = Flow::Error;
+                        break;
+                    }
+                    if (!cond->as_bool()) {
+                        break;
+                    }
+                }
+                Flow flow = exec(*s.body);
+                if (flow == Flow::Break) {
+                    break;
+                }
+                if (flow == Flow::Return || flow == Flow::Error) {
+                    result = flow;
+                    break;
+                }
+                if (s.step && !eval(*s.step, nullptr)) {
+                    result = Flow::Error;
+                }
+            }
+            pop_scope();
+            return result;
+        }
+        case NodeType::NODE_MATCH:
+            return exec_match(static_cast<const MatchStmtAST&>(stmt));
+        case NodeType::NODE_BREAK:
+            return Flow::Break;
+        case NodeType::NODE_CONTINUE:
+            return Flow::Continue;
+        default:
+            report(ErrorCode::E301_NOT_CONSTANT,
+                   "statement cannot be evaluated at compile time", stmt.loc);
+            return Flow::Error;
+    }
+}
+
+ConstEvaluator::Flow ConstEvaluator::exec_block(const BlockStmtAST& block) {
+    push_scope();
+    Flow flow = Flow::Normal;
+    for (const auto& stmt : block.statements) {
+        flow = exec(*stmt);
+        if (flow != Flow::Normal) {
+            break;
+        }
+    }
+    pop_scope();
+    return flow;
+}
+
+ConstEvaluator::Flow ConstEvaluator::exec_var_decl(const VarDeclAST& decl) {
+    const Type* type = decl.type.get();
+    if (type != nullptr && !is_scalar(type->kind)) {
+        report(ErrorCode::E301_NOT_CONSTANT,
+               "local '" + decl.name + "' of type '" + type_to_string(*type) +
+                   "' cannot be evaluated at compile time",
+               decl.loc);
+        return Flow::Error;
+    }
+    ConstValue value;
+    if (decl.init) {
+        auto init = eval(*decl.init, type);
+        if (!init) {
+            return Flow::Error;
+        }
+        if (type != nullptr && init->type != type->kind) {
+            report(ErrorCode::E307_CONST_TYPE_MISMATCH,
+                   "'" + decl.name + "' has type '" + type_to_string(*type) +
+                       "' but its initializer has type '" + kind_name(init->type) + "'",
+                   decl.init->loc);
+            return Flow::Error;
+        }
+        value = std::move(*init);
+    } else if (is_float(type->kind)) {
+        value = ConstValue::make_float(type->kind, 0.0);
+    } else if (type->kind == TypeKind::TYPE_STRING) {
+        value = ConstValue::make_string("");
+    } else {
+        value = ConstValue::make_int(type->kind, 0);
+    }
+    return declare_local(decl.name, std::move(value), decl.is_const(), decl.loc) ? Flow::Normal
+                                                                                 : Flow::Error;
+}
+
+ConstEvaluator::Flow ConstEvaluator::exec_match(const MatchStmtAST& stmt) {
+    auto scrutinee = eval(*stmt.scrutinee, nullptr);
+    if (!scrutinee) {
+        return Flow::Error;
+    }
+    Type scrutinee_type;
+    scrutinee_type.kind = scrutinee->type;
+    for (const MatchArm& arm : stmt.arms) {
+        if (arm.pattern == PatternKind::PATTERN_LITERAL) {
+            auto literal = eval(*arm.literal, &scrutinee_type);
+            if (!literal) {
+                return Flow::Error;
+            }
+            auto equal = apply_binary(TokenType::TOKEN_EQUAL, *scrutinee, *literal, arm.loc);
+            if (!equal) {
+                return Flow::Error;
+            }
+            if (!equal->as_bool()) {
+                continue;
+            }
+            return exec_block(*arm.body);
+        }
+        if (arm.pattern == PatternKind::PATTERN_IDENTIFIER) {
+            push_scope();
+            Flow flow = declare_local(arm.binding, *scrutinee, true, arm.loc)
+                            ? exec_block(*arm.body)
+                            : Flow::Error;
+            pop_scope();
+            return flow;
+        }
+        return exec_block(*arm.body);
+    }
+    return Flow::Normal;
+}
+
+void ConstEvaluator::resolve_array_sizes(ModuleAST& mod) {
+    for (auto& decl : mod.decls) {
+        resolve_stmt(*decl);
+    }
+}
+
+void ConstEvaluator::resolve_type(Type& type) {
+    if (type.element) {
+        resolve_type(*type.element);
+    }
+    for (auto& arg : type.args) {
+        resolve_type(*arg);
+    }
+    if (type.kind != TypeKind::TYPE_ARRAY || !type.size_expr || type.size_known) {
+        return;
+    }
+    Type hint;
+    hint.kind = TypeKind::TYPE_U64;
+    auto size = eval(*type.size_expr, &hint);
+    if (!size) {
+        return;
+    }
+    SourceLocation loc = type.size_expr->loc;
+    if (!is_integer(size->type)) {
+        report(ErrorCode::E306_INVALID_ARRAY_SIZE,
+               "array size must be an integer, found '" + kind_name(size->type) + "'", loc);
+        return;
+    }
+    if (is_signed(size->type) && size->as_signed() < 0) {
+        report(ErrorCode::E306_INVALID_ARRAY_SIZE,
+               "array size " + size->to_string() + " is negative", loc);
+        return;
+    }
+    if (!fits_unsigned(size->bits, 64)) {
+        report(ErrorCode::E306_INVALID_ARRAY_SIZE,
+               "array size " + size->to_string() + " is too large", loc);
+        return;
+    }
+    type.array_size = static_cast<std::uint64_t>(size->bits);
+    type.size_known = true;
+}
+
+void ConstEvaluator::resolve_stmt(StmtAST& stmt) {
+    switch (stmt.kind) {
+        case NodeType::NODE_FUNCTION: {
+            auto& fn = static_cast<FunctionAST&>(stmt);
+            for (Param& p : fn.proto->params) {
+                resolve_type(*p.type);
+            }
+            if (fn.proto->return_type) {
+                resolve_type(*fn.proto->return_type);
+            }
+            Frame frame;
+            frame.proto = fn.proto.get();
+            frames.push_back(std::move(frame));
+            resolve_stmt(*fn.body);
+            frames.pop_back();
+            return;
+        }
+        case NodeType::NODE_STRUCT: {
+            auto& decl = static_cast<StructDeclAST&>(stmt);
+            for (FieldDecl& field : decl.fields) {
+                resolve_type(*field.type);
+            }
+            for (auto& method : decl.methods) {
+                resolve_stmt(*method);
+            }
+            return;
+        }
+        case NodeType::NODE_TYPE_ALIAS:
+            resolve_type(*static_cast<TypeAliasAST&>(stmt).aliased);
+            return;
+        case NodeType::NODE_BLOCK: {
+            push_scope();
+            for (auto& s : static_cast<BlockStmtAST&>(stmt).statements) {
+                resolve_stmt(*s);
+            }
+            pop_scope();
+            return;
+        }
+        case NodeType::NODE_VAR_DECL:
+        case NodeType::NODE_CONST: {
+            auto& decl = static_cast<VarDeclAST&>(stmt);
+            if (decl.type) {
+                resolve_type(*decl.type);
+            }
+            if (decl.init) {
+                resolve_expr(*decl.init);
+            }
+            // A local const with a constant initializer can size later arrays;
+            // one initialized at runtime simply stays out of scope here.
+            if (decl.is_const() && !frames.empty() && decl.init &&
+                (!decl.type || is_scalar(decl.type->kind))) {
+                quiet++;
+                auto value = eval(*decl.init, decl.type.get());
+                quiet--;
+                if (value && (!decl.type || value->type == decl.type->kind)) {
+                    declare_local(decl.name, std::move(*value), true, decl.loc);
+                }
+            }
+            return;
+        }
+        case NodeType::NODE_EXPR:
+            resolve_expr(*static_cast<ExprStmtAST&>(stmt).expr);
+            return;
+        case NodeType::NODE_RETURN: {
+            auto& ret = static_cast<ReturnStmtAST&>(stmt);
+            if (ret.value) {
+                resolve_expr(*ret.value);
+            }
+            return;
+        }
+        case NodeType::NODE_IF: {
+            auto& s = static_cast<IfStmtAST&>(stmt);
+            resolve_expr(*s.cond);
+            resolve_stmt(*s.then_branch);
+            if (s.else_branch) {
+                resolve_stmt(*s.else_branch);
+            }
+            return;
+        }
+        case NodeType::NODE_WHILE: {
+            auto& s = static_cast<WhileStmtAST&>(stmt);
+            resolve_expr(*s.cond);
+            resolve_stmt(*s.body);
+            return;
+        }
+        case NodeType::NODE_FOR: {
+            auto& s = static_cast<ForStmtAST&>(stmt);
+            push_scope();
+            if (s.init) {
+                resolve_stmt(*s.init);
+            }
+            if (s.cond) {
+                resolve_expr(*s.cond);
+            }
+            if (s.step) {
+                resolve_expr(*s.step);
+            }
+            resolve_stmt(*s.body);
+            pop_scope();
+            return;
+        }
+        case NodeType::NODE_RANGE_FOR: {
+            auto& s = static_cast<RangeForStmtAST&>(stmt);
+            resolve_expr(*s.range);
+            resolve_stmt(*s.body);
+            return;
+        }
+        case NodeType::NODE_MATCH: {
+            auto& s = static_cast<MatchStmtAST&>(stmt);
+            resolve_expr(*s.scrutinee);
+            for (MatchArm& arm : s.arms) {
+                resolve_stmt(*arm.body);
+            }
+            return;
+        }
+        case NodeType::NODE_ARENA: {
+            auto& s = static_cast<ArenaStmtAST&>(stmt);
+            if (s.capacity) {
+                resolve_expr(*s.capacity);
+            }
+            resolve_stmt(*s.body);
+            return;
+        }
+        default:
+            return;
+    }
+}
+
+void ConstEvaluator::resolve_expr(ExprAST& expr) {
+    switch (expr.kind) {
+        case ExprKind::EXPR_UNARY:
+            resolve_expr(*static_cast<UnaryExprAST&>(expr).operand);
+            return;
+        case ExprKind::EXPR_BINARY: {
+            auto& e = static_cast<BinaryExprAST&>(expr);
+            resolve_expr(*e.lhs);
+            resolve_expr(*e.rhs);
+            return;
+        }
+        case ExprKind::EXPR_ASSIGN: {
+            auto& e = static_cast<AssignExprAST&>(expr);
+            resolve_expr(*e.target);
+            resolve_expr(*e.value);
+            return;
+        }
+        case ExprKind::EXPR_CALL: {
+            auto& e = static_cast<CallExprAST&>(expr);
+            resolve_expr(*e.callee);
+            for (auto& t : e.type_args) {
+                resolve_type(*t);
+            }
+            for (auto& a : e.args) {
+                resolve_expr(*a);
+            }
+            return;
+        }
+        case ExprKind::EXPR_INDEX: {
+            auto& e = static_cast<IndexExprAST&>(expr);
+            resolve_expr(*e.base);
+            resolve_expr(*e.index);
+            return;
+        }
+        case ExprKind::EXPR_MEMBER:
+            resolve_expr(*static_cast<MemberExprAST&>(expr).base);
+            return;
+        case ExprKind::EXPR_NEW: {
+            auto& e = static_cast<NewExprAST&>(expr);
+            resolve_type(*e.allocated);
+            if (e.arena) {
+                resolve_expr(*e.arena);
+            }
+            if (e.count) {
+                resolve_expr(*e.count);
+            }
+            for (auto& a : e.args) {
+                resolve_expr(*a);
+            }
+            return;
+        }
+        case ExprKind::EXPR_DELETE:
+            resolve_expr(*static_cast<DeleteExprAST&>(expr).operand);
+            return;
+        case ExprKind::EXPR_CAST: {
+            auto& e = static_cast<CastExprAST&>(expr);
+            resolve_type(*e.target);
+            resolve_expr(*e.operand);
+            return;
+        }
+        case ExprKind::EXPR_ARRAY:
+            for (auto& e : static_cast<ArrayExprAST&>(expr).elements) {
+                resolve_expr(*e);
+            }
+            return;
+        case ExprKind::EXPR_INTERPOLATION:
+            for (auto& e : static_cast<InterpolationExprAST&>(expr).parts) {
+                resolve_expr(*e);
+            }
+            return;
+        case ExprKind::EXPR_LAMBDA:
+            resolve_stmt(*static_cast<LambdaExprAST&>(expr).function);
+            return;
+        default:
+            return;
+    }
+}
+
+}  // namespace pallas::frontend
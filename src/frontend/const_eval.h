@@ -0,0 +1,147 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ast.h"
+#include "diagnostics.h"
+
+namespace pallas::frontend {
+
+using u128 = unsigned __int128;
+using i128 = __int128;
+
+// A compile-time value. Integers are kept in canonical form: truncated to the
+// width of their type, then sign- or zero-extended to 128 bits.
+struct ConstValue {
+    TypeKind type = TypeKind::TYPE_UNKNOWN;
+    u128 bits = 0;      // integers, bool and char
+    double real = 0.0;  // f32 and f64 (f32 values are rounded after every operation)
+    std::string text;   // string
+
+    static ConstValue make_int(TypeKind type, u128 raw);
+    static ConstValue make_bool(bool value);
+    static ConstValue make_float(TypeKind type, double value);
+    static ConstValue make_string(std::string value);
+
+    i128 as_signed() const { return static_cast<i128>(bits); }
+    u128 as_unsigned() const { return bits; }
+    bool as_bool() const { return bits != 0; }
+    std::string to_string() const;
+};
+
+bool operator==(const ConstValue& a, const ConstValue& b);
+
+struct ConstEvalLimits {
+    std::uint64_t max_steps = 1'000'000;
+    std::size_t max_call_depth = 256;
+    std::size_t max_memory_bytes = 1 << 20;
+};
+
+struct ConstEvalStats {
+    std::uint64_t steps = 0;
+    std::size_t peak_memory_bytes = 0;
+    std::size_t const_cache_hits = 0;
+    std::size_t call_cache_hits = 0;
+};
+
+// Evaluates const declarations, array sizes and calls to pure functions at
+// compile time. Integer arithmetic is checked: a result that does not fit its
+// type is reported as E302 rather than wrapped. Each const symbol is evaluated
+// at most once; pure calls are memoized by their argument values.
+class ConstEvaluator {
+  public:
+    ConstEvaluator(const ModuleAST& module, Diagnostics* diagnostics, ConstEvalLimits limits = {});
+
+    std::optional<ConstValue> evaluate_const(const std::string& name);
+    std::optional<ConstValue> evaluate(const ExprAST& expr, const Type* expected = nullptr);
+    void evaluate_all();
+    // Evaluates every array size expression in the module and stores the result
+    // in Type::array_size.
+    void resolve_array_sizes(ModuleAST& module);
+    bool had_error() const { return error_count > 0; }
+    const ConstEvalStats& stats() const { return eval_stats; }
+
+  private:
+    enum class ConstState {
+        Unevaluated,
+        InProgress,
+        Done,
+        Failed,
+    };
+
+    struct ConstEntry {
+        const VarDeclAST* decl = nullptr;
+        ConstState state = ConstState::Unevaluated;
+        ConstValue value;
+    };
+
+    struct Local {
+        ConstValue value;
+        bool is_const = false;
+    };
+
+    struct Frame {
+        const PrototypeAST* proto = nullptr;
+        std::vector<std::unordered_map<std::string, Local>> scopes;
+    };
+
+    enum class Flow {
+        Normal,
+        Return,
+        Break,
+        Continue,
+        Error,
+    };
+
+    const ModuleAST& module;
+    Diagnostics* diagnostics = nullptr;
+    ConstEvalLimits limits;
+    ConstEvalStats eval_stats;
+    std::size_t error_count = 0;
+    bool budget_reported = false;
+    int quiet = 0;
+    std::size_t memory_used = 0;
+
+    std::unordered_map<std::string, ConstEntry> consts;
+    std::unordered_map<std::string, const FunctionAST*> functions;
+    std::unordered_map<std::string, ConstValue> call_cache;
+    std::vector<Frame> frames;
+    ConstValue return_value;
+
+    void report(ErrorCode code, const std::string& msg, SourceLocation loc);
+    bool step(SourceLocation loc);
+    bool reserve_memory(std::size_t bytes, SourceLocation loc);
+    void push_scope();
+    void pop_scope();
+    Local* lookup_local(const std::string& name);
+    bool declare_local(const std::string& name, ConstValue value, bool is_const, SourceLocation loc);
+
+    std::optional<ConstValue> eval(const ExprAST& expr, const Type* expected);
+    std::optional<ConstValue> eval_number(const NumberExprAST& expr, const Type* expected);
+    std::optional<ConstValue> eval_variable(const VariableExprAST& expr);
+    std::optional<ConstValue> eval_unary(const UnaryExprAST& expr, const Type* expected);
+    std::optional<ConstValue> eval_binary(const BinaryExprAST& expr, const Type* expected);
+    std::optional<ConstValue> eval_assign(const AssignExprAST& expr);
+    std::optional<ConstValue> eval_call(const CallExprAST& expr);
+    std::optional<ConstValue> eval_cast(const CastExprAST& expr);
+    std::optional<ConstValue> apply_binary(TokenType op, const ConstValue& lhs,
+                                           const ConstValue& rhs, SourceLocation loc);
+    std::optional<ConstValue> apply_integer(TokenType op, const ConstValue& lhs,
+                                            const ConstValue& rhs, SourceLocation loc);
+    std::optional<ConstValue> convert(const ConstValue& value, TypeKind target, SourceLocation loc);
+
+    Flow exec(const StmtAST& stmt);
+    Flow exec_block(const BlockStmtAST& block);
+    Flow exec_var_decl(const VarDeclAST& decl);
+    Flow exec_match(const MatchStmtAST& stmt);
+
+    void resolve_type(Type& type);
+    void resolve_stmt(StmtAST& stmt);
+    void resolve_expr(ExprAST& expr);
+};
+
+}  // namespace pallas::frontend
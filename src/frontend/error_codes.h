@@ -5,16 +5,40 @@
 
 namespace pallas::frontend {
 
-enum class ErrorCode : std::uint8_t {
+enum class ErrorCode : std::uint16_t {
     E101_UNTERMINATED_BLOCK_COMMENT = 101,
     E103_INVALID_HEX_LITERAL = 103,
     E104_UNTERMINATED_CHAR_LITERAL = 104,
     E105_INVALID_NUMBER_LITERAL = 105,
     E107_UNTERMINATED_STRING_LITERAL = 107,
+
+    E201_UNEXPECTED_TOKEN = 201,
+    E202_EXPECTED_EXPRESSION = 202,
+    E203_EXPECTED_TYPE = 203,
+    E204_INVALID_ASSIGNMENT_TARGET = 204,
+
+    E301_NOT_CONSTANT = 301,
+    E302_CONST_OVERFLOW = 302,
+    E303_CONST_DIVISION_BY_ZERO = 303,
+    E304_CONST_CYCLE = 304,
+    E305_CONST_BUDGET_EXCEEDED = 305,
+    E306_INVALID_ARRAY_SIZE = 306,
+    E307_CONST_TYPE_MISMATCH = 307,
+
+    E401_UNKNOWN_TYPE = 401,
+    E402_RECURSIVE_TYPE = 402,
+    E403_INVALID_ATTRIBUTE = 403,
+    E404_UNDEFINED_NAME = 404,
+    E405_TYPE_MISMATCH = 405,
+    E406_WRONG_ARGUMENT_COUNT = 406,
+    E407_UNREACHABLE_PATTERN = 407,
+
+    E501_INVALID_IR = 501,
+    E502_UNSUPPORTED_LOWERING = 502,
 };
 
 inline int error_code_value(ErrorCode code) {
-    return code;
+    return static_cast<int>(code);
 }
 
 inline const char* code_to_string(ErrorCode code) {
@@ -24,6 +48,26 @@ inline const char* code_to_string(ErrorCode code) {
         case ErrorCode::E104_UNTERMINATED_CHAR_LITERAL: return "unterminated character literal";
         case ErrorCode::E105_INVALID_NUMBER_LITERAL: return "invalid number literal";
         case ErrorCode::E107_UNTERMINATED_STRING_LITERAL: return "unterminated string literal";
+        case ErrorCode::E201_UNEXPECTED_TOKEN: return "unexpected token";
+        case ErrorCode::E202_EXPECTED_EXPRESSION: return "expected expression";
+        case ErrorCode::E203_EXPECTED_TYPE: return "expected type";
+        case ErrorCode::E204_INVALID_ASSIGNMENT_TARGET: return "invalid assignment target";
+        case ErrorCode::E301_NOT_CONSTANT: return "expression is not constant";
+        case ErrorCode::E302_CONST_OVERFLOW: return "overflow in constant expression";
+        case ErrorCode::E303_CONST_DIVISION_BY_ZERO: return "division by zero in constant expression";
+        case ErrorCode::E304_CONST_CYCLE: return "constant depends on itself";
+        case ErrorCode::E305_CONST_BUDGET_EXCEEDED: return "constant evaluation budget exceeded";
+        case ErrorCode::E306_INVALID_ARRAY_SIZE: return "invalid array size";
+        case ErrorCode::E307_CONST_TYPE_MISMATCH: return "type mismatch in constant expression";
+        case ErrorCode::E401_UNKNOWN_TYPE: return "unknown type";
+        case ErrorCode::E402_RECURSIVE_TYPE: return "type contains itself";
+        case ErrorCode::E403_INVALID_ATTRIBUTE: return "invalid attribute";
+        case ErrorCode::E404_UNDEFINED_NAME: return "undefined name";
+        case ErrorCode::E405_TYPE_MISMATCH: return "type mismatch";
+        case ErrorCode::E406_WRONG_ARGUMENT_COUNT: return "wrong number of arguments";
+        case ErrorCode::E407_UNREACHABLE_PATTERN: return "unreachable match arm";
+        case ErrorCode::E501_INVALID_IR: return "invalid IR";
+        case ErrorCode::E502_UNSUPPORTED_LOWERING: return "construct not supported by IR lowering";
         default: return "unknown error";
     }
 }
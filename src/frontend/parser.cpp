@@ -1,5 +1,1427 @@
 #include "parser.h"
+#include <utility>
+#include "support/trace.h"
 
 namespace pallas::frontend {
 
-} // namespace pallas::frontend
\ No newline at end of file
+namespace {
+
+int binary_precedence(TokenType type) {
+    switch (type) {
+        case TokenType::TOKEN_LOGICAL_OR:
+            return 1;
+        case TokenType::TOKEN_LOGICAL_AND:
+            return 2;
+        case TokenType::TOKEN_PIPE:
+            return 3;
+        case TokenType::TOKEN_CARET:
+            return 4;
+        case TokenType::TOKEN_AMPERSAND:
+            return 5;
+        case TokenType::TOKEN_EQUAL:
+        case TokenType::TOKEN_NOT_EQUAL:
+            return 6;
+        case TokenType::TOKEN_LESS:
+        case TokenType::TOKEN_LESS_EQUAL:
+        case TokenType::TOKEN_GREATER:
+        case TokenType::TOKEN_GREATER_EQUAL:
+            return 7;
+        case TokenType::TOKEN_LEFT_SHIFT:
+        case TokenType::TOKEN_RIGHT_SHIFT:
+            return 8;
+        case TokenType::TOKEN_PLUS:
+        case TokenType::TOKEN_MINUS:
+            return 9;
+        case TokenType::TOKEN_STAR:
+        case TokenType::TOKEN_SLASH:
+        case TokenType::TOKEN_PERCENT:
+            return 10;
+        default:
+            return -1;
+    }
+}
+
+bool is_assignment_op(TokenType type) {
+    return type == TokenType::TOKEN_ASSIGN || type == TokenType::TOKEN_PLUS_ASSIGN ||
+           type == TokenType::TOKEN_MINUS_ASSIGN || type == TokenType::TOKEN_STAR_ASSIGN ||
+           type == TokenType::TOKEN_SLASH_ASSIGN;
+}
+
+bool is_primitive_type_token(TokenType type) {
+    switch (type) {
+        case TokenType::TOKEN_VOID:
+        case TokenType::TOKEN_INT:
+        case TokenType::TOKEN_FLOAT:
+        case TokenType::TOKEN_DOUBLE:
+        case TokenType::TOKEN_CHAR:
+        case TokenType::TOKEN_STRING:
+        case TokenType::TOKEN_BOOL:
+        case TokenType::TOKEN_F32:
+        case TokenType::TOKEN_F64:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool starts_operand(TokenType type) {
+    switch (type) {
+        case TokenType::TOKEN_IDENT:
+        case TokenType::TOKEN_INT_LITERAL:
+        case TokenType::TOKEN_FLOAT_LITERAL:
+        case TokenType::TOKEN_CHAR_LITERAL:
+        case TokenType::TOKEN_STRING_LITERAL:
+        case TokenType::TOKEN_TRUE:
+        case TokenType::TOKEN_FALSE:
+        case TokenType::TOKEN_NULL:
+        case TokenType::TOKEN_LPAREN:
+        case TokenType::TOKEN_LBRACKET:
+        case TokenType::TOKEN_LOGICAL_NOT:
+        case TokenType::TOKEN_MINUS:
+        case TokenType::TOKEN_TILDE:
+        case TokenType::TOKEN_NEW:
+            return true;
+        default:
+            return false;
+    }
+}
+
+const char* token_description(const Token& tok) {
+    if (tok.type == TokenType::TOKEN_EOF) {
+        return "end of file";
+    }
+    return nullptr;
+}
+
+}  // namespace
+
+Parser::Parser(std::vector<Token> tokens) : Parser(std::move(tokens), nullptr) {}
+
+Parser::Parser(std::vector<Token> tokens_in, Diagnostics* diag)
+    : tokens(std::move(tokens_in)), diagnostics(diag) {
+    if (tokens.empty() || tokens.back().type != TokenType::TOKEN_EOF) {
+        Token eof;
+        eof.type = TokenType::TOKEN_EOF;
+        if (!tokens.empty()) {
+            eof.offset = tokens.back().offset + tokens.back().length;
+            eof.line = tokens.back().line;
+            eof.column = tokens.back().column + tokens.back().length;
+        }
+        tokens.push_back(eof);
+    }
+}
+
+const Token& Parser::peek(std::size_t n) const {
+    if (split_shift && n == 0) {
+        const Token& shift = tokens[current];
+        split_token = shift;
+        split_token.type = TokenType::TOKEN_GREATER;
+        split_token.lexeme = ">";
+        split_token.length = 1;
+        split_token.offset = shift.offset + 1;
+        split_token.column = shift.column + 1;
+        return split_token;
+    }
+    std::size_t idx = current + n;
+    if (idx >= tokens.size()) {
+        return tokens.back();
+    }
+    return tokens[idx];
+}
+
+TokenType Parser::peek_type(std::size_t n) const {
+    return peek(n).type;
+}
+
+const Token& Parser::advance() {
+    const Token& tok = peek();
+    split_shift = false;
+    if (current + 1 < tokens.size()) {
+        current++;
+    }
+    return tok;
+}
+
+bool Parser::check(TokenType type) const {
+    return peek_type() == type;
+}
+
+bool Parser::match(TokenType type) {
+    if (!check(type)) {
+        return false;
+    }
+    advance();
+    return true;
+}
+
+bool Parser::expect(TokenType type, const char* what) {
+    if (match(type)) {
+        return true;
+    }
+    const Token& tok = peek();
+    const char* desc = token_description(tok);
+    std::string found = desc != nullptr ? desc : "'" + tok.lexeme + "'";
+    error(ErrorCode::E201_UNEXPECTED_TOKEN, std::string("expected ") + what + ", found " + found);
+    return false;
+}
+
+bool Parser::is_at_end() const {
+    return peek_type() == TokenType::TOKEN_EOF;
+}
+
+void Parser::restore(State s) {
+    current = s.current;
+    split_shift = s.split_shift;
+}
+
+SourceLocation Parser::location() const {
+    const Token& tok = peek();
+    return {tok.offset, tok.line, tok.column};
+}
+
+void Parser::error(ErrorCode code, const std::string& msg) {
+    error_at(peek(), code, msg);
+}
+
+void Parser::error_at(const Token& tok, ErrorCode code, const std::string& msg) {
+    if (speculating > 0) {
+        return;
+    }
+    error_count++;
+    if (diagnostics != nullptr) {
+        diagnostics->report(Severity::Error, code, msg, "", tok.offset, tok.length, tok.line,
+                            tok.column);
+    }
+}
+
+void Parser::synchronize() {
+    while (!is_at_end()) {
+        if (match(TokenType::TOKEN_SEMICOLON)) {
+            return;
+        }
+        switch (peek_type()) {
+            case TokenType::TOKEN_RBRACE:
+            case TokenType::TOKEN_IF:
+            case TokenType::TOKEN_FOR:
+            case TokenType::TOKEN_WHILE:
+            case TokenType::TOKEN_RETURN:
+            case TokenType::TOKEN_MATCH:
+            case TokenType::TOKEN_STRUCT:
+            case TokenType::TOKEN_CLASS:
+            case TokenType::TOKEN_CONST:
+            case TokenType::TOKEN_IMPORT:
+                return;
+            default:
+                advance();
+        }
+    }
+}
+
+std::unique_ptr<ModuleAST> Parser::parse_module() {
+    support::TraceScope trace("parse");
+    auto module = std::make_unique<ModuleAST>();
+    while (!is_at_end()) {
+        std::size_t before = current;
+        auto decl = parse_top_level();
+        if (decl) {
+            module->decls.push_back(std::move(decl));
+            continue;
+        }
+        synchronize();
+        if (current == before) {
+            advance();
+        }
+    }
+    trace.set_items(current);
+    return module;
+}
+
+bool Parser::parse_attributes(std::vector<Attribute>& attributes) {
+    while (check(TokenType::TOKEN_AT)) {
+        Attribute attr;
+        attr.loc = location();
+        advance();
+        if (!check(TokenType::TOKEN_IDENT)) {
+            expect(TokenType::TOKEN_IDENT, "attribute name");
+            return false;
+        }
+        attr.name = advance().lexeme;
+        if (check(TokenType::TOKEN_LPAREN) && !parse_arguments(attr.args)) {
+            return false;
+        }
+        attributes.push_back(std::move(attr));
+    }
+    return true;
+}
+
+std::unique_ptr<StmtAST> Parser::parse_top_level() {
+    if (check(TokenType::TOKEN_AT)) {
+        std::vector<Attribute> attributes;
+        if (!parse_attributes(attributes)) {
+            return nullptr;
+        }
+        auto decl = parse_top_level();
+        if (decl) {
+            for (Attribute& attr : attributes) {
+                decl->attributes.push_back(std::move(attr));
+            }
+        }
+        return decl;
+    }
+    switch (peek_type()) {
+        case TokenType::TOKEN_IMPORT:
+            return parse_import();
+        case TokenType::TOKEN_STRUCT:
+            advance();
+            return parse_struct(false);
+        case TokenType::TOKEN_CLASS:
+            advance();
+            return parse_struct(true);
+        case TokenType::TOKEN_TYPE:
+            return parse_type_alias();
+        case TokenType::TOKEN_CONST:
+            advance();
+            return parse_var_decl(NodeType::NODE_CONST);
+        case TokenType::TOKEN_IDENT:
+            if (peek_type(1) == TokenType::TOKEN_LPAREN || peek_type(1) == TokenType::TOKEN_LESS) {
+                return parse_function(FunctionKind::FUNCTION_FREE);
+            }
+            if (peek_type(1) == TokenType::TOKEN_COLON) {
+                return parse_var_decl(NodeType::NODE_VAR_DECL);
+            }
+            break;
+        default:
+            break;
+    }
+    error(ErrorCode::E201_UNEXPECTED_TOKEN, "expected declaration, found '" + peek().lexeme + "'");
+    return nullptr;
+}
+
+std::unique_ptr<StmtAST> Parser::parse_import() {
+    SourceLocation loc = location();
+    advance();
+    if (!check(TokenType::TOKEN_STRING_LITERAL)) {
+        expect(TokenType::TOKEN_STRING_LITERAL, "import path");
+        return nullptr;
+    }
+    const Token& path = advance();
+    std::string body = path.lexeme.size() >= 2 ? path.lexeme.substr(1, path.lexeme.size() - 2) : "";
+    if (!expect(TokenType::TOKEN_SEMICOLON, "';'")) {
+        return nullptr;
+    }
+    return std::make_unique<ImportAST>(decode_escapes(body), loc);
+}
+
+std::unique_ptr<StmtAST> Parser::parse_type_alias() {
+    SourceLocation loc = location();
+    advance();
+    if (!check(TokenType::TOKEN_IDENT)) {
+        expect(TokenType::TOKEN_IDENT, "alias name");
+        return nullptr;
+    }
+    std::string name = advance().lexeme;
+    std::vector<TypeParam> params;
+    if (check(TokenType::TOKEN_LESS)) {
+        params = parse_type_params();
+    }
+    if (!expect(TokenType::TOKEN_ASSIGN, "'='")) {
+        return nullptr;
+    }
+    auto aliased = parse_type();
+    if (!aliased || !expect(TokenType::TOKEN_SEMICOLON, "';'")) {
+        return nullptr;
+    }
+    auto alias = std::make_unique<TypeAliasAST>(std::move(name), std::move(aliased), loc);
+    alias->type_params = std::move(params);
+    return alias;
+}
+
+std::unique_ptr<VarDeclAST> Parser::parse_var_decl(NodeType kind) {
+    SourceLocation loc = location();
+    // "arena" is a keyword, but README code also uses it as a variable name.
+    if (!check(TokenType::TOKEN_IDENT) && !check(TokenType::TOKEN_ARENA)) {
+        expect(TokenType::TOKEN_IDENT, "identifier");
+        return nullptr;
+    }
+    std::string name = advance().lexeme;
+    std::shared_ptr<Type> type;
+    if (match(TokenType::TOKEN_COLON)) {
+        type = parse_type();
+        if (!type) {
+            return nullptr;
+        }
+    }
+    std::unique_ptr<ExprAST> init;
+    if (match(TokenType::TOKEN_ASSIGN)) {
+        init = parse_expression();
+        if (!init) {
+            return nullptr;
+        }
+    }
+    if (kind == NodeType::NODE_CONST && !init) {
+        error(ErrorCode::E202_EXPECTED_EXPRESSION, "const '" + name + "' requires an initializer");
+        return nullptr;
+    }
+    if (!type && !init) {
+        error(ErrorCode::E203_EXPECTED_TYPE, "declaration of '" + name + "' needs a type");
+        return nullptr;
+    }
+    if (!expect(TokenType::TOKEN_SEMICOLON, "';'")) {
+        return nullptr;
+    }
+    return std::make_unique<VarDeclAST>(kind, std::move(name), std::move(type), std::move(init),
+                                        loc);
+}
+
+std::vector<TypeParam> Parser::parse_type_params() {
+    std::vector<TypeParam> params;
+    advance();  // '<'
+    do {
+        if (!check(TokenType::TOKEN_IDENT)) {
+            expect(TokenType::TOKEN_IDENT, "type parameter");
+            return params;
+        }
+        TypeParam p;
+        p.name = advance().lexeme;
+        if (match(TokenType::TOKEN_ASSIGN)) {
+            p.default_type = parse_type();
+        }
+        params.push_back(std::move(p));
+    } while (match(TokenType::TOKEN_COMMA));
+    if (!close_angle()) {
+        expect(TokenType::TOKEN_GREATER, "'>'");
+    }
+    return params;
+}
+
+bool Parser::parse_params(std::vector<Param>& params) {
+    if (!expect(TokenType::TOKEN_LPAREN, "'('")) {
+        return false;
+    }
+    if (match(TokenType::TOKEN_RPAREN)) {
+        return true;
+    }
+    do {
+        Param p;
+        p.loc = location();
+        if (!check(TokenType::TOKEN_IDENT)) {
+            expect(TokenType::TOKEN_IDENT, "parameter name");
+            return false;
+        }
+        p.name = advance().lexeme;
+        if (!expect(TokenType::TOKEN_COLON, "':'")) {
+            return false;
+        }
+        p.type = parse_type();
+        if (!p.type) {
+            return false;
+        }
+        params.push_back(std::move(p));
+    } while (match(TokenType::TOKEN_COMMA));
+    return expect(TokenType::TOKEN_RPAREN, "')'");
+}
+
+std::unique_ptr<FunctionAST> Parser::parse_function(FunctionKind kind) {
+    SourceLocation loc = location();
+    if (!check(TokenType::TOKEN_IDENT)) {
+        expect(TokenType::TOKEN_IDENT, "function name");
+        return nullptr;
+    }
+    std::string name = advance().lexeme;
+    std::vector<TypeParam> type_params;
+    if (check(TokenType::TOKEN_LESS)) {
+        type_params = parse_type_params();
+    }
+    std::vector<Param> params;
+    if (!parse_params(params)) {
+        return nullptr;
+    }
+    std::shared_ptr<Type> ret;
+    if (match(TokenType::TOKEN_COLON)) {
+        ret = parse_type();
+        if (!ret) {
+            return nullptr;
+        }
+    } else {
+        ret = make_type(TypeKind::TYPE_VOID);
+    }
+    auto body = parse_block();
+    if (!body) {
+        return nullptr;
+    }
+    auto proto = std::make_unique<PrototypeAST>(std::move(name), std::move(params), std::move(ret));
+    proto->type_params = std::move(type_params);
+    proto->function_kind = kind;
+    proto->loc = loc;
+    return std::make_unique<FunctionAST>(std::move(proto), std::move(body), loc);
+}
+
+std::unique_ptr<StructDeclAST> Parser::parse_struct(bool is_class) {
+    SourceLocation loc = location();
+    if (!check(TokenType::TOKEN_IDENT)) {
+        expect(TokenType::TOKEN_IDENT, is_class ? "class name" : "struct name");
+        return nullptr;
+    }
+    auto decl = std::make_unique<StructDeclAST>(advance().lexeme, is_class, loc);
+    if (check(TokenType::TOKEN_LESS)) {
+        decl->type_params = parse_type_params();
+    }
+    if (!expect(TokenType::TOKEN_LBRACE, "'{'")) {
+        return nullptr;
+    }
+    Visibility visibility = Visibility::VISIBILITY_PUBLIC;
+    while (!check(TokenType::TOKEN_RBRACE) && !is_at_end()) {
+        if (check(TokenType::TOKEN_PUBLIC) || check(TokenType::TOKEN_PRIVATE)) {
+            Visibility v = check(TokenType::TOKEN_PUBLIC) ? Visibility::VISIBILITY_PUBLIC
+                                                          : Visibility::VISIBILITY_PRIVATE;
+            advance();
+            if (match(TokenType::TOKEN_COLON)) {
+                visibility = v;
+                continue;
+            }
+            if (!expect(TokenType::TOKEN_LBRACE, "':' or '{'")) {
+                synchronize();
+                continue;
+            }
+            while (!check(TokenType::TOKEN_RBRACE) && !is_at_end()) {
+                std::size_t before = current;
+                if (!parse_struct_member(*decl, v)) {
+                    synchronize();
+                    if (current == before) {
+                        advance();
+                    }
+                }
+            }
+            expect(TokenType::TOKEN_RBRACE, "'}'");
+            continue;
+        }
+        std::size_t before = current;
+        if (!parse_struct_member(*decl, visibility)) {
+            synchronize();
+            if (current == before) {
+                advance();
+            }
+        }
+    }
+    if (!expect(TokenType::TOKEN_RBRACE, "'}'")) {
+        return nullptr;
+    }
+    match(TokenType::TOKEN_SEMICOLON);
+    return decl;
+}
+
+bool Parser::parse_struct_member(StructDeclAST& decl, Visibility visibility) {
+    std::vector<Attribute> attributes;
+    if (!parse_attributes(attributes)) {
+        return false;
+    }
+    if (match(TokenType::TOKEN_TILDE)) {
+        auto fn = parse_function(FunctionKind::FUNCTION_DESTRUCTOR);
+        if (!fn) {
+            return false;
+        }
+        fn->attributes = std::move(attributes);
+        decl.methods.push_back(std::move(fn));
+        return true;
+    }
+    if (!check(TokenType::TOKEN_IDENT)) {
+        expect(TokenType::TOKEN_IDENT, "member declaration");
+        return false;
+    }
+    if (peek_type(1) == TokenType::TOKEN_LPAREN || peek_type(1) == TokenType::TOKEN_LESS) {
+        FunctionKind kind = peek().lexeme == decl.name ? FunctionKind::FUNCTION_CONSTRUCTOR
+                                                       : FunctionKind::FUNCTION_METHOD;
+        auto fn = parse_function(kind);
+        if (!fn) {
+            return false;
+        }
+        fn->attributes = std::move(attributes);
+        decl.methods.push_back(std::move(fn));
+        return true;
+    }
+    FieldDecl field;
+    field.loc = location();
+    field.name = advance().lexeme;
+    field.visibility = visibility;
+    field.attributes = std::move(attributes);
+    if (!expect(TokenType::TOKEN_COLON, "':'")) {
+        return false;
+    }
+    field.type = parse_type();
+    if (!field.type || !expect(TokenType::TOKEN_SEMICOLON, "';'")) {
+        return false;
+    }
+    decl.fields.push_back(std::move(field));
+    return true;
+}
+
+std::unique_ptr<BlockStmtAST> Parser::parse_block() {
+    auto block = std::make_unique<BlockStmtAST>(location());
+    if (!expect(TokenType::TOKEN_LBRACE, "'{'")) {
+        return nullptr;
+    }
+    while (!check(TokenType::TOKEN_RBRACE) && !is_at_end()) {
+        std::size_t before = current;
+        auto stmt = parse_statement();
+        if (stmt) {
+            block->statements.push_back(std::move(stmt));
+            continue;
+        }
+        synchronize();
+        if (current == before) {
+            advance();
+        }
+    }
+    if (!expect(TokenType::TOKEN_RBRACE, "'}'")) {
+        return nullptr;
+    }
+    return block;
+}
+
+std::unique_ptr<StmtAST> Parser::parse_statement() {
+    SourceLocation loc = location();
+    switch (peek_type()) {
+        case TokenType::TOKEN_LBRACE:
+            return parse_block();
+        case TokenType::TOKEN_IF:
+            return parse_if();
+        case TokenType::TOKEN_WHILE:
+            return parse_while();
+        case TokenType::TOKEN_FOR:
+            return parse_for();
+        case TokenType::TOKEN_MATCH:
+            return parse_match();
+        case TokenType::TOKEN_ARENA:
+            if (peek_type(1) == TokenType::TOKEN_LPAREN) {
+                return parse_arena();
+            }
+            if (peek_type(1) == TokenType::TOKEN_COLON) {
+                return parse_var_decl(NodeType::NODE_VAR_DECL);
+            }
+            break;
+        case TokenType::TOKEN_RETURN:
+            return parse_return();
+        case TokenType::TOKEN_BREAK:
+            advance();
+            if (!expect(TokenType::TOKEN_SEMICOLON, "';'")) {
+                return nullptr;
+            }
+            return std::make_unique<StmtAST>(NodeType::NODE_BREAK, loc);
+        case TokenType::TOKEN_CONTINUE:
+            advance();
+            if (!expect(TokenType::TOKEN_SEMICOLON, "';'")) {
+                return nullptr;
+            }
+            return std::make_unique<StmtAST>(NodeType::NODE_CONTINUE, loc);
+        case TokenType::TOKEN_CONST:
+            advance();
+            return parse_var_decl(NodeType::NODE_CONST);
+        case TokenType::TOKEN_IDENT:
+            if (peek_type(1) == TokenType::TOKEN_COLON) {
+                return parse_var_decl(NodeType::NODE_VAR_DECL);
+            }
+            break;
+        default:
+            break;
+    }
+    auto expr = parse_expression();
+    if (!expr || !expect(TokenType::TOKEN_SEMICOLON, "';'")) {
+        return nullptr;
+    }
+    return std::make_unique<ExprStmtAST>(std::move(expr), loc);
+}
+
+std::unique_ptr<StmtAST> Parser::parse_if() {
+    SourceLocation loc = location();
+    advance();
+    if (!expect(TokenType::TOKEN_LPAREN, "'('")) {
+        return nullptr;
+    }
+    auto cond = parse_expression();
+    if (!cond || !expect(TokenType::TOKEN_RPAREN, "')'")) {
+        return nullptr;
+    }
+    auto then_branch = parse_statement();
+    if (!then_branch) {
+        return nullptr;
+    }
+    std::unique_ptr<StmtAST> else_branch;
+    if (match(TokenType::TOKEN_ELSE)) {
+        else_branch = parse_statement();
+        if (!else_branch) {
+            return nullptr;
+        }
+    }
+    return std::make_unique<IfStmtAST>(std::move(cond), std::move(then_branch),
+                                       std::move(else_branch), loc);
+}
+
+std::unique_ptr<StmtAST> Parser::parse_while() {
+    SourceLocation loc = location();
+    advance();
+    if (!expect(TokenType::TOKEN_LPAREN, "'('")) {
+        return nullptr;
+    }
+    auto cond = parse_expression();
+    if (!cond || !expect(TokenType::TOKEN_RPAREN, "')'")) {
+        return nullptr;
+    }
+    auto body = parse_statement();
+    if (!body) {
+        return nullptr;
+    }
+    return std::make_unique<WhileStmtAST>(std::move(cond), std::move(body), loc);
+}
+
+std::unique_ptr<StmtAST> Parser::parse_for() {
+    SourceLocation loc = location();
+    advance();
+    if (!expect(TokenType::TOKEN_LPAREN, "'('")) {
+        return nullptr;
+    }
+
+    // "for (x : range)" has no ';' before the closing parenthesis.
+    bool range_for = false;
+    if (check(TokenType::TOKEN_IDENT) && peek_type(1) == TokenType::TOKEN_COLON) {
+        range_for = true;
+        int depth = 0;
+        for (std::size_t i = current; i < tokens.size(); ++i) {
+            TokenType t = tokens[i].type;
+            if (t == TokenType::TOKEN_LPAREN) {
+                depth++;
+            } else if (t == TokenType::TOKEN_RPAREN) {
+                if (depth == 0) {
+                    break;
+                }
+                depth--;
+            } else if (t == TokenType::TOKEN_SEMICOLON || t == TokenType::TOKEN_EOF) {
+                range_for = t == TokenType::TOKEN_EOF;
+                break;
+            }
+        }
+    }
+
+    if (range_for) {
+        std::string var = advance().lexeme;
+        advance();  // ':'
+        auto range = parse_expression();
+        if (!range || !expect(TokenType::TOKEN_RPAREN, "')'")) {
+            return nullptr;
+        }
+        auto body = parse_statement();
+        if (!body) {
+            return nullptr;
+        }
+        return std::make_unique<RangeForStmtAST>(std::move(var), std::move(range), std::move(body),
+                                                 loc);
+    }
+
+    auto stmt = std::make_unique<ForStmtAST>(loc);
+    if (!match(TokenType::TOKEN_SEMICOLON)) {
+        if (check(TokenType::TOKEN_IDENT) && peek_type(1) == TokenType::TOKEN_COLON) {
+            stmt->init = parse_var_decl(NodeType::NODE_VAR_DECL);
+            if (!stmt->init) {
+                return nullptr;
+            }
+        } else {
+            SourceLocation init_loc = location();
+            auto init = parse_expression();
+            if (!init || !expect(TokenType::TOKEN_SEMICOLON, "';'")) {
+                return nullptr;
+            }
+            stmt->init = std::make_unique<ExprStmtAST>(std::move(init), init_loc);
+        }
+    }
+    if (!check(TokenType::TOKEN_SEMICOLON)) {
+        stmt->cond = parse_expression();
+        if (!stmt->cond) {
+            return nullptr;
+        }
+    }
+    if (!expect(TokenType::TOKEN_SEMICOLON, "';'")) {
+        return nullptr;
+    }
+    if (!check(TokenType::TOKEN_RPAREN)) {
+        stmt->step = parse_expression();
+        if (!stmt->step) {
+            return nullptr;
+        }
+    }
+    if (!expect(TokenType::TOKEN_RPAREN, "')'")) {
+        return nullptr;
+    }
+    stmt->body = parse_statement();
+    if (!stmt->body) {
+        return nullptr;
+    }
+    return stmt;
+}
+
+std::unique_ptr<StmtAST> Parser::parse_match() {
+    SourceLocation loc = location();
+    advance();
+    if (!expect(TokenType::TOKEN_LPAREN, "'('")) {
+        return nullptr;
+    }
+    auto scrutinee = parse_expression();
+    if (!scrutinee || !expect(TokenType::TOKEN_RPAREN, "')'") ||
+        !expect(TokenType::TOKEN_LBRACE, "'{'")) {
+        return nullptr;
+    }
+    auto stmt = std::make_unique<MatchStmtAST>(std::move(scrutinee), loc);
+    while (!check(TokenType::TOKEN_RBRACE) && !is_at_end()) {
+        MatchArm arm;
+        arm.loc = location();
+        switch (peek_type()) {
+            case TokenType::TOKEN_IDENT:
+                if (peek().lexeme == "_") {
+                    arm.pattern = PatternKind::PATTERN_WILDCARD;
+                } else {
+                    arm.pattern = PatternKind::PATTERN_IDENTIFIER;
+                    arm.binding = peek().lexeme;
+                }
+                advance();
+                break;
+            case TokenType::TOKEN_INT_LITERAL:
+            case TokenType::TOKEN_FLOAT_LITERAL:
+            case TokenType::TOKEN_CHAR_LITERAL:
+            case TokenType::TOKEN_STRING_LITERAL:
+            case TokenType::TOKEN_TRUE:
+            case TokenType::TOKEN_FALSE:
+            case TokenType::TOKEN_MINUS:
+                arm.pattern = PatternKind::PATTERN_LITERAL;
+                arm.literal = parse_unary();
+                if (!arm.literal) {
+                    return nullptr;
+                }
+                break;
+            default:
+                error(ErrorCode::E201_UNEXPECTED_TOKEN,
+                      "expected pattern, found '" + peek().lexeme + "'");
+                return nullptr;
+        }
+        if (!expect(TokenType::TOKEN_FAT_ARROW, "'=>'")) {
+            return nullptr;
+        }
+        arm.body = parse_block();
+        if (!arm.body) {
+            return nullptr;
+        }
+        match(TokenType::TOKEN_COMMA);
+        stmt->arms.push_back(std::move(arm));
+    }
+    if (!expect(TokenType::TOKEN_RBRACE, "'}'")) {
+        return nullptr;
+    }
+    return stmt;
+}
+
+std::unique_ptr<StmtAST> Parser::parse_arena() {
+    SourceLocation loc = location();
+    advance();
+    advance();  // '('
+    std::unique_ptr<ExprAST> capacity;
+    if (!check(TokenType::TOKEN_RPAREN)) {
+        capacity = parse_expression();
+        if (!capacity) {
+            return nullptr;
+        }
+    }
+    if (!expect(TokenType::TOKEN_RPAREN, "')'")) {
+        return nullptr;
+    }
+    auto body = parse_block();
+    if (!body) {
+        return nullptr;
+    }
+    return std::make_unique<ArenaStmtAST>(std::move(capacity), std::move(body), loc);
+}
+
+std::unique_ptr<StmtAST> Parser::parse_return() {
+    SourceLocation loc = location();
+    advance();
+    std::unique_ptr<ExprAST> value;
+    if (!check(TokenType::TOKEN_SEMICOLON)) {
+        value = parse_expression();
+        if (!value) {
+            return nullptr;
+        }
+    }
+    if (!expect(TokenType::TOKEN_SEMICOLON, "';'")) {
+        return nullptr;
+    }
+    return std::make_unique<ReturnStmtAST>(std::move(value), loc);
+}
+
+std::shared_ptr<Type> Parser::parse_type() {
+    return parse_type_impl(true);
+}
+
+bool Parser::starts_type() const {
+    return is_primitive_type_token(peek_type()) || check(TokenType::TOKEN_IDENT) ||
+           check(TokenType::TOKEN_LPAREN);
+}
+
+std::shared_ptr<Type> Parser::parse_type_impl(bool allow_array) {
+    // `@soa T[N]`: the array is stored as one array per field of T.
+    if (allow_array && match(TokenType::TOKEN_AT)) {
+        if (!check(TokenType::TOKEN_IDENT) || peek().lexeme != "soa") {
+            error(ErrorCode::E403_INVALID_ATTRIBUTE, "expected 'soa' after '@' in a type");
+            return nullptr;
+        }
+        advance();
+        auto array = parse_type_impl(true);
+        if (array && array->kind != TypeKind::TYPE_ARRAY) {
+            error(ErrorCode::E403_INVALID_ATTRIBUTE,
+                  "@soa applies to array types, not '" + type_to_string(*array) + "'");
+            return nullptr;
+        }
+        if (array) {
+            array->soa = true;
+        }
+        return array;
+    }
+    auto type = parse_type_atom();
+    if (!type) {
+        return nullptr;
+    }
+    for (;;) {
+        if (match(TokenType::TOKEN_STAR)) {
+            type = make_pointer(type);
+            continue;
+        }
+        if (match(TokenType::TOKEN_AMPERSAND)) {
+            auto ref = make_type(TypeKind::TYPE_REFERENCE);
+            ref->element = type;
+            type = ref;
+            continue;
+        }
+        if (allow_array && check(TokenType::TOKEN_LBRACKET)) {
+            advance();
+            auto arr = make_type(TypeKind::TYPE_ARRAY);
+            arr->element = type;
+            if (!check(TokenType::TOKEN_RBRACKET)) {
+                auto size = parse_expression();
+                if (!size) {
+                    return nullptr;
+                }
+                arr->size_expr = std::move(size);
+            }
+            if (!expect(TokenType::TOKEN_RBRACKET, "']'")) {
+                return nullptr;
+            }
+            type = arr;
+            continue;
+        }
+        break;
+    }
+    return type;
+}
+
+std::shared_ptr<Type> Parser::parse_type_atom() {
+    if (is_primitive_type_token(peek_type())) {
+        return make_type(primitive_from_name(advance().lexeme));
+    }
+    if (check(TokenType::TOKEN_IDENT)) {
+        std::string name = advance().lexeme;
+        TypeKind kind = primitive_from_name(name);
+        if (kind != TypeKind::TYPE_UNKNOWN) {
+            return make_type(kind);
+        }
+        auto type = make_type(TypeKind::TYPE_UNKNOWN, std::move(name));
+        if (check(TokenType::TOKEN_LESS) && !parse_type_args(type->args)) {
+            return nullptr;
+        }
+        return type;
+    }
+    if (check(TokenType::TOKEN_LPAREN)) {
+        std::vector<Param> params;
+        if (!parse_params(params) || !expect(TokenType::TOKEN_COLON, "':'")) {
+            return nullptr;
+        }
+        auto fn = make_type(TypeKind::TYPE_FUNCTION);
+        fn->element = parse_type();
+        if (!fn->element) {
+            return nullptr;
+        }
+        for (Param& p : params) {
+            fn->args.push_back(std::move(p.type));
+        }
+        return fn;
+    }
+    const Token& tok = peek();
+    const char* desc = token_description(tok);
+    error(ErrorCode::E203_EXPECTED_TYPE,
+          std::string("expected type, found ") + (desc != nullptr ? desc : "'" + tok.lexeme + "'"));
+    return nullptr;
+}
+
+bool Parser::close_angle() {
+    if (match(TokenType::TOKEN_GREATER)) {
+        return true;
+    }
+    if (!split_shift && check(TokenType::TOKEN_RIGHT_SHIFT)) {
+        split_shift = true;
+        return true;
+    }
+    return false;
+}
+
+bool Parser::parse_type_args(std::vector<std::shared_ptr<Type>>& args) {
+    advance();  // '<'
+    do {
+        auto arg = parse_type();
+        if (!arg) {
+            return false;
+        }
+        args.push_back(std::move(arg));
+    } while (match(TokenType::TOKEN_COMMA));
+    if (!close_angle()) {
+        expect(TokenType::TOKEN_GREATER, "'>'");
+        return false;
+    }
+    return true;
+}
+
+// Speculatively parses "<T, ...>" in expression position. It only counts as a
+// type argument list when a call follows, e.g. identity<i32>(42).
+bool Parser::try_parse_type_args(std::vector<std::shared_ptr<Type>>& args) {
+    State state = save();
+    speculating++;
+    bool ok = parse_type_args(args) && check(TokenType::TOKEN_LPAREN);
+    speculating--;
+    if (!ok) {
+        args.clear();
+        restore(state);
+    }
+    return ok;
+}
+
+std::unique_ptr<ExprAST> Parser::parse_expression() {
+    return parse_assignment();
+}
+
+std::unique_ptr<ExprAST> Parser::parse_assignment() {
+    auto lhs = parse_binary(1);
+    if (!lhs) {
+        return nullptr;
+    }
+    if (is_assignment_op(peek_type())) {
+        const Token& op_tok = peek();
+        TokenType op = op_tok.type;
+        SourceLocation loc{op_tok.offset, op_tok.line, op_tok.column};
+        if (lhs->kind != ExprKind::EXPR_VARIABLE && lhs->kind != ExprKind::EXPR_INDEX &&
+            lhs->kind != ExprKind::EXPR_MEMBER) {
+            error(ErrorCode::E204_INVALID_ASSIGNMENT_TARGET, "invalid assignment target");
+            return nullptr;
+        }
+        advance();
+        auto rhs = parse_assignment();
+        if (!rhs) {
+            return nullptr;
+        }
+        return std::make_unique<AssignExprAST>(op, std::move(lhs), std::move(rhs), loc);
+    }
+    return lhs;
+}
+
+std::unique_ptr<ExprAST> Parser::parse_binary(int min_prec) {
+    auto lhs = parse_unary();
+    if (!lhs) {
+        return nullptr;
+    }
+    for (;;) {
+        int prec = binary_precedence(peek_type());
+        if (prec < min_prec) {
+            return lhs;
+        }
+        const Token& op_tok = advance();
+        TokenType op = op_tok.type;
+        SourceLocation loc{op_tok.offset, op_tok.line, op_tok.column};
+        auto rhs = parse_binary(prec + 1);
+        if (!rhs) {
+            return nullptr;
+        }
+        lhs = std::make_unique<BinaryExprAST>(op, std::move(lhs), std::move(rhs), loc);
+    }
+}
+
+std::unique_ptr<ExprAST> Parser::parse_unary() {
+    SourceLocation loc = location();
+    switch (peek_type()) {
+        case TokenType::TOKEN_LOGICAL_NOT:
+        case TokenType::TOKEN_MINUS:
+        case TokenType::TOKEN_TILDE:
+        case TokenType::TOKEN_PLUS_PLUS:
+        case TokenType::TOKEN_MINUS_MINUS: {
+            TokenType op = advance().type;
+            auto operand = parse_unary();
+            if (!operand) {
+                return nullptr;
+            }
+            return std::make_unique<UnaryExprAST>(op, std::move(operand), false, loc);
+        }
+        case TokenType::TOKEN_LPAREN: {
+            auto cast = try_parse_cast();
+            if (cast) {
+                return cast;
+            }
+            break;
+        }
+        default:
+            break;
+    }
+    auto primary = parse_primary();
+    if (!primary) {
+        return nullptr;
+    }
+    return parse_postfix(std::move(primary));
+}
+
+std::unique_ptr<ExprAST> Parser::try_parse_cast() {
+    // Only primitive target types are accepted so that "(a) - b" stays a
+    // parenthesized expression.
+    TokenType first = peek_type(1);
+    bool primitive = is_primitive_type_token(first) ||
+                     (first == TokenType::TOKEN_IDENT &&
+                      primitive_from_name(peek(1).lexeme) != TypeKind::TYPE_UNKNOWN);
+    if (!primitive) {
+        return nullptr;
+    }
+    State state = save();
+    SourceLocation loc = location();
+    advance();
+    speculating++;
+    auto target = parse_type();
+    speculating--;
+    if (!target || !match(TokenType::TOKEN_RPAREN) || !starts_operand(peek_type())) {
+        restore(state);
+        return nullptr;
+    }
+    auto operand = parse_unary();
+    if (!operand) {
+        return nullptr;
+    }
+    return std::make_unique<CastExprAST>(std::move(target), std::move(operand), loc);
+}
+
+std::unique_ptr<ExprAST> Parser::parse_postfix(std::unique_ptr<ExprAST> expr) {
+    for (;;) {
+        SourceLocation loc = location();
+        std::vector<std::shared_ptr<Type>> type_args;
+        if (check(TokenType::TOKEN_LESS) && (expr->kind == ExprKind::EXPR_VARIABLE ||
+                                             expr->kind == ExprKind::EXPR_MEMBER)) {
+            try_parse_type_args(type_args);
+        }
+        if (check(TokenType::TOKEN_LPAREN)) {
+            std::vector<std::unique_ptr<ExprAST>> args;
+            if (!parse_arguments(args)) {
+                return nullptr;
+            }
+            SourceLocation call_loc = expr->loc;
+            expr = std::make_unique<CallExprAST>(std::move(expr), std::move(type_args),
+                                                 std::move(args), call_loc);
+            continue;
+        }
+        if (match(TokenType::TOKEN_LBRACKET)) {
+            auto index = parse_expression();
+            if (!index || !expect(TokenType::TOKEN_RBRACKET, "']'")) {
+                return nullptr;
+            }
+            expr = std::make_unique<IndexExprAST>(std::move(expr), std::move(index), loc);
+            continue;
+        }
+        if (match(TokenType::TOKEN_DOT) || match(TokenType::TOKEN_ARROW)) {
+            if (!check(TokenType::TOKEN_IDENT)) {
+                expect(TokenType::TOKEN_IDENT, "member name");
+                return nullptr;
+            }
+            expr = std::make_unique<MemberExprAST>(std::move(expr), advance().lexeme, loc);
+            continue;
+        }
+        if (check(TokenType::TOKEN_PLUS_PLUS) || check(TokenType::TOKEN_MINUS_MINUS)) {
+            TokenType op = advance().type;
+            expr = std::make_unique<UnaryExprAST>(op, std::move(expr), true, loc);
+            continue;
+        }
+        return expr;
+    }
+}
+
+bool Parser::parse_arguments(std::vector<std::unique_ptr<ExprAST>>& args) {
+    advance();  // '('
+    if (match(TokenType::TOKEN_RPAREN)) {
+        return true;
+    }
+    do {
+        auto arg = parse_expression();
+        if (!arg) {
+            return false;
+        }
+        args.push_back(std::move(arg));
+    } while (match(TokenType::TOKEN_COMMA));
+    return expect(TokenType::TOKEN_RPAREN, "')'");
+}
+
+std::unique_ptr<ExprAST> Parser::parse_primary() {
+    SourceLocation loc = location();
+    const Token& tok = peek();
+    switch (tok.type) {
+        case TokenType::TOKEN_INT_LITERAL:
+            return std::make_unique<NumberExprAST>(advance().lexeme, false, loc);
+        case TokenType::TOKEN_FLOAT_LITERAL:
+            return std::make_unique<NumberExprAST>(advance().lexeme, true, loc);
+        case TokenType::TOKEN_TRUE:
+            advance();
+            return std::make_unique<BoolExprAST>(true, loc);
+        case TokenType::TOKEN_FALSE:
+            advance();
+            return std::make_unique<BoolExprAST>(false, loc);
+        case TokenType::TOKEN_NULL:
+            advance();
+            return std::make_unique<NullExprAST>(loc);
+        case TokenType::TOKEN_CHAR_LITERAL: {
+            const std::string& lex = advance().lexeme;
+            std::string body = lex.size() >= 2 ? lex.substr(1, lex.size() - 2) : "";
+            std::string decoded = decode_escapes(body);
+            return std::make_unique<CharExprAST>(decoded.empty() ? '\0' : decoded[0], loc);
+        }
+        case TokenType::TOKEN_STRING_LITERAL:
+            return parse_string(advance(), loc);
+        case TokenType::TOKEN_IDENT:
+        case TokenType::TOKEN_ARENA:
+            return std::make_unique<VariableExprAST>(advance().lexeme, loc);
+        case TokenType::TOKEN_STRING:
+            // string("...") constructs a string value.
+            return std::make_unique<VariableExprAST>(advance().lexeme, loc);
+        case TokenType::TOKEN_LPAREN:
+            return parse_paren();
+        case TokenType::TOKEN_LBRACKET: {
+            advance();
+            std::vector<std::unique_ptr<ExprAST>> elements;
+            if (!check(TokenType::TOKEN_RBRACKET)) {
+                do {
+                    auto e = parse_expression();
+                    if (!e) {
+                        return nullptr;
+                    }
+                    elements.push_back(std::move(e));
+                } while (match(TokenType::TOKEN_COMMA));
+            }
+            if (!expect(TokenType::TOKEN_RBRACKET, "']'")) {
+                return nullptr;
+            }
+            return std::make_unique<ArrayExprAST>(std::move(elements), loc);
+        }
+        case TokenType::TOKEN_NEW:
+            return parse_new();
+        case TokenType::TOKEN_DELETE: {
+            advance();
+            auto operand = parse_unary();
+            if (!operand) {
+                return nullptr;
+            }
+            return std::make_unique<DeleteExprAST>(std::move(operand), loc);
+        }
+        default: {
+            const char* desc = token_description(tok);
+            error(ErrorCode::E202_EXPECTED_EXPRESSION,
+                  std::string("expected expression, found ") +
+                      (desc != nullptr ? desc : "'" + tok.lexeme + "'"));
+            return nullptr;
+        }
+    }
+}
+
+std::unique_ptr<ExprAST> Parser::parse_paren() {
+    bool lambda = (peek_type(1) == TokenType::TOKEN_IDENT &&
+                   peek_type(2) == TokenType::TOKEN_COLON) ||
+                  (peek_type(1) == TokenType::TOKEN_RPAREN &&
+                   (peek_type(2) == TokenType::TOKEN_COLON || peek_type(2) == TokenType::TOKEN_LBRACE));
+    if (lambda) {
+        return parse_lambda();
+    }
+    advance();
+    auto expr = parse_expression();
+    if (!expr || !expect(TokenType::TOKEN_RPAREN, "')'")) {
+        return nullptr;
+    }
+    return expr;
+}
+
+std::unique_ptr<ExprAST> Parser::parse_lambda() {
+    SourceLocation loc = location();
+    std::vector<Param> params;
+    if (!parse_params(params)) {
+        return nullptr;
+    }
+    std::shared_ptr<Type> ret;
+    if (match(TokenType::TOKEN_COLON)) {
+        ret = parse_type();
+        if (!ret) {
+            return nullptr;
+        }
+    } else {
+        ret = make_type(TypeKind::TYPE_VOID);
+    }
+    auto body = parse_block();
+    if (!body) {
+        return nullptr;
+    }
+    auto proto = std::make_unique<PrototypeAST>("<lambda>", std::move(params), std::move(ret));
+    proto->loc = loc;
+    auto fn = std::make_unique<FunctionAST>(std::move(proto), std::move(body), loc);
+    return std::make_unique<LambdaExprAST>(std::move(fn), loc);
+}
+
+std::unique_ptr<ExprAST> Parser::parse_new() {
+    SourceLocation loc = location();
+    advance();
+    std::unique_ptr<ExprAST> arena;
+    if (check(TokenType::TOKEN_LPAREN)) {
+        advance();
+        arena = parse_expression();
+        if (!arena || !expect(TokenType::TOKEN_RPAREN, "')'")) {
+            return nullptr;
+        }
+    }
+    auto type = parse_type_impl(false);
+    if (!type) {
+        return nullptr;
+    }
+    auto expr = std::make_unique<NewExprAST>(std::move(type), loc);
+    expr->arena = std::move(arena);
+    if (match(TokenType::TOKEN_LBRACKET)) {
+        expr->count = parse_expression();
+        if (!expr->count || !expect(TokenType::TOKEN_RBRACKET, "']'")) {
+            return nullptr;
+        }
+    } else if (check(TokenType::TOKEN_LPAREN)) {
+        expr->has_args = true;
+        if (!parse_arguments(expr->args)) {
+            return nullptr;
+        }
+    }
+    return expr;
+}
+
+namespace {
+
+// Index of the '}' closing the `${` whose expression starts at `from`, skipping
+// nested braces, character literals and strings (with their own `${...}`).
+std::size_t interpolation_end(const std::string& text, std::size_t from) {
+    std::size_t depth = 0;
+    for (std::size_t i = from; i < text.size(); ++i) {
+        char c = text[i];
+        if (c == '\'') {
+            i += i + 1 < text.size() && text[i + 1] == '\\' ? 3 : 2;
+        } else if (c == '"') {
+            for (++i; i < text.size() && text[i] != '"'; ++i) {
+                if (text[i] == '\\') {
+                    ++i;
+                } else if (text[i] == '$' && i + 1 < text.size() && text[i + 1] == '{') {
+                    i = interpolation_end(text, i + 2);
+                }
+            }
+        } else if (c == '{') {
+            ++depth;
+        } else if (c == '}' && depth-- == 0) {
+            return i;
+        }
+    }
+    return text.size();
+}
+
+}  // namespace
+
+// A string literal, split at its `${...}` parts. Each expression is scanned
+// and parsed on its own, then moved to where it appears in the literal.
+std::unique_ptr<ExprAST> Parser::parse_string(const Token& token, SourceLocation loc) {
+    const std::string& lex = token.lexeme;
+    std::string body = lex.size() >= 2 ? lex.substr(1, lex.size() - 2) : "";
+    std::vector<std::string> fragments(1);
+    std::vector<std::unique_ptr<ExprAST>> parts;
+    for (std::size_t i = 0; i < body.size(); ++i) {
+        if (body[i] == '\\' && i + 1 < body.size()) {
+            fragments.back() += body.substr(i++, 2);
+            continue;
+        }
+        if (body[i] != '$' || i + 1 >= body.size() || body[i + 1] != '{') {
+            fragments.back() += body[i];
+            continue;
+        }
+        std::size_t end = interpolation_end(body, i + 2);
+        // Where the expression starts: one quote, then i + 2 bytes in.
+        std::size_t line = token.line;
+        std::size_t column = token.column;
+        for (std::size_t j = 0; j < i + 3; ++j) {
+            column = lex[j] == '\n' ? 1 : column + 1;
+            line += lex[j] == '\n' ? 1 : 0;
+        }
+        std::vector<Token> tokens =
+            Scanner(body.substr(i + 2, end - i - 2), speculating > 0 ? nullptr : diagnostics)
+                .get_tokens();
+        for (Token& t : tokens) {
+            t.column += t.line == 1 ? column - 1 : 0;
+            t.line += line - 1;
+            t.offset += token.offset + i + 3;
+        }
+        Parser parser(std::move(tokens), diagnostics);
+        parser.speculating = speculating;
+        std::unique_ptr<ExprAST> part;
+        if (!parser.is_at_end()) {
+            part = parser.parse_expression();
+        }
+        error_count += parser.error_count;
+        if (part == nullptr || !parser.is_at_end()) {
+            if (parser.error_count == 0) {
+                error_at(parser.peek(), ErrorCode::E202_EXPECTED_EXPRESSION,
+                         "expected one expression in '${...}'");
+            }
+            return nullptr;
+        }
+        parts.push_back(std::move(part));
+        fragments.emplace_back();
+        i = end;
+    }
+    for (std::string& fragment : fragments) {
+        fragment = decode_escapes(fragment);
+    }
+    if (parts.empty()) {
+        return std::make_unique<StringExprAST>(std::move(fragments[0]), loc);
+    }
+    return std::make_unique<InterpolationExprAST>(std::move(fragments), std::move(parts), loc);
+}
+
+std::string Parser::decode_escapes(const std::string& body) {
+    std::string out;
+    out.reserve(body.size());
+    for (std::size_t i = 0; i < body.size(); ++i) {
+        char c = body[i];
+        if (c != '\\' || i + 1 >= body.size()) {
+            out.push_back(c);
+            continue;
+        }
+        char e = body[++i];
+        switch (e) {
+            case 'n':
+                out.push_back('\n');
+                break;
+            case 't':
+                out.push_back('\t');
+                break;
+            case 'r':
+                out.push_back('\r');
+                break;
+            case '0':
+                out.push_back('\0');
+                break;
+            default:
+                out.push_back(e);
+                break;
+        }
+    }
+    return out;
+}
+
+}  // namespace pallas::frontend
@@ -1,7 +1,94 @@
 #pragma once
 
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+#include "ast.h"
+#include "diagnostics.h"
+#include "scanner.h"
+
 namespace pallas::frontend {
 
-struct Parser {};
+class Parser {
+  public:
+    Parser(std::vector<Token> tokens);
+    Parser(std::vector<Token> tokens, Diagnostics* diagnostics);
+
+    std::unique_ptr<ModuleAST> parse_module();
+    std::unique_ptr<ExprAST> parse_expression();
+    std::shared_ptr<Type> parse_type();
+    bool had_error() const { return error_count > 0; }
+
+  private:
+    struct State {
+        std::size_t current;
+        bool split_shift;
+    };
+
+    std::vector<Token> tokens;
+    std::size_t current = 0;
+    // A '>>' token whose first '>' already closed a type argument list.
+    bool split_shift = false;
+    mutable Token split_token;
+    int speculating = 0;
+    std::size_t error_count = 0;
+    Diagnostics* diagnostics = nullptr;
+
+    const Token& peek(std::size_t n = 0) const;
+    TokenType peek_type(std::size_t n = 0) const;
+    const Token& advance();
+    bool check(TokenType type) const;
+    bool match(TokenType type);
+    bool expect(TokenType type, const char* what);
+    bool is_at_end() const;
+    State save() const { return {current, split_shift}; }
+    void restore(State s);
+    SourceLocation location() const;
+    void error(ErrorCode code, const std::string& msg);
+    void error_at(const Token& tok, ErrorCode code, const std::string& msg);
+    void synchronize();
+
+    std::unique_ptr<StmtAST> parse_top_level();
+    bool parse_attributes(std::vector<Attribute>& attributes);
+    std::unique_ptr<FunctionAST> parse_function(FunctionKind kind);
+    std::unique_ptr<StructDeclAST> parse_struct(bool is_class);
+    bool parse_struct_member(StructDeclAST& decl, Visibility visibility);
+    std::unique_ptr<StmtAST> parse_import();
+    std::unique_ptr<StmtAST> parse_type_alias();
+    std::unique_ptr<VarDeclAST> parse_var_decl(NodeType kind);
+    std::vector<TypeParam> parse_type_params();
+    bool parse_params(std::vector<Param>& params);
+
+    std::unique_ptr<StmtAST> parse_statement();
+    std::unique_ptr<BlockStmtAST> parse_block();
+    std::unique_ptr<StmtAST> parse_if();
+    std::unique_ptr<StmtAST> parse_while();
+    std::unique_ptr<StmtAST> parse_for();
+    std::unique_ptr<StmtAST> parse_match();
+    std::unique_ptr<StmtAST> parse_arena();
+    std::unique_ptr<StmtAST> parse_return();
+
+    std::shared_ptr<Type> parse_type_impl(bool allow_array);
+    std::shared_ptr<Type> parse_type_atom();
+    bool parse_type_args(std::vector<std::shared_ptr<Type>>& args);
+    bool try_parse_type_args(std::vector<std::shared_ptr<Type>>& args);
+    bool close_angle();
+    bool starts_type() const;
+
+    std::unique_ptr<ExprAST> parse_assignment();
+    std::unique_ptr<ExprAST> parse_binary(int min_prec);
+    std::unique_ptr<ExprAST> parse_unary();
+    std::unique_ptr<ExprAST> parse_postfix(std::unique_ptr<ExprAST> expr);
+    std::unique_ptr<ExprAST> parse_primary();
+    std::unique_ptr<ExprAST> parse_string(const Token& token, SourceLocation loc);
+    std::unique_ptr<ExprAST> parse_paren();
+    std::unique_ptr<ExprAST> parse_new();
+    std::unique_ptr<ExprAST> parse_lambda();
+    std::unique_ptr<ExprAST> try_parse_cast();
+    bool parse_arguments(std::vector<std::unique_ptr<ExprAST>>& args);
+
+    static std::string decode_escapes(const std::string& body);
+};
 
-}  // namespace pallas::frontend
\ No newline at end of file
+}  // namespace pallas::frontend
@@ -4,6 +4,7 @@
 #include <string>
 #include <utility>
 #include "diagnostics.h"
+#include "support/trace.h"
 
 namespace pallas::frontend {
 
@@ -232,29 +233,71 @@ void Scanner::s_char() {
 }
 
 void Scanner::s_string() {
+    if (skip_string_body()) {
+        add_token(TokenType::TOKEN_STRING_LITERAL);
+        return;
+    }
+
+    report(Severity::Error, ErrorCode::E107_UNTERMINATED_STRING_LITERAL,
+           "unterminated string literal", start, position, start_line, start_column);
+
+    position = start + 1;
+    line = start_line;
+    column = start_column + 1;
+
+    return;
+}
+
+// Advances past the closing quote; false at the end of the input. The
+// expressions in `${...}` are skipped whole, so they may contain strings.
+bool Scanner::skip_string_body() {
     while (!is_at_end()) {
         char c = peek_char();
         if (c == '\"') {
             advance();
-            add_token(TokenType::TOKEN_STRING_LITERAL);
-            return;
+            return true;
         }
         if (c == '\\') {
             advance();
             if (!is_at_end()) advance();
             continue;
         }
+        if (c == '$' && peek_char(1) == '{') {
+            advance();
+            advance();
+            if (!skip_interpolation()) {
+                return false;
+            }
+            continue;
+        }
         advance();
     }
+    return false;
+}
 
-    report(Severity::Error, ErrorCode::E107_UNTERMINATED_STRING_LITERAL,
-           "unterminated string literal", start, position, start_line, start_column);
-
-    position = start + 1;
-    line = start_line;
-    column = start_column + 1;
-
-    return;
+// Advances past the '}' that closes a `${`.
+bool Scanner::skip_interpolation() {
+    std::size_t depth = 0;
+    while (!is_at_end()) {
+        char c = advance();
+        if (c == '\"') {
+            if (!skip_string_body()) {
+                return false;
+            }
+        } else if (c == '\'') {
+            if (peek_char() == '\\') advance();
+            advance();
+            match_char('\'');
+        } else if (c == '{') {
+            ++depth;
+        } else if (c == '}') {
+            if (depth == 0) {
+                return true;
+            }
+            --depth;
+        }
+    }
+    return false;
 }
 
 void Scanner::s_operator() {
@@ -380,6 +423,9 @@ void Scanner::s_operator() {
             if (peek_char() == '=') {
                 advance();
                 add_token(TokenType::TOKEN_EQUAL);
+            } else if (peek_char() == '>') {
+                advance();
+                add_token(TokenType::TOKEN_FAT_ARROW);
             } else {
                 add_token(TokenType::TOKEN_ASSIGN);
             }
@@ -466,6 +512,7 @@ void Scanner::s_operator() {
 }
 
 void Scanner::scan() {
+    support::TraceScope trace("scan");
     while (!is_at_end()) {
         skip_untracked();
         if (is_at_end()) {
@@ -506,6 +553,7 @@ void Scanner::scan() {
     start_line = line;
     start_column = column;
     add_token(TokenType::TOKEN_EOF);
+    trace.set_items(tokens.size());
 }
 
 Scanner::Scanner(std::string source_text) : source(std::move(source_text)) {
@@ -72,6 +72,7 @@ enum class TokenType {
     TOKEN_AT,
     TOKEN_DOUBLE_COLON,
     TOKEN_ARROW,
+    TOKEN_FAT_ARROW,
     TOKEN_ASSIGN,
     TOKEN_PLUS_ASSIGN,
     TOKEN_MINUS_ASSIGN,
@@ -118,7 +119,9 @@ class Scanner {
     std::vector<Token> get_tokens();
     Diagnostics* get_diagnostics() const { return diagnostics; }
     private:
-    std::unordered_map<std::string, TokenType> keywords = {
+    // Built once per process rather than per scanner, which matters to a
+    // compile server scanning many files.
+    inline static const std::unordered_map<std::string, TokenType> keywords = {
         {"import", TokenType::TOKEN_IMPORT},   {"if", TokenType::TOKEN_IF},
         {"else", TokenType::TOKEN_ELSE},       {"for", TokenType::TOKEN_FOR},
         {"while", TokenType::TOKEN_WHILE},     {"do", TokenType::TOKEN_DO},
@@ -163,6 +166,8 @@ class Scanner {
     void s_number();
     void s_char();
     void s_string();
+    bool skip_string_body();
+    bool skip_interpolation();
     void s_operator();
     void scan();
 };
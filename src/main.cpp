@@ -1,6 +1,1125 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
 #include <iostream>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "backend/bench.h"
+#include "backend/codegen.h"
+#include "backend/x86_64.h"
+#include "frontend/const_eval.h"
+#include "frontend/diagnostics.h"
+#include "frontend/parser.h"
+#include "frontend/scanner.h"
+#include "middle/interpreter.h"
+#include "middle/ir.h"
+#include "middle/layout.h"
+#include "middle/link.h"
+#include "middle/lower.h"
+#include "middle/passes.h"
+#include "middle/profile.h"
+#include "middle/transforms.h"
+#include "runtime/heap_profile.h"
+#include "support/server.h"
+#include "support/trace.h"
 
-int main() {
-    std::cout << "Welcome to this cool compiler yo!" << '\n';
+using namespace pallas;
+
+namespace {
+
+struct Options {
+    std::string input;
+    bool layout_report = false;
+    bool reorder_fields = false;
+    bool emit_ir = false;
+    bool time_passes = false;
+    bool verify_each = false;
+    bool run = false;
+    bool run_stats = false;
+    bool jit = false;  // `palc run`: compile main() with LLVM and call it
+    bool bench = false;  // `palc bench`: measure the @bench functions
+    std::string bench_filter;
+    unsigned bench_samples = 20;
+    std::string bench_json;     // file to write the results to, "-" for stdout
+    std::string bench_compare;  // results of an earlier run to compare with
+    bool emit_llvm = false;
+    bool x86_backend = false;  // -o and `palc run` without LLVM's code generator
+    std::string output;  // object file to write
+    unsigned codegen_partitions = 1;
+    bool bounds_checks = true;
+    bool bounds_report = false;
+    int opt_level = 0;
+    unsigned threads = 0;  // for function passes and x86 codegen, 0 = one per hardware thread
+    std::string passes;  // explicit pipeline, comma separated
+    std::string profile_generate;  // profile to write from an instrumented build
+    std::string profile_use;       // profile to optimize with
+    std::string heap_profile;      // heap profile to write from an instrumented build
+    std::uint64_t heap_profile_rate = runtime::kDefaultHeapSampleRate;
+    bool time_trace = false;
+    std::string time_trace_file;  // empty: next to the output or the input
+    bool lto = false;           // whole-program optimization across imports
+    bool emit_summary = false;  // print the summary of every module
+    bool help = false;
+    bool server = false;       // palc --server
+    bool client = false;       // forward to a server
+    bool stop_server = false;
+    std::string socket;        // of the server; empty for the default
+};
+
+constexpr const char* kDefaultProfile = "default.palprof";
+constexpr const char* kDefaultHeapProfile = "heap.pprof";
+
+void print_usage() {
+    std::cout << "usage: palc [options] <file.pal | file.pir>\n"
+                 "       palc run [options] <file>  compile main() with the JIT and run it\n"
+                 "       palc bench [options] <file>\n"
+                 "                          measure the @bench functions (at -O2 unless given)\n"
+                 "  -O0 .. -O3         optimization level\n"
+                 "  --passes=a,b,c     run the named IR passes instead of the -O pipeline\n"
+                 "  --emit-ir          print the IR after optimization\n"
+                 "  --time-passes      report time, instruction and memory deltas per pass\n"
+                 "  --verify-each      verify the IR after every pass\n"
+                 "  -j N               optimize functions, and assign their x86 registers,\n"
+                 "                     on N threads (default: all cores)\n"
+                 "  --run              interpret main() after optimization (exit code = result)\n"
+                 "  --run-stats        with --run, report executed instructions and run time;\n"
+                 "                     with palc run, the run time\n"
+                 "  -o <file.o>        write an object file\n"
+                 "  --backend=llvm|x86 code generator for -o and palc run: LLVM (default), or\n"
+                 "                     the direct x86-64 backend for fast debug builds\n"
+                 "  --emit-llvm        print the LLVM IR after LLVM's optimizations\n"
+                 "  --codegen-partitions=N\n"
+                 "                     split large modules into N objects generated in parallel\n"
+                 "  --no-bounds-checks do not check indexing of fixed-size arrays at run time\n"
+                 "  --bounds-report    per function, bounds checks removed, hoisted and remaining\n"
+                 "  --layout-report    print size, alignment and field offsets of every type\n"
+                 "                     and of every @soa array\n"
+                 "  --reorder-fields   reorder fields of all structs to minimize padding\n"
+                 "  -fprofile-generate[=file]\n"
+                 "                     instrument the program to write an execution profile\n"
+                 "                     when main returns (default: default.palprof)\n"
+                 "  -fprofile-use[=file]\n"
+                 "                     optimize with a profile: inlining, branch weights,\n"
+                 "                     switch case order and cold block placement\n"
+                 "  -fheap-profile[=file]\n"
+                 "                     sample heap allocations by site and write a pprof\n"
+                 "                     profile when main returns (default: heap.pprof)\n"
+                 "  -fheap-profile-rate=N\n"
+                 "                     about one sample per N bytes allocated (default:\n"
+                 "                     524288; 0 records every allocation)\n"
+                 "  -ftime-trace[=file] write a Chrome trace of the compiler's phases (default:\n"
+                 "                     the output or input with .json) and print a summary\n"
+                 "  -flto              optimize the program as a whole: inline across imports,\n"
+                 "                     internalize functions and remove the ones not used\n"
+                 "  --emit-summary     print the summary of every module the program links\n"
+                 "  --filter=text      palc bench: only benchmarks whose name contains text\n"
+                 "  --samples=N        palc bench: timed samples per benchmark (default: 20)\n"
+                 "  --json=file        palc bench: write the results as JSON ('-': stdout)\n"
+                 "  --compare=file     palc bench: show the change from results in file\n"
+                 "  --server[=socket]  stay running as a compile server that keeps the optimized\n"
+                 "                     IR of unchanged files between requests\n"
+                 "  --client[=socket]  have the compile server do this compilation, or compile\n"
+                 "                     here when none is listening\n"
+                 "  --stop-server[=socket]\n"
+                 "                     ask the compile server to exit\n"
+                 "  --help             show this message\n"
+                 "\n"
+                 "Files ending in .pir are read as textual IR. The server socket defaults to\n"
+                 "$PALC_SERVER_SOCKET, or else $XDG_RUNTIME_DIR/palc.sock, or else\n"
+                 "/tmp/palc-<uid>/server.sock.\n";
+}
+
+// Takes the arguments without the program name.
+bool parse_args(const std::vector<std::string>& args, Options& options) {
+    std::size_t first = 0;
+    if (!args.empty() && args[0] == "run") {
+        options.jit = true;
+        first = 1;
+    } else if (!args.empty() && args[0] == "bench") {
+        options.bench = true;
+        options.opt_level = 2;  // benchmarks measure release builds
+        first = 1;
+    }
+    std::size_t argc = args.size();
+    for (std::size_t i = first; i < argc; ++i) {
+        const std::string& arg = args[i];
+        if (arg == "--help" || arg == "-h") {
+            options.help = true;
+            return true;
+        } else if (arg == "--layout-report") {
+            options.layout_report = true;
+        } else if (arg == "--reorder-fields") {
+            options.reorder_fields = true;
+        } else if (arg == "--emit-ir") {
+            options.emit_ir = true;
+        } else if (arg == "--time-passes" || arg == "-time-passes") {
+            options.time_passes = true;
+        } else if (arg == "--no-bounds-checks") {
+            options.bounds_checks = false;
+        } else if (arg == "--bounds-report") {
+            options.bounds_report = true;
+        } else if (arg == "--verify-each") {
+            options.verify_each = true;
+        } else if (arg == "--run") {
+            options.run = true;
+        } else if (arg == "--run-stats") {
+            options.run = !options.jit;
+            options.run_stats = true;
+        } else if (arg.size() == 3 && arg[0] == '-' && arg[1] == 'O' && arg[2] >= '0' &&
+                   arg[2] <= '3') {
+            options.opt_level = arg[2] - '0';
+        } else if (arg.rfind("-j", 0) == 0) {
+            std::string count = arg.size() > 2 ? arg.substr(2) : (i + 1 < argc ? args[++i] : "");
+            char* end = nullptr;
+            unsigned long n = std::strtoul(count.c_str(), &end, 10);
+            if (count.empty() || *end != '\0' || n == 0 || n > 1024) {
+                std::cerr << "palc: -j expects a thread count from 1 to 1024\n";
+                return false;
+            }
+            options.threads = static_cast<unsigned>(n);
+        } else if (arg == "-o") {
+            if (i + 1 >= argc) {
+                std::cerr << "palc: -o expects a file name\n";
+                return false;
+            }
+            options.output = args[++i];
+        } else if (arg.rfind("--backend=", 0) == 0) {
+            std::string name = arg.substr(10);
+            if (name != "llvm" && name != "x86") {
+                std::cerr << "palc: --backend expects 'llvm' or 'x86'\n";
+                return false;
+            }
+            options.x86_backend = name == "x86";
+        } else if (arg == "--emit-llvm") {
+            options.emit_llvm = true;
+        } else if (arg.rfind("--codegen-partitions=", 0) == 0) {
+            unsigned long n = std::strtoul(arg.c_str() + 21, nullptr, 10);
+            if (n == 0 || n > 256) {
+                std::cerr << "palc: --codegen-partitions expects a count from 1 to 256\n";
+                return false;
+            }
+            options.codegen_partitions = static_cast<unsigned>(n);
+        } else if (arg == "-fprofile-generate" || arg.rfind("-fprofile-generate=", 0) == 0) {
+            options.profile_generate = arg.size() > 18 ? arg.substr(19) : kDefaultProfile;
+        } else if (arg == "-fprofile-use" || arg.rfind("-fprofile-use=", 0) == 0) {
+            options.profile_use = arg.size() > 13 ? arg.substr(14) : kDefaultProfile;
+        } else if (arg == "-fheap-profile" || arg.rfind("-fheap-profile=", 0) == 0) {
+            options.heap_profile = arg.size() > 14 ? arg.substr(15) : kDefaultHeapProfile;
+        } else if (arg.rfind("-fheap-profile-rate=", 0) == 0) {
+            char* end = nullptr;
+            options.heap_profile_rate = std::strtoull(arg.c_str() + 20, &end, 10);
+            if (end == arg.c_str() + 20 || *end != '\0') {
+                std::cerr << "palc: -fheap-profile-rate expects a number of bytes\n";
+                return false;
+            }
+        } else if (arg == "-flto") {
+            options.lto = true;
+        } else if (arg == "--emit-summary") {
+            options.emit_summary = true;
+        } else if (arg == "-ftime-trace" || arg.rfind("-ftime-trace=", 0) == 0) {
+            options.time_trace = true;
+            options.time_trace_file = arg.size() > 12 ? arg.substr(13) : "";
+        } else if (arg == "--server" || arg.rfind("--server=", 0) == 0) {
+            options.server = true;
+            options.socket = arg.size() > 8 ? arg.substr(9) : "";
+        } else if (arg == "--stop-server" || arg.rfind("--stop-server=", 0) == 0) {
+            options.stop_server = true;
+            options.socket = arg.size() > 13 ? arg.substr(14) : "";
+        } else if (options.bench && arg.rfind("--filter=", 0) == 0) {
+            options.bench_filter = arg.substr(9);
+        } else if (options.bench && arg.rfind("--samples=", 0) == 0) {
+            unsigned long n = std::strtoul(arg.c_str() + 10, nullptr, 10);
+            if (n == 0 || n > 10000) {
+                std::cerr << "palc: --samples expects a count from 1 to 10000\n";
+                return false;
+            }
+            options.bench_samples = static_cast<unsigned>(n);
+        } else if (options.bench && arg.rfind("--json=", 0) == 0) {
+            options.bench_json = arg.substr(7);
+        } else if (options.bench && arg.rfind("--compare=", 0) == 0) {
+            options.bench_compare = arg.substr(10);
+        } else if (arg.rfind("--passes=", 0) == 0) {
+            options.passes = arg.substr(9);
+        } else if (!arg.empty() && arg[0] == '-') {
+            std::cerr << "palc: unknown option '" << arg << "'\n";
+            return false;
+        } else if (options.input.empty()) {
+            options.input = arg;
+        } else {
+            std::cerr << "palc: more than one input file\n";
+            return false;
+        }
+    }
+    if (options.input.empty() && !options.server && !options.stop_server) {
+        print_usage();
+        return false;
+    }
+    if (!options.heap_profile.empty() && (options.run || options.bench)) {
+        std::cerr << "palc: -fheap-profile needs compiled code (-o or palc run)\n";
+        return false;
+    }
+    return true;
+}
+
+bool has_errors(const frontend::Diagnostics& diagnostics) {
+    for (const frontend::Info& d : diagnostics.all()) {
+        if (d.severity == frontend::Severity::Error) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ends_with(const std::string& s, const std::string& suffix) {
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+int run_main(const middle::Module& module, const Options& options) {
+    support::TraceScope trace("run");
+    middle::Interpreter interpreter(module);
+    middle::ExecutionResult result = interpreter.run("main");
+    if (!result.ok) {
+        std::cerr << "palc: run failed: " << result.error << '\n';
+        return 1;
+    }
+    if (options.run_stats) {
+        const middle::ExecutionStats& stats = result.stats;
+        std::cerr << "executed " << stats.instructions << " instructions (" << stats.calls
+                  << " calls, " << stats.loads << " loads, " << stats.stores << " stores, "
+                  << stats.bounds_checks << " bounds checks, " << stats.allocations
+                  << " allocations, " << stats.frees << " frees, " << stats.arena_refills
+                  << " arena refills) in "
+                  << stats.seconds * 1000.0 << " ms\n";
+    }
+    return static_cast<int>(result.value & 0xff);
+}
+
+bool write_file(const std::string& path, const std::string& contents) {
+    std::ofstream out(path, std::ios::binary);
+    out << contents;
+    return static_cast<bool>(out);
+}
+
+int report_run(const backend::RunResult& result, const Options& options) {
+    if (!result.ok) {
+        std::cerr << "palc: run failed: " << result.error << '\n';
+        return 1;
+    }
+    if (options.run_stats) {
+        std::cerr << "ran in " << result.seconds * 1000.0 << " ms\n";
+    }
+    return static_cast<int>(result.value & 0xff);
+}
+
+int codegen_x86(const middle::Module& module, const Options& options) {
+    std::string error;
+    std::string object = backend::emit_x86_object(module, &error, options.threads);
+    if (object.empty()) {
+        std::cerr << "palc: " << error << '\n';
+        return 1;
+    }
+    if (!options.output.empty() && !write_file(options.output, object)) {
+        std::cerr << "palc: cannot write '" << options.output << "'\n";
+        return 1;
+    }
+    if (options.jit) {
+        support::TraceScope trace("run");
+        return report_run(backend::run_object(module, object), options);
+    }
+    return 0;
+}
+
+int codegen(const middle::Module& module, const Options& options) {
+    backend::CodegenOptions codegen_options;
+    codegen_options.opt_level = options.opt_level;
+    codegen_options.partitions = options.codegen_partitions;
+    std::string error;
+    if (options.emit_llvm) {
+        std::string text = backend::emit_llvm_ir(module, codegen_options, &error);
+        if (text.empty()) {
+            std::cerr << "palc: " << error << '\n';
+            return 1;
+        }
+        std::cout << text;
+    }
+    if (options.x86_backend) {
+        return codegen_x86(module, options);
+    }
+    if (!options.output.empty()) {
+        std::vector<std::string> written;
+        if (!backend::emit_object(module, options.output, codegen_options, &written, &error)) {
+            std::cerr << "palc: " << error << '\n';
+            return 1;
+        }
+        if (written.size() > 1) {
+            std::cerr << "palc: wrote " << written.size() << " objects:";
+            for (const std::string& path : written) {
+                std::cerr << ' ' << path;
+            }
+            std::cerr << '\n';
+        }
+    }
+    if (options.jit) {
+        support::TraceScope trace("run");
+        return report_run(backend::run_jit(module, codegen_options), options);
+    }
+    return 0;
+}
+
+// Attaches the counts of the profile to the module; functions changed since it
+// was collected are compiled without them.
+bool use_profile(middle::Module& module, const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "palc: cannot open profile '" << path << "'\n";
+        return false;
+    }
+    std::stringstream bytes;
+    bytes << file.rdbuf();
+    middle::ProfileData profile;
+    std::string error;
+    if (!middle::parse_profile(bytes.str(), &profile, &error)) {
+        std::cerr << "palc: " << path << ": " << error << '\n';
+        return false;
+    }
+    for (const std::string& name : middle::apply_profile(module, profile).stale) {
+        std::cerr << "palc: warning: profile for '@" << name
+                  << "' does not match its code and is ignored\n";
+    }
+    return true;
+}
+
+int optimize(middle::Module& module, const Options& options) {
+    if (!options.profile_use.empty() && !use_profile(module, options.profile_use)) {
+        return 1;
+    }
+    middle::PassOptions pass_options;
+    pass_options.time_passes = options.time_passes;
+    pass_options.verify_each = options.verify_each;
+    pass_options.threads = options.threads;
+    middle::PassManager passes(pass_options);
+    middle::BoundsCheckReport bounds;
+    if (!options.profile_generate.empty()) {
+        // Counters are numbered on the IR as lowered, which is what a build
+        // using the profile matches them against.
+        passes.add(middle::create_profile_generate_pass(options.profile_generate));
+    }
+    if (!options.passes.empty()) {
+        std::stringstream list(options.passes);
+        std::string name;
+        while (std::getline(list, name, ',')) {
+            if (!middle::add_pass_by_name(passes, name)) {
+                std::cerr << "palc: unknown pass '" << name << "'\n";
+                return 1;
+            }
+        }
+    } else {
+        middle::build_pipeline(passes, options.opt_level, &bounds);
+    }
+    if (!options.profile_use.empty()) {
+        middle::add_pass_by_name(passes, "profile-layout");
+    }
+    if (!options.heap_profile.empty()) {
+        passes.add(middle::create_heap_profile_pass(options.heap_profile,
+                                                    options.heap_profile_rate));
+    }
+    if (options.x86_backend && !options.run) {
+        // The x86 backend handles scalars only.
+        middle::add_pass_by_name(passes, "scalarize");
+    }
+    if (!passes.run(module)) {
+        std::cerr << "palc: " << passes.error() << '\n';
+        return 1;
+    }
+    if (options.emit_ir) {
+        std::cout << middle::print_module(module);
+    }
+    if (options.time_passes) {
+        std::cerr << passes.timing_report();
+    }
+    if (options.bounds_report) {
+        // Functions may have been optimized in any order; report in module order.
+        std::unordered_map<std::string, std::size_t> order;
+        for (const auto& fn : module.functions) {
+            order.emplace(fn->name, order.size());
+        }
+        std::stable_sort(bounds.functions.begin(), bounds.functions.end(),
+                         [&](const auto& a, const auto& b) {
+                             return order[a.function] < order[b.function];
+                         });
+        for (const middle::BoundsCheckReport::Entry& entry : bounds.functions) {
+            std::cerr << "bounds checks in @" << entry.function << ": " << entry.removed
+                      << " removed, " << entry.hoisted << " hoisted, " << entry.remaining
+                      << " remaining\n";
+        }
+    }
+    return 0;
+}
+
+// Runs or generates code for the optimized module.
+bool read_file(const std::string& path, std::string* contents) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    std::stringstream bytes;
+    bytes << file.rdbuf();
+    *contents = bytes.str();
+    return true;
+}
+
+int bench(const middle::Module& module, const Options& options) {
+    if (options.x86_backend || !backend::llvm_available()) {
+        std::cerr << "palc: palc bench needs the LLVM backend\n";
+        return 1;
+    }
+    std::vector<backend::BenchResult> baseline;
+    if (!options.bench_compare.empty()) {
+        std::string text;
+        std::string error;
+        if (!read_file(options.bench_compare, &text)) {
+            std::cerr << "palc: cannot open '" << options.bench_compare << "'\n";
+            return 1;
+        }
+        if (!backend::parse_bench_json(text, &baseline, &error)) {
+            std::cerr << "palc: " << options.bench_compare << ": " << error << '\n';
+            return 1;
+        }
+    }
+    backend::BenchOptions bench_options;
+    bench_options.opt_level = options.opt_level;
+    bench_options.filter = options.bench_filter;
+    bench_options.samples = options.bench_samples;
+    std::vector<backend::BenchResult> results;
+    std::string error;
+    if (!backend::run_benchmarks(module, bench_options, &results, &error)) {
+        std::cerr << "palc: bench failed: " << error << '\n';
+        return 1;
+    }
+    if (results.empty()) {
+        std::cerr << "palc: no @bench functions" << (options.bench_filter.empty() ? "" : " match")
+                  << '\n';
+        return 1;
+    }
+    std::string json = backend::bench_json(results, options.input, options.opt_level);
+    if (options.bench_json == "-") {
+        std::cout << json;
+        return 0;
+    }
+    std::cout << backend::bench_table(results, options.bench_compare.empty() ? nullptr
+                                                                            : &baseline);
+    if (!options.bench_json.empty() && !write_file(options.bench_json, json)) {
+        std::cerr << "palc: cannot write '" << options.bench_json << "'\n";
+        return 1;
+    }
     return 0;
 }
+
+int emit(const middle::Module& module, const Options& options) {
+    if (options.bench) {
+        return bench(module, options);
+    }
+    if (options.run) {
+        return run_main(module, options);
+    }
+    return codegen(module, options);
+}
+
+// Where -ftime-trace writes when no file is given: the object file, or else
+// the input, with its extension replaced by .json.
+std::string trace_path(const Options& options) {
+    if (!options.time_trace_file.empty()) {
+        return options.time_trace_file;
+    }
+    const std::string& base = options.output.empty() ? options.input : options.output;
+    std::size_t slash = base.find_last_of('/');
+    std::size_t dot = base.find_last_of('.');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+        dot = base.size();
+    }
+    return base.substr(0, dot) + ".json";
+}
+
+// The optimized IR of an input and the diagnostics compiling it printed.
+struct Compiled {
+    frontend::Diagnostics diagnostics;
+    std::unique_ptr<middle::Module> module;
+    bool imports = false;  // other files went into it
+};
+
+bool wants_ir(const Options& options) {
+    return options.emit_ir || options.run || options.time_passes || options.bounds_report ||
+           !options.passes.empty() || options.jit || options.emit_llvm || !options.output.empty() ||
+           options.emit_summary || options.bench;
+}
+
+// Constant evaluation, layout and lowering of a parsed file. Null after errors
+// or when no IR is needed.
+std::unique_ptr<middle::Module> lower_file(frontend::ModuleAST& ast, const Options& options,
+                                           middle::LowerOptions lower_options,
+                                           frontend::Diagnostics& diagnostics) {
+    frontend::ConstEvaluator evaluator(ast, &diagnostics);
+    evaluator.evaluate_all();
+    evaluator.resolve_array_sizes(ast);
+
+    middle::LayoutOptions layout_options;
+    layout_options.reorder_all = options.reorder_fields;
+    middle::LayoutEngine layout(ast, &diagnostics, layout_options);
+    if (options.layout_report) {
+        std::cout << layout.report();
+    } else {
+        layout.compute_all();
+    }
+    if (!wants_ir(options) || has_errors(diagnostics)) {
+        return nullptr;
+    }
+    lower_options.bounds_checks = options.bounds_checks;
+    auto module = middle::lower_module(ast, evaluator, layout, &diagnostics, lower_options);
+    return has_errors(diagnostics) ? nullptr : std::move(module);
+}
+
+// A file of a program of several.
+struct SourceFile {
+    std::string path;
+    std::string source;
+    std::unique_ptr<frontend::ModuleAST> ast;
+    frontend::Diagnostics diagnostics;
+    std::vector<std::size_t> imports;  // files it imports
+};
+
+// The file `import "name";` in `from` refers to: relative to the importing
+// file, with .pal added when it has no extension.
+std::string import_path(const std::string& from, const std::string& name) {
+    std::filesystem::path path = std::filesystem::path(from).parent_path() / name;
+    if (!path.has_extension()) {
+        path += ".pal";
+    }
+    return path.lexically_normal().string();
+}
+
+// Reads and parses every file the files in `files` import, directly or not.
+bool load_imports(std::vector<SourceFile>& files) {
+    std::unordered_map<std::string, std::size_t> index;
+    for (std::size_t i = 0; i < files.size(); ++i) {
+        index.emplace(std::filesystem::path(files[i].path).lexically_normal().string(), i);
+    }
+    for (std::size_t i = 0; i < files.size(); ++i) {
+        for (const auto& decl : files[i].ast->decls) {
+            if (decl->kind != frontend::NodeType::NODE_IMPORT) {
+                continue;
+            }
+            const auto& import = static_cast<const frontend::ImportAST&>(*decl);
+            std::string path = import_path(files[i].path, import.path);
+            auto [found, added] = index.emplace(path, files.size());
+            if (added) {
+                std::ifstream file(path);
+                if (!file) {
+                    std::cerr << "palc: " << files[i].path << ": cannot open import '"
+                              << import.path << "' (" << path << ")\n";
+                    return false;
+                }
+                std::stringstream buffer;
+                buffer << file.rdbuf();
+                SourceFile& added_file = files.emplace_back();
+                added_file.path = path;
+                added_file.source = buffer.str();
+                frontend::Scanner scanner(added_file.source, &added_file.diagnostics);
+                frontend::Parser parser(scanner.get_tokens(), &added_file.diagnostics);
+                added_file.ast = parser.parse_module();
+            }
+            files[i].imports.push_back(found->second);
+        }
+    }
+    return true;
+}
+
+// Lowers file `i` on its own, with the declarations of every file it imports
+// directly or not: their functions are called, not compiled.
+std::unique_ptr<middle::Module> lower_module_of(std::vector<SourceFile>& files, std::size_t i,
+                                                const Options& options) {
+    std::vector<bool> seen(files.size(), false);
+    std::vector<std::size_t> work = files[i].imports;
+    seen[i] = true;
+    middle::LowerOptions lower_options;
+    while (!work.empty()) {
+        std::size_t j = work.back();
+        work.pop_back();
+        if (seen[j]) {
+            continue;
+        }
+        seen[j] = true;
+        work.insert(work.end(), files[j].imports.begin(), files[j].imports.end());
+        // A fresh parse: the declarations move into this file's tree. Errors
+        // in the file are reported when it is compiled itself.
+        frontend::Diagnostics ignored;
+        frontend::Scanner scanner(files[j].source, &ignored);
+        frontend::Parser parser(scanner.get_tokens(), &ignored);
+        auto imported = parser.parse_module();
+        frontend::import_declarations(*files[i].ast, *imported, lower_options.imported);
+    }
+    return lower_file(*files[i].ast, options, std::move(lower_options), files[i].diagnostics);
+}
+
+int optimize(middle::Module& module, const Options& options);
+
+// The options that change the optimized IR of a file, for the keys of the
+// compile server's caches. Empty when the compilation reports on itself
+// (--time-passes and the like), and so is not cached.
+std::string cache_options(const Options& options) {
+    if (options.time_passes || options.bounds_report || options.layout_report ||
+        options.emit_summary || options.time_trace || !options.profile_use.empty()) {
+        return {};
+    }
+    return std::to_string(options.opt_level) + ',' + options.passes + ',' +
+           options.profile_generate + ',' + options.heap_profile + ',' +
+           std::to_string(options.heap_profile_rate) + ',' +
+           (options.bounds_checks ? 'b' : '-') + (options.reorder_fields ? 'r' : '-') +
+           (options.verify_each ? 'v' : '-') + (options.lto ? 'l' : '-') +
+           (options.x86_backend && !options.run ? 's' : '-');
+}
+
+// What `palc --server` keeps of the files of programs with imports: for each
+// file and set of options, its optimized module before linking, the module's
+// summary and the diagnostics compiling it printed. An entry is reused while
+// the file and every file it imports, directly or not, hash the same; all of
+// them are read anyway to find the imports.
+class ModuleCache {
+  public:
+    struct Entry {
+        std::size_t hash = 0;
+        std::unique_ptr<middle::Module> module;
+        middle::ModuleSummary summary;
+        std::vector<frontend::Info> diagnostics;
+        std::uint64_t last_use = 0;
+    };
+
+    static constexpr std::size_t kMaxEntries = 256;
+
+    // Empty when `path` cannot be made absolute.
+    static std::string key(const std::string& path, const std::string& options) {
+        std::error_code code;
+        std::filesystem::path absolute = std::filesystem::absolute(path, code);
+        return code ? std::string() : absolute.lexically_normal().string() + '\n' + options;
+    }
+
+    Entry* find(const std::string& key, std::size_t hash) {
+        auto it = entries.find(key);
+        if (it == entries.end() || it->second.hash != hash) {
+            return nullptr;
+        }
+        it->second.last_use = ++uses;
+        return &it->second;
+    }
+
+    void insert(const std::string& key, Entry entry) {
+        if (entries.size() >= kMaxEntries && entries.find(key) == entries.end()) {
+            auto oldest = std::min_element(entries.begin(), entries.end(),
+                                           [](const auto& a, const auto& b) {
+                                               return a.second.last_use < b.second.last_use;
+                                           });
+            entries.erase(oldest);
+        }
+        entry.last_use = ++uses;
+        entries[key] = std::move(entry);
+    }
+
+  private:
+    std::map<std::string, Entry> entries;
+    std::uint64_t uses = 0;
+};
+
+// Hash of the sources file `i` is compiled from: its own and those of the
+// files it imports, directly or not.
+std::size_t sources_hash(const std::vector<SourceFile>& files, std::size_t i) {
+    std::vector<bool> seen(files.size(), false);
+    std::vector<std::size_t> work{i};
+    std::size_t hash = 0;
+    while (!work.empty()) {
+        std::size_t j = work.back();
+        work.pop_back();
+        if (seen[j]) {
+            continue;
+        }
+        seen[j] = true;
+        work.insert(work.end(), files[j].imports.begin(), files[j].imports.end());
+        hash = hash * 31 + std::hash<std::string_view>{}(files[j].source);
+    }
+    return hash;
+}
+
+// A program that imports other files, or any program under -flto: every file
+// is compiled and optimized as a module of its own and summarized, then the
+// modules are linked, with whole-program optimization under -flto. With
+// `modules`, files whose sources did not change start from their cached
+// module.
+int build_program(std::unique_ptr<frontend::ModuleAST> root, const std::string& source,
+                  const Options& options, Compiled& out, ModuleCache* modules) {
+    std::vector<SourceFile> files(1);
+    files[0].path = options.input;
+    files[0].source = source;
+    files[0].ast = std::move(root);
+    for (frontend::Info info : out.diagnostics.all()) {
+        files[0].diagnostics.report(info);
+    }
+    out.diagnostics.clear();
+    if (!load_imports(files)) {
+        return 1;
+    }
+    out.imports = files.size() > 1;
+    if (out.imports && (!options.profile_generate.empty() || !options.profile_use.empty())) {
+        std::cerr << "palc: profiles of programs with imports are not supported yet\n";
+        return 1;
+    }
+
+    Options module_options = options;
+    module_options.emit_ir = false;
+    module_options.heap_profile.clear();  // once, on the linked program
+    std::string cached_options = modules != nullptr ? cache_options(options) : std::string();
+    std::vector<middle::LinkUnit> units;
+    for (std::size_t i = 0; i < files.size(); ++i) {
+        std::string key = cached_options.empty()
+                              ? std::string()
+                              : ModuleCache::key(files[i].path, cached_options);
+        std::size_t hash = key.empty() ? 0 : sources_hash(files, i);
+        ModuleCache::Entry* cached = key.empty() ? nullptr : modules->find(key, hash);
+        std::unique_ptr<middle::Module> module;
+        if (cached != nullptr) {
+            support::TraceScope hit("server-cache-hit", files[i].path);
+            files[i].diagnostics.clear();
+            for (frontend::Info info : cached->diagnostics) {
+                files[i].diagnostics.report(info);
+            }
+            module = middle::copy_module(*cached->module);
+        } else {
+            module = lower_module_of(files, i, options);
+        }
+        for (frontend::Info info : files[i].diagnostics.all()) {
+            info.file = files[i].path;
+            out.diagnostics.report(info);
+        }
+        if (module == nullptr) {
+            continue;
+        }
+        if (cached != nullptr) {
+            middle::ModuleSummary summary = cached->summary;
+            summary.name = files[i].path;
+            units.push_back({std::move(module), std::move(summary)});
+            continue;
+        }
+        if (optimize(*module, module_options) != 0) {
+            return 1;
+        }
+        middle::ModuleSummary summary = middle::summarize_module(*module, files[i].path);
+        if (!key.empty()) {
+            modules->insert(key, {hash, middle::copy_module(*module), summary,
+                                  files[i].diagnostics.all()});
+        }
+        units.push_back({std::move(module), std::move(summary)});
+    }
+    out.diagnostics.print();
+    if (has_errors(out.diagnostics)) {
+        return 1;
+    }
+    if (units.size() != files.size()) {
+        return 0;  // no IR was asked for
+    }
+    if (options.emit_summary) {
+        for (const middle::LinkUnit& unit : units) {
+            std::cout << middle::print_summary(unit.summary);
+        }
+    }
+
+    middle::LinkOptions link_options;
+    link_options.whole_program = options.lto;
+    link_options.opt_level = options.opt_level;
+    link_options.verify_each = options.verify_each;
+    link_options.threads = options.threads;
+    middle::LinkStats stats;
+    std::string error;
+    out.module = middle::link_modules(std::move(units), link_options, &error, &stats);
+    if (out.module == nullptr) {
+        std::cerr << "palc: " << error << '\n';
+        return 1;
+    }
+    if (options.emit_summary && options.lto) {
+        std::cout << "link: " << stats.imported << " imported, " << stats.internalized
+                  << " internalized, " << stats.removed << " removed, " << stats.constant_globals
+                  << " read-only globals\n";
+    }
+    middle::PassManager passes;
+    if (!options.heap_profile.empty()) {
+        passes.add(middle::create_heap_profile_pass(options.heap_profile,
+                                                    options.heap_profile_rate));
+    }
+    if (options.x86_backend && !options.run) {
+        // Optimizing again after importing may have vectorized loops.
+        middle::add_pass_by_name(passes, "scalarize");
+    }
+    passes.run(*out.module);
+    if (options.emit_ir) {
+        std::cout << middle::print_module(*out.module);
+    }
+    return 0;
+}
+
+// Front end and optimization of `source`. Returns 0 with the module in `out`,
+// or the exit status when compilation failed or ended before IR was needed
+// (0 without a module). Programs with imports reuse the modules in `modules`.
+int build(const std::string& source, const Options& options, Compiled& out,
+          ModuleCache* modules = nullptr) {
+    frontend::Diagnostics& diagnostics = out.diagnostics;
+    if (ends_with(options.input, ".pir")) {
+        auto module = middle::parse_module(source, &diagnostics);
+        if (!module) {
+            diagnostics.print();
+            return 1;
+        }
+        std::string error;
+        if (!middle::verify_module(*module, &error)) {
+            std::cerr << "palc: " << error << '\n';
+            return 1;
+        }
+        out.module = std::move(module);
+        return optimize(*out.module, options);
+    }
+
+    frontend::Scanner scanner(source, &diagnostics);
+    frontend::Parser parser(scanner.get_tokens(), &diagnostics);
+    auto module = parser.parse_module();
+    bool imports = std::any_of(module->decls.begin(), module->decls.end(), [](const auto& decl) {
+        return decl->kind == frontend::NodeType::NODE_IMPORT;
+    });
+    if (imports || options.lto) {
+        return build_program(std::move(module), source, options, out, modules);
+    }
+
+    out.module = lower_file(*module, options, {}, diagnostics);
+    diagnostics.print();
+    if (out.module == nullptr) {
+        return has_errors(diagnostics) ? 1 : 0;
+    }
+    return optimize(*out.module, options);
+}
+
+// What `palc --server` keeps between requests: for each input and set of
+// options that shape the IR, the optimized module and its diagnostics. An
+// entry is reused while the file keeps its modification time and size, or
+// when its contents still hash the same. Code generation and runs start from
+// the cached module, which they do not change. Programs with imports are
+// linked again on every request, from the `modules` of the files that did not
+// change.
+class CompileCache {
+  public:
+    struct Entry {
+        std::filesystem::file_time_type modified;
+        std::uintmax_t size = 0;
+        std::size_t hash = 0;
+        Compiled compiled;
+        std::uint64_t last_use = 0;
+    };
+
+    static constexpr std::size_t kMaxEntries = 64;
+
+    ModuleCache modules;
+
+    // Empty when the compilation is not cached (see cache_options). Otherwise
+    // every option that changes the optimized module is part of the key.
+    static std::string key(const Options& options) {
+        std::string cached = cache_options(options);
+        if (cached.empty()) {
+            return {};
+        }
+        std::error_code code;
+        std::filesystem::path path = std::filesystem::absolute(options.input, code);
+        if (code) {
+            return {};
+        }
+        return path.string() + '\n' + cached;
+    }
+
+    Entry* find(const std::string& key) {
+        auto it = entries.find(key);
+        if (it == entries.end()) {
+            return nullptr;
+        }
+        it->second.last_use = ++uses;
+        return &it->second;
+    }
+
+    Entry& insert(const std::string& key, Entry entry) {
+        if (entries.size() >= kMaxEntries && entries.find(key) == entries.end()) {
+            auto oldest = std::min_element(entries.begin(), entries.end(),
+                                           [](const auto& a, const auto& b) {
+                                               return a.second.last_use < b.second.last_use;
+                                           });
+            entries.erase(oldest);
+        }
+        entry.last_use = ++uses;
+        return entries[key] = std::move(entry);
+    }
+
+  private:
+    std::map<std::string, Entry> entries;
+    std::uint64_t uses = 0;
+};
+
+// Code generation or the run for a compiled module. A program run for a
+// server client runs in a child process: if it crashes or never ends, the
+// server goes on serving.
+int finish(const middle::Module& module, const Options& options,
+           const support::ServerRequest* client) {
+    if (client == nullptr || !(options.run || options.jit || options.bench)) {
+        return emit(module, options);
+    }
+    return support::detach(*client, [&] { return emit(module, options); });
+}
+
+int compile(const Options& options, CompileCache* cache, const support::ServerRequest* client) {
+    support::TraceScope trace("compile", options.input);
+    std::string key = cache != nullptr ? CompileCache::key(options) : std::string();
+    CompileCache::Entry* entry = key.empty() ? nullptr : cache->find(key);
+    std::error_code code;
+    std::filesystem::file_time_type modified = std::filesystem::last_write_time(options.input,
+                                                                                code);
+    std::uintmax_t size = code ? 0 : std::filesystem::file_size(options.input, code);
+    bool unchanged = entry != nullptr && !code && entry->modified == modified &&
+                     entry->size == size;
+
+    std::string source;
+    if (!unchanged) {
+        std::ifstream file(options.input);
+        if (!file) {
+            std::cerr << "palc: cannot open '" << options.input << "'\n";
+            return 1;
+        }
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+        source = buffer.str();
+    }
+    std::size_t hash = key.empty() ? 0 : std::hash<std::string_view>{}(source);
+    if (!unchanged && entry != nullptr && entry->hash == hash) {
+        entry->modified = modified;
+        entry->size = size;
+        unchanged = true;
+    }
+    if (unchanged) {
+        support::TraceScope hit("server-cache-hit", options.input);
+        entry->compiled.diagnostics.print();
+        if (options.emit_ir) {
+            std::cout << middle::print_module(*entry->compiled.module);
+        }
+        return finish(*entry->compiled.module, options, client);
+    }
+
+    Compiled compiled;
+    int status = build(source, options, compiled, key.empty() ? nullptr : &cache->modules);
+    if (status != 0 || compiled.module == nullptr) {
+        return status;
+    }
+    if (key.empty() || compiled.imports) {
+        // The other files of the program may change: only its modules are kept.
+        return finish(*compiled.module, options, client);
+    }
+    CompileCache::Entry& stored = cache->insert(key, {modified, size, hash, std::move(compiled)});
+    return finish(*stored.compiled.module, options, client);
+}
+
+// One palc invocation, in this process or on behalf of a server client.
+int run_palc(const Options& options, CompileCache* cache,
+             const support::ServerRequest* client = nullptr) {
+    if (options.help) {
+        print_usage();
+        return 0;
+    }
+    if (options.time_trace) {
+        support::start_tracing();
+    }
+    int status = compile(options, cache, client);
+    if (options.time_trace) {
+        support::stop_tracing();
+        std::string path = trace_path(options);
+        if (!write_file(path, support::trace_json())) {
+            std::cerr << "palc: cannot write '" << path << "'\n";
+            return 1;
+        }
+        std::cerr << support::trace_summary();
+    }
+    return status;
+}
+
+int serve(const Options& options) {
+    CompileCache cache;
+    auto handler = [&](const support::ServerRequest& request) {
+        Options forwarded;
+        if (!parse_args(request.args, forwarded)) {
+            return 1;
+        }
+        if (forwarded.server || forwarded.stop_server) {
+            std::cerr << "palc: server options cannot be forwarded to a server\n";
+            return 1;
+        }
+        return run_palc(forwarded, &cache, &request);
+    };
+    std::string path = options.socket.empty() ? support::default_server_socket() : options.socket;
+    std::string error;
+    if (!support::serve(path, handler, &error)) {
+        std::cerr << "palc: " << error << '\n';
+        return 1;
+    }
+    return 0;
+}
+
+// Has the server compile with `args`; compiles here when no server is
+// listening.
+int forward(const std::vector<std::string>& args, const Options& options) {
+    support::ServerRequest request;
+    request.stop = options.stop_server;
+    std::error_code code;
+    request.directory = std::filesystem::current_path(code).string();
+    request.args = args;
+    std::string path = options.socket.empty() ? support::default_server_socket() : options.socket;
+    std::string error;
+    std::optional<int> status = support::send_request(path, request, &error);
+    if (!error.empty() && (status.has_value() || options.stop_server)) {
+        std::cerr << "palc: " << error << '\n';
+    }
+    if (status.has_value()) {
+        return *status;
+    }
+    return options.stop_server ? 1 : run_palc(options, nullptr);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    // --client may come before `run`, and is not forwarded.
+    Options options;
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--client" || arg.rfind("--client=", 0) == 0) {
+            options.client = true;
+            options.socket = arg.size() > 8 ? arg.substr(9) : "";
+        } else {
+            args.push_back(std::move(arg));
+        }
+    }
+    if (!parse_args(args, options)) {
+        return 1;
+    }
+    if (options.server) {
+        return serve(options);
+    }
+    if (options.client || options.stop_server) {
+        return forward(args, options);
+    }
+    return run_palc(options, nullptr);
+}
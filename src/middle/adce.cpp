@@ -0,0 +1,278 @@
+#include <algorithm>
+#include <optional>
+#include <vector>
+#include "transforms.h"
+
+namespace pallas::middle {
+
+namespace {
+
+// Immediate post-dominators over the reverse CFG, with a virtual exit node
+// (index num_blocks) that every ret/unreachable block flows into. Blocks that
+// never reach an exit (infinite loops) get no post-dominator.
+class PostDominatorTree {
+  public:
+    PostDominatorTree(const Function& fn, const CFGInfo& cfg) : exit_node(fn.num_blocks()) {
+        std::size_t n = fn.num_blocks() + 1;
+        std::vector<std::vector<BlockId>> succs(n);  // CFG successors incl. the virtual exit
+        for (BlockId b : fn.block_order()) {
+            succs[b].assign(fn.successors(b).begin(), fn.successors(b).end());
+            if (succs[b].empty()) {
+                succs[b].push_back(exit_node);
+            }
+        }
+        auto preds_of = [&](BlockId b) -> std::vector<BlockId> {
+            if (b != exit_node) {
+                return {cfg.preds(b).begin(), cfg.preds(b).end()};
+            }
+            std::vector<BlockId> exits;
+            for (BlockId x : fn.block_order()) {
+                if (fn.successors(x).empty()) {
+                    exits.push_back(x);
+                }
+            }
+            return exits;
+        };
+
+        // Post-order of the reverse CFG starting at the virtual exit.
+        std::vector<std::uint32_t> order_index(n, kNoBlock);
+        std::vector<BlockId> post;
+        std::vector<bool> visited(n, false);
+        std::vector<std::pair<BlockId, std::vector<BlockId>>> stack;
+        stack.push_back({exit_node, preds_of(exit_node)});
+        visited[exit_node] = true;
+        while (!stack.empty()) {
+            auto& [b, pending] = stack.back();
+            if (pending.empty()) {
+                order_index[b] = static_cast<std::uint32_t>(post.size());
+                post.push_back(b);
+                stack.pop_back();
+                continue;
+            }
+            BlockId p = pending.back();
+            pending.pop_back();
+            if (!visited[p]) {
+                visited[p] = true;
+                stack.push_back({p, preds_of(p)});
+            }
+        }
+
+        ipdoms.assign(n, kNoBlock);
+        ipdoms[exit_node] = exit_node;
+        auto intersect = [&](BlockId a, BlockId b) {
+            while (a != b) {
+                while (order_index[a] < order_index[b]) a = ipdoms[a];
+                while (order_index[b] < order_index[a]) b = ipdoms[b];
+            }
+            return a;
+        };
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (auto it = post.rbegin(); it != post.rend(); ++it) {
+                BlockId b = *it;
+                if (b == exit_node) {
+                    continue;
+                }
+                BlockId best = kNoBlock;
+                for (BlockId s : succs[b]) {
+                    if (ipdoms[s] == kNoBlock) {
+                        continue;
+                    }
+                    best = best == kNoBlock ? s : intersect(s, best);
+                }
+                if (best != ipdoms[b]) {
+                    ipdoms[b] = best;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    BlockId ipdom(BlockId b) const { return ipdoms[b]; }
+    bool reaches_exit(BlockId b) const { return ipdoms[b] != kNoBlock; }
+    BlockId exit() const { return exit_node; }
+
+  private:
+    BlockId exit_node;
+    std::vector<BlockId> ipdoms;
+};
+
+class ADCEPass : public FunctionPass {
+  public:
+    const char* name() const override { return "adce"; }
+    std::unique_ptr<FunctionPass> clone() const override {
+        return std::make_unique<ADCEPass>(*this);
+    }
+
+    PreservedAnalyses run(Function& fn, AnalysisManager& analyses) override {
+        if (fn.entry() == kNoBlock) {
+            return PreservedAnalyses::all();
+        }
+        bool cfg_changed = remove_unreachable_blocks(fn);
+        if (cfg_changed) {
+            analyses.invalidate(fn, PreservedAnalyses::none());
+        }
+        const CFGInfo& cfg = analyses.cfg(fn);
+        PostDominatorTree pdom(fn, cfg);
+        const LoopInfo& loops = analyses.loops(fn);
+        loop_info = &loops;
+        finite.assign(loops.loops().size(), false);
+        for (std::uint32_t l = 0; l < loops.loops().size(); ++l) {
+            finite[l] = terminates(fn, loops, l);
+        }
+
+        // Control dependence from the post-dominance frontier: block y depends on
+        // the branch in a when a has a successor s such that y post-dominates s
+        // but not a.
+        std::vector<std::vector<BlockId>> control(fn.num_blocks());
+        for (BlockId a : fn.block_order()) {
+            if (!pdom.reaches_exit(a) || fn.successors(a).size() < 2) {
+                continue;
+            }
+            for (BlockId s : fn.successors(a)) {
+                for (BlockId y = s; y != pdom.ipdom(a) && y != pdom.exit() && y != kNoBlock;
+                     y = pdom.ipdom(y)) {
+                    control[y].push_back(a);
+                }
+            }
+        }
+
+        function = &fn;
+        live.assign(fn.num_values(), false);
+        live_block.assign(fn.num_blocks(), false);
+        work.clear();
+        for (BlockId b : fn.block_order()) {
+            for (ValueId v = fn.block(b).first; v != kNoValue; v = fn.inst(v).next) {
+                if (is_root(pdom, v)) {
+                    mark(v);
+                }
+            }
+        }
+        while (!work.empty()) {
+            ValueId v = work.back();
+            work.pop_back();
+            const Inst& inst = fn.inst(v);
+            for (std::uint32_t i = 0; i < inst.num_operands; ++i) {
+                mark(fn.operand(v, i));
+            }
+            if (inst.op == Opcode::OP_PHI) {
+                for (BlockId from : fn.targets(v)) {
+                    mark(fn.terminator(from));
+                }
+            }
+            if (!live_block[inst.block]) {
+                live_block[inst.block] = true;
+                for (BlockId a : control[inst.block]) {
+                    mark(fn.terminator(a));
+                }
+            }
+        }
+
+        bool changed = false;
+        for (BlockId b : std::vector<BlockId>(fn.block_order())) {
+            for (ValueId v : fn.block_insts(b)) {
+                if (live[v] || fn.inst(v).op == Opcode::OP_BR) {
+                    continue;
+                }
+                if (is_terminator(fn.inst(v).op)) {
+                    // Nothing live depends on which way this branch goes: jump to
+                    // the first block every path meets again.
+                    BlockId target = pdom.ipdom(b);
+                    for (BlockId s : fn.successors(b)) {
+                        fn.remove_predecessor(s, b);
+                    }
+                    fn.erase(v);
+                    fn.append(b, Opcode::OP_BR, IRType(), {}, {&target, 1});
+                    cfg_changed = true;
+                } else {
+                    fn.erase(v);
+                    changed = true;
+                }
+            }
+        }
+        if (cfg_changed) {
+            remove_unreachable_blocks(fn);
+            return PreservedAnalyses::none();
+        }
+        return changed ? PreservedAnalyses::cfg() : PreservedAnalyses::all();
+    }
+
+  private:
+    const Function* function = nullptr;
+    const LoopInfo* loop_info = nullptr;
+    std::vector<bool> finite;  // per loop: known to be left after finitely many iterations
+    std::vector<bool> live;
+    std::vector<bool> live_block;
+    std::vector<ValueId> work;
+
+    void mark(ValueId v) {
+        if (v == kNoValue || live[v] || function->inst(v).block == kNoBlock) {
+            return;
+        }
+        live[v] = true;
+        work.push_back(v);
+    }
+
+    // A counted loop whose induction variable reaches the bound: its trip
+    // count is known, or it steps by one towards a bound it cannot skip.
+    static bool terminates(const Function& fn, const LoopInfo& loops, std::uint32_t loop) {
+        std::optional<CountedLoop> counted = analyze_counted_loop(fn, loops, loop);
+        if (!counted) {
+            return false;
+        }
+        if (constant_trip_count(fn, *counted)) {
+            return true;
+        }
+        switch (counted->pred) {
+            case CmpPredicate::CMP_NE: return counted->iv.step == 1 || counted->iv.step == -1;
+            case CmpPredicate::CMP_SLT:
+            case CmpPredicate::CMP_ULT: return counted->iv.step == 1;
+            case CmpPredicate::CMP_SGT:
+            case CmpPredicate::CMP_UGT: return counted->iv.step == -1;
+            default: return false;
+        }
+    }
+
+    // Whether the branch leaves a loop that may never end. Removing it would
+    // turn a program that runs forever into one that finishes.
+    bool leaves_endless_loop(BlockId b) const {
+        std::span<const BlockId> succs = function->successors(b);
+        for (std::uint32_t l = loop_info->loop_for(b); l != kNoBlock;
+             l = loop_info->loops()[l].parent) {
+            if (!finite[l] && std::any_of(succs.begin(), succs.end(), [&](BlockId s) {
+                    return !loop_info->contains(l, s);
+                })) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool is_root(const PostDominatorTree& pdom, ValueId v) const {
+        const Inst& inst = function->inst(v);
+        if (inst.op == Opcode::OP_COND_BR || inst.op == Opcode::OP_SWITCH) {
+            // Kept when the branch cannot be retargeted to its post-dominator:
+            // it may enter or leave a loop that never ends, or the join block
+            // has phis that tell the incoming edges apart.
+            BlockId join = pdom.ipdom(inst.block);
+            if (join == kNoBlock || join == pdom.exit() ||
+                function->inst(function->block(join).first).op == Opcode::OP_PHI ||
+                leaves_endless_loop(inst.block)) {
+                return true;
+            }
+            std::span<const BlockId> succs = function->successors(inst.block);
+            return std::any_of(succs.begin(), succs.end(),
+                               [&](BlockId s) { return !pdom.reaches_exit(s); });
+        }
+        return inst.op != Opcode::OP_BR && has_side_effects(inst.op);
+    }
+};
+
+}  // namespace
+
+std::unique_ptr<FunctionPass> create_adce_pass() {
+    return std::make_unique<ADCEPass>();
+}
+
+}  // namespace pallas::middle
@@ -0,0 +1,448 @@
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "transforms.h"
+
+namespace pallas::middle {
+
+namespace {
+
+using i128 = __int128;
+
+// Closed interval of the values an integer can hold, read as signed.
+struct Range {
+    i128 lo = 0;
+    i128 hi = 0;
+};
+
+i128 type_min(IRType type) {
+    return -(i128(1) << (type_bits(type) - 1));
+}
+
+i128 type_max(IRType type) {
+    return (i128(1) << (type_bits(type) - 1)) - 1;
+}
+
+Range full_range(IRType type) {
+    return {type_min(type), type_max(type)};
+}
+
+// An interval computed without wrapping is only valid if it fits the type.
+Range fit(Range r, IRType type) {
+    return r.lo < type_min(type) || r.hi > type_max(type) ? full_range(type) : r;
+}
+
+i128 signed_value(std::uint64_t bits, unsigned width) {
+    if (width < 64) {
+        std::uint64_t sign = std::uint64_t{1} << (width - 1);
+        bits &= (std::uint64_t{1} << width) - 1;
+        return i128(static_cast<std::int64_t>((bits ^ sign) - sign));
+    }
+    return i128(static_cast<std::int64_t>(bits));
+}
+
+bool is_check(const Function& fn, ValueId v) {
+    return fn.inst(v).op == Opcode::OP_BOUNDS_CHECK;
+}
+
+// Value ranges from constants, arithmetic and the bounds of counted loops.
+// The range of an induction variable depends on where it is read: inside the
+// body it is limited by the loop test, in the header it is not.
+class RangeAnalysis {
+  public:
+    RangeAnalysis(const Function& fn, const LoopInfo& loops) : fn(fn), loops(loops) {}
+
+    Range of(ValueId v, BlockId at, unsigned depth = 0) const {
+        const Inst& inst = fn.inst(v);
+        if (!is_int(inst.type) || inst.type.is_vector() ||
+            inst.type.kind == IRTypeKind::IR_I128) {
+            return full_range(IRType::scalar(IRTypeKind::IR_I64));
+        }
+        Range full = full_range(inst.type);
+        if (inst.op == Opcode::OP_CONST) {
+            i128 c = signed_value(inst.imm, type_bits(inst.type));
+            return {c, c};
+        }
+        if (depth > kMaxDepth || inst.num_operands == 0) {
+            return full;
+        }
+        auto operand = [&](std::uint32_t i) { return of(fn.operand(v, i), at, depth + 1); };
+        switch (inst.op) {
+            case Opcode::OP_SEXT:
+                return operand(0);
+            case Opcode::OP_ZEXT: {
+                Range r = operand(0);
+                IRType from = fn.inst(fn.operand(v, 0)).type;
+                return r.lo >= 0 ? r : Range{0, (i128(1) << type_bits(from)) - 1};
+            }
+            case Opcode::OP_TRUNC:
+                return fit(operand(0), inst.type);
+            case Opcode::OP_ADD: {
+                Range a = operand(0);
+                Range b = operand(1);
+                return fit({a.lo + b.lo, a.hi + b.hi}, inst.type);
+            }
+            case Opcode::OP_SUB: {
+                Range a = operand(0);
+                Range b = operand(1);
+                return fit({a.lo - b.hi, a.hi - b.lo}, inst.type);
+            }
+            case Opcode::OP_MUL: {
+                Range a = operand(0);
+                Range b = operand(1);
+                i128 products[] = {a.lo * b.lo, a.lo * b.hi, a.hi * b.lo, a.hi * b.hi};
+                return fit({*std::min_element(std::begin(products), std::end(products)),
+                            *std::max_element(std::begin(products), std::end(products))},
+                           inst.type);
+            }
+            case Opcode::OP_AND: {
+                Range a = operand(0);
+                Range b = operand(1);
+                if (a.lo >= 0 && b.lo >= 0) {
+                    return {0, std::min(a.hi, b.hi)};
+                }
+                if (a.lo >= 0 || b.lo >= 0) {
+                    return {0, a.lo >= 0 ? a.hi : b.hi};
+                }
+                return full;
+            }
+            case Opcode::OP_UREM:
+            case Opcode::OP_SREM: {
+                Range a = operand(0);
+                Range b = operand(1);
+                if (b.lo <= 0 || (a.lo < 0 && inst.op == Opcode::OP_SREM)) {
+                    return full;
+                }
+                return {0, a.lo >= 0 ? std::min(a.hi, b.hi - 1) : b.hi - 1};
+            }
+            case Opcode::OP_UDIV:
+            case Opcode::OP_SDIV: {
+                Range a = operand(0);
+                Range b = operand(1);
+                if (a.lo < 0 || b.lo <= 0) {
+                    return full;
+                }
+                return {a.lo / b.hi, a.hi / b.lo};
+            }
+            case Opcode::OP_LSHR:
+            case Opcode::OP_ASHR: {
+                Range a = operand(0);
+                const Inst& amount = fn.inst(fn.operand(v, 1));
+                if (amount.op != Opcode::OP_CONST || amount.imm >= type_bits(inst.type) ||
+                    (a.lo < 0 && inst.op == Opcode::OP_LSHR)) {
+                    return full;
+                }
+                return {a.lo >> amount.imm, a.hi >> amount.imm};
+            }
+            case Opcode::OP_SELECT: {
+                Range a = operand(1);
+                Range b = operand(2);
+                return {std::min(a.lo, b.lo), std::max(a.hi, b.hi)};
+            }
+            case Opcode::OP_PHI:
+                return induction_range(v, at, depth).value_or(full);
+            default:
+                return full;
+        }
+    }
+
+  private:
+    static constexpr unsigned kMaxDepth = 12;
+
+    const Function& fn;
+    const LoopInfo& loops;
+
+    // Inside the body of a counted loop the variable lies between its start and
+    // the bound of the test, as long as stepping past the bound cannot wrap.
+    std::optional<Range> induction_range(ValueId phi, BlockId at, unsigned depth) const {
+        BlockId header = fn.inst(phi).block;
+        std::uint32_t loop = loops.loop_for(header);
+        if (loop == kNoBlock || loops.loops()[loop].header != header || at == header ||
+            !loops.contains(loop, at)) {
+            return std::nullopt;
+        }
+        std::optional<CountedLoop> counted = analyze_counted_loop(fn, loops, loop);
+        if (!counted || counted->iv.phi != phi) {
+            return std::nullopt;
+        }
+        IRType type = fn.inst(phi).type;
+        BlockId pre = loops.loops()[loop].preheader;
+        Range start = of(counted->iv.start, pre, depth + 1);
+        Range bound = of(counted->bound, pre, depth + 1);
+        i128 step = counted->iv.step;
+        CmpPredicate pred = counted->pred;
+        // Unsigned tests read the same as signed ones while both sides are
+        // non-negative.
+        if (pred >= CmpPredicate::CMP_ULT && pred <= CmpPredicate::CMP_UGE) {
+            if (start.lo < 0 || bound.lo < 0) {
+                return std::nullopt;
+            }
+            pred = static_cast<CmpPredicate>(static_cast<int>(pred) -
+                                             static_cast<int>(CmpPredicate::CMP_ULT) +
+                                             static_cast<int>(CmpPredicate::CMP_SLT));
+        }
+        Range r;
+        switch (pred) {
+            case CmpPredicate::CMP_SLT: r = {start.lo, bound.hi - 1}; break;
+            case CmpPredicate::CMP_SLE: r = {start.lo, bound.hi}; break;
+            case CmpPredicate::CMP_SGT: r = {bound.lo + 1, start.hi}; break;
+            case CmpPredicate::CMP_SGE: r = {bound.lo, start.hi}; break;
+            case CmpPredicate::CMP_NE:
+                // Counting by one towards a bound it starts on the right side of.
+                if (step == 1 && start.hi <= bound.lo) {
+                    r = {start.lo, bound.hi - 1};
+                } else if (step == -1 && start.lo >= bound.hi) {
+                    r = {bound.lo + 1, start.hi};
+                } else {
+                    return std::nullopt;
+                }
+                break;
+            default:
+                return std::nullopt;
+        }
+        bool up = pred == CmpPredicate::CMP_SLT || pred == CmpPredicate::CMP_SLE ||
+                  (pred == CmpPredicate::CMP_NE && step > 0);
+        if ((up && (step <= 0 || r.hi + step > type_max(type))) ||
+            (!up && (step >= 0 || r.lo + step < type_min(type)))) {
+            return std::nullopt;
+        }
+        return r;
+    }
+};
+
+class BoundsCheckElimPass : public FunctionPass {
+  public:
+    explicit BoundsCheckElimPass(BoundsCheckReport* report) : report(report) {}
+
+    const char* name() const override { return "bce"; }
+    std::unique_ptr<FunctionPass> clone() const override {
+        return std::make_unique<BoundsCheckElimPass>(*this);
+    }
+
+    PreservedAnalyses run(Function& fn, AnalysisManager& analyses) override {
+        if (fn.entry() == kNoBlock) {
+            return PreservedAnalyses::all();
+        }
+        const DominatorTree& dom = analyses.dominators(fn);
+        const LoopInfo& loops = analyses.loops(fn);
+        RangeAnalysis ranges(fn, loops);
+        BoundsCheckReport::Entry counts;
+        counts.function = fn.name;
+        counts.removed = remove_proven(fn, dom, ranges);
+        for (std::uint32_t loop : loops.innermost_first()) {
+            counts.hoisted += hoist(fn, loops, dom, ranges, loop);
+        }
+        for (BlockId b : fn.block_order()) {
+            for (ValueId v = fn.block(b).first; v != kNoValue; v = fn.inst(v).next) {
+                counts.remaining += is_check(fn, v);
+            }
+        }
+        if (report != nullptr) {
+            std::lock_guard<std::mutex> guard(*report_lock);
+            report->functions.push_back(counts);
+        }
+        bool changed = counts.removed + counts.hoisted > 0;
+        return changed ? PreservedAnalyses::cfg() : PreservedAnalyses::all();
+    }
+
+  private:
+    BoundsCheckReport* report;
+    // Shared by the clones that run on other threads.
+    std::shared_ptr<std::mutex> report_lock = std::make_shared<std::mutex>();
+
+    // Removes checks whose index is known to be in range, and checks repeated
+    // under an earlier check of the same index against a length no larger.
+    static std::size_t remove_proven(Function& fn, const DominatorTree& dom,
+                                     const RangeAnalysis& ranges) {
+        struct Fact {
+            ValueId index;
+            ValueId length;
+        };
+        std::vector<Fact> facts;
+        std::vector<std::pair<BlockId, std::size_t>> scopes;  // block, facts on entry
+        std::size_t removed = 0;
+        for (BlockId b : dom.preorder()) {
+            while (!scopes.empty() && !dom.dominates(scopes.back().first, b)) {
+                facts.resize(scopes.back().second);
+                scopes.pop_back();
+            }
+            scopes.push_back({b, facts.size()});
+            for (ValueId v = fn.block(b).first; v != kNoValue;) {
+                ValueId next = fn.inst(v).next;
+                if (is_check(fn, v)) {
+                    ValueId index = fn.operand(v, 0);
+                    ValueId length = fn.operand(v, 1);
+                    Range in = ranges.of(index, b);
+                    Range limit = ranges.of(length, b);
+                    bool redundant = std::any_of(facts.begin(), facts.end(), [&](const Fact& f) {
+                        return f.index == index &&
+                               (f.length == length || ranges.of(f.length, b).hi <= limit.lo);
+                    });
+                    if ((in.lo >= 0 && in.hi < limit.lo) || redundant) {
+                        fn.erase(v);
+                        ++removed;
+                    } else {
+                        facts.push_back({index, length});
+                    }
+                }
+                v = next;
+            }
+        }
+        return removed;
+    }
+
+    // A check that runs on every iteration of a counted loop, on an index that
+    // is invariant or moves with the induction variable, holds for all
+    // iterations if it holds for the first and the last one. Those two checks
+    // go to the preheader. Trapping before earlier iterations is only
+    // unobservable when the loop makes no calls.
+    static std::size_t hoist(Function& fn, const LoopInfo& loops, const DominatorTree& dom,
+                             const RangeAnalysis& ranges, std::uint32_t loop) {
+        const Loop& l = loops.loops()[loop];
+        std::optional<CountedLoop> counted = analyze_counted_loop(fn, loops, loop);
+        if (!counted || std::abs(counted->iv.step) != 1) {
+            return 0;
+        }
+        std::vector<ValueId> checks;
+        for (BlockId b : l.blocks) {
+            bool every_iteration = dom.dominates(b, l.latches[0]);
+            for (ValueId v = fn.block(b).first; v != kNoValue; v = fn.inst(v).next) {
+                if (fn.inst(v).op == Opcode::OP_CALL) {
+                    return 0;
+                }
+                if (every_iteration && loops.loop_for(b) == loop && is_check(fn, v)) {
+                    checks.push_back(v);
+                }
+            }
+        }
+        BlockId pre = l.preheader;
+        ValueId insert_at = fn.terminator(pre);
+        IRType i1 = IRType::scalar(IRTypeKind::IR_I1);
+        std::optional<std::uint64_t> trips = constant_trip_count(fn, *counted);
+        ValueId runs = kNoValue;  // the loop body runs at least once
+        std::size_t hoisted = 0;
+        for (ValueId v : checks) {
+            ValueId index = fn.operand(v, 0);
+            ValueId length = fn.operand(v, 1);
+            if (!is_loop_invariant(fn, loops, loop, length) || ranges.of(length, pre).lo <= 0) {
+                continue;
+            }
+            std::vector<ValueId> ends;
+            if (hoist_invariant(fn, loops, loop, index, insert_at)) {
+                ends.push_back(index);
+            } else {
+                std::optional<Opcode> extend;
+                ValueId iv = index;
+                if (fn.inst(index).op == Opcode::OP_SEXT || fn.inst(index).op == Opcode::OP_ZEXT) {
+                    extend = fn.inst(index).op;
+                    iv = fn.operand(index, 0);
+                }
+                // Stepping towards a bound it may have started past, a `!=`
+                // loop can wrap, so its first and last values are not the extremes.
+                if (iv != counted->iv.phi || counted->pred == CmpPredicate::CMP_NE ||
+                    (extend && !extension_preserves_order(*extend, counted->pred))) {
+                    continue;
+                }
+                ValueId last = last_value(fn, *counted, insert_at);
+                for (ValueId end : {counted->iv.start, last}) {
+                    if (extend) {
+                        end = fn.insert_before(insert_at, *extend, fn.inst(index).type, {&end, 1});
+                    }
+                    ends.push_back(end);
+                }
+            }
+            for (ValueId end : ends) {
+                Range in = ranges.of(end, pre);
+                if (in.lo >= 0 && in.hi < ranges.of(length, pre).lo) {
+                    continue;
+                }
+                if (!trips || *trips == 0) {
+                    // An index of 0 passes any check against a positive length.
+                    if (runs == kNoValue) {
+                        ValueId compare[] = {counted->iv.start, counted->bound};
+                        runs = fn.insert_before(insert_at, Opcode::OP_ICMP, i1, compare);
+                        fn.inst(runs).aux = static_cast<std::uint32_t>(counted->pred);
+                    }
+                    IRType type = fn.inst(end).type;
+                    ValueId choose[] = {runs, end, fn.constant(type, 0)};
+                    end = fn.insert_before(insert_at, Opcode::OP_SELECT, type, choose);
+                }
+                ValueId operands[] = {end, length};
+                fn.insert_before(insert_at, Opcode::OP_BOUNDS_CHECK, IRType(), operands);
+            }
+            fn.erase(v);
+            ++hoisted;
+        }
+        return hoisted;
+    }
+
+    // Moves the computation of `v` to the preheader if it only depends on values
+    // from outside the loop, through extensions and wrapping arithmetic (which
+    // cannot fault, unlike division). Returns false if `v` stays in the loop.
+    static bool hoist_invariant(Function& fn, const LoopInfo& loops, std::uint32_t loop,
+                                ValueId v, ValueId insert_at) {
+        if (is_loop_invariant(fn, loops, loop, v)) {
+            return true;
+        }
+        switch (fn.inst(v).op) {
+            case Opcode::OP_SEXT:
+            case Opcode::OP_ZEXT:
+            case Opcode::OP_TRUNC:
+            case Opcode::OP_ADD:
+            case Opcode::OP_SUB:
+            case Opcode::OP_MUL:
+            case Opcode::OP_AND:
+            case Opcode::OP_OR:
+            case Opcode::OP_XOR:
+                break;
+            default:
+                return false;
+        }
+        for (std::uint32_t i = 0; i < fn.num_operands(v); ++i) {
+            if (!is_loop_invariant(fn, loops, loop, fn.operand(v, i)) &&
+                !hoist_invariant(fn, loops, loop, fn.operand(v, i), insert_at)) {
+                return false;
+            }
+        }
+        fn.move_before(v, insert_at);
+        return true;
+    }
+
+    // Extending keeps the first and last values the extremes only if the
+    // variable does not wrap in the extension's signedness.
+    static bool extension_preserves_order(Opcode extend, CmpPredicate pred) {
+        bool is_unsigned = pred >= CmpPredicate::CMP_ULT && pred <= CmpPredicate::CMP_UGE;
+        bool is_signed = pred >= CmpPredicate::CMP_SLT && pred <= CmpPredicate::CMP_SGE;
+        return extend == Opcode::OP_SEXT ? is_signed : is_unsigned;
+    }
+
+    // The induction variable in the last iteration, for a step of +1 or -1 and
+    // an ordered test.
+    static ValueId last_value(Function& fn, const CountedLoop& counted, ValueId insert_at) {
+        IRType type = fn.inst(counted.iv.phi).type;
+        std::int64_t adjust = 0;
+        switch (counted.pred) {
+            case CmpPredicate::CMP_SLT:
+            case CmpPredicate::CMP_ULT: adjust = -1; break;
+            case CmpPredicate::CMP_SGT:
+            case CmpPredicate::CMP_UGT: adjust = 1; break;
+            default: break;
+        }
+        if (adjust == 0) {
+            return counted.bound;
+        }
+        ValueId operands[] = {counted.bound,
+                              fn.constant(type, static_cast<std::uint64_t>(adjust))};
+        return fn.insert_before(insert_at, Opcode::OP_ADD, type, operands);
+    }
+};
+
+}  // namespace
+
+std::unique_ptr<FunctionPass> create_bce_pass(BoundsCheckReport* report) {
+    return std::make_unique<BoundsCheckElimPass>(report);
+}
+
+}  // namespace pallas::middle
@@ -0,0 +1,191 @@
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "transforms.h"
+
+namespace pallas::middle {
+
+namespace {
+
+// Larger objects stay on the heap: the stack is small and the promoted object
+// is zeroed with one store per 8 bytes.
+constexpr std::uint64_t kMaxPromotedBytes = 256;
+constexpr std::uint64_t kMaxPromotedPerFunction = 4096;
+// `new` returns memory aligned for any type.
+constexpr std::uint32_t kNewAlignment = 16;
+
+bool is_definition(const Function& fn) {
+    return (fn.flags & FUNCTION_EXTERN) == 0 && fn.entry() != kNoBlock;
+}
+
+// For every function, which pointer arguments it may capture: store somewhere,
+// return, delete, or pass to a function that does. Starts from "captures
+// nothing" for every definition and only ever adds captures, so iterating to a
+// fixed point handles recursion.
+class CaptureSummaries {
+  public:
+    explicit CaptureSummaries(const Module& module) : module(module) {
+        for (const auto& fn : module.functions) {
+            captured[fn.get()].assign(fn->num_args(), !is_definition(*fn));
+        }
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (const auto& fn : module.functions) {
+                if (!is_definition(*fn)) {
+                    continue;
+                }
+                std::vector<bool>& flags = captured[fn.get()];
+                for (std::uint32_t i = 0; i < fn->num_args(); ++i) {
+                    if (!flags[i] && escapes(*fn, fn->arg(i), nullptr)) {
+                        flags[i] = true;
+                        changed = true;
+                    }
+                }
+            }
+        }
+    }
+
+    // Follows the pointer `root` and the addresses computed from it. Returns
+    // true if the object may outlive the function or be freed by someone
+    // else; otherwise the `delete`s of `root` itself are collected.
+    bool escapes(const Function& fn, ValueId root, std::vector<ValueId>* deletes) const {
+        std::vector<ValueId> work = {root};
+        while (!work.empty()) {
+            ValueId p = work.back();
+            work.pop_back();
+            for (ValueId user : fn.users(p)) {
+                const Inst& inst = fn.inst(user);
+                switch (inst.op) {
+                    case Opcode::OP_LOAD:
+                    case Opcode::OP_ICMP:
+                        break;
+                    case Opcode::OP_STORE:
+                        if (fn.operand(user, 0) == p) {
+                            return true;  // the address itself is written to memory
+                        }
+                        break;
+                    case Opcode::OP_PTRADD:
+                        work.push_back(user);
+                        break;
+                    case Opcode::OP_DELETE:
+                        // Freeing an interior pointer, or an argument, is left to
+                        // fail at run time as it did before.
+                        if (p != root || deletes == nullptr) {
+                            return true;
+                        }
+                        deletes->push_back(user);
+                        break;
+                    case Opcode::OP_CALL:
+                        if (!passes_safely(fn, user, p)) {
+                            return true;
+                        }
+                        break;
+                    default:
+                        return true;  // phi, select, ret, ptrtoint, ...
+                }
+            }
+        }
+        return false;
+    }
+
+  private:
+    const Module& module;
+    std::unordered_map<const Function*, std::vector<bool>> captured;
+
+    bool passes_safely(const Function& fn, ValueId call, ValueId p) const {
+        const Function* callee = module.function_for(fn.inst(call).aux);
+        if (callee == nullptr) {
+            return false;
+        }
+        const std::vector<bool>& flags = captured.at(callee);
+        for (std::uint32_t i = 0; i < fn.num_operands(call); ++i) {
+            if (fn.operand(call, i) == p && (i >= flags.size() || flags[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+// Escape analysis: a `new` of a small constant size whose object never
+// outlives the function becomes a stack slot in the entry block, zeroed where
+// the allocation was, and its `delete`s go away. An allocation in a loop
+// reuses the slot on every iteration; that is safe because its address never
+// reaches memory or a phi, so no iteration can see the previous object.
+class EscapePass : public ModulePass {
+  public:
+    const char* name() const override { return "escape"; }
+
+    PreservedAnalyses run(Module& module, AnalysisManager&) override {
+        CaptureSummaries summaries(module);
+        bool changed = false;
+        for (const auto& fn : module.functions) {
+            if (is_definition(*fn) && promote(*fn, summaries)) {
+                changed = true;
+            }
+        }
+        return changed ? PreservedAnalyses::cfg() : PreservedAnalyses::all();
+    }
+
+  private:
+    static bool promote(Function& fn, const CaptureSummaries& summaries) {
+        std::vector<ValueId> allocations;
+        for (BlockId b : fn.block_order()) {
+            for (ValueId v = fn.block(b).first; v != kNoValue; v = fn.inst(v).next) {
+                if (fn.inst(v).op == Opcode::OP_NEW) {
+                    allocations.push_back(v);
+                }
+            }
+        }
+        IRType i64 = IRType::scalar(IRTypeKind::IR_I64);
+        IRType ptr = IRType::scalar(IRTypeKind::IR_PTR);
+        std::uint64_t budget = kMaxPromotedPerFunction;
+        bool changed = false;
+        for (ValueId site : allocations) {
+            const Inst& size = fn.inst(fn.operand(site, 0));
+            if (size.op != Opcode::OP_CONST) {
+                continue;
+            }
+            std::uint64_t bytes = std::max<std::uint64_t>(size.imm, 1);
+            std::vector<ValueId> deletes;
+            if (bytes > kMaxPromotedBytes || bytes > budget ||
+                summaries.escapes(fn, site, &deletes)) {
+                continue;
+            }
+            budget -= bytes;
+            bytes = (bytes + 7) & ~std::uint64_t{7};
+            ValueId slot = fn.insert_before(fn.block(fn.entry()).first, Opcode::OP_ALLOCA, ptr);
+            fn.inst(slot).imm = bytes;
+            fn.inst(slot).aux = kNewAlignment;
+            fn.replace_all_uses(site, slot);
+            // `new` hands out zeroed memory; a stack slot has to be cleared on
+            // every execution of the allocation.
+            ValueId zero = fn.constant(i64, 0);
+            for (std::uint64_t offset = 0; offset < bytes; offset += 8) {
+                ValueId address = slot;
+                if (offset != 0) {
+                    ValueId operands[] = {slot, fn.constant(i64, offset)};
+                    address = fn.insert_before(site, Opcode::OP_PTRADD, ptr, operands);
+                }
+                ValueId operands[] = {zero, address};
+                fn.insert_before(site, Opcode::OP_STORE, IRType(), operands);
+            }
+            fn.erase(site);
+            for (ValueId d : deletes) {
+                fn.erase(d);
+            }
+            changed = true;
+        }
+        return changed;
+    }
+};
+
+}  // namespace
+
+std::unique_ptr<ModulePass> create_escape_pass() {
+    return std::make_unique<EscapePass>();
+}
+
+}  // namespace pallas::middle
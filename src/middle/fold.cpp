@@ -0,0 +1,325 @@
+#include "fold.h"
+#include <bit>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace pallas::middle {
+
+namespace {
+
+std::uint64_t mask_to(std::uint64_t bits, unsigned width) {
+    return width >= 64 ? bits : bits & ((std::uint64_t{1} << width) - 1);
+}
+
+std::int64_t to_signed(std::uint64_t bits, unsigned width) {
+    if (width >= 64) {
+        return static_cast<std::int64_t>(bits);
+    }
+    std::uint64_t sign = std::uint64_t{1} << (width - 1);
+    bits = mask_to(bits, width);
+    return static_cast<std::int64_t>((bits ^ sign) - sign);
+}
+
+double to_double(const ConstOperand& c) {
+    return std::bit_cast<double>(c.bits);
+}
+
+std::uint64_t from_double(IRType type, double value) {
+    if (type.kind == IRTypeKind::IR_F32) {
+        value = static_cast<double>(static_cast<float>(value));
+    }
+    return std::bit_cast<std::uint64_t>(value);
+}
+
+bool foldable_type(IRType type) {
+    return !type.is_vector() && type.kind != IRTypeKind::IR_I128 &&
+           type.kind != IRTypeKind::IR_PTR && type.kind != IRTypeKind::IR_VOID;
+}
+
+std::optional<std::uint64_t> fold_int_binary(Opcode op, unsigned w, std::uint64_t a,
+                                             std::uint64_t b) {
+    a = mask_to(a, w);
+    b = mask_to(b, w);
+    std::int64_t sa = to_signed(a, w);
+    std::int64_t sb = to_signed(b, w);
+    switch (op) {
+        case Opcode::OP_ADD: return mask_to(a + b, w);
+        case Opcode::OP_SUB: return mask_to(a - b, w);
+        case Opcode::OP_MUL: return mask_to(a * b, w);
+        case Opcode::OP_AND: return a & b;
+        case Opcode::OP_OR: return a | b;
+        case Opcode::OP_XOR: return a ^ b;
+        case Opcode::OP_UDIV:
+            if (b == 0) return std::nullopt;
+            return a / b;
+        case Opcode::OP_UREM:
+            if (b == 0) return std::nullopt;
+            return a % b;
+        case Opcode::OP_SDIV:
+        case Opcode::OP_SREM: {
+            std::int64_t min = w >= 64 ? std::numeric_limits<std::int64_t>::min()
+                                       : -(std::int64_t{1} << (w - 1));
+            if (sb == 0 || (sa == min && sb == -1)) return std::nullopt;
+            std::int64_t r = op == Opcode::OP_SDIV ? sa / sb : sa % sb;
+            return mask_to(static_cast<std::uint64_t>(r), w);
+        }
+        case Opcode::OP_SHL:
+            if (b >= w) return std::nullopt;
+            return mask_to(a << b, w);
+        case Opcode::OP_LSHR:
+            if (b >= w) return std::nullopt;
+            return a >> b;
+        case Opcode::OP_ASHR:
+            if (b >= w) return std::nullopt;
+            return mask_to(static_cast<std::uint64_t>(sa >> b), w);
+        default:
+            return std::nullopt;
+    }
+}
+
+bool compare(CmpPredicate pred, const ConstOperand& x, const ConstOperand& y) {
+    if (is_float(x.type)) {
+        double a = to_double(x);
+        double b = to_double(y);
+        switch (pred) {
+            case CmpPredicate::CMP_OEQ: return a == b;
+            case CmpPredicate::CMP_ONE: return a < b || a > b;
+            case CmpPredicate::CMP_OLT: return a < b;
+            case CmpPredicate::CMP_OLE: return a <= b;
+            case CmpPredicate::CMP_OGT: return a > b;
+            case CmpPredicate::CMP_OGE: return a >= b;
+            default: return false;
+        }
+    }
+    unsigned w = type_bits(x.type);
+    std::uint64_t a = mask_to(x.bits, w);
+    std::uint64_t b = mask_to(y.bits, w);
+    std::int64_t sa = to_signed(a, w);
+    std::int64_t sb = to_signed(b, w);
+    switch (pred) {
+        case CmpPredicate::CMP_EQ: return a == b;
+        case CmpPredicate::CMP_NE: return a != b;
+        case CmpPredicate::CMP_SLT: return sa < sb;
+        case CmpPredicate::CMP_SLE: return sa <= sb;
+        case CmpPredicate::CMP_SGT: return sa > sb;
+        case CmpPredicate::CMP_SGE: return sa >= sb;
+        case CmpPredicate::CMP_ULT: return a < b;
+        case CmpPredicate::CMP_ULE: return a <= b;
+        case CmpPredicate::CMP_UGT: return a > b;
+        case CmpPredicate::CMP_UGE: return a >= b;
+        default: return false;
+    }
+}
+
+}  // namespace
+
+bool is_pure(Opcode op) {
+    switch (op) {
+        case Opcode::OP_ADD:
+        case Opcode::OP_SUB:
+        case Opcode::OP_MUL:
+        case Opcode::OP_SDIV:
+        case Opcode::OP_UDIV:
+        case Opcode::OP_SREM:
+        case Opcode::OP_UREM:
+        case Opcode::OP_AND:
+        case Opcode::OP_OR:
+        case Opcode::OP_XOR:
+        case Opcode::OP_SHL:
+        case Opcode::OP_LSHR:
+        case Opcode::OP_ASHR:
+        case Opcode::OP_FADD:
+        case Opcode::OP_FSUB:
+        case Opcode::OP_FMUL:
+        case Opcode::OP_FDIV:
+        case Opcode::OP_FREM:
+        case Opcode::OP_FNEG:
+        case Opcode::OP_ICMP:
+        case Opcode::OP_FCMP:
+        case Opcode::OP_TRUNC:
+        case Opcode::OP_ZEXT:
+        case Opcode::OP_SEXT:
+        case Opcode::OP_FPTOSI:
+        case Opcode::OP_FPTOUI:
+        case Opcode::OP_SITOFP:
+        case Opcode::OP_UITOFP:
+        case Opcode::OP_FPEXT:
+        case Opcode::OP_FPTRUNC:
+        case Opcode::OP_PTRTOINT:
+        case Opcode::OP_INTTOPTR:
+        case Opcode::OP_SELECT:
+        case Opcode::OP_SPLAT:
+        case Opcode::OP_EXTRACT:
+        case Opcode::OP_INSERT:
+        case Opcode::OP_PTRADD:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool is_commutative(Opcode op) {
+    switch (op) {
+        case Opcode::OP_ADD:
+        case Opcode::OP_MUL:
+        case Opcode::OP_AND:
+        case Opcode::OP_OR:
+        case Opcode::OP_XOR:
+        case Opcode::OP_FADD:
+        case Opcode::OP_FMUL:
+            return true;
+        default:
+            return false;
+    }
+}
+
+CmpPredicate inverse_predicate(CmpPredicate pred) {
+    switch (pred) {
+        case CmpPredicate::CMP_EQ: return CmpPredicate::CMP_NE;
+        case CmpPredicate::CMP_NE: return CmpPredicate::CMP_EQ;
+        case CmpPredicate::CMP_SLT: return CmpPredicate::CMP_SGE;
+        case CmpPredicate::CMP_SLE: return CmpPredicate::CMP_SGT;
+        case CmpPredicate::CMP_SGT: return CmpPredicate::CMP_SLE;
+        case CmpPredicate::CMP_SGE: return CmpPredicate::CMP_SLT;
+        case CmpPredicate::CMP_ULT: return CmpPredicate::CMP_UGE;
+        case CmpPredicate::CMP_ULE: return CmpPredicate::CMP_UGT;
+        case CmpPredicate::CMP_UGT: return CmpPredicate::CMP_ULE;
+        case CmpPredicate::CMP_UGE: return CmpPredicate::CMP_ULT;
+        default: return pred;
+    }
+}
+
+CmpPredicate swapped_predicate(CmpPredicate pred) {
+    switch (pred) {
+        case CmpPredicate::CMP_SLT: return CmpPredicate::CMP_SGT;
+        case CmpPredicate::CMP_SLE: return CmpPredicate::CMP_SGE;
+        case CmpPredicate::CMP_SGT: return CmpPredicate::CMP_SLT;
+        case CmpPredicate::CMP_SGE: return CmpPredicate::CMP_SLE;
+        case CmpPredicate::CMP_ULT: return CmpPredicate::CMP_UGT;
+        case CmpPredicate::CMP_ULE: return CmpPredicate::CMP_UGE;
+        case CmpPredicate::CMP_UGT: return CmpPredicate::CMP_ULT;
+        case CmpPredicate::CMP_UGE: return CmpPredicate::CMP_ULE;
+        default: return pred;
+    }
+}
+
+std::optional<std::uint64_t> fold_operation(Opcode op, IRType type, std::uint32_t aux,
+                                            std::span<const ConstOperand> operands) {
+    for (const ConstOperand& c : operands) {
+        if (!foldable_type(c.type)) {
+            return std::nullopt;
+        }
+    }
+    if (!foldable_type(type)) {
+        return std::nullopt;
+    }
+    unsigned w = type_bits(type);
+    switch (op) {
+        case Opcode::OP_ADD:
+        case Opcode::OP_SUB:
+        case Opcode::OP_MUL:
+        case Opcode::OP_SDIV:
+        case Opcode::OP_UDIV:
+        case Opcode::OP_SREM:
+        case Opcode::OP_UREM:
+        case Opcode::OP_AND:
+        case Opcode::OP_OR:
+        case Opcode::OP_XOR:
+        case Opcode::OP_SHL:
+        case Opcode::OP_LSHR:
+        case Opcode::OP_ASHR:
+            if (operands.size() != 2 || !is_int(type)) return std::nullopt;
+            return fold_int_binary(op, w, operands[0].bits, operands[1].bits);
+        case Opcode::OP_FADD:
+        case Opcode::OP_FSUB:
+        case Opcode::OP_FMUL:
+        case Opcode::OP_FDIV:
+        case Opcode::OP_FREM: {
+            if (operands.size() != 2) return std::nullopt;
+            double a = to_double(operands[0]);
+            double b = to_double(operands[1]);
+            double r = 0.0;
+            switch (op) {
+                case Opcode::OP_FADD: r = a + b; break;
+                case Opcode::OP_FSUB: r = a - b; break;
+                case Opcode::OP_FMUL: r = a * b; break;
+                case Opcode::OP_FDIV: r = a / b; break;
+                default: r = std::fmod(a, b); break;
+            }
+            if (type.kind == IRTypeKind::IR_F32) {
+                // Single-precision arithmetic rounds each result to float.
+                float fa = static_cast<float>(a);
+                float fb = static_cast<float>(b);
+                switch (op) {
+                    case Opcode::OP_FADD: r = fa + fb; break;
+                    case Opcode::OP_FSUB: r = fa - fb; break;
+                    case Opcode::OP_FMUL: r = fa * fb; break;
+                    case Opcode::OP_FDIV: r = fa / fb; break;
+                    default: r = std::fmod(fa, fb); break;
+                }
+            }
+            return from_double(type, r);
+        }
+        case Opcode::OP_FNEG:
+            if (operands.size() != 1) return std::nullopt;
+            return from_double(type, -to_double(operands[0]));
+        case Opcode::OP_ICMP:
+        case Opcode::OP_FCMP:
+            if (operands.size() != 2) return std::nullopt;
+            return compare(static_cast<CmpPredicate>(aux), operands[0], operands[1]) ? 1 : 0;
+        case Opcode::OP_TRUNC:
+            return mask_to(operands[0].bits, w);
+        case Opcode::OP_ZEXT:
+            return mask_to(operands[0].bits, type_bits(operands[0].type));
+        case Opcode::OP_SEXT:
+            return mask_to(static_cast<std::uint64_t>(
+                               to_signed(operands[0].bits, type_bits(operands[0].type))),
+                           w);
+        case Opcode::OP_SITOFP:
+            return from_double(type, static_cast<double>(
+                                         to_signed(operands[0].bits, type_bits(operands[0].type))));
+        case Opcode::OP_UITOFP:
+            return from_double(type, static_cast<double>(
+                                         mask_to(operands[0].bits, type_bits(operands[0].type))));
+        case Opcode::OP_FPEXT:
+        case Opcode::OP_FPTRUNC:
+            return from_double(type, to_double(operands[0]));
+        case Opcode::OP_FPTOSI:
+        case Opcode::OP_FPTOUI: {
+            double value = std::trunc(to_double(operands[0]));
+            bool is_signed = op == Opcode::OP_FPTOSI;
+            double lo = is_signed ? -std::ldexp(1.0, static_cast<int>(w) - 1) : 0.0;
+            double hi = is_signed ? std::ldexp(1.0, static_cast<int>(w) - 1) : std::ldexp(1.0, static_cast<int>(w));
+            if (!(value >= lo && value < hi)) return std::nullopt;
+            if (is_signed) {
+                return mask_to(static_cast<std::uint64_t>(static_cast<std::int64_t>(value)), w);
+            }
+            return static_cast<std::uint64_t>(value);
+        }
+        case Opcode::OP_SELECT:
+            if (operands.size() != 3) return std::nullopt;
+            return (operands[0].bits & 1) ? operands[1].bits : operands[2].bits;
+        default:
+            return std::nullopt;
+    }
+}
+
+std::optional<std::uint64_t> fold_instruction(const Function& fn, ValueId v) {
+    const Inst& inst = fn.inst(v);
+    if (!is_pure(inst.op) || inst.num_operands == 0) {
+        return std::nullopt;
+    }
+    std::vector<ConstOperand> operands;
+    operands.reserve(inst.num_operands);
+    for (std::uint32_t i = 0; i < inst.num_operands; ++i) {
+        const Inst& op = fn.inst(fn.operand(v, i));
+        if (op.op != Opcode::OP_CONST) {
+            return std::nullopt;
+        }
+        operands.push_back({op.type, op.imm});
+    }
+    return fold_operation(inst.op, inst.type, inst.aux, operands);
+}
+
+}  // namespace pallas::middle
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include "ir.h"
+
+namespace pallas::middle {
+
+struct ConstOperand {
+    IRType type;
+    std::uint64_t bits = 0;
+};
+
+// Evaluates a pure scalar operation on constant operands. Returns nothing when
+// the operation is not foldable (memory, calls, vectors, i128) or would be
+// undefined at run time, such as division by zero or an oversized shift.
+std::optional<std::uint64_t> fold_operation(Opcode op, IRType type, std::uint32_t aux,
+                                            std::span<const ConstOperand> operands);
+
+// Folds an instruction whose operands are all OP_CONST leaves.
+std::optional<std::uint64_t> fold_instruction(const Function& fn, ValueId v);
+
+// True for side-effect-free instructions whose result depends only on their
+// operands (no memory reads), so they may be value-numbered or hoisted.
+bool is_pure(Opcode op);
+bool is_commutative(Opcode op);
+
+// Integer predicates: the one that holds exactly when `pred` does not, and the
+// one that gives the same result with the operands exchanged.
+CmpPredicate inverse_predicate(CmpPredicate pred);
+CmpPredicate swapped_predicate(CmpPredicate pred);
+
+}  // namespace pallas::middle
@@ -0,0 +1,283 @@
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "fold.h"
+#include "transforms.h"
+
+namespace pallas::middle {
+
+namespace {
+
+// An expression up to the identity of its result: opcode, type, predicate or
+// other aux data, immediate, and operands (then block targets, for phis).
+// Loads carry the memory generation in `imm`, so two loads of the same pointer
+// only match when nothing could have written memory between them.
+struct ExprKey {
+    Opcode op = Opcode::OP_UNDEF;
+    IRType type;
+    std::uint32_t aux = 0;
+    std::uint64_t imm = 0;
+    std::vector<std::uint32_t> operands;
+
+    bool operator==(const ExprKey&) const = default;
+};
+
+struct ExprKeyHash {
+    std::size_t operator()(const ExprKey& key) const {
+        std::uint64_t h = static_cast<std::uint64_t>(key.op) * 0x9e3779b97f4a7c15ull;
+        h ^= (static_cast<std::uint64_t>(key.type.kind) << 16) ^ key.type.lanes ^
+             (static_cast<std::uint64_t>(key.aux) << 32);
+        h = h * 31 + key.imm;
+        for (std::uint32_t v : key.operands) {
+            h = (h ^ v) * 0x100000001b3ull;
+        }
+        return static_cast<std::size_t>(h);
+    }
+};
+
+bool is_const(const Function& fn, ValueId v, std::uint64_t bits) {
+    const Inst& inst = fn.inst(v);
+    return inst.op == Opcode::OP_CONST && !inst.type.is_vector() && inst.imm == bits;
+}
+
+bool clobbers_memory(Opcode op) {
+    return op == Opcode::OP_STORE || op == Opcode::OP_CALL || op == Opcode::OP_DELETE ||
+           op == Opcode::OP_NEW;
+}
+
+// Walks the dominator tree keeping a scoped table of available expressions:
+// every entry inserted while visiting a block is undone when the walk leaves
+// the block's subtree, so lookups only ever see dominating definitions.
+class GVN {
+  public:
+    GVN(Function& fn, AnalysisManager& analyses)
+        : fn(fn), cfg(analyses.cfg(fn)), dom(analyses.dominators(fn)) {}
+
+    bool run() {
+        std::vector<std::uint64_t> end_generation(fn.num_blocks(), 0);
+        // Explicit stack instead of recursion: (block, next child, undo mark).
+        struct Frame {
+            BlockId block;
+            std::size_t child;
+            std::size_t mark;
+        };
+        std::vector<Frame> stack;
+        auto enter = [&](BlockId b) {
+            std::span<const BlockId> preds = cfg.preds(b);
+            // With one predecessor (the immediate dominator) memory is exactly as
+            // that block left it; a merge point could see stores from any side.
+            bool single = preds.size() == 1 && preds[0] == dom.idom(b);
+            generation = single ? end_generation[preds[0]] : ++next_generation;
+            stack.push_back({b, 0, undo.size()});
+            visit_block(b);
+            end_generation[b] = generation;
+        };
+        enter(fn.entry());
+        while (!stack.empty()) {
+            Frame& top = stack.back();
+            const std::vector<BlockId>& kids = dom.children(top.block);
+            if (top.child < kids.size()) {
+                enter(kids[top.child++]);
+                continue;
+            }
+            while (undo.size() > top.mark) {
+                table.erase(undo.back());
+                undo.pop_back();
+            }
+            stack.pop_back();
+        }
+        return changed;
+    }
+
+  private:
+    Function& fn;
+    const CFGInfo& cfg;
+    const DominatorTree& dom;
+    std::unordered_map<ExprKey, ValueId, ExprKeyHash> table;
+    std::vector<ExprKey> undo;
+    std::uint64_t generation = 0;
+    std::uint64_t next_generation = 0;
+    bool changed = false;
+
+    void replace(ValueId v, ValueId with) {
+        fn.replace_all_uses(v, with);
+        fn.erase(v);
+        changed = true;
+    }
+
+    // Returns the existing value for `key`, or records `v` as its leader.
+    ValueId lookup_or_insert(ExprKey key, ValueId v) {
+        auto [it, inserted] = table.emplace(std::move(key), v);
+        if (!inserted) {
+            return it->second;
+        }
+        undo.push_back(it->first);
+        return kNoValue;
+    }
+
+    void visit_block(BlockId b) {
+        for (ValueId v : fn.block_insts(b)) {
+            const Inst& inst = fn.inst(v);
+            Opcode op = inst.op;
+            if (clobbers_memory(op)) {
+                generation = ++next_generation;
+                if (op == Opcode::OP_STORE) {
+                    // The stored value is what a following load of the pointer reads.
+                    ExprKey key{Opcode::OP_LOAD, fn.inst(fn.operand(v, 0)).type, 0, generation,
+                                {fn.operand(v, 1)}};
+                    lookup_or_insert(std::move(key), fn.operand(v, 0));
+                }
+                continue;
+            }
+            if (op == Opcode::OP_LOAD) {
+                ExprKey key{op, inst.type, 0, generation, {fn.operand(v, 0)}};
+                ValueId found = lookup_or_insert(std::move(key), v);
+                if (found != kNoValue) {
+                    replace(v, found);
+                }
+                continue;
+            }
+            if (op != Opcode::OP_PHI && !is_pure(op)) {
+                continue;
+            }
+            ValueId simpler = simplify(v);
+            if (simpler != kNoValue) {
+                replace(v, simpler);
+                continue;
+            }
+            ValueId found = lookup_or_insert(key_of(v), v);
+            if (found != kNoValue) {
+                replace(v, found);
+            }
+        }
+    }
+
+    ExprKey key_of(ValueId v) const {
+        const Inst& inst = fn.inst(v);
+        ExprKey key{inst.op, inst.type, inst.aux, inst.imm, {}};
+        key.operands.reserve(inst.num_operands + inst.num_targets);
+        for (std::uint32_t i = 0; i < inst.num_operands; ++i) {
+            key.operands.push_back(fn.operand(v, i));
+        }
+        if (is_commutative(inst.op)) {
+            std::sort(key.operands.begin(), key.operands.end());
+        }
+        if (inst.op == Opcode::OP_PHI) {
+            // Phis are only interchangeable within one block.
+            key.imm = inst.block;
+            for (BlockId from : fn.targets(v)) {
+                key.operands.push_back(from);
+            }
+        }
+        return key;
+    }
+
+    // Algebraic identities and constant folding. Returns the replacement value,
+    // or kNoValue if the instruction stays.
+    ValueId simplify(ValueId v) {
+        const Inst& inst = fn.inst(v);
+        IRType type = inst.type;
+        if (inst.op == Opcode::OP_PHI) {
+            ValueId same = kNoValue;
+            for (std::uint32_t i = 0; i < inst.num_operands; ++i) {
+                ValueId in = fn.operand(v, i);
+                if (in == v || in == same) {
+                    continue;
+                }
+                if (same != kNoValue) {
+                    return kNoValue;
+                }
+                same = in;
+            }
+            return same;
+        }
+        if (std::optional<std::uint64_t> folded = fold_instruction(fn, v)) {
+            return fn.constant(type, *folded);
+        }
+        if (inst.op == Opcode::OP_SELECT) {
+            return fn.operand(v, 1) == fn.operand(v, 2) ? fn.operand(v, 1) : kNoValue;
+        }
+        if (inst.num_operands != 2 || !is_int(type) || type.is_vector()) {
+            return kNoValue;
+        }
+        ValueId a = fn.operand(v, 0);
+        ValueId b = fn.operand(v, 1);
+        if (is_commutative(inst.op) && fn.inst(a).op == Opcode::OP_CONST) {
+            std::swap(a, b);
+        }
+        switch (inst.op) {
+            case Opcode::OP_ADD:
+            case Opcode::OP_OR:
+            case Opcode::OP_XOR:
+            case Opcode::OP_SHL:
+            case Opcode::OP_LSHR:
+            case Opcode::OP_ASHR:
+                if (is_const(fn, b, 0)) return a;
+                break;
+            case Opcode::OP_SUB:
+                if (is_const(fn, b, 0)) return a;
+                break;
+            case Opcode::OP_MUL:
+                if (is_const(fn, b, 1)) return a;
+                if (is_const(fn, b, 0)) return b;
+                break;
+            case Opcode::OP_AND:
+                if (is_const(fn, b, 0)) return b;
+                break;
+            case Opcode::OP_ICMP: {
+                // Stack slots and globals are never null.
+                auto pred = static_cast<CmpPredicate>(inst.aux);
+                if (fn.inst(a).op == Opcode::OP_CONST) {
+                    std::swap(a, b);
+                }
+                if ((pred == CmpPredicate::CMP_EQ || pred == CmpPredicate::CMP_NE) &&
+                    is_const(fn, b, 0) && fn.inst(b).type.kind == IRTypeKind::IR_PTR &&
+                    (fn.inst(a).op == Opcode::OP_ALLOCA || fn.inst(a).op == Opcode::OP_GLOBAL)) {
+                    return fn.constant(type, pred == CmpPredicate::CMP_NE ? 1 : 0);
+                }
+                break;
+            }
+            default:
+                break;
+        }
+        if (a == b) {
+            switch (inst.op) {
+                case Opcode::OP_AND:
+                case Opcode::OP_OR:
+                    return a;
+                case Opcode::OP_SUB:
+                case Opcode::OP_XOR:
+                    return fn.constant(type, 0);
+                default:
+                    break;
+            }
+        }
+        return kNoValue;
+    }
+};
+
+class GVNPass : public FunctionPass {
+  public:
+    const char* name() const override { return "gvn"; }
+    std::unique_ptr<FunctionPass> clone() const override {
+        return std::make_unique<GVNPass>(*this);
+    }
+
+    PreservedAnalyses run(Function& fn, AnalysisManager& analyses) override {
+        if (fn.entry() == kNoBlock) {
+            return PreservedAnalyses::all();
+        }
+        GVN gvn(fn, analyses);
+        return gvn.run() ? PreservedAnalyses::cfg() : PreservedAnalyses::all();
+    }
+};
+
+}  // namespace
+
+std::unique_ptr<FunctionPass> create_gvn_pass() {
+    return std::make_unique<GVNPass>();
+}
+
+}  // namespace pallas::middle
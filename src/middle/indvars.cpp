@@ -0,0 +1,103 @@
+#include <vector>
+#include "transforms.h"
+
+namespace pallas::middle {
+
+namespace {
+
+class IndVarsPass : public FunctionPass {
+  public:
+    const char* name() const override { return "indvars"; }
+    std::unique_ptr<FunctionPass> clone() const override {
+        return std::make_unique<IndVarsPass>(*this);
+    }
+
+    PreservedAnalyses run(Function& fn, AnalysisManager& analyses) override {
+        if (fn.entry() == kNoBlock) {
+            return PreservedAnalyses::all();
+        }
+        const LoopInfo& loops = analyses.loops(fn);
+        const DominatorTree& dom = analyses.dominators(fn);
+        bool changed = false;
+        for (std::uint32_t loop : loops.innermost_first()) {
+            changed |= merge_equivalent(fn, loops, dom, loop);
+            changed |= replace_exit_values(fn, loops, loop);
+        }
+        return changed ? PreservedAnalyses::cfg() : PreservedAnalyses::all();
+    }
+
+  private:
+    // Two induction variables with the same start and step hold the same value
+    // in every iteration; the one whose increment comes first survives.
+    bool merge_equivalent(Function& fn, const LoopInfo& loops, const DominatorTree& dom,
+                          std::uint32_t loop) {
+        std::vector<InductionVariable> ivs = find_induction_variables(fn, loops, loop);
+        std::vector<bool> merged(ivs.size(), false);
+        bool changed = false;
+        for (std::size_t i = 0; i < ivs.size(); ++i) {
+            for (std::size_t j = i + 1; j < ivs.size(); ++j) {
+                if (merged[i] || merged[j] || ivs[i].start != ivs[j].start ||
+                    ivs[i].step != ivs[j].step ||
+                    fn.inst(ivs[i].phi).type != fn.inst(ivs[j].phi).type) {
+                    continue;
+                }
+                std::size_t keep = dom.dominates(fn, ivs[i].next, ivs[j].next) ? i : j;
+                std::size_t drop = keep == i ? j : i;
+                if (!dom.dominates(fn, ivs[keep].next, ivs[drop].next)) {
+                    continue;
+                }
+                fn.replace_all_uses(ivs[drop].phi, ivs[keep].phi);
+                fn.replace_all_uses(ivs[drop].next, ivs[keep].next);
+                fn.erase(ivs[drop].phi);
+                fn.erase(ivs[drop].next);
+                merged[drop] = true;
+                changed = true;
+            }
+        }
+        return changed;
+    }
+
+    // After a loop with a known trip count, an induction variable with a
+    // constant start holds start + trips * step; using that constant instead
+    // can leave the loop without users.
+    bool replace_exit_values(Function& fn, const LoopInfo& loops, std::uint32_t loop) {
+        std::optional<CountedLoop> counted = analyze_counted_loop(fn, loops, loop);
+        if (!counted) {
+            return false;
+        }
+        std::optional<std::uint64_t> trips = constant_trip_count(fn, *counted);
+        if (!trips) {
+            return false;
+        }
+        bool changed = false;
+        for (const InductionVariable& iv : find_induction_variables(fn, loops, loop)) {
+            const Inst& start = fn.inst(iv.start);
+            if (start.op != Opcode::OP_CONST) {
+                continue;
+            }
+            std::uint64_t bits = start.imm + *trips * static_cast<std::uint64_t>(iv.step);
+            ValueId exit_value = fn.constant(start.type, bits);
+            for (ValueId user : fn.users(iv.phi)) {
+                BlockId b = fn.inst(user).block;
+                if (b != kNoBlock && loops.contains(loop, b)) {
+                    continue;
+                }
+                for (std::uint32_t i = 0; i < fn.num_operands(user); ++i) {
+                    if (fn.operand(user, i) == iv.phi) {
+                        fn.set_operand(user, i, exit_value);
+                        changed = true;
+                    }
+                }
+            }
+        }
+        return changed;
+    }
+};
+
+}  // namespace
+
+std::unique_ptr<FunctionPass> create_indvars_pass() {
+    return std::make_unique<IndVarsPass>();
+}
+
+}  // namespace pallas::middle
@@ -0,0 +1,406 @@
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "transforms.h"
+
+namespace pallas::middle {
+
+namespace {
+
+// Cost model, in instructions. Inlining removes the call, the argument setup
+// and the return; constant arguments let the folding passes delete the
+// instructions that use them, and whole regions when they decide a branch.
+constexpr std::int64_t kCallOverhead = 3;
+constexpr std::int64_t kConstantUseBonus = 2;
+constexpr std::int64_t kConstantBranchBonus = 8;
+
+bool is_definition(const Function& fn) {
+    return (fn.flags & FUNCTION_EXTERN) == 0 && fn.entry() != kNoBlock;
+}
+
+// Strongly connected components of the call graph (Tarjan), in reverse
+// topological order: every component comes after the components it calls.
+class CallGraph {
+  public:
+    explicit CallGraph(const Module& module) {
+        for (const auto& fn : module.functions) {
+            index_of[fn.get()] = static_cast<std::uint32_t>(nodes.size());
+            nodes.push_back(fn.get());
+        }
+        callees.resize(nodes.size());
+        for (std::uint32_t i = 0; i < nodes.size(); ++i) {
+            const Function& fn = *nodes[i];
+            for (BlockId b : fn.block_order()) {
+                for (ValueId v = fn.block(b).first; v != kNoValue; v = fn.inst(v).next) {
+                    if (fn.inst(v).op != Opcode::OP_CALL) {
+                        continue;
+                    }
+                    if (const Function* callee = module.function_for(fn.inst(v).aux)) {
+                        callees[i].push_back(index_of.at(callee));
+                    }
+                }
+            }
+        }
+        compute_components();
+    }
+
+    const std::vector<std::vector<Function*>>& bottom_up() const { return components; }
+    std::uint32_t component(const Function* fn) const { return component_of[index_of.at(fn)]; }
+
+  private:
+    std::vector<Function*> nodes;
+    std::unordered_map<const Function*, std::uint32_t> index_of;
+    std::vector<std::vector<std::uint32_t>> callees;
+    std::vector<std::vector<Function*>> components;
+    std::vector<std::uint32_t> component_of;
+
+    void compute_components() {
+        constexpr std::uint32_t kUnvisited = kNoBlock;
+        std::size_t n = nodes.size();
+        std::vector<std::uint32_t> order(n, kUnvisited);
+        std::vector<std::uint32_t> low(n, 0);
+        std::vector<bool> on_stack(n, false);
+        std::vector<std::uint32_t> stack;
+        component_of.assign(n, kUnvisited);
+        std::uint32_t counter = 0;
+        // Explicit DFS stack of (node, next callee index).
+        std::vector<std::pair<std::uint32_t, std::size_t>> dfs;
+        for (std::uint32_t root = 0; root < n; ++root) {
+            if (order[root] != kUnvisited) {
+                continue;
+            }
+            dfs.push_back({root, 0});
+            order[root] = low[root] = counter++;
+            stack.push_back(root);
+            on_stack[root] = true;
+            while (!dfs.empty()) {
+                auto& [node, next] = dfs.back();
+                if (next < callees[node].size()) {
+                    std::uint32_t callee = callees[node][next++];
+                    if (order[callee] == kUnvisited) {
+                        order[callee] = low[callee] = counter++;
+                        stack.push_back(callee);
+                        on_stack[callee] = true;
+                        dfs.push_back({callee, 0});
+                    } else if (on_stack[callee]) {
+                        low[node] = std::min(low[node], order[callee]);
+                    }
+                    continue;
+                }
+                std::uint32_t done = node;
+                dfs.pop_back();
+                if (!dfs.empty()) {
+                    low[dfs.back().first] = std::min(low[dfs.back().first], low[done]);
+                }
+                if (low[done] != order[done]) {
+                    continue;
+                }
+                std::vector<Function*> members;
+                std::uint32_t member;
+                do {
+                    member = stack.back();
+                    stack.pop_back();
+                    on_stack[member] = false;
+                    component_of[member] = static_cast<std::uint32_t>(components.size());
+                    members.push_back(nodes[member]);
+                } while (member != done);
+                components.push_back(std::move(members));
+            }
+        }
+    }
+};
+
+// Copies the body of `callee` into `caller` in place of the call `site`.
+class Inliner {
+  public:
+    Inliner(Function& caller, const Function& callee, ValueId site)
+        : caller(caller), callee(callee), site(site) {}
+
+    void run() {
+        BlockId call_block = caller.inst(site).block;
+        BlockId cont = split_after_site(call_block);
+
+        value_map.assign(callee.num_values(), kNoValue);
+        block_map.assign(callee.num_blocks(), kNoBlock);
+        for (std::uint32_t i = 0; i < callee.num_args(); ++i) {
+            value_map[callee.arg(i)] = caller.operand(site, i);
+        }
+        std::vector<BlockId> cloned;
+        for (BlockId b : callee.block_order()) {
+            block_map[b] = caller.add_block();
+            cloned.push_back(block_map[b]);
+        }
+        // Phase one creates every instruction with placeholder operands, so
+        // forward references (phis, uses in blocks laid out earlier) resolve in
+        // phase two.
+        std::vector<std::pair<ValueId, ValueId>> pending;  // (callee value, clone)
+        std::vector<std::pair<ValueId, BlockId>> returns;  // (returned value, block)
+        for (BlockId b : callee.block_order()) {
+            for (ValueId v = callee.block(b).first; v != kNoValue; v = callee.inst(v).next) {
+                clone_instruction(v, b == callee.entry(), cont, pending, returns);
+            }
+        }
+        for (auto [from, to] : pending) {
+            for (std::uint32_t i = 0; i < callee.num_operands(from); ++i) {
+                caller.set_operand(to, i, map_value(callee.operand(from, i)));
+            }
+        }
+
+        // Jump into the copy, and route its results to the continuation.
+        ValueId result = kNoValue;
+        bool has_value = callee.return_type.kind != IRTypeKind::IR_VOID;
+        if (has_value && returns.size() == 1) {
+            result = map_value(returns[0].first);
+        } else if (has_value && returns.size() > 1) {
+            ValueId first = caller.block(cont).first;
+            result = caller.insert_before(first, Opcode::OP_PHI, callee.return_type);
+            for (auto [value, from] : returns) {
+                caller.add_incoming(result, map_value(value), from);
+            }
+        }
+        if (caller.has_uses(site)) {
+            caller.replace_all_uses(site, result != kNoValue ? result
+                                                             : caller.undef(callee.return_type));
+        }
+        caller.erase(site);
+        BlockId entry = block_map[callee.entry()];
+        caller.append(call_block, Opcode::OP_BR, IRType(), {}, {&entry, 1});
+
+        // Lay the copy out between the call block and its continuation.
+        std::vector<BlockId> order;
+        for (BlockId b : caller.block_order()) {
+            if (b == cont || b >= cloned.front()) {  // the copy's blocks were added last
+                continue;
+            }
+            order.push_back(b);
+            if (b == call_block) {
+                order.insert(order.end(), cloned.begin(), cloned.end());
+                order.push_back(cont);
+            }
+        }
+        caller.set_block_order(std::move(order));
+        copy_profile(call_block, cont);
+    }
+
+  private:
+    Function& caller;
+    const Function& callee;
+    ValueId site;
+    std::vector<ValueId> value_map;
+    std::vector<BlockId> block_map;
+    ValueId placeholder = kNoValue;
+
+    // Moves everything after the call into a new block that takes over the
+    // call block's outgoing edges.
+    BlockId split_after_site(BlockId b) {
+        BlockId cont = caller.add_block();
+        for (ValueId v = caller.inst(site).next; v != kNoValue;) {
+            ValueId next = caller.inst(v).next;
+            caller.move_to_end(v, cont);
+            v = next;
+        }
+        std::vector<BlockId> succs(caller.successors(cont).begin(), caller.successors(cont).end());
+        std::sort(succs.begin(), succs.end());
+        succs.erase(std::unique(succs.begin(), succs.end()), succs.end());
+        for (BlockId s : succs) {
+            caller.replace_predecessor(s, b, cont);
+        }
+        return cont;
+    }
+
+    // The copy ran as often as the call did: the callee's counts are scaled by
+    // the share of its calls that came from this site.
+    void copy_profile(BlockId call_block, BlockId cont) {
+        FunctionProfile& out = caller.profile;
+        if (out.empty()) {
+            return;
+        }
+        std::uint64_t site_count = out.block_count(call_block);
+        out.set_block_count(cont, site_count);
+        const FunctionProfile& in = callee.profile;
+        if (in.empty() || site_count == kNoCount) {
+            return;
+        }
+        auto scale = [&](std::uint64_t count) -> std::uint64_t {
+            if (count == kNoCount || in.entry_count == 0) {
+                return count == kNoCount ? kNoCount : 0;
+            }
+            unsigned __int128 scaled = static_cast<unsigned __int128>(count) * site_count;
+            return static_cast<std::uint64_t>(scaled / in.entry_count);
+        };
+        for (BlockId b : callee.block_order()) {
+            out.set_block_count(block_map[b], scale(in.block_count(b)));
+        }
+        for (const auto& [term, weights] : in.branch_weights) {
+            if (term < value_map.size() && value_map[term] != kNoValue) {
+                std::vector<std::uint64_t>& copy = out.branch_weights[value_map[term]];
+                copy.clear();
+                for (std::uint64_t weight : weights) {
+                    copy.push_back(scale(weight));
+                }
+            }
+        }
+    }
+
+    ValueId map_value(ValueId v) {
+        if (value_map[v] != kNoValue) {
+            return value_map[v];
+        }
+        const Inst& inst = callee.inst(v);
+        switch (inst.op) {
+            case Opcode::OP_CONST: value_map[v] = caller.constant(inst.type, inst.imm); break;
+            case Opcode::OP_UNDEF: value_map[v] = caller.undef(inst.type); break;
+            case Opcode::OP_GLOBAL: value_map[v] = caller.global(inst.aux); break;
+            default: break;
+        }
+        return value_map[v];
+    }
+
+    void clone_instruction(ValueId v, bool in_entry, BlockId cont,
+                           std::vector<std::pair<ValueId, ValueId>>& pending,
+                           std::vector<std::pair<ValueId, BlockId>>& returns) {
+        const Inst inst = callee.inst(v);  // copy: the caller's pools may grow
+        BlockId b = block_map[inst.block];
+        if (inst.op == Opcode::OP_RET) {
+            if (inst.num_operands > 0) {
+                returns.push_back({callee.operand(v, 0), b});
+            } else {
+                returns.push_back({kNoValue, b});
+            }
+            caller.append(b, Opcode::OP_BR, IRType(), {}, {&cont, 1});
+            return;
+        }
+        if (placeholder == kNoValue) {
+            placeholder = caller.undef(IRType::scalar(IRTypeKind::IR_I1));
+        }
+        std::vector<ValueId> operands(inst.num_operands, placeholder);
+        std::vector<BlockId> targets;
+        for (BlockId t : callee.targets(v)) {
+            targets.push_back(block_map[t]);
+        }
+        ValueId clone;
+        if (inst.op == Opcode::OP_ALLOCA && in_entry) {
+            // Static stack slots move to the caller's entry block so a call in a
+            // loop does not allocate on every iteration.
+            BlockId entry = caller.entry();
+            ValueId first = caller.block(entry).first;
+            clone = first == kNoValue ? caller.append(entry, inst.op, inst.type)
+                                      : caller.insert_before(first, inst.op, inst.type);
+        } else {
+            clone = caller.append(b, inst.op, inst.type, operands, targets);
+        }
+        Inst& out = caller.inst(clone);
+        out.aux = inst.aux;
+        out.imm = inst.imm;
+        out.flags = inst.flags;
+        value_map[v] = clone;
+        if (inst.num_operands > 0) {
+            pending.push_back({v, clone});
+        }
+    }
+};
+
+class InlinePass : public ModulePass {
+  public:
+    explicit InlinePass(InlineOptions options) : options(options) {}
+
+    const char* name() const override { return "inline"; }
+
+    PreservedAnalyses run(Module& module, AnalysisManager&) override {
+        CallGraph graph(module);
+        hottest = 0;
+        for (const auto& fn : module.functions) {
+            for (std::uint64_t count : fn->profile.block_counts) {
+                hottest = count == kNoCount ? hottest : std::max(hottest, count);
+            }
+        }
+        bool changed = false;
+        for (const std::vector<Function*>& component : graph.bottom_up()) {
+            for (Function* fn : component) {
+                if (is_definition(*fn)) {
+                    changed |= inline_calls(module, graph, *fn);
+                }
+            }
+        }
+        return changed ? PreservedAnalyses::none() : PreservedAnalyses::all();
+    }
+
+  private:
+    InlineOptions options;
+    std::uint64_t hottest = 0;  // largest block count in the module's profile
+
+    bool inline_calls(const Module& module, const CallGraph& graph, Function& caller) {
+        // Only the calls present now are candidates; calls copied in from a
+        // callee were already considered when that callee was processed.
+        std::vector<ValueId> sites;
+        for (BlockId b : caller.block_order()) {
+            for (ValueId v = caller.block(b).first; v != kNoValue; v = caller.inst(v).next) {
+                if (caller.inst(v).op == Opcode::OP_CALL) {
+                    sites.push_back(v);
+                }
+            }
+        }
+        std::size_t size = caller.instruction_count();
+        std::size_t budget = std::max(options.min_growth,
+                                      static_cast<std::size_t>(size * options.growth_factor));
+        bool changed = false;
+        for (ValueId site : sites) {
+            const Function* callee = module.function_for(caller.inst(site).aux);
+            if (callee == nullptr || !is_definition(*callee) ||
+                (callee->flags & FUNCTION_NOINLINE) != 0 ||
+                graph.component(callee) == graph.component(&caller)) {
+                continue;
+            }
+            std::size_t callee_size = callee->instruction_count();
+            if ((callee->flags & FUNCTION_INLINE) == 0) {
+                std::uint64_t count = caller.profile.block_count(caller.inst(site).block);
+                bool profiled = caller.profile.entry_count > 0 && count != kNoCount;
+                std::int64_t threshold = options.threshold;
+                if (profiled && count >= std::max<std::uint64_t>(hottest / options.hot_ratio, 1)) {
+                    threshold = options.hot_threshold;
+                }
+                if (options.only_always || (profiled && count == 0) ||
+                    size + callee_size > budget || cost(caller, *callee, site) > threshold) {
+                    continue;
+                }
+            }
+            Inliner(caller, *callee, site).run();
+            size += callee_size;
+            changed = true;
+        }
+        if (changed) {
+            remove_unreachable_blocks(caller);
+        }
+        return changed;
+    }
+
+    // Estimated growth of the caller after cleanup: the callee's size minus the
+    // call overhead and the code that constant arguments are likely to fold away.
+    static std::int64_t cost(const Function& caller, const Function& callee, ValueId site) {
+        std::int64_t value = static_cast<std::int64_t>(callee.instruction_count()) - kCallOverhead -
+                             static_cast<std::int64_t>(callee.num_args());
+        for (std::uint32_t i = 0; i < callee.num_args(); ++i) {
+            if (caller.inst(caller.operand(site, i)).op != Opcode::OP_CONST) {
+                continue;
+            }
+            for (ValueId user : callee.users(callee.arg(i))) {
+                Opcode op = callee.inst(user).op;
+                value -= kConstantUseBonus;
+                if (op == Opcode::OP_ICMP || op == Opcode::OP_FCMP || op == Opcode::OP_SWITCH ||
+                    op == Opcode::OP_COND_BR) {
+                    value -= kConstantBranchBonus;
+                }
+            }
+        }
+        return value;
+    }
+};
+
+}  // namespace
+
+std::unique_ptr<ModulePass> create_inline_pass(InlineOptions options) {
+    return std::make_unique<InlinePass>(options);
+}
+
+}  // namespace pallas::middle
@@ -0,0 +1,803 @@
+#include "interpreter.h"
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <optional>
+#include <string_view>
+#include "fold.h"
+#include "runtime/format.h"
+#include "runtime/profile.h"
+#include "runtime/str.h"
+#include "runtime/vec.h"
+
+namespace pallas::middle {
+
+namespace {
+
+std::uint64_t mask_to(std::uint64_t bits, unsigned width) {
+    return width >= 64 ? bits : bits & ((std::uint64_t{1} << width) - 1);
+}
+
+// Pointers take part in comparisons, selects and casts as 64-bit integers.
+IRType as_integer(IRType type) {
+    return type.kind == IRTypeKind::IR_PTR ? IRType::scalar(IRTypeKind::IR_I64) : type;
+}
+
+bool supported_type(IRType type) {
+    return !type.is_vector() && type.kind != IRTypeKind::IR_I128;
+}
+
+// Vector instructions either produce a vector or take one apart.
+bool is_vector_instruction(const Function& fn, ValueId v) {
+    const Inst& inst = fn.inst(v);
+    if (inst.type.is_vector()) {
+        return true;
+    }
+    return (inst.op == Opcode::OP_STORE || inst.op == Opcode::OP_EXTRACT) &&
+           fn.inst(fn.operand(v, 0)).type.is_vector();
+}
+
+}  // namespace
+
+Interpreter::Interpreter(const Module& module, InterpreterOptions options)
+    : module(module), options(options), stack(options.stack_bytes) {}
+
+Interpreter::~Interpreter() {
+    for (auto& [address, region] : regions) {
+        if (region.heap) {
+            std::free(reinterpret_cast<void*>(address));
+        } else if (region.arena_chunk) {
+            // An arena the program did not release, e.g. after a failed run.
+            std::free(reinterpret_cast<PallasArenaChunk*>(address) - 1);
+        }
+    }
+}
+
+bool Interpreter::fail(const std::string& msg) {
+    if (error.empty()) {
+        error = msg;
+    }
+    return false;
+}
+
+std::byte* Interpreter::global_address(SymbolId symbol) {
+    auto found = globals.find(symbol);
+    if (found != globals.end()) {
+        return found->second.get();
+    }
+    // Functions get a one-byte placeholder so their address is unique.
+    const Global* global = module.find_global(symbol);
+    std::size_t size = global != nullptr ? global->bytes.size() : 1;
+    auto memory = std::make_unique<std::byte[]>(std::max<std::size_t>(size, 1));
+    if (global != nullptr) {
+        std::memcpy(memory.get(), global->bytes.data(), size);
+    }
+    std::byte* address = memory.get();
+    regions[reinterpret_cast<std::uintptr_t>(address)] = {global != nullptr ? size : 0, false};
+    globals.emplace(symbol, std::move(memory));
+    return address;
+}
+
+const Interpreter::FrameLayout& Interpreter::layout_of(const Function& fn) {
+    auto found = layouts.find(&fn);
+    if (found != layouts.end()) {
+        return found->second;
+    }
+    FrameLayout& frame = layouts[&fn];
+    frame.vector_signature = fn.return_type.is_vector();
+    for (ValueId v = 0; v < fn.num_values(); ++v) {
+        const Inst& inst = fn.inst(v);
+        if (inst.op == Opcode::OP_CONST || inst.op == Opcode::OP_UNDEF ||
+            inst.op == Opcode::OP_GLOBAL) {
+            frame.leaves.push_back(v);
+        }
+        if (inst.op == Opcode::OP_SWITCH && inst.block != kNoBlock) {
+            bool constant = true;
+            for (std::uint32_t i = 1; i < inst.num_operands; ++i) {
+                constant &= fn.inst(fn.operand(v, i)).op == Opcode::OP_CONST;
+            }
+            if (constant) {
+                frame.switches.emplace(v, switch_table(fn, v));
+            }
+        }
+        if (inst.type.is_vector()) {
+            frame.vector_signature |= inst.op == Opcode::OP_ARG;
+            frame.vectors.push_back(v);
+            frame.lane_offsets.push_back(static_cast<std::uint32_t>(frame.lane_count));
+            frame.lane_count += inst.type.lanes;
+        }
+    }
+    return frame;
+}
+
+// The table starts at the smallest case in signed or in unsigned order,
+// whichever gives the smaller span.
+Interpreter::FrameLayout::SwitchTable Interpreter::switch_table(const Function& fn, ValueId v) {
+    constexpr std::uint64_t kMaxDenseSlots = 1 << 16;
+    FrameLayout::SwitchTable table;
+    unsigned width = type_bits(fn.inst(fn.operand(v, 0)).type);
+    table.mask = width >= 64 ? ~std::uint64_t{0} : (std::uint64_t{1} << width) - 1;
+    std::uint64_t sign = std::uint64_t{1} << (width - 1);
+    std::span<const BlockId> targets = fn.targets(v);
+    for (std::uint32_t i = 1; i < fn.num_operands(v); ++i) {
+        table.sorted.emplace_back(fn.inst(fn.operand(v, i)).imm, targets[i]);
+    }
+    std::stable_sort(table.sorted.begin(), table.sorted.end(),
+                     [](const auto& a, const auto& b) { return a.first < b.first; });
+    table.sorted.erase(std::unique(table.sorted.begin(), table.sorted.end(),
+                                   [](const auto& a, const auto& b) { return a.first == b.first; }),
+                       table.sorted.end());
+    if (table.sorted.empty()) {
+        return table;
+    }
+    std::uint64_t span = ~std::uint64_t{0};
+    for (std::uint64_t base : {table.sorted.front().first, sign & table.mask}) {
+        // The smallest signed value is the first case at or above the sign bit.
+        auto first = std::lower_bound(table.sorted.begin(), table.sorted.end(), base,
+                                      [](const auto& c, std::uint64_t b) { return c.first < b; });
+        base = first == table.sorted.end() ? table.sorted.front().first : first->first;
+        std::uint64_t widest = 0;
+        for (const auto& c : table.sorted) {
+            widest = std::max(widest, (c.first - base) & table.mask);
+        }
+        if (widest < span) {
+            span = widest;
+            table.base = base;
+        }
+    }
+    if (span < kMaxDenseSlots && span / 4 <= table.sorted.size()) {
+        table.dense.assign(span + 1, targets[0]);
+        for (const auto& [value, target] : table.sorted) {
+            table.dense[(value - table.base) & table.mask] = target;
+        }
+        table.sorted.clear();
+    }
+    return table;
+}
+
+bool Interpreter::check_access(std::uint64_t address, std::uint64_t size) {
+    if (address == 0) {
+        return fail("null pointer dereference");
+    }
+    auto base = reinterpret_cast<std::uintptr_t>(stack.data());
+    if (address >= base && address < base + stack.size()) {
+        if (address + size > base + stack_top) {
+            return fail("access to a dead stack slot");
+        }
+        return true;
+    }
+    auto region = regions.upper_bound(address);
+    if (region != regions.begin()) {
+        --region;
+        if (address + size <= region->first + region->second.size) {
+            return true;
+        }
+    }
+    return fail("out-of-bounds memory access");
+}
+
+bool Interpreter::load(IRType type, std::uint64_t address, std::uint64_t& out) {
+    if (!supported_type(type)) {
+        return fail("load of '" + type_to_string(type) + "' is not supported");
+    }
+    std::uint64_t size = type_size(type);
+    if (!check_access(address, size)) {
+        return false;
+    }
+    const void* from = reinterpret_cast<const void*>(address);
+    if (type.kind == IRTypeKind::IR_F32) {
+        float value;
+        std::memcpy(&value, from, sizeof(value));
+        out = std::bit_cast<std::uint64_t>(static_cast<double>(value));
+        return true;
+    }
+    out = 0;
+    std::memcpy(&out, from, size);
+    out = mask_to(out, type_bits(type));
+    return true;
+}
+
+bool Interpreter::store(IRType type, std::uint64_t value, std::uint64_t address) {
+    if (!supported_type(type)) {
+        return fail("store of '" + type_to_string(type) + "' is not supported");
+    }
+    std::uint64_t size = type_size(type);
+    if (!check_access(address, size)) {
+        return false;
+    }
+    void* to = reinterpret_cast<void*>(address);
+    if (type.kind == IRTypeKind::IR_F32) {
+        float narrow = static_cast<float>(std::bit_cast<double>(value));
+        std::memcpy(to, &narrow, sizeof(narrow));
+        return true;
+    }
+    std::memcpy(to, &value, size);
+    return true;
+}
+
+bool Interpreter::execute_vector(const Function& fn, ValueId v, std::vector<std::uint64_t>& regs,
+                                 std::vector<std::uint64_t>& lanes) {
+    const Inst& inst = fn.inst(v);
+    // Registers of vector values hold the offset of their lanes.
+    auto lane = [&](ValueId value, std::uint64_t i) {
+        return fn.inst(value).type.is_vector() ? lanes[regs[value] + i] : regs[value];
+    };
+    switch (inst.op) {
+        case Opcode::OP_SPLAT:
+            std::fill_n(lanes.begin() + regs[v], inst.type.lanes, regs[fn.operand(v, 0)]);
+            return true;
+        case Opcode::OP_EXTRACT: {
+            ValueId vector = fn.operand(v, 0);
+            std::uint64_t index = regs[fn.operand(v, 1)];
+            if (index >= fn.inst(vector).type.lanes) {
+                return fail("lane index out of range in 'extract'");
+            }
+            regs[v] = lanes[regs[vector] + index];
+            return true;
+        }
+        case Opcode::OP_INSERT: {
+            std::uint64_t index = regs[fn.operand(v, 2)];
+            if (index >= inst.type.lanes) {
+                return fail("lane index out of range in 'insert'");
+            }
+            std::copy_n(lanes.begin() + regs[fn.operand(v, 0)], inst.type.lanes,
+                        lanes.begin() + regs[v]);
+            lanes[regs[v] + index] = regs[fn.operand(v, 1)];
+            return true;
+        }
+        case Opcode::OP_LOAD:
+        case Opcode::OP_STORE: {
+            bool is_load = inst.op == Opcode::OP_LOAD;
+            IRType type = is_load ? inst.type : fn.inst(fn.operand(v, 0)).type;
+            IRType element = type.element();
+            std::uint64_t address = regs[fn.operand(v, is_load ? 0 : 1)];
+            if (!check_access(address, type_size(type))) {
+                return false;
+            }
+            for (std::uint64_t i = 0; i < type.lanes; ++i) {
+                std::uint64_t at = address + i * type_size(element);
+                bool ok = is_load ? load(element, at, lanes[regs[v] + i])
+                                  : store(element, lane(fn.operand(v, 0), i), at);
+                if (!ok) {
+                    return false;
+                }
+            }
+            ++(is_load ? stats.loads : stats.stores);
+            return true;
+        }
+        default:
+            break;
+    }
+    IRType element = inst.type.element();
+    if (!is_pure(inst.op) || inst.op == Opcode::OP_PTRADD || !supported_type(element)) {
+        return fail(std::string("cannot execute '") + opcode_name(inst.op) + "' of type '" +
+                    type_to_string(inst.type) + "'");
+    }
+    ConstOperand operands[3];
+    std::uint32_t count = std::min<std::uint32_t>(inst.num_operands, 3);
+    for (std::uint64_t i = 0; i < inst.type.lanes; ++i) {
+        for (std::uint32_t k = 0; k < count; ++k) {
+            ValueId in = fn.operand(v, k);
+            operands[k] = {as_integer(fn.inst(in).type.element()), lane(in, i)};
+        }
+        std::optional<std::uint64_t> value =
+            fold_operation(inst.op, as_integer(element), inst.aux, {operands, count});
+        if (!value) {
+            return fail(std::string("undefined behavior in '") + opcode_name(inst.op) +
+                        "' in '@" + fn.name + "'");
+        }
+        lanes[regs[v] + i] = *value;
+    }
+    return true;
+}
+
+void Interpreter::track_arena_chunks(const PallasArena& arena) {
+    for (PallasArenaChunk* chunk = arena.first; chunk != nullptr; chunk = chunk->next) {
+        auto data = reinterpret_cast<std::uintptr_t>(runtime::chunk_data(chunk));
+        regions.try_emplace(data, Region{chunk->size, false, true});
+    }
+}
+
+// The arena, format and profile runtime, called natively on the interpreter's memory. The chunks
+// of every arena are registered as regions so that accesses to them pass the
+// bounds checks, and unregistered before they are freed.
+bool Interpreter::call_runtime(const Function& fn, std::span<const std::uint64_t> args,
+                               std::uint64_t& result) {
+    if (fn.name.starts_with("pallas_arena_") && !args.empty()) {
+        if (!check_access(args[0], sizeof(PallasArena))) {
+            return false;
+        }
+        auto* arena = reinterpret_cast<PallasArena*>(args[0]);
+        ++stats.calls;
+        if (fn.name == "pallas_arena_init" && args.size() == 2) {
+            pallas_arena_init(arena, args[1]);
+        } else if (fn.name == "pallas_arena_alloc" && args.size() == 3) {
+            if (args[2] == 0 || !std::has_single_bit(args[2])) {
+                return fail("arena alignment " + std::to_string(args[2]) +
+                            " is not a power of two");
+            }
+            ++stats.arena_refills;
+            result = reinterpret_cast<std::uintptr_t>(pallas_arena_alloc(arena, args[1], args[2]));
+        } else if (fn.name == "pallas_arena_free_all" && args.size() == 1) {
+            pallas_arena_free_all(arena);
+            return true;
+        } else if (fn.name == "pallas_arena_release" && args.size() == 1) {
+            for (PallasArenaChunk* chunk = arena->first; chunk != nullptr; chunk = chunk->next) {
+                regions.erase(reinterpret_cast<std::uintptr_t>(runtime::chunk_data(chunk)));
+            }
+            pallas_arena_release(arena);
+            return true;
+        } else {
+            return fail("call to external function '@" + fn.name + "'");
+        }
+        if (arena->first == nullptr || (fn.name == "pallas_arena_alloc" && result == 0)) {
+            return fail("out of memory");
+        }
+        track_arena_chunks(*arena);
+        return true;
+    }
+    if (fn.name.starts_with("pallas_format_") && args.size() >= 2) {
+        auto* out = reinterpret_cast<char*>(args[0]);
+        ++stats.calls;
+        if (fn.name == "pallas_format_string" && args.size() == 3) {
+            if (!check_access(args[0], args[2]) || !check_access(args[1], args[2])) {
+                return false;
+            }
+            result = reinterpret_cast<std::uintptr_t>(
+                pallas_format_string(out, reinterpret_cast<const char*>(args[1]), args[2]));
+            return true;
+        }
+        if (!check_access(args[0], fn.name.ends_with("i64") || fn.name.ends_with("u64")
+                                       ? runtime::kMaxIntegerChars
+                                       : runtime::kMaxFloatChars)) {
+            return false;
+        }
+        char* end = nullptr;
+        if (fn.name == "pallas_format_i64") {
+            end = pallas_format_i64(out, static_cast<std::int64_t>(args[1]));
+        } else if (fn.name == "pallas_format_u64") {
+            end = pallas_format_u64(out, args[1]);
+        } else if (fn.name == "pallas_format_f64") {
+            end = pallas_format_f64(out, std::bit_cast<double>(args[1]));
+        } else if (fn.name == "pallas_format_f32") {
+            // f32 registers hold the value widened to double.
+            end = pallas_format_f32(out, static_cast<float>(std::bit_cast<double>(args[1])));
+        } else {
+            return fail("call to external function '@" + fn.name + "'");
+        }
+        result = reinterpret_cast<std::uintptr_t>(end);
+        return true;
+    }
+    // The reserved output is a region until it is committed.
+    if (fn.name == "pallas_output_reserve" && args.size() == 1) {
+        ++stats.calls;
+        result = reinterpret_cast<std::uintptr_t>(pallas_output_reserve(args[0]));
+        regions.insert_or_assign(result, Region{args[0], false, false});
+        return true;
+    }
+    if (fn.name == "pallas_output_commit" && args.size() == 1) {
+        auto region = regions.upper_bound(args[0]);
+        if (region == regions.begin()) {
+            return fail("output committed without a reservation");
+        }
+        --region;
+        if (args[0] > region->first + region->second.size) {
+            return fail("output committed past its reservation");
+        }
+        ++stats.calls;
+        regions.erase(region);
+        pallas_output_commit(reinterpret_cast<char*>(args[0]));
+        return true;
+    }
+    if (fn.name.starts_with("pallas_vec_") || fn.name.starts_with("pallas_string_")) {
+        return call_storage(fn, args, result);
+    }
+    if (fn.name == "pallas_profile_write" && args.size() == 5) {
+        if (!check_access(args[0], 1) || !check_access(args[1], args[2]) ||
+            !check_access(args[3], args[4] * sizeof(std::uint64_t))) {
+            return false;
+        }
+        ++stats.calls;
+        pallas_profile_write(reinterpret_cast<const char*>(args[0]),
+                             reinterpret_cast<const std::uint8_t*>(args[1]), args[2],
+                             reinterpret_cast<const std::uint64_t*>(args[3]), args[4]);
+        return true;
+    }
+    if (fn.name.starts_with("pallas_black_box_") && args.size() == 1) {
+        ++stats.calls;
+        result = args[0];  // floats and pointers travel as their bits already
+        return true;
+    }
+    return fail("call to external function '@" + fn.name + "'");
+}
+
+// The string and Vec runtime. A heap buffer is a region while a string or Vec
+// owns it: it is unregistered before a call that may move or free it and
+// registered again afterwards. Arena buffers are covered by their chunks, and
+// inline buffers by the stack.
+bool Interpreter::call_storage(const Function& fn, std::span<const std::uint64_t> args,
+                               std::uint64_t& result) {
+    static const std::unordered_map<std::string_view, std::pair<std::size_t, std::size_t>>
+        kSignatures = {
+            // name -> argument count, index of the arena argument (0 if none)
+            {"pallas_vec_grow", {3, 2}},        {"pallas_vec_reserve", {4, 3}},
+            {"pallas_vec_init_inline", {4, 0}}, {"pallas_vec_free", {1, 0}},
+            {"pallas_string_assign", {4, 3}},   {"pallas_string_append", {4, 3}},
+            {"pallas_string_prepare", {3, 2}},  {"pallas_string_commit", {2, 0}},
+            {"pallas_string_slice", {5, 4}},    {"pallas_string_free", {1, 0}},
+        };
+    auto signature = kSignatures.find(fn.name);
+    if (signature == kSignatures.end() || args.size() != signature->second.first) {
+        return fail("call to external function '@" + fn.name + "'");
+    }
+    bool vec = fn.name.starts_with("pallas_vec_");
+    if (!check_access(args[0], vec ? sizeof(PallasVec) : sizeof(PallasString))) {
+        return false;
+    }
+    std::size_t arena_index = signature->second.second;
+    auto* arena = arena_index != 0 ? reinterpret_cast<PallasArena*>(args[arena_index]) : nullptr;
+    if (arena != nullptr && !check_access(args[arena_index], sizeof(PallasArena))) {
+        return false;
+    }
+    auto* v = reinterpret_cast<PallasVec*>(args[0]);
+    auto* s = reinterpret_cast<PallasString*>(args[0]);
+    auto buffer = [&]() -> void* {
+        if (vec) {
+            return v->data;
+        }
+        return runtime::string_is_inline(s) ? nullptr : s->data;
+    };
+    auto* text = reinterpret_cast<const char*>(args[1]);
+    if (fn.name == "pallas_vec_init_inline") {
+        if (args[3] != 0 && args[2] > (UINT64_MAX - runtime::kVecInlineHeader) / args[3]) {
+            return fail("inline Vec storage is too large");
+        }
+        if (!check_access(args[1], runtime::kVecInlineHeader + args[2] * args[3])) {
+            return false;
+        }
+    } else if (fn.name == "pallas_string_assign" || fn.name == "pallas_string_append") {
+        if (args[2] != 0 && !check_access(args[1], args[2])) {
+            return false;
+        }
+    } else if (fn.name == "pallas_string_commit") {
+        const char* start = runtime::string_text(s);
+        std::uint64_t capacity = runtime::string_is_inline(s)
+                                     ? runtime::kStringInlineCapacity
+                                     : s->capacity & ~runtime::kStringHeapFlag;
+        if (args[1] < reinterpret_cast<std::uintptr_t>(start) ||
+            args[1] - reinterpret_cast<std::uintptr_t>(start) > capacity) {
+            return fail("string committed past its capacity");
+        }
+    } else if (fn.name == "pallas_string_slice") {
+        if (!check_access(args[1], sizeof(PallasString))) {
+            return false;
+        }
+        // The runtime would panic (pallas_slice_fail); fail with its message.
+        std::uint64_t length = runtime::string_length(reinterpret_cast<PallasString*>(args[1]));
+        if (args[3] > length || args[2] > args[3]) {
+            return fail("slice [" + std::to_string(args[2]) + ", " + std::to_string(args[3]) +
+                        ") out of bounds for length " + std::to_string(length));
+        }
+    }
+
+    void* old = buffer();
+    if (old != nullptr && runtime::buffer_header(old)->source == runtime::kBufferHeap) {
+        regions.erase(reinterpret_cast<std::uintptr_t>(old));
+    }
+    ++stats.calls;
+    if (fn.name == "pallas_vec_grow") {
+        pallas_vec_grow(v, args[1], arena);
+    } else if (fn.name == "pallas_vec_reserve") {
+        pallas_vec_reserve(v, args[1], args[2], arena);
+    } else if (fn.name == "pallas_vec_init_inline") {
+        pallas_vec_init_inline(v, reinterpret_cast<void*>(args[1]), args[2], args[3]);
+    } else if (fn.name == "pallas_vec_free") {
+        pallas_vec_free(v);
+    } else if (fn.name == "pallas_string_assign") {
+        pallas_string_assign(s, text, args[2], arena);
+    } else if (fn.name == "pallas_string_append") {
+        pallas_string_append(s, text, args[2], arena);
+    } else if (fn.name == "pallas_string_prepare") {
+        result = reinterpret_cast<std::uintptr_t>(pallas_string_prepare(s, args[1], arena));
+    } else if (fn.name == "pallas_string_commit") {
+        pallas_string_commit(s, reinterpret_cast<char*>(args[1]));
+    } else if (fn.name == "pallas_string_slice") {
+        pallas_string_slice(s, reinterpret_cast<PallasString*>(args[1]), args[2], args[3], arena);
+    } else {
+        pallas_string_free(s);
+    }
+    void* now = buffer();
+    if (now != nullptr) {
+        const runtime::BufferHeader* header = runtime::buffer_header(now);
+        if (header->source == runtime::kBufferHeap) {
+            regions.insert_or_assign(reinterpret_cast<std::uintptr_t>(now),
+                                     Region{header->bytes, false, false});
+        } else if (header->source != runtime::kBufferInline) {
+            track_arena_chunks(*reinterpret_cast<const PallasArena*>(header->source));
+        }
+    }
+    return true;
+}
+
+bool Interpreter::call(const Function& fn, std::span<const std::uint64_t> args,
+                       std::uint64_t& result) {
+    if ((fn.flags & FUNCTION_EXTERN) != 0 || fn.entry() == kNoBlock) {
+        return call_runtime(fn, args, result);
+    }
+    if (depth >= options.max_call_depth) {
+        return fail("call depth limit exceeded in '@" + fn.name + "'");
+    }
+    const FrameLayout& frame = layout_of(fn);
+    if (frame.vector_signature) {
+        return fail("vector parameters and results are not supported in '@" + fn.name + "'");
+    }
+    ++depth;
+    ++stats.calls;
+    std::size_t saved_top = stack_top;
+    std::vector<std::uint64_t> regs(fn.num_values(), 0);
+    std::vector<std::uint64_t> lanes(frame.lane_count, 0);
+    for (std::size_t i = 0; i < frame.vectors.size(); ++i) {
+        regs[frame.vectors[i]] = frame.lane_offsets[i];
+    }
+    for (std::size_t i = 0; i < args.size(); ++i) {
+        regs[fn.arg(i)] = args[i];
+    }
+    for (ValueId v : frame.leaves) {
+        const Inst& inst = fn.inst(v);
+        if (inst.op == Opcode::OP_CONST && inst.type.is_vector()) {
+            std::fill_n(lanes.begin() + regs[v], inst.type.lanes, inst.imm);
+        } else if (inst.op == Opcode::OP_CONST) {
+            regs[v] = inst.imm;
+        } else if (inst.op == Opcode::OP_GLOBAL) {
+            regs[v] = reinterpret_cast<std::uintptr_t>(global_address(inst.aux));
+        }
+    }
+    auto finish = [&](bool ok) {
+        stack_top = saved_top;
+        --depth;
+        return ok;
+    };
+
+    std::vector<std::uint64_t> incoming;
+    std::vector<std::uint64_t> incoming_lanes;
+    std::vector<std::uint64_t> call_args;
+    BlockId prev = kNoBlock;
+    BlockId b = fn.entry();
+    while (true) {
+        ValueId v = fn.block(b).first;
+        // Phis read their inputs before any of them is written.
+        incoming.clear();
+        incoming_lanes.clear();
+        ValueId first_phi = v;
+        for (; v != kNoValue && fn.inst(v).op == Opcode::OP_PHI; v = fn.inst(v).next) {
+            std::span<const BlockId> from = fn.targets(v);
+            std::uint32_t i = 0;
+            while (i < from.size() && from[i] != prev) {
+                ++i;
+            }
+            if (i == from.size()) {
+                return finish(fail("phi in '@" + fn.name + "' has no value for the incoming edge"));
+            }
+            ValueId in = fn.operand(v, i);
+            IRType type = fn.inst(v).type;
+            if (type.is_vector()) {
+                incoming_lanes.insert(incoming_lanes.end(), lanes.begin() + regs[in],
+                                      lanes.begin() + regs[in] + type.lanes);
+            } else {
+                incoming.push_back(regs[in]);
+            }
+        }
+        std::size_t k = 0;
+        std::size_t copied = 0;
+        std::uint64_t count = 0;
+        for (ValueId p = first_phi; p != v; p = fn.inst(p).next, ++count) {
+            IRType type = fn.inst(p).type;
+            if (type.is_vector()) {
+                std::copy_n(incoming_lanes.begin() + copied, type.lanes, lanes.begin() + regs[p]);
+                copied += type.lanes;
+            } else {
+                regs[p] = incoming[k++];
+            }
+        }
+        stats.instructions += count;
+
+        BlockId next = kNoBlock;
+        for (; v != kNoValue; v = fn.inst(v).next) {
+            if (++stats.instructions > options.max_instructions) {
+                return finish(fail("instruction limit exceeded"));
+            }
+            const Inst& inst = fn.inst(v);
+            if (frame.lane_count != 0 && is_vector_instruction(fn, v)) {
+                if (!execute_vector(fn, v, regs, lanes)) {
+                    return finish(false);
+                }
+                continue;
+            }
+            switch (inst.op) {
+                case Opcode::OP_BR:
+                    next = fn.targets(v)[0];
+                    break;
+                case Opcode::OP_COND_BR:
+                    next = fn.targets(v)[(regs[fn.operand(v, 0)] & 1) != 0 ? 0 : 1];
+                    break;
+                case Opcode::OP_SWITCH: {
+                    std::uint64_t value = regs[fn.operand(v, 0)];
+                    next = fn.targets(v)[0];
+                    auto table = frame.switches.find(v);
+                    if (table != frame.switches.end()) {
+                        const FrameLayout::SwitchTable& t = table->second;
+                        if (!t.dense.empty()) {
+                            std::uint64_t index = (value - t.base) & t.mask;
+                            next = index < t.dense.size() ? t.dense[index] : next;
+                        } else {
+                            auto found = std::lower_bound(
+                                t.sorted.begin(), t.sorted.end(), value,
+                                [](const auto& c, std::uint64_t x) { return c.first < x; });
+                            if (found != t.sorted.end() && found->first == value) {
+                                next = found->second;
+                            }
+                        }
+                        break;
+                    }
+                    for (std::uint32_t i = 1; i < inst.num_operands; ++i) {
+                        if (regs[fn.operand(v, i)] == value) {
+                            next = fn.targets(v)[i];
+                            break;
+                        }
+                    }
+                    break;
+                }
+                case Opcode::OP_RET:
+                    result = inst.num_operands > 0 ? regs[fn.operand(v, 0)] : 0;
+                    return finish(true);
+                case Opcode::OP_UNREACHABLE:
+                    return finish(fail("reached 'unreachable' in '@" + fn.name + "'"));
+                case Opcode::OP_ALLOCA: {
+                    std::uint64_t align = std::max<std::uint64_t>(inst.aux, 1);
+                    std::uint64_t top = (stack_top + align - 1) & ~(align - 1);
+                    if (top + inst.imm > stack.size()) {
+                        return finish(fail("stack overflow"));
+                    }
+                    std::memset(stack.data() + top, 0, inst.imm);
+                    regs[v] = reinterpret_cast<std::uintptr_t>(stack.data() + top);
+                    stack_top = top + inst.imm;
+                    break;
+                }
+                case Opcode::OP_LOAD:
+                    ++stats.loads;
+                    if (!load(inst.type, regs[fn.operand(v, 0)], regs[v])) {
+                        return finish(false);
+                    }
+                    break;
+                case Opcode::OP_STORE:
+                    ++stats.stores;
+                    if (!store(fn.inst(fn.operand(v, 0)).type, regs[fn.operand(v, 0)],
+                               regs[fn.operand(v, 1)])) {
+                        return finish(false);
+                    }
+                    break;
+                case Opcode::OP_PTRADD:
+                    regs[v] = regs[fn.operand(v, 0)] + regs[fn.operand(v, 1)];
+                    break;
+                case Opcode::OP_PTRTOINT:
+                    regs[v] = mask_to(regs[fn.operand(v, 0)], type_bits(inst.type));
+                    break;
+                case Opcode::OP_INTTOPTR:
+                    regs[v] = regs[fn.operand(v, 0)];
+                    break;
+                case Opcode::OP_NEW: {
+                    ++stats.allocations;
+                    std::uint64_t size = std::max<std::uint64_t>(regs[fn.operand(v, 0)], 1);
+                    void* memory = std::calloc(1, size);
+                    if (memory == nullptr) {
+                        return finish(fail("out of memory"));
+                    }
+                    regions[reinterpret_cast<std::uintptr_t>(memory)] = {size, true};
+                    regs[v] = reinterpret_cast<std::uintptr_t>(memory);
+                    break;
+                }
+                case Opcode::OP_DELETE: {
+                    std::uint64_t address = regs[fn.operand(v, 0)];
+                    if (address == 0) {
+                        break;
+                    }
+                    auto region = regions.find(address);
+                    if (region == regions.end() || !region->second.heap) {
+                        return finish(fail("delete of a pointer that was not allocated with new"));
+                    }
+                    ++stats.frees;
+                    regions.erase(region);
+                    std::free(reinterpret_cast<void*>(address));
+                    break;
+                }
+                case Opcode::OP_BOUNDS_CHECK: {
+                    ++stats.bounds_checks;
+                    std::uint64_t index = regs[fn.operand(v, 0)];
+                    std::uint64_t length = regs[fn.operand(v, 1)];
+                    if (index >= length) {
+                        return finish(fail("index " + std::to_string(index) +
+                                           " out of bounds for length " +
+                                           std::to_string(length)));
+                    }
+                    break;
+                }
+                case Opcode::OP_CALL: {
+                    const Function* callee = module.function_for(inst.aux);
+                    if (callee == nullptr) {
+                        return finish(fail("call to unknown function '@" +
+                                           module.symbol_name(inst.aux) + "'"));
+                    }
+                    call_args.clear();
+                    for (std::uint32_t i = 0; i < inst.num_operands; ++i) {
+                        call_args.push_back(regs[fn.operand(v, i)]);
+                    }
+                    if (!call(*callee, call_args, regs[v])) {
+                        return finish(false);
+                    }
+                    break;
+                }
+                default: {
+                    if (!is_pure(inst.op) || !supported_type(inst.type)) {
+                        return finish(fail(std::string("cannot execute '") + opcode_name(inst.op) +
+                                           "' of type '" + type_to_string(inst.type) + "'"));
+                    }
+                    ConstOperand operands[3];
+                    std::uint32_t count = std::min<std::uint32_t>(inst.num_operands, 3);
+                    for (std::uint32_t i = 0; i < count; ++i) {
+                        ValueId in = fn.operand(v, i);
+                        operands[i] = {as_integer(fn.inst(in).type), regs[in]};
+                    }
+                    std::optional<std::uint64_t> value =
+                        fold_operation(inst.op, as_integer(inst.type), inst.aux, {operands, count});
+                    if (!value) {
+                        return finish(fail(std::string("undefined behavior in '") +
+                                           opcode_name(inst.op) + "' in '@" + fn.name + "'"));
+                    }
+                    regs[v] = *value;
+                    break;
+                }
+            }
+            if (next != kNoBlock) {
+                break;
+            }
+        }
+        if (next == kNoBlock) {
+            return finish(fail("block without terminator in '@" + fn.name + "'"));
+        }
+        prev = b;
+        b = next;
+    }
+}
+
+ExecutionResult Interpreter::run(const std::string& function, std::span<const std::uint64_t> args) {
+    ExecutionResult result;
+    error.clear();
+    stats = {};
+    const Function* fn = module.find_function(function);
+    if (fn == nullptr) {
+        result.error = "no function '@" + function + "'";
+        return result;
+    }
+    if (args.size() != fn->num_args()) {
+        result.error = "'@" + function + "' takes " + std::to_string(fn->num_args()) + " arguments";
+        return result;
+    }
+    std::vector<std::uint64_t> masked(args.begin(), args.end());
+    for (std::size_t i = 0; i < masked.size(); ++i) {
+        IRType type = fn->inst(fn->arg(i)).type;
+        if (is_int(type)) {
+            masked[i] = mask_to(masked[i], type_bits(type));
+        }
+    }
+    auto start = std::chrono::steady_clock::now();
+    result.ok = call(*fn, masked, result.value);
+    runtime::flush_output();
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.error = error;
+    result.stats = stats;
+    return result;
+}
+
+}  // namespace pallas::middle
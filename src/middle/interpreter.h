@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ir.h"
+#include "runtime/arena.h"
+
+namespace pallas::middle {
+
+struct InterpreterOptions {
+    std::uint64_t max_instructions = 10'000'000'000ull;
+    std::size_t max_call_depth = 4096;
+    std::size_t stack_bytes = 8 << 20;
+};
+
+// Dynamic counts of one run; `instructions` counts every executed
+// instruction, including phis and terminators.
+struct ExecutionStats {
+    std::uint64_t instructions = 0;
+    std::uint64_t calls = 0;
+    std::uint64_t loads = 0;
+    std::uint64_t stores = 0;
+    std::uint64_t bounds_checks = 0;
+    std::uint64_t allocations = 0;  // executed `new`s
+    std::uint64_t frees = 0;        // executed `delete`s of non-null pointers
+    std::uint64_t arena_refills = 0;  // arena allocations that missed the inline fast path
+    double seconds = 0.0;
+};
+
+struct ExecutionResult {
+    bool ok = false;
+    std::uint64_t value = 0;  // return value bits, floats as double bits
+    std::string error;
+    ExecutionStats stats;
+};
+
+// Executes IR directly, for testing transforms and comparing the dynamic cost
+// of pipelines without a backend. Scalar values are held as 64-bit patterns in
+// the same encoding as IR constants; vectors keep one such pattern per lane in a
+// per-call lane buffer, and a vector instruction counts as one instruction.
+// Pointers are host addresses into memory the interpreter owns: a stack for
+// allocas, one buffer per global, the heap blocks from `new` and the chunks of
+// arenas; calls to the arena runtime (pallas_arena_*) run the native functions.
+// Undefined behavior that the interpreter can see (division by zero, oversized
+// shifts, null or freed pointers, falling into `unreachable`) stops the run
+// with an error.
+class Interpreter {
+  public:
+    explicit Interpreter(const Module& module, InterpreterOptions options = {});
+    ~Interpreter();
+    Interpreter(const Interpreter&) = delete;
+    Interpreter& operator=(const Interpreter&) = delete;
+
+    ExecutionResult run(const std::string& function, std::span<const std::uint64_t> args = {});
+
+  private:
+    struct Region {
+        std::size_t size = 0;
+        bool heap = false;
+        bool arena_chunk = false;  // data of a runtime arena chunk
+    };
+
+    const Module& module;
+    InterpreterOptions options;
+    std::vector<std::byte> stack;
+    std::size_t stack_top = 0;
+    std::unordered_map<SymbolId, std::unique_ptr<std::byte[]>> globals;
+    // Global and heap memory by start address, for bounds checks.
+    std::map<std::uintptr_t, Region> regions;
+    // Computed on the first call of each function: the constant, undef and
+    // global leaves, so a call only initializes the registers that are not
+    // computed by instructions, and where each vector value keeps its lanes.
+    struct FrameLayout {
+        std::vector<ValueId> leaves;
+        std::vector<ValueId> vectors;
+        std::vector<std::uint32_t> lane_offsets;  // parallel to `vectors`
+        std::size_t lane_count = 0;
+        bool vector_signature = false;
+        // Switches whose cases are all constants. Dense case sets get a table
+        // indexed by (value - base) & mask, others are searched in `sorted`;
+        // either way only the first of equal cases counts.
+        struct SwitchTable {
+            std::uint64_t base = 0;
+            std::uint64_t mask = 0;
+            std::vector<BlockId> dense;
+            std::vector<std::pair<std::uint64_t, BlockId>> sorted;
+        };
+        std::unordered_map<ValueId, SwitchTable> switches;
+    };
+    std::unordered_map<const Function*, FrameLayout> layouts;
+    ExecutionStats stats;
+    std::string error;
+    std::size_t depth = 0;
+
+    bool fail(const std::string& msg);
+    std::byte* global_address(SymbolId symbol);
+    const FrameLayout& layout_of(const Function& fn);
+    static FrameLayout::SwitchTable switch_table(const Function& fn, ValueId v);
+    bool call(const Function& fn, std::span<const std::uint64_t> args, std::uint64_t& result);
+    bool call_runtime(const Function& fn, std::span<const std::uint64_t> args,
+                      std::uint64_t& result);
+    bool call_storage(const Function& fn, std::span<const std::uint64_t> args,
+                      std::uint64_t& result);
+    void track_arena_chunks(const PallasArena& arena);
+    bool check_access(std::uint64_t address, std::uint64_t size);
+    bool load(IRType type, std::uint64_t address, std::uint64_t& out);
+    bool store(IRType type, std::uint64_t value, std::uint64_t address);
+    bool execute_vector(const Function& fn, ValueId v, std::vector<std::uint64_t>& regs,
+                        std::vector<std::uint64_t>& lanes);
+};
+
+}  // namespace pallas::middle
@@ -0,0 +1,1656 @@
+#include "ir.h"
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <unordered_set>
+#include <utility>
+
+namespace pallas::middle {
+
+bool is_int(IRType type) {
+    switch (type.kind) {
+        case IRTypeKind::IR_I1:
+        case IRTypeKind::IR_I8:
+        case IRTypeKind::IR_I16:
+        case IRTypeKind::IR_I32:
+        case IRTypeKind::IR_I64:
+        case IRTypeKind::IR_I128:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool is_float(IRType type) {
+    return type.kind == IRTypeKind::IR_F32 || type.kind == IRTypeKind::IR_F64;
+}
+
+unsigned type_bits(IRType type) {
+    switch (type.kind) {
+        case IRTypeKind::IR_I1: return 1;
+        case IRTypeKind::IR_I8: return 8;
+        case IRTypeKind::IR_I16: return 16;
+        case IRTypeKind::IR_I32: return 32;
+        case IRTypeKind::IR_I64: return 64;
+        case IRTypeKind::IR_I128: return 128;
+        case IRTypeKind::IR_F32: return 32;
+        case IRTypeKind::IR_F64: return 64;
+        case IRTypeKind::IR_PTR: return 64;
+        default: return 0;
+    }
+}
+
+std::uint64_t type_size(IRType type) {
+    if (type.kind == IRTypeKind::IR_VOID) {
+        return 0;
+    }
+    std::uint64_t scalar = type.kind == IRTypeKind::IR_I1 ? 1 : type_bits(type) / 8;
+    return scalar * type.lanes;
+}
+
+std::string type_to_string(IRType type) {
+    const char* name = "void";
+    switch (type.kind) {
+        case IRTypeKind::IR_VOID: name = "void"; break;
+        case IRTypeKind::IR_I1: name = "i1"; break;
+        case IRTypeKind::IR_I8: name = "i8"; break;
+        case IRTypeKind::IR_I16: name = "i16"; break;
+        case IRTypeKind::IR_I32: name = "i32"; break;
+        case IRTypeKind::IR_I64: name = "i64"; break;
+        case IRTypeKind::IR_I128: name = "i128"; break;
+        case IRTypeKind::IR_F32: name = "f32"; break;
+        case IRTypeKind::IR_F64: name = "f64"; break;
+        case IRTypeKind::IR_PTR: name = "ptr"; break;
+    }
+    if (type.is_vector()) {
+        return "<" + std::to_string(type.lanes) + " x " + name + ">";
+    }
+    return name;
+}
+
+const char* opcode_name(Opcode op) {
+    switch (op) {
+        case Opcode::OP_ARG: return "arg";
+        case Opcode::OP_CONST: return "const";
+        case Opcode::OP_UNDEF: return "undef";
+        case Opcode::OP_GLOBAL: return "global";
+        case Opcode::OP_ADD: return "add";
+        case Opcode::OP_SUB: return "sub";
+        case Opcode::OP_MUL: return "mul";
+        case Opcode::OP_SDIV: return "sdiv";
+        case Opcode::OP_UDIV: return "udiv";
+        case Opcode::OP_SREM: return "srem";
+        case Opcode::OP_UREM: return "urem";
+        case Opcode::OP_AND: return "and";
+        case Opcode::OP_OR: return "or";
+        case Opcode::OP_XOR: return "xor";
+        case Opcode::OP_SHL: return "shl";
+        case Opcode::OP_LSHR: return "lshr";
+        case Opcode::OP_ASHR: return "ashr";
+        case Opcode::OP_FADD: return "fadd";
+        case Opcode::OP_FSUB: return "fsub";
+        case Opcode::OP_FMUL: return "fmul";
+        case Opcode::OP_FDIV: return "fdiv";
+        case Opcode::OP_FREM: return "frem";
+        case Opcode::OP_FNEG: return "fneg";
+        case Opcode::OP_ICMP: return "icmp";
+        case Opcode::OP_FCMP: return "fcmp";
+        case Opcode::OP_TRUNC: return "trunc";
+        case Opcode::OP_ZEXT: return "zext";
+        case Opcode::OP_SEXT: return "sext";
+        case Opcode::OP_FPTOSI: return "fptosi";
+        case Opcode::OP_FPTOUI: return "fptoui";
+        case Opcode::OP_SITOFP: return "sitofp";
+        case Opcode::OP_UITOFP: return "uitofp";
+        case Opcode::OP_FPEXT: return "fpext";
+        case Opcode::OP_FPTRUNC: return "fptrunc";
+        case Opcode::OP_PTRTOINT: return "ptrtoint";
+        case Opcode::OP_INTTOPTR: return "inttoptr";
+        case Opcode::OP_SELECT: return "select";
+        case Opcode::OP_SPLAT: return "splat";
+        case Opcode::OP_EXTRACT: return "extract";
+        case Opcode::OP_INSERT: return "insert";
+        case Opcode::OP_ALLOCA: return "alloca";
+        case Opcode::OP_LOAD: return "load";
+        case Opcode::OP_STORE: return "store";
+        case Opcode::OP_PTRADD: return "ptradd";
+        case Opcode::OP_NEW: return "new";
+        case Opcode::OP_DELETE: return "delete";
+        case Opcode::OP_BOUNDS_CHECK: return "boundscheck";
+        case Opcode::OP_CALL: return "call";
+        case Opcode::OP_PHI: return "phi";
+        case Opcode::OP_BR: return "br";
+        case Opcode::OP_COND_BR: return "condbr";
+        case Opcode::OP_SWITCH: return "switch";
+        case Opcode::OP_RET: return "ret";
+        case Opcode::OP_UNREACHABLE: return "unreachable";
+    }
+    return "?";
+}
+
+const char* predicate_name(CmpPredicate pred) {
+    switch (pred) {
+        case CmpPredicate::CMP_EQ: return "eq";
+        case CmpPredicate::CMP_NE: return "ne";
+        case CmpPredicate::CMP_SLT: return "slt";
+        case CmpPredicate::CMP_SLE: return "sle";
+        case CmpPredicate::CMP_SGT: return "sgt";
+        case CmpPredicate::CMP_SGE: return "sge";
+        case CmpPredicate::CMP_ULT: return "ult";
+        case CmpPredicate::CMP_ULE: return "ule";
+        case CmpPredicate::CMP_UGT: return "ugt";
+        case CmpPredicate::CMP_UGE: return "uge";
+        case CmpPredicate::CMP_OEQ: return "oeq";
+        case CmpPredicate::CMP_ONE: return "one";
+        case CmpPredicate::CMP_OLT: return "olt";
+        case CmpPredicate::CMP_OLE: return "ole";
+        case CmpPredicate::CMP_OGT: return "ogt";
+        case CmpPredicate::CMP_OGE: return "oge";
+    }
+    return "?";
+}
+
+bool is_terminator(Opcode op) {
+    switch (op) {
+        case Opcode::OP_BR:
+        case Opcode::OP_COND_BR:
+        case Opcode::OP_SWITCH:
+        case Opcode::OP_RET:
+        case Opcode::OP_UNREACHABLE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool has_side_effects(Opcode op) {
+    switch (op) {
+        case Opcode::OP_STORE:
+        case Opcode::OP_NEW:
+        case Opcode::OP_DELETE:
+        case Opcode::OP_BOUNDS_CHECK:
+        case Opcode::OP_CALL:
+            return true;
+        default:
+            return is_terminator(op);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Function
+// ---------------------------------------------------------------------------
+
+void FunctionProfile::set_block_count(BlockId b, std::uint64_t count) {
+    if (b >= block_counts.size()) {
+        block_counts.resize(b + 1, kNoCount);
+    }
+    block_counts[b] = count;
+}
+
+Function::Function(Module* module, std::string name, IRType return_type,
+                   const std::vector<IRType>& param_types)
+    : module(module), name(std::move(name)), return_type(return_type) {
+    for (std::size_t i = 0; i < param_types.size(); ++i) {
+        ValueId v = new_value(Opcode::OP_ARG, param_types[i]);
+        insts[v].aux = static_cast<std::uint32_t>(i);
+        args.push_back(v);
+    }
+}
+
+ValueId Function::new_value(Opcode op, IRType type) {
+    Inst inst;
+    inst.op = op;
+    inst.type = type;
+    insts.push_back(inst);
+    return static_cast<ValueId>(insts.size() - 1);
+}
+
+ValueId Function::constant(IRType type, std::uint64_t bits) {
+    unsigned width = type_bits(type);
+    if (is_int(type) && width < 64) {
+        bits &= (std::uint64_t{1} << width) - 1;
+    }
+    ConstKey key{type, Opcode::OP_CONST, bits};
+    auto found = constant_index.find(key);
+    if (found != constant_index.end()) {
+        return found->second;
+    }
+    ValueId v = new_value(Opcode::OP_CONST, type);
+    insts[v].imm = bits;
+    constant_index.emplace(key, v);
+    return v;
+}
+
+ValueId Function::float_constant(IRType type, double value) {
+    if (type.kind == IRTypeKind::IR_F32) {
+        value = static_cast<double>(static_cast<float>(value));
+    }
+    return constant(type, std::bit_cast<std::uint64_t>(value));
+}
+
+ValueId Function::undef(IRType type) {
+    ConstKey key{type, Opcode::OP_UNDEF, 0};
+    auto found = constant_index.find(key);
+    if (found != constant_index.end()) {
+        return found->second;
+    }
+    ValueId v = new_value(Opcode::OP_UNDEF, type);
+    constant_index.emplace(key, v);
+    return v;
+}
+
+ValueId Function::global(SymbolId symbol) {
+    auto found = global_index.find(symbol);
+    if (found != global_index.end()) {
+        return found->second;
+    }
+    ValueId v = new_value(Opcode::OP_GLOBAL, IRType::scalar(IRTypeKind::IR_PTR));
+    insts[v].aux = symbol;
+    global_index.emplace(symbol, v);
+    return v;
+}
+
+void Function::link_use(UseId u) {
+    Use& use = uses[u];
+    use.prev = kNoUse;
+    use.next = kNoUse;
+    if (use.value == kNoValue) {
+        return;
+    }
+    Inst& def = insts[use.value];
+    use.next = def.first_use;
+    if (use.next != kNoUse) {
+        uses[use.next].prev = u;
+    }
+    def.first_use = u;
+}
+
+void Function::unlink_use(UseId u) {
+    Use& use = uses[u];
+    if (use.value == kNoValue) {
+        return;
+    }
+    if (use.prev != kNoUse) {
+        uses[use.prev].next = use.next;
+    } else {
+        insts[use.value].first_use = use.next;
+    }
+    if (use.next != kNoUse) {
+        uses[use.next].prev = use.prev;
+    }
+    use.prev = kNoUse;
+    use.next = kNoUse;
+}
+
+void Function::set_operand(ValueId v, std::uint32_t i, ValueId value) {
+    UseId u = insts[v].first_operand + i;
+    unlink_use(u);
+    uses[u].value = value;
+    link_use(u);
+}
+
+std::size_t Function::count_uses(ValueId v) const {
+    std::size_t n = 0;
+    for (UseId u = insts[v].first_use; u != kNoUse; u = uses[u].next) {
+        ++n;
+    }
+    return n;
+}
+
+std::vector<ValueId> Function::users(ValueId v) const {
+    std::vector<ValueId> out;
+    for (UseId u = insts[v].first_use; u != kNoUse; u = uses[u].next) {
+        if (std::find(out.begin(), out.end(), uses[u].user) == out.end()) {
+            out.push_back(uses[u].user);
+        }
+    }
+    return out;
+}
+
+void Function::replace_all_uses(ValueId from, ValueId to) {
+    if (from == to) {
+        return;
+    }
+    while (insts[from].first_use != kNoUse) {
+        UseId u = insts[from].first_use;
+        unlink_use(u);
+        uses[u].value = to;
+        link_use(u);
+    }
+}
+
+void Function::allocate_operands(ValueId v, std::span<const ValueId> operands,
+                                 std::uint32_t capacity) {
+    capacity = std::max<std::uint32_t>(capacity, static_cast<std::uint32_t>(operands.size()));
+    UseId first = static_cast<UseId>(uses.size());
+    uses.resize(uses.size() + capacity);
+    for (std::size_t i = 0; i < operands.size(); ++i) {
+        uses[first + i].value = operands[i];
+        uses[first + i].user = v;
+        link_use(static_cast<UseId>(first + i));
+    }
+    for (std::size_t i = operands.size(); i < capacity; ++i) {
+        uses[first + i].user = v;
+    }
+    insts[v].first_operand = first;
+    insts[v].num_operands = static_cast<std::uint32_t>(operands.size());
+    insts[v].operand_capacity = capacity;
+}
+
+void Function::allocate_targets(ValueId v, std::span<const BlockId> targets,
+                                std::uint32_t capacity) {
+    capacity = std::max<std::uint32_t>(capacity, static_cast<std::uint32_t>(targets.size()));
+    std::uint32_t first = static_cast<std::uint32_t>(target_pool.size());
+    target_pool.insert(target_pool.end(), targets.begin(), targets.end());
+    target_pool.resize(first + capacity, kNoBlock);
+    insts[v].first_target = first;
+    insts[v].num_targets = static_cast<std::uint32_t>(targets.size());
+    insts[v].target_capacity = capacity;
+}
+
+void Function::link_into_block(ValueId v, BlockId b, ValueId before) {
+    Inst& inst = insts[v];
+    inst.block = b;
+    if (before == kNoValue) {
+        inst.prev = blocks[b].last;
+        inst.next = kNoValue;
+        if (blocks[b].last != kNoValue) {
+            insts[blocks[b].last].next = v;
+        } else {
+            blocks[b].first = v;
+        }
+        blocks[b].last = v;
+        return;
+    }
+    inst.next = before;
+    inst.prev = insts[before].prev;
+    if (inst.prev != kNoValue) {
+        insts[inst.prev].next = v;
+    } else {
+        blocks[b].first = v;
+    }
+    insts[before].prev = v;
+}
+
+void Function::unlink_from_block(ValueId v) {
+    Inst& inst = insts[v];
+    if (inst.block == kNoBlock) {
+        return;
+    }
+    Block& block = blocks[inst.block];
+    if (inst.prev != kNoValue) {
+        insts[inst.prev].next = inst.next;
+    } else {
+        block.first = inst.next;
+    }
+    if (inst.next != kNoValue) {
+        insts[inst.next].prev = inst.prev;
+    } else {
+        block.last = inst.prev;
+    }
+    inst.prev = kNoValue;
+    inst.next = kNoValue;
+    inst.block = kNoBlock;
+}
+
+ValueId Function::append(BlockId b, Opcode op, IRType type, std::span<const ValueId> operands,
+                         std::span<const BlockId> targets) {
+    ValueId v = new_value(op, type);
+    allocate_operands(v, operands, static_cast<std::uint32_t>(operands.size()));
+    allocate_targets(v, targets, static_cast<std::uint32_t>(targets.size()));
+    link_into_block(v, b, kNoValue);
+    return v;
+}
+
+ValueId Function::insert_before(ValueId pos, Opcode op, IRType type,
+                                std::span<const ValueId> operands,
+                                std::span<const BlockId> targets) {
+    ValueId v = new_value(op, type);
+    allocate_operands(v, operands, static_cast<std::uint32_t>(operands.size()));
+    allocate_targets(v, targets, static_cast<std::uint32_t>(targets.size()));
+    link_into_block(v, insts[pos].block, pos);
+    return v;
+}
+
+void Function::move_before(ValueId v, ValueId pos) {
+    unlink_from_block(v);
+    link_into_block(v, insts[pos].block, pos);
+}
+
+void Function::move_to_end(ValueId v, BlockId b) {
+    unlink_from_block(v);
+    link_into_block(v, b, kNoValue);
+}
+
+void Function::erase(ValueId v) {
+    unlink_from_block(v);
+    Inst& inst = insts[v];
+    for (std::uint32_t i = 0; i < inst.num_operands; ++i) {
+        unlink_use(inst.first_operand + i);
+        uses[inst.first_operand + i].value = kNoValue;
+    }
+    inst.num_operands = 0;
+    inst.num_targets = 0;
+}
+
+void Function::add_incoming(ValueId phi, ValueId value, BlockId from) {
+    Inst& inst = insts[phi];
+    if (inst.num_operands == inst.operand_capacity) {
+        std::vector<ValueId> operands;
+        for (std::uint32_t i = 0; i < inst.num_operands; ++i) {
+            operands.push_back(operand(phi, i));
+            unlink_use(inst.first_operand + i);
+            uses[inst.first_operand + i].value = kNoValue;
+        }
+        std::uint32_t capacity = std::max<std::uint32_t>(4, inst.operand_capacity * 2);
+        allocate_operands(phi, operands, capacity);
+    }
+    if (insts[phi].num_targets == insts[phi].target_capacity) {
+        std::vector<BlockId> old(targets(phi).begin(), targets(phi).end());
+        std::uint32_t capacity = std::max<std::uint32_t>(4, insts[phi].target_capacity * 2);
+        allocate_targets(phi, old, capacity);
+    }
+    Inst& grown = insts[phi];
+    UseId u = grown.first_operand + grown.num_operands++;
+    uses[u].value = value;
+    uses[u].user = phi;
+    link_use(u);
+    target_pool[grown.first_target + grown.num_targets++] = from;
+}
+
+void Function::remove_incoming(ValueId phi, std::uint32_t index) {
+    Inst& inst = insts[phi];
+    for (std::uint32_t i = index; i + 1 < inst.num_operands; ++i) {
+        set_operand(phi, i, operand(phi, i + 1));
+        target_pool[inst.first_target + i] = target_pool[inst.first_target + i + 1];
+    }
+    UseId last = inst.first_operand + inst.num_operands - 1;
+    unlink_use(last);
+    uses[last].value = kNoValue;
+    inst.num_operands--;
+    inst.num_targets--;
+}
+
+void Function::remove_predecessor(BlockId b, BlockId pred) {
+    for (ValueId v = blocks[b].first; v != kNoValue && insts[v].op == Opcode::OP_PHI;
+         v = insts[v].next) {
+        std::span<const BlockId> from = targets(v);
+        for (std::uint32_t i = 0; i < from.size(); ++i) {
+            if (from[i] == pred) {
+                remove_incoming(v, i);
+                break;
+            }
+        }
+    }
+}
+
+void Function::replace_predecessor(BlockId b, BlockId pred, BlockId replacement) {
+    for (ValueId v = blocks[b].first; v != kNoValue && insts[v].op == Opcode::OP_PHI;
+         v = insts[v].next) {
+        for (BlockId& from : targets(v)) {
+            if (from == pred) {
+                from = replacement;
+            }
+        }
+    }
+}
+
+void Function::remove_dead_predecessors(BlockId b, const std::vector<bool>& live) {
+    for (ValueId v = blocks[b].first; v != kNoValue && insts[v].op == Opcode::OP_PHI;
+         v = insts[v].next) {
+        Inst& inst = insts[v];
+        std::uint32_t kept = 0;
+        for (std::uint32_t i = 0; i < inst.num_operands; ++i) {
+            BlockId from = target_pool[inst.first_target + i];
+            if (!live[from]) {
+                continue;
+            }
+            if (kept != i) {
+                set_operand(v, kept, operand(v, i));
+                target_pool[inst.first_target + kept] = from;
+            }
+            kept++;
+        }
+        for (std::uint32_t i = kept; i < inst.num_operands; ++i) {
+            unlink_use(inst.first_operand + i);
+            uses[inst.first_operand + i].value = kNoValue;
+        }
+        inst.num_operands = kept;
+        inst.num_targets = kept;
+    }
+}
+
+BlockId Function::add_block() {
+    blocks.emplace_back();
+    BlockId b = static_cast<BlockId>(blocks.size() - 1);
+    layout.push_back(b);
+    return b;
+}
+
+void Function::erase_block(BlockId b) {
+    for (ValueId v : block_insts(b)) {
+        erase(v);
+    }
+    blocks[b].erased = true;
+    layout.erase(std::remove(layout.begin(), layout.end(), b), layout.end());
+}
+
+ValueId Function::terminator(BlockId b) const {
+    ValueId last = blocks[b].last;
+    if (last != kNoValue && is_terminator(insts[last].op)) {
+        return last;
+    }
+    return kNoValue;
+}
+
+std::span<const BlockId> Function::successors(BlockId b) const {
+    ValueId term = terminator(b);
+    if (term == kNoValue) {
+        return {};
+    }
+    return targets(term);
+}
+
+std::vector<ValueId> Function::block_insts(BlockId b) const {
+    std::vector<ValueId> out;
+    for (ValueId v = blocks[b].first; v != kNoValue; v = insts[v].next) {
+        out.push_back(v);
+    }
+    return out;
+}
+
+void Function::rebind(Module* into) {
+    global_index.clear();
+    for (ValueId v = 0; v < insts.size(); ++v) {
+        Inst& inst = insts[v];
+        if (inst.op == Opcode::OP_CALL || inst.op == Opcode::OP_GLOBAL) {
+            inst.aux = into->intern(module->symbol_name(inst.aux));
+        }
+        if (inst.op == Opcode::OP_GLOBAL) {
+            global_index.emplace(inst.aux, v);
+        }
+    }
+    module = into;
+}
+
+std::size_t Function::instruction_count() const {
+    std::size_t n = 0;
+    for (BlockId b : layout) {
+        for (ValueId v = blocks[b].first; v != kNoValue; v = insts[v].next) {
+            ++n;
+        }
+    }
+    return n;
+}
+
+std::size_t Function::memory_bytes() const {
+    return insts.capacity() * sizeof(Inst) + uses.capacity() * sizeof(Use) +
+           target_pool.capacity() * sizeof(BlockId) + blocks.capacity() * sizeof(Block) +
+           layout.capacity() * sizeof(BlockId);
+}
+
+// ---------------------------------------------------------------------------
+// Module
+// ---------------------------------------------------------------------------
+
+SymbolId Module::intern(const std::string& name) {
+    auto found = symbol_index.find(name);
+    if (found != symbol_index.end()) {
+        return found->second;
+    }
+    SymbolId id = static_cast<SymbolId>(symbols.size());
+    symbols.push_back(name);
+    symbol_index.emplace(name, id);
+    return id;
+}
+
+SymbolId Module::find_symbol(const std::string& name) const {
+    auto found = symbol_index.find(name);
+    return found == symbol_index.end() ? kNoSymbol : found->second;
+}
+
+Function* Module::add_function(const std::string& name, IRType return_type,
+                               const std::vector<IRType>& param_types) {
+    functions.push_back(std::make_unique<Function>(this, name, return_type, param_types));
+    Function* fn = functions.back().get();
+    function_index[intern(name)] = fn;
+    return fn;
+}
+
+Function* Module::find_function(const std::string& name) const {
+    SymbolId id = find_symbol(name);
+    return id == kNoSymbol ? nullptr : function_for(id);
+}
+
+Function* Module::function_for(SymbolId symbol) const {
+    auto found = function_index.find(symbol);
+    return found == function_index.end() ? nullptr : found->second;
+}
+
+void Module::remove_function(const Function* fn) {
+    SymbolId id = find_symbol(fn->name);
+    if (id != kNoSymbol) {
+        function_index.erase(id);
+    }
+    functions.erase(std::remove_if(functions.begin(), functions.end(),
+                                   [&](const std::unique_ptr<Function>& f) { return f.get() == fn; }),
+                    functions.end());
+}
+
+Function* Module::copy_function(const Function& fn) {
+    auto copy = std::make_unique<Function>(fn);
+    copy->rebind(this);
+    functions.push_back(std::move(copy));
+    Function* added = functions.back().get();
+    function_index[intern(added->name)] = added;
+    return added;
+}
+
+Function* Module::take_function(Module& from, const Function* fn) {
+    auto found = std::find_if(from.functions.begin(), from.functions.end(),
+                              [&](const std::unique_ptr<Function>& f) { return f.get() == fn; });
+    std::unique_ptr<Function> moved = std::move(*found);
+    from.functions.erase(found);
+    from.function_index.erase(from.find_symbol(moved->name));
+    moved->rebind(this);
+    functions.push_back(std::move(moved));
+    Function* added = functions.back().get();
+    function_index[intern(added->name)] = added;
+    return added;
+}
+
+void Module::rename(SymbolId id, const std::string& name) {
+    symbol_index.erase(symbols[id]);
+    symbols[id] = name;
+    symbol_index.emplace(name, id);
+    if (Function* fn = function_for(id)) {
+        fn->name = name;
+    }
+}
+
+const Global* Module::find_global(SymbolId symbol) const {
+    for (const Global& g : globals) {
+        if (g.symbol == symbol) {
+            return &g;
+        }
+    }
+    return nullptr;
+}
+
+SymbolId Module::add_global(const std::string& name, std::string bytes, bool constant) {
+    SymbolId id = intern(name);
+    globals.push_back({id, std::move(bytes), constant});
+    return id;
+}
+
+std::unique_ptr<Module> copy_module(const Module& module) {
+    auto copy = std::make_unique<Module>();
+    for (const Global& global : module.globals) {
+        copy->add_global(module.symbol_name(global.symbol), global.bytes, global.constant);
+    }
+    for (const auto& fn : module.functions) {
+        copy->copy_function(*fn);
+    }
+    return copy;
+}
+
+// ---------------------------------------------------------------------------
+// Printer
+// ---------------------------------------------------------------------------
+
+namespace {
+
+std::int64_t sign_extend(std::uint64_t bits, unsigned width) {
+    if (width >= 64 || width == 0) {
+        return static_cast<std::int64_t>(bits);
+    }
+    std::uint64_t sign = std::uint64_t{1} << (width - 1);
+    return static_cast<std::int64_t>((bits ^ sign) - sign);
+}
+
+std::string escape_bytes(const std::string& bytes) {
+    std::string out;
+    for (unsigned char c : bytes) {
+        if (c == '"' || c == '\\' || c < 0x20 || c >= 0x7f) {
+            char buf[8];
+            std::snprintf(buf, sizeof(buf), "\\%02x", c);
+            out.append(buf);
+        } else {
+            out.push_back(static_cast<char>(c));
+        }
+    }
+    return out;
+}
+
+std::string format_double(double value) {
+    char buf[64];
+    std::snprintf(buf, sizeof(buf), "%.17g", value);
+    std::string out = buf;
+    if (out.find_first_of(".eEn") == std::string::npos) {
+        out.append(".0");
+    }
+    return out;
+}
+
+class Printer {
+  public:
+    explicit Printer(const Function& fn) : fn(fn), numbers(fn.num_values(), kNoValue) {
+        std::uint32_t next = 0;
+        for (std::size_t i = 0; i < fn.num_args(); ++i) {
+            numbers[fn.arg(i)] = next++;
+        }
+        for (BlockId b : fn.block_order()) {
+            for (ValueId v = fn.block(b).first; v != kNoValue; v = fn.inst(v).next) {
+                if (fn.inst(v).type.kind != IRTypeKind::IR_VOID) {
+                    numbers[v] = next++;
+                }
+            }
+        }
+        block_numbers.assign(fn.num_blocks(), kNoBlock);
+        std::uint32_t b_next = 0;
+        for (BlockId b : fn.block_order()) {
+            block_numbers[b] = b_next++;
+        }
+    }
+
+    std::string print() {
+        std::string out;
+        out.append(fn.flags & FUNCTION_EXTERN ? "declare @" : "func @");
+        out.append(fn.name);
+        out.push_back('(');
+        for (std::size_t i = 0; i < fn.num_args(); ++i) {
+            if (i != 0) {
+                out.append(", ");
+            }
+            out.append(type_to_string(fn.inst(fn.arg(i)).type));
+            if (!(fn.flags & FUNCTION_EXTERN)) {
+                out.append(" %");
+                out.append(std::to_string(numbers[fn.arg(i)]));
+            }
+        }
+        out.append(") -> ");
+        out.append(type_to_string(fn.return_type));
+        if (fn.flags & FUNCTION_INLINE) {
+            out.append(" inline");
+        }
+        if (fn.flags & FUNCTION_NOINLINE) {
+            out.append(" noinline");
+        }
+        if (fn.flags & FUNCTION_INTERNAL) {
+            out.append(" internal");
+        }
+        if (fn.flags & FUNCTION_BENCH) {
+            out.append(" bench");
+        }
+        if (fn.flags & FUNCTION_EXTERN) {
+            out.push_back('\n');
+            return out;
+        }
+        out.append(" {\n");
+        for (BlockId b : fn.block_order()) {
+            out.append(block_name(b));
+            out.append(":\n");
+            for (ValueId v = fn.block(b).first; v != kNoValue; v = fn.inst(v).next) {
+                out.append("  ");
+                print_inst(v, out);
+                out.push_back('\n');
+            }
+        }
+        out.append("}\n");
+        return out;
+    }
+
+  private:
+    const Function& fn;
+    std::vector<std::uint32_t> numbers;
+    std::vector<std::uint32_t> block_numbers;
+
+    std::string block_name(BlockId b) const {
+        if (b == kNoBlock || b >= block_numbers.size() || block_numbers[b] == kNoBlock) {
+            return "<dead block>";
+        }
+        return "bb" + std::to_string(block_numbers[b]);
+    }
+
+    std::string value_name(ValueId v) const {
+        if (v == kNoValue) {
+            return "<null>";
+        }
+        const Inst& inst = fn.inst(v);
+        switch (inst.op) {
+            case Opcode::OP_CONST: {
+                std::string out = type_to_string(inst.type) + " ";
+                if (is_float(inst.type)) {
+                    return out + format_double(std::bit_cast<double>(inst.imm));
+                }
+                if (inst.type.kind == IRTypeKind::IR_PTR) {
+                    return out + (inst.imm == 0 ? "null" : std::to_string(inst.imm));
+                }
+                if (inst.type.kind == IRTypeKind::IR_I1) {
+                    return out + std::to_string(inst.imm & 1);
+                }
+                return out + std::to_string(sign_extend(inst.imm, type_bits(inst.type)));
+            }
+            case Opcode::OP_UNDEF:
+                return type_to_string(inst.type) + " undef";
+            case Opcode::OP_GLOBAL:
+                return "@" + fn.module->symbol_name(inst.aux);
+            default:
+                break;
+        }
+        if (numbers[v] == kNoValue) {
+            return "%<dead " + std::to_string(v) + ">";
+        }
+        return "%" + std::to_string(numbers[v]);
+    }
+
+    void print_inst(ValueId v, std::string& out) const {
+        const Inst& inst = fn.inst(v);
+        if (inst.type.kind != IRTypeKind::IR_VOID) {
+            out.append(value_name(v));
+            out.append(" = ");
+        }
+        out.append(opcode_name(inst.op));
+        switch (inst.op) {
+            case Opcode::OP_ICMP:
+            case Opcode::OP_FCMP:
+                out.push_back(' ');
+                out.append(predicate_name(static_cast<CmpPredicate>(inst.aux)));
+                break;
+            case Opcode::OP_ALLOCA:
+                out.push_back(' ');
+                out.append(std::to_string(inst.imm));
+                out.append(", align ");
+                out.append(std::to_string(inst.aux));
+                return;
+            case Opcode::OP_CALL:
+                out.push_back(' ');
+                out.append(type_to_string(inst.type));
+                out.append(" @");
+                out.append(fn.module->symbol_name(inst.aux));
+                out.push_back('(');
+                for (std::uint32_t i = 0; i < inst.num_operands; ++i) {
+                    if (i != 0) {
+                        out.append(", ");
+                    }
+                    out.append(value_name(fn.operand(v, i)));
+                }
+                out.push_back(')');
+                return;
+            case Opcode::OP_PHI:
+                out.push_back(' ');
+                out.append(type_to_string(inst.type));
+                for (std::uint32_t i = 0; i < inst.num_operands; ++i) {
+                    out.append(i == 0 ? " [" : ", [");
+                    out.append(value_name(fn.operand(v, i)));
+                    out.append(", ");
+                    out.append(block_name(fn.targets(v)[i]));
+                    out.push_back(']');
+                }
+                return;
+            case Opcode::OP_SWITCH:
+                out.push_back(' ');
+                out.append(value_name(fn.operand(v, 0)));
+                out.append(", ");
+                out.append(block_name(fn.targets(v)[0]));
+                for (std::uint32_t i = 1; i < inst.num_operands; ++i) {
+                    out.append(" [");
+                    out.append(value_name(fn.operand(v, i)));
+                    out.append(", ");
+                    out.append(block_name(fn.targets(v)[i]));
+                    out.push_back(']');
+                }
+                return;
+            default:
+                if (inst.type.kind != IRTypeKind::IR_VOID) {
+                    out.push_back(' ');
+                    out.append(type_to_string(inst.type));
+                }
+                break;
+        }
+        bool first = true;
+        for (std::uint32_t i = 0; i < inst.num_operands; ++i) {
+            out.append(first ? " " : ", ");
+            out.append(value_name(fn.operand(v, i)));
+            first = false;
+        }
+        for (BlockId target : fn.targets(v)) {
+            out.append(first ? " " : ", ");
+            out.append(block_name(target));
+            first = false;
+        }
+    }
+};
+
+}  // namespace
+
+std::string print_function(const Function& fn) {
+    return Printer(fn).print();
+}
+
+std::string print_module(const Module& module) {
+    std::string out;
+    for (const Global& g : module.globals) {
+        out.append(g.constant ? "global @" : "global mut @");
+        out.append(module.symbol_name(g.symbol));
+        out.append(" = \"");
+        out.append(escape_bytes(g.bytes));
+        out.append("\"\n");
+    }
+    for (std::size_t i = 0; i < module.functions.size(); ++i) {
+        if (i != 0 || !module.globals.empty()) {
+            out.push_back('\n');
+        }
+        out.append(print_function(*module.functions[i]));
+    }
+    return out;
+}
+
+// ---------------------------------------------------------------------------
+// Parser
+// ---------------------------------------------------------------------------
+
+namespace {
+
+enum class IRTok : std::uint8_t {
+    IDENT,     // keywords, opcodes, types and block labels
+    LOCAL,     // %name
+    GLOBAL,    // @name
+    NUMBER,
+    STRING,
+    PUNCT,     // ( ) { } [ ] , : = < > and ->
+    NEWLINE,
+    END,
+};
+
+struct IRToken {
+    IRTok kind = IRTok::END;
+    std::string text;
+    std::size_t line = 0;
+};
+
+std::vector<IRToken> tokenize(const std::string& text) {
+    std::vector<IRToken> out;
+    std::size_t line = 1;
+    std::size_t i = 0;
+    auto ident_char = [](char c) {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '.' || c == '$';
+    };
+    while (i < text.size()) {
+        char c = text[i];
+        if (c == '\n') {
+            out.push_back({IRTok::NEWLINE, "", line++});
+            ++i;
+        } else if (c == ' ' || c == '\t' || c == '\r') {
+            ++i;
+        } else if (c == ';') {
+            while (i < text.size() && text[i] != '\n') {
+                ++i;
+            }
+        } else if (c == '%' || c == '@') {
+            std::size_t start = ++i;
+            while (i < text.size() && ident_char(text[i])) {
+                ++i;
+            }
+            out.push_back({c == '%' ? IRTok::LOCAL : IRTok::GLOBAL, text.substr(start, i - start),
+                           line});
+        } else if (c == '"') {
+            std::string bytes;
+            ++i;
+            while (i < text.size() && text[i] != '"') {
+                if (text[i] == '\\' && i + 2 < text.size()) {
+                    bytes.push_back(static_cast<char>(std::strtol(text.substr(i + 1, 2).c_str(), nullptr, 16)));
+                    i += 3;
+                } else {
+                    bytes.push_back(text[i++]);
+                }
+            }
+            ++i;
+            out.push_back({IRTok::STRING, bytes, line});
+        } else if (c == '-' && i + 1 < text.size() && text[i + 1] == '>') {
+            out.push_back({IRTok::PUNCT, "->", line});
+            i += 2;
+        } else if (std::isdigit(static_cast<unsigned char>(c)) || c == '-' || c == '+') {
+            std::size_t start = i++;
+            while (i < text.size() && (std::isalnum(static_cast<unsigned char>(text[i])) ||
+                                       text[i] == '.' ||
+                                       ((text[i] == '-' || text[i] == '+') &&
+                                        (text[i - 1] == 'e' || text[i - 1] == 'E')))) {
+                ++i;
+            }
+            out.push_back({IRTok::NUMBER, text.substr(start, i - start), line});
+        } else if (ident_char(c)) {
+            std::size_t start = i;
+            while (i < text.size() && ident_char(text[i])) {
+                ++i;
+            }
+            out.push_back({IRTok::IDENT, text.substr(start, i - start), line});
+        } else {
+            out.push_back({IRTok::PUNCT, std::string(1, c), line});
+            ++i;
+        }
+    }
+    out.push_back({IRTok::END, "", line});
+    return out;
+}
+
+// A parsed operand before names are resolved: a local, a global or a typed constant.
+struct OperandRef {
+    enum Kind : std::uint8_t { LOCAL, GLOBAL, CONST, UNDEF } kind = LOCAL;
+    std::string name;
+    IRType type;
+    std::string literal;
+    std::size_t line = 0;
+};
+
+struct ParsedInst {
+    std::string result;
+    Opcode op = Opcode::OP_UNDEF;
+    IRType type;
+    std::uint32_t aux = 0;
+    std::uint64_t imm = 0;
+    std::string callee;
+    std::vector<OperandRef> operands;
+    std::vector<std::string> targets;
+    std::size_t line = 0;
+};
+
+class IRParser {
+  public:
+    IRParser(const std::string& text, frontend::Diagnostics* diagnostics)
+        : tokens(tokenize(text)), diagnostics(diagnostics) {}
+
+    std::unique_ptr<Module> parse() {
+        auto module = std::make_unique<Module>();
+        this->module = module.get();
+        skip_newlines();
+        while (!failed && peek().kind != IRTok::END) {
+            if (is_ident("global")) {
+                parse_global();
+            } else if (is_ident("func") || is_ident("declare")) {
+                parse_function();
+            } else {
+                error("expected 'func', 'declare' or 'global'");
+            }
+            skip_newlines();
+        }
+        if (failed) {
+            return nullptr;
+        }
+        return module;
+    }
+
+  private:
+    std::vector<IRToken> tokens;
+    std::size_t pos = 0;
+    frontend::Diagnostics* diagnostics = nullptr;
+    Module* module = nullptr;
+    bool failed = false;
+
+    const IRToken& peek(std::size_t ahead = 0) const {
+        return tokens[std::min(pos + ahead, tokens.size() - 1)];
+    }
+    const IRToken& advance() {
+        const IRToken& tok = tokens[pos];
+        if (pos + 1 < tokens.size()) {
+            ++pos;
+        }
+        return tok;
+    }
+    bool is_ident(const char* text) const {
+        return peek().kind == IRTok::IDENT && peek().text == text;
+    }
+    bool is_punct(const char* text) const {
+        return peek().kind == IRTok::PUNCT && peek().text == text;
+    }
+    void skip_newlines() {
+        while (peek().kind == IRTok::NEWLINE) {
+            advance();
+        }
+    }
+
+    void error(const std::string& msg, std::size_t line = 0) {
+        if (failed) {
+            return;
+        }
+        failed = true;
+        if (diagnostics != nullptr) {
+            diagnostics->report(frontend::Severity::Error, frontend::ErrorCode::E501_INVALID_IR, msg,
+                                "", 0, 0, line != 0 ? line : peek().line, 0);
+        }
+    }
+
+    bool expect_punct(const char* text) {
+        if (!is_punct(text)) {
+            error(std::string("expected '") + text + "'");
+            return false;
+        }
+        advance();
+        return true;
+    }
+
+    bool try_type(IRType& out) {
+        if (is_punct("<")) {
+            advance();
+            if (peek().kind != IRTok::NUMBER) {
+                error("expected lane count");
+                return false;
+            }
+            std::uint16_t lanes = static_cast<std::uint16_t>(std::strtoul(advance().text.c_str(), nullptr, 10));
+            if (!is_ident("x")) {
+                error("expected 'x' in vector type");
+                return false;
+            }
+            advance();
+            IRType elem;
+            if (!try_type(elem)) {
+                error("expected element type");
+                return false;
+            }
+            expect_punct(">");
+            out = IRType::vector(elem.kind, lanes);
+            return true;
+        }
+        if (peek().kind != IRTok::IDENT) {
+            return false;
+        }
+        static const std::pair<const char*, IRTypeKind> kTypes[] = {
+            {"void", IRTypeKind::IR_VOID}, {"i1", IRTypeKind::IR_I1},
+            {"i8", IRTypeKind::IR_I8},     {"i16", IRTypeKind::IR_I16},
+            {"i32", IRTypeKind::IR_I32},   {"i64", IRTypeKind::IR_I64},
+            {"i128", IRTypeKind::IR_I128}, {"f32", IRTypeKind::IR_F32},
+            {"f64", IRTypeKind::IR_F64},   {"ptr", IRTypeKind::IR_PTR},
+        };
+        for (const auto& [name, kind] : kTypes) {
+            if (peek().text == name) {
+                advance();
+                out = IRType::scalar(kind);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    IRType expect_type() {
+        IRType type;
+        if (!try_type(type)) {
+            error("expected type, found '" + peek().text + "'");
+        }
+        return type;
+    }
+
+    OperandRef parse_operand() {
+        OperandRef ref;
+        ref.line = peek().line;
+        if (peek().kind == IRTok::LOCAL) {
+            ref.kind = OperandRef::LOCAL;
+            ref.name = advance().text;
+            return ref;
+        }
+        if (peek().kind == IRTok::GLOBAL) {
+            ref.kind = OperandRef::GLOBAL;
+            ref.name = advance().text;
+            return ref;
+        }
+        ref.type = expect_type();
+        if (is_ident("undef")) {
+            advance();
+            ref.kind = OperandRef::UNDEF;
+            return ref;
+        }
+        if (is_ident("null") || is_ident("true") || is_ident("false") ||
+            peek().kind == IRTok::NUMBER) {
+            ref.kind = OperandRef::CONST;
+            ref.literal = advance().text;
+            return ref;
+        }
+        error("expected operand, found '" + peek().text + "'");
+        return ref;
+    }
+
+    std::string parse_label() {
+        if (peek().kind != IRTok::IDENT) {
+            error("expected block label");
+            return {};
+        }
+        return advance().text;
+    }
+
+    void parse_global() {
+        advance();
+        bool constant = true;
+        if (is_ident("mut")) {
+            advance();
+            constant = false;
+        }
+        if (peek().kind != IRTok::GLOBAL) {
+            error("expected global name");
+            return;
+        }
+        std::string name = advance().text;
+        expect_punct("=");
+        if (peek().kind != IRTok::STRING) {
+            error("expected string initializer");
+            return;
+        }
+        module->add_global(name, advance().text, constant);
+    }
+
+    static bool opcode_from_name(const std::string& name, Opcode& out) {
+        for (int i = static_cast<int>(Opcode::OP_ADD); i <= static_cast<int>(Opcode::OP_UNREACHABLE); ++i) {
+            if (name == opcode_name(static_cast<Opcode>(i))) {
+                out = static_cast<Opcode>(i);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static bool predicate_from_name(const std::string& name, std::uint32_t& out) {
+        for (int i = 0; i <= static_cast<int>(CmpPredicate::CMP_OGE); ++i) {
+            if (name == predicate_name(static_cast<CmpPredicate>(i))) {
+                out = static_cast<std::uint32_t>(i);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void parse_function() {
+        bool is_declare = advance().text == "declare";
+        if (peek().kind != IRTok::GLOBAL) {
+            error("expected function name");
+            return;
+        }
+        std::string name = advance().text;
+        expect_punct("(");
+        std::vector<IRType> params;
+        std::vector<std::string> param_names;
+        while (!failed && !is_punct(")")) {
+            params.push_back(expect_type());
+            param_names.emplace_back();
+            if (peek().kind == IRTok::LOCAL) {
+                param_names.back() = advance().text;
+            }
+            if (!is_punct(")")) {
+                expect_punct(",");
+            }
+        }
+        expect_punct(")");
+        expect_punct("->");
+        IRType ret = expect_type();
+        if (failed) {
+            return;
+        }
+        Function* fn = module->add_function(name, ret, params);
+        while (peek().kind == IRTok::IDENT) {
+            std::string attr = advance().text;
+            if (attr == "inline") {
+                fn->flags |= FUNCTION_INLINE;
+            } else if (attr == "noinline") {
+                fn->flags |= FUNCTION_NOINLINE;
+            } else if (attr == "internal") {
+                fn->flags |= FUNCTION_INTERNAL;
+            } else if (attr == "bench") {
+                fn->flags |= FUNCTION_BENCH;
+            } else {
+                error("unknown function attribute '" + attr + "'");
+                return;
+            }
+        }
+        if (is_declare) {
+            fn->flags |= FUNCTION_EXTERN;
+            return;
+        }
+        expect_punct("{");
+        skip_newlines();
+
+        std::vector<std::pair<std::string, std::vector<ParsedInst>>> blocks;
+        while (!failed && !is_punct("}")) {
+            if (peek().kind == IRTok::IDENT && peek(1).kind == IRTok::PUNCT && peek(1).text == ":") {
+                blocks.emplace_back(advance().text, std::vector<ParsedInst>{});
+                advance();
+            } else {
+                if (blocks.empty()) {
+                    error("instruction outside of a block");
+                    return;
+                }
+                blocks.back().second.push_back(parse_inst());
+            }
+            skip_newlines();
+        }
+        expect_punct("}");
+        if (!failed) {
+            build(*fn, param_names, blocks);
+        }
+    }
+
+    ParsedInst parse_inst() {
+        ParsedInst pi;
+        pi.line = peek().line;
+        if (peek().kind == IRTok::LOCAL) {
+            pi.result = advance().text;
+            expect_punct("=");
+        }
+        if (peek().kind != IRTok::IDENT || !opcode_from_name(peek().text, pi.op)) {
+            error("unknown instruction '" + peek().text + "'");
+            return pi;
+        }
+        advance();
+        switch (pi.op) {
+            case Opcode::OP_ICMP:
+            case Opcode::OP_FCMP:
+                if (peek().kind != IRTok::IDENT || !predicate_from_name(advance().text, pi.aux)) {
+                    error("expected comparison predicate");
+                }
+                pi.type = IRType::scalar(IRTypeKind::IR_I1);
+                parse_operand_list(pi);
+                return pi;
+            case Opcode::OP_ALLOCA:
+                pi.type = IRType::scalar(IRTypeKind::IR_PTR);
+                if (peek().kind != IRTok::NUMBER) {
+                    error("expected allocation size");
+                    return pi;
+                }
+                pi.imm = std::strtoull(advance().text.c_str(), nullptr, 10);
+                pi.aux = 1;
+                if (is_punct(",")) {
+                    advance();
+                    if (!is_ident("align")) {
+                        error("expected 'align'");
+                        return pi;
+                    }
+                    advance();
+                    pi.aux = static_cast<std::uint32_t>(std::strtoul(advance().text.c_str(), nullptr, 10));
+                }
+                return pi;
+            case Opcode::OP_CALL:
+                pi.type = expect_type();
+                if (peek().kind != IRTok::GLOBAL) {
+                    error("expected callee");
+                    return pi;
+                }
+                pi.callee = advance().text;
+                expect_punct("(");
+                while (!failed && !is_punct(")")) {
+                    pi.operands.push_back(parse_operand());
+                    if (!is_punct(")")) {
+                        expect_punct(",");
+                    }
+                }
+                expect_punct(")");
+                return pi;
+            case Opcode::OP_PHI:
+                pi.type = expect_type();
+                while (!failed && is_punct("[")) {
+                    advance();
+                    pi.operands.push_back(parse_operand());
+                    expect_punct(",");
+                    pi.targets.push_back(parse_label());
+                    expect_punct("]");
+                    if (is_punct(",")) {
+                        advance();
+                    }
+                }
+                return pi;
+            case Opcode::OP_SWITCH:
+                pi.operands.push_back(parse_operand());
+                expect_punct(",");
+                pi.targets.push_back(parse_label());
+                while (!failed && is_punct("[")) {
+                    advance();
+                    pi.operands.push_back(parse_operand());
+                    expect_punct(",");
+                    pi.targets.push_back(parse_label());
+                    expect_punct("]");
+                }
+                return pi;
+            case Opcode::OP_BR:
+            case Opcode::OP_COND_BR:
+            case Opcode::OP_RET:
+            case Opcode::OP_UNREACHABLE:
+            case Opcode::OP_STORE:
+            case Opcode::OP_DELETE:
+            case Opcode::OP_BOUNDS_CHECK:
+                pi.type = IRType::scalar(IRTypeKind::IR_VOID);
+                parse_operand_list(pi);
+                return pi;
+            default:
+                pi.type = expect_type();
+                parse_operand_list(pi);
+                return pi;
+        }
+    }
+
+    // Comma-separated operands followed by block labels, up to the end of line.
+    void parse_operand_list(ParsedInst& pi) {
+        bool first = true;
+        while (!failed && peek().kind != IRTok::NEWLINE && peek().kind != IRTok::END &&
+               !is_punct("}")) {
+            if (!first) {
+                expect_punct(",");
+            }
+            first = false;
+            // Block labels are the identifiers that do not start a type.
+            IRType probe;
+            std::size_t saved = pos;
+            bool typed = try_type(probe);
+            pos = saved;
+            if (peek().kind == IRTok::IDENT && !typed) {
+                pi.targets.push_back(advance().text);
+            } else {
+                pi.operands.push_back(parse_operand());
+            }
+        }
+    }
+
+    ValueId resolve_constant(Function& fn, const OperandRef& ref) {
+        if (ref.kind == OperandRef::UNDEF) {
+            return fn.undef(ref.type);
+        }
+        if (ref.literal == "null" || ref.literal == "false") {
+            return fn.constant(ref.type, 0);
+        }
+        if (ref.literal == "true") {
+            return fn.constant(ref.type, 1);
+        }
+        if (is_float(ref.type)) {
+            return fn.float_constant(ref.type, std::strtod(ref.literal.c_str(), nullptr));
+        }
+        if (!ref.literal.empty() && ref.literal[0] == '-') {
+            return fn.constant(ref.type,
+                               static_cast<std::uint64_t>(std::strtoll(ref.literal.c_str(), nullptr, 0)));
+        }
+        return fn.constant(ref.type, std::strtoull(ref.literal.c_str(), nullptr, 0));
+    }
+
+    void build(Function& fn, const std::vector<std::string>& param_names,
+               const std::vector<std::pair<std::string, std::vector<ParsedInst>>>& blocks) {
+        std::unordered_map<std::string, ValueId> values;
+        std::unordered_map<std::string, BlockId> labels;
+        for (std::size_t i = 0; i < param_names.size(); ++i) {
+            if (!param_names[i].empty()) {
+                values[param_names[i]] = fn.arg(i);
+            }
+        }
+        std::vector<BlockId> order;
+        for (const auto& [label, insts] : blocks) {
+            if (labels.count(label) != 0) {
+                error("block '" + label + "' defined twice");
+                return;
+            }
+            BlockId b = fn.add_block();
+            labels[label] = b;
+            order.push_back(b);
+        }
+
+        // Create every instruction first so operands may refer forward.
+        std::vector<ValueId> created;
+        const std::vector<ValueId> no_values;
+        for (std::size_t bi = 0; bi < blocks.size(); ++bi) {
+            for (const ParsedInst& pi : blocks[bi].second) {
+                std::vector<ValueId> placeholder(pi.operands.size(), kNoValue);
+                std::vector<BlockId> targets;
+                for (const std::string& label : pi.targets) {
+                    auto found = labels.find(label);
+                    if (found == labels.end()) {
+                        error("unknown block '" + label + "'", pi.line);
+                        return;
+                    }
+                    targets.push_back(found->second);
+                }
+                ValueId v = fn.append(order[bi], pi.op, pi.type, placeholder, targets);
+                fn.inst(v).aux = pi.aux;
+                fn.inst(v).imm = pi.imm;
+                if (pi.op == Opcode::OP_CALL) {
+                    fn.inst(v).aux = module->intern(pi.callee);
+                }
+                if (!pi.result.empty()) {
+                    if (!values.emplace(pi.result, v).second) {
+                        error("value '%" + pi.result + "' defined twice", pi.line);
+                        return;
+                    }
+                }
+                created.push_back(v);
+            }
+        }
+
+        std::size_t index = 0;
+        for (const auto& [label, insts] : blocks) {
+            for (const ParsedInst& pi : insts) {
+                ValueId v = created[index++];
+                for (std::size_t i = 0; i < pi.operands.size(); ++i) {
+                    const OperandRef& ref = pi.operands[i];
+                    ValueId value = kNoValue;
+                    if (ref.kind == OperandRef::LOCAL) {
+                        auto found = values.find(ref.name);
+                        if (found == values.end()) {
+                            error("undefined value '%" + ref.name + "'", ref.line);
+                            return;
+                        }
+                        value = found->second;
+                    } else if (ref.kind == OperandRef::GLOBAL) {
+                        value = fn.global(module->intern(ref.name));
+                    } else {
+                        value = resolve_constant(fn, ref);
+                    }
+                    fn.set_operand(v, static_cast<std::uint32_t>(i), value);
+                }
+                if ((pi.op == Opcode::OP_ICMP || pi.op == Opcode::OP_FCMP) && !pi.operands.empty()) {
+                    std::uint16_t lanes = fn.inst(fn.operand(v, 0)).type.lanes;
+                    fn.inst(v).type = IRType::vector(IRTypeKind::IR_I1, lanes);
+                }
+            }
+        }
+        fn.set_block_order(order);
+    }
+};
+
+}  // namespace
+
+std::unique_ptr<Module> parse_module(const std::string& text, frontend::Diagnostics* diagnostics) {
+    return IRParser(text, diagnostics).parse();
+}
+
+// ---------------------------------------------------------------------------
+// Verifier
+// ---------------------------------------------------------------------------
+
+bool verify_function(const Function& fn, std::string* error) {
+    if (fn.flags & FUNCTION_EXTERN) {
+        return true;
+    }
+    auto fail = [&](const std::string& msg) {
+        if (error != nullptr) {
+            *error = "@" + fn.name + ": " + msg;
+        }
+        return false;
+    };
+    if (fn.block_order().empty()) {
+        return fail("function has no blocks");
+    }
+    std::vector<std::vector<BlockId>> preds(fn.num_blocks());
+    std::vector<bool> live(fn.num_blocks(), false);
+    for (BlockId b : fn.block_order()) {
+        live[b] = true;
+    }
+    for (BlockId b : fn.block_order()) {
+        for (BlockId s : fn.successors(b)) {
+            if (s >= fn.num_blocks() || !live[s]) {
+                return fail("block branches to a removed block");
+            }
+            preds[s].push_back(b);
+        }
+    }
+    for (BlockId b : fn.block_order()) {
+        const Block& block = fn.block(b);
+        if (block.first == kNoValue) {
+            return fail("empty block");
+        }
+        bool phis_done = false;
+        for (ValueId v = block.first; v != kNoValue; v = fn.inst(v).next) {
+            const Inst& inst = fn.inst(v);
+            std::string where = std::string(opcode_name(inst.op)) + " (value " + std::to_string(v) + ")";
+            if (inst.block != b) {
+                return fail(where + " has a stale block link");
+            }
+            if (is_terminator(inst.op) != (v == block.last)) {
+                return fail(where + ": a block must end in exactly one terminator");
+            }
+            if (inst.op == Opcode::OP_PHI) {
+                if (phis_done) {
+                    return fail(where + ": phi after a non-phi instruction");
+                }
+                if (inst.num_operands != inst.num_targets ||
+                    inst.num_operands != preds[b].size()) {
+                    return fail(where + ": incoming count does not match predecessors");
+                }
+                for (BlockId from : fn.targets(v)) {
+                    if (std::find(preds[b].begin(), preds[b].end(), from) == preds[b].end()) {
+                        return fail(where + ": incoming block is not a predecessor");
+                    }
+                }
+            } else {
+                phis_done = true;
+            }
+            for (std::uint32_t i = 0; i < inst.num_operands; ++i) {
+                ValueId op = fn.operand(v, i);
+                if (op == kNoValue || op >= fn.num_values()) {
+                    return fail(where + ": missing operand");
+                }
+                const Inst& def = fn.inst(op);
+                bool leaf = def.op == Opcode::OP_ARG || def.op == Opcode::OP_CONST ||
+                            def.op == Opcode::OP_UNDEF || def.op == Opcode::OP_GLOBAL;
+                if (!leaf && def.block == kNoBlock) {
+                    return fail(where + ": operand refers to an erased instruction");
+                }
+            }
+            if (inst.op == Opcode::OP_RET) {
+                bool has_value = inst.num_operands == 1;
+                if (has_value != (fn.return_type.kind != IRTypeKind::IR_VOID)) {
+                    return fail(where + ": return does not match the function type");
+                }
+            }
+            if (inst.op == Opcode::OP_CALL && fn.module != nullptr) {
+                const Function* callee = fn.module->function_for(inst.aux);
+                if (callee != nullptr && callee->num_args() != inst.num_operands) {
+                    return fail(where + ": wrong number of arguments to @" + callee->name);
+                }
+            }
+        }
+    }
+    return true;
+}
+
+bool verify_module(const Module& module, std::string* error) {
+    for (const auto& fn : module.functions) {
+        if (!verify_function(*fn, error)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace pallas::middle
@@ -0,0 +1,401 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "frontend/diagnostics.h"
+
+namespace pallas::middle {
+
+// Dense per-function indices. Values (arguments, constants and instructions)
+// and blocks are numbered from 0 so analyses can keep side tables in plain
+// vectors indexed by ID.
+using ValueId = std::uint32_t;
+using BlockId = std::uint32_t;
+using UseId = std::uint32_t;
+using SymbolId = std::uint32_t;
+
+constexpr ValueId kNoValue = std::numeric_limits<ValueId>::max();
+constexpr BlockId kNoBlock = std::numeric_limits<BlockId>::max();
+constexpr UseId kNoUse = std::numeric_limits<UseId>::max();
+constexpr SymbolId kNoSymbol = std::numeric_limits<SymbolId>::max();
+
+enum class IRTypeKind : std::uint8_t {
+    IR_VOID,
+    IR_I1,
+    IR_I8,
+    IR_I16,
+    IR_I32,
+    IR_I64,
+    IR_I128,
+    IR_F32,
+    IR_F64,
+    IR_PTR,
+};
+
+// A scalar type or a fixed-width vector of scalars (lanes > 1). Aggregates
+// live in memory and are addressed with byte offsets from the layout engine.
+struct IRType {
+    IRTypeKind kind = IRTypeKind::IR_VOID;
+    std::uint16_t lanes = 1;
+
+    static IRType scalar(IRTypeKind kind) { return {kind, 1}; }
+    static IRType vector(IRTypeKind kind, std::uint16_t lanes) { return {kind, lanes}; }
+    IRType element() const { return {kind, 1}; }
+    bool is_vector() const { return lanes > 1; }
+    bool operator==(const IRType&) const = default;
+};
+
+bool is_int(IRType type);
+bool is_float(IRType type);
+unsigned type_bits(IRType type);
+// Size in bytes of one value of the type (vectors: all lanes).
+std::uint64_t type_size(IRType type);
+std::string type_to_string(IRType type);
+
+enum class Opcode : std::uint8_t {
+    // Leaves
+    OP_ARG,
+    OP_CONST,
+    OP_UNDEF,
+    OP_GLOBAL,  // address of a module global or function, symbol in aux
+    // Integer arithmetic
+    OP_ADD,
+    OP_SUB,
+    OP_MUL,
+    OP_SDIV,
+    OP_UDIV,
+    OP_SREM,
+    OP_UREM,
+    OP_AND,
+    OP_OR,
+    OP_XOR,
+    OP_SHL,
+    OP_LSHR,
+    OP_ASHR,
+    // Floating point
+    OP_FADD,
+    OP_FSUB,
+    OP_FMUL,
+    OP_FDIV,
+    OP_FREM,
+    OP_FNEG,
+    // Comparisons, predicate in aux
+    OP_ICMP,
+    OP_FCMP,
+    // Conversions
+    OP_TRUNC,
+    OP_ZEXT,
+    OP_SEXT,
+    OP_FPTOSI,
+    OP_FPTOUI,
+    OP_SITOFP,
+    OP_UITOFP,
+    OP_FPEXT,
+    OP_FPTRUNC,
+    OP_PTRTOINT,
+    OP_INTTOPTR,
+    OP_SELECT,
+    // Vectors. Element-wise opcodes above also apply lane by lane to vectors.
+    OP_SPLAT,    // operand copied into every lane
+    OP_EXTRACT,  // operands: vector, lane index
+    OP_INSERT,   // operands: vector, element, lane index
+    // Memory
+    OP_ALLOCA,  // imm = size in bytes, aux = alignment
+    OP_LOAD,
+    OP_STORE,
+    OP_PTRADD,  // byte offset from a pointer
+    OP_NEW,     // heap allocation, operand = size in bytes, aux = source line or 0
+    OP_DELETE,
+    OP_BOUNDS_CHECK,  // stops the program unless operand 0 < operand 1 (unsigned)
+    OP_CALL,  // callee symbol in aux
+    OP_PHI,
+    // Terminators
+    OP_BR,
+    OP_COND_BR,
+    OP_SWITCH,  // operands: value, case constants; targets: default, cases
+    OP_RET,
+    OP_UNREACHABLE,
+};
+
+enum class CmpPredicate : std::uint8_t {
+    CMP_EQ,
+    CMP_NE,
+    CMP_SLT,
+    CMP_SLE,
+    CMP_SGT,
+    CMP_SGE,
+    CMP_ULT,
+    CMP_ULE,
+    CMP_UGT,
+    CMP_UGE,
+    // Ordered float comparisons
+    CMP_OEQ,
+    CMP_ONE,
+    CMP_OLT,
+    CMP_OLE,
+    CMP_OGT,
+    CMP_OGE,
+};
+
+const char* opcode_name(Opcode op);
+const char* predicate_name(CmpPredicate pred);
+bool is_terminator(Opcode op);
+// True when removing an unused instance cannot change program behavior.
+bool has_side_effects(Opcode op);
+
+// One operand slot. Operands of an instruction occupy a contiguous range of
+// the function's use pool; all uses of a value form a doubly-linked list
+// threaded through the same pool.
+struct Use {
+    ValueId value = kNoValue;
+    ValueId user = kNoValue;
+    UseId prev = kNoUse;
+    UseId next = kNoUse;
+};
+
+struct Inst {
+    Opcode op = Opcode::OP_UNDEF;
+    IRType type;
+    std::uint8_t flags = 0;
+    BlockId block = kNoBlock;  // kNoBlock for arguments, constants and erased instructions
+    ValueId prev = kNoValue;   // neighbours within the block
+    ValueId next = kNoValue;
+    UseId first_operand = kNoUse;
+    std::uint32_t num_operands = 0;
+    std::uint32_t operand_capacity = 0;
+    std::uint32_t first_target = 0;  // successor / incoming blocks in the target pool
+    std::uint32_t num_targets = 0;
+    std::uint32_t target_capacity = 0;
+    UseId first_use = kNoUse;
+    std::uint32_t aux = 0;   // predicate, callee symbol, argument index, alignment or line
+    std::uint64_t imm = 0;   // constant bits, alloca size, or source line of runtime calls
+};
+
+struct Block {
+    ValueId first = kNoValue;
+    ValueId last = kNoValue;
+    bool erased = false;
+};
+
+constexpr std::uint64_t kNoCount = std::numeric_limits<std::uint64_t>::max();
+
+// Execution counts from a profile (palc -fprofile-use); empty without one.
+// Passes keep them approximately current: blocks added after the profile was
+// applied have no count, and edge weights go away with their terminator.
+struct FunctionProfile {
+    std::uint64_t entry_count = 0;
+    std::vector<std::uint64_t> block_counts;  // by BlockId
+    // Per conditional branch or switch: the count of each edge, in target order.
+    std::unordered_map<ValueId, std::vector<std::uint64_t>> branch_weights;
+
+    bool empty() const { return block_counts.empty(); }
+    // kNoCount when the block is not covered by the profile.
+    std::uint64_t block_count(BlockId b) const {
+        return b < block_counts.size() ? block_counts[b] : kNoCount;
+    }
+    void set_block_count(BlockId b, std::uint64_t count);
+};
+
+enum FunctionFlags : std::uint32_t {
+    FUNCTION_EXTERN = 1u << 0,  // declaration only
+    FUNCTION_INLINE = 1u << 1,
+    FUNCTION_NOINLINE = 1u << 2,
+    FUNCTION_INTERNAL = 1u << 3,  // not visible outside the program (see link.h)
+    FUNCTION_BENCH = 1u << 4,     // @bench: measured by palc bench (see backend/bench.h)
+};
+
+class Module;
+
+// A function owns all of its IR in a handful of pools (instructions, uses,
+// block targets and blocks). Nothing is allocated per instruction, scans walk
+// contiguous memory, and destroying the function frees its IR at once.
+class Function {
+  public:
+    Function(Module* module, std::string name, IRType return_type,
+             const std::vector<IRType>& param_types);
+
+    Module* module = nullptr;
+    std::string name;
+    IRType return_type;
+    std::uint32_t flags = 0;
+    FunctionProfile profile;
+
+    // Value pool
+    std::size_t num_values() const { return insts.size(); }
+    Inst& inst(ValueId v) { return insts[v]; }
+    const Inst& inst(ValueId v) const { return insts[v]; }
+    std::size_t num_args() const { return args.size(); }
+    ValueId arg(std::size_t i) const { return args[i]; }
+    // A constant of a vector type holds the same bits in every lane.
+    ValueId constant(IRType type, std::uint64_t bits);
+    ValueId float_constant(IRType type, double value);
+    ValueId undef(IRType type);
+    ValueId global(SymbolId symbol);
+
+    // Operands and uses
+    ValueId operand(ValueId v, std::uint32_t i) const { return uses[insts[v].first_operand + i].value; }
+    std::uint32_t num_operands(ValueId v) const { return insts[v].num_operands; }
+    void set_operand(ValueId v, std::uint32_t i, ValueId value);
+    const Use& use(UseId u) const { return uses[u]; }
+    bool has_uses(ValueId v) const { return insts[v].first_use != kNoUse; }
+    std::size_t count_uses(ValueId v) const;
+    std::vector<ValueId> users(ValueId v) const;
+    void replace_all_uses(ValueId from, ValueId to);
+
+    // Block targets (successors of terminators, incoming blocks of phis)
+    std::span<BlockId> targets(ValueId v) {
+        return {target_pool.data() + insts[v].first_target, insts[v].num_targets};
+    }
+    std::span<const BlockId> targets(ValueId v) const {
+        return {target_pool.data() + insts[v].first_target, insts[v].num_targets};
+    }
+
+    // Blocks
+    BlockId add_block();
+    std::size_t num_blocks() const { return blocks.size(); }
+    const Block& block(BlockId b) const { return blocks[b]; }
+    BlockId entry() const { return layout.empty() ? kNoBlock : layout.front(); }
+    // Live blocks in emission order; the first one is the entry block.
+    const std::vector<BlockId>& block_order() const { return layout; }
+    void set_block_order(std::vector<BlockId> order) { layout = std::move(order); }
+    void erase_block(BlockId b);
+    ValueId terminator(BlockId b) const;
+    std::span<const BlockId> successors(BlockId b) const;
+    std::vector<ValueId> block_insts(BlockId b) const;
+
+    // Instruction creation. `append` adds at the end of the block, `insert_before`
+    // in front of an existing instruction.
+    ValueId append(BlockId b, Opcode op, IRType type, std::span<const ValueId> operands = {},
+                   std::span<const BlockId> targets = {});
+    ValueId insert_before(ValueId pos, Opcode op, IRType type,
+                          std::span<const ValueId> operands = {},
+                          std::span<const BlockId> targets = {});
+    // Unlinks the instruction from its block, moves it before `pos`.
+    void move_before(ValueId v, ValueId pos);
+    void move_to_end(ValueId v, BlockId b);
+    // Removes the instruction from its block and drops its operands. The ID stays
+    // allocated (and dead) so side tables remain valid.
+    void erase(ValueId v);
+
+    // Phi helpers: operand i flows in from target block i.
+    void add_incoming(ValueId phi, ValueId value, BlockId from);
+    void remove_incoming(ValueId phi, std::uint32_t index);
+    void set_target(ValueId v, std::uint32_t i, BlockId b) { target_pool[insts[v].first_target + i] = b; }
+    // Drops one incoming entry for `pred` from every phi of `b` (the edge pred -> b
+    // was removed), or renames `pred` to `replacement` (the edge was redirected).
+    void remove_predecessor(BlockId b, BlockId pred);
+    void replace_predecessor(BlockId b, BlockId pred, BlockId replacement);
+    // Drops, in one pass over each phi of `b`, every incoming entry from a block
+    // not marked in `live` (indexed by block).
+    void remove_dead_predecessors(BlockId b, const std::vector<bool>& live);
+
+    // Re-interns the symbols that calls and global addresses name in `into`,
+    // which becomes the function's module. Used to move or copy a function
+    // between modules; the caller adds it to `into`.
+    void rebind(Module* into);
+
+    // Number of instructions currently placed in blocks.
+    std::size_t instruction_count() const;
+    // Approximate bytes held by the pools.
+    std::size_t memory_bytes() const;
+
+  private:
+    std::vector<Inst> insts;
+    std::vector<Use> uses;
+    std::vector<BlockId> target_pool;
+    std::vector<Block> blocks;
+    std::vector<BlockId> layout;
+    std::vector<ValueId> args;
+    struct ConstKey {
+        IRType type;
+        Opcode op;
+        std::uint64_t bits;
+        bool operator==(const ConstKey&) const = default;
+    };
+    struct ConstKeyHash {
+        std::size_t operator()(const ConstKey& k) const {
+            return std::hash<std::uint64_t>()(k.bits * 31 + (static_cast<std::uint64_t>(k.type.kind) << 20) +
+                                              (static_cast<std::uint64_t>(k.type.lanes) << 4) +
+                                              static_cast<std::uint64_t>(k.op));
+        }
+    };
+    std::unordered_map<ConstKey, ValueId, ConstKeyHash> constant_index;
+    std::unordered_map<SymbolId, ValueId> global_index;
+
+    ValueId new_value(Opcode op, IRType type);
+    void link_use(UseId u);
+    void unlink_use(UseId u);
+    void allocate_operands(ValueId v, std::span<const ValueId> operands, std::uint32_t capacity);
+    void allocate_targets(ValueId v, std::span<const BlockId> targets, std::uint32_t capacity);
+    void link_into_block(ValueId v, BlockId b, ValueId before);
+    void unlink_from_block(ValueId v);
+};
+
+struct Global {
+    SymbolId symbol = kNoSymbol;
+    std::string bytes;  // initial contents
+    bool constant = true;
+};
+
+class Module {
+  public:
+    std::vector<std::unique_ptr<Function>> functions;
+    std::vector<Global> globals;
+
+    SymbolId intern(const std::string& name);
+    const std::string& symbol_name(SymbolId id) const { return symbols[id]; }
+    SymbolId find_symbol(const std::string& name) const;
+    std::size_t num_symbols() const { return symbols.size(); }
+
+    Function* add_function(const std::string& name, IRType return_type,
+                           const std::vector<IRType>& param_types);
+    Function* find_function(const std::string& name) const;
+    Function* function_for(SymbolId symbol) const;
+    void remove_function(const Function* fn);
+    // Adds a copy of `fn`, a function of another module, under the same name.
+    Function* copy_function(const Function& fn);
+    // Moves `fn` out of `from` into this module.
+    Function* take_function(Module& from, const Function* fn);
+    // Gives a symbol, and the function it names, a name not used yet.
+    void rename(SymbolId id, const std::string& name);
+    const Global* find_global(SymbolId symbol) const;
+    SymbolId add_global(const std::string& name, std::string bytes, bool constant = true);
+
+  private:
+    std::vector<std::string> symbols;
+    std::unordered_map<std::string, SymbolId> symbol_index;
+    std::unordered_map<SymbolId, Function*> function_index;
+};
+
+// A copy of `module` that shares nothing with it.
+std::unique_ptr<Module> copy_module(const Module& module);
+
+// Textual form, one instruction per line:
+//
+//   func @add(i32 %0, i32 %1) -> i32 {
+//   bb0:
+//     %2 = add i32 %0, i32 1
+//     %3 = icmp slt %2, %1
+//     condbr %3, bb1, bb2
+//   ...
+//   }
+//
+// Constant operands are written with their type (`i32 7`). The printer
+// renumbers values and blocks densely in block order so output is stable; the
+// parser accepts any %name / block label.
+std::string print_function(const Function& fn);
+std::string print_module(const Module& module);
+std::unique_ptr<Module> parse_module(const std::string& text, frontend::Diagnostics* diagnostics);
+
+// Structural checks: every block ends in exactly one terminator, phis lead
+// their block and match the predecessor count, operands are live values.
+bool verify_function(const Function& fn, std::string* error);
+bool verify_module(const Module& module, std::string* error);
+
+}  // namespace pallas::middle
@@ -0,0 +1,562 @@
+#include "layout.h"
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <utility>
+#include "runtime/arena.h"
+#include "support/trace.h"
+
+namespace pallas::middle {
+
+using frontend::Attribute;
+using frontend::ErrorCode;
+using frontend::SourceLocation;
+using frontend::StructDeclAST;
+using frontend::Type;
+using frontend::TypeKind;
+
+namespace {
+
+std::uint64_t round_up(std::uint64_t value, std::uint64_t align) {
+    return (value + align - 1) / align * align;
+}
+
+bool is_power_of_two(std::uint64_t v) {
+    return v != 0 && (v & (v - 1)) == 0;
+}
+
+using Bindings = std::unordered_map<std::string, const Type*>;
+
+// Replaces generic parameters inside type arguments, e.g. Optional<T> with
+// T bound to i32 becomes Optional<i32>.
+std::shared_ptr<Type> substitute(const Type& type, const Bindings& bindings) {
+    if (type.kind == TypeKind::TYPE_UNKNOWN && type.args.empty()) {
+        auto bound = bindings.find(type.name);
+        if (bound != bindings.end()) {
+            return std::make_shared<Type>(*bound->second);
+        }
+    }
+    auto out = std::make_shared<Type>(type);
+    if (type.element) {
+        out->element = substitute(*type.element, bindings);
+    }
+    for (auto& arg : out->args) {
+        arg = substitute(*arg, bindings);
+    }
+    return out;
+}
+
+// Orders hot fields first and cold fields last (sorting each group by decreasing
+// alignment when reordering) and assigns offsets. Returns the end of the last field.
+std::uint64_t place_fields(std::vector<FieldLayout>& fields, std::uint64_t struct_align,
+                           bool reorder) {
+    auto group = [](const FieldLayout& f) {
+        return f.hot ? 0 : (f.cold ? 2 : 1);
+    };
+    std::stable_sort(fields.begin(), fields.end(),
+                     [&](const FieldLayout& a, const FieldLayout& b) {
+                         if (group(a) != group(b)) {
+                             return group(a) < group(b);
+                         }
+                         return reorder && a.align > b.align;
+                     });
+
+    std::uint64_t offset = 0;
+    bool seen_non_cold = false;
+    for (FieldLayout& f : fields) {
+        std::uint64_t start = round_up(offset, f.align);
+        // Keep cold data off the cache lines that hold the hot fields.
+        if (f.cold && seen_non_cold && struct_align >= kCacheLineSize) {
+            start = round_up(start, kCacheLineSize);
+            seen_non_cold = false;
+        }
+        if (!f.cold) {
+            seen_non_cold = true;
+        }
+        f.padding_before = start - offset;
+        f.offset = start;
+        offset = start + f.size;
+    }
+    return offset;
+}
+
+}  // namespace
+
+LayoutEngine::LayoutEngine(const frontend::ModuleAST& module, frontend::Diagnostics* diagnostics,
+                           LayoutOptions options)
+    : module(module), diagnostics(diagnostics), options(options) {
+    for (const auto& decl : module.decls) {
+        if (decl->kind == frontend::NodeType::NODE_STRUCT) {
+            const auto* s = static_cast<const StructDeclAST*>(decl.get());
+            structs.emplace(s->name, s);
+        } else if (decl->kind == frontend::NodeType::NODE_TYPE_ALIAS) {
+            const auto* a = static_cast<const frontend::TypeAliasAST*>(decl.get());
+            aliases.emplace(a->name, a);
+        }
+    }
+}
+
+void LayoutEngine::report_error(ErrorCode code, const std::string& msg, SourceLocation loc) {
+    if (diagnostics != nullptr) {
+        diagnostics->report(frontend::Severity::Error, code, msg, "", loc.offset, 0, loc.line,
+                            loc.column);
+    }
+}
+
+std::uint64_t LayoutEngine::attribute_alignment(const std::vector<Attribute>& attributes,
+                                                SourceLocation loc) {
+    std::uint64_t align = 1;
+    if (frontend::find_attribute(attributes, "cache_aligned") != nullptr) {
+        align = kCacheLineSize;
+    }
+    const Attribute* attr = frontend::find_attribute(attributes, "align");
+    if (attr == nullptr) {
+        return align;
+    }
+    if (attr->args.size() != 1 || attr->args[0]->kind != frontend::ExprKind::EXPR_NUMBER) {
+        report_error(ErrorCode::E403_INVALID_ATTRIBUTE, "@align expects one integer literal",
+                     attr->loc);
+        return align;
+    }
+    const auto& num = static_cast<const frontend::NumberExprAST&>(*attr->args[0]);
+    std::uint64_t value = num.is_float ? 0 : std::strtoull(num.text.c_str(), nullptr, 0);
+    if (!is_power_of_two(value)) {
+        report_error(ErrorCode::E403_INVALID_ATTRIBUTE,
+                     "@align(" + num.text + ") is not a power of two", attr->loc);
+        return align;
+    }
+    (void)loc;
+    return std::max(align, value);
+}
+
+LayoutEngine::SizeAlign LayoutEngine::measure(const Type& type, const Bindings& bindings,
+                                              SourceLocation loc) {
+    switch (type.kind) {
+        case TypeKind::TYPE_VOID:
+            return {0, 1};
+        case TypeKind::TYPE_BOOL:
+        case TypeKind::TYPE_I8:
+        case TypeKind::TYPE_U8:
+        case TypeKind::TYPE_CHAR:
+            return {1, 1};
+        case TypeKind::TYPE_I16:
+        case TypeKind::TYPE_U16:
+            return {2, 2};
+        case TypeKind::TYPE_I32:
+        case TypeKind::TYPE_U32:
+        case TypeKind::TYPE_F32:
+            return {4, 4};
+        case TypeKind::TYPE_I64:
+        case TypeKind::TYPE_U64:
+        case TypeKind::TYPE_F64:
+            return {8, 8};
+        case TypeKind::TYPE_I128:
+        case TypeKind::TYPE_U128:
+            return {16, 16};
+        case TypeKind::TYPE_STRING:
+            // Runtime string: pointer, length and capacity (or inline bytes).
+            return {24, 8};
+        case TypeKind::TYPE_POINTER:
+        case TypeKind::TYPE_REFERENCE:
+        case TypeKind::TYPE_FUNCTION:
+            return {8, 8};
+        case TypeKind::TYPE_ARRAY: {
+            if (const SoaLayout* soa = soa_layout_of(type)) {
+                return {soa->size, soa->align};
+            }
+            SizeAlign elem = measure(*type.element, bindings, loc);
+            return {type.size_known ? elem.size * type.array_size : 0, elem.align};
+        }
+        case TypeKind::TYPE_STRUCT:
+        case TypeKind::TYPE_CLASS:
+        case TypeKind::TYPE_UNKNOWN:
+        default:
+            break;
+    }
+
+    if (type.args.empty()) {
+        auto bound = bindings.find(type.name);
+        if (bound != bindings.end()) {
+            return measure(*bound->second, {}, loc);
+        }
+    }
+    auto alias = aliases.find(type.name);
+    if (alias != aliases.end()) {
+        return measure(*alias->second->aliased, bindings, loc);
+    }
+    if (type.name == "Vec") {
+        // Runtime Vec<T>: data pointer, length and capacity.
+        return {24, 8};
+    }
+    if (type.name == "Arena") {
+        // Runtime arena header: cursor, limit, chunk list and finalizers.
+        return {sizeof(PallasArena), alignof(PallasArena)};
+    }
+    auto found = structs.find(type.name);
+    if (found == structs.end()) {
+        report_error(ErrorCode::E401_UNKNOWN_TYPE, "unknown type '" + type_to_string(type) + "'",
+                     loc);
+        return {0, 1};
+    }
+    std::vector<std::shared_ptr<Type>> args;
+    args.reserve(type.args.size());
+    for (const auto& arg : type.args) {
+        args.push_back(substitute(*arg, bindings));
+    }
+    const TypeLayout* layout = compute(*found->second, args, loc);
+    if (layout == nullptr) {
+        return {0, 1};
+    }
+    return {layout->size, layout->align};
+}
+
+const TypeLayout* LayoutEngine::compute(const StructDeclAST& decl,
+                                        const std::vector<std::shared_ptr<Type>>& args,
+                                        SourceLocation loc) {
+    std::string key = decl.name;
+    if (!decl.type_params.empty()) {
+        key.push_back('<');
+        for (std::size_t i = 0; i < decl.type_params.size(); ++i) {
+            if (i != 0) {
+                key.append(", ");
+            }
+            const Type* arg = i < args.size() ? args[i].get() : decl.type_params[i].default_type.get();
+            if (arg == nullptr) {
+                report_error(ErrorCode::E401_UNKNOWN_TYPE,
+                             "missing type argument '" + decl.type_params[i].name + "' for '" +
+                                 decl.name + "'",
+                             loc);
+                return nullptr;
+            }
+            key.append(type_to_string(*arg));
+        }
+        key.push_back('>');
+    }
+
+    auto existing = layouts.find(key);
+    if (existing != layouts.end()) {
+        return &existing->second;
+    }
+    if (failed.count(key) != 0) {
+        return nullptr;
+    }
+    if (in_progress.count(key) != 0) {
+        report_error(ErrorCode::E402_RECURSIVE_TYPE,
+                     "'" + key + "' contains itself by value; use a pointer instead", decl.loc);
+        failed.insert(key);
+        return nullptr;
+    }
+    in_progress.insert(key);
+
+    Bindings bindings;
+    for (std::size_t i = 0; i < decl.type_params.size(); ++i) {
+        bindings[decl.type_params[i].name] =
+            i < args.size() ? args[i].get() : decl.type_params[i].default_type.get();
+    }
+
+    TypeLayout layout;
+    layout.name = key;
+    std::uint64_t struct_align = attribute_alignment(decl.attributes, decl.loc);
+    std::vector<FieldLayout> fields;
+    fields.reserve(decl.fields.size());
+    for (std::size_t i = 0; i < decl.fields.size(); ++i) {
+        const frontend::FieldDecl& field = decl.fields[i];
+        SizeAlign sa = measure(*field.type, bindings, field.loc);
+        FieldLayout f;
+        f.name = field.name;
+        f.type_name = type_to_string(*substitute(*field.type, bindings));
+        f.decl_index = i;
+        f.size = sa.size;
+        f.align = std::max(sa.align, attribute_alignment(field.attributes, field.loc));
+        f.hot = frontend::find_attribute(field.attributes, "hot") != nullptr;
+        f.cold = frontend::find_attribute(field.attributes, "cold") != nullptr;
+        if (f.hot && f.cold) {
+            report_error(ErrorCode::E403_INVALID_ATTRIBUTE,
+                         "field '" + field.name + "' cannot be both @hot and @cold", field.loc);
+            f.cold = false;
+        }
+        struct_align = std::max(struct_align, f.align);
+        fields.push_back(std::move(f));
+    }
+    in_progress.erase(key);
+    if (failed.count(key) != 0) {
+        return nullptr;
+    }
+
+    bool reorder = options.reorder_all || frontend::find_attribute(decl.attributes, "reorder");
+    std::uint64_t end = place_fields(fields, struct_align, reorder);
+    std::uint64_t field_bytes = 0;
+    for (const FieldLayout& f : fields) {
+        field_bytes += f.size;
+    }
+    layout.size = round_up(end, struct_align);
+    layout.align = struct_align;
+    layout.tail_padding = layout.size - end;
+    layout.padding = layout.size - field_bytes;
+
+    std::vector<FieldLayout> sorted = fields;
+    layout.optimal_size =
+        std::min(layout.size, round_up(place_fields(sorted, struct_align, true), struct_align));
+
+    for (std::size_t i = 0; i < fields.size(); ++i) {
+        if (fields[i].decl_index != i) {
+            layout.reordered = true;
+        }
+    }
+    layout.fields = std::move(fields);
+
+    order.push_back(key);
+    return &layouts.emplace(key, std::move(layout)).first->second;
+}
+
+const TypeLayout* LayoutEngine::layout_of(const std::string& name) {
+    auto found = structs.find(name);
+    if (found == structs.end()) {
+        return nullptr;
+    }
+    return compute(*found->second, {}, found->second->loc);
+}
+
+const TypeLayout* LayoutEngine::layout_of(const Type& type) {
+    auto found = structs.find(type.name);
+    if (found == structs.end()) {
+        return nullptr;
+    }
+    return compute(*found->second, type.args, found->second->loc);
+}
+
+// The struct an array element names, through aliases.
+const StructDeclAST* LayoutEngine::element_struct(const Type& element) {
+    const Type* type = &element;
+    for (std::size_t hops = 0; hops <= aliases.size(); ++hops) {
+        if (!type->args.empty() || (type->kind != TypeKind::TYPE_UNKNOWN &&
+                                    type->kind != TypeKind::TYPE_STRUCT &&
+                                    type->kind != TypeKind::TYPE_CLASS)) {
+            return nullptr;
+        }
+        auto alias = aliases.find(type->name);
+        if (alias == aliases.end()) {
+            auto found = structs.find(type->name);
+            return found != structs.end() ? found->second : nullptr;
+        }
+        type = alias->second->aliased.get();
+    }
+    return nullptr;  // aliases that refer to each other
+}
+
+bool LayoutEngine::is_soa(const Type& array) {
+    if (array.kind != TypeKind::TYPE_ARRAY || !array.element) {
+        return false;
+    }
+    if (array.soa) {
+        return true;
+    }
+    const StructDeclAST* decl = element_struct(*array.element);
+    return decl != nullptr && frontend::find_attribute(decl->attributes, "soa") != nullptr;
+}
+
+const SoaLayout* LayoutEngine::soa_layout_of(const Type& array) {
+    if (!array.size_known || !is_soa(array)) {
+        return nullptr;
+    }
+    const StructDeclAST* decl = element_struct(*array.element);
+    if (decl == nullptr || !decl->type_params.empty()) {
+        return nullptr;
+    }
+    std::string key = decl->name + "[" + std::to_string(array.array_size) + "]";
+    auto existing = soa_layouts.find(key);
+    if (existing != soa_layouts.end()) {
+        return &existing->second;
+    }
+    const TypeLayout* element = compute(*decl, {}, decl->loc);
+    if (element == nullptr) {
+        return nullptr;
+    }
+    // Each field's array starts at the field's alignment; the stride is the
+    // field's size, so the values of one field are contiguous.
+    SoaLayout soa;
+    std::uint64_t end = 0;
+    for (const FieldLayout& f : element->fields) {
+        SoaField field;
+        field.name = f.name;
+        field.decl_index = f.decl_index;
+        field.offset = round_up(end, f.align);
+        field.stride = f.size;
+        end = field.offset + f.size * array.array_size;
+        soa.align = std::max(soa.align, f.align);
+        soa.fields.push_back(std::move(field));
+    }
+    soa.size = round_up(end, soa.align);
+    soa_order.push_back(key);
+    return &soa_layouts.emplace(key, std::move(soa)).first->second;
+}
+
+std::uint64_t LayoutEngine::size_of(const Type& type) {
+    return measure(type, {}, {}).size;
+}
+
+std::uint64_t LayoutEngine::align_of(const Type& type) {
+    return measure(type, {}, {}).align;
+}
+
+void LayoutEngine::compute_all() {
+    support::TraceScope trace("layout");
+    for (const auto& decl : module.decls) {
+        if (decl->kind != frontend::NodeType::NODE_STRUCT) {
+            continue;
+        }
+        const auto& s = static_cast<const StructDeclAST&>(*decl);
+        bool concrete = std::all_of(s.type_params.begin(), s.type_params.end(),
+                                    [](const frontend::TypeParam& p) { return p.default_type; });
+        if (concrete) {
+            compute(s, {}, s.loc);
+        }
+    }
+}
+
+// Lays out the @soa arrays declared in `stmt` and the statements in it, which
+// lowering would otherwise only do once it reaches them.
+void LayoutEngine::compute_soa(const frontend::StmtAST* stmt) {
+    if (stmt == nullptr) {
+        return;
+    }
+    switch (stmt->kind) {
+        case frontend::NodeType::NODE_VAR_DECL: {
+            const auto& var = static_cast<const frontend::VarDeclAST&>(*stmt);
+            if (var.type != nullptr) {
+                soa_layout_of(*var.type);
+            }
+            return;
+        }
+        case frontend::NodeType::NODE_FUNCTION:
+            compute_soa(static_cast<const frontend::FunctionAST&>(*stmt).body.get());
+            return;
+        case frontend::NodeType::NODE_STRUCT:
+            for (const auto& method : static_cast<const StructDeclAST&>(*stmt).methods) {
+                compute_soa(method.get());
+            }
+            return;
+        case frontend::NodeType::NODE_BLOCK:
+            for (const auto& s : static_cast<const frontend::BlockStmtAST&>(*stmt).statements) {
+                compute_soa(s.get());
+            }
+            return;
+        case frontend::NodeType::NODE_IF: {
+            const auto& branch = static_cast<const frontend::IfStmtAST&>(*stmt);
+            compute_soa(branch.then_branch.get());
+            compute_soa(branch.else_branch.get());
+            return;
+        }
+        case frontend::NodeType::NODE_WHILE:
+            compute_soa(static_cast<const frontend::WhileStmtAST&>(*stmt).body.get());
+            return;
+        case frontend::NodeType::NODE_FOR: {
+            const auto& loop = static_cast<const frontend::ForStmtAST&>(*stmt);
+            compute_soa(loop.init.get());
+            compute_soa(loop.body.get());
+            return;
+        }
+        case frontend::NodeType::NODE_RANGE_FOR:
+            compute_soa(static_cast<const frontend::RangeForStmtAST&>(*stmt).body.get());
+            return;
+        case frontend::NodeType::NODE_MATCH:
+            for (const auto& arm : static_cast<const frontend::MatchStmtAST&>(*stmt).arms) {
+                compute_soa(arm.body.get());
+            }
+            return;
+        case frontend::NodeType::NODE_ARENA:
+            compute_soa(static_cast<const frontend::ArenaStmtAST&>(*stmt).body.get());
+            return;
+        default:
+            return;
+    }
+}
+
+std::string LayoutEngine::report() {
+    compute_all();
+    for (const auto& decl : module.decls) {
+        compute_soa(decl.get());
+    }
+    std::string out;
+    auto pad_num = [](std::uint64_t v, std::size_t width) {
+        std::string s = std::to_string(v);
+        return s.size() < width ? std::string(width - s.size(), ' ') + s : s;
+    };
+    for (const std::string& key : order) {
+        const TypeLayout& layout = layouts.at(key);
+        out.append(layout.name);
+        out.append(": size ");
+        out.append(std::to_string(layout.size));
+        out.append(", align ");
+        out.append(std::to_string(layout.align));
+        out.append(", padding ");
+        out.append(std::to_string(layout.padding));
+        out.append(layout.padding == 1 ? " byte" : " bytes");
+        if (layout.reordered) {
+            out.append(" (reordered)");
+        }
+        out.push_back('\n');
+        out.append("  offset   size  align  field\n");
+        for (const FieldLayout& f : layout.fields) {
+            if (f.padding_before != 0) {
+                out.append("  ");
+                out.append(pad_num(f.offset - f.padding_before, 6));
+                out.append(" ");
+                out.append(pad_num(f.padding_before, 6));
+                out.append("         <padding>\n");
+            }
+            out.append("  ");
+            out.append(pad_num(f.offset, 6));
+            out.append(" ");
+            out.append(pad_num(f.size, 6));
+            out.append(" ");
+            out.append(pad_num(f.align, 6));
+            out.append("  ");
+            out.append(f.name);
+            out.append(": ");
+            out.append(f.type_name);
+            if (f.hot) {
+                out.append(" [hot]");
+            }
+            if (f.cold) {
+                out.append(" [cold]");
+            }
+            out.push_back('\n');
+        }
+        if (layout.tail_padding != 0) {
+            out.append("  ");
+            out.append(pad_num(layout.size - layout.tail_padding, 6));
+            out.append(" ");
+            out.append(pad_num(layout.tail_padding, 6));
+            out.append("         <tail padding>\n");
+        }
+        if (layout.optimal_size < layout.size) {
+            out.append("  note: @reorder would shrink this type to ");
+            out.append(std::to_string(layout.optimal_size));
+            out.append(" bytes\n");
+        }
+    }
+    for (const std::string& key : soa_order) {
+        const SoaLayout& soa = soa_layouts.at(key);
+        out.append("@soa ");
+        out.append(key);
+        out.append(": size ");
+        out.append(std::to_string(soa.size));
+        out.append(", align ");
+        out.append(std::to_string(soa.align));
+        out.push_back('\n');
+        out.append("  offset stride  field\n");
+        for (const SoaField& f : soa.fields) {
+            out.append("  ");
+            out.append(pad_num(f.offset, 6));
+            out.append(" ");
+            out.append(pad_num(f.stride, 6));
+            out.append("  ");
+            out.append(f.name);
+            out.push_back('\n');
+        }
+    }
+    return out;
+}
+
+}  // namespace pallas::middle
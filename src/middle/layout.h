@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "frontend/ast.h"
+#include "frontend/diagnostics.h"
+
+namespace pallas::middle {
+
+constexpr std::uint64_t kCacheLineSize = 64;
+
+struct FieldLayout {
+    std::string name;
+    std::string type_name;
+    std::size_t decl_index = 0;  // position in the source declaration
+    std::uint64_t offset = 0;
+    std::uint64_t size = 0;
+    std::uint64_t align = 1;
+    std::uint64_t padding_before = 0;
+    bool hot = false;
+    bool cold = false;
+};
+
+struct TypeLayout {
+    std::string name;
+    std::uint64_t size = 0;
+    std::uint64_t align = 1;
+    std::uint64_t padding = 0;       // interior and tail padding
+    std::uint64_t tail_padding = 0;
+    std::uint64_t optimal_size = 0;  // size with padding-minimizing order
+    bool reordered = false;          // field order differs from the declaration
+    std::vector<FieldLayout> fields;  // in memory order
+};
+
+// A @soa array of N structs stores each field as an array of N values of its
+// own, in the order the fields have in the struct. Field `f` of element i is at
+// offset + i * stride.
+struct SoaField {
+    std::string name;
+    std::size_t decl_index = 0;  // position in the source declaration
+    std::uint64_t offset = 0;    // start of the field's array
+    std::uint64_t stride = 0;    // size of the field
+};
+
+struct SoaLayout {
+    std::uint64_t size = 0;
+    std::uint64_t align = 1;
+    std::vector<SoaField> fields;
+};
+
+struct LayoutOptions {
+    // Reorder the fields of every struct as if it carried @reorder.
+    bool reorder_all = false;
+};
+
+// Computes size, alignment and field offsets on the x86-64 SysV data model.
+//
+// Struct and class attributes:
+//   @reorder      sort fields by decreasing alignment, which removes interior padding
+//   @align(N)     raise the alignment of the type to N (a power of two)
+//   @cache_aligned  shorthand for @align(64)
+//   @soa          arrays of the struct are stored as one array per field
+// Field attributes:
+//   @align(N)     raise the alignment of one field
+//   @hot, @cold   hot fields are placed first and cold fields last; in a
+//                 cache-line aligned type the cold fields start on a new line
+// Array types:
+//   @soa T[N]     store this array of structs as one array per field
+class LayoutEngine {
+  public:
+    LayoutEngine(const frontend::ModuleAST& module, frontend::Diagnostics* diagnostics,
+                 LayoutOptions options = {});
+
+    // Layout of a named struct or class (generic ones with their defaults).
+    const TypeLayout* layout_of(const std::string& name);
+    // Layout of a struct type with explicit generic arguments.
+    const TypeLayout* layout_of(const frontend::Type& type);
+    std::uint64_t size_of(const frontend::Type& type);
+    std::uint64_t align_of(const frontend::Type& type);
+    // True for an array written `@soa T[N]` or whose element is a @soa struct.
+    bool is_soa(const frontend::Type& array);
+    // Layout of a @soa array of a concrete struct, or null: other @soa arrays
+    // are stored element by element.
+    const SoaLayout* soa_layout_of(const frontend::Type& array);
+    void compute_all();
+    // One block per computed struct/class, listing offsets and padding bytes,
+    // then one per @soa array declared in the module, listing field arrays.
+    std::string report();
+
+  private:
+    struct SizeAlign {
+        std::uint64_t size = 0;
+        std::uint64_t align = 1;
+    };
+
+    const frontend::ModuleAST& module;
+    frontend::Diagnostics* diagnostics = nullptr;
+    LayoutOptions options;
+    std::unordered_map<std::string, const frontend::StructDeclAST*> structs;
+    std::unordered_map<std::string, const frontend::TypeAliasAST*> aliases;
+    std::unordered_map<std::string, TypeLayout> layouts;
+    std::unordered_map<std::string, SoaLayout> soa_layouts;  // by element and length
+    std::vector<std::string> soa_order;  // @soa layouts in computation order
+    std::vector<std::string> order;  // layouts in computation order
+    std::unordered_set<std::string> in_progress;
+    std::unordered_set<std::string> failed;
+
+    void report_error(frontend::ErrorCode code, const std::string& msg, frontend::SourceLocation loc);
+    SizeAlign measure(const frontend::Type& type,
+                      const std::unordered_map<std::string, const frontend::Type*>& bindings,
+                      frontend::SourceLocation loc);
+    const TypeLayout* compute(const frontend::StructDeclAST& decl,
+                              const std::vector<std::shared_ptr<frontend::Type>>& args,
+                              frontend::SourceLocation loc);
+    const frontend::StructDeclAST* element_struct(const frontend::Type& element);
+    void compute_soa(const frontend::StmtAST* stmt);
+    std::uint64_t attribute_alignment(const std::vector<frontend::Attribute>& attributes,
+                                      frontend::SourceLocation loc);
+};
+
+}  // namespace pallas::middle
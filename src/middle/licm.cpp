@@ -0,0 +1,131 @@
+#include <vector>
+#include "fold.h"
+#include "transforms.h"
+
+namespace pallas::middle {
+
+namespace {
+
+// Operations that are undefined for some inputs (a zero divisor, an
+// oversized shift, an out-of-range float conversion) are only hoisted when
+// the problem inputs are ruled out by constants: the preheader runs even when
+// the loop body never does.
+bool safe_to_speculate(const Function& fn, ValueId v) {
+    const Inst& inst = fn.inst(v);
+    auto constant_operand = [&](std::uint32_t i) -> const Inst* {
+        const Inst& op = fn.inst(fn.operand(v, i));
+        return op.op == Opcode::OP_CONST ? &op : nullptr;
+    };
+    switch (inst.op) {
+        case Opcode::OP_UDIV:
+        case Opcode::OP_UREM: {
+            const Inst* divisor = constant_operand(1);
+            return divisor != nullptr && divisor->imm != 0;
+        }
+        case Opcode::OP_SDIV:
+        case Opcode::OP_SREM: {
+            // x / -1 overflows for the most negative x.
+            const Inst* divisor = constant_operand(1);
+            unsigned width = type_bits(inst.type);
+            std::uint64_t minus_one =
+                width >= 64 ? ~std::uint64_t{0} : (std::uint64_t{1} << width) - 1;
+            return divisor != nullptr && divisor->imm != 0 && divisor->imm != minus_one;
+        }
+        case Opcode::OP_SHL:
+        case Opcode::OP_LSHR:
+        case Opcode::OP_ASHR: {
+            const Inst* amount = constant_operand(1);
+            return amount != nullptr && amount->imm < type_bits(inst.type);
+        }
+        case Opcode::OP_FPTOSI:
+        case Opcode::OP_FPTOUI:
+            return false;
+        default:
+            return true;
+    }
+}
+
+class LICMPass : public FunctionPass {
+  public:
+    const char* name() const override { return "licm"; }
+    std::unique_ptr<FunctionPass> clone() const override {
+        return std::make_unique<LICMPass>(*this);
+    }
+
+    PreservedAnalyses run(Function& fn, AnalysisManager& analyses) override {
+        if (fn.entry() == kNoBlock) {
+            return PreservedAnalyses::all();
+        }
+        const LoopInfo& loops = analyses.loops(fn);
+        const DominatorTree& dom = analyses.dominators(fn);
+        bool changed = false;
+        // Inner loops first, so code hoisted out of an inner loop can move on
+        // out of the enclosing one.
+        for (std::uint32_t loop : loops.innermost_first()) {
+            changed |= hoist(fn, loops, dom, loop);
+        }
+        return changed ? PreservedAnalyses::cfg() : PreservedAnalyses::all();
+    }
+
+  private:
+    bool hoist(Function& fn, const LoopInfo& loops, const DominatorTree& dom,
+               std::uint32_t loop) {
+        const Loop& l = loops.loops()[loop];
+        if (l.preheader == kNoBlock) {
+            return false;
+        }
+        // A bounds check left in the loop may be what keeps a load's address
+        // valid, so it pins loads like a write does.
+        bool pins_loads = false;
+        for (BlockId b : l.blocks) {
+            for (ValueId v = fn.block(b).first; v != kNoValue; v = fn.inst(v).next) {
+                Opcode op = fn.inst(v).op;
+                pins_loads |= op == Opcode::OP_STORE || op == Opcode::OP_CALL ||
+                              op == Opcode::OP_DELETE || op == Opcode::OP_BOUNDS_CHECK;
+            }
+        }
+        // Dominator-tree order visits definitions before their uses, so chains
+        // of invariant computations move out in one sweep.
+        ValueId insert_at = fn.terminator(l.preheader);
+        bool changed = false;
+        for (BlockId b : dom.preorder()) {
+            if (!loops.contains(loop, b)) {
+                continue;
+            }
+            for (ValueId v = fn.block(b).first; v != kNoValue;) {
+                ValueId next = fn.inst(v).next;
+                if (can_hoist(fn, loops, loop, v, b == l.header && !pins_loads)) {
+                    fn.move_before(v, insert_at);
+                    changed = true;
+                }
+                v = next;
+            }
+        }
+        return changed;
+    }
+
+    // Loads are hoisted only from the header, which runs whenever the
+    // preheader does, and only when nothing in the loop writes memory.
+    bool can_hoist(const Function& fn, const LoopInfo& loops, std::uint32_t loop, ValueId v,
+                   bool loads_allowed) {
+        const Inst& inst = fn.inst(v);
+        bool is_load = inst.op == Opcode::OP_LOAD;
+        if (inst.op == Opcode::OP_PHI || (!is_pure(inst.op) && !(is_load && loads_allowed))) {
+            return false;
+        }
+        for (std::uint32_t i = 0; i < inst.num_operands; ++i) {
+            if (!is_loop_invariant(fn, loops, loop, fn.operand(v, i))) {
+                return false;
+            }
+        }
+        return safe_to_speculate(fn, v);
+    }
+};
+
+}  // namespace
+
+std::unique_ptr<FunctionPass> create_licm_pass() {
+    return std::make_unique<LICMPass>();
+}
+
+}  // namespace pallas::middle
@@ -0,0 +1,584 @@
+#include "link.h"
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+#include "parallel.h"
+#include "passes.h"
+#include "support/trace.h"
+
+namespace pallas::middle {
+
+namespace {
+
+bool is_definition(const Function& fn) {
+    return (fn.flags & FUNCTION_EXTERN) == 0 && fn.entry() != kNoBlock;
+}
+
+// Compiler-generated functions are private to the module that made them.
+bool is_helper(const std::string& name) {
+    return name.starts_with("pallas.");
+}
+
+// True when the address `v` (of a global, or an offset into one) is only
+// loaded from.
+bool only_loaded(const Function& fn, ValueId v) {
+    for (ValueId user : fn.users(v)) {
+        const Inst& inst = fn.inst(user);
+        if (inst.op == Opcode::OP_LOAD) {
+            continue;
+        }
+        if (inst.op == Opcode::OP_PTRADD && fn.operand(user, 0) == v && only_loaded(fn, user)) {
+            continue;
+        }
+        return false;
+    }
+    return true;
+}
+
+// Symbols named by the calls and global addresses of the functions of
+// `module`, optionally leaving some functions out.
+std::unordered_set<SymbolId> referenced_symbols(
+    const Module& module, const std::unordered_set<const Function*>& skip = {}) {
+    std::unordered_set<SymbolId> out;
+    for (const auto& fn : module.functions) {
+        if (skip.count(fn.get()) != 0) {
+            continue;
+        }
+        for (ValueId v = 0; v < fn->num_values(); ++v) {
+            const Inst& inst = fn->inst(v);
+            if ((inst.op == Opcode::OP_CALL && inst.block != kNoBlock) ||
+                (inst.op == Opcode::OP_GLOBAL && fn->has_uses(v))) {
+                out.insert(inst.aux);
+            }
+        }
+    }
+    return out;
+}
+
+// Replaces loads from the read-only bytes at `address` + `offset` with
+// constants.
+void fold_loads(Function& fn, ValueId address, std::int64_t offset, const std::string& bytes) {
+    for (ValueId user : fn.users(address)) {
+        const Inst inst = fn.inst(user);
+        if (inst.op == Opcode::OP_PTRADD && fn.operand(user, 0) == address) {
+            const Inst& step = fn.inst(fn.operand(user, 1));
+            if (step.op == Opcode::OP_CONST) {
+                fold_loads(fn, user, offset + static_cast<std::int64_t>(step.imm), bytes);
+            }
+            continue;
+        }
+        std::uint64_t size = type_size(inst.type);
+        if (inst.op != Opcode::OP_LOAD || inst.type.is_vector() || offset < 0 || size > 8 ||
+            static_cast<std::uint64_t>(offset) + size > bytes.size()) {
+            continue;
+        }
+        std::uint64_t bits = 0;
+        std::memcpy(&bits, bytes.data() + offset, size);
+        ValueId value = kNoValue;
+        if (inst.type.kind == IRTypeKind::IR_F32) {
+            float f;
+            std::memcpy(&f, &bits, sizeof(f));
+            value = fn.float_constant(inst.type, f);
+        } else {
+            value = fn.constant(inst.type, bits);
+        }
+        fn.replace_all_uses(user, value);
+        fn.erase(user);
+    }
+}
+
+// Gives the globals and helpers of every module that another module also has
+// a symbol of the same name for a name of their own.
+void rename_private_symbols(std::vector<LinkUnit>& units) {
+    std::unordered_map<std::string, std::size_t> modules_using;
+    for (const LinkUnit& unit : units) {
+        for (SymbolId id = 0; id < unit.module->num_symbols(); ++id) {
+            modules_using[unit.module->symbol_name(id)]++;
+        }
+    }
+    for (std::size_t i = 0; i < units.size(); ++i) {
+        Module& module = *units[i].module;
+        std::vector<SymbolId> clashing;
+        for (const Global& global : module.globals) {
+            clashing.push_back(global.symbol);
+        }
+        for (const auto& fn : module.functions) {
+            if (is_helper(fn->name) && is_definition(*fn)) {
+                clashing.push_back(module.find_symbol(fn->name));
+            }
+        }
+        std::erase_if(clashing, [&](SymbolId id) {
+            return modules_using[module.symbol_name(id)] < 2;
+        });
+        for (SymbolId id : clashing) {
+            module.rename(id, module.symbol_name(id) + "." + std::to_string(i));
+        }
+        if (!clashing.empty()) {
+            units[i].summary = summarize_module(module, std::move(units[i].summary.name));
+        }
+    }
+}
+
+// Adds to `into` declarations of the functions, and copies of the globals, of
+// `from` that `copy` refers to and `into` lacks.
+void declare_references(Module& into, const Function& copy, const Module& from) {
+    for (ValueId v = 0; v < copy.num_values(); ++v) {
+        const Inst& inst = copy.inst(v);
+        if (inst.op != Opcode::OP_CALL && inst.op != Opcode::OP_GLOBAL) {
+            continue;
+        }
+        const std::string& name = into.symbol_name(inst.aux);
+        if (into.function_for(inst.aux) != nullptr) {
+            continue;
+        }
+        if (const Function* callee = from.find_function(name)) {
+            std::vector<IRType> params;
+            for (std::size_t i = 0; i < callee->num_args(); ++i) {
+                params.push_back(callee->inst(callee->arg(i)).type);
+            }
+            Function* decl = into.add_function(name, callee->return_type, params);
+            decl->flags = (callee->flags & (FUNCTION_INLINE | FUNCTION_NOINLINE)) | FUNCTION_EXTERN;
+            continue;
+        }
+        const Global* global = from.find_global(from.find_symbol(name));
+        if (global != nullptr && into.find_global(inst.aux) == nullptr) {
+            into.add_global(name, global->bytes, global->constant);
+        }
+    }
+}
+
+// Takes every function and global of `units` into one module. A definition
+// replaces declarations of the same name.
+std::unique_ptr<Module> merge(std::vector<LinkUnit>& units) {
+    auto out = std::make_unique<Module>();
+    std::unordered_set<std::string> globals;
+    for (LinkUnit& unit : units) {
+        Module& module = *unit.module;
+        for (Global& global : module.globals) {
+            const std::string& name = module.symbol_name(global.symbol);
+            if (globals.insert(name).second) {
+                out->add_global(name, std::move(global.bytes), global.constant);
+            }
+        }
+        std::vector<const Function*> functions;
+        for (const auto& fn : module.functions) {
+            functions.push_back(fn.get());
+        }
+        for (const Function* fn : functions) {
+            Function* existing = out->find_function(fn->name);
+            if (existing != nullptr && (is_definition(*existing) || !is_definition(*fn))) {
+                continue;
+            }
+            if (existing != nullptr) {
+                out->remove_function(existing);
+            }
+            out->take_function(module, fn);
+        }
+    }
+    return out;
+}
+
+// Whole-program optimization of units that define `main`.
+class ProgramLinker {
+  public:
+    // Function name to the unit defining it and its summary there.
+    using Definition = std::pair<std::size_t, const FunctionSummary*>;
+    using Definitions = std::unordered_map<std::string, Definition>;
+
+    ProgramLinker(std::vector<LinkUnit>& units, const Definitions& definitions,
+                  const LinkOptions& options, LinkStats& stats)
+        : units(units), definitions(definitions), options(options), stats(stats) {}
+
+    bool run(std::string* error) {
+        find_live();
+        for (const auto& [name, definition] : definitions) {
+            std::uint64_t count = definition.second->entry_count;
+            hottest = count == kNoCount ? hottest : std::max(hottest, count);
+        }
+        std::unordered_set<std::string> read_only;
+        for (const LinkUnit& unit : units) {
+            for (const GlobalSummary& global : unit.summary.globals) {
+                if (!global.constant && !global.written) {
+                    read_only.insert(global.name);
+                }
+            }
+        }
+        stats.constant_globals = read_only.size();
+
+        std::vector<std::vector<std::string>> imports(units.size());
+        for (std::size_t i = 0; i < units.size(); ++i) {
+            imports[i] = choose_imports(i);
+        }
+        for (std::size_t i = 0; i < units.size(); ++i) {
+            internalize(*units[i].module);
+        }
+        for (std::size_t i = 0; i < units.size(); ++i) {
+            for (const std::string& name : imports[i]) {
+                import(i, name);
+            }
+        }
+
+        std::vector<std::string> errors(units.size());
+        parallel_for(units.size(), thread_count(options.threads), [&](std::size_t i, unsigned) {
+            Module& module = *units[i].module;
+            support::TraceScope trace("link-optimize", units[i].summary.name);
+            fold_read_only(module, read_only);
+            PassOptions pass_options;
+            pass_options.verify_each = options.verify_each;
+            PassManager passes(pass_options);
+            build_pipeline(passes, options.opt_level);
+            if (!passes.run(module)) {
+                errors[i] = passes.error();
+            }
+            drop_imported(module, imports[i]);
+        });
+        for (const std::string& message : errors) {
+            if (!message.empty()) {
+                *error = message;
+                return false;
+            }
+        }
+        return true;
+    }
+
+  private:
+    std::vector<LinkUnit>& units;
+    const Definitions& definitions;
+    const LinkOptions& options;
+    LinkStats& stats;
+    std::unordered_set<std::string> live;
+    std::uint64_t hottest = 0;
+
+    // Functions reachable from main and the benchmarks through calls and taken
+    // addresses; the rest are removed.
+    void find_live() {
+        std::vector<const FunctionSummary*> work;
+        auto visit = [&](const std::string& name) {
+            auto found = definitions.find(name);
+            if (found != definitions.end() && live.insert(name).second) {
+                work.push_back(found->second.second);
+            }
+        };
+        visit("main");
+        for (const auto& [name, definition] : definitions) {
+            if ((definition.second->flags & FUNCTION_BENCH) != 0) {
+                visit(name);
+            }
+        }
+        while (!work.empty()) {
+            const FunctionSummary* fn = work.back();
+            work.pop_back();
+            for (const auto& [callee, sites] : fn->calls) {
+                visit(callee);
+            }
+            for (const std::string& ref : fn->refs) {
+                visit(ref);
+            }
+        }
+    }
+
+    bool hot(const FunctionSummary& fn) const {
+        return fn.entry_count != kNoCount && hottest > 0 &&
+               fn.entry_count >= std::max<std::uint64_t>(hottest / options.hot_ratio, 1);
+    }
+
+    // Callees defined elsewhere that unit `i` gets a copy of, nearest first.
+    std::vector<std::string> choose_imports(std::size_t i) const {
+        struct Candidate {
+            std::string name;
+            double limit;
+        };
+        std::vector<Candidate> work;
+        for (const FunctionSummary& fn : units[i].summary.functions) {
+            if (live.count(fn.name) != 0) {
+                for (const auto& [callee, sites] : fn.calls) {
+                    work.push_back({callee, static_cast<double>(options.import_limit)});
+                }
+            }
+        }
+        std::vector<std::string> chosen;
+        std::unordered_set<std::string> seen;
+        for (std::size_t next = 0; next < work.size(); ++next) {
+            Candidate candidate = work[next];
+            auto found = definitions.find(candidate.name);
+            if (found == definitions.end() || found->second.first == i ||
+                !seen.insert(candidate.name).second) {
+                continue;
+            }
+            const FunctionSummary& callee = *found->second.second;
+            if ((callee.flags & FUNCTION_NOINLINE) != 0 || !callee.importable ||
+                callee.entry_count == 0) {
+                continue;
+            }
+            double limit = hot(callee) ? std::max(candidate.limit,
+                                                  static_cast<double>(options.hot_import_limit))
+                                       : candidate.limit;
+            if ((callee.flags & FUNCTION_INLINE) == 0 &&
+                static_cast<double>(callee.instructions) > limit) {
+                continue;
+            }
+            chosen.push_back(candidate.name);
+            for (const auto& [next_callee, sites] : callee.calls) {
+                work.push_back({next_callee, candidate.limit * options.import_decay});
+            }
+        }
+        return chosen;
+    }
+
+    // Removes dead functions and hides the others, except main and the
+    // benchmarks palc bench looks up.
+    void internalize(Module& module) {
+        std::vector<const Function*> dead;
+        for (const auto& fn : module.functions) {
+            if (!is_definition(*fn)) {
+                continue;
+            }
+            if (live.count(fn->name) == 0) {
+                dead.push_back(fn.get());
+            } else if (fn->name != "main" && (fn->flags & FUNCTION_BENCH) == 0) {
+                fn->flags |= FUNCTION_INTERNAL;
+                stats.internalized++;
+            }
+        }
+        for (const Function* fn : dead) {
+            module.remove_function(fn);
+        }
+        stats.removed += dead.size();
+    }
+
+    void import(std::size_t i, const std::string& name) {
+        Module& into = *units[i].module;
+        const Module& from = *units[definitions.at(name).first].module;
+        const Function* source = from.find_function(name);
+        if (Function* declaration = into.find_function(name)) {
+            into.remove_function(declaration);
+        }
+        Function* copy = into.copy_function(*source);
+        declare_references(into, *copy, from);
+        stats.imported++;
+    }
+
+    void fold_read_only(Module& module, const std::unordered_set<std::string>& read_only) {
+        for (Global& global : module.globals) {
+            if (read_only.count(module.symbol_name(global.symbol)) == 0) {
+                continue;
+            }
+            global.constant = true;
+            for (const auto& fn : module.functions) {
+                for (ValueId v = 0; v < fn->num_values(); ++v) {
+                    if (fn->inst(v).op == Opcode::OP_GLOBAL && fn->inst(v).aux == global.symbol) {
+                        fold_loads(*fn, v, 0, global.bytes);
+                    }
+                }
+            }
+        }
+    }
+
+    // Imported copies are only there to be inlined: the ones still called
+    // become declarations again, and the module they came from defines them.
+    void drop_imported(Module& module, const std::vector<std::string>& imported) {
+        std::unordered_set<const Function*> copies;
+        for (const std::string& name : imported) {
+            copies.insert(module.find_function(name));
+        }
+        std::unordered_set<SymbolId> used = referenced_symbols(module, copies);
+        for (const Function* copy : copies) {
+            std::string name = copy->name;
+            IRType return_type = copy->return_type;
+            std::vector<IRType> params;
+            for (std::size_t i = 0; i < copy->num_args(); ++i) {
+                params.push_back(copy->inst(copy->arg(i)).type);
+            }
+            std::uint32_t flags = copy->flags;
+            module.remove_function(copy);
+            if (used.count(module.find_symbol(name)) != 0) {
+                Function* declaration = module.add_function(name, return_type, params);
+                declaration->flags = (flags & ~FUNCTION_INTERNAL) | FUNCTION_EXTERN;
+            }
+        }
+    }
+};
+
+// Removes internal functions main no longer reaches, now that calls have
+// been inlined, the declarations left unused, and globals no function refers
+// to.
+void remove_unreferenced(Module& module, LinkStats& stats) {
+    std::unordered_set<SymbolId> reached;
+    std::vector<const Function*> work;
+    auto visit = [&](SymbolId symbol) {
+        const Function* fn = module.function_for(symbol);
+        if (reached.insert(symbol).second && fn != nullptr) {
+            work.push_back(fn);
+        }
+    };
+    visit(module.find_symbol("main"));
+    for (const auto& fn : module.functions) {
+        if ((fn->flags & FUNCTION_BENCH) != 0) {
+            visit(module.find_symbol(fn->name));
+        }
+    }
+    while (!work.empty()) {
+        const Function* fn = work.back();
+        work.pop_back();
+        for (ValueId v = 0; v < fn->num_values(); ++v) {
+            const Inst& inst = fn->inst(v);
+            if ((inst.op == Opcode::OP_CALL && inst.block != kNoBlock) ||
+                (inst.op == Opcode::OP_GLOBAL && fn->has_uses(v))) {
+                visit(inst.aux);
+            }
+        }
+    }
+    std::vector<const Function*> dead;
+    for (const auto& fn : module.functions) {
+        bool removable = (fn->flags & FUNCTION_INTERNAL) != 0 || !is_definition(*fn);
+        if (removable && reached.count(module.find_symbol(fn->name)) == 0) {
+            dead.push_back(fn.get());
+        }
+    }
+    for (const Function* fn : dead) {
+        stats.removed += is_definition(*fn);
+        module.remove_function(fn);
+    }
+    std::erase_if(module.globals,
+                  [&](const Global& global) { return reached.count(global.symbol) == 0; });
+}
+
+}  // namespace
+
+ModuleSummary summarize_module(const Module& module, std::string name) {
+    ModuleSummary out;
+    out.name = std::move(name);
+    std::unordered_map<SymbolId, std::size_t> global_index;
+    for (const Global& global : module.globals) {
+        global_index.emplace(global.symbol, out.globals.size());
+        out.globals.push_back({module.symbol_name(global.symbol), global.bytes.size(),
+                               global.constant, false});
+    }
+    for (const auto& fn : module.functions) {
+        if (!is_definition(*fn)) {
+            continue;
+        }
+        FunctionSummary summary;
+        summary.name = fn->name;
+        summary.flags = fn->flags;
+        summary.instructions = fn->instruction_count();
+        if (!fn->profile.empty()) {
+            summary.entry_count = fn->profile.entry_count;
+        }
+        std::unordered_map<SymbolId, std::size_t> call_index;
+        for (BlockId b : fn->block_order()) {
+            for (ValueId v = fn->block(b).first; v != kNoValue; v = fn->inst(v).next) {
+                const Inst& inst = fn->inst(v);
+                if (inst.op != Opcode::OP_CALL) {
+                    continue;
+                }
+                auto [at, added] = call_index.emplace(inst.aux, summary.calls.size());
+                if (added) {
+                    summary.calls.push_back({module.symbol_name(inst.aux), 0});
+                }
+                summary.calls[at->second].second++;
+            }
+        }
+        for (ValueId v = 0; v < fn->num_values(); ++v) {
+            const Inst& inst = fn->inst(v);
+            if (inst.op != Opcode::OP_GLOBAL || !fn->has_uses(v)) {
+                continue;
+            }
+            auto global = global_index.find(inst.aux);
+            if (global == global_index.end()) {
+                summary.refs.push_back(module.symbol_name(inst.aux));
+            } else if (!only_loaded(*fn, v)) {
+                out.globals[global->second].written = true;
+            }
+        }
+        auto private_helper = [&](const std::string& callee) {
+            const Function* target = module.find_function(callee);
+            return is_helper(callee) && target != nullptr && is_definition(*target);
+        };
+        summary.importable =
+            std::none_of(summary.refs.begin(), summary.refs.end(), private_helper) &&
+            std::none_of(summary.calls.begin(), summary.calls.end(),
+                         [&](const auto& call) { return private_helper(call.first); });
+        out.functions.push_back(std::move(summary));
+    }
+    return out;
+}
+
+std::string print_summary(const ModuleSummary& summary) {
+    std::string out = "module " + summary.name + "\n";
+    for (const FunctionSummary& fn : summary.functions) {
+        out.append("func @" + fn.name + " " + std::to_string(fn.instructions));
+        if (fn.flags & FUNCTION_INLINE) {
+            out.append(" inline");
+        }
+        if (fn.flags & FUNCTION_NOINLINE) {
+            out.append(" noinline");
+        }
+        if (!fn.importable) {
+            out.append(" local");
+        }
+        if (fn.entry_count != kNoCount) {
+            out.append(" count=" + std::to_string(fn.entry_count));
+        }
+        if (!fn.calls.empty()) {
+            out.append(" calls");
+            for (const auto& [callee, sites] : fn.calls) {
+                out.append(" @" + callee + "*" + std::to_string(sites));
+            }
+        }
+        if (!fn.refs.empty()) {
+            out.append(" refs");
+            for (const std::string& ref : fn.refs) {
+                out.append(" @" + ref);
+            }
+        }
+        out.push_back('\n');
+    }
+    for (const GlobalSummary& global : summary.globals) {
+        out.append("global @" + global.name + " " + std::to_string(global.size));
+        if (global.constant) {
+            out.append(" constant");
+        }
+        if (global.written) {
+            out.append(" written");
+        }
+        out.push_back('\n');
+    }
+    return out;
+}
+
+std::unique_ptr<Module> link_modules(std::vector<LinkUnit> units, const LinkOptions& options,
+                                     std::string* error, LinkStats* stats) {
+    support::TraceScope trace("link");
+    LinkStats ignored;
+    LinkStats& counts = stats != nullptr ? *stats : ignored;
+    counts = {};
+    rename_private_symbols(units);
+    ProgramLinker::Definitions definitions;
+    for (std::size_t i = 0; i < units.size(); ++i) {
+        for (const FunctionSummary& fn : units[i].summary.functions) {
+            auto [found, added] = definitions.emplace(fn.name, std::make_pair(i, &fn));
+            if (!added) {
+                *error = "'@" + fn.name + "' is defined in both '" +
+                         units[found->second.first].summary.name + "' and '" +
+                         units[i].summary.name + "'";
+                return nullptr;
+            }
+        }
+    }
+    bool whole_program = options.whole_program && definitions.count("main") != 0;
+    if (whole_program) {
+        ProgramLinker linker(units, definitions, options, counts);
+        if (!linker.run(error)) {
+            return nullptr;
+        }
+    }
+    std::unique_ptr<Module> out = merge(units);
+    if (whole_program) {
+        remove_unreferenced(*out, counts);
+    }
+    return out;
+}
+
+}  // namespace pallas::middle
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "ir.h"
+
+namespace pallas::middle {
+
+// Linking of separately compiled modules (one per source file, see
+// frontend::import_declarations), with optional whole-program optimization in
+// the manner of ThinLTO (Johnson et al., "ThinLTO: Scalable and Incremental
+// LTO"). Each module is lowered and optimized on its own and described by a
+// summary. The link step decides from the summaries alone which functions are
+// dead, which small callees every module gets a copy of, and which globals
+// nothing writes; the modules then apply the decisions and are optimized again
+// in parallel, and are finally merged into one module for code generation.
+
+// A function defined by a module.
+struct FunctionSummary {
+    std::string name;
+    std::uint32_t flags = 0;  // FunctionFlags
+    std::size_t instructions = 0;
+    std::uint64_t entry_count = kNoCount;  // from a profile
+    std::vector<std::pair<std::string, std::uint32_t>> calls;  // callee, call sites
+    std::vector<std::string> refs;  // functions whose address is taken
+    // False when it uses a compiler-generated helper (`pallas.*`) of its
+    // module, which another module does not have.
+    bool importable = true;
+};
+
+struct GlobalSummary {
+    std::string name;
+    std::size_t size = 0;
+    bool constant = false;
+    // Stored to, or its address used other than to load from it.
+    bool written = false;
+};
+
+struct ModuleSummary {
+    std::string name;  // the source file
+    std::vector<FunctionSummary> functions;
+    std::vector<GlobalSummary> globals;
+};
+
+ModuleSummary summarize_module(const Module& module, std::string name);
+
+// One line per function and global, e.g.
+//
+//   module lib/math.pal
+//   func @square 5 calls @mul*2
+//   func @main 40 noinline calls @square*3 refs @on_exit
+//   global @counter 8 written
+//
+// Functions that cannot be imported are marked `local`, and profile entry
+// counts written as `count=N`.
+std::string print_summary(const ModuleSummary& summary);
+
+struct LinkOptions {
+    // Import, internalize and remove dead code (palc -flto). Otherwise the
+    // modules are only merged, the way separately compiled objects are linked.
+    bool whole_program = false;
+    // Callees of at most this many instructions are imported by the modules
+    // that call them; @inline callees always are, @noinline ones never.
+    std::size_t import_limit = 60;
+    // For callees a profile shows to be hot: entered at least 1/hot_ratio as
+    // often as the most frequently entered function.
+    std::size_t hot_import_limit = 300;
+    std::uint64_t hot_ratio = 100;
+    // The callees of an imported function are imported with the limit
+    // multiplied by this factor, and so on down.
+    double import_decay = 0.7;
+    // Pipeline run on every module after importing (see build_pipeline).
+    int opt_level = 2;
+    bool verify_each = false;
+    // Modules optimized at once, 0 for one per hardware thread.
+    unsigned threads = 0;
+};
+
+struct LinkStats {
+    std::size_t imported = 0;          // copies of functions made in other modules
+    std::size_t internalized = 0;      // functions made invisible outside the program
+    std::size_t removed = 0;           // dead functions dropped
+    std::size_t constant_globals = 0;  // globals found read-only, their loads folded
+};
+
+struct LinkUnit {
+    std::unique_ptr<Module> module;
+    ModuleSummary summary;
+};
+
+// Links `units` into one module. Two modules defining a function of the same
+// name is an error; globals and compiler-generated helpers are private to their
+// module and are renamed when their names clash. With whole_program, `main` and
+// the @bench functions are the only ones left visible and everything they do
+// not reach is removed; without a `main` nothing is internalized or removed.
+// Returns null with `error` set on failure.
+std::unique_ptr<Module> link_modules(std::vector<LinkUnit> units, const LinkOptions& options,
+                                     std::string* error, LinkStats* stats = nullptr);
+
+}  // namespace pallas::middle
@@ -0,0 +1,115 @@
+#include <vector>
+#include "transforms.h"
+
+namespace pallas::middle {
+
+namespace {
+
+class LoopReducePass : public FunctionPass {
+  public:
+    const char* name() const override { return "loop-reduce"; }
+    std::unique_ptr<FunctionPass> clone() const override {
+        return std::make_unique<LoopReducePass>(*this);
+    }
+
+    PreservedAnalyses run(Function& fn, AnalysisManager& analyses) override {
+        if (fn.entry() == kNoBlock) {
+            return PreservedAnalyses::all();
+        }
+        const LoopInfo& loops = analyses.loops(fn);
+        bool changed = false;
+        for (std::uint32_t loop : loops.innermost_first()) {
+            changed |= reduce(fn, loops, loop);
+        }
+        return changed ? PreservedAnalyses::cfg() : PreservedAnalyses::all();
+    }
+
+  private:
+    bool reduce(Function& fn, const LoopInfo& loops, std::uint32_t loop) {
+        const Loop& l = loops.loops()[loop];
+        std::optional<CountedLoop> counted = analyze_counted_loop(fn, loops, loop);
+        bool changed = false;
+        for (const InductionVariable& iv : find_induction_variables(fn, loops, loop)) {
+            // Extending the variable commutes with stepping it only if it never
+            // wraps: it counts up by one and the loop stops at a bound of the
+            // same signedness.
+            bool counts_up = counted && counted->iv.phi == iv.phi && iv.step == 1;
+            bool no_signed_wrap = counts_up && counted->pred == CmpPredicate::CMP_SLT;
+            bool no_unsigned_wrap = counts_up && counted->pred == CmpPredicate::CMP_ULT;
+            std::vector<std::pair<ValueId, ValueId>> candidates;  // (scaled value, extension)
+            for (ValueId user : fn.users(iv.phi)) {
+                Opcode op = fn.inst(user).op;
+                if ((op == Opcode::OP_SEXT && no_signed_wrap) ||
+                    (op == Opcode::OP_ZEXT && no_unsigned_wrap)) {
+                    for (ValueId scaled : fn.users(user)) {
+                        candidates.push_back({scaled, user});
+                    }
+                } else {
+                    candidates.push_back({user, kNoValue});
+                }
+            }
+            for (auto [scaled, extension] : candidates) {
+                std::optional<std::uint64_t> factor = constant_factor(fn, scaled);
+                BlockId b = fn.inst(scaled).block;
+                if (!factor || b == kNoBlock || !loops.contains(loop, b)) {
+                    continue;
+                }
+                IRType type = fn.inst(scaled).type;
+                // start * factor, computed once before the loop.
+                ValueId insert_at = fn.terminator(l.preheader);
+                ValueId start = iv.start;
+                if (extension != kNoValue) {
+                    start = fn.insert_before(insert_at, fn.inst(extension).op, type, {&start, 1});
+                }
+                ValueId start_operands[] = {start, fn.constant(type, *factor)};
+                ValueId initial = fn.insert_before(insert_at, Opcode::OP_MUL, type, start_operands);
+                // ... then advanced by step * factor on every back edge.
+                ValueId first = fn.block(l.header).first;
+                ValueId phi = fn.insert_before(first, Opcode::OP_PHI, type);
+                std::uint64_t increment = static_cast<std::uint64_t>(iv.step) * *factor;
+                ValueId next_operands[] = {phi, fn.constant(type, increment)};
+                ValueId next = fn.insert_before(fn.terminator(l.latches[0]), Opcode::OP_ADD, type,
+                                                next_operands);
+                fn.add_incoming(phi, initial, l.preheader);
+                fn.add_incoming(phi, next, l.latches[0]);
+                fn.replace_all_uses(scaled, phi);
+                fn.erase(scaled);
+                if (extension != kNoValue && !fn.has_uses(extension)) {
+                    fn.erase(extension);
+                }
+                changed = true;
+            }
+        }
+        return changed;
+    }
+
+    // x * c or x << c with a constant c, as the multiplier.
+    static std::optional<std::uint64_t> constant_factor(const Function& fn, ValueId v) {
+        const Inst& inst = fn.inst(v);
+        if ((inst.op != Opcode::OP_MUL && inst.op != Opcode::OP_SHL) || !is_int(inst.type) ||
+            inst.type.is_vector()) {
+            return std::nullopt;
+        }
+        const Inst& rhs = fn.inst(fn.operand(v, 1));
+        const Inst& lhs = fn.inst(fn.operand(v, 0));
+        if (inst.op == Opcode::OP_MUL && rhs.op == Opcode::OP_CONST) {
+            return rhs.imm;
+        }
+        if (inst.op == Opcode::OP_MUL && lhs.op == Opcode::OP_CONST) {
+            return lhs.imm;
+        }
+        if (inst.op == Opcode::OP_SHL && rhs.op == Opcode::OP_CONST &&
+            rhs.imm < type_bits(inst.type)) {
+            return std::uint64_t{1} << rhs.imm;
+        }
+        return std::nullopt;
+    }
+};
+
+}  // namespace
+
+std::unique_ptr<FunctionPass> create_loop_reduce_pass() {
+    return std::make_unique<LoopReducePass>();
+}
+
+}  // namespace pallas::middle
@@ -0,0 +1,89 @@
+#include <algorithm>
+#include <vector>
+#include "transforms.h"
+
+namespace pallas::middle {
+
+namespace {
+
+class LoopSimplifyPass : public FunctionPass {
+  public:
+    const char* name() const override { return "loop-simplify"; }
+    std::unique_ptr<FunctionPass> clone() const override {
+        return std::make_unique<LoopSimplifyPass>(*this);
+    }
+
+    PreservedAnalyses run(Function& fn, AnalysisManager& analyses) override {
+        if (fn.entry() == kNoBlock) {
+            return PreservedAnalyses::all();
+        }
+        const LoopInfo& loops = analyses.loops(fn);
+        bool changed = false;
+        for (std::uint32_t loop = 0; loop < loops.loops().size(); ++loop) {
+            if (loops.loops()[loop].preheader == kNoBlock) {
+                insert_preheader(fn, loops, loop);
+                changed = true;
+            }
+        }
+        return changed ? PreservedAnalyses::none() : PreservedAnalyses::all();
+    }
+
+  private:
+    // Routes every edge entering the header from outside the loop through a
+    // new block; header phis with several outside inputs are merged there.
+    static void insert_preheader(Function& fn, const LoopInfo& loops, std::uint32_t loop) {
+        BlockId header = loops.loops()[loop].header;
+        auto outside = [&](BlockId b) { return !loops.contains(loop, b); };
+        BlockId pre = fn.add_block();
+        for (ValueId v = fn.block(header).first;
+             v != kNoValue && fn.inst(v).op == Opcode::OP_PHI; v = fn.inst(v).next) {
+            std::vector<std::pair<ValueId, BlockId>> entering;
+            for (std::uint32_t i = fn.num_operands(v); i-- > 0;) {
+                if (outside(fn.targets(v)[i])) {
+                    entering.push_back({fn.operand(v, i), fn.targets(v)[i]});
+                    fn.remove_incoming(v, i);
+                }
+            }
+            if (entering.empty()) {
+                continue;
+            }
+            ValueId merged = entering[0].first;
+            bool same = std::all_of(entering.begin(), entering.end(),
+                                    [&](const auto& e) { return e.first == merged; });
+            if (!same) {
+                merged = fn.append(pre, Opcode::OP_PHI, fn.inst(v).type);
+                for (auto [value, from] : entering) {
+                    fn.add_incoming(merged, value, from);
+                }
+            }
+            fn.add_incoming(v, merged, pre);
+        }
+        fn.append(pre, Opcode::OP_BR, IRType(), {}, {&header, 1});
+        std::vector<BlockId> layout;
+        for (BlockId b : fn.block_order()) {
+            if (b == pre) {
+                continue;
+            }
+            if (b == header) {
+                layout.push_back(pre);
+            } else if (outside(b)) {
+                ValueId term = fn.terminator(b);
+                for (std::uint32_t i = 0; i < fn.inst(term).num_targets; ++i) {
+                    if (fn.targets(term)[i] == header) {
+                        fn.set_target(term, i, pre);
+                    }
+                }
+            }
+            layout.push_back(b);
+        }
+        fn.set_block_order(std::move(layout));
+    }
+};
+
+}  // namespace
+
+std::unique_ptr<FunctionPass> create_loop_simplify_pass() {
+    return std::make_unique<LoopSimplifyPass>();
+}
+
+}  // namespace pallas::middle
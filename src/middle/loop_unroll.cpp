@@ -0,0 +1,215 @@
+#include <algorithm>
+#include <vector>
+#include "transforms.h"
+
+namespace pallas::middle {
+
+namespace {
+
+// Full unrolling removes the loop test and the induction updates and lets
+// constant folding see every iteration, but the copies must stay small.
+constexpr std::uint64_t kMaxTrips = 16;
+constexpr std::size_t kMaxUnrolledSize = 256;
+
+class LoopUnrollPass : public FunctionPass {
+  public:
+    const char* name() const override { return "loop-unroll"; }
+    std::unique_ptr<FunctionPass> clone() const override {
+        return std::make_unique<LoopUnrollPass>(*this);
+    }
+
+    PreservedAnalyses run(Function& fn, AnalysisManager& analyses) override {
+        if (fn.entry() == kNoBlock) {
+            return PreservedAnalyses::all();
+        }
+        const LoopInfo& loops = analyses.loops(fn);
+        // Innermost loops are disjoint, so each can be replaced independently.
+        std::vector<std::uint32_t> candidates;
+        for (std::uint32_t loop = 0; loop < loops.loops().size(); ++loop) {
+            if (is_innermost(loops, loop)) {
+                candidates.push_back(loop);
+            }
+        }
+        bool changed = false;
+        for (std::uint32_t loop : candidates) {
+            changed |= unroll(fn, loops, loop);
+        }
+        return changed ? PreservedAnalyses::none() : PreservedAnalyses::all();
+    }
+
+  private:
+    static bool is_innermost(const LoopInfo& loops, std::uint32_t loop) {
+        for (BlockId b : loops.loops()[loop].blocks) {
+            if (loops.loop_for(b) != loop) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool unroll(Function& fn, const LoopInfo& loops, std::uint32_t loop) {
+        const Loop& l = loops.loops()[loop];
+        std::optional<CountedLoop> counted = analyze_counted_loop(fn, loops, loop);
+        if (!counted || l.latches[0] == l.header) {
+            return false;
+        }
+        std::optional<std::uint64_t> trips = constant_trip_count(fn, *counted);
+        std::size_t size = 0;
+        for (BlockId b : l.blocks) {
+            size += fn.block_insts(b).size();
+        }
+        if (!trips || *trips > kMaxTrips || size * (*trips + 1) > kMaxUnrolledSize) {
+            return false;
+        }
+
+        std::vector<BlockId> blocks;  // the loop in layout order, header first
+        blocks.push_back(l.header);
+        for (BlockId b : fn.block_order()) {
+            if (b != l.header && loops.contains(loop, b)) {
+                blocks.push_back(b);
+            }
+        }
+        BlockId latch = l.latches[0];
+        std::size_t num_values = fn.num_values();
+        std::size_t num_blocks = fn.num_blocks();
+        auto in_loop = [&](BlockId b) { return loops.contains(loop, b); };
+
+        // Copy k runs iteration k; the last copy is only the header, whose test
+        // fails and leaves the loop.
+        std::vector<ValueId> previous;
+        std::vector<BlockId> order;
+        BlockId first_header = kNoBlock;
+        BlockId last_header = kNoBlock;
+        BlockId previous_latch = kNoBlock;
+        for (std::uint64_t k = 0; k <= *trips; ++k) {
+            bool last = k == *trips;
+            std::vector<ValueId> value_map(num_values, kNoValue);
+            std::vector<BlockId> block_map(fn.num_blocks(), kNoBlock);
+            for (BlockId b : blocks) {
+                if (b == l.header || !last) {
+                    block_map[b] = fn.add_block();
+                    order.push_back(block_map[b]);
+                }
+            }
+            // Header phis become the value of the previous iteration.
+            for (ValueId v = fn.block(l.header).first;
+                 v != kNoValue && fn.inst(v).op == Opcode::OP_PHI; v = fn.inst(v).next) {
+                for (std::uint32_t i = 0; i < fn.num_operands(v); ++i) {
+                    BlockId from = fn.targets(v)[i];
+                    ValueId in = fn.operand(v, i);
+                    if (k == 0 && from == l.preheader) {
+                        value_map[v] = in;
+                    } else if (k > 0 && from == latch) {
+                        value_map[v] = in < num_values && previous[in] != kNoValue ? previous[in]
+                                                                                   : in;
+                    }
+                }
+            }
+            std::vector<ValueId> cloned;
+            for (BlockId b : blocks) {
+                if (block_map[b] == kNoBlock) {
+                    continue;
+                }
+                for (ValueId v : fn.block_insts(b)) {
+                    if (b == l.header && fn.inst(v).op == Opcode::OP_PHI) {
+                        continue;
+                    }
+                    const Inst inst = fn.inst(v);  // copy: the pools may grow
+                    std::vector<BlockId> targets;
+                    if (b == l.header && inst.op == Opcode::OP_COND_BR) {
+                        targets.push_back(last ? counted->exit : block_map[counted->body]);
+                        fn.append(block_map[b], Opcode::OP_BR, IRType(), {}, targets);
+                        continue;
+                    }
+                    for (BlockId t : fn.targets(v)) {
+                        // The back edge goes on to the next copy's header, which
+                        // does not exist yet; it is patched below.
+                        targets.push_back(t == l.header ? kNoBlock : block_map[t]);
+                    }
+                    std::vector<ValueId> operands(inst.num_operands, v);
+                    ValueId clone = fn.append(block_map[b], inst.op, inst.type, operands, targets);
+                    fn.inst(clone).aux = inst.aux;
+                    fn.inst(clone).imm = inst.imm;
+                    fn.inst(clone).flags = inst.flags;
+                    value_map[v] = clone;
+                    cloned.push_back(v);
+                }
+            }
+            for (ValueId v : cloned) {
+                ValueId clone = value_map[v];
+                for (std::uint32_t i = 0; i < fn.num_operands(v); ++i) {
+                    ValueId in = fn.operand(v, i);
+                    fn.set_operand(clone, i, value_map[in] != kNoValue ? value_map[in] : in);
+                }
+            }
+            BlockId header = block_map[l.header];
+            if (k == 0) {
+                first_header = header;
+            } else {
+                // Point the previous copy's back edge at this header.
+                ValueId back = fn.terminator(previous_latch);
+                for (std::uint32_t i = 0; i < fn.inst(back).num_targets; ++i) {
+                    if (fn.targets(back)[i] == kNoBlock) {
+                        fn.set_target(back, i, header);
+                    }
+                }
+            }
+            last_header = header;
+            previous_latch = block_map[latch];
+            previous = std::move(value_map);
+        }
+
+        // Enter the first copy, leave from the last one, and let code after
+        // the loop use the last copy's header values.
+        ValueId entry = fn.terminator(l.preheader);
+        for (std::uint32_t i = 0; i < fn.inst(entry).num_targets; ++i) {
+            if (fn.targets(entry)[i] == l.header) {
+                fn.set_target(entry, i, first_header);
+            }
+        }
+        fn.replace_predecessor(counted->exit, l.header, last_header);
+        for (ValueId v : fn.block_insts(l.header)) {
+            if (!fn.has_uses(v)) {
+                continue;
+            }
+            for (ValueId user : fn.users(v)) {
+                BlockId b = fn.inst(user).block;
+                if (b == kNoBlock || !in_loop(b)) {
+                    for (std::uint32_t i = 0; i < fn.num_operands(user); ++i) {
+                        if (fn.operand(user, i) == v) {
+                            fn.set_operand(user, i, previous[v] != kNoValue ? previous[v] : v);
+                        }
+                    }
+                }
+            }
+        }
+        for (BlockId b : blocks) {
+            for (ValueId v : fn.block_insts(b)) {
+                if (fn.has_uses(v)) {
+                    fn.replace_all_uses(v, fn.undef(fn.inst(v).type));
+                }
+            }
+        }
+        std::vector<BlockId> layout;
+        for (BlockId b : fn.block_order()) {
+            if (b == l.header) {
+                layout.insert(layout.end(), order.begin(), order.end());
+            } else if (b < num_blocks && !in_loop(b)) {
+                layout.push_back(b);
+            }
+        }
+        for (BlockId b : blocks) {
+            fn.erase_block(b);
+        }
+        fn.set_block_order(std::move(layout));
+        return true;
+    }
+};
+
+}  // namespace
+
+std::unique_ptr<FunctionPass> create_loop_unroll_pass() {
+    return std::make_unique<LoopUnrollPass>();
+}
+
+}  // namespace pallas::middle
@@ -0,0 +1,198 @@
+#include <algorithm>
+#include <optional>
+#include <vector>
+#include "fold.h"
+#include "transforms.h"
+
+namespace pallas::middle {
+
+namespace {
+
+using i128 = __int128;
+
+i128 signed_value(std::uint64_t bits, unsigned width) {
+    if (width < 64 && ((bits >> (width - 1)) & 1) != 0) {
+        bits |= ~std::uint64_t{0} << width;
+    }
+    return static_cast<std::int64_t>(bits);
+}
+
+bool is_signed_predicate(CmpPredicate pred) {
+    return pred == CmpPredicate::CMP_SLT || pred == CmpPredicate::CMP_SLE ||
+           pred == CmpPredicate::CMP_SGT || pred == CmpPredicate::CMP_SGE;
+}
+
+}  // namespace
+
+bool is_loop_invariant(const Function& fn, const LoopInfo& loops, std::uint32_t loop, ValueId v) {
+    BlockId b = fn.inst(v).block;
+    return b == kNoBlock || !loops.contains(loop, b);
+}
+
+std::vector<InductionVariable> find_induction_variables(const Function& fn, const LoopInfo& loops,
+                                                        std::uint32_t loop) {
+    const Loop& l = loops.loops()[loop];
+    std::vector<InductionVariable> out;
+    if (l.preheader == kNoBlock || l.latches.size() != 1) {
+        return out;
+    }
+    for (ValueId v = fn.block(l.header).first; v != kNoValue && fn.inst(v).op == Opcode::OP_PHI;
+         v = fn.inst(v).next) {
+        const Inst& phi = fn.inst(v);
+        if (!is_int(phi.type) || phi.type.is_vector() || phi.num_operands != 2) {
+            continue;
+        }
+        InductionVariable iv;
+        iv.phi = v;
+        for (std::uint32_t i = 0; i < 2; ++i) {
+            BlockId from = fn.targets(v)[i];
+            if (from == l.preheader) {
+                iv.start = fn.operand(v, i);
+            } else if (from == l.latches[0]) {
+                iv.next = fn.operand(v, i);
+            }
+        }
+        if (iv.start == kNoValue || iv.next == kNoValue) {
+            continue;
+        }
+        const Inst& next = fn.inst(iv.next);
+        if ((next.op != Opcode::OP_ADD && next.op != Opcode::OP_SUB) ||
+            next.block == kNoBlock || !loops.contains(loop, next.block)) {
+            continue;
+        }
+        ValueId a = fn.operand(iv.next, 0);
+        ValueId b = fn.operand(iv.next, 1);
+        if (next.op == Opcode::OP_ADD && b == v) {
+            std::swap(a, b);
+        }
+        if (a != v || fn.inst(b).op != Opcode::OP_CONST) {
+            continue;
+        }
+        std::int64_t step = static_cast<std::int64_t>(
+            signed_value(fn.inst(b).imm, type_bits(phi.type)));
+        iv.step = next.op == Opcode::OP_ADD ? step : -step;
+        if (iv.step != 0) {
+            out.push_back(iv);
+        }
+    }
+    return out;
+}
+
+std::optional<CountedLoop> analyze_counted_loop(const Function& fn, const LoopInfo& loops,
+                                                std::uint32_t loop) {
+    const Loop& l = loops.loops()[loop];
+    if (l.exits.size() != 1) {
+        return std::nullopt;
+    }
+    // The header must be the only block that leaves the loop.
+    for (BlockId b : l.blocks) {
+        if (b == l.header) {
+            continue;
+        }
+        for (BlockId s : fn.successors(b)) {
+            if (!loops.contains(loop, s)) {
+                return std::nullopt;
+            }
+        }
+    }
+    ValueId term = fn.terminator(l.header);
+    if (term == kNoValue || fn.inst(term).op != Opcode::OP_COND_BR) {
+        return std::nullopt;
+    }
+    CountedLoop counted;
+    counted.compare = fn.operand(term, 0);
+    const Inst& cmp = fn.inst(counted.compare);
+    if (cmp.op != Opcode::OP_ICMP) {
+        return std::nullopt;
+    }
+    bool exit_on_true = !loops.contains(loop, fn.targets(term)[0]);
+    counted.body = fn.targets(term)[exit_on_true ? 1 : 0];
+    counted.exit = fn.targets(term)[exit_on_true ? 0 : 1];
+    CmpPredicate pred = static_cast<CmpPredicate>(cmp.aux);
+    if (exit_on_true) {
+        pred = inverse_predicate(pred);
+    }
+    ValueId lhs = fn.operand(counted.compare, 0);
+    ValueId rhs = fn.operand(counted.compare, 1);
+    for (const InductionVariable& iv : find_induction_variables(fn, loops, loop)) {
+        bool swapped = iv.phi == rhs;
+        ValueId bound = swapped ? lhs : rhs;
+        if ((iv.phi == lhs || swapped) && is_loop_invariant(fn, loops, loop, bound)) {
+            counted.iv = iv;
+            counted.bound = bound;
+            counted.pred = swapped ? swapped_predicate(pred) : pred;
+            return counted;
+        }
+    }
+    return std::nullopt;
+}
+
+std::optional<std::uint64_t> constant_trip_count(const Function& fn, const CountedLoop& counted) {
+    const Inst& start_inst = fn.inst(counted.iv.start);
+    const Inst& bound_inst = fn.inst(counted.bound);
+    if (start_inst.op != Opcode::OP_CONST || bound_inst.op != Opcode::OP_CONST) {
+        return std::nullopt;
+    }
+    unsigned width = type_bits(start_inst.type);
+    bool is_signed = is_signed_predicate(counted.pred);
+    i128 start = is_signed ? signed_value(start_inst.imm, width) : i128(start_inst.imm);
+    i128 bound = is_signed ? signed_value(bound_inst.imm, width) : i128(bound_inst.imm);
+    i128 lo = is_signed ? -(i128(1) << (width - 1)) : 0;
+    i128 hi = is_signed ? (i128(1) << (width - 1)) - 1 : (i128(1) << width) - 1;
+    i128 step = counted.iv.step;
+    i128 trips = 0;
+    switch (counted.pred) {
+        case CmpPredicate::CMP_SLT:
+        case CmpPredicate::CMP_ULT:
+        case CmpPredicate::CMP_SLE:
+        case CmpPredicate::CMP_ULE: {
+            bool inclusive =
+                counted.pred == CmpPredicate::CMP_SLE || counted.pred == CmpPredicate::CMP_ULE;
+            if (step <= 0) {
+                return std::nullopt;
+            }
+            i128 span = bound - start + (inclusive ? 1 : 0);
+            trips = span > 0 ? (span + step - 1) / step : 0;
+            break;
+        }
+        case CmpPredicate::CMP_SGT:
+        case CmpPredicate::CMP_UGT:
+        case CmpPredicate::CMP_SGE:
+        case CmpPredicate::CMP_UGE: {
+            bool inclusive =
+                counted.pred == CmpPredicate::CMP_SGE || counted.pred == CmpPredicate::CMP_UGE;
+            if (step >= 0) {
+                return std::nullopt;
+            }
+            i128 span = start - bound + (inclusive ? 1 : 0);
+            trips = span > 0 ? (span - step - 1) / -step : 0;
+            break;
+        }
+        case CmpPredicate::CMP_NE: {
+            // Counting by one towards the bound, wrapping around if needed.
+            i128 modulus = i128(1) << width;
+            i128 distance = (i128(bound_inst.imm) - i128(start_inst.imm)) % modulus;
+            if (distance < 0) {
+                distance += modulus;
+            }
+            if (step == 1) {
+                trips = distance;
+            } else if (step == -1) {
+                trips = distance == 0 ? 0 : modulus - distance;
+            } else {
+                return std::nullopt;
+            }
+            return static_cast<std::uint64_t>(trips);
+        }
+        default:
+            return std::nullopt;
+    }
+    // The value that fails the test must not have wrapped around.
+    i128 last = start + trips * step;
+    if (trips > 0 && (last < lo || last > hi)) {
+        return std::nullopt;
+    }
+    return static_cast<std::uint64_t>(trips);
+}
+
+}  // namespace pallas::middle
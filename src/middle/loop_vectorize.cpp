@@ -0,0 +1,673 @@
+#include <algorithm>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+#include "fold.h"
+#include "transforms.h"
+
+namespace pallas::middle {
+
+namespace {
+
+constexpr unsigned kVectorBits = 256;
+
+bool is_vector_element(IRType type) {
+    if (type.is_vector()) {
+        return false;
+    }
+    switch (type.kind) {
+        case IRTypeKind::IR_I8:
+        case IRTypeKind::IR_I16:
+        case IRTypeKind::IR_I32:
+        case IRTypeKind::IR_I64:
+        case IRTypeKind::IR_F32:
+        case IRTypeKind::IR_F64:
+            return true;
+        default:
+            return false;
+    }
+}
+
+std::uint64_t reduction_identity(Opcode op, IRType type) {
+    switch (op) {
+        case Opcode::OP_MUL: return 1;
+        case Opcode::OP_AND: return ~std::uint64_t{0} >> (64 - type_bits(type));
+        default: return 0;
+    }
+}
+
+// Strips constant and variable offsets down to the allocation a pointer
+// points into.
+ValueId underlying_object(const Function& fn, ValueId p) {
+    while (fn.inst(p).op == Opcode::OP_PTRADD) {
+        p = fn.operand(p, 0);
+    }
+    return p;
+}
+
+// Distinct stack slots and globals never overlap, and a function's own stack
+// slots cannot be reached through its arguments.
+bool known_disjoint(const Function& fn, ValueId a, ValueId b) {
+    Opcode x = fn.inst(a).op;
+    Opcode y = fn.inst(b).op;
+    if (a == b) {
+        return false;
+    }
+    bool a_object = x == Opcode::OP_ALLOCA || x == Opcode::OP_GLOBAL;
+    bool b_object = y == Opcode::OP_ALLOCA || y == Opcode::OP_GLOBAL;
+    if (a_object && b_object) {
+        return true;
+    }
+    return (x == Opcode::OP_ALLOCA && y == Opcode::OP_ARG) ||
+           (y == Opcode::OP_ALLOCA && x == Opcode::OP_ARG);
+}
+
+// A load or store whose address advances by exactly one element per iteration.
+struct Access {
+    ValueId inst = kNoValue;
+    ValueId address = kNoValue;
+    ValueId object = kNoValue;
+    std::uint64_t size = 0;
+    bool is_store = false;
+};
+
+struct Reduction {
+    ValueId phi = kNoValue;
+    ValueId start = kNoValue;
+    ValueId update = kNoValue;  // phi op operand, fed back on the back edge
+    ValueId operand = kNoValue;
+};
+
+// Vectorizes one loop of the shape left by lowering and the scalar passes:
+//
+//   header:  i = phi [start, pre], [i + 1, body]; (reduction phis)
+//            condbr (icmp i, bound), body, exit
+//   body:    straight-line loads, pure arithmetic and stores; br header
+//
+// The vector loop runs over the largest multiple of the vector width and
+// hands the rest to the original loop, which becomes the remainder:
+//
+//   pre -> vheader <-> vbody;  vheader -> middle -> header <-> body -> exit
+class LoopVectorizer {
+  public:
+    LoopVectorizer(Function& fn, const LoopInfo& loops, std::uint32_t loop,
+                   const CountedLoop& counted)
+        : fn(fn), loops(loops), loop(loop), l(loops.loops()[loop]), counted(counted) {}
+
+    bool run() {
+        if (!legal()) {
+            return false;
+        }
+        transform();
+        return true;
+    }
+
+  private:
+    Function& fn;
+    const LoopInfo& loops;
+    std::uint32_t loop;
+    const Loop& l;
+    CountedLoop counted;
+    std::vector<ValueId> order;  // header non-phis, then the body, without terminators
+    std::vector<Access> accesses;
+    std::vector<Reduction> reductions;
+    std::unordered_map<ValueId, bool> widenable;
+    std::uint16_t lanes = 0;
+
+    // Code generation state.
+    ValueId pre_insert = kNoValue;
+    ValueId body_insert = kNoValue;
+    ValueId vector_index = kNoValue;
+    ValueId step_vector = kNoValue;
+    std::unordered_map<ValueId, ValueId> widened;
+    std::unordered_map<ValueId, ValueId> splats;
+    std::unordered_map<ValueId, ValueId> lane0;
+    std::vector<ValueId> vector_phis;
+
+    bool invariant(ValueId v) const { return is_loop_invariant(fn, loops, loop, v); }
+
+    IRType vector_of(IRType type) const { return IRType::vector(type.kind, lanes); }
+
+    // -------------------------------------------------------------------
+    // Legality
+    // -------------------------------------------------------------------
+
+    bool legal() {
+        const InductionVariable& iv = counted.iv;
+        if (l.blocks.size() != 2 || l.preheader == kNoBlock || counted.body == l.header ||
+            l.latches[0] != counted.body || iv.step != 1) {
+            return false;
+        }
+        if (counted.pred != CmpPredicate::CMP_SLT && counted.pred != CmpPredicate::CMP_ULT &&
+            counted.pred != CmpPredicate::CMP_NE) {
+            return false;
+        }
+        for (ValueId v = fn.block(l.header).first; v != kNoValue; v = fn.inst(v).next) {
+            const Inst& inst = fn.inst(v);
+            if (inst.op == Opcode::OP_PHI) {
+                if (v != iv.phi && !add_reduction(v)) {
+                    return false;
+                }
+            } else if (!is_terminator(inst.op)) {
+                order.push_back(v);
+            }
+        }
+        for (ValueId v = fn.block(counted.body).first; v != kNoValue; v = fn.inst(v).next) {
+            if (!is_terminator(fn.inst(v).op)) {
+                order.push_back(v);
+            }
+        }
+        unsigned widest = 0;
+        for (ValueId v : order) {
+            const Inst& inst = fn.inst(v);
+            if (inst.op == Opcode::OP_LOAD || inst.op == Opcode::OP_STORE) {
+                bool is_store = inst.op == Opcode::OP_STORE;
+                IRType type = is_store ? fn.inst(fn.operand(v, 0)).type : inst.type;
+                Access access{v, fn.operand(v, is_store ? 1 : 0), kNoValue, type_size(type),
+                              is_store};
+                std::optional<std::int64_t> stride = address_stride(access.address, access.object);
+                if (!is_vector_element(type) || !stride ||
+                    *stride != static_cast<std::int64_t>(access.size)) {
+                    return false;
+                }
+                if (is_store && !can_widen(fn.operand(v, 0))) {
+                    return false;
+                }
+                accesses.push_back(access);
+                widest = std::max(widest, type_bits(type));
+            } else if (inst.op == Opcode::OP_PHI || !is_pure(inst.op)) {
+                return false;
+            }
+        }
+        for (const Reduction& r : reductions) {
+            if (!can_widen(r.operand)) {
+                return false;
+            }
+            widest = std::max(widest, type_bits(fn.inst(r.phi).type));
+        }
+        for (auto [v, ok] : widenable) {
+            if (ok && fn.inst(v).type.kind != IRTypeKind::IR_I1) {
+                widest = std::max(widest, type_bits(fn.inst(v).type));
+            }
+        }
+        if (widest == 0 || (reductions.empty() &&
+                            std::none_of(accesses.begin(), accesses.end(),
+                                         [](const Access& a) { return a.is_store; }))) {
+            return false;
+        }
+        lanes = static_cast<std::uint16_t>(kVectorBits / widest);
+        std::optional<std::uint64_t> trips = constant_trip_count(fn, counted);
+        return !trips || *trips >= lanes;
+    }
+
+    // r = phi [start, pre], [r op x, body] where nothing else in the loop reads r
+    // or the update.
+    bool add_reduction(ValueId phi) {
+        const Inst& inst = fn.inst(phi);
+        if (!is_int(inst.type) || inst.type.is_vector() || inst.num_operands != 2) {
+            return false;
+        }
+        Reduction r;
+        r.phi = phi;
+        for (std::uint32_t i = 0; i < 2; ++i) {
+            if (fn.targets(phi)[i] == l.preheader) {
+                r.start = fn.operand(phi, i);
+            } else {
+                r.update = fn.operand(phi, i);
+            }
+        }
+        if (r.start == kNoValue || r.update == kNoValue || fn.count_uses(r.update) != 1) {
+            return false;
+        }
+        // Code after the loop may read the result; the loop itself may not.
+        for (ValueId user : fn.users(phi)) {
+            BlockId b = fn.inst(user).block;
+            if (user != r.update && b != kNoBlock && loops.contains(loop, b)) {
+                return false;
+            }
+        }
+        const Inst& update = fn.inst(r.update);
+        switch (update.op) {
+            case Opcode::OP_ADD:
+            case Opcode::OP_MUL:
+            case Opcode::OP_AND:
+            case Opcode::OP_OR:
+            case Opcode::OP_XOR:
+                break;
+            default:
+                return false;
+        }
+        if (update.block != counted.body) {
+            return false;
+        }
+        ValueId a = fn.operand(r.update, 0);
+        ValueId b = fn.operand(r.update, 1);
+        if (a != phi && b != phi) {
+            return false;
+        }
+        r.operand = a == phi ? b : a;
+        if (r.operand == phi) {
+            return false;
+        }
+        reductions.push_back(r);
+        return true;
+    }
+
+    bool is_reduction_update(ValueId v) const {
+        return std::any_of(reductions.begin(), reductions.end(),
+                           [&](const Reduction& r) { return r.update == v; });
+    }
+
+    // Bytes the value advances per iteration, if it is an affine function of
+    // the induction variable.
+    std::optional<std::int64_t> stride_of(ValueId v) const {
+        const InductionVariable& iv = counted.iv;
+        if (invariant(v)) {
+            return 0;
+        }
+        if (v == iv.phi || v == iv.next) {
+            return 1;
+        }
+        const Inst& inst = fn.inst(v);
+        auto constant = [&](std::uint32_t i) -> std::optional<std::int64_t> {
+            const Inst& op = fn.inst(fn.operand(v, i));
+            if (op.op != Opcode::OP_CONST) {
+                return std::nullopt;
+            }
+            return static_cast<std::int64_t>(op.imm);
+        };
+        switch (inst.op) {
+            case Opcode::OP_ADD:
+            case Opcode::OP_SUB: {
+                std::optional<std::int64_t> a = stride_of(fn.operand(v, 0));
+                std::optional<std::int64_t> b = stride_of(fn.operand(v, 1));
+                if (!a || !b) {
+                    return std::nullopt;
+                }
+                return inst.op == Opcode::OP_ADD ? *a + *b : *a - *b;
+            }
+            case Opcode::OP_MUL: {
+                std::optional<std::int64_t> a = stride_of(fn.operand(v, 0));
+                std::optional<std::int64_t> c = constant(1);
+                if (!a || !c) {
+                    a = stride_of(fn.operand(v, 1));
+                    c = constant(0);
+                }
+                if (!a || !c) {
+                    return std::nullopt;
+                }
+                return *a * *c;
+            }
+            case Opcode::OP_SHL: {
+                std::optional<std::int64_t> a = stride_of(fn.operand(v, 0));
+                std::optional<std::int64_t> c = constant(1);
+                if (!a || !c || *c < 0 || *c >= 63) {
+                    return std::nullopt;
+                }
+                return *a << *c;
+            }
+            case Opcode::OP_SEXT:
+            case Opcode::OP_ZEXT: {
+                // The variable and its successor only take values below the
+                // bound, so extending them cannot observe a wrap.
+                ValueId x = fn.operand(v, 0);
+                CmpPredicate pred = inst.op == Opcode::OP_SEXT ? CmpPredicate::CMP_SLT
+                                                               : CmpPredicate::CMP_ULT;
+                if ((x == iv.phi || x == iv.next) && counted.pred == pred) {
+                    return 1;
+                }
+                return std::nullopt;
+            }
+            default:
+                return std::nullopt;
+        }
+    }
+
+    std::optional<std::int64_t> address_stride(ValueId address, ValueId& object) const {
+        if (invariant(address)) {
+            object = underlying_object(fn, address);
+            return 0;
+        }
+        const Inst& inst = fn.inst(address);
+        if (inst.op != Opcode::OP_PTRADD) {
+            return std::nullopt;
+        }
+        std::optional<std::int64_t> base = address_stride(fn.operand(address, 0), object);
+        std::optional<std::int64_t> offset = stride_of(fn.operand(address, 1));
+        if (!base || !offset) {
+            return std::nullopt;
+        }
+        return *base + *offset;
+    }
+
+    bool can_widen(ValueId v) {
+        auto found = widenable.find(v);
+        if (found != widenable.end()) {
+            return found->second;
+        }
+        widenable[v] = false;  // cycles only go through phis, which are rejected
+        bool ok = false;
+        const Inst& inst = fn.inst(v);
+        if (invariant(v) || v == counted.iv.phi) {
+            ok = inst.type.kind != IRTypeKind::IR_PTR;
+        } else if (inst.op == Opcode::OP_LOAD) {
+            ok = std::any_of(accesses.begin(), accesses.end(),
+                             [&](const Access& a) { return a.inst == v; });
+        } else if (is_pure(inst.op) && inst.op != Opcode::OP_PTRADD &&
+                   inst.op != Opcode::OP_PHI && !is_reduction_update(v) &&
+                   (is_vector_element(inst.type) || inst.type.kind == IRTypeKind::IR_I1)) {
+            ok = true;
+            for (std::uint32_t i = 0; i < inst.num_operands && ok; ++i) {
+                ok = can_widen(fn.operand(v, i));
+            }
+        }
+        widenable[v] = ok;
+        return ok;
+    }
+
+    // -------------------------------------------------------------------
+    // Code generation
+    // -------------------------------------------------------------------
+
+    ValueId emit(ValueId pos, Opcode op, IRType type, std::initializer_list<ValueId> operands,
+                 std::uint32_t aux = 0) {
+        ValueId v = fn.insert_before(pos, op, type, {operands.begin(), operands.size()});
+        fn.inst(v).aux = aux;
+        return v;
+    }
+
+    ValueId lane_index(std::uint64_t i) {
+        return fn.constant(IRType::scalar(IRTypeKind::IR_I32), i);
+    }
+
+    // The scalar value of `v` in the iteration where the induction variable is
+    // `index`, for affine address computations. Code goes before `pos`.
+    ValueId materialize(ValueId v, ValueId index, ValueId pos,
+                        std::unordered_map<ValueId, ValueId>& memo) {
+        const InductionVariable& iv = counted.iv;
+        if (invariant(v)) {
+            return v;
+        }
+        if (v == iv.phi) {
+            return index;
+        }
+        auto found = memo.find(v);
+        if (found != memo.end()) {
+            return found->second;
+        }
+        const Inst inst = fn.inst(v);  // copy: the pools may grow
+        ValueId out;
+        if (v == iv.next) {
+            IRType type = inst.type;
+            out = emit(pos, Opcode::OP_ADD, type, {index, fn.constant(type, 1)});
+        } else {
+            std::vector<ValueId> operands;
+            for (std::uint32_t i = 0; i < inst.num_operands; ++i) {
+                operands.push_back(materialize(fn.operand(v, i), index, pos, memo));
+            }
+            out = fn.insert_before(pos, inst.op, inst.type, operands);
+            fn.inst(out).aux = inst.aux;
+        }
+        memo[v] = out;
+        return out;
+    }
+
+    ValueId splat(ValueId v) {
+        auto found = splats.find(v);
+        if (found != splats.end()) {
+            return found->second;
+        }
+        const Inst& inst = fn.inst(v);
+        ValueId out = inst.op == Opcode::OP_CONST
+                          ? fn.constant(vector_of(inst.type), inst.imm)
+                          : emit(pre_insert, Opcode::OP_SPLAT, vector_of(inst.type), {v});
+        splats[v] = out;
+        return out;
+    }
+
+    ValueId widen(ValueId v) {
+        auto found = widened.find(v);
+        if (found != widened.end()) {
+            return found->second;
+        }
+        const Inst inst = fn.inst(v);  // copy: the pools may grow
+        ValueId out;
+        if (invariant(v)) {
+            out = splat(v);
+        } else if (v == counted.iv.phi) {
+            // <i, i + 1, ..., i + lanes - 1>
+            if (step_vector == kNoValue) {
+                step_vector = fn.constant(vector_of(inst.type), 0);
+                for (std::uint64_t i = 1; i < lanes; ++i) {
+                    step_vector = emit(pre_insert, Opcode::OP_INSERT, vector_of(inst.type),
+                                       {step_vector, fn.constant(inst.type, i), lane_index(i)});
+                }
+            }
+            ValueId base = emit(body_insert, Opcode::OP_SPLAT, vector_of(inst.type),
+                                {vector_index});
+            out = emit(body_insert, Opcode::OP_ADD, vector_of(inst.type), {base, step_vector});
+        } else if (inst.op == Opcode::OP_LOAD) {
+            ValueId address = materialize(fn.operand(v, 0), vector_index, body_insert, lane0);
+            out = emit(body_insert, Opcode::OP_LOAD, vector_of(inst.type), {address});
+        } else {
+            std::vector<ValueId> operands;
+            for (std::uint32_t i = 0; i < inst.num_operands; ++i) {
+                operands.push_back(widen(fn.operand(v, i)));
+            }
+            out = fn.insert_before(body_insert, inst.op, vector_of(inst.type), operands);
+            fn.inst(out).aux = inst.aux;
+        }
+        widened[v] = out;
+        return out;
+    }
+
+    // Iterations the vector loop covers: the trip count rounded down to a
+    // multiple of the width, as the end value of the induction variable.
+    ValueId vector_end() {
+        const InductionVariable& iv = counted.iv;
+        IRType type = fn.inst(iv.phi).type;
+        IRType i1 = IRType::scalar(IRTypeKind::IR_I1);
+        ValueId count = emit(pre_insert, Opcode::OP_SUB, type, {counted.bound, iv.start});
+        if (counted.pred != CmpPredicate::CMP_NE) {
+            ValueId runs = emit(pre_insert, Opcode::OP_ICMP, i1, {iv.start, counted.bound},
+                                static_cast<std::uint32_t>(counted.pred));
+            count = emit(pre_insert, Opcode::OP_SELECT, type,
+                         {runs, count, fn.constant(type, 0)});
+        }
+        ValueId rest = emit(pre_insert, Opcode::OP_AND, type,
+                            {count, fn.constant(type, lanes - 1)});
+        ValueId covered = emit(pre_insert, Opcode::OP_SUB, type, {count, rest});
+        return emit(pre_insert, Opcode::OP_ADD, type, {iv.start, covered});
+    }
+
+    // True (an i1) when no store can touch what another access reads or
+    // writes during the vector iterations; kNoValue when that is known.
+    ValueId no_overlap(ValueId end) {
+        IRType i1 = IRType::scalar(IRTypeKind::IR_I1);
+        ValueId safe = kNoValue;
+        std::unordered_map<ValueId, ValueId> at_start;
+        std::unordered_map<ValueId, ValueId> at_end;
+        auto range = [&](const Access& a) {
+            ValueId lo = materialize(a.address, counted.iv.start, pre_insert, at_start);
+            ValueId hi = materialize(a.address, end, pre_insert, at_end);
+            return std::pair{lo, hi};
+        };
+        for (std::size_t i = 0; i < accesses.size(); ++i) {
+            for (std::size_t j = 0; j < accesses.size(); ++j) {
+                const Access& a = accesses[i];
+                const Access& b = accesses[j];
+                bool ordered = b.is_store ? i < j : true;  // each store pair once
+                if (!a.is_store || i == j || !ordered || a.address == b.address ||
+                    known_disjoint(fn, a.object, b.object)) {
+                    continue;
+                }
+                auto [a_lo, a_hi] = range(a);
+                auto [b_lo, b_hi] = range(b);
+                auto ule = static_cast<std::uint32_t>(CmpPredicate::CMP_ULE);
+                ValueId before = emit(pre_insert, Opcode::OP_ICMP, i1, {a_hi, b_lo}, ule);
+                ValueId after = emit(pre_insert, Opcode::OP_ICMP, i1, {b_hi, a_lo}, ule);
+                ValueId disjoint = emit(pre_insert, Opcode::OP_OR, i1, {before, after});
+                safe = safe == kNoValue ? disjoint
+                                        : emit(pre_insert, Opcode::OP_AND, i1, {safe, disjoint});
+            }
+        }
+        return safe;
+    }
+
+    void transform() {
+        const InductionVariable& iv = counted.iv;
+        IRType type = fn.inst(iv.phi).type;
+        IRType i1 = IRType::scalar(IRTypeKind::IR_I1);
+        BlockId pre = l.preheader;
+        pre_insert = fn.terminator(pre);
+
+        ValueId end = vector_end();
+        // If the accesses might overlap, the vector loop runs zero times and
+        // the original loop does all the work.
+        ValueId safe = no_overlap(end);
+        if (safe != kNoValue) {
+            end = emit(pre_insert, Opcode::OP_SELECT, type, {safe, end, iv.start});
+        }
+
+        BlockId vheader = fn.add_block();
+        BlockId vbody = fn.add_block();
+        BlockId middle = fn.add_block();
+        vector_index = fn.append(vheader, Opcode::OP_PHI, type);
+        for (const Reduction& r : reductions) {
+            vector_phis.push_back(fn.append(vheader, Opcode::OP_PHI,
+                                            vector_of(fn.inst(r.phi).type)));
+            widened[r.phi] = vector_phis.back();
+        }
+        ValueId compare_operands[] = {vector_index, end};
+        ValueId more = fn.append(vheader, Opcode::OP_ICMP, i1, compare_operands);
+        fn.inst(more).aux = static_cast<std::uint32_t>(CmpPredicate::CMP_NE);
+        BlockId vheader_targets[] = {vbody, middle};
+        fn.append(vheader, Opcode::OP_COND_BR, IRType(), {&more, 1}, vheader_targets);
+        body_insert = fn.append(vbody, Opcode::OP_BR, IRType(), {}, {&vheader, 1});
+
+        // Memory operations keep their order; everything else is widened on
+        // demand, so address arithmetic stays scalar.
+        for (ValueId v : order) {
+            const Inst inst = fn.inst(v);
+            if (inst.op == Opcode::OP_LOAD && can_widen(v)) {
+                widen(v);
+            } else if (inst.op == Opcode::OP_STORE) {
+                ValueId value = widen(fn.operand(v, 0));
+                ValueId address = materialize(fn.operand(v, 1), vector_index, body_insert, lane0);
+                emit(body_insert, Opcode::OP_STORE, IRType(), {value, address});
+            }
+        }
+        std::vector<ValueId> updates;
+        for (const Reduction& r : reductions) {
+            const Inst update = fn.inst(r.update);
+            ValueId acc = widened[r.phi];
+            updates.push_back(emit(body_insert, update.op, vector_of(update.type),
+                                   {acc, widen(r.operand)}));
+        }
+        ValueId next = emit(body_insert, Opcode::OP_ADD, type,
+                            {vector_index, fn.constant(type, lanes)});
+        fn.add_incoming(vector_index, iv.start, pre);
+        fn.add_incoming(vector_index, next, vbody);
+
+        // Fold the vector accumulators back into scalars for the remainder.
+        ValueId middle_br = fn.append(middle, Opcode::OP_BR, IRType(), {}, {&l.header, 1});
+        std::vector<ValueId> results;
+        for (std::size_t k = 0; k < reductions.size(); ++k) {
+            const Reduction& r = reductions[k];
+            IRType scalar = fn.inst(r.phi).type;
+            Opcode op = fn.inst(r.update).op;
+            // The start value goes in one lane, the identity in the others.
+            std::uint64_t identity = reduction_identity(op, scalar);
+            ValueId init = fn.constant(vector_of(scalar), identity);
+            const Inst& start = fn.inst(r.start);
+            if (start.op != Opcode::OP_CONST || start.imm != identity) {
+                init = emit(pre_insert, Opcode::OP_INSERT, vector_of(scalar),
+                            {init, r.start, lane_index(0)});
+            }
+            fn.add_incoming(vector_phis[k], init, pre);
+            fn.add_incoming(vector_phis[k], updates[k], vbody);
+            ValueId total = emit(middle_br, Opcode::OP_EXTRACT, scalar,
+                                 {vector_phis[k], lane_index(0)});
+            for (std::uint64_t i = 1; i < lanes; ++i) {
+                ValueId lane = emit(middle_br, Opcode::OP_EXTRACT, scalar,
+                                    {vector_phis[k], lane_index(i)});
+                total = emit(middle_br, op, scalar, {total, lane});
+            }
+            results.push_back(total);
+        }
+
+        // The original loop now starts where the vector loop stopped.
+        for (ValueId v = fn.block(l.header).first;
+             v != kNoValue && fn.inst(v).op == Opcode::OP_PHI; v = fn.inst(v).next) {
+            for (std::uint32_t i = 0; i < fn.num_operands(v); ++i) {
+                if (fn.targets(v)[i] != pre) {
+                    continue;
+                }
+                fn.set_target(v, i, middle);
+                if (v == iv.phi) {
+                    // The vector loop stops exactly at `end`; passing it on
+                    // lets constant folding drop a remainder that never runs.
+                    fn.set_operand(v, i, end);
+                }
+                for (std::size_t k = 0; k < reductions.size(); ++k) {
+                    if (reductions[k].phi == v) {
+                        fn.set_operand(v, i, results[k]);
+                    }
+                }
+            }
+        }
+        for (std::uint32_t i = 0; i < fn.inst(pre_insert).num_targets; ++i) {
+            if (fn.targets(pre_insert)[i] == l.header) {
+                fn.set_target(pre_insert, i, vheader);
+            }
+        }
+        std::vector<BlockId> layout;
+        for (BlockId b : fn.block_order()) {
+            if (b == vheader || b == vbody || b == middle) {
+                continue;
+            }
+            if (b == l.header) {
+                layout.insert(layout.end(), {vheader, vbody, middle});
+            }
+            layout.push_back(b);
+        }
+        fn.set_block_order(std::move(layout));
+    }
+};
+
+class LoopVectorizePass : public FunctionPass {
+  public:
+    const char* name() const override { return "loop-vectorize"; }
+    std::unique_ptr<FunctionPass> clone() const override {
+        return std::make_unique<LoopVectorizePass>(*this);
+    }
+
+    PreservedAnalyses run(Function& fn, AnalysisManager& analyses) override {
+        if (fn.entry() == kNoBlock) {
+            return PreservedAnalyses::all();
+        }
+        const LoopInfo& loops = analyses.loops(fn);
+        // Candidates are innermost loops, which are disjoint, so the analysis
+        // stays valid for the loops not yet visited.
+        bool changed = false;
+        for (std::uint32_t loop = 0; loop < loops.loops().size(); ++loop) {
+            const Loop& l = loops.loops()[loop];
+            if (l.blocks.size() != 2 || loops.loop_for(l.blocks[1]) != loop) {
+                continue;
+            }
+            std::optional<CountedLoop> counted = analyze_counted_loop(fn, loops, loop);
+            if (counted) {
+                changed |= LoopVectorizer(fn, loops, loop, *counted).run();
+            }
+        }
+        return changed ? PreservedAnalyses::none() : PreservedAnalyses::all();
+    }
+};
+
+}  // namespace
+
+std::unique_ptr<FunctionPass> create_loop_vectorize_pass() {
+    return std::make_unique<LoopVectorizePass>();
+}
+
+}  // namespace pallas::middle
@@ -0,0 +1,4494 @@
+#include "lower.h"
+#include <algorithm>
+#include <bit>
+#include <limits>
+#include <map>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "match.h"
+#include "runtime/arena.h"
+#include "runtime/format.h"
+#include "runtime/str.h"
+#include "runtime/vec.h"
+#include "support/trace.h"
+#include "transforms.h"
+
+namespace pallas::middle {
+
+using frontend::ErrorCode;
+using frontend::ExprAST;
+using frontend::ExprKind;
+using frontend::NodeType;
+using frontend::SourceLocation;
+using frontend::StmtAST;
+using frontend::TokenType;
+using frontend::Type;
+using frontend::TypeKind;
+
+namespace {
+
+using TypePtr = std::shared_ptr<Type>;
+
+constexpr std::uint32_t kNoVariable = std::numeric_limits<std::uint32_t>::max();
+
+// How a value in `${...}` is written.
+enum class FormatKind : std::uint8_t {
+    FORMAT_SIGNED,        // as i64, by the runtime
+    FORMAT_UNSIGNED,      // as u64, by the runtime
+    FORMAT_SIGNED_128,    // as i128 in two halves, by the runtime
+    FORMAT_UNSIGNED_128,  // as u128 in two halves, by the runtime
+    FORMAT_F32,
+    FORMAT_F64,
+    FORMAT_BOOL,    // "true" or "false", inline
+    FORMAT_CHAR,    // one byte, inline
+    FORMAT_STRING,  // a NUL-terminated char*, copied
+};
+
+// How a function hands back its result.
+enum class ResultPassing : std::uint8_t {
+    RESULT_VALUE,  // a scalar, returned as it is
+    RESULT_FIELD,  // a record with one scalar field, returned as that field
+    RESULT_SLOT,   // any other aggregate, written where the caller's first argument points
+};
+
+// Where formatted text goes.
+enum class TextTarget : std::uint8_t {
+    TEXT_NEW,     // a new NUL-terminated char*
+    TEXT_OUTPUT,  // the output buffer
+    TEXT_STRING,  // a string, whose text it replaces
+};
+
+// The text and length of a string, as read by compiled code.
+struct TextRef {
+    ValueId text = kNoValue;
+    ValueId length = kNoValue;
+};
+
+struct FormatPart {
+    FormatKind kind;
+    ValueId value = kNoValue;
+    ValueId length = kNoValue;  // strings only
+    ValueId high = kNoValue;    // 128-bit integers only: the upper 64 bits
+};
+
+// An expression result. Aggregates are represented by their address.
+struct RValue {
+    ValueId value = kNoValue;
+    TypePtr type;
+};
+
+// Something that can be assigned to: an SSA variable or a memory location.
+struct LValue {
+    std::uint32_t variable = kNoVariable;
+    ValueId address = kNoValue;
+    TypePtr type;
+    // Element `index` of the @soa array at `address`, which has no address of
+    // its own: reading it gathers its fields, writing it scatters them.
+    const SoaLayout* soa = nullptr;
+    ValueId index = kNoValue;
+};
+
+bool is_aggregate(const Type& type) {
+    return type.kind == TypeKind::TYPE_STRUCT || type.kind == TypeKind::TYPE_CLASS ||
+           type.kind == TypeKind::TYPE_ARRAY || type.kind == TypeKind::TYPE_STRING;
+}
+
+// The built-in `Arena` is a class without a declaration; its layout is the
+// runtime's PallasArena.
+bool is_arena(const Type& type) {
+    return type.kind == TypeKind::TYPE_CLASS && type.name == "Arena";
+}
+
+// `Vec<T>` is likewise the runtime's PallasVec, with the element type as its
+// one argument.
+bool is_vec(const Type& type) {
+    return type.kind == TypeKind::TYPE_CLASS && type.name == "Vec" && type.args.size() == 1;
+}
+
+// Strings and Vecs own their storage and free it at the end of their scope.
+bool owns_storage(const Type& type) {
+    return type.kind == TypeKind::TYPE_STRING || is_vec(type);
+}
+
+bool is_record(const Type& type) {
+    return (type.kind == TypeKind::TYPE_STRUCT || type.kind == TypeKind::TYPE_CLASS) &&
+           !is_arena(type) && !is_vec(type);
+}
+
+bool is_int_like(TypeKind kind) {
+    return frontend::is_integer(kind) || kind == TypeKind::TYPE_CHAR;
+}
+
+// A `char*` scrutinee holds a NUL-terminated string and matches string literals.
+bool is_string_pointer(const Type& type) {
+    return type.kind == TypeKind::TYPE_POINTER && type.element &&
+           type.element->kind == TypeKind::TYPE_CHAR;
+}
+
+// Scrutinees that string literals match: `char*` and `string`.
+bool matches_text(const Type& type) {
+    return is_string_pointer(type) || type.kind == TypeKind::TYPE_STRING;
+}
+
+bool same_type(const Type& a, const Type& b) {
+    if (a.kind != b.kind) {
+        return false;
+    }
+    switch (a.kind) {
+        case TypeKind::TYPE_POINTER:
+            // `null` has no pointee and converts to every pointer type.
+            return !a.element || !b.element || same_type(*a.element, *b.element);
+        case TypeKind::TYPE_ARRAY:
+            return a.array_size == b.array_size && a.soa == b.soa &&
+                   same_type(*a.element, *b.element);
+        case TypeKind::TYPE_STRUCT:
+        case TypeKind::TYPE_CLASS:
+            if (a.name != b.name || a.args.size() != b.args.size()) {
+                return false;
+            }
+            for (std::size_t i = 0; i < a.args.size(); ++i) {
+                if (!same_type(*a.args[i], *b.args[i])) {
+                    return false;
+                }
+            }
+            return true;
+        default:
+            return true;
+    }
+}
+
+IRType ir_type(const Type& type) {
+    switch (type.kind) {
+        case TypeKind::TYPE_VOID: return IRType::scalar(IRTypeKind::IR_VOID);
+        case TypeKind::TYPE_BOOL: return IRType::scalar(IRTypeKind::IR_I1);
+        case TypeKind::TYPE_CHAR:
+        case TypeKind::TYPE_I8:
+        case TypeKind::TYPE_U8: return IRType::scalar(IRTypeKind::IR_I8);
+        case TypeKind::TYPE_I16:
+        case TypeKind::TYPE_U16: return IRType::scalar(IRTypeKind::IR_I16);
+        case TypeKind::TYPE_I32:
+        case TypeKind::TYPE_U32: return IRType::scalar(IRTypeKind::IR_I32);
+        case TypeKind::TYPE_I64:
+        case TypeKind::TYPE_U64: return IRType::scalar(IRTypeKind::IR_I64);
+        case TypeKind::TYPE_I128:
+        case TypeKind::TYPE_U128: return IRType::scalar(IRTypeKind::IR_I128);
+        case TypeKind::TYPE_F32: return IRType::scalar(IRTypeKind::IR_F32);
+        case TypeKind::TYPE_F64: return IRType::scalar(IRTypeKind::IR_F64);
+        default: return IRType::scalar(IRTypeKind::IR_PTR);
+    }
+}
+
+TokenType compound_operator(TokenType op) {
+    switch (op) {
+        case TokenType::TOKEN_PLUS_ASSIGN: return TokenType::TOKEN_PLUS;
+        case TokenType::TOKEN_MINUS_ASSIGN: return TokenType::TOKEN_MINUS;
+        case TokenType::TOKEN_STAR_ASSIGN: return TokenType::TOKEN_STAR;
+        case TokenType::TOKEN_SLASH_ASSIGN: return TokenType::TOKEN_SLASH;
+        default: return op;
+    }
+}
+
+bool is_comparison(TokenType op) {
+    switch (op) {
+        case TokenType::TOKEN_EQUAL:
+        case TokenType::TOKEN_NOT_EQUAL:
+        case TokenType::TOKEN_LESS:
+        case TokenType::TOKEN_LESS_EQUAL:
+        case TokenType::TOKEN_GREATER:
+        case TokenType::TOKEN_GREATER_EQUAL:
+            return true;
+        default:
+            return false;
+    }
+}
+
+CmpPredicate predicate_for(TokenType op, bool fp, bool is_signed) {
+    switch (op) {
+        case TokenType::TOKEN_EQUAL:
+            return fp ? CmpPredicate::CMP_OEQ : CmpPredicate::CMP_EQ;
+        case TokenType::TOKEN_NOT_EQUAL:
+            return fp ? CmpPredicate::CMP_ONE : CmpPredicate::CMP_NE;
+        case TokenType::TOKEN_LESS:
+            return fp ? CmpPredicate::CMP_OLT
+                      : is_signed ? CmpPredicate::CMP_SLT : CmpPredicate::CMP_ULT;
+        case TokenType::TOKEN_LESS_EQUAL:
+            return fp ? CmpPredicate::CMP_OLE
+                      : is_signed ? CmpPredicate::CMP_SLE : CmpPredicate::CMP_ULE;
+        case TokenType::TOKEN_GREATER:
+            return fp ? CmpPredicate::CMP_OGT
+                      : is_signed ? CmpPredicate::CMP_SGT : CmpPredicate::CMP_UGT;
+        default:
+            return fp ? CmpPredicate::CMP_OGE
+                      : is_signed ? CmpPredicate::CMP_SGE : CmpPredicate::CMP_UGE;
+    }
+}
+
+// What lowering needs to know about a function body before it starts: the
+// last reference to each name in evaluation order (a by-value use there can
+// move instead of copy) and the one local that every `return` names, if there
+// is one, declared once and outside any loop (it can live in the caller's
+// result slot). Also the range-for loops over a local array whose body changes
+// neither the array nor the loop variable, which can then read the element in
+// place instead of copying it.
+class UseScan {
+  public:
+    explicit UseScan(const frontend::FunctionAST& function) {
+        for (const frontend::Param& param : function.proto->params) {
+            declared[param.name] += 2;  // never the returned local
+        }
+        if (function.body) {
+            stmt(function.body.get());
+        }
+        for (const auto& [name, use] : last) {
+            last_uses.insert(use);
+        }
+        auto found = declared.find(returned);
+        if (!one_returned || found == declared.end() || found->second != 1 ||
+            declared_in_loop.count(returned) != 0) {
+            returned.clear();
+        }
+    }
+
+    std::unordered_set<const frontend::VariableExprAST*> last_uses;
+    std::string returned;  // empty if there is no such local
+    std::unordered_set<const frontend::RangeForStmtAST*> read_only_loops;
+
+  private:
+    std::unordered_map<std::string, const frontend::VariableExprAST*> last;
+    std::unordered_map<std::string, int> declared;
+    std::unordered_set<std::string> declared_in_loop;
+    bool one_returned = true;
+    int loop_depth = 0;
+    // Range-for loops being scanned, and whether their body changes the array
+    // or the variable.
+    std::vector<std::pair<const frontend::RangeForStmtAST*, bool>> range_loops;
+
+    // The variable an assignment target or method receiver is part of.
+    static const frontend::VariableExprAST* root_of(const ExprAST* e) {
+        while (e != nullptr) {
+            if (e->kind == ExprKind::EXPR_MEMBER) {
+                e = static_cast<const frontend::MemberExprAST&>(*e).base.get();
+            } else if (e->kind == ExprKind::EXPR_INDEX) {
+                e = static_cast<const frontend::IndexExprAST&>(*e).base.get();
+            } else {
+                break;
+            }
+        }
+        return e != nullptr && e->kind == ExprKind::EXPR_VARIABLE
+                   ? static_cast<const frontend::VariableExprAST*>(e)
+                   : nullptr;
+    }
+
+    void modified(const ExprAST* target) {
+        const frontend::VariableExprAST* root = root_of(target);
+        for (auto& [loop, changed] : range_loops) {
+            const frontend::VariableExprAST* range = root_of(loop->range.get());
+            changed = changed || root == nullptr || root->name == loop->var ||
+                      (range != nullptr && root->name == range->name);
+        }
+    }
+
+    void expr(const ExprAST* e) {
+        if (e == nullptr) {
+            return;
+        }
+        switch (e->kind) {
+            case ExprKind::EXPR_VARIABLE: {
+                const auto& var = static_cast<const frontend::VariableExprAST&>(*e);
+                last[var.name] = &var;
+                return;
+            }
+            case ExprKind::EXPR_UNARY: {
+                const auto& unary = static_cast<const frontend::UnaryExprAST&>(*e);
+                if (unary.op == TokenType::TOKEN_PLUS_PLUS ||
+                    unary.op == TokenType::TOKEN_MINUS_MINUS) {
+                    modified(unary.operand.get());
+                }
+                expr(unary.operand.get());
+                return;
+            }
+            case ExprKind::EXPR_BINARY: {
+                const auto& binary = static_cast<const frontend::BinaryExprAST&>(*e);
+                expr(binary.lhs.get());
+                expr(binary.rhs.get());
+                return;
+            }
+            case ExprKind::EXPR_ASSIGN: {
+                const auto& assign = static_cast<const frontend::AssignExprAST&>(*e);
+                modified(assign.target.get());
+                expr(assign.target.get());
+                expr(assign.value.get());
+                return;
+            }
+            case ExprKind::EXPR_CALL: {
+                const auto& call = static_cast<const frontend::CallExprAST&>(*e);
+                if (call.callee->kind == ExprKind::EXPR_MEMBER) {
+                    modified(static_cast<const frontend::MemberExprAST&>(*call.callee).base.get());
+                    expr(call.callee.get());
+                }
+                for (const auto& arg : call.args) {
+                    expr(arg.get());
+                }
+                return;
+            }
+            case ExprKind::EXPR_INDEX: {
+                const auto& index = static_cast<const frontend::IndexExprAST&>(*e);
+                expr(index.base.get());
+                expr(index.index.get());
+                return;
+            }
+            case ExprKind::EXPR_MEMBER:
+                expr(static_cast<const frontend::MemberExprAST&>(*e).base.get());
+                return;
+            case ExprKind::EXPR_NEW: {
+                const auto& made = static_cast<const frontend::NewExprAST&>(*e);
+                expr(made.arena.get());
+                expr(made.count.get());
+                for (const auto& arg : made.args) {
+                    expr(arg.get());
+                }
+                return;
+            }
+            case ExprKind::EXPR_DELETE:
+                expr(static_cast<const frontend::DeleteExprAST&>(*e).operand.get());
+                return;
+            case ExprKind::EXPR_CAST:
+                expr(static_cast<const frontend::CastExprAST&>(*e).operand.get());
+                return;
+            case ExprKind::EXPR_ARRAY: {
+                const auto& array = static_cast<const frontend::ArrayExprAST&>(*e);
+                for (const auto& element : array.elements) {
+                    expr(element.get());
+                }
+                return;
+            }
+            case ExprKind::EXPR_INTERPOLATION: {
+                const auto& text = static_cast<const frontend::InterpolationExprAST&>(*e);
+                for (const auto& part : text.parts) {
+                    expr(part.get());
+                }
+                return;
+            }
+            default:
+                return;
+        }
+    }
+
+    void stmt(const StmtAST* s) {
+        if (s == nullptr) {
+            return;
+        }
+        switch (s->kind) {
+            case NodeType::NODE_BLOCK: {
+                const auto& block = static_cast<const frontend::BlockStmtAST&>(*s);
+                for (const auto& inner : block.statements) {
+                    stmt(inner.get());
+                }
+                return;
+            }
+            case NodeType::NODE_EXPR:
+                expr(static_cast<const frontend::ExprStmtAST&>(*s).expr.get());
+                return;
+            case NodeType::NODE_VAR_DECL:
+            case NodeType::NODE_CONST: {
+                const auto& decl = static_cast<const frontend::VarDeclAST&>(*s);
+                expr(decl.init.get());
+                declared[decl.name]++;
+                if (loop_depth > 0) {
+                    declared_in_loop.insert(decl.name);
+                }
+                return;
+            }
+            case NodeType::NODE_RETURN: {
+                const ExprAST* value = static_cast<const frontend::ReturnStmtAST&>(*s).value.get();
+                expr(value);
+                if (value == nullptr || value->kind != ExprKind::EXPR_VARIABLE) {
+                    one_returned = false;
+                    return;
+                }
+                const auto& name = static_cast<const frontend::VariableExprAST&>(*value).name;
+                one_returned = one_returned && (returned.empty() || returned == name);
+                returned = name;
+                return;
+            }
+            case NodeType::NODE_IF: {
+                const auto& branch = static_cast<const frontend::IfStmtAST&>(*s);
+                expr(branch.cond.get());
+                stmt(branch.then_branch.get());
+                stmt(branch.else_branch.get());
+                return;
+            }
+            case NodeType::NODE_WHILE: {
+                const auto& loop = static_cast<const frontend::WhileStmtAST&>(*s);
+                loop_depth++;
+                expr(loop.cond.get());
+                stmt(loop.body.get());
+                loop_depth--;
+                return;
+            }
+            case NodeType::NODE_FOR: {
+                const auto& loop = static_cast<const frontend::ForStmtAST&>(*s);
+                stmt(loop.init.get());
+                loop_depth++;
+                expr(loop.cond.get());
+                stmt(loop.body.get());
+                expr(loop.step.get());
+                loop_depth--;
+                return;
+            }
+            case NodeType::NODE_RANGE_FOR: {
+                const auto& loop = static_cast<const frontend::RangeForStmtAST&>(*s);
+                expr(loop.range.get());
+                loop_depth++;
+                declared_in_loop.insert(loop.var);
+                range_loops.emplace_back(&loop, false);
+                stmt(loop.body.get());
+                if (!range_loops.back().second && loop.range->kind == ExprKind::EXPR_VARIABLE) {
+                    read_only_loops.insert(&loop);
+                }
+                range_loops.pop_back();
+                loop_depth--;
+                return;
+            }
+            case NodeType::NODE_MATCH: {
+                const auto& match = static_cast<const frontend::MatchStmtAST&>(*s);
+                expr(match.scrutinee.get());
+                for (const frontend::MatchArm& arm : match.arms) {
+                    if (!arm.binding.empty()) {
+                        declared[arm.binding] += 2;
+                    }
+                    stmt(arm.body.get());
+                }
+                return;
+            }
+            case NodeType::NODE_ARENA: {
+                const auto& arena = static_cast<const frontend::ArenaStmtAST&>(*s);
+                expr(arena.capacity.get());
+                stmt(arena.body.get());
+                return;
+            }
+            default:
+                return;
+        }
+    }
+};
+
+class Lowering {
+  public:
+    Lowering(const frontend::ModuleAST& ast, frontend::ConstEvaluator& consts, LayoutEngine& layout,
+             frontend::Diagnostics* diagnostics, LowerOptions options)
+        : ast(ast), consts(consts), layout(layout), diagnostics(diagnostics), options(options) {}
+
+    std::unique_ptr<Module> run() {
+        support::TraceScope trace("lower");
+        module = std::make_unique<Module>();
+        collect_declarations();
+        declare_globals();
+        declare_functions();
+        declare_arena_finalizer();
+        for (Signature& sig : signatures) {
+            support::TraceScope function_trace("lower-function", sig.fn->name);
+            lower_function(sig);
+            function_trace.set_items(sig.fn->instruction_count());
+        }
+        if (arena_finalizer != nullptr) {
+            lower_arena_finalizer();
+        }
+        for (const Function* fn : dropped) {
+            module->remove_function(fn);
+        }
+        if (trace.active()) {
+            std::size_t instructions = 0;
+            for (const auto& fn : module->functions) {
+                instructions += fn->instruction_count();
+            }
+            trace.set_items(instructions);
+        }
+        return std::move(module);
+    }
+
+  private:
+    struct Signature {
+        const frontend::FunctionAST* ast = nullptr;
+        const frontend::StructDeclAST* owner = nullptr;
+        Function* fn = nullptr;
+        std::vector<TypePtr> params;  // without the object pointer
+        TypePtr ret;
+        ResultPassing result = ResultPassing::RESULT_VALUE;
+    };
+
+    struct GlobalVar {
+        SymbolId symbol = kNoSymbol;
+        TypePtr type;
+    };
+
+    struct Variable {
+        TypePtr type;
+        ValueId address = kNoValue;  // stack slot for aggregates, kNoValue for SSA values
+        ValueId arena = kNoValue;    // strings and Vecs: the arena block they were declared in
+        std::size_t loop_depth = 0;  // loops around its declaration
+        // A range-for variable that reads element `index` of the @soa array
+        // at `address` in place.
+        const SoaLayout* soa = nullptr;
+        ValueId index = kNoValue;
+    };
+
+    struct LoopTargets {
+        BlockId break_to = kNoBlock;
+        BlockId continue_to = kNoBlock;
+        std::size_t cleanups = 0;  // cleanups registered outside the loop
+    };
+
+    // An arena to release, a string or Vec to free, or a record whose
+    // destructor to run, when the scope at depth `scope` ends, or earlier when
+    // control leaves it by return, break or continue.
+    struct Cleanup {
+        ValueId object = kNoValue;
+        std::size_t scope = 0;
+        TypePtr type;  // Arena, string, Vec<T> or a record with a destructor
+        // Records: a bool variable, false once the object was moved from, so
+        // a moved-from object is not destroyed. It is constant wherever the
+        // move is unconditional, and then no test is emitted.
+        std::uint32_t live = kNoVariable;
+    };
+
+    // A type with a destructor. Objects of such types allocated in an arena
+    // are linked into the arena's finalizer list under their kind number.
+    struct Finalizable {
+        TypePtr type;
+        Signature* dtor = nullptr;
+    };
+
+    const frontend::ModuleAST& ast;
+    frontend::ConstEvaluator& consts;
+    LayoutEngine& layout;
+    frontend::Diagnostics* diagnostics = nullptr;
+    LowerOptions options;
+    std::unique_ptr<Module> module;
+
+    std::unordered_map<std::string, const frontend::StructDeclAST*> structs;
+    std::unordered_map<std::string, const frontend::TypeAliasAST*> aliases;
+    std::unordered_map<std::string, const frontend::VarDeclAST*> constants;
+    std::unordered_map<std::string, GlobalVar> globals;
+    std::vector<Signature> signatures;
+    std::unordered_map<std::string, std::size_t> signature_index;  // by IR name
+    std::vector<const Function*> dropped;
+    std::vector<Finalizable> finalizables;
+    std::unordered_map<std::string, std::uint32_t> finalizable_kinds;
+    Function* arena_finalizer = nullptr;
+    std::unordered_map<std::string, Function*> runtime_functions;
+    std::unordered_map<std::string, SymbolId> string_literals;
+    // is_untyped_literal of binary expressions, which every enclosing binary
+    // expression asks again.
+    std::unordered_map<const ExprAST*, bool> untyped_binaries;
+
+    // Per-function state.
+    Signature* current = nullptr;
+    Function* fn = nullptr;
+    BlockId block = kNoBlock;  // insertion block, kNoBlock after a terminator
+    ValueId self = kNoValue;   // object pointer in methods
+    bool failed = false;
+    std::vector<Variable> variables;
+    std::vector<std::unordered_map<std::string, std::uint32_t>> scopes;
+    std::vector<LoopTargets> loops;
+    std::vector<Cleanup> cleanups;
+    std::vector<ValueId> arenas;  // enclosing arena blocks, innermost last
+    std::size_t loop_depth = 0;
+    // Where a call or constructor builds an aggregate result when it is the
+    // whole initializer or return value (copy elision), or kNoValue.
+    ValueId aggregate_target = kNoValue;
+    ValueId result_slot = kNoValue;                      // RESULT_SLOT functions
+    std::uint32_t returned_variable = kNoVariable;       // lives in result_slot
+    std::unordered_set<ValueId> temporaries;             // aggregates calls built
+    std::unordered_set<const frontend::VariableExprAST*> last_uses;
+    std::unordered_set<const frontend::RangeForStmtAST*> read_only_loops;
+    std::string returned_name;
+    // Where `s.slice(a, b)` writes when it is the whole right-hand side of a
+    // string initialization or assignment.
+    struct {
+        ValueId string = kNoValue;
+        ValueId arena = kNoValue;
+    } slice_target;
+
+    // SSA construction state, indexed by block.
+    std::vector<std::unordered_map<std::uint32_t, ValueId>> defs;
+    std::vector<std::vector<BlockId>> preds;
+    std::vector<bool> sealed;
+    std::vector<std::vector<std::pair<std::uint32_t, ValueId>>> incomplete;
+
+    // -----------------------------------------------------------------------
+    // Diagnostics
+    // -----------------------------------------------------------------------
+
+    void error(ErrorCode code, const std::string& msg, SourceLocation loc) {
+        failed = true;
+        if (diagnostics != nullptr) {
+            diagnostics->report(frontend::Severity::Error, code, msg, "", loc.offset, 0, loc.line,
+                                loc.column);
+        }
+    }
+
+    void warning(ErrorCode code, const std::string& msg, SourceLocation loc) {
+        if (diagnostics != nullptr) {
+            diagnostics->report(frontend::Severity::Warning, code, msg, "", loc.offset, 0,
+                                loc.line, loc.column);
+        }
+    }
+
+    void unsupported(const std::string& what, SourceLocation loc) {
+        error(ErrorCode::E502_UNSUPPORTED_LOWERING, what + " cannot be lowered to IR yet", loc);
+    }
+
+    // -----------------------------------------------------------------------
+    // Types
+    // -----------------------------------------------------------------------
+
+    TypePtr resolve(const TypePtr& type, SourceLocation loc) {
+        if (!type) {
+            return frontend::make_type(TypeKind::TYPE_VOID);
+        }
+        switch (type->kind) {
+            case TypeKind::TYPE_UNKNOWN: {
+                TypeKind prim = frontend::primitive_from_name(type->name);
+                if (prim != TypeKind::TYPE_UNKNOWN) {
+                    return resolve(frontend::make_type(prim), loc);
+                }
+                auto alias = aliases.find(type->name);
+                if (alias != aliases.end() && alias->second->type_params.empty()) {
+                    return resolve(alias->second->aliased, loc);
+                }
+                if (type->name == "Arena") {
+                    return frontend::make_type(TypeKind::TYPE_CLASS, "Arena");
+                }
+                if (type->name == "Vec" && structs.count("Vec") == 0) {
+                    return resolve_vec(*type, loc);
+                }
+                auto found = structs.find(type->name);
+                if (found == structs.end()) {
+                    if (alias != aliases.end()) {
+                        unsupported("type '" + frontend::type_to_string(*type) + "'", loc);
+                    } else {
+                        error(ErrorCode::E401_UNKNOWN_TYPE,
+                              "unknown type '" + frontend::type_to_string(*type) + "'", loc);
+                    }
+                    return nullptr;
+                }
+                if (!found->second->type_params.empty() || !type->args.empty()) {
+                    unsupported("generic type '" + frontend::type_to_string(*type) + "'", loc);
+                    return nullptr;
+                }
+                return frontend::make_type(
+                    found->second->is_class ? TypeKind::TYPE_CLASS : TypeKind::TYPE_STRUCT,
+                    type->name);
+            }
+            case TypeKind::TYPE_POINTER:
+            case TypeKind::TYPE_ARRAY: {
+                TypePtr element = resolve(type->element, loc);
+                if (!element) {
+                    return nullptr;
+                }
+                if (type->kind == TypeKind::TYPE_ARRAY && !type->size_known) {
+                    unsupported("array without a constant size", loc);
+                    return nullptr;
+                }
+                if (type->kind == TypeKind::TYPE_ARRAY && owns_storage(*element)) {
+                    unsupported("array of '" + frontend::type_to_string(*element) + "'", loc);
+                    return nullptr;
+                }
+                bool soa = type->kind == TypeKind::TYPE_ARRAY && layout.is_soa(*type);
+                if (soa && !is_record(*element)) {
+                    error(ErrorCode::E403_INVALID_ATTRIBUTE,
+                          "@soa needs an array of structs, not of '" +
+                              frontend::type_to_string(*element) + "'",
+                          loc);
+                    return nullptr;
+                }
+                auto out = std::make_shared<Type>(*type);
+                out->element = element;
+                out->soa = soa;
+                return out;
+            }
+            case TypeKind::TYPE_REFERENCE:
+                unsupported("reference type", loc);
+                return nullptr;
+            case TypeKind::TYPE_FUNCTION:
+                unsupported("function type", loc);
+                return nullptr;
+            default:
+                return type;
+        }
+    }
+
+    // Vec<T>: T is stored by value and relocated with a byte copy, so it
+    // cannot own storage or need a destructor.
+    TypePtr resolve_vec(const Type& type, SourceLocation loc) {
+        if (type.args.size() != 1) {
+            error(ErrorCode::E401_UNKNOWN_TYPE, "'Vec' takes one type argument", loc);
+            return nullptr;
+        }
+        TypePtr element = resolve(type.args[0], loc);
+        if (!element) {
+            return nullptr;
+        }
+        bool destructor = is_record(*element) && find_signature(element->name + ".$dtor");
+        if (element->kind == TypeKind::TYPE_VOID || is_arena(*element) || owns_storage(*element) ||
+            destructor) {
+            unsupported("'Vec<" + frontend::type_to_string(*element) + ">'", loc);
+            return nullptr;
+        }
+        auto out = frontend::make_type(TypeKind::TYPE_CLASS, "Vec");
+        out->args.push_back(element);
+        return out;
+    }
+
+    TypePtr bool_type() { return frontend::make_type(TypeKind::TYPE_BOOL); }
+    TypePtr i64_type() { return frontend::make_type(TypeKind::TYPE_I64); }
+    TypePtr string_type() {
+        return frontend::make_pointer(frontend::make_type(TypeKind::TYPE_CHAR));
+    }
+
+    std::uint64_t size_of(const Type& type) { return layout.size_of(type); }
+
+    // -----------------------------------------------------------------------
+    // Declarations
+    // -----------------------------------------------------------------------
+
+    void collect_declarations() {
+        for (const auto& decl : ast.decls) {
+            switch (decl->kind) {
+                case NodeType::NODE_STRUCT: {
+                    const auto& s = static_cast<const frontend::StructDeclAST&>(*decl);
+                    structs[s.name] = &s;
+                    break;
+                }
+                case NodeType::NODE_TYPE_ALIAS: {
+                    const auto& a = static_cast<const frontend::TypeAliasAST&>(*decl);
+                    aliases[a.name] = &a;
+                    break;
+                }
+                case NodeType::NODE_CONST: {
+                    const auto& c = static_cast<const frontend::VarDeclAST&>(*decl);
+                    constants[c.name] = &c;
+                    break;
+                }
+                default:
+                    break;
+            }
+        }
+    }
+
+    void declare_globals() {
+        for (const auto& decl : ast.decls) {
+            if (decl->kind != NodeType::NODE_VAR_DECL) {
+                continue;
+            }
+            const auto& var = static_cast<const frontend::VarDeclAST&>(*decl);
+            TypePtr type = var.type ? resolve(var.type, var.loc) : nullptr;
+            std::optional<frontend::ConstValue> init;
+            if (var.init) {
+                init = consts.evaluate(*var.init, type.get());
+                if (!init) {
+                    continue;  // reported by the evaluator
+                }
+                if (!type) {
+                    type = frontend::make_type(init->type);
+                }
+            }
+            if (!type) {
+                continue;
+            }
+            if (is_aggregate(*type) || type->kind == TypeKind::TYPE_STRING) {
+                unsupported("global of type '" + frontend::type_to_string(*type) + "'", var.loc);
+                continue;
+            }
+            std::string bytes(size_of(*type), '\0');
+            if (init) {
+                std::uint64_t bits = constant_bits(*init, *type);
+                for (std::size_t i = 0; i < bytes.size() && i < 8; ++i) {
+                    bytes[i] = static_cast<char>((bits >> (8 * i)) & 0xff);
+                }
+                if (type->kind == TypeKind::TYPE_F32) {
+                    float f = static_cast<float>(init->real);
+                    std::uint32_t raw = std::bit_cast<std::uint32_t>(f);
+                    for (std::size_t i = 0; i < 4; ++i) {
+                        bytes[i] = static_cast<char>((raw >> (8 * i)) & 0xff);
+                    }
+                }
+            }
+            globals[var.name] = {module->add_global(var.name, std::move(bytes), false), type};
+        }
+    }
+
+    void declare_function(const frontend::FunctionAST& ast_fn,
+                          const frontend::StructDeclAST* owner) {
+        const frontend::PrototypeAST& proto = *ast_fn.proto;
+        if (!proto.type_params.empty() || (owner != nullptr && !owner->type_params.empty())) {
+            return;  // generic: lowered once instantiation exists
+        }
+        std::string name = proto.name;
+        if (owner != nullptr) {
+            switch (proto.function_kind) {
+                case frontend::FunctionKind::FUNCTION_CONSTRUCTOR: name = "$ctor"; break;
+                case frontend::FunctionKind::FUNCTION_DESTRUCTOR: name = "$dtor"; break;
+                default: break;
+            }
+            name = owner->name + "." + name;
+        }
+        Signature sig;
+        sig.ast = &ast_fn;
+        sig.owner = owner;
+        bool ok = true;
+        std::vector<IRType> param_types;
+        if (owner != nullptr) {
+            param_types.push_back(IRType::scalar(IRTypeKind::IR_PTR));
+        }
+        for (const frontend::Param& p : proto.params) {
+            TypePtr type = resolve(p.type, p.loc);
+            if (type && owns_storage(*type)) {
+                std::string name = frontend::type_to_string(*type);
+                error(ErrorCode::E405_TYPE_MISMATCH,
+                      "'" + name + "' cannot be passed by value; take a '" + name + "*'", p.loc);
+                type = nullptr;
+            }
+            ok = ok && type != nullptr;
+            if (type) {
+                sig.params.push_back(type);
+                std::vector<RegisterField> fields = register_fields(*type);
+                if (fields.empty()) {
+                    param_types.push_back(ir_type(*type));
+                }
+                for (const RegisterField& field : fields) {
+                    param_types.push_back(field.type);
+                }
+            }
+        }
+        sig.ret = resolve(proto.return_type, proto.loc);
+        if (sig.ret && (owns_storage(*sig.ret) || is_arena(*sig.ret))) {
+            unsupported("returning '" + frontend::type_to_string(*sig.ret) + "' by value",
+                        proto.loc);
+            sig.ret = nullptr;
+        }
+        if (!ok || !sig.ret) {
+            return;
+        }
+        IRType ret_type = ir_type(*sig.ret);
+        if (is_aggregate(*sig.ret)) {
+            std::vector<RegisterField> fields = register_fields(*sig.ret);
+            if (fields.size() == 1) {
+                sig.result = ResultPassing::RESULT_FIELD;
+                ret_type = fields[0].type;
+            } else {
+                sig.result = ResultPassing::RESULT_SLOT;
+                ret_type = IRType::scalar(IRTypeKind::IR_VOID);
+                param_types.insert(param_types.begin(), IRType::scalar(IRTypeKind::IR_PTR));
+            }
+        }
+        sig.fn = module->add_function(name, ret_type, param_types);
+        const auto& attrs = ast_fn.attributes;
+        if (frontend::find_attribute(attrs, "inline") != nullptr) {
+            sig.fn->flags |= FUNCTION_INLINE;
+        }
+        if (frontend::find_attribute(attrs, "noinline") != nullptr) {
+            sig.fn->flags |= FUNCTION_NOINLINE;
+        }
+        if ((sig.fn->flags & FUNCTION_INLINE) && (sig.fn->flags & FUNCTION_NOINLINE)) {
+            error(ErrorCode::E403_INVALID_ATTRIBUTE,
+                  "function '" + name + "' cannot be both @inline and @noinline", ast_fn.loc);
+        }
+        if (frontend::find_attribute(attrs, "bench") != nullptr) {
+            // palc bench calls it over and over with nothing to pass and
+            // nowhere to put an aggregate result.
+            bool slot = sig.result == ResultPassing::RESULT_SLOT;
+            if (owner != nullptr || !proto.params.empty() || slot) {
+                error(ErrorCode::E403_INVALID_ATTRIBUTE,
+                      "@bench function '" + name + "' must take no parameters and return a scalar "
+                      "or nothing",
+                      ast_fn.loc);
+            }
+            sig.fn->flags |= FUNCTION_BENCH;
+        }
+        const frontend::StmtAST* decl = &ast_fn;
+        if (owner != nullptr) {
+            decl = owner;
+        }
+        if (options.imported.count(decl) != 0) {
+            sig.fn->flags |= FUNCTION_EXTERN;  // defined by the module it comes from
+        }
+        signature_index[name] = signatures.size();
+        signatures.push_back(std::move(sig));
+    }
+
+    void declare_functions() {
+        for (const auto& decl : ast.decls) {
+            if (decl->kind == NodeType::NODE_FUNCTION) {
+                declare_function(static_cast<const frontend::FunctionAST&>(*decl), nullptr);
+            } else if (decl->kind == NodeType::NODE_STRUCT) {
+                const auto& s = static_cast<const frontend::StructDeclAST&>(*decl);
+                for (const auto& method : s.methods) {
+                    declare_function(*method, &s);
+                }
+            }
+        }
+    }
+
+    Signature* find_signature(const std::string& name) {
+        auto found = signature_index.find(name);
+        return found == signature_index.end() ? nullptr : &signatures[found->second];
+    }
+
+    // -----------------------------------------------------------------------
+    // SSA construction
+    // -----------------------------------------------------------------------
+
+    BlockId new_block() {
+        BlockId b = fn->add_block();
+        defs.resize(fn->num_blocks());
+        preds.resize(fn->num_blocks());
+        sealed.resize(fn->num_blocks(), false);
+        incomplete.resize(fn->num_blocks());
+        return b;
+    }
+
+    // Code after return/break/continue still needs a block; it has no
+    // predecessors and is deleted once the function is complete.
+    BlockId insertion_block() {
+        if (block == kNoBlock) {
+            block = new_block();
+            sealed[block] = true;
+        }
+        return block;
+    }
+
+    ValueId emit(Opcode op, IRType type, std::initializer_list<ValueId> operands = {}) {
+        return fn->append(insertion_block(), op, type, {operands.begin(), operands.size()});
+    }
+
+    void branch(BlockId to) {
+        if (block == kNoBlock) {
+            return;
+        }
+        fn->append(block, Opcode::OP_BR, IRType(), {}, {&to, 1});
+        preds[to].push_back(block);
+        block = kNoBlock;
+    }
+
+    void cond_branch(ValueId cond, BlockId if_true, BlockId if_false) {
+        BlockId from = insertion_block();
+        BlockId targets[] = {if_true, if_false};
+        fn->append(from, Opcode::OP_COND_BR, IRType(), {&cond, 1}, targets);
+        preds[if_true].push_back(from);
+        preds[if_false].push_back(from);
+        block = kNoBlock;
+    }
+
+    void seal(BlockId b) {
+        sealed[b] = true;
+        for (auto [var, phi] : incomplete[b]) {
+            add_phi_operands(var, phi);
+        }
+        incomplete[b].clear();
+    }
+
+    ValueId new_phi(BlockId b, IRType type) {
+        ValueId first = fn->block(b).first;
+        if (first == kNoValue) {
+            return fn->append(b, Opcode::OP_PHI, type);
+        }
+        return fn->insert_before(first, Opcode::OP_PHI, type);
+    }
+
+    void write_variable(std::uint32_t var, BlockId b, ValueId value) { defs[b][var] = value; }
+
+    ValueId read_variable(std::uint32_t var, BlockId b) {
+        auto found = defs[b].find(var);
+        if (found != defs[b].end()) {
+            return found->second;
+        }
+        IRType type = ir_type(*variables[var].type);
+        ValueId value;
+        if (!sealed[b]) {
+            value = new_phi(b, type);
+            incomplete[b].emplace_back(var, value);
+        } else if (preds[b].empty()) {
+            value = fn->undef(type);
+        } else if (preds[b].size() == 1) {
+            value = read_variable(var, preds[b][0]);
+        } else {
+            value = new_phi(b, type);
+            write_variable(var, b, value);  // breaks cycles through loops
+            add_phi_operands(var, value);
+        }
+        write_variable(var, b, value);
+        return value;
+    }
+
+    void add_phi_operands(std::uint32_t var, ValueId phi) {
+        BlockId b = fn->inst(phi).block;
+        for (BlockId p : preds[b]) {
+            fn->add_incoming(phi, read_variable(var, p), p);
+        }
+    }
+
+    // Phis whose incoming values are all the same (or the phi itself) are
+    // replaced by that value, repeatedly, since removing one can make another
+    // trivial.
+    void remove_trivial_phis() {
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (BlockId b : fn->block_order()) {
+                for (ValueId v : fn->block_insts(b)) {
+                    if (fn->inst(v).op != Opcode::OP_PHI) {
+                        break;
+                    }
+                    ValueId same = kNoValue;
+                    bool trivial = true;
+                    for (std::uint32_t i = 0; i < fn->num_operands(v) && trivial; ++i) {
+                        ValueId in = fn->operand(v, i);
+                        if (in == v || in == same) {
+                            continue;
+                        }
+                        trivial = same == kNoValue;
+                        same = in;
+                    }
+                    if (!trivial) {
+                        continue;
+                    }
+                    if (same == kNoValue) {
+                        same = fn->undef(fn->inst(v).type);
+                    }
+                    fn->replace_all_uses(v, same);
+                    fn->erase(v);
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    // -----------------------------------------------------------------------
+    // Scopes and variables
+    // -----------------------------------------------------------------------
+
+    std::uint32_t declare_variable(const std::string& name, TypePtr type) {
+        return bind_variable(name, type, is_aggregate(*type) ? stack_slot(*type) : kNoValue);
+    }
+
+    // Names `address`, which already holds an aggregate: a parameter, or a
+    // local that took over a temporary or a moved-from object.
+    std::uint32_t bind_variable(const std::string& name, TypePtr type, ValueId address) {
+        std::uint32_t id = static_cast<std::uint32_t>(variables.size());
+        Variable var;
+        var.type = type;
+        var.address = address;
+        var.loop_depth = loop_depth;
+        variables.push_back(var);
+        scopes.back()[name] = id;
+        return id;
+    }
+
+    Signature* destructor_of(const Type& type) {
+        Signature* dtor = is_record(type) ? find_signature(type.name + ".$dtor") : nullptr;
+        return dtor != nullptr && dtor->fn != nullptr ? dtor : nullptr;
+    }
+
+    // Runs the destructor of the record at `object`, if it has one, when the
+    // current scope ends, unless the object is moved from first.
+    void destroy_at_scope_end(ValueId object, const TypePtr& type) {
+        if (destructor_of(*type) == nullptr) {
+            return;
+        }
+        IRType i1 = IRType::scalar(IRTypeKind::IR_I1);
+        auto live = static_cast<std::uint32_t>(variables.size());
+        variables.push_back({bool_type()});  // not visible to the source
+        // False on paths that never reach the object's initialization.
+        write_variable(live, fn->entry(), fn->constant(i1, 0));
+        write_variable(live, insertion_block(), fn->constant(i1, 1));
+        cleanups.push_back({object, scopes.size(), type, live});
+    }
+
+    // Marks the object at `object` as moved from (or, with `live`, as holding
+    // a value again after an assignment), so its scope's end does (not)
+    // destroy it.
+    void set_live(ValueId object, bool live) {
+        for (auto it = cleanups.rbegin(); it != cleanups.rend(); ++it) {
+            if (it->object == object && it->live != kNoVariable) {
+                write_variable(it->live, insertion_block(),
+                               fn->constant(IRType::scalar(IRTypeKind::IR_I1), live ? 1 : 0));
+                return;
+            }
+        }
+    }
+
+    // Runs the destructor of a record cleanup unless its object was moved from.
+    void destroy(const Cleanup& cleanup) {
+        Signature* dtor = destructor_of(*cleanup.type);
+        ValueId live = read_variable(cleanup.live, insertion_block());
+        const Inst& flag = fn->inst(live);
+        if (flag.op == Opcode::OP_CONST) {
+            if ((flag.imm & 1) != 0) {
+                call(*dtor, cleanup.object, {}, SourceLocation{});
+            }
+            return;
+        }
+        BlockId run = new_block();
+        BlockId join = new_block();
+        cond_branch(live, run, join);
+        seal(run);
+        block = run;
+        call(*dtor, cleanup.object, {}, SourceLocation{});
+        branch(join);
+        seal(join);
+        block = join;
+    }
+
+    // The by-value aggregate `expr` (already lowered to `value`) will not be
+    // used again: a temporary a call built, or a local's last use outside any
+    // loop the local was declared outside of. It can be moved, not copied.
+    bool is_dead_after(const ExprAST& expr, ValueId value) {
+        if (temporaries.count(value) != 0) {
+            return true;
+        }
+        if (expr.kind != ExprKind::EXPR_VARIABLE ||
+            last_uses.count(static_cast<const frontend::VariableExprAST*>(&expr)) == 0) {
+            return false;
+        }
+        const auto& name = static_cast<const frontend::VariableExprAST&>(expr).name;
+        std::uint32_t id = lookup_variable(name);
+        return id != kNoVariable && id != returned_variable && variables[id].address == value &&
+               variables[id].loop_depth == loop_depth;
+    }
+
+    std::uint32_t lookup_variable(const std::string& name) const {
+        for (auto it = scopes.rbegin(); it != scopes.rend(); ++it) {
+            auto found = it->find(name);
+            if (found != it->end()) {
+                return found->second;
+            }
+        }
+        return kNoVariable;
+    }
+
+    // Stack slots go to the top of the entry block so that a slot declared in a
+    // loop is allocated once per call.
+    ValueId stack_slot(const Type& type) {
+        return stack_slot(size_of(type), layout.align_of(type));
+    }
+
+    ValueId stack_slot(std::uint64_t size, std::uint64_t align) {
+        BlockId entry = fn->entry();
+        IRType ptr = IRType::scalar(IRTypeKind::IR_PTR);
+        ValueId first = fn->block(entry).first;
+        ValueId slot = first == kNoValue ? fn->append(entry, Opcode::OP_ALLOCA, ptr)
+                                         : fn->insert_before(first, Opcode::OP_ALLOCA, ptr);
+        fn->inst(slot).imm = std::max<std::uint64_t>(size, 1);
+        fn->inst(slot).aux = static_cast<std::uint32_t>(align);
+        return slot;
+    }
+
+    // -----------------------------------------------------------------------
+    // Functions
+    // -----------------------------------------------------------------------
+
+    // Resets the per-function state and opens the entry block of `f`.
+    void begin_function(Function* f, Signature* sig) {
+        current = sig;
+        fn = f;
+        failed = false;
+        variables.clear();
+        scopes.assign(1, {});
+        loops.clear();
+        cleanups.clear();
+        arenas.clear();
+        loop_depth = 0;
+        aggregate_target = kNoValue;
+        result_slot = kNoValue;
+        returned_variable = kNoVariable;
+        temporaries.clear();
+        defs.clear();
+        preds.clear();
+        sealed.clear();
+        incomplete.clear();
+        self = kNoValue;
+        BlockId entry = new_block();
+        sealed[entry] = true;
+        block = entry;
+    }
+
+    void finish_function() {
+        for (BlockId b : fn->block_order()) {
+            if (!sealed[b]) {
+                seal(b);
+            }
+        }
+        remove_trivial_phis();
+        remove_unreachable_blocks(*fn);
+        if (failed) {
+            dropped.push_back(fn);
+        }
+        fn = nullptr;
+        current = nullptr;
+    }
+
+    void lower_function(Signature& sig) {
+        if (sig.fn == nullptr || (sig.fn->flags & FUNCTION_EXTERN) != 0) {
+            return;
+        }
+        begin_function(sig.fn, &sig);
+        UseScan uses(*sig.ast);
+        last_uses = std::move(uses.last_uses);
+        read_only_loops = std::move(uses.read_only_loops);
+        returned_name = sig.result == ResultPassing::RESULT_SLOT ? uses.returned : std::string();
+        std::size_t arg = 0;
+        if (sig.result == ResultPassing::RESULT_SLOT) {
+            result_slot = fn->arg(arg++);
+        }
+        if (sig.owner != nullptr) {
+            self = fn->arg(arg++);
+        }
+        const auto& params = sig.ast->proto->params;
+        for (std::size_t i = 0; i < params.size(); ++i) {
+            const TypePtr& type = sig.params[i];
+            if (!is_aggregate(*type)) {
+                write_variable(declare_variable(params[i].name, type), block, fn->arg(arg++));
+                continue;
+            }
+            // The callee owns what it receives: a private copy, or the
+            // caller's object moved in. Records that came as their fields
+            // are put back together in a slot of their own.
+            ValueId object = kNoValue;
+            std::vector<RegisterField> fields = register_fields(*type);
+            if (fields.empty()) {
+                object = fn->arg(arg++);
+            } else {
+                object = stack_slot(*type);
+                for (const RegisterField& field : fields) {
+                    store(fn->arg(arg++), offset_address(object, field.offset));
+                }
+            }
+            bind_variable(params[i].name, type, object);
+            destroy_at_scope_end(object, type);
+        }
+        if (sig.ast->body) {
+            lower_block(*sig.ast->body);
+        }
+        if (block != kNoBlock) {
+            if (sig.ret->kind == TypeKind::TYPE_VOID) {
+                run_cleanups(0);  // by-value parameters
+                emit(Opcode::OP_RET, IRType());
+            } else {
+                emit(Opcode::OP_UNREACHABLE, IRType());  // falls off the end of a non-void function
+            }
+            block = kNoBlock;
+        }
+        finish_function();
+    }
+
+    // -----------------------------------------------------------------------
+    // Statements
+    // -----------------------------------------------------------------------
+
+    void lower_block(const frontend::BlockStmtAST& body) {
+        scopes.emplace_back();
+        for (const auto& stmt : body.statements) {
+            lower_stmt(*stmt);
+        }
+        pop_scope();
+    }
+
+    // Ends the innermost scope, releasing the arenas, strings and Vecs it owns.
+    void pop_scope() {
+        std::size_t keep = cleanups.size();
+        while (keep > 0 && cleanups[keep - 1].scope >= scopes.size()) {
+            --keep;
+        }
+        run_cleanups(keep);
+        cleanups.resize(keep);
+        scopes.pop_back();
+    }
+
+    // Runs, innermost first, the cleanups registered after the first `keep`.
+    // Control is leaving their scopes, so the code path after this one (if
+    // any) is a terminator.
+    void run_cleanups(std::size_t keep) {
+        if (block == kNoBlock) {
+            return;
+        }
+        for (std::size_t i = cleanups.size(); i-- > keep;) {
+            const Cleanup& cleanup = cleanups[i];
+            if (is_arena(*cleanup.type)) {
+                release_arena(cleanup.object);
+            } else if (cleanup.live != kNoVariable) {
+                destroy(cleanup);
+            } else {
+                free_storage(cleanup.object, *cleanup.type);
+            }
+        }
+    }
+
+    void lower_stmt(const StmtAST& stmt) {
+        switch (stmt.kind) {
+            case NodeType::NODE_BLOCK:
+                lower_block(static_cast<const frontend::BlockStmtAST&>(stmt));
+                return;
+            case NodeType::NODE_EXPR:
+                lower_expr(*static_cast<const frontend::ExprStmtAST&>(stmt).expr, nullptr);
+                return;
+            case NodeType::NODE_VAR_DECL:
+            case NodeType::NODE_CONST:
+                lower_var_decl(static_cast<const frontend::VarDeclAST&>(stmt));
+                return;
+            case NodeType::NODE_RETURN:
+                lower_return(static_cast<const frontend::ReturnStmtAST&>(stmt));
+                return;
+            case NodeType::NODE_IF:
+                lower_if(static_cast<const frontend::IfStmtAST&>(stmt));
+                return;
+            case NodeType::NODE_WHILE:
+                lower_while(static_cast<const frontend::WhileStmtAST&>(stmt));
+                return;
+            case NodeType::NODE_FOR:
+                lower_for(static_cast<const frontend::ForStmtAST&>(stmt));
+                return;
+            case NodeType::NODE_BREAK:
+            case NodeType::NODE_CONTINUE:
+                if (loops.empty()) {
+                    error(ErrorCode::E201_UNEXPECTED_TOKEN,
+                          stmt.kind == NodeType::NODE_BREAK ? "'break' outside of a loop"
+                                                            : "'continue' outside of a loop",
+                          stmt.loc);
+                    return;
+                }
+                run_cleanups(loops.back().cleanups);
+                branch(stmt.kind == NodeType::NODE_BREAK ? loops.back().break_to
+                                                         : loops.back().continue_to);
+                return;
+            case NodeType::NODE_MATCH:
+                lower_match(static_cast<const frontend::MatchStmtAST&>(stmt));
+                return;
+            case NodeType::NODE_ARENA:
+                lower_arena_block(static_cast<const frontend::ArenaStmtAST&>(stmt));
+                return;
+            case NodeType::NODE_RANGE_FOR:
+                lower_range_for(static_cast<const frontend::RangeForStmtAST&>(stmt));
+                return;
+            default:
+                unsupported("nested declaration", stmt.loc);
+                return;
+        }
+    }
+
+    void lower_var_decl(const frontend::VarDeclAST& decl) {
+        TypePtr type = decl.type ? resolve(decl.type, decl.loc) : nullptr;
+        if (decl.type && !type) {
+            return;
+        }
+        if ((type && is_arena(*type)) ||
+            (!type && decl.init && arena_constructor(*decl.init) != nullptr)) {
+            declare_arena_variable(decl);
+            return;
+        }
+        if ((type && owns_storage(*type)) ||
+            (!type && decl.init && vec_constructor(*decl.init) != nullptr)) {
+            declare_owner(decl, type);
+            return;
+        }
+        if (!type && !decl.init) {
+            error(ErrorCode::E203_EXPECTED_TYPE, "variable '" + decl.name + "' needs a type",
+                  decl.loc);
+            return;
+        }
+        if (type && type->kind == TypeKind::TYPE_ARRAY && decl.init &&
+            decl.init->kind == ExprKind::EXPR_ARRAY) {
+            std::uint32_t var = declare_variable(decl.name, type);
+            store_array_literal(variables[var].address, *type,
+                                static_cast<const frontend::ArrayExprAST&>(*decl.init));
+            return;
+        }
+        RValue init;
+        ValueId target = kNoValue;
+        if (decl.init) {
+            if (type && is_aggregate(*type) && decl.init->kind == ExprKind::EXPR_CALL) {
+                bool returned = decl.name == returned_name && same_type(*type, *current->ret);
+                target = returned ? result_slot : stack_slot(*type);
+                aggregate_target = target;
+            }
+            init = lower_expr(*decl.init, type);
+            aggregate_target = kNoValue;
+            if (init.value == kNoValue) {
+                return;
+            }
+            if (!type) {
+                type = init.type;
+            } else {
+                init = convert(init, type, decl.init->loc);
+            }
+        } else if (!is_aggregate(*type)) {
+            init = {zero(*type), type};
+        }
+        if (type->kind == TypeKind::TYPE_VOID) {
+            error(ErrorCode::E405_TYPE_MISMATCH, "variable '" + decl.name + "' has type void",
+                  decl.loc);
+            return;
+        }
+        if (owns_storage(*type)) {
+            // Inferred from another string or Vec, which is copied, not shared.
+            declare_owner(decl, type, &init);
+            return;
+        }
+        if (is_aggregate(*type)) {
+            declare_aggregate(decl, type, init, target);
+            return;
+        }
+        std::uint32_t var = declare_variable(decl.name, type);
+        if (init.value != kNoValue) {
+            write_variable(var, insertion_block(), init.value);
+        }
+    }
+
+    // The storage of an aggregate local is, in order of preference: what the
+    // initializing call built in place, the caller's result slot for the local
+    // every `return` names, the temporary or moved-from local it is
+    // initialized from, or a slot of its own the initializer is copied to.
+    void declare_aggregate(const frontend::VarDeclAST& decl, const TypePtr& type,
+                           const RValue& init, ValueId target) {
+        bool returned = decl.name == returned_name && same_type(*type, *current->ret);
+        bool moved = init.value != kNoValue && is_dead_after(*decl.init, init.value);
+        ValueId address = kNoValue;
+        if (init.value != kNoValue && init.value == target) {
+            address = target;
+        } else if (moved && !returned) {
+            address = init.value;
+        } else {
+            address = returned ? result_slot : stack_slot(*type);
+            if (init.value != kNoValue) {
+                copy_memory(address, init.value, *type);
+            } else {
+                zero_memory(address, *type);
+            }
+        }
+        if (moved) {
+            set_live(init.value, false);
+        }
+        std::uint32_t var = bind_variable(decl.name, type, address);
+        if (returned) {
+            returned_variable = var;  // the caller destroys it
+        } else {
+            destroy_at_scope_end(address, type);
+        }
+    }
+
+    void lower_return(const frontend::ReturnStmtAST& stmt) {
+        TypePtr ret = current->ret;
+        if (!stmt.value) {
+            if (ret->kind != TypeKind::TYPE_VOID) {
+                error(ErrorCode::E405_TYPE_MISMATCH, "missing return value", stmt.loc);
+            }
+            run_cleanups(0);
+            emit(Opcode::OP_RET, IRType());
+            block = kNoBlock;
+            return;
+        }
+        if (is_aggregate(*ret)) {
+            return_aggregate(*stmt.value);
+            return;
+        }
+        RValue value = lower_expr(*stmt.value, ret);
+        if (value.value == kNoValue) {
+            return;
+        }
+        value = convert(value, ret, stmt.loc);
+        run_cleanups(0);
+        emit(Opcode::OP_RET, IRType(), {value.value});
+        block = kNoBlock;
+    }
+
+    // An aggregate result goes to the caller's slot, or back as its one field.
+    // A returned call builds it in the slot directly; a returned local or
+    // temporary is moved, so not destroyed here, and the local that lives in
+    // the slot already is the result.
+    void return_aggregate(const ExprAST& expr) {
+        const TypePtr& ret = current->ret;
+        bool slot = current->result == ResultPassing::RESULT_SLOT;
+        std::uint32_t local = kNoVariable;
+        if (expr.kind == ExprKind::EXPR_VARIABLE) {
+            local = lookup_variable(static_cast<const frontend::VariableExprAST&>(expr).name);
+        }
+        ValueId result = kNoValue;
+        if (local == kNoVariable || local != returned_variable) {
+            aggregate_target = slot && expr.kind == ExprKind::EXPR_CALL ? result_slot : kNoValue;
+            RValue value = lower_expr(expr, ret);
+            aggregate_target = kNoValue;
+            if (value.value == kNoValue) {
+                return;
+            }
+            value = convert(value, ret, expr.loc);
+            if (value.value == kNoValue) {
+                return;
+            }
+            if ((local != kNoVariable && variables[local].address == value.value) ||
+                is_dead_after(expr, value.value)) {
+                set_live(value.value, false);
+            }
+            if (!slot) {
+                RegisterField field = register_fields(*ret)[0];
+                result = emit(Opcode::OP_LOAD, field.type,
+                              {offset_address(value.value, field.offset)});
+            } else if (value.value != result_slot) {
+                copy_memory(result_slot, value.value, *ret);
+            }
+        }
+        run_cleanups(0);
+        if (result != kNoValue) {
+            emit(Opcode::OP_RET, IRType(), {result});
+        } else {
+            emit(Opcode::OP_RET, IRType());
+        }
+        block = kNoBlock;
+    }
+
+    ValueId lower_condition(const ExprAST& expr) {
+        RValue cond = lower_expr(expr, bool_type());
+        if (cond.value == kNoValue) {
+            return fn->undef(IRType::scalar(IRTypeKind::IR_I1));
+        }
+        if (cond.type->kind != TypeKind::TYPE_BOOL) {
+            error(ErrorCode::E405_TYPE_MISMATCH,
+                  "condition must be bool, found '" + frontend::type_to_string(*cond.type) + "'",
+                  expr.loc);
+            return fn->undef(IRType::scalar(IRTypeKind::IR_I1));
+        }
+        return cond.value;
+    }
+
+    void lower_if(const frontend::IfStmtAST& stmt) {
+        ValueId cond = lower_condition(*stmt.cond);
+        BlockId then_block = new_block();
+        BlockId else_block = stmt.else_branch ? new_block() : kNoBlock;
+        BlockId join = new_block();
+        cond_branch(cond, then_block, else_block != kNoBlock ? else_block : join);
+        seal(then_block);
+        block = then_block;
+        lower_stmt(*stmt.then_branch);
+        branch(join);
+        if (else_block != kNoBlock) {
+            seal(else_block);
+            block = else_block;
+            lower_stmt(*stmt.else_branch);
+            branch(join);
+        }
+        seal(join);
+        block = join;
+    }
+
+    // Emits the header, body, latch and exit blocks of a loop and continues in
+    // the exit. `cond` emits the test in the header and returns it, kNoValue for
+    // an endless loop; `step` fills the latch, which is where 'continue' goes.
+    // Without a step the body branches straight back to the header.
+    template <typename Cond, typename Body, typename Step>
+    void emit_loop(Cond&& cond, Body&& body, Step&& step, bool has_step) {
+        BlockId header = new_block();
+        BlockId body_block = new_block();
+        BlockId latch = has_step ? new_block() : header;
+        BlockId exit = new_block();
+        branch(header);
+        block = header;
+        loop_depth++;  // the condition and step run once per iteration too
+        ValueId test = cond();
+        if (test != kNoValue) {
+            cond_branch(test, body_block, exit);
+        } else {
+            branch(body_block);
+        }
+        seal(body_block);
+        block = body_block;
+        loops.push_back({exit, latch, cleanups.size()});
+        body();
+        loops.pop_back();
+        branch(latch);
+        if (has_step) {
+            seal(latch);
+            block = latch;
+            step();
+            branch(header);
+        }
+        loop_depth--;
+        seal(header);
+        seal(exit);
+        block = exit;
+    }
+
+    void lower_loop(const ExprAST* cond, const StmtAST& body, const ExprAST* step) {
+        emit_loop([&] { return cond != nullptr ? lower_condition(*cond) : kNoValue; },
+                  [&] { lower_stmt(body); },
+                  [&] { lower_expr(*step, nullptr); }, step != nullptr);
+    }
+
+    // Runs `body` with an i64 index counting from 0 to count - 1.
+    template <typename Body>
+    void counted_loop(std::uint64_t count, Body&& body) {
+        counted_loop(fn->constant(IRType::scalar(IRTypeKind::IR_I64), count), body);
+    }
+
+    template <typename Body>
+    void counted_loop(ValueId count, Body&& body) {
+        IRType i64 = IRType::scalar(IRTypeKind::IR_I64);
+        variables.push_back({i64_type(), kNoValue});  // not visible to the source
+        std::uint32_t index = static_cast<std::uint32_t>(variables.size() - 1);
+        write_variable(index, insertion_block(), fn->constant(i64, 0));
+        emit_loop(
+            [&] {
+                ValueId i = read_variable(index, insertion_block());
+                ValueId v = emit(Opcode::OP_ICMP, IRType::scalar(IRTypeKind::IR_I1), {i, count});
+                fn->inst(v).aux = static_cast<std::uint32_t>(CmpPredicate::CMP_SLT);
+                return v;
+            },
+            [&] { body(read_variable(index, insertion_block())); },
+            [&] {
+                ValueId i = read_variable(index, insertion_block());
+                write_variable(index, insertion_block(),
+                               emit(Opcode::OP_ADD, i64, {i, fn->constant(i64, 1)}));
+            },
+            true);
+    }
+
+    void lower_while(const frontend::WhileStmtAST& stmt) {
+        lower_loop(stmt.cond.get(), *stmt.body, nullptr);
+    }
+
+    // for (x : array) visits the elements in order; x is a copy of the element.
+    // Over a @soa array x is gathered from the field arrays, or, when the body
+    // changes neither x nor a local array, reads the element in place, so that
+    // each field x.f is a load from a contiguous stream.
+    void lower_range_for(const frontend::RangeForStmtAST& stmt) {
+        RValue range = lower_expr(*stmt.range, nullptr);
+        if (range.value == kNoValue) {
+            return;
+        }
+        if (const Type* owner = storage_owner(*range.type)) {
+            lower_owner_range_for(stmt, range.value, *owner);
+            return;
+        }
+        if (range.type->kind != TypeKind::TYPE_ARRAY || !range.type->element) {
+            unsupported("range-based for over '" + frontend::type_to_string(*range.type) + "'",
+                        stmt.range->loc);
+            return;
+        }
+        TypePtr element = range.type->element;
+        const SoaLayout* soa = layout.soa_layout_of(*range.type);
+        bool in_place =
+            soa != nullptr && read_only_loops.count(&stmt) != 0 &&
+            lookup_variable(static_cast<const frontend::VariableExprAST&>(*stmt.range).name) !=
+                kNoVariable;
+        scopes.emplace_back();
+        counted_loop(range.type->array_size, [&](ValueId index) {
+            // Checked like any other index; bounds-check elimination proves it.
+            array_index({index, i64_type()}, *range.type);
+            if (in_place) {
+                std::uint32_t var = bind_variable(stmt.var, element, range.value);
+                variables[var].soa = soa;
+                variables[var].index = index;
+                lower_stmt(*stmt.body);
+                return;
+            }
+            std::uint32_t var = declare_variable(stmt.var, element);
+            if (soa != nullptr) {
+                copy_soa_element(soa_element(range.value, *soa, element, index),
+                                 variables[var].address, false);
+                lower_stmt(*stmt.body);
+                return;
+            }
+            ValueId address = element_address(range.value, index, *element);
+            if (variables[var].address != kNoValue) {
+                copy_memory(variables[var].address, address, *element);
+            } else {
+                write_variable(var, insertion_block(), load(address, *element));
+            }
+            lower_stmt(*stmt.body);
+        });
+        pop_scope();
+    }
+
+    void lower_for(const frontend::ForStmtAST& stmt) {
+        scopes.emplace_back();
+        if (stmt.init) {
+            lower_stmt(*stmt.init);
+        }
+        lower_loop(stmt.cond.get(), *stmt.body, stmt.step.get());
+        pop_scope();
+    }
+
+    // -----------------------------------------------------------------------
+    // Match
+    // -----------------------------------------------------------------------
+
+    // A literal arm: the IR constant bits (or the text, for strings) it
+    // matches and the block its body starts in.
+    struct MatchCase {
+        std::uint64_t bits = 0;
+        std::string text;
+        BlockId target = kNoBlock;
+    };
+
+    // The scrutinee is evaluated once. The first wildcard or binding arm
+    // catches everything the literal arms before it do not; without one, an
+    // unmatched value skips the match. The literal arms are selected by a
+    // dispatch that does not test them one by one: see emit_int_dispatch and
+    // emit_string_dispatch. An arm that can never be selected is reported and
+    // lowered into a block without predecessors, so it is still checked.
+    void lower_match(const frontend::MatchStmtAST& stmt) {
+        RValue scrutinee = lower_expr(*stmt.scrutinee, nullptr);
+        if (scrutinee.value == kNoValue) {
+            return;
+        }
+        const Type& type = *scrutinee.type;
+        if ((is_aggregate(type) && type.kind != TypeKind::TYPE_STRING) ||
+            type.kind == TypeKind::TYPE_VOID) {
+            error(ErrorCode::E405_TYPE_MISMATCH,
+                  "cannot match on '" + frontend::type_to_string(type) + "'", stmt.scrutinee->loc);
+            return;
+        }
+        if (type.kind == TypeKind::TYPE_I128 || type.kind == TypeKind::TYPE_U128) {
+            unsupported("match on a 128-bit integer", stmt.scrutinee->loc);
+            return;
+        }
+        std::vector<MatchCase> cases;
+        std::vector<BlockId> targets;  // per arm, kNoBlock if unreachable
+        std::map<std::uint64_t, bool> seen_bits;
+        std::map<std::string, bool> seen_text;
+        BlockId fallback = kNoBlock;
+        for (const frontend::MatchArm& arm : stmt.arms) {
+            BlockId target = kNoBlock;
+            if (fallback != kNoBlock) {
+                warning(ErrorCode::E407_UNREACHABLE_PATTERN,
+                        "unreachable match arm: an earlier arm matches every value", arm.loc);
+            } else if (arm.pattern != frontend::PatternKind::PATTERN_LITERAL) {
+                fallback = target = new_block();
+            } else if (std::optional<MatchCase> c = match_literal(*arm.literal, scrutinee.type)) {
+                bool fresh = matches_text(type) ? seen_text.emplace(c->text, true).second
+                                                : seen_bits.emplace(c->bits, true).second;
+                if (fresh) {
+                    c->target = target = new_block();
+                    cases.push_back(std::move(*c));
+                } else {
+                    warning(ErrorCode::E407_UNREACHABLE_PATTERN,
+                            "unreachable match arm: an earlier arm matches this value", arm.loc);
+                }
+            }
+            targets.push_back(target);
+        }
+        BlockId join = new_block();
+        BlockId otherwise = fallback != kNoBlock ? fallback : join;
+        if (type.kind == TypeKind::TYPE_STRING) {
+            TextRef view = string_view(scrutinee.value);
+            emit_string_dispatch(view.text, view.length, cases, otherwise);
+        } else if (is_string_pointer(type)) {
+            emit_string_dispatch(scrutinee.value, kNoValue, cases, otherwise);
+        } else if (frontend::is_float(type.kind)) {
+            emit_float_dispatch(scrutinee.value, cases, otherwise);
+        } else {
+            emit_int_dispatch(scrutinee.value, type, cases, otherwise);
+        }
+        for (std::size_t i = 0; i < stmt.arms.size(); ++i) {
+            const frontend::MatchArm& arm = stmt.arms[i];
+            if (targets[i] != kNoBlock) {
+                seal(targets[i]);
+            }
+            block = targets[i];
+            scopes.emplace_back();
+            if (arm.pattern == frontend::PatternKind::PATTERN_IDENTIFIER &&
+                type.kind == TypeKind::TYPE_STRING) {
+                bind_string_copy(arm.binding, scrutinee, arm.loc);
+            } else if (arm.pattern == frontend::PatternKind::PATTERN_IDENTIFIER) {
+                std::uint32_t var = declare_variable(arm.binding, scrutinee.type);
+                write_variable(var, insertion_block(), scrutinee.value);
+            }
+            lower_block(*arm.body);
+            pop_scope();
+            branch(join);
+        }
+        seal(join);
+        block = join;
+    }
+
+    // A binding arm names a copy of a `string` scrutinee, freed when the arm
+    // ends, as a local initialized from it would be.
+    void bind_string_copy(const std::string& name, const RValue& value, SourceLocation loc) {
+        ValueId object = stack_slot(*value.type);
+        ValueId arena = arenas.empty() ? kNoValue : arenas.back();
+        zero_memory(object, *value.type);
+        cleanups.push_back({object, scopes.size(), value.type});
+        assign_value(object, value, arena_or_null(arena), loc);
+        variables.push_back({value.type, object, arena});
+        scopes.back()[name] = static_cast<std::uint32_t>(variables.size() - 1);
+    }
+
+    // The constant a literal pattern stands for, checked against the type of
+    // the scrutinee; nothing after reporting an error.
+    std::optional<MatchCase> match_literal(const ExprAST& literal, const TypePtr& type) {
+        bool string = matches_text(*type);
+        std::optional<frontend::ConstValue> value =
+            consts.evaluate(literal, string ? nullptr : type.get());
+        if (!value) {
+            failed = true;
+            return std::nullopt;
+        }
+        if (value->type != (string ? TypeKind::TYPE_STRING : type->kind)) {
+            error(ErrorCode::E405_TYPE_MISMATCH,
+                  "a pattern of type '" +
+                      frontend::type_to_string(*frontend::make_type(value->type)) +
+                      "' cannot match '" + frontend::type_to_string(*type) + "'",
+                  literal.loc);
+            return std::nullopt;
+        }
+        MatchCase c;
+        if (string) {
+            c.text = value->text;
+        } else {
+            c.bits = fn->inst(constant_from(*value, *type)).imm;
+        }
+        return c;
+    }
+
+    ValueId emit_compare(CmpPredicate pred, ValueId a, ValueId b) {
+        bool fp = is_float(fn->inst(a).type);
+        ValueId v = emit(fp ? Opcode::OP_FCMP : Opcode::OP_ICMP,
+                         IRType::scalar(IRTypeKind::IR_I1), {a, b});
+        fn->inst(v).aux = static_cast<std::uint32_t>(pred);
+        return v;
+    }
+
+    // Sorts the cases and splits them into clusters (see cluster_cases): a
+    // dense cluster is one switch, which a backend emits as a jump table and
+    // the interpreter indexes directly, and the clusters are searched with a
+    // balanced tree of comparisons. Selecting an arm costs O(1) for dense case
+    // sets and O(log n) tests otherwise.
+    void emit_int_dispatch(ValueId value, const Type& type, std::vector<MatchCase>& cases,
+                           BlockId otherwise) {
+        bool is_signed = frontend::is_signed(type.kind);
+        unsigned width = type_bits(ir_type(type));
+        auto key = [&](std::uint64_t bits) {
+            if (!is_signed) {
+                return bits;
+            }
+            std::uint64_t sign = std::uint64_t{1} << (width - 1);
+            std::uint64_t extended = width < 64 ? (bits ^ sign) - sign : bits;
+            return extended ^ (std::uint64_t{1} << 63);
+        };
+        std::sort(cases.begin(), cases.end(), [&](const MatchCase& a, const MatchCase& b) {
+            return key(a.bits) < key(b.bits);
+        });
+        std::vector<std::uint64_t> keys;
+        for (const MatchCase& c : cases) {
+            keys.push_back(key(c.bits));
+        }
+        std::vector<CaseCluster> clusters = cluster_cases(keys);
+        emit_case_tree(value, is_signed, cases, clusters, 0, clusters.size(), otherwise);
+    }
+
+    void emit_case_tree(ValueId value, bool is_signed, const std::vector<MatchCase>& cases,
+                        const std::vector<CaseCluster>& clusters, std::size_t lo,
+                        std::size_t hi, BlockId otherwise) {
+        IRType type = fn->inst(value).type;
+        if (hi - lo > kMaxLinearClusters) {
+            std::size_t mid = lo + (hi - lo) / 2;
+            BlockId left = new_block();
+            BlockId right = new_block();
+            ValueId pivot = fn->constant(type, cases[clusters[mid].first].bits);
+            cond_branch(emit_compare(is_signed ? CmpPredicate::CMP_SLT : CmpPredicate::CMP_ULT,
+                                value, pivot),
+                        left, right);
+            seal(left);
+            block = left;
+            emit_case_tree(value, is_signed, cases, clusters, lo, mid, otherwise);
+            seal(right);
+            block = right;
+            emit_case_tree(value, is_signed, cases, clusters, mid, hi, otherwise);
+            return;
+        }
+        if (lo == hi) {
+            branch(otherwise);
+            return;
+        }
+        for (std::size_t i = lo; i < hi; ++i) {
+            const CaseCluster& cluster = clusters[i];
+            BlockId next = i + 1 < hi ? new_block() : otherwise;
+            if (cluster.jump_table) {
+                std::vector<ValueId> operands = {value};
+                std::vector<BlockId> successors = {next};
+                for (std::size_t c = cluster.first; c < cluster.first + cluster.count; ++c) {
+                    operands.push_back(fn->constant(type, cases[c].bits));
+                    successors.push_back(cases[c].target);
+                }
+                BlockId from = insertion_block();
+                fn->append(from, Opcode::OP_SWITCH, IRType(), operands, successors);
+                for (BlockId s : successors) {
+                    preds[s].push_back(from);
+                }
+                block = kNoBlock;
+            } else {
+                const MatchCase& c = cases[cluster.first];
+                cond_branch(emit_compare(CmpPredicate::CMP_EQ, value, fn->constant(type, c.bits)),
+                            c.target, next);
+            }
+            if (next != otherwise) {
+                seal(next);
+                block = next;
+            }
+        }
+    }
+
+    // Floats have no useful order for a tree (NaN matches nothing), so the
+    // cases are compared in source order.
+    void emit_float_dispatch(ValueId value, const std::vector<MatchCase>& cases,
+                             BlockId otherwise) {
+        IRType type = fn->inst(value).type;
+        for (std::size_t i = 0; i < cases.size(); ++i) {
+            BlockId next = i + 1 < cases.size() ? new_block() : otherwise;
+            ValueId pattern = fn->constant(type, cases[i].bits);
+            cond_branch(emit_compare(CmpPredicate::CMP_OEQ, value, pattern), cases[i].target, next);
+            if (next != otherwise) {
+                seal(next);
+                block = next;
+            }
+        }
+        branch(otherwise);
+    }
+
+    // Strings are dispatched on their length first, then, among the patterns
+    // of that length, on their bytes packed into an integer (up to 8 bytes)
+    // or on string_case_hash; a hash hit, or the only longer pattern of its
+    // length, is confirmed by comparing the bytes 8 at a time. A `string`
+    // brings its `length`; for a `char*` (kNoValue) it is counted up to the
+    // NUL, and a null string matches no literal.
+    void emit_string_dispatch(ValueId text, ValueId length, const std::vector<MatchCase>& cases,
+                              BlockId otherwise) {
+        IRType i64 = IRType::scalar(IRTypeKind::IR_I64);
+        TypePtr u64 = frontend::make_type(TypeKind::TYPE_U64);
+        if (length == kNoValue) {
+            BlockId present = new_block();
+            cond_branch(emit_compare(CmpPredicate::CMP_NE, text,
+                                     fn->constant(IRType::scalar(IRTypeKind::IR_PTR), 0)),
+                        present, otherwise);
+            seal(present);
+            block = present;
+            length = string_length(text);
+        }
+        std::map<std::size_t, std::vector<MatchCase>> by_length;
+        for (const MatchCase& c : cases) {
+            by_length[c.text.size()].push_back(c);
+        }
+        std::vector<MatchCase> lengths;
+        for (const auto& [size, group] : by_length) {
+            lengths.push_back({size, "", size == 0 ? group[0].target : new_block()});
+        }
+        emit_int_dispatch(length, *u64, lengths, otherwise);
+        for (MatchCase& entry : lengths) {
+            std::vector<MatchCase>& group = by_length[entry.bits];
+            if (entry.bits == 0) {
+                continue;
+            }
+            seal(entry.target);
+            block = entry.target;
+            if (entry.bits <= kPackedStringBytes) {
+                for (MatchCase& c : group) {
+                    c.bits = pack_string(c.text);
+                }
+                emit_int_dispatch(load_packed(text, 0, entry.bits), *u64, group, otherwise);
+                continue;
+            }
+            if (group.size() == 1) {
+                cond_branch(string_equals(text, group[0].text), group[0].target, otherwise);
+                continue;
+            }
+            std::map<std::uint64_t, std::vector<const MatchCase*>> by_hash;
+            for (const MatchCase& c : group) {
+                by_hash[string_case_hash(c.text)].push_back(&c);
+            }
+            std::vector<MatchCase> hashes;
+            for (const auto& [hash, candidates] : by_hash) {
+                hashes.push_back({hash, "", new_block()});
+            }
+            ValueId head = load_packed(text, 0, kPackedStringBytes);
+            ValueId tail = load_packed(text, entry.bits - kPackedStringBytes, kPackedStringBytes);
+            ValueId hash = emit(Opcode::OP_XOR, i64,
+                                {emit(Opcode::OP_MUL, i64,
+                                      {head, fn->constant(i64, kStringHashMultiplier)}),
+                                 tail});
+            emit_int_dispatch(hash, *u64, hashes, otherwise);
+            for (const MatchCase& h : hashes) {
+                seal(h.target);
+                block = h.target;
+                const std::vector<const MatchCase*>& candidates = by_hash[h.bits];
+                for (std::size_t i = 0; i < candidates.size(); ++i) {
+                    BlockId next = i + 1 < candidates.size() ? new_block() : otherwise;
+                    cond_branch(string_equals(text, candidates[i]->text), candidates[i]->target,
+                                next);
+                    if (next != otherwise) {
+                        seal(next);
+                        block = next;
+                    }
+                }
+            }
+        }
+    }
+
+    // Number of bytes before the terminating NUL, as an i64.
+    ValueId string_length(ValueId text) {
+        IRType i64 = IRType::scalar(IRTypeKind::IR_I64);
+        variables.push_back({i64_type(), kNoValue});  // not visible to the source
+        std::uint32_t index = static_cast<std::uint32_t>(variables.size() - 1);
+        write_variable(index, insertion_block(), fn->constant(i64, 0));
+        emit_loop(
+            [&] {
+                ValueId i = read_variable(index, insertion_block());
+                ValueId c = emit(Opcode::OP_LOAD, IRType::scalar(IRTypeKind::IR_I8),
+                                 {emit(Opcode::OP_PTRADD, IRType::scalar(IRTypeKind::IR_PTR),
+                                       {text, i})});
+                return emit_compare(CmpPredicate::CMP_NE, c,
+                               fn->constant(IRType::scalar(IRTypeKind::IR_I8), 0));
+            },
+            [] {},
+            [&] {
+                ValueId i = read_variable(index, insertion_block());
+                write_variable(index, insertion_block(),
+                               emit(Opcode::OP_ADD, i64, {i, fn->constant(i64, 1)}));
+            },
+            true);
+        return read_variable(index, insertion_block());
+    }
+
+    // `size` (at most 8) bytes at `offset` as a little-endian i64, loaded in
+    // pieces of 8, 4, 2 and 1 bytes so nothing past them is read.
+    ValueId load_packed(ValueId text, std::uint64_t offset, std::uint64_t size) {
+        IRType i64 = IRType::scalar(IRTypeKind::IR_I64);
+        ValueId packed = kNoValue;
+        for (std::uint64_t done = 0; done < size;) {
+            std::uint64_t piece = std::bit_floor(size - done);
+            IRType type = IRType::scalar(piece == 8   ? IRTypeKind::IR_I64
+                                         : piece == 4 ? IRTypeKind::IR_I32
+                                         : piece == 2 ? IRTypeKind::IR_I16
+                                                      : IRTypeKind::IR_I8);
+            ValueId part = emit(Opcode::OP_LOAD, type, {offset_address(text, offset + done)});
+            if (piece < 8) {
+                part = emit(Opcode::OP_ZEXT, i64, {part});
+            }
+            if (done != 0) {
+                part = emit(Opcode::OP_SHL, i64, {part, fn->constant(i64, 8 * done)});
+                part = emit(Opcode::OP_OR, i64, {packed, part});
+            }
+            packed = part;
+            done += piece;
+        }
+        return packed;
+    }
+
+    // True if the string, already known to have the pattern's length (more
+    // than 8 bytes), has its bytes; the last word may overlap the one before.
+    ValueId string_equals(ValueId text, const std::string& pattern) {
+        IRType i64 = IRType::scalar(IRTypeKind::IR_I64);
+        ValueId all = kNoValue;
+        for (std::size_t offset = 0; offset < pattern.size(); offset += kPackedStringBytes) {
+            std::size_t at = std::min(offset, pattern.size() - kPackedStringBytes);
+            std::uint64_t expected = pack_string(std::string_view(pattern).substr(at));
+            ValueId word = load_packed(text, at, kPackedStringBytes);
+            ValueId same = emit_compare(CmpPredicate::CMP_EQ, word, fn->constant(i64, expected));
+            all = all == kNoValue
+                      ? same
+                      : emit(Opcode::OP_AND, IRType::scalar(IRTypeKind::IR_I1), {all, same});
+        }
+        return all;
+    }
+
+    // -----------------------------------------------------------------------
+    // Strings
+    // -----------------------------------------------------------------------
+
+    // A NUL-terminated constant, shared by equal literals.
+    RValue string_literal(const std::string& text) {
+        auto found = string_literals.find(text);
+        if (found == string_literals.end()) {
+            std::string name = "pallas.str." + std::to_string(string_literals.size());
+            found = string_literals.emplace(text, module->add_global(name, text + '\0')).first;
+        }
+        return {fn->global(found->second), string_type()};
+    }
+
+    // black_box(x) is x, passed through a call the optimizer cannot see into
+    // (runtime/bench.h), so that benchmarks keep the work they measure.
+    // Aggregates pass their address, which makes them escape.
+    RValue lower_black_box(const frontend::CallExprAST& expr) {
+        if (expr.args.size() != 1) {
+            error(ErrorCode::E406_WRONG_ARGUMENT_COUNT,
+                  "'black_box' takes one argument, " + std::to_string(expr.args.size()) +
+                      " given",
+                  expr.loc);
+            return fail();
+        }
+        RValue value = lower_expr(*expr.args[0], nullptr);
+        if (value.value == kNoValue) {
+            return fail();
+        }
+        IRType type = fn->inst(value.value).type;
+        IRType i64 = IRType::scalar(IRTypeKind::IR_I64);
+        const char* name = nullptr;
+        switch (type.kind) {
+            case IRTypeKind::IR_F32: name = "pallas_black_box_f32"; break;
+            case IRTypeKind::IR_F64: name = "pallas_black_box_f64"; break;
+            case IRTypeKind::IR_PTR: name = "pallas_black_box_ptr"; break;
+            case IRTypeKind::IR_I128:
+            case IRTypeKind::IR_VOID:
+                unsupported("black_box of '" + frontend::type_to_string(*value.type) + "'",
+                            expr.loc);
+                return fail();
+            default: {
+                ValueId wide = value.value;
+                if (type.kind != IRTypeKind::IR_I64) {
+                    wide = emit(Opcode::OP_ZEXT, i64, {wide});
+                }
+                Function* box = runtime_function("pallas_black_box_u64", i64, {i64});
+                ValueId boxed = call_function(box, {wide});
+                if (type.kind != IRTypeKind::IR_I64) {
+                    boxed = emit(Opcode::OP_TRUNC, type, {boxed});
+                }
+                return {boxed, value.type};
+            }
+        }
+        return {call_function(runtime_function(name, type, {type}), {value.value}), value.type};
+    }
+
+    // print(x) and println(x): x is formatted as if written "${x}", straight
+    // into the output buffer.
+    RValue lower_print(const frontend::CallExprAST& expr, bool newline) {
+        std::string end = newline ? "\n" : "";
+        if (expr.args.size() != 1 && !(newline && expr.args.empty())) {
+            error(ErrorCode::E406_WRONG_ARGUMENT_COUNT,
+                  std::string(newline ? "'println'" : "'print'") + " takes one argument, " +
+                      std::to_string(expr.args.size()) + " given",
+                  expr.loc);
+            return fail();
+        }
+        std::vector<std::string> fragments = {end};
+        std::vector<const ExprAST*> parts;
+        const ExprAST* arg = expr.args.empty() ? nullptr : expr.args[0].get();
+        if (arg != nullptr && arg->kind == ExprKind::EXPR_STRING) {
+            fragments[0] = static_cast<const frontend::StringExprAST&>(*arg).value + end;
+        } else if (arg != nullptr && arg->kind == ExprKind::EXPR_INTERPOLATION) {
+            const auto& text = static_cast<const frontend::InterpolationExprAST&>(*arg);
+            fragments = text.fragments;
+            fragments.back() += end;
+            for (const auto& part : text.parts) {
+                parts.push_back(part.get());
+            }
+        } else if (arg != nullptr) {
+            fragments = {"", end};
+            parts.push_back(arg);
+        }
+        ValueId written = format_text(fragments, parts, TextTarget::TEXT_OUTPUT);
+        return written != kNoValue ? RValue{written, frontend::make_type(TypeKind::TYPE_VOID)}
+                                   : fail();
+    }
+
+    // The fragments with the values of the parts between them. Everything is
+    // sized before anything is written: fragments and the most characters a
+    // formatted number can take are constants, so only strings add to the
+    // size at run time. The text goes into one allocation, from the arena
+    // inside an arena block, straight into the output buffer, or into the
+    // string at `string` (whose own storage comes from `arena`). Returns the
+    // NUL-terminated text, or the end of what was written.
+    ValueId format_text(const std::vector<std::string>& fragments,
+                        const std::vector<const ExprAST*>& parts, TextTarget target,
+                        ValueId string = kNoValue, ValueId arena = kNoValue) {
+        IRType i8 = IRType::scalar(IRTypeKind::IR_I8);
+        IRType i64 = IRType::scalar(IRTypeKind::IR_I64);
+        IRType ptr = IRType::scalar(IRTypeKind::IR_PTR);
+        IRType void_type = IRType::scalar(IRTypeKind::IR_VOID);
+        std::uint64_t fixed = target == TextTarget::TEXT_NEW ? 1 : 0;
+        for (const std::string& fragment : fragments) {
+            fixed += fragment.size();
+        }
+        std::vector<FormatPart> values;
+        ValueId size = kNoValue;
+        for (const ExprAST* part : parts) {
+            RValue value = lower_expr(*part, nullptr);
+            if (value.value == kNoValue) {
+                return kNoValue;
+            }
+            std::optional<FormatPart> format = format_part(value, part->loc);
+            if (!format) {
+                return kNoValue;
+            }
+            switch (format->kind) {
+                case FormatKind::FORMAT_SIGNED:
+                case FormatKind::FORMAT_UNSIGNED: fixed += runtime::kMaxIntegerChars; break;
+                case FormatKind::FORMAT_SIGNED_128:
+                case FormatKind::FORMAT_UNSIGNED_128: fixed += runtime::kMaxInt128Chars; break;
+                case FormatKind::FORMAT_F32:
+                case FormatKind::FORMAT_F64: fixed += runtime::kMaxFloatChars; break;
+                case FormatKind::FORMAT_BOOL: fixed += 5; break;
+                case FormatKind::FORMAT_CHAR: fixed += 1; break;
+                case FormatKind::FORMAT_STRING:
+                    if (format->length == kNoValue) {
+                        format->length = string_length(format->value);
+                    }
+                    size = size == kNoValue ? format->length
+                                            : emit(Opcode::OP_ADD, i64, {size, format->length});
+                    break;
+            }
+            values.push_back(*format);
+        }
+        size = size == kNoValue ? fn->constant(i64, fixed)
+                                : emit(Opcode::OP_ADD, i64, {size, fn->constant(i64, fixed)});
+
+        // A part may be the text of the string being replaced, which must
+        // stay intact until it is copied: such text is built aside first.
+        bool aside = target == TextTarget::TEXT_STRING &&
+                     std::any_of(values.begin(), values.end(), [](const FormatPart& part) {
+                         return part.kind == FormatKind::FORMAT_STRING;
+                     });
+        ValueId text = kNoValue;
+        if (target == TextTarget::TEXT_OUTPUT) {
+            text = call_function(runtime_function("pallas_output_reserve", ptr, {i64}), {size});
+        } else if (target == TextTarget::TEXT_STRING && !aside) {
+            Function* prepare = runtime_function("pallas_string_prepare", ptr, {ptr, i64, ptr});
+            text = call_function(prepare, {string, size, arena});
+        } else if (!arenas.empty()) {
+            text = arena_allocate(arenas.back(), size, 1);
+        } else {
+            text = emit(Opcode::OP_NEW, ptr, {size});
+        }
+        ValueId cursor = text;
+        for (std::size_t i = 0; i < fragments.size(); ++i) {
+            cursor = write_fragment(cursor, fragments[i]);
+            if (i < values.size()) {
+                cursor = write_part(cursor, values[i]);
+            }
+        }
+        if (target == TextTarget::TEXT_OUTPUT) {
+            call_function(runtime_function("pallas_output_commit", void_type, {ptr}), {cursor});
+            return cursor;
+        }
+        if (target == TextTarget::TEXT_STRING && !aside) {
+            call_function(runtime_function("pallas_string_commit", void_type, {ptr, ptr}),
+                          {string, cursor});
+            return cursor;
+        }
+        if (target == TextTarget::TEXT_STRING) {
+            ValueId length = emit(Opcode::OP_SUB, i64, {emit(Opcode::OP_PTRTOINT, i64, {cursor}),
+                                                        emit(Opcode::OP_PTRTOINT, i64, {text})});
+            assign_text(string, text, length, arena);
+            if (arenas.empty()) {
+                emit(Opcode::OP_DELETE, IRType(), {text});
+            }
+            return cursor;
+        }
+        store(fn->constant(i8, 0), cursor);
+        return text;
+    }
+
+    std::optional<FormatPart> format_part(const RValue& value, SourceLocation loc) {
+        TypeKind kind = value.type->kind;
+        if (frontend::is_integer(kind) && frontend::integer_bits(kind) <= 64) {
+            bool sign = frontend::is_signed(kind);
+            return FormatPart{sign ? FormatKind::FORMAT_SIGNED : FormatKind::FORMAT_UNSIGNED,
+                              widen_index(value)};
+        }
+        if (frontend::is_integer(kind)) {
+            // The runtime takes the value as two i64 halves, low first.
+            IRType i64 = IRType::scalar(IRTypeKind::IR_I64);
+            IRType i128 = IRType::scalar(IRTypeKind::IR_I128);
+            ValueId upper = emit(Opcode::OP_LSHR, i128, {value.value, fn->constant(i128, 64)});
+            FormatPart part{frontend::is_signed(kind) ? FormatKind::FORMAT_SIGNED_128
+                                                      : FormatKind::FORMAT_UNSIGNED_128,
+                            emit(Opcode::OP_TRUNC, i64, {value.value})};
+            part.high = emit(Opcode::OP_TRUNC, i64, {upper});
+            return part;
+        }
+        switch (kind) {
+            case TypeKind::TYPE_F32: return FormatPart{FormatKind::FORMAT_F32, value.value};
+            case TypeKind::TYPE_F64: return FormatPart{FormatKind::FORMAT_F64, value.value};
+            case TypeKind::TYPE_BOOL: return FormatPart{FormatKind::FORMAT_BOOL, value.value};
+            case TypeKind::TYPE_CHAR: return FormatPart{FormatKind::FORMAT_CHAR, value.value};
+            default: break;
+        }
+        if (is_string_pointer(*value.type)) {
+            return FormatPart{FormatKind::FORMAT_STRING, value.value};
+        }
+        if (kind == TypeKind::TYPE_STRING) {
+            TextRef view = string_view(value.value);
+            return FormatPart{FormatKind::FORMAT_STRING, view.text, view.length};
+        }
+        error(ErrorCode::E405_TYPE_MISMATCH,
+              "cannot format '" + frontend::type_to_string(*value.type) + "' in a string", loc);
+        return std::nullopt;
+    }
+
+    // Stores the bytes of a literal fragment as constants, 8 at a time.
+    ValueId write_fragment(ValueId cursor, const std::string& fragment) {
+        for (std::size_t at = 0; at < fragment.size();) {
+            std::size_t piece = std::bit_floor(std::min(fragment.size() - at, kPackedStringBytes));
+            IRType type = IRType::scalar(piece == 8   ? IRTypeKind::IR_I64
+                                         : piece == 4 ? IRTypeKind::IR_I32
+                                         : piece == 2 ? IRTypeKind::IR_I16
+                                                      : IRTypeKind::IR_I8);
+            std::uint64_t bytes = pack_string(std::string_view(fragment).substr(at, piece));
+            store(fn->constant(type, bytes), offset_address(cursor, at));
+            at += piece;
+        }
+        return offset_address(cursor, fragment.size());
+    }
+
+    ValueId write_part(ValueId cursor, const FormatPart& part) {
+        IRType i8 = IRType::scalar(IRTypeKind::IR_I8);
+        IRType i32 = IRType::scalar(IRTypeKind::IR_I32);
+        IRType i64 = IRType::scalar(IRTypeKind::IR_I64);
+        IRType ptr = IRType::scalar(IRTypeKind::IR_PTR);
+        auto format = [&](const char* name, IRType type) {
+            return call_function(runtime_function(name, ptr, {ptr, type}), {cursor, part.value});
+        };
+        switch (part.kind) {
+            case FormatKind::FORMAT_SIGNED: return format("pallas_format_i64", i64);
+            case FormatKind::FORMAT_UNSIGNED: return format("pallas_format_u64", i64);
+            case FormatKind::FORMAT_SIGNED_128:
+            case FormatKind::FORMAT_UNSIGNED_128: {
+                const char* name = part.kind == FormatKind::FORMAT_SIGNED_128
+                                       ? "pallas_format_i128"
+                                       : "pallas_format_u128";
+                return call_function(runtime_function(name, ptr, {ptr, i64, i64}),
+                                     {cursor, part.value, part.high});
+            }
+            case FormatKind::FORMAT_F32:
+                return format("pallas_format_f32", IRType::scalar(IRTypeKind::IR_F32));
+            case FormatKind::FORMAT_F64:
+                return format("pallas_format_f64", IRType::scalar(IRTypeKind::IR_F64));
+            case FormatKind::FORMAT_BOOL: {
+                // "true" or "fals", then an 'e' that only "false" keeps.
+                ValueId word = emit(Opcode::OP_SELECT, i32,
+                                    {part.value, fn->constant(i32, pack_string("true")),
+                                     fn->constant(i32, pack_string("fals"))});
+                store(word, cursor);
+                store(fn->constant(i8, 'e'), offset_address(cursor, 4));
+                ValueId length = emit(Opcode::OP_SELECT, i64,
+                                      {part.value, fn->constant(i64, 4), fn->constant(i64, 5)});
+                return emit(Opcode::OP_PTRADD, ptr, {cursor, length});
+            }
+            case FormatKind::FORMAT_CHAR:
+                store(part.value, cursor);
+                return offset_address(cursor, 1);
+            case FormatKind::FORMAT_STRING: {
+                Function* copy = runtime_function("pallas_format_string", ptr, {ptr, ptr, i64});
+                return call_function(copy, {cursor, part.value, part.length});
+            }
+        }
+        return cursor;
+    }
+
+    // -----------------------------------------------------------------------
+    // Strings and Vecs
+    // -----------------------------------------------------------------------
+
+    // `string` and `Vec<T>` (or a pointer to one) for indexing, methods and
+    // range-for; nullptr for anything else.
+    static const Type* storage_owner(const Type& type) {
+        const Type* owner = &type;
+        if (owner->kind == TypeKind::TYPE_POINTER && owner->element) {
+            owner = owner->element.get();
+        }
+        return owns_storage(*owner) ? owner : nullptr;
+    }
+
+    // The call in `Vec<T>(...)`, or nullptr for any other expression.
+    const frontend::CallExprAST* vec_constructor(const ExprAST& expr) const {
+        if (expr.kind != ExprKind::EXPR_CALL) {
+            return nullptr;
+        }
+        const auto& call = static_cast<const frontend::CallExprAST&>(expr);
+        if (call.callee->kind != ExprKind::EXPR_VARIABLE || structs.count("Vec") != 0 ||
+            static_cast<const frontend::VariableExprAST&>(*call.callee).name != "Vec") {
+            return nullptr;
+        }
+        return &call;
+    }
+
+    ValueId arena_or_null(ValueId arena) {
+        return arena != kNoValue ? arena : fn->constant(IRType::scalar(IRTypeKind::IR_PTR), 0);
+    }
+
+    // The arena a string or Vec variable named by `expr` takes its first
+    // buffer from; null (the heap) for one reached through a pointer.
+    ValueId owner_arena(const ExprAST& expr) {
+        if (expr.kind == ExprKind::EXPR_VARIABLE) {
+            std::uint32_t id =
+                lookup_variable(static_cast<const frontend::VariableExprAST&>(expr).name);
+            if (id != kNoVariable) {
+                return arena_or_null(variables[id].arena);
+            }
+        }
+        return arena_or_null(kNoValue);
+    }
+
+    // name: string = ... and name: Vec<T> = Vec<T>(...). The variable starts
+    // empty and frees its buffer when its scope ends; declared in an arena
+    // block, its buffers come from that arena. `init` is the already lowered
+    // initializer of a variable whose type was inferred from it.
+    void declare_owner(const frontend::VarDeclAST& decl, TypePtr type,
+                       const RValue* init = nullptr) {
+        const frontend::CallExprAST* ctor = decl.init ? vec_constructor(*decl.init) : nullptr;
+        if (ctor != nullptr) {
+            auto written = frontend::make_type(TypeKind::TYPE_UNKNOWN, "Vec");
+            written->args = ctor->type_args;
+            TypePtr made = resolve(written, ctor->loc);
+            if (!made) {
+                return;
+            }
+            if (type && !same_type(*type, *made)) {
+                error(ErrorCode::E405_TYPE_MISMATCH,
+                      "expected '" + frontend::type_to_string(*type) + "', found '" +
+                          frontend::type_to_string(*made) + "'",
+                      decl.init->loc);
+                return;
+            }
+            type = made;
+        }
+        if (is_vec(*type) && decl.init && ctor == nullptr) {
+            error(ErrorCode::E405_TYPE_MISMATCH,
+                  "a Vec must be initialized with Vec<T>() or Vec<T>(capacity); Vecs are not "
+                  "copied",
+                  decl.init->loc);
+            return;
+        }
+        ValueId object = stack_slot(*type);
+        ValueId arena = arenas.empty() ? kNoValue : arenas.back();
+        zero_memory(object, *type);
+        cleanups.push_back({object, scopes.size(), type});
+        // The initializer is lowered before the name is visible.
+        if (init != nullptr) {
+            assign_value(object, *init, arena_or_null(arena), decl.init->loc);
+        } else if (ctor != nullptr) {
+            init_vec(object, *type->args[0], *ctor, arena);
+        } else if (decl.init) {
+            assign_string(object, *decl.init, arena_or_null(arena));
+        }
+        variables.push_back({type, object, arena});
+        scopes.back()[decl.name] = static_cast<std::uint32_t>(variables.size() - 1);
+    }
+
+    // Vec<T>(capacity) reserves the capacity. A small constant capacity
+    // outside an arena block is reserved on the stack instead: the Vec uses
+    // that storage until it outgrows it, and never allocates if it does not.
+    void init_vec(ValueId vec, const Type& element, const frontend::CallExprAST& ctor,
+                  ValueId arena) {
+        IRType i64 = IRType::scalar(IRTypeKind::IR_I64);
+        IRType ptr = IRType::scalar(IRTypeKind::IR_PTR);
+        IRType void_type = IRType::scalar(IRTypeKind::IR_VOID);
+        if (ctor.args.size() > 1) {
+            error(ErrorCode::E406_WRONG_ARGUMENT_COUNT,
+                  "'Vec' takes at most one argument, the capacity", ctor.loc);
+            return;
+        }
+        if (ctor.args.empty()) {
+            return;
+        }
+        RValue capacity = lower_expr(*ctor.args[0], i64_type());
+        if (capacity.value == kNoValue) {
+            return;
+        }
+        if (!frontend::is_integer(capacity.type->kind)) {
+            error(ErrorCode::E405_TYPE_MISMATCH,
+                  "Vec capacity must be an integer, found '" +
+                      frontend::type_to_string(*capacity.type) + "'",
+                  ctor.args[0]->loc);
+            return;
+        }
+        ValueId count = widen_index(capacity);
+        std::uint64_t size = std::max<std::uint64_t>(size_of(element), 1);
+        const Inst& constant = fn->inst(count);
+        if (arena == kNoValue && constant.op == Opcode::OP_CONST && constant.imm > 0 &&
+            constant.imm <= runtime::kVecInlineBytes / size) {
+            ValueId storage =
+                stack_slot(runtime::kVecInlineHeader + constant.imm * size,
+                           std::max<std::uint64_t>(layout.align_of(element),
+                                                   alignof(runtime::BufferHeader)));
+            Function* init = runtime_function("pallas_vec_init_inline", void_type,
+                                              {ptr, ptr, i64, i64});
+            call_function(init, {vec, storage, count, fn->constant(i64, size)});
+            return;
+        }
+        Function* reserve =
+            runtime_function("pallas_vec_reserve", void_type, {ptr, i64, i64, ptr});
+        call_function(reserve, {vec, fn->constant(i64, size), count, arena_or_null(arena)});
+    }
+
+    void free_storage(ValueId object, const Type& type) {
+        const char* name = is_vec(type) ? "pallas_vec_free" : "pallas_string_free";
+        call_function(runtime_function(name, IRType::scalar(IRTypeKind::IR_VOID),
+                                       {IRType::scalar(IRTypeKind::IR_PTR)}),
+                      {object});
+    }
+
+    // The text and length of the string at `s`, read inline without a
+    // branch: the sign bit of the last byte tells the two forms apart.
+    TextRef string_view(ValueId s) {
+        IRType i8 = IRType::scalar(IRTypeKind::IR_I8);
+        IRType i64 = IRType::scalar(IRTypeKind::IR_I64);
+        IRType ptr = IRType::scalar(IRTypeKind::IR_PTR);
+        ValueId tag = emit(Opcode::OP_LOAD, i8, {offset_address(s, runtime::kStringTagOffset)});
+        ValueId heap = emit_compare(CmpPredicate::CMP_SLT, tag, fn->constant(i8, 0));
+        ValueId data = emit(Opcode::OP_LOAD, ptr, {offset_address(s, runtime::kStringDataOffset)});
+        ValueId length =
+            emit(Opcode::OP_LOAD, i64, {offset_address(s, runtime::kStringLengthOffset)});
+        return {emit(Opcode::OP_SELECT, ptr, {heap, data, s}),
+                emit(Opcode::OP_SELECT, i64, {heap, length, emit(Opcode::OP_ZEXT, i64, {tag})})};
+    }
+
+    void assign_text(ValueId s, ValueId text, ValueId length, ValueId arena) {
+        IRType ptr = IRType::scalar(IRTypeKind::IR_PTR);
+        Function* assign =
+            runtime_function("pallas_string_assign", IRType::scalar(IRTypeKind::IR_VOID),
+                             {ptr, ptr, IRType::scalar(IRTypeKind::IR_I64), ptr});
+        call_function(assign, {s, text, length, arena});
+    }
+
+    // s = expr. Literals are copied with their constant length, interpolations
+    // are formatted straight into the string, and `t.slice(a, b)` copies the
+    // bytes without a temporary string.
+    bool assign_string(ValueId s, const ExprAST& expr, ValueId arena) {
+        if (expr.kind == ExprKind::EXPR_STRING) {
+            const std::string& text = static_cast<const frontend::StringExprAST&>(expr).value;
+            assign_text(s, string_literal(text).value,
+                        fn->constant(IRType::scalar(IRTypeKind::IR_I64), text.size()), arena);
+            return true;
+        }
+        if (expr.kind == ExprKind::EXPR_INTERPOLATION) {
+            const auto& text = static_cast<const frontend::InterpolationExprAST&>(expr);
+            std::vector<const ExprAST*> parts;
+            for (const auto& part : text.parts) {
+                parts.push_back(part.get());
+            }
+            return format_text(text.fragments, parts, TextTarget::TEXT_STRING, s, arena) !=
+                   kNoValue;
+        }
+        if (expr.kind == ExprKind::EXPR_CALL) {
+            const auto& call = static_cast<const frontend::CallExprAST&>(expr);
+            if (call.callee->kind == ExprKind::EXPR_MEMBER &&
+                static_cast<const frontend::MemberExprAST&>(*call.callee).member == "slice") {
+                slice_target = {s, arena};
+            }
+        }
+        RValue value = lower_expr(expr, nullptr);
+        slice_target = {};
+        return value.value != kNoValue && assign_value(s, value, arena, expr.loc);
+    }
+
+    // s = value, for a string or a `char*` value.
+    bool assign_value(ValueId s, const RValue& value, ValueId arena, SourceLocation loc) {
+        if (value.type->kind == TypeKind::TYPE_STRING) {
+            if (value.value != s) {  // `s = s` and slices written into `s` are done
+                TextRef view = string_view(value.value);
+                assign_text(s, view.text, view.length, arena);
+            }
+            return true;
+        }
+        if (is_string_pointer(*value.type)) {
+            assign_text(s, value.value, string_length(value.value), arena);
+            return true;
+        }
+        error(ErrorCode::E405_TYPE_MISMATCH,
+              "expected 'string', found '" + frontend::type_to_string(*value.type) + "'", loc);
+        return false;
+    }
+
+    // s += expr and s.append(expr): a string, a `char*` or a char.
+    bool append_string(ValueId s, const ExprAST& expr, ValueId arena) {
+        IRType i64 = IRType::scalar(IRTypeKind::IR_I64);
+        IRType ptr = IRType::scalar(IRTypeKind::IR_PTR);
+        TextRef text;
+        ValueId temporary = kNoValue;
+        if (expr.kind == ExprKind::EXPR_STRING) {
+            const std::string& literal = static_cast<const frontend::StringExprAST&>(expr).value;
+            text = {string_literal(literal).value, fn->constant(i64, literal.size())};
+        } else {
+            RValue value = lower_expr(expr, nullptr);
+            if (value.value == kNoValue) {
+                return false;
+            }
+            if (value.type->kind == TypeKind::TYPE_STRING) {
+                text = string_view(value.value);
+            } else if (is_string_pointer(*value.type)) {
+                text = {value.value, string_length(value.value)};
+                if (expr.kind == ExprKind::EXPR_INTERPOLATION && arenas.empty()) {
+                    temporary = value.value;
+                }
+            } else if (value.type->kind == TypeKind::TYPE_CHAR) {
+                ValueId byte = stack_slot(1, 1);
+                emit(Opcode::OP_STORE, IRType(), {value.value, byte});
+                text = {byte, fn->constant(i64, 1)};
+            } else {
+                error(ErrorCode::E405_TYPE_MISMATCH,
+                      "cannot append '" + frontend::type_to_string(*value.type) +
+                          "' to a string",
+                      expr.loc);
+                return false;
+            }
+        }
+        Function* append =
+            runtime_function("pallas_string_append", IRType::scalar(IRTypeKind::IR_VOID),
+                             {ptr, ptr, i64, ptr});
+        call_function(append, {s, text.text, text.length, arena});
+        if (temporary != kNoValue) {
+            emit(Opcode::OP_DELETE, IRType(), {temporary});
+        }
+        return true;
+    }
+
+    RValue assign_owner(const LValue& place, const frontend::AssignExprAST& expr) {
+        if (is_vec(*place.type)) {
+            error(ErrorCode::E405_TYPE_MISMATCH, "a Vec cannot be assigned; Vecs are not copied",
+                  expr.loc);
+            return fail();
+        }
+        ValueId arena = owner_arena(*expr.target);
+        bool ok = false;
+        if (expr.op == TokenType::TOKEN_ASSIGN) {
+            ok = assign_string(place.address, *expr.value, arena);
+        } else if (expr.op == TokenType::TOKEN_PLUS_ASSIGN) {
+            ok = append_string(place.address, *expr.value, arena);
+        } else {
+            error(ErrorCode::E405_TYPE_MISMATCH, "strings only support '=' and '+='", expr.loc);
+        }
+        return ok ? RValue{place.address, place.type} : fail();
+    }
+
+    bool check_arguments(const frontend::CallExprAST& expr, const std::string& name,
+                         std::size_t count) {
+        if (expr.args.size() == count) {
+            return true;
+        }
+        error(ErrorCode::E406_WRONG_ARGUMENT_COUNT,
+              "'" + name + "' takes " + std::to_string(count) + " arguments, " +
+                  std::to_string(expr.args.size()) + " given",
+              expr.loc);
+        return false;
+    }
+
+    // An integer argument as an i64, kNoValue on error.
+    ValueId integer_argument(const ExprAST& arg) {
+        RValue value = lower_expr(arg, i64_type());
+        if (value.value == kNoValue) {
+            return kNoValue;
+        }
+        if (!is_int_like(value.type->kind)) {
+            error(ErrorCode::E405_TYPE_MISMATCH,
+                  "expected an integer, found '" + frontend::type_to_string(*value.type) + "'",
+                  arg.loc);
+            return kNoValue;
+        }
+        return widen_index(value);
+    }
+
+    // push, pop, len, capacity, reserve and clear. push stores inline while
+    // there is room and only calls the runtime to grow.
+    RValue vec_method(ValueId vec, const Type& type, ValueId arena,
+                      const frontend::CallExprAST& expr) {
+        IRType i64 = IRType::scalar(IRTypeKind::IR_I64);
+        IRType ptr = IRType::scalar(IRTypeKind::IR_PTR);
+        IRType void_type = IRType::scalar(IRTypeKind::IR_VOID);
+        const std::string& name = static_cast<const frontend::MemberExprAST&>(*expr.callee).member;
+        const TypePtr& element = type.args[0];
+        ValueId size = fn->constant(i64, std::max<std::uint64_t>(size_of(*element), 1));
+        ValueId length_address = offset_address(vec, runtime::kVecLengthOffset);
+        RValue none{vec, frontend::make_type(TypeKind::TYPE_VOID)};
+        if (name == "push") {
+            if (!check_arguments(expr, name, 1)) {
+                return fail();
+            }
+            RValue value = convert(lower_expr(*expr.args[0], element), element, expr.args[0]->loc);
+            if (value.value == kNoValue) {
+                return fail();
+            }
+            if (is_aggregate(*element)) {
+                // It may be an element of this Vec, which growing moves.
+                ValueId copy = stack_slot(*element);
+                copy_memory(copy, value.value, *element);
+                value.value = copy;
+            }
+            ValueId length = emit(Opcode::OP_LOAD, i64, {length_address});
+            ValueId capacity =
+                emit(Opcode::OP_LOAD, i64, {offset_address(vec, runtime::kVecCapacityOffset)});
+            BlockId grow = new_block();
+            BlockId join = new_block();
+            cond_branch(emit_compare(CmpPredicate::CMP_EQ, length, capacity), grow, join);
+            seal(grow);
+            block = grow;
+            call_function(runtime_function("pallas_vec_grow", void_type, {ptr, i64, ptr}),
+                          {vec, size, arena});
+            branch(join);
+            seal(join);
+            block = join;
+            ValueId data =
+                emit(Opcode::OP_LOAD, ptr, {offset_address(vec, runtime::kVecDataOffset)});
+            write_place({kNoVariable, element_address(data, length, *element), element},
+                        value.value);
+            store(emit(Opcode::OP_ADD, i64, {length, fn->constant(i64, 1)}), length_address);
+            return none;
+        }
+        if (name == "pop") {
+            if (!check_arguments(expr, name, 0)) {
+                return fail();
+            }
+            ValueId length = emit(Opcode::OP_LOAD, i64, {length_address});
+            ValueId last = emit(Opcode::OP_SUB, i64, {length, fn->constant(i64, 1)});
+            if (options.bounds_checks) {
+                emit(Opcode::OP_BOUNDS_CHECK, IRType(), {last, length});  // fails when empty
+            }
+            store(last, length_address);
+            ValueId data =
+                emit(Opcode::OP_LOAD, ptr, {offset_address(vec, runtime::kVecDataOffset)});
+            return read_place({kNoVariable, element_address(data, last, *element), element});
+        }
+        if (name == "len" || name == "capacity") {
+            if (!check_arguments(expr, name, 0)) {
+                return fail();
+            }
+            std::uint64_t offset =
+                name == "len" ? runtime::kVecLengthOffset : runtime::kVecCapacityOffset;
+            return {emit(Opcode::OP_LOAD, i64, {offset_address(vec, offset)}), i64_type()};
+        }
+        if (name == "reserve") {
+            if (!check_arguments(expr, name, 1)) {
+                return fail();
+            }
+            ValueId capacity = integer_argument(*expr.args[0]);
+            if (capacity == kNoValue) {
+                return fail();
+            }
+            Function* reserve =
+                runtime_function("pallas_vec_reserve", void_type, {ptr, i64, i64, ptr});
+            call_function(reserve, {vec, size, capacity, arena});
+            return none;
+        }
+        if (name == "clear") {
+            if (!check_arguments(expr, name, 0)) {
+                return fail();
+            }
+            store(fn->constant(i64, 0), length_address);
+            return none;
+        }
+        error(ErrorCode::E404_UNDEFINED_NAME,
+              "'" + frontend::type_to_string(type) + "' has no method '" + name + "'",
+              expr.callee->loc);
+        return fail();
+    }
+
+    // len, c_str, append and slice. slice writes into `target`, the string
+    // being initialized or assigned, so it is only allowed there.
+    RValue string_method(ValueId s, ValueId arena, const frontend::CallExprAST& expr,
+                         ValueId target, ValueId target_arena) {
+        IRType i64 = IRType::scalar(IRTypeKind::IR_I64);
+        IRType ptr = IRType::scalar(IRTypeKind::IR_PTR);
+        const std::string& name = static_cast<const frontend::MemberExprAST&>(*expr.callee).member;
+        if (name == "len" || name == "c_str") {
+            if (!check_arguments(expr, name, 0)) {
+                return fail();
+            }
+            TextRef view = string_view(s);
+            return name == "len" ? RValue{view.length, i64_type()}
+                                 : RValue{view.text, string_type()};
+        }
+        if (name == "append") {
+            if (!check_arguments(expr, name, 1) || !append_string(s, *expr.args[0], arena)) {
+                return fail();
+            }
+            return {s, frontend::make_type(TypeKind::TYPE_VOID)};
+        }
+        if (name == "slice") {
+            if (target == kNoValue) {
+                error(ErrorCode::E405_TYPE_MISMATCH,
+                      "'slice' makes a new string; use it to initialize or assign one", expr.loc);
+                return fail();
+            }
+            if (!check_arguments(expr, name, 2)) {
+                return fail();
+            }
+            ValueId begin = integer_argument(*expr.args[0]);
+            ValueId end = begin != kNoValue ? integer_argument(*expr.args[1]) : kNoValue;
+            if (end == kNoValue) {
+                return fail();
+            }
+            Function* slice =
+                runtime_function("pallas_string_slice", IRType::scalar(IRTypeKind::IR_VOID),
+                                 {ptr, ptr, i64, i64, ptr});
+            call_function(slice, {target, s, begin, end, target_arena});
+            return {target, frontend::make_type(TypeKind::TYPE_STRING)};
+        }
+        error(ErrorCode::E404_UNDEFINED_NAME, "'string' has no method '" + name + "'",
+              expr.callee->loc);
+        return fail();
+    }
+
+    // v[i] and s[i], checked against the current length.
+    LValue owner_element(ValueId object, const Type& type, ValueId index) {
+        IRType i64 = IRType::scalar(IRTypeKind::IR_I64);
+        IRType ptr = IRType::scalar(IRTypeKind::IR_PTR);
+        if (is_vec(type)) {
+            ValueId length =
+                emit(Opcode::OP_LOAD, i64, {offset_address(object, runtime::kVecLengthOffset)});
+            if (options.bounds_checks) {
+                emit(Opcode::OP_BOUNDS_CHECK, IRType(), {index, length});
+            }
+            ValueId data =
+                emit(Opcode::OP_LOAD, ptr, {offset_address(object, runtime::kVecDataOffset)});
+            return {kNoVariable, element_address(data, index, *type.args[0]), type.args[0]};
+        }
+        TextRef view = string_view(object);
+        if (options.bounds_checks) {
+            emit(Opcode::OP_BOUNDS_CHECK, IRType(), {index, view.length});
+        }
+        return {kNoVariable, emit(Opcode::OP_PTRADD, ptr, {view.text, index}),
+                frontend::make_type(TypeKind::TYPE_CHAR)};
+    }
+
+    // for (x : v) and for (c : s) visit the elements that were there when the
+    // loop started. Each one is still read through the current buffer and
+    // checked against the current length, since the body may push or clear.
+    void lower_owner_range_for(const frontend::RangeForStmtAST& stmt, ValueId object,
+                               const Type& type) {
+        TypePtr element = is_vec(type) ? type.args[0] : frontend::make_type(TypeKind::TYPE_CHAR);
+        ValueId count = is_vec(type)
+                            ? emit(Opcode::OP_LOAD, IRType::scalar(IRTypeKind::IR_I64),
+                                   {offset_address(object, runtime::kVecLengthOffset)})
+                            : string_view(object).length;
+        scopes.emplace_back();
+        counted_loop(count, [&](ValueId index) {
+            LValue place = owner_element(object, type, index);
+            std::uint32_t var = declare_variable(stmt.var, element);
+            if (variables[var].address != kNoValue) {
+                copy_memory(variables[var].address, place.address, *element);
+            } else {
+                write_variable(var, insertion_block(), load(place.address, *element));
+            }
+            lower_stmt(*stmt.body);
+        });
+        pop_scope();
+    }
+
+    // -----------------------------------------------------------------------
+    // Memory
+    // -----------------------------------------------------------------------
+
+    ValueId offset_address(ValueId base, std::uint64_t offset) {
+        if (offset == 0) {
+            return base;
+        }
+        ValueId off = fn->constant(IRType::scalar(IRTypeKind::IR_I64), offset);
+        return emit(Opcode::OP_PTRADD, IRType::scalar(IRTypeKind::IR_PTR), {base, off});
+    }
+
+    ValueId load(ValueId address, const Type& type) {
+        return emit(Opcode::OP_LOAD, ir_type(type), {address});
+    }
+
+    void store(ValueId value, ValueId address) {
+        emit(Opcode::OP_STORE, IRType(), {value, address});
+    }
+
+    ValueId zero(const Type& type) {
+        IRType ir = ir_type(type);
+        if (is_float(ir)) {
+            return fn->float_constant(ir, 0.0);
+        }
+        return fn->constant(ir, 0);
+    }
+
+    // A scalar field of a record passed in registers.
+    struct RegisterField {
+        IRType type;
+        std::uint64_t offset = 0;
+    };
+
+    // Records of at most this many scalar fields and bytes are passed as their
+    // fields, one argument each, so that they travel in registers.
+    static constexpr std::size_t kRegisterFields = 4;
+    static constexpr std::uint64_t kRegisterBytes = 16;
+
+    // The fields a by-value record is passed as; none if it goes in memory.
+    std::vector<RegisterField> register_fields(const Type& type) {
+        std::vector<RegisterField> fields;
+        if (!is_record(type) || size_of(type) > kRegisterBytes) {
+            return fields;
+        }
+        for_each_scalar(type, 0, [&](const Type& leaf, std::uint64_t offset) {
+            fields.push_back({ir_type(leaf), offset});
+        });
+        if (fields.size() > kRegisterFields) {
+            fields.clear();
+        }
+        return fields;
+    }
+
+    // Visits every scalar leaf of an aggregate with its byte offset.
+    template <typename F>
+    void for_each_scalar(const Type& type, std::uint64_t offset, F&& visit) {
+        if (const SoaLayout* soa = layout.soa_layout_of(type)) {
+            for (const SoaStream& stream : soa_streams(*soa, *type.element)) {
+                for (std::uint64_t i = 0; i < type.array_size; ++i) {
+                    for_each_scalar(*stream.type, offset + stream.field->offset +
+                                                      i * stream.field->stride,
+                                    visit);
+                }
+            }
+            return;
+        }
+        if (type.kind == TypeKind::TYPE_ARRAY) {
+            std::uint64_t stride = size_of(*type.element);
+            for (std::uint64_t i = 0; i < type.array_size; ++i) {
+                for_each_scalar(*type.element, offset + i * stride, visit);
+            }
+            return;
+        }
+        if (is_arena(type) || owns_storage(type)) {
+            for (std::uint64_t i = 0; i < size_of(type); i += sizeof(void*)) {
+                visit(*frontend::make_type(TypeKind::TYPE_POINTER), offset + i);
+            }
+            return;
+        }
+        if (is_record(type)) {
+            const TypeLayout* record = layout.layout_of(type.name);
+            const frontend::StructDeclAST* decl = structs.at(type.name);
+            if (record == nullptr) {
+                return;
+            }
+            for (const FieldLayout& field : record->fields) {
+                TypePtr field_type = resolve(decl->fields[field.decl_index].type, decl->loc);
+                if (field_type) {
+                    for_each_scalar(*field_type, offset + field.offset, visit);
+                }
+            }
+            return;
+        }
+        visit(type, offset);
+    }
+
+    // A field of the element of a @soa array, with its type and its offset
+    // within one element.
+    struct SoaStream {
+        const SoaField* field = nullptr;
+        TypePtr type;
+        std::uint64_t record_offset = 0;
+    };
+
+    std::vector<SoaStream> soa_streams(const SoaLayout& soa, const Type& element) {
+        std::vector<SoaStream> streams;
+        const frontend::StructDeclAST* decl = structs.at(element.name);
+        const TypeLayout* record = layout.layout_of(element.name);
+        for (std::size_t i = 0; i < soa.fields.size(); ++i) {
+            const SoaField& field = soa.fields[i];
+            TypePtr type = resolve(decl->fields[field.decl_index].type, decl->loc);
+            if (type) {
+                streams.push_back({&field, type, record->fields[i].offset});
+            }
+        }
+        return streams;
+    }
+
+    LValue soa_element(ValueId array, const SoaLayout& soa, const TypePtr& element,
+                       ValueId index) {
+        LValue place{kNoVariable, array, element};
+        place.soa = &soa;
+        place.index = index;
+        return place;
+    }
+
+    // Copies a @soa element field by field into the record at `record`, or
+    // with `scatter`, from it.
+    void copy_soa_element(const LValue& place, ValueId record, bool scatter) {
+        for (const SoaStream& stream : soa_streams(*place.soa, *place.type)) {
+            ValueId field = element_address(offset_address(place.address, stream.field->offset),
+                                            place.index, *stream.type);
+            ValueId copy = offset_address(record, stream.record_offset);
+            if (scatter) {
+                copy_memory(field, copy, *stream.type);
+            } else {
+                copy_memory(copy, field, *stream.type);
+            }
+        }
+    }
+
+    // Address of element `index` (an i64) of an array or pointer.
+    ValueId element_address(ValueId base, ValueId index, const Type& element) {
+        ValueId offset = scale_index({index, i64_type()}, size_of(element));
+        return emit(Opcode::OP_PTRADD, IRType::scalar(IRTypeKind::IR_PTR), {base, offset});
+    }
+
+    // Arrays longer than this are copied and cleared with a loop rather than
+    // one load/store per element.
+    static constexpr std::uint64_t kUnrolledArrayLength = 16;
+
+    bool needs_loop(const Type& type) const {
+        return type.kind == TypeKind::TYPE_ARRAY && type.array_size > kUnrolledArrayLength;
+    }
+
+    void copy_memory(ValueId dst, ValueId src, const Type& type) {
+        const SoaLayout* soa = needs_loop(type) ? layout.soa_layout_of(type) : nullptr;
+        if (soa != nullptr) {
+            for (const SoaStream& stream : soa_streams(*soa, *type.element)) {
+                ValueId to = offset_address(dst, stream.field->offset);
+                ValueId from = offset_address(src, stream.field->offset);
+                counted_loop(type.array_size, [&](ValueId index) {
+                    copy_memory(element_address(to, index, *stream.type),
+                                element_address(from, index, *stream.type), *stream.type);
+                });
+            }
+            return;
+        }
+        if (needs_loop(type)) {
+            counted_loop(type.array_size, [&](ValueId index) {
+                copy_memory(element_address(dst, index, *type.element),
+                            element_address(src, index, *type.element), *type.element);
+            });
+            return;
+        }
+        for_each_scalar(type, 0, [&](const Type& leaf, std::uint64_t offset) {
+            ValueId value = load(offset_address(src, offset), leaf);
+            store(value, offset_address(dst, offset));
+        });
+    }
+
+    void zero_memory(ValueId dst, const Type& type) {
+        const SoaLayout* soa = needs_loop(type) ? layout.soa_layout_of(type) : nullptr;
+        if (soa != nullptr) {
+            for (const SoaStream& stream : soa_streams(*soa, *type.element)) {
+                ValueId to = offset_address(dst, stream.field->offset);
+                counted_loop(type.array_size, [&](ValueId index) {
+                    zero_memory(element_address(to, index, *stream.type), *stream.type);
+                });
+            }
+            return;
+        }
+        if (needs_loop(type)) {
+            counted_loop(type.array_size, [&](ValueId index) {
+                zero_memory(element_address(dst, index, *type.element), *type.element);
+            });
+            return;
+        }
+        for_each_scalar(type, 0, [&](const Type& leaf, std::uint64_t offset) {
+            store(zero(leaf), offset_address(dst, offset));
+        });
+    }
+
+    void store_array_literal(ValueId address, const Type& type, const frontend::ArrayExprAST& lit) {
+        if (lit.elements.size() > type.array_size) {
+            error(ErrorCode::E405_TYPE_MISMATCH,
+                  "too many elements for '" + frontend::type_to_string(type) + "'", lit.loc);
+            return;
+        }
+        if (const SoaLayout* soa = layout.soa_layout_of(type)) {
+            // Element by element into the field arrays, the rest zeroed first.
+            if (lit.elements.size() < type.array_size) {
+                zero_memory(address, type);
+            }
+            IRType i64 = IRType::scalar(IRTypeKind::IR_I64);
+            for (std::size_t i = 0; i < lit.elements.size(); ++i) {
+                RValue value = lower_expr(*lit.elements[i], type.element);
+                value = convert(value, type.element, lit.elements[i]->loc);
+                if (value.value != kNoValue) {
+                    write_place(soa_element(address, *soa, type.element, fn->constant(i64, i)),
+                                value.value);
+                }
+            }
+            return;
+        }
+        std::uint64_t stride = size_of(*type.element);
+        for (std::uint64_t i = 0; i < type.array_size; ++i) {
+            ValueId slot = offset_address(address, i * stride);
+            if (i >= lit.elements.size()) {
+                if (is_aggregate(*type.element)) {
+                    zero_memory(slot, *type.element);
+                } else {
+                    store(zero(*type.element), slot);
+                }
+                continue;
+            }
+            const ExprAST& element = *lit.elements[i];
+            if (type.element->kind == TypeKind::TYPE_ARRAY &&
+                element.kind == ExprKind::EXPR_ARRAY) {
+                store_array_literal(slot, *type.element,
+                                    static_cast<const frontend::ArrayExprAST&>(element));
+                continue;
+            }
+            RValue value = lower_expr(element, type.element);
+            if (value.value == kNoValue) {
+                continue;
+            }
+            value = convert(value, type.element, element.loc);
+            if (is_aggregate(*type.element)) {
+                copy_memory(slot, value.value, *type.element);
+            } else {
+                store(value.value, slot);
+            }
+        }
+    }
+
+    // -----------------------------------------------------------------------
+    // Expressions
+    // -----------------------------------------------------------------------
+
+    RValue fail() { return {kNoValue, nullptr}; }
+
+    // Checks that `value` has type `to`; there are no implicit conversions.
+    RValue convert(RValue value, const TypePtr& to, SourceLocation loc) {
+        if (value.value == kNoValue || !to || same_type(*value.type, *to)) {
+            return {value.value, value.value == kNoValue ? nullptr : to};
+        }
+        error(ErrorCode::E405_TYPE_MISMATCH,
+              "expected '" + frontend::type_to_string(*to) + "', found '" +
+                  frontend::type_to_string(*value.type) + "'",
+              loc);
+        return fail();
+    }
+
+    ValueId constant_from(const frontend::ConstValue& value, const Type& type) {
+        IRType ir = ir_type(type);
+        if (is_float(ir)) {
+            return fn->float_constant(ir, value.real);
+        }
+        return fn->constant(ir, constant_bits(value, type));
+    }
+
+    static std::uint64_t constant_bits(const frontend::ConstValue& value, const Type& type) {
+        if (frontend::is_float(type.kind)) {
+            return std::bit_cast<std::uint64_t>(value.real);
+        }
+        return static_cast<std::uint64_t>(value.bits);
+    }
+
+    RValue lower_expr(const ExprAST& expr, const TypePtr& expected) {
+        switch (expr.kind) {
+            case ExprKind::EXPR_NUMBER: {
+                const Type* hint = expected && (is_int_like(expected->kind) ||
+                                                frontend::is_float(expected->kind))
+                                       ? expected.get()
+                                       : nullptr;
+                std::optional<frontend::ConstValue> value = consts.evaluate(expr, hint);
+                if (!value) {
+                    failed = true;
+                    return fail();
+                }
+                TypePtr type = frontend::make_type(value->type);
+                return {constant_from(*value, *type), type};
+            }
+            case ExprKind::EXPR_BOOL: {
+                bool value = static_cast<const frontend::BoolExprAST&>(expr).value;
+                return {fn->constant(IRType::scalar(IRTypeKind::IR_I1), value ? 1 : 0),
+                        bool_type()};
+            }
+            case ExprKind::EXPR_CHAR: {
+                const auto& lit = static_cast<const frontend::CharExprAST&>(expr);
+                auto c = static_cast<unsigned char>(lit.value);
+                return {fn->constant(IRType::scalar(IRTypeKind::IR_I8), c),
+                        frontend::make_type(TypeKind::TYPE_CHAR)};
+            }
+            case ExprKind::EXPR_NULL:
+                return {fn->constant(IRType::scalar(IRTypeKind::IR_PTR), 0),
+                        frontend::make_type(TypeKind::TYPE_POINTER)};
+            case ExprKind::EXPR_VARIABLE:
+                return lower_variable(static_cast<const frontend::VariableExprAST&>(expr));
+            case ExprKind::EXPR_UNARY:
+                return lower_unary(static_cast<const frontend::UnaryExprAST&>(expr), expected);
+            case ExprKind::EXPR_BINARY:
+                return lower_binary(static_cast<const frontend::BinaryExprAST&>(expr), expected);
+            case ExprKind::EXPR_ASSIGN:
+                return lower_assign(static_cast<const frontend::AssignExprAST&>(expr));
+            case ExprKind::EXPR_CALL:
+                return lower_call(static_cast<const frontend::CallExprAST&>(expr));
+            case ExprKind::EXPR_INDEX:
+            case ExprKind::EXPR_MEMBER: {
+                LValue place = lower_place(expr);
+                return read_place(place);
+            }
+            case ExprKind::EXPR_CAST:
+                return lower_cast(static_cast<const frontend::CastExprAST&>(expr));
+            case ExprKind::EXPR_STRING:
+                return string_literal(static_cast<const frontend::StringExprAST&>(expr).value);
+            case ExprKind::EXPR_INTERPOLATION: {
+                const auto& text = static_cast<const frontend::InterpolationExprAST&>(expr);
+                std::vector<const ExprAST*> parts;
+                for (const auto& part : text.parts) {
+                    parts.push_back(part.get());
+                }
+                ValueId result = format_text(text.fragments, parts, TextTarget::TEXT_NEW);
+                return result != kNoValue ? RValue{result, string_type()} : fail();
+            }
+            case ExprKind::EXPR_NEW:
+                return lower_new(static_cast<const frontend::NewExprAST&>(expr));
+            case ExprKind::EXPR_DELETE:
+                return lower_delete(static_cast<const frontend::DeleteExprAST&>(expr));
+            case ExprKind::EXPR_ARRAY:
+                unsupported("array literal outside an initializer", expr.loc);
+                return fail();
+            case ExprKind::EXPR_LAMBDA:
+                unsupported("lambda", expr.loc);
+                return fail();
+        }
+        return fail();
+    }
+
+    RValue lower_variable(const frontend::VariableExprAST& expr) {
+        if (lookup_variable(expr.name) != kNoVariable || field_of_self(expr.name) != nullptr ||
+            globals.count(expr.name) != 0) {
+            return read_place(lower_place(expr));
+        }
+        if (expr.name == "this" && self != kNoValue) {
+            return {self, frontend::make_pointer(owner_type())};
+        }
+        auto constant = constants.find(expr.name);
+        if (constant != constants.end()) {
+            std::optional<frontend::ConstValue> value = consts.evaluate_const(expr.name);
+            if (!value) {
+                failed = true;
+                return fail();
+            }
+            TypePtr type = constant->second->type ? resolve(constant->second->type, expr.loc)
+                                                  : frontend::make_type(value->type);
+            if (!type || is_aggregate(*type) || type->kind == TypeKind::TYPE_STRING) {
+                if (type) {
+                    unsupported("constant of type '" + frontend::type_to_string(*type) + "'",
+                                expr.loc);
+                }
+                return fail();
+            }
+            return {constant_from(*value, *type), type};
+        }
+        error(ErrorCode::E404_UNDEFINED_NAME, "undefined name '" + expr.name + "'", expr.loc);
+        return fail();
+    }
+
+    TypePtr owner_type() const {
+        return frontend::make_type(
+            current->owner->is_class ? TypeKind::TYPE_CLASS : TypeKind::TYPE_STRUCT,
+            current->owner->name);
+    }
+
+    const frontend::FieldDecl* field_of_self(const std::string& name) const {
+        if (self == kNoValue) {
+            return nullptr;
+        }
+        for (const frontend::FieldDecl& field : current->owner->fields) {
+            if (field.name == name) {
+                return &field;
+            }
+        }
+        return nullptr;
+    }
+
+    // Address of field `name` in the record at `base`.
+    LValue field_place(ValueId base, const Type& record, const std::string& name,
+                       SourceLocation loc) {
+        const frontend::StructDeclAST* decl = structs.at(record.name);
+        const TypeLayout* fields = layout.layout_of(record.name);
+        if (fields != nullptr) {
+            for (const FieldLayout& field : fields->fields) {
+                if (field.name != name) {
+                    continue;
+                }
+                TypePtr type = resolve(decl->fields[field.decl_index].type, loc);
+                if (type && owns_storage(*type)) {
+                    unsupported("field of type '" + frontend::type_to_string(*type) + "'", loc);
+                    return {};
+                }
+                if (!type) {
+                    return {};
+                }
+                return {kNoVariable, offset_address(base, field.offset), type};
+            }
+        }
+        error(ErrorCode::E404_UNDEFINED_NAME,
+              "'" + record.name + "' has no field '" + name + "'", loc);
+        return {};
+    }
+
+    LValue lower_place(const ExprAST& expr) {
+        switch (expr.kind) {
+            case ExprKind::EXPR_VARIABLE: {
+                const auto& var = static_cast<const frontend::VariableExprAST&>(expr);
+                std::uint32_t id = lookup_variable(var.name);
+                if (id != kNoVariable) {
+                    const Variable& v = variables[id];
+                    if (v.soa != nullptr) {
+                        return soa_element(v.address, *v.soa, v.type, v.index);
+                    }
+                    return {v.address == kNoValue ? id : kNoVariable, v.address, v.type};
+                }
+                if (field_of_self(var.name) != nullptr) {
+                    return field_place(self, *owner_type(), var.name, expr.loc);
+                }
+                auto global = globals.find(var.name);
+                if (global != globals.end()) {
+                    return {kNoVariable, fn->global(global->second.symbol), global->second.type};
+                }
+                error(ErrorCode::E204_INVALID_ASSIGNMENT_TARGET,
+                      "cannot assign to '" + var.name + "'", expr.loc);
+                return {};
+            }
+            case ExprKind::EXPR_MEMBER: {
+                const auto& member = static_cast<const frontend::MemberExprAST&>(expr);
+                RValue base;
+                if (is_local_place(*member.base)) {
+                    LValue element = lower_place(*member.base);
+                    if (element.soa != nullptr) {
+                        return soa_field_place(element, member.member, expr.loc);
+                    }
+                    base = read_place(element);
+                } else {
+                    base = lower_expr(*member.base, nullptr);
+                }
+                if (base.value == kNoValue) {
+                    return {};
+                }
+                TypePtr record = base.type;
+                if (record->kind == TypeKind::TYPE_POINTER && record->element) {
+                    record = record->element;  // p.x and p->x both dereference
+                }
+                if (!is_record(*record)) {
+                    error(ErrorCode::E405_TYPE_MISMATCH,
+                          "'" + frontend::type_to_string(*base.type) + "' has no fields",
+                          expr.loc);
+                    return {};
+                }
+                return field_place(base.value, *record, member.member, expr.loc);
+            }
+            case ExprKind::EXPR_INDEX: {
+                const auto& index = static_cast<const frontend::IndexExprAST&>(expr);
+                RValue base = lower_expr(*index.base, nullptr);
+                RValue at = lower_expr(*index.index, i64_type());
+                if (base.value == kNoValue || at.value == kNoValue) {
+                    return {};
+                }
+                if (!is_int_like(at.type->kind)) {
+                    error(ErrorCode::E405_TYPE_MISMATCH, "array index must be an integer",
+                          index.index->loc);
+                    return {};
+                }
+                if (const Type* owner = storage_owner(*base.type)) {
+                    return owner_element(base.value, *owner, widen_index(at));
+                }
+                if ((base.type->kind != TypeKind::TYPE_ARRAY &&
+                     base.type->kind != TypeKind::TYPE_POINTER) ||
+                    !base.type->element) {
+                    error(ErrorCode::E405_TYPE_MISMATCH,
+                          "cannot index '" + frontend::type_to_string(*base.type) + "'", expr.loc);
+                    return {};
+                }
+                TypePtr element = base.type->element;
+                ValueId wide = array_index(at, *base.type);
+                if (const SoaLayout* soa = layout.soa_layout_of(*base.type)) {
+                    return soa_element(base.value, *soa, element, wide);
+                }
+                ValueId offset = scale_index({wide, i64_type()}, size_of(*element));
+                return {kNoVariable,
+                        emit(Opcode::OP_PTRADD, IRType::scalar(IRTypeKind::IR_PTR),
+                             {base.value, offset}),
+                        element};
+            }
+            default:
+                error(ErrorCode::E204_INVALID_ASSIGNMENT_TARGET, "expression is not assignable",
+                      expr.loc);
+                return {};
+        }
+    }
+
+    // An array element or local variable, which may be an element of a @soa
+    // array: lowered as a place, it reads as well as lower_expr would.
+    bool is_local_place(const ExprAST& expr) const {
+        if (expr.kind == ExprKind::EXPR_VARIABLE) {
+            const auto& var = static_cast<const frontend::VariableExprAST&>(expr);
+            return lookup_variable(var.name) != kNoVariable;
+        }
+        return expr.kind == ExprKind::EXPR_INDEX;
+    }
+
+    // Field `name` of a @soa element: an element of the field's array.
+    LValue soa_field_place(const LValue& element, const std::string& name, SourceLocation loc) {
+        const frontend::StructDeclAST* decl = structs.at(element.type->name);
+        for (const SoaField& field : element.soa->fields) {
+            if (field.name != name) {
+                continue;
+            }
+            TypePtr type = resolve(decl->fields[field.decl_index].type, loc);
+            if (type && owns_storage(*type)) {
+                unsupported("field of type '" + frontend::type_to_string(*type) + "'", loc);
+                return {};
+            }
+            if (!type) {
+                return {};
+            }
+            ValueId array = offset_address(element.address, field.offset);
+            return {kNoVariable, element_address(array, element.index, *type), type};
+        }
+        error(ErrorCode::E404_UNDEFINED_NAME,
+              "'" + element.type->name + "' has no field '" + name + "'", loc);
+        return {};
+    }
+
+    // The index as an i64. Indexing a fixed-size array checks it against the
+    // length; a negative index wraps to a huge unsigned value and fails too.
+    ValueId array_index(const RValue& index, const Type& base) {
+        IRType i64 = IRType::scalar(IRTypeKind::IR_I64);
+        ValueId wide = widen_index(index);
+        if (base.kind == TypeKind::TYPE_ARRAY && options.bounds_checks) {
+            emit(Opcode::OP_BOUNDS_CHECK, IRType(), {wide, fn->constant(i64, base.array_size)});
+        }
+        return wide;
+    }
+
+    ValueId widen_index(const RValue& index) {
+        IRType i64 = IRType::scalar(IRTypeKind::IR_I64);
+        if (ir_type(*index.type) == i64) {
+            return index.value;
+        }
+        return emit(frontend::is_signed(index.type->kind) ? Opcode::OP_SEXT : Opcode::OP_ZEXT,
+                    i64, {index.value});
+    }
+
+    // index * stride as an i64 byte offset.
+    ValueId scale_index(const RValue& index, std::uint64_t stride) {
+        IRType i64 = IRType::scalar(IRTypeKind::IR_I64);
+        ValueId wide = widen_index(index);
+        if (stride == 1) {
+            return wide;
+        }
+        return emit(Opcode::OP_MUL, i64, {wide, fn->constant(i64, stride)});
+    }
+
+    RValue read_place(const LValue& place) {
+        if (!place.type) {
+            return fail();
+        }
+        if (place.variable != kNoVariable) {
+            return {read_variable(place.variable, insertion_block()), place.type};
+        }
+        if (place.soa != nullptr) {
+            ValueId copy = stack_slot(*place.type);
+            copy_soa_element(place, copy, false);
+            return {copy, place.type};
+        }
+        if (is_aggregate(*place.type)) {
+            return {place.address, place.type};
+        }
+        return {load(place.address, *place.type), place.type};
+    }
+
+    void write_place(const LValue& place, ValueId value) {
+        if (place.variable != kNoVariable) {
+            write_variable(place.variable, insertion_block(), value);
+        } else if (place.soa != nullptr) {
+            copy_soa_element(place, value, true);
+        } else if (is_aggregate(*place.type)) {
+            copy_memory(place.address, value, *place.type);
+        } else {
+            store(value, place.address);
+        }
+    }
+
+    RValue lower_unary(const frontend::UnaryExprAST& expr, const TypePtr& expected) {
+        if (expr.op == TokenType::TOKEN_PLUS_PLUS || expr.op == TokenType::TOKEN_MINUS_MINUS) {
+            LValue place = lower_place(*expr.operand);
+            RValue old = read_place(place);
+            if (old.value == kNoValue) {
+                return fail();
+            }
+            if (!is_int_like(old.type->kind) && !frontend::is_float(old.type->kind)) {
+                error(ErrorCode::E405_TYPE_MISMATCH, "'++' and '--' need a numeric operand",
+                      expr.loc);
+                return fail();
+            }
+            IRType ir = ir_type(*old.type);
+            ValueId one = is_float(ir) ? fn->float_constant(ir, 1.0) : fn->constant(ir, 1);
+            TokenType op = expr.op == TokenType::TOKEN_PLUS_PLUS ? TokenType::TOKEN_PLUS
+                                                                 : TokenType::TOKEN_MINUS;
+            RValue updated = arithmetic(op, old, {one, old.type}, expr.loc);
+            write_place(place, updated.value);
+            return expr.postfix ? old : updated;
+        }
+        RValue operand = lower_expr(*expr.operand, expected);
+        if (operand.value == kNoValue) {
+            return fail();
+        }
+        IRType ir = ir_type(*operand.type);
+        switch (expr.op) {
+            case TokenType::TOKEN_MINUS:
+                if (is_float(ir)) {
+                    return {emit(Opcode::OP_FNEG, ir, {operand.value}), operand.type};
+                }
+                if (is_int_like(operand.type->kind)) {
+                    return {emit(Opcode::OP_SUB, ir, {fn->constant(ir, 0), operand.value}),
+                            operand.type};
+                }
+                break;
+            case TokenType::TOKEN_LOGICAL_NOT:
+                if (operand.type->kind == TypeKind::TYPE_BOOL) {
+                    return {emit(Opcode::OP_XOR, ir, {operand.value, fn->constant(ir, 1)}),
+                            operand.type};
+                }
+                break;
+            case TokenType::TOKEN_TILDE:
+                if (is_int_like(operand.type->kind)) {
+                    return {emit(Opcode::OP_XOR, ir, {operand.value, fn->constant(ir, ~0ull)}),
+                            operand.type};
+                }
+                break;
+            default:
+                break;
+        }
+        error(ErrorCode::E405_TYPE_MISMATCH,
+              "invalid operand type '" + frontend::type_to_string(*operand.type) + "'", expr.loc);
+        return fail();
+    }
+
+    // True for expressions whose type is taken from context: integer and float
+    // literals, and arithmetic on nothing but them, such as `-1` or `(2 + 3)`.
+    bool is_untyped_literal(const ExprAST& expr) {
+        if (expr.kind == ExprKind::EXPR_NUMBER) {
+            return true;
+        }
+        if (expr.kind == ExprKind::EXPR_UNARY) {
+            const auto& unary = static_cast<const frontend::UnaryExprAST&>(expr);
+            return (unary.op == TokenType::TOKEN_MINUS || unary.op == TokenType::TOKEN_TILDE) &&
+                   is_untyped_literal(*unary.operand);
+        }
+        if (expr.kind != ExprKind::EXPR_BINARY) {
+            return false;
+        }
+        auto known = untyped_binaries.find(&expr);
+        if (known != untyped_binaries.end()) {
+            return known->second;
+        }
+        const auto& binary = static_cast<const frontend::BinaryExprAST&>(expr);
+        bool untyped = !is_comparison(binary.op) && binary.op != TokenType::TOKEN_LOGICAL_AND &&
+                       binary.op != TokenType::TOKEN_LOGICAL_OR &&
+                       is_untyped_literal(*binary.lhs) && is_untyped_literal(*binary.rhs);
+        untyped_binaries.emplace(&expr, untyped);
+        return untyped;
+    }
+
+    RValue lower_binary(const frontend::BinaryExprAST& expr, const TypePtr& expected) {
+        if (expr.op == TokenType::TOKEN_LOGICAL_AND || expr.op == TokenType::TOKEN_LOGICAL_OR) {
+            return lower_logical(expr);
+        }
+        TypePtr hint = is_comparison(expr.op) ? nullptr : expected;
+        RValue lhs;
+        RValue rhs;
+        if (is_untyped_literal(*expr.lhs) && !is_untyped_literal(*expr.rhs)) {
+            // `1 + x`: the literal takes its type from the other side. Literals
+            // have no side effects, so evaluating the right side first is safe.
+            rhs = lower_expr(*expr.rhs, hint);
+            if (rhs.value == kNoValue) {
+                return fail();
+            }
+            lhs = lower_expr(*expr.lhs, rhs.type);
+        } else {
+            lhs = lower_expr(*expr.lhs, hint);
+            if (lhs.value == kNoValue) {
+                return fail();
+            }
+            bool shift = expr.op == TokenType::TOKEN_LEFT_SHIFT ||
+                         expr.op == TokenType::TOKEN_RIGHT_SHIFT;
+            rhs = lower_expr(*expr.rhs, shift && !is_int_like(lhs.type->kind) ? nullptr : lhs.type);
+        }
+        if (lhs.value == kNoValue || rhs.value == kNoValue) {
+            return fail();
+        }
+        if (is_comparison(expr.op)) {
+            return compare(expr.op, lhs, rhs, expr.loc);
+        }
+        return arithmetic(expr.op, lhs, rhs, expr.loc);
+    }
+
+    RValue lower_logical(const frontend::BinaryExprAST& expr) {
+        bool is_and = expr.op == TokenType::TOKEN_LOGICAL_AND;
+        ValueId lhs = lower_condition(*expr.lhs);
+        BlockId lhs_end = insertion_block();
+        BlockId rhs_block = new_block();
+        BlockId join = new_block();
+        if (is_and) {
+            cond_branch(lhs, rhs_block, join);
+        } else {
+            cond_branch(lhs, join, rhs_block);
+        }
+        seal(rhs_block);
+        block = rhs_block;
+        ValueId rhs = lower_condition(*expr.rhs);
+        BlockId rhs_end = insertion_block();
+        branch(join);
+        seal(join);
+        block = join;
+        IRType i1 = IRType::scalar(IRTypeKind::IR_I1);
+        ValueId phi = new_phi(join, i1);
+        fn->add_incoming(phi, fn->constant(i1, is_and ? 0 : 1), lhs_end);
+        fn->add_incoming(phi, rhs, rhs_end);
+        return {phi, bool_type()};
+    }
+
+    RValue compare(TokenType op, const RValue& lhs, const RValue& rhs, SourceLocation loc) {
+        if (!same_type(*lhs.type, *rhs.type) || is_aggregate(*lhs.type)) {
+            error(ErrorCode::E405_TYPE_MISMATCH,
+                  "cannot compare '" + frontend::type_to_string(*lhs.type) + "' with '" +
+                      frontend::type_to_string(*rhs.type) + "'",
+                  loc);
+            return fail();
+        }
+        TypeKind kind = lhs.type->kind;
+        bool fp = frontend::is_float(kind);
+        CmpPredicate pred = predicate_for(op, fp, frontend::is_signed(kind));
+        ValueId v = emit(fp ? Opcode::OP_FCMP : Opcode::OP_ICMP, IRType::scalar(IRTypeKind::IR_I1),
+                         {lhs.value, rhs.value});
+        fn->inst(v).aux = static_cast<std::uint32_t>(pred);
+        return {v, bool_type()};
+    }
+
+    RValue arithmetic(TokenType op, const RValue& lhs, const RValue& rhs, SourceLocation loc) {
+        TypeKind kind = lhs.type->kind;
+        // Pointer arithmetic: p + n and p - n step by whole elements.
+        if (kind == TypeKind::TYPE_POINTER && lhs.type->element && is_int_like(rhs.type->kind) &&
+            (op == TokenType::TOKEN_PLUS || op == TokenType::TOKEN_MINUS)) {
+            ValueId offset = scale_index(rhs, size_of(*lhs.type->element));
+            if (op == TokenType::TOKEN_MINUS) {
+                IRType i64 = IRType::scalar(IRTypeKind::IR_I64);
+                offset = emit(Opcode::OP_SUB, i64, {fn->constant(i64, 0), offset});
+            }
+            IRType ptr = IRType::scalar(IRTypeKind::IR_PTR);
+            return {emit(Opcode::OP_PTRADD, ptr, {lhs.value, offset}), lhs.type};
+        }
+        if (!same_type(*lhs.type, *rhs.type)) {
+            error(ErrorCode::E405_TYPE_MISMATCH,
+                  "mismatched operand types '" + frontend::type_to_string(*lhs.type) + "' and '" +
+                      frontend::type_to_string(*rhs.type) + "'",
+                  loc);
+            return fail();
+        }
+        bool fp = frontend::is_float(kind);
+        bool is_signed = frontend::is_signed(kind);
+        bool integral = is_int_like(kind);
+        bool logical = kind == TypeKind::TYPE_BOOL;
+        std::optional<Opcode> opcode;
+        switch (op) {
+            case TokenType::TOKEN_PLUS:
+                if (fp) opcode = Opcode::OP_FADD; else if (integral) opcode = Opcode::OP_ADD;
+                break;
+            case TokenType::TOKEN_MINUS:
+                if (fp) opcode = Opcode::OP_FSUB; else if (integral) opcode = Opcode::OP_SUB;
+                break;
+            case TokenType::TOKEN_STAR:
+                if (fp) opcode = Opcode::OP_FMUL; else if (integral) opcode = Opcode::OP_MUL;
+                break;
+            case TokenType::TOKEN_SLASH:
+                if (fp) opcode = Opcode::OP_FDIV;
+                else if (integral) opcode = is_signed ? Opcode::OP_SDIV : Opcode::OP_UDIV;
+                break;
+            case TokenType::TOKEN_PERCENT:
+                if (fp) opcode = Opcode::OP_FREM;
+                else if (integral) opcode = is_signed ? Opcode::OP_SREM : Opcode::OP_UREM;
+                break;
+            case TokenType::TOKEN_AMPERSAND:
+                if (integral || logical) opcode = Opcode::OP_AND;
+                break;
+            case TokenType::TOKEN_PIPE:
+                if (integral || logical) opcode = Opcode::OP_OR;
+                break;
+            case TokenType::TOKEN_CARET:
+                if (integral || logical) opcode = Opcode::OP_XOR;
+                break;
+            case TokenType::TOKEN_LEFT_SHIFT:
+                if (integral) opcode = Opcode::OP_SHL;
+                break;
+            case TokenType::TOKEN_RIGHT_SHIFT:
+                if (integral) opcode = is_signed ? Opcode::OP_ASHR : Opcode::OP_LSHR;
+                break;
+            default:
+                break;
+        }
+        if (!opcode) {
+            error(ErrorCode::E405_TYPE_MISMATCH,
+                  "invalid operand type '" + frontend::type_to_string(*lhs.type) + "'", loc);
+            return fail();
+        }
+        return {emit(*opcode, ir_type(*lhs.type), {lhs.value, rhs.value}), lhs.type};
+    }
+
+    RValue lower_assign(const frontend::AssignExprAST& expr) {
+        LValue place = lower_place(*expr.target);
+        if (!place.type) {
+            return fail();
+        }
+        if (is_arena(*place.type)) {
+            error(ErrorCode::E405_TYPE_MISMATCH, "an Arena cannot be assigned", expr.loc);
+            return fail();
+        }
+        if (owns_storage(*place.type)) {
+            return assign_owner(place, expr);
+        }
+        RValue value = lower_expr(*expr.value, place.type);
+        if (value.value == kNoValue) {
+            return fail();
+        }
+        if (expr.op != TokenType::TOKEN_ASSIGN) {
+            RValue old = read_place(place);
+            value = arithmetic(compound_operator(expr.op), old, value, expr.loc);
+        } else {
+            value = convert(value, place.type, expr.value->loc);
+        }
+        if (value.value == kNoValue) {
+            return fail();
+        }
+        write_place(place, value.value);
+        if (is_aggregate(*place.type)) {
+            // The old value is overwritten, not destroyed, as with a field.
+            if (is_dead_after(*expr.value, value.value)) {
+                set_live(value.value, false);
+            }
+            if (expr.target->kind == ExprKind::EXPR_VARIABLE) {
+                set_live(place.address, true);
+            }
+        }
+        return value;
+    }
+
+    RValue lower_cast(const frontend::CastExprAST& expr) {
+        TypePtr to = resolve(expr.target, expr.loc);
+        if (!to) {
+            return fail();
+        }
+        RValue from = lower_expr(*expr.operand, to);
+        if (from.value == kNoValue) {
+            return fail();
+        }
+        TypeKind a = from.type->kind;
+        TypeKind b = to->kind;
+        IRType src = ir_type(*from.type);
+        IRType dst = ir_type(*to);
+        if (same_type(*from.type, *to) || (src == dst && !frontend::is_float(a) &&
+                                           (is_int_like(a) || a == TypeKind::TYPE_POINTER))) {
+            return {from.value, to};  // same representation, e.g. i32 -> u32
+        }
+        std::optional<Opcode> op;
+        if (b == TypeKind::TYPE_BOOL && (is_int_like(a) || a == TypeKind::TYPE_POINTER)) {
+            ValueId v = emit(Opcode::OP_ICMP, dst, {from.value, fn->constant(src, 0)});
+            fn->inst(v).aux = static_cast<std::uint32_t>(CmpPredicate::CMP_NE);
+            return {v, to};
+        }
+        bool int_from = is_int_like(a) || a == TypeKind::TYPE_BOOL;
+        if (int_from && is_int_like(b)) {
+            if (type_bits(dst) < type_bits(src)) {
+                op = Opcode::OP_TRUNC;
+            } else {
+                op = frontend::is_signed(a) ? Opcode::OP_SEXT : Opcode::OP_ZEXT;
+            }
+        } else if (int_from && frontend::is_float(b)) {
+            op = frontend::is_signed(a) ? Opcode::OP_SITOFP : Opcode::OP_UITOFP;
+        } else if (frontend::is_float(a) && is_int_like(b)) {
+            op = frontend::is_signed(b) ? Opcode::OP_FPTOSI : Opcode::OP_FPTOUI;
+        } else if (frontend::is_float(a) && frontend::is_float(b)) {
+            op = type_bits(dst) > type_bits(src) ? Opcode::OP_FPEXT : Opcode::OP_FPTRUNC;
+        } else if (a == TypeKind::TYPE_POINTER && is_int_like(b)) {
+            op = Opcode::OP_PTRTOINT;
+        } else if (is_int_like(a) && b == TypeKind::TYPE_POINTER) {
+            op = Opcode::OP_INTTOPTR;
+        } else if ((a == TypeKind::TYPE_POINTER || a == TypeKind::TYPE_ARRAY) &&
+                   b == TypeKind::TYPE_POINTER) {
+            return {from.value, to};  // arrays are already represented by their address
+        }
+        if (!op) {
+            error(ErrorCode::E405_TYPE_MISMATCH,
+                  "cannot cast '" + frontend::type_to_string(*from.type) + "' to '" +
+                      frontend::type_to_string(*to) + "'",
+                  expr.loc);
+            return fail();
+        }
+        return {emit(*op, dst, {from.value}), to};
+    }
+
+    RValue lower_call(const frontend::CallExprAST& expr) {
+        // Only this call may build into the target, not the calls in its arguments.
+        ValueId target = std::exchange(aggregate_target, kNoValue);
+        if (vec_constructor(expr) != nullptr) {
+            error(ErrorCode::E405_TYPE_MISMATCH,
+                  "Vec<T>(...) can only initialize a Vec variable", expr.loc);
+            return fail();
+        }
+        if (!expr.type_args.empty()) {
+            unsupported("call with generic arguments", expr.loc);
+            return fail();
+        }
+        Signature* callee = nullptr;
+        ValueId object = kNoValue;
+        LValue element;  // a @soa element, whose method runs on a gathered copy
+        if (expr.callee->kind == ExprKind::EXPR_VARIABLE) {
+            const auto& var = static_cast<const frontend::VariableExprAST&>(*expr.callee);
+            const std::string& name = var.name;
+            if (self != kNoValue) {
+                callee = find_signature(current->owner->name + "." + name);
+                object = callee != nullptr ? self : kNoValue;
+            }
+            if (callee == nullptr) {
+                callee = find_signature(name);
+            }
+            if (callee == nullptr && structs.count(name) != 0) {
+                return construct(name, expr, target);
+            }
+            if (callee == nullptr && (name == "print" || name == "println")) {
+                return lower_print(expr, name == "println");
+            }
+            if (callee == nullptr && name == "black_box") {
+                return lower_black_box(expr);
+            }
+            if (callee == nullptr && name == "Arena") {
+                error(ErrorCode::E405_TYPE_MISMATCH,
+                      "Arena(...) can only initialize an Arena variable", expr.loc);
+                return fail();
+            }
+            if (callee == nullptr) {
+                error(ErrorCode::E404_UNDEFINED_NAME, "undefined function '" + name + "'",
+                      expr.callee->loc);
+                return fail();
+            }
+        } else if (expr.callee->kind == ExprKind::EXPR_MEMBER) {
+            const auto& member = static_cast<const frontend::MemberExprAST&>(*expr.callee);
+            auto slice = std::exchange(slice_target, {});  // only for this call
+            RValue base;
+            if (is_local_place(*member.base)) {
+                element = lower_place(*member.base);
+                base = read_place(element);
+            } else {
+                base = lower_expr(*member.base, nullptr);
+            }
+            if (base.value == kNoValue) {
+                return fail();
+            }
+            TypePtr record = base.type;
+            if (record->kind == TypeKind::TYPE_POINTER && record->element) {
+                record = record->element;
+            }
+            if (is_arena(*record)) {
+                return arena_method(base.value, member.member, expr);
+            }
+            if (is_vec(*record)) {
+                return vec_method(base.value, *record, owner_arena(*member.base), expr);
+            }
+            if (record->kind == TypeKind::TYPE_STRING) {
+                return string_method(base.value, owner_arena(*member.base), expr, slice.string,
+                                     slice.arena);
+            }
+            if (is_record(*record)) {
+                callee = find_signature(record->name + "." + member.member);
+            }
+            if (callee == nullptr) {
+                error(ErrorCode::E404_UNDEFINED_NAME,
+                      "'" + frontend::type_to_string(*base.type) + "' has no method '" +
+                          member.member + "'",
+                      expr.callee->loc);
+                return fail();
+            }
+            object = base.value;
+        } else {
+            unsupported("indirect call", expr.loc);
+            return fail();
+        }
+        if (callee->owner != nullptr && object == kNoValue) {
+            error(ErrorCode::E404_UNDEFINED_NAME,
+                  "method '" + callee->fn->name + "' needs an object", expr.callee->loc);
+            return fail();
+        }
+        RValue result = call(*callee, object, expr.args, expr.loc, target);
+        if (element.soa != nullptr && result.value != kNoValue) {
+            copy_soa_element(element, object, true);
+        }
+        return result;
+    }
+
+    // Aggregate results are written to `target` if there is one, else to a
+    // new temporary.
+    RValue call(Signature& callee, ValueId object,
+                const std::vector<std::unique_ptr<ExprAST>>& args, SourceLocation loc,
+                ValueId target = kNoValue) {
+        if (args.size() != callee.params.size()) {
+            error(ErrorCode::E406_WRONG_ARGUMENT_COUNT,
+                  "'" + callee.fn->name + "' takes " + std::to_string(callee.params.size()) +
+                      " arguments, " + std::to_string(args.size()) + " given",
+                  loc);
+            return fail();
+        }
+        std::vector<ValueId> operands;
+        ValueId result = kNoValue;
+        if (callee.result != ResultPassing::RESULT_VALUE) {
+            result = target != kNoValue ? target : stack_slot(*callee.ret);
+        }
+        if (callee.result == ResultPassing::RESULT_SLOT) {
+            operands.push_back(result);
+        }
+        if (object != kNoValue) {
+            operands.push_back(object);
+        }
+        for (std::size_t i = 0; i < args.size(); ++i) {
+            const TypePtr& param = callee.params[i];
+            RValue arg = lower_expr(*args[i], param);
+            if (arg.value != kNoValue && owns_storage(*arg.type) &&
+                param->kind == TypeKind::TYPE_POINTER && param->element &&
+                same_type(*param->element, *arg.type)) {
+                arg.type = param;  // a string or Vec passed to a `T*` lends its address
+            }
+            arg = convert(arg, param, args[i]->loc);
+            if (arg.value == kNoValue) {
+                return fail();
+            }
+            if (is_arena(*arg.type)) {
+                error(ErrorCode::E405_TYPE_MISMATCH,
+                      "an Arena cannot be passed by value; pass an Arena*", args[i]->loc);
+                return fail();
+            }
+            if (!is_aggregate(*arg.type)) {
+                operands.push_back(arg.value);
+                continue;
+            }
+            // By-value aggregates belong to the callee. One that is not used
+            // again is handed over in place, anything else as a private copy;
+            // small records go as their fields either way.
+            bool moved = is_dead_after(*args[i], arg.value) && arg.value != object &&
+                         std::find(operands.begin(), operands.end(), arg.value) == operands.end();
+            std::vector<RegisterField> fields = register_fields(*arg.type);
+            for (const RegisterField& field : fields) {
+                operands.push_back(emit(Opcode::OP_LOAD, field.type,
+                                        {offset_address(arg.value, field.offset)}));
+            }
+            if (fields.empty() && moved) {
+                operands.push_back(arg.value);
+            } else if (fields.empty()) {
+                ValueId copy = stack_slot(*arg.type);
+                copy_memory(copy, arg.value, *arg.type);
+                operands.push_back(copy);
+            }
+            if (moved) {
+                set_live(arg.value, false);
+            }
+        }
+        ValueId v =
+            fn->append(insertion_block(), Opcode::OP_CALL, callee.fn->return_type, operands);
+        fn->inst(v).aux = module->intern(callee.fn->name);
+        if (result == kNoValue) {
+            return {v, callee.ret};
+        }
+        if (callee.result == ResultPassing::RESULT_FIELD) {
+            store(v, offset_address(result, register_fields(*callee.ret)[0].offset));
+        }
+        if (result != target) {
+            temporary(result, callee.ret);
+        }
+        return {result, callee.ret};
+    }
+
+    // `object` was built by a call for the expression around it, which may
+    // move it; whatever it does not move is destroyed with the scope.
+    void temporary(ValueId object, const TypePtr& type) {
+        temporaries.insert(object);
+        destroy_at_scope_end(object, type);
+    }
+
+    // Class(args): a temporary initialized by the constructor, if there is one,
+    // or `target` itself when the call initializes it.
+    RValue construct(const std::string& name, const frontend::CallExprAST& expr, ValueId target) {
+        TypePtr type = resolve(frontend::make_type(TypeKind::TYPE_UNKNOWN, name), expr.loc);
+        if (!type) {
+            return fail();
+        }
+        ValueId object = target != kNoValue ? target : stack_slot(*type);
+        zero_memory(object, *type);
+        Signature* ctor = find_signature(name + ".$ctor");
+        if (ctor != nullptr) {
+            if (call(*ctor, object, expr.args, expr.loc).type == nullptr) {
+                return fail();
+            }
+        } else if (!expr.args.empty()) {
+            error(ErrorCode::E406_WRONG_ARGUMENT_COUNT, "'" + name + "' has no constructor",
+                  expr.loc);
+            return fail();
+        }
+        if (object != target) {
+            temporary(object, type);
+        }
+        return {object, type};
+    }
+
+    // new T, new T(args) and new T[count]: zeroed memory, then the constructor
+    // or the single initializer for scalars. Inside an arena block, and with
+    // new(arena), the memory comes from the arena; otherwise from the heap.
+    RValue lower_new(const frontend::NewExprAST& expr) {
+        ValueId arena = arenas.empty() ? kNoValue : arenas.back();
+        if (expr.arena) {
+            arena = arena_address(*expr.arena);
+            if (arena == kNoValue) {
+                return fail();
+            }
+        }
+        TypePtr type = resolve(expr.allocated, expr.loc);
+        if (!type) {
+            return fail();
+        }
+        if (is_arena(*type) || owns_storage(*type)) {
+            error(ErrorCode::E405_TYPE_MISMATCH,
+                  "'" + frontend::type_to_string(*type) + "' cannot be allocated with 'new'",
+                  expr.loc);
+            return fail();
+        }
+        IRType i64 = IRType::scalar(IRTypeKind::IR_I64);
+        IRType ptr = IRType::scalar(IRTypeKind::IR_PTR);
+        TypePtr result = frontend::make_pointer(type);
+        std::uint64_t size = std::max<std::uint64_t>(size_of(*type), 1);
+        ValueId count = kNoValue;
+        if (expr.count) {
+            RValue n = lower_expr(*expr.count, i64_type());
+            if (n.value == kNoValue) {
+                return fail();
+            }
+            if (!frontend::is_integer(n.type->kind)) {
+                error(ErrorCode::E405_TYPE_MISMATCH,
+                      "array size must be an integer, found '" +
+                          frontend::type_to_string(*n.type) + "'",
+                      expr.count->loc);
+                return fail();
+            }
+            count = widen_index(n);
+        }
+        if (arena != kNoValue) {
+            ValueId object =
+                arena_new(arena, *type, count, static_cast<std::uint32_t>(expr.loc.line));
+            return count != kNoValue || initialize_new(object, type, expr) ? RValue{object, result}
+                                                                          : fail();
+        }
+        // The line goes with the allocation, for heap profiles.
+        if (count != kNoValue) {
+            ValueId bytes = scale_index({count, i64_type()}, size);
+            ValueId array = emit(Opcode::OP_NEW, ptr, {bytes});
+            fn->inst(array).aux = static_cast<std::uint32_t>(expr.loc.line);
+            return {array, result};
+        }
+        ValueId object = emit(Opcode::OP_NEW, ptr, {fn->constant(i64, size_of(*type))});
+        fn->inst(object).aux = static_cast<std::uint32_t>(expr.loc.line);
+        return initialize_new(object, type, expr) ? RValue{object, result} : fail();
+    }
+
+    bool initialize_new(ValueId object, const TypePtr& type, const frontend::NewExprAST& expr) {
+        if (is_record(*type)) {
+            Signature* ctor = find_signature(type->name + ".$ctor");
+            if (ctor != nullptr) {
+                return call(*ctor, object, expr.args, expr.loc).type != nullptr;
+            }
+            if (!expr.args.empty()) {
+                error(ErrorCode::E406_WRONG_ARGUMENT_COUNT,
+                      "'" + type->name + "' has no constructor", expr.loc);
+                return false;
+            }
+        } else if (!expr.args.empty()) {
+            if (expr.args.size() != 1 || is_aggregate(*type)) {
+                error(ErrorCode::E406_WRONG_ARGUMENT_COUNT,
+                      "'new " + frontend::type_to_string(*type) + "' takes one initializer",
+                      expr.loc);
+                return false;
+            }
+            RValue init = convert(lower_expr(*expr.args[0], type), type, expr.args[0]->loc);
+            if (init.value == kNoValue) {
+                return false;
+            }
+            store(init.value, object);
+        }
+        return true;
+    }
+
+    // delete p: runs the destructor, if the type has one, unless p is null.
+    RValue lower_delete(const frontend::DeleteExprAST& expr) {
+        RValue operand = lower_expr(*expr.operand, nullptr);
+        if (operand.value == kNoValue) {
+            return fail();
+        }
+        if (operand.type->kind != TypeKind::TYPE_POINTER) {
+            error(ErrorCode::E405_TYPE_MISMATCH,
+                  "cannot delete '" + frontend::type_to_string(*operand.type) + "'",
+                  expr.loc);
+            return fail();
+        }
+        // Literals live in read-only data. The interpreter catches their
+        // deletion at run time; compiled code would crash in free().
+        if (fn->inst(operand.value).op == Opcode::OP_GLOBAL &&
+            module->symbol_name(fn->inst(operand.value).aux).starts_with("pallas.str.")) {
+            error(ErrorCode::E405_TYPE_MISMATCH, "cannot delete a string literal", expr.loc);
+            return fail();
+        }
+        const TypePtr& pointee = operand.type->element;
+        Signature* dtor =
+            pointee && is_record(*pointee) ? find_signature(pointee->name + ".$dtor") : nullptr;
+        if (dtor != nullptr) {
+            IRType ptr = IRType::scalar(IRTypeKind::IR_PTR);
+            ValueId null = fn->constant(ptr, 0);
+            ValueId live = emit(Opcode::OP_ICMP, IRType::scalar(IRTypeKind::IR_I1),
+                                {operand.value, null});
+            fn->inst(live).aux = static_cast<std::uint32_t>(CmpPredicate::CMP_NE);
+            BlockId destroy = new_block();
+            BlockId join = new_block();
+            cond_branch(live, destroy, join);
+            seal(destroy);
+            block = destroy;
+            call(*dtor, operand.value, {}, expr.loc);
+            branch(join);
+            seal(join);
+            block = join;
+        }
+        ValueId v = emit(Opcode::OP_DELETE, IRType(), {operand.value});
+        return {v, frontend::make_type(TypeKind::TYPE_VOID)};
+    }
+
+    // -----------------------------------------------------------------------
+    // Arenas
+    // -----------------------------------------------------------------------
+
+    // Allocations of at most this many bytes bump the cursor inline; larger
+    // or variable-sized ones call the runtime.
+    static constexpr std::uint64_t kInlineArenaBytes = 256;
+    // In front of an arena object with a destructor: the next list entry, the
+    // kind and the element count.
+    static constexpr std::uint64_t kFinalizerHeaderBytes = 24;
+
+    static std::uint64_t align_up(std::uint64_t value, std::uint64_t align) {
+        return (value + align - 1) & ~(align - 1);
+    }
+
+    TypePtr arena_type() { return frontend::make_type(TypeKind::TYPE_CLASS, "Arena"); }
+
+    Function* runtime_function(const std::string& name, IRType ret,
+                               const std::vector<IRType>& params) {
+        auto found = runtime_functions.find(name);
+        if (found != runtime_functions.end()) {
+            return found->second;
+        }
+        Function* f = module->add_function(name, ret, params);
+        f->flags |= FUNCTION_EXTERN;
+        runtime_functions[name] = f;
+        return f;
+    }
+
+    ValueId call_function(const Function* callee, std::initializer_list<ValueId> operands) {
+        ValueId v = emit(Opcode::OP_CALL, callee->return_type, operands);
+        fn->inst(v).aux = module->intern(callee->name);
+        return v;
+    }
+
+    // Calls pallas_arena_<name>(arena) for free_all and release.
+    void arena_runtime_call(const std::string& name, ValueId arena) {
+        IRType ptr = IRType::scalar(IRTypeKind::IR_PTR);
+        call_function(
+            runtime_function("pallas_arena_" + name, IRType::scalar(IRTypeKind::IR_VOID), {ptr}),
+            {arena});
+    }
+
+    // Collects the types whose objects need their destructor run when an
+    // arena is freed; the finalizer function is only created if there are any.
+    void declare_arena_finalizer() {
+        for (const auto& decl : ast.decls) {
+            if (decl->kind != NodeType::NODE_STRUCT) {
+                continue;
+            }
+            const auto& s = static_cast<const frontend::StructDeclAST&>(*decl);
+            Signature* dtor = find_signature(s.name + ".$dtor");
+            if (dtor == nullptr || dtor->fn == nullptr) {
+                continue;
+            }
+            finalizable_kinds[s.name] = static_cast<std::uint32_t>(finalizables.size());
+            finalizables.push_back(
+                {frontend::make_type(s.is_class ? TypeKind::TYPE_CLASS : TypeKind::TYPE_STRUCT,
+                                     s.name),
+                 dtor});
+        }
+        if (!finalizables.empty()) {
+            arena_finalizer = module->add_function("pallas.arena_finalize",
+                                                   IRType::scalar(IRTypeKind::IR_VOID),
+                                                   {IRType::scalar(IRTypeKind::IR_PTR)});
+        }
+    }
+
+    // @pallas.arena_finalize(arena) walks the arena's finalizer list, newest
+    // object first, calls the destructor of every element and empties the list.
+    void lower_arena_finalizer() {
+        begin_function(arena_finalizer, nullptr);
+        IRType i1 = IRType::scalar(IRTypeKind::IR_I1);
+        IRType i64 = IRType::scalar(IRTypeKind::IR_I64);
+        IRType ptr = IRType::scalar(IRTypeKind::IR_PTR);
+        ValueId null = fn->constant(ptr, 0);
+        ValueId list = offset_address(fn->arg(0), runtime::kArenaFinalizersOffset);
+        variables.push_back({frontend::make_type(TypeKind::TYPE_POINTER), kNoValue});
+        auto node = static_cast<std::uint32_t>(variables.size() - 1);
+        write_variable(node, insertion_block(), emit(Opcode::OP_LOAD, ptr, {list}));
+        store(null, list);
+        emit_loop(
+            [&] {
+                ValueId current = read_variable(node, insertion_block());
+                ValueId v = emit(Opcode::OP_ICMP, i1, {current, null});
+                fn->inst(v).aux = static_cast<std::uint32_t>(CmpPredicate::CMP_NE);
+                return v;
+            },
+            [&] {
+                ValueId header = read_variable(node, insertion_block());
+                ValueId next = emit(Opcode::OP_LOAD, ptr, {header});
+                ValueId kind = emit(Opcode::OP_LOAD, i64, {offset_address(header, 8)});
+                ValueId count = emit(Opcode::OP_LOAD, i64, {offset_address(header, 16)});
+                for (std::uint32_t k = 0; k < finalizables.size(); ++k) {
+                    const Finalizable& type = finalizables[k];
+                    ValueId matches = emit(Opcode::OP_ICMP, i1, {kind, fn->constant(i64, k)});
+                    fn->inst(matches).aux = static_cast<std::uint32_t>(CmpPredicate::CMP_EQ);
+                    BlockId run = new_block();
+                    BlockId skip = new_block();
+                    cond_branch(matches, run, skip);
+                    seal(run);
+                    block = run;
+                    std::uint64_t align = std::max<std::uint64_t>(layout.align_of(*type.type),
+                                                                  runtime::kArenaAlignment);
+                    ValueId objects =
+                        offset_address(header, align_up(kFinalizerHeaderBytes, align));
+                    counted_loop(count, [&](ValueId i) {
+                        call_function(type.dtor->fn, {element_address(objects, i, *type.type)});
+                    });
+                    branch(skip);
+                    seal(skip);
+                    block = skip;
+                }
+                write_variable(node, insertion_block(), next);
+            },
+            [] {}, false);
+        emit(Opcode::OP_RET, IRType());
+        block = kNoBlock;
+        finish_function();
+    }
+
+    void finalize_arena(ValueId arena) {
+        if (arena_finalizer != nullptr) {
+            call_function(arena_finalizer, {arena});
+        }
+    }
+
+    void release_arena(ValueId arena) {
+        finalize_arena(arena);
+        arena_runtime_call("release", arena);
+    }
+
+    // The capacity argument of arena(n) or Arena(n) as an i64, kNoValue on error.
+    ValueId arena_capacity(const ExprAST* expr) {
+        IRType i64 = IRType::scalar(IRTypeKind::IR_I64);
+        if (expr == nullptr) {
+            return fn->constant(i64, runtime::kArenaDefaultCapacity);
+        }
+        RValue capacity = lower_expr(*expr, i64_type());
+        if (capacity.value == kNoValue) {
+            return kNoValue;
+        }
+        if (!frontend::is_integer(capacity.type->kind)) {
+            error(ErrorCode::E405_TYPE_MISMATCH,
+                  "arena capacity must be an integer, found '" +
+                      frontend::type_to_string(*capacity.type) + "'",
+                  expr->loc);
+            return kNoValue;
+        }
+        return widen_index(capacity);
+    }
+
+    // The line goes with the call, for heap profiles.
+    void init_arena(ValueId arena, ValueId capacity, std::uint32_t line) {
+        IRType ptr = IRType::scalar(IRTypeKind::IR_PTR);
+        IRType i64 = IRType::scalar(IRTypeKind::IR_I64);
+        Function* init = runtime_function("pallas_arena_init",
+                                          IRType::scalar(IRTypeKind::IR_VOID), {ptr, i64});
+        fn->inst(call_function(init, {arena, capacity})).imm = line;
+    }
+
+    // arena(capacity) { ... }: `new` in the block allocates from a fresh arena
+    // that is released, destructors first, whenever control leaves the block.
+    void lower_arena_block(const frontend::ArenaStmtAST& stmt) {
+        ValueId capacity = arena_capacity(stmt.capacity.get());
+        if (capacity == kNoValue) {
+            return;
+        }
+        ValueId arena = stack_slot(*arena_type());
+        init_arena(arena, capacity, static_cast<std::uint32_t>(stmt.loc.line));
+        scopes.emplace_back();
+        cleanups.push_back({arena, scopes.size(), arena_type()});
+        arenas.push_back(arena);
+        for (const auto& inner : stmt.body->statements) {
+            lower_stmt(*inner);
+        }
+        arenas.pop_back();
+        pop_scope();
+    }
+
+    // The call in `Arena(capacity)`, or nullptr for any other expression.
+    const frontend::CallExprAST* arena_constructor(const ExprAST& expr) const {
+        if (expr.kind != ExprKind::EXPR_CALL) {
+            return nullptr;
+        }
+        const auto& call = static_cast<const frontend::CallExprAST&>(expr);
+        if (call.callee->kind != ExprKind::EXPR_VARIABLE ||
+            static_cast<const frontend::VariableExprAST&>(*call.callee).name != "Arena") {
+            return nullptr;
+        }
+        return &call;
+    }
+
+    // name: Arena = Arena(capacity); the arena is released at the end of the scope.
+    void declare_arena_variable(const frontend::VarDeclAST& decl) {
+        const frontend::CallExprAST* ctor = decl.init ? arena_constructor(*decl.init) : nullptr;
+        if (decl.init && ctor == nullptr) {
+            error(ErrorCode::E405_TYPE_MISMATCH,
+                  "an Arena must be initialized with Arena(capacity)", decl.init->loc);
+            return;
+        }
+        if (ctor != nullptr && ctor->args.size() > 1) {
+            error(ErrorCode::E406_WRONG_ARGUMENT_COUNT, "'Arena' takes one argument, the capacity",
+                  ctor->loc);
+            return;
+        }
+        ValueId capacity =
+            arena_capacity(ctor != nullptr && !ctor->args.empty() ? ctor->args[0].get() : nullptr);
+        if (capacity == kNoValue) {
+            return;
+        }
+        std::uint32_t var = declare_variable(decl.name, arena_type());
+        init_arena(variables[var].address, capacity,
+                   static_cast<std::uint32_t>(decl.loc.line));
+        cleanups.push_back({variables[var].address, scopes.size(), arena_type()});
+    }
+
+    // Address of the arena named in new(arena): an Arena or an Arena*.
+    ValueId arena_address(const ExprAST& expr) {
+        RValue arena = lower_expr(expr, nullptr);
+        if (arena.value == kNoValue) {
+            return kNoValue;
+        }
+        const Type* type = arena.type.get();
+        if (type->kind == TypeKind::TYPE_POINTER && type->element) {
+            type = type->element.get();
+        }
+        if (!is_arena(*type)) {
+            error(ErrorCode::E405_TYPE_MISMATCH,
+                  "expected an Arena, found '" + frontend::type_to_string(*arena.type) + "'",
+                  expr.loc);
+            return kNoValue;
+        }
+        return arena.value;
+    }
+
+    RValue arena_method(ValueId arena, const std::string& name, const frontend::CallExprAST& expr) {
+        if (name != "free_all") {
+            error(ErrorCode::E404_UNDEFINED_NAME, "'Arena' has no method '" + name + "'",
+                  expr.callee->loc);
+            return fail();
+        }
+        if (!expr.args.empty()) {
+            error(ErrorCode::E406_WRONG_ARGUMENT_COUNT, "'free_all' takes no arguments", expr.loc);
+            return fail();
+        }
+        finalize_arena(arena);
+        arena_runtime_call("free_all", arena);
+        return {arena, frontend::make_type(TypeKind::TYPE_VOID)};
+    }
+
+    // Memory for `count` objects of `type` (one if kNoValue) from `arena`, for
+    // the `new` on `line`. Objects with a destructor get a header linking them
+    // into the arena's finalizer list; the returned pointer is past it.
+    ValueId arena_new(ValueId arena, const Type& type, ValueId count, std::uint32_t line) {
+        IRType i64 = IRType::scalar(IRTypeKind::IR_I64);
+        IRType ptr = IRType::scalar(IRTypeKind::IR_PTR);
+        std::uint64_t size = std::max<std::uint64_t>(size_of(type), 1);
+        std::uint64_t align =
+            std::max<std::uint64_t>(layout.align_of(type), runtime::kArenaAlignment);
+        auto kind = is_record(type) ? finalizable_kinds.find(type.name) : finalizable_kinds.end();
+        bool finalized = kind != finalizable_kinds.end();
+        std::uint64_t header = finalized ? align_up(kFinalizerHeaderBytes, align) : 0;
+        ValueId bytes = fn->constant(i64, header + size);
+        if (count != kNoValue) {
+            bytes = emit(Opcode::OP_ADD, i64,
+                         {scale_index({count, i64_type()}, size), fn->constant(i64, header)});
+        }
+        ValueId memory = arena_allocate(arena, bytes, align, line);
+        if (!finalized) {
+            return memory;
+        }
+        ValueId list = offset_address(arena, runtime::kArenaFinalizersOffset);
+        store(emit(Opcode::OP_LOAD, ptr, {list}), memory);
+        store(fn->constant(i64, kind->second), offset_address(memory, 8));
+        store(count != kNoValue ? count : fn->constant(i64, 1), offset_address(memory, 16));
+        store(memory, list);
+        return offset_address(memory, header);
+    }
+
+    // `bytes` of zeroed arena memory. Small constant sizes take the inline
+    // fast path: bump the cursor if the result stays within the limit, clear
+    // the bytes with 8-byte stores, and call the runtime only when the chunk
+    // is full. The runtime calls carry `line`, the `new` the memory is for (0
+    // if none), for heap profiles.
+    ValueId arena_allocate(ValueId arena, ValueId bytes, std::uint64_t align,
+                           std::uint32_t line = 0) {
+        IRType i1 = IRType::scalar(IRTypeKind::IR_I1);
+        IRType i64 = IRType::scalar(IRTypeKind::IR_I64);
+        IRType ptr = IRType::scalar(IRTypeKind::IR_PTR);
+        Function* slow = runtime_function("pallas_arena_alloc", ptr, {ptr, i64, i64});
+        const Inst& request = fn->inst(bytes);
+        if (request.op != Opcode::OP_CONST || request.imm > kInlineArenaBytes ||
+            align > runtime::kArenaAlignment) {
+            ValueId memory = call_function(slow, {arena, bytes, fn->constant(i64, align)});
+            fn->inst(memory).imm = line;
+            return memory;
+        }
+        std::uint64_t size = align_up(std::max<std::uint64_t>(request.imm, 1),
+                                      runtime::kArenaAlignment);
+        ValueId cursor_address = offset_address(arena, runtime::kArenaCursorOffset);
+        ValueId cursor = emit(Opcode::OP_LOAD, ptr, {cursor_address});
+        ValueId limit_address = offset_address(arena, runtime::kArenaLimitOffset);
+        ValueId limit = emit(Opcode::OP_LOAD, ptr, {limit_address});
+        ValueId next = emit(Opcode::OP_PTRADD, ptr, {cursor, fn->constant(i64, size)});
+        ValueId fits = emit(Opcode::OP_ICMP, i1, {next, limit});
+        fn->inst(fits).aux = static_cast<std::uint32_t>(CmpPredicate::CMP_ULE);
+        BlockId fast = new_block();
+        BlockId refill = new_block();
+        BlockId join = new_block();
+        cond_branch(fits, fast, refill);
+        seal(fast);
+        block = fast;
+        store(next, cursor_address);
+        for (std::uint64_t offset = 0; offset < size; offset += 8) {
+            store(fn->constant(i64, 0), offset_address(cursor, offset));
+        }
+        BlockId fast_end = insertion_block();
+        branch(join);
+        seal(refill);
+        block = refill;
+        ValueId refilled = call_function(
+            slow, {arena, fn->constant(i64, size), fn->constant(i64, runtime::kArenaAlignment)});
+        fn->inst(refilled).imm = line;
+        BlockId refill_end = insertion_block();
+        branch(join);
+        seal(join);
+        block = join;
+        ValueId memory = new_phi(join, ptr);
+        fn->add_incoming(memory, cursor, fast_end);
+        fn->add_incoming(memory, refilled, refill_end);
+        return memory;
+    }
+};
+
+}  // namespace
+
+std::unique_ptr<Module> lower_module(const frontend::ModuleAST& ast,
+                                     frontend::ConstEvaluator& consts, LayoutEngine& layout,
+                                     frontend::Diagnostics* diagnostics, LowerOptions options) {
+    Lowering lowering(ast, consts, layout, diagnostics, options);
+    return lowering.run();
+}
+
+}  // namespace pallas::middle
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <memory>
+#include <unordered_set>
+#include "frontend/ast.h"
+#include "frontend/const_eval.h"
+#include "frontend/diagnostics.h"
+#include "ir.h"
+#include "layout.h"
+
+namespace pallas::middle {
+
+struct LowerOptions {
+    // Check every index into a fixed-size array T[n] against n at run time.
+    bool bounds_checks = true;
+    // Top-level declarations that another module defines (see
+    // frontend::import_declarations): their functions and methods are declared
+    // for calls, and lowered by that module.
+    std::unordered_set<const frontend::StmtAST*> imported;
+};
+
+// Translates a parsed source file into IR.
+//
+// Scalar locals become SSA values while lowering (Braun et al., "Simple and
+// Efficient Construction of Static Single Assignment Form"), so no separate
+// memory-to-register pass is needed. Structs, classes and fixed-size arrays live
+// in stack slots addressed with byte offsets from the layout engine. Records of
+// up to four scalar fields and 16 bytes are passed as one argument per field;
+// other aggregates are passed as pointers to a copy made by the caller, or to
+// the object itself at its last use. Aggregate results are built in a slot the
+// caller passes first, unless the record has a single field.
+//
+// Methods are lowered to functions named `Class.method` that take the object
+// pointer first; constructors and destructors are `Class.$ctor` and
+// `Class.$dtor`. @inline and @noinline set the matching function flags.
+//
+// `match` compiles its literal arms into jump tables and balanced comparison
+// trees, and dispatches `char*` scrutinees on length, then packed bytes or a
+// hash; arms that can never run are reported as E407 warnings.
+//
+// Constructs the lowering does not handle yet (string values, generics,
+// lambdas) are reported as E502; the function containing them is left out of
+// the module.
+std::unique_ptr<Module> lower_module(const frontend::ModuleAST& ast,
+                                     frontend::ConstEvaluator& consts, LayoutEngine& layout,
+                                     frontend::Diagnostics* diagnostics,
+                                     LowerOptions options = {});
+
+}  // namespace pallas::middle
@@ -0,0 +1,49 @@
+#include "match.h"
+
+namespace pallas::middle {
+
+namespace {
+
+bool is_dense(std::span<const std::uint64_t> keys, std::size_t first, std::size_t last) {
+    std::uint64_t count = last - first + 1;
+    std::uint64_t range = keys[last] - keys[first];  // slots - 1; cannot overflow
+    return count >= kMinJumpTableCases && range < kMaxJumpTableSlots &&
+           count * 100 >= (range + 1) * kMinJumpTableDensity;
+}
+
+}  // namespace
+
+std::vector<CaseCluster> cluster_cases(std::span<const std::uint64_t> keys) {
+    std::vector<CaseCluster> clusters;
+    std::size_t i = 0;
+    while (i < keys.size()) {
+        CaseCluster cluster;
+        cluster.first = i;
+        for (std::size_t last = keys.size() - 1; last >= i + kMinJumpTableCases - 1; --last) {
+            if (is_dense(keys, i, last)) {
+                cluster.count = last - i + 1;
+                cluster.jump_table = true;
+                break;
+            }
+        }
+        clusters.push_back(cluster);
+        i += cluster.count;
+    }
+    return clusters;
+}
+
+std::uint64_t pack_string(std::string_view text) {
+    std::uint64_t packed = 0;
+    for (std::size_t i = 0; i < text.size() && i < kPackedStringBytes; ++i) {
+        packed |= std::uint64_t{static_cast<unsigned char>(text[i])} << (8 * i);
+    }
+    return packed;
+}
+
+std::uint64_t string_case_hash(std::string_view text) {
+    std::uint64_t head = pack_string(text.substr(0, kPackedStringBytes));
+    std::uint64_t tail = pack_string(text.substr(text.size() - kPackedStringBytes));
+    return head * kStringHashMultiplier ^ tail;
+}
+
+}  // namespace pallas::middle
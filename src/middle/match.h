@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace pallas::middle {
+
+// A run of consecutive cases (by index into the sorted case keys) that is
+// selected with one test: a single comparison or, for a dense run, a switch
+// that a backend emits as a jump table.
+struct CaseCluster {
+    std::size_t first = 0;
+    std::size_t count = 1;
+    bool jump_table = false;
+};
+
+// Jump tables need at least this many cases, at least 40% of the table slots
+// filled, and at most kMaxJumpTableSlots slots.
+constexpr std::size_t kMinJumpTableCases = 4;
+constexpr std::uint64_t kMinJumpTableDensity = 40;  // percent
+constexpr std::uint64_t kMaxJumpTableSlots = 4096;
+// Up to this many clusters are tested one after the other; more are split in
+// half by a comparison against the middle one, which bounds the number of
+// tests by O(log n).
+constexpr std::size_t kMaxLinearClusters = 3;
+
+// Splits sorted, distinct case keys into clusters. Scanning from the left,
+// each cluster is the longest dense run that qualifies as a jump table, or
+// otherwise a single case. Keys must preserve the scrutinee's order, i.e.
+// signed values are biased by 2^63.
+std::vector<CaseCluster> cluster_cases(std::span<const std::uint64_t> keys);
+
+// Strings of up to 8 bytes are dispatched on their bytes packed little-endian
+// into an integer; longer ones on this hash of their first and last 8 bytes,
+// which generated code computes with two loads once the length is known.
+constexpr std::size_t kPackedStringBytes = 8;
+constexpr std::uint64_t kStringHashMultiplier = 0x9e3779b97f4a7c15ull;
+std::uint64_t pack_string(std::string_view text);
+std::uint64_t string_case_hash(std::string_view text);
+
+}  // namespace pallas::middle
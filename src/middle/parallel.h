@@ -0,0 +1,47 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace pallas::middle {
+
+// Worker threads to use for `requested` (0 means one per hardware thread).
+inline unsigned thread_count(unsigned requested) {
+    if (requested != 0) {
+        return requested;
+    }
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Calls work(index, worker) for every index in [0, count) on up to `threads`
+// threads, the calling thread being worker 0. Indices are handed out in
+// increasing order to whichever worker is free, so the assignment varies from
+// run to run; work that must be deterministic may only depend on `index` and
+// keep per-worker state in slot `worker`. Runs serially for one thread.
+template <typename Work>
+void parallel_for(std::size_t count, unsigned threads, Work&& work) {
+    threads = static_cast<unsigned>(std::min<std::size_t>(std::max(threads, 1u), count));
+    if (threads <= 1) {
+        for (std::size_t i = 0; i < count; ++i) {
+            work(i, 0u);
+        }
+        return;
+    }
+    std::atomic<std::size_t> next{0};
+    auto drain = [&](unsigned worker) {
+        for (std::size_t i = next++; i < count; i = next++) {
+            work(i, worker);
+        }
+    };
+    std::vector<std::jthread> helpers;
+    helpers.reserve(threads - 1);
+    for (unsigned worker = 1; worker < threads; ++worker) {
+        helpers.emplace_back(drain, worker);
+    }
+    drain(0);
+}
+
+}  // namespace pallas::middle
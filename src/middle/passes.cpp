@@ -0,0 +1,915 @@
+#include "passes.h"
+#include <sys/resource.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <utility>
+#include "parallel.h"
+#include "support/trace.h"
+#include "transforms.h"
+
+namespace pallas::middle {
+
+const char* analysis_name(AnalysisKind kind) {
+    switch (kind) {
+        case AnalysisKind::ANALYSIS_CFG: return "cfg";
+        case AnalysisKind::ANALYSIS_DOMINATORS: return "dominators";
+        case AnalysisKind::ANALYSIS_LOOPS: return "loops";
+        case AnalysisKind::ANALYSIS_LIVENESS: return "liveness";
+    }
+    return "?";
+}
+
+namespace {
+
+bool is_leaf(Opcode op) {
+    return op == Opcode::OP_ARG || op == Opcode::OP_CONST || op == Opcode::OP_UNDEF ||
+           op == Opcode::OP_GLOBAL;
+}
+
+}  // namespace
+
+// ---------------------------------------------------------------------------
+// CFG
+// ---------------------------------------------------------------------------
+
+CFGInfo::CFGInfo(const Function& fn) {
+    std::size_t n = fn.num_blocks();
+    pred_offsets.assign(n + 1, 0);
+    for (BlockId b : fn.block_order()) {
+        for (BlockId s : fn.successors(b)) {
+            pred_offsets[s + 1]++;
+        }
+    }
+    for (std::size_t i = 0; i < n; ++i) {
+        pred_offsets[i + 1] += pred_offsets[i];
+    }
+    pred_list.resize(pred_offsets[n]);
+    std::vector<std::uint32_t> fill(pred_offsets.begin(), pred_offsets.end() - 1);
+    for (BlockId b : fn.block_order()) {
+        for (BlockId s : fn.successors(b)) {
+            pred_list[fill[s]++] = b;
+        }
+    }
+
+    // Iterative DFS for post-order, then reverse it.
+    index.assign(n, kNoBlock);
+    BlockId entry = fn.entry();
+    if (entry == kNoBlock) {
+        return;
+    }
+    std::vector<bool> visited(n, false);
+    std::vector<std::pair<BlockId, std::uint32_t>> stack;
+    stack.emplace_back(entry, 0);
+    visited[entry] = true;
+    while (!stack.empty()) {
+        auto& [b, next] = stack.back();
+        std::span<const BlockId> succs = fn.successors(b);
+        if (next < succs.size()) {
+            BlockId s = succs[next++];
+            if (!visited[s]) {
+                visited[s] = true;
+                stack.emplace_back(s, 0);
+            }
+            continue;
+        }
+        order.push_back(b);
+        stack.pop_back();
+    }
+    std::reverse(order.begin(), order.end());
+    for (std::size_t i = 0; i < order.size(); ++i) {
+        index[order[i]] = static_cast<std::uint32_t>(i);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Dominators
+// ---------------------------------------------------------------------------
+
+DominatorTree::DominatorTree(const Function& fn, const CFGInfo& cfg) {
+    std::size_t n = fn.num_blocks();
+    idoms.assign(n, kNoBlock);
+    kids.assign(n, {});
+    enter.assign(n, 0);
+    leave.assign(n, 0);
+    reachable_mask.assign(n, false);
+    const std::vector<BlockId>& rpo = cfg.rpo();
+    if (rpo.empty()) {
+        return;
+    }
+    BlockId entry = rpo.front();
+    idoms[entry] = entry;
+
+    auto intersect = [&](BlockId a, BlockId b) {
+        while (a != b) {
+            while (cfg.rpo_index(a) > cfg.rpo_index(b)) {
+                a = idoms[a];
+            }
+            while (cfg.rpo_index(b) > cfg.rpo_index(a)) {
+                b = idoms[b];
+            }
+        }
+        return a;
+    };
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (std::size_t i = 1; i < rpo.size(); ++i) {
+            BlockId b = rpo[i];
+            BlockId new_idom = kNoBlock;
+            for (BlockId p : cfg.preds(b)) {
+                if (!cfg.reachable(p) || idoms[p] == kNoBlock) {
+                    continue;
+                }
+                new_idom = new_idom == kNoBlock ? p : intersect(p, new_idom);
+            }
+            if (new_idom != idoms[b]) {
+                idoms[b] = new_idom;
+                changed = true;
+            }
+        }
+    }
+    idoms[entry] = kNoBlock;
+    for (BlockId b : rpo) {
+        if (idoms[b] != kNoBlock) {
+            kids[idoms[b]].push_back(b);
+        }
+    }
+
+    std::uint32_t clock = 0;
+    std::vector<std::pair<BlockId, std::size_t>> stack;
+    stack.emplace_back(entry, 0);
+    enter[entry] = clock++;
+    pre.push_back(entry);
+    while (!stack.empty()) {
+        auto& [b, next] = stack.back();
+        if (next < kids[b].size()) {
+            BlockId child = kids[b][next++];
+            enter[child] = clock++;
+            pre.push_back(child);
+            stack.emplace_back(child, 0);
+            continue;
+        }
+        leave[b] = clock++;
+        stack.pop_back();
+    }
+    for (BlockId b : rpo) {
+        reachable_mask[b] = true;
+    }
+}
+
+bool DominatorTree::dominates(BlockId a, BlockId b) const {
+    if (!reachable_mask[b]) {
+        return true;  // uses in unreachable code never need a definition
+    }
+    if (!reachable_mask[a]) {
+        return false;
+    }
+    return enter[a] <= enter[b] && leave[b] <= leave[a];
+}
+
+bool DominatorTree::dominates(const Function& fn, ValueId def, ValueId user) const {
+    const Inst& d = fn.inst(def);
+    if (is_leaf(d.op)) {
+        return true;
+    }
+    BlockId db = d.block;
+    BlockId ub = fn.inst(user).block;
+    if (db != ub) {
+        return dominates(db, ub);
+    }
+    for (ValueId v = d.next; v != kNoValue; v = fn.inst(v).next) {
+        if (v == user) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// ---------------------------------------------------------------------------
+// Loops
+// ---------------------------------------------------------------------------
+
+LoopInfo::LoopInfo(const Function& fn, const CFGInfo& cfg, const DominatorTree& dom) {
+    std::size_t n = fn.num_blocks();
+    innermost.assign(n, kNoBlock);
+    for (BlockId header : cfg.rpo()) {
+        Loop loop;
+        loop.header = header;
+        for (BlockId p : cfg.preds(header)) {
+            if (cfg.reachable(p) && dom.dominates(header, p) &&
+                std::find(loop.latches.begin(), loop.latches.end(), p) == loop.latches.end()) {
+                loop.latches.push_back(p);
+            }
+        }
+        if (loop.latches.empty()) {
+            continue;
+        }
+        std::vector<bool> in_loop(n, false);
+        in_loop[header] = true;
+        loop.blocks.push_back(header);
+        std::vector<BlockId> work = loop.latches;
+        while (!work.empty()) {
+            BlockId b = work.back();
+            work.pop_back();
+            if (in_loop[b]) {
+                continue;
+            }
+            in_loop[b] = true;
+            loop.blocks.push_back(b);
+            for (BlockId p : cfg.preds(b)) {
+                if (cfg.reachable(p) && !in_loop[p]) {
+                    work.push_back(p);
+                }
+            }
+        }
+        for (BlockId b : loop.blocks) {
+            for (BlockId s : fn.successors(b)) {
+                if (!in_loop[s] &&
+                    std::find(loop.exits.begin(), loop.exits.end(), s) == loop.exits.end()) {
+                    loop.exits.push_back(s);
+                }
+            }
+        }
+        BlockId outside = kNoBlock;
+        std::size_t outside_count = 0;
+        for (BlockId p : cfg.preds(header)) {
+            if (!in_loop[p]) {
+                outside = p;
+                ++outside_count;
+            }
+        }
+        if (outside_count == 1 && fn.successors(outside).size() == 1) {
+            loop.preheader = outside;
+        }
+        all.push_back(std::move(loop));
+        membership.push_back(std::move(in_loop));
+    }
+
+    // Headers were visited in reverse post-order, so enclosing loops come first.
+    for (std::size_t j = 0; j < all.size(); ++j) {
+        std::size_t best = kNoBlock;
+        for (std::size_t i = 0; i < j; ++i) {
+            if (membership[i][all[j].header] &&
+                (best == kNoBlock || all[i].blocks.size() < all[best].blocks.size())) {
+                best = i;
+            }
+        }
+        if (best != kNoBlock) {
+            all[j].parent = static_cast<std::uint32_t>(best);
+            all[j].depth = all[best].depth + 1;
+        }
+        for (BlockId b : all[j].blocks) {
+            std::uint32_t current = innermost[b];
+            if (current == kNoBlock || all[j].blocks.size() < all[current].blocks.size()) {
+                innermost[b] = static_cast<std::uint32_t>(j);
+            }
+        }
+    }
+}
+
+bool LoopInfo::contains(std::uint32_t loop, BlockId b) const {
+    return b < membership[loop].size() && membership[loop][b];
+}
+
+std::vector<std::uint32_t> LoopInfo::innermost_first() const {
+    std::vector<std::uint32_t> out(all.size());
+    for (std::size_t i = 0; i < all.size(); ++i) {
+        out[i] = static_cast<std::uint32_t>(i);
+    }
+    std::stable_sort(out.begin(), out.end(),
+                     [&](std::uint32_t a, std::uint32_t b) { return all[a].depth > all[b].depth; });
+    return out;
+}
+
+// ---------------------------------------------------------------------------
+// Liveness
+// ---------------------------------------------------------------------------
+
+Liveness::Liveness(const Function& fn, const CFGInfo& cfg) {
+    auto candidate = [&](ValueId v) {
+        return v != kNoValue && (fn.inst(v).op == Opcode::OP_ARG || !is_leaf(fn.inst(v).op));
+    };
+    // Arguments, phi operands and values used outside their own block.
+    std::vector<bool> crosses(fn.num_values(), false);
+    for (BlockId b : cfg.rpo()) {
+        for (ValueId v = fn.block(b).first; v != kNoValue; v = fn.inst(v).next) {
+            const Inst& inst = fn.inst(v);
+            for (std::uint32_t i = 0; i < inst.num_operands; ++i) {
+                ValueId op = fn.operand(v, i);
+                if (candidate(op) &&
+                    (inst.op == Opcode::OP_PHI || fn.inst(op).block != b)) {
+                    crosses[op] = true;
+                }
+            }
+        }
+    }
+    index.assign(fn.num_values(), kNotTracked);
+    for (ValueId v = 0; v < fn.num_values(); ++v) {
+        if (crosses[v]) {
+            index[v] = static_cast<std::uint32_t>(tracked.size());
+            tracked.push_back(v);
+        }
+    }
+
+    std::size_t n = fn.num_blocks();
+    std::size_t words = (tracked.size() + 63) / 64;
+    ins.assign(n, Bits(words, 0));
+    outs.assign(n, Bits(words, 0));
+    std::vector<Bits> gen(n, Bits(words, 0));
+    std::vector<Bits> kill(n, Bits(words, 0));
+    // (predecessor, value) pairs flowing into phis of each block.
+    std::vector<std::vector<std::pair<BlockId, ValueId>>> phi_uses(n);
+
+    auto set = [&](Bits& bits, ValueId v) {
+        bits[index[v] / 64] |= std::uint64_t{1} << (index[v] % 64);
+    };
+
+    for (BlockId b : cfg.rpo()) {
+        for (ValueId v = fn.block(b).first; v != kNoValue; v = fn.inst(v).next) {
+            const Inst& inst = fn.inst(v);
+            if (inst.op == Opcode::OP_PHI) {
+                for (std::uint32_t i = 0; i < inst.num_operands; ++i) {
+                    ValueId op = fn.operand(v, i);
+                    if (op != kNoValue && crosses[op]) {
+                        phi_uses[b].emplace_back(fn.targets(v)[i], op);
+                    }
+                }
+            } else {
+                for (std::uint32_t i = 0; i < inst.num_operands; ++i) {
+                    ValueId op = fn.operand(v, i);
+                    if (op != kNoValue && crosses[op] && !test(kill[b], op)) {
+                        set(gen[b], op);
+                    }
+                }
+            }
+            if (crosses[v]) {
+                set(kill[b], v);
+            }
+        }
+    }
+
+    const std::vector<BlockId>& rpo = cfg.rpo();
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (auto it = rpo.rbegin(); it != rpo.rend(); ++it) {
+            BlockId b = *it;
+            Bits out(words, 0);
+            for (BlockId s : fn.successors(b)) {
+                for (std::size_t w = 0; w < words; ++w) {
+                    out[w] |= ins[s][w];
+                }
+                for (const auto& [from, value] : phi_uses[s]) {
+                    if (from == b) {
+                        set(out, value);
+                    }
+                }
+            }
+            Bits in(words, 0);
+            for (std::size_t w = 0; w < words; ++w) {
+                in[w] = gen[b][w] | (out[w] & ~kill[b][w]);
+            }
+            if (in != ins[b] || out != outs[b]) {
+                ins[b] = std::move(in);
+                outs[b] = std::move(out);
+                changed = true;
+            }
+        }
+    }
+}
+
+std::vector<ValueId> Liveness::collect(const Bits& bits) const {
+    std::vector<ValueId> out;
+    for (std::size_t w = 0; w < bits.size(); ++w) {
+        std::uint64_t word = bits[w];
+        while (word != 0) {
+            int bit = __builtin_ctzll(word);
+            out.push_back(tracked[w * 64 + static_cast<std::size_t>(bit)]);
+            word &= word - 1;
+        }
+    }
+    return out;
+}
+
+std::vector<ValueId> Liveness::live_in_values(BlockId b) const {
+    return collect(ins[b]);
+}
+
+std::vector<ValueId> Liveness::live_out_values(BlockId b) const {
+    return collect(outs[b]);
+}
+
+// ---------------------------------------------------------------------------
+// Analysis manager
+// ---------------------------------------------------------------------------
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double seconds_since(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+}  // namespace
+
+// Entries are only ever added, and unordered_map keeps references to them
+// valid, so the lock is only needed while looking one up.
+AnalysisManager::Entry& AnalysisManager::entry_for(const Function& fn) {
+    std::lock_guard<std::mutex> guard(lock);
+    return cache[&fn];
+}
+
+void AnalysisManager::record(AnalysisKind kind, double seconds) {
+    std::lock_guard<std::mutex> guard(lock);
+    counters.computed[static_cast<std::size_t>(kind)]++;
+    counters.seconds[static_cast<std::size_t>(kind)] += seconds;
+}
+
+const CFGInfo& AnalysisManager::cfg(const Function& fn) {
+    Entry& entry = entry_for(fn);
+    if (!entry.cfg) {
+        auto start = Clock::now();
+        entry.cfg = std::make_unique<CFGInfo>(fn);
+        record(AnalysisKind::ANALYSIS_CFG, seconds_since(start));
+    }
+    return *entry.cfg;
+}
+
+const DominatorTree& AnalysisManager::dominators(const Function& fn) {
+    const CFGInfo& graph = cfg(fn);
+    Entry& entry = entry_for(fn);
+    if (!entry.dominators) {
+        auto start = Clock::now();
+        entry.dominators = std::make_unique<DominatorTree>(fn, graph);
+        record(AnalysisKind::ANALYSIS_DOMINATORS, seconds_since(start));
+    }
+    return *entry.dominators;
+}
+
+const LoopInfo& AnalysisManager::loops(const Function& fn) {
+    const CFGInfo& graph = cfg(fn);
+    const DominatorTree& dom = dominators(fn);
+    Entry& entry = entry_for(fn);
+    if (!entry.loops) {
+        auto start = Clock::now();
+        entry.loops = std::make_unique<LoopInfo>(fn, graph, dom);
+        record(AnalysisKind::ANALYSIS_LOOPS, seconds_since(start));
+    }
+    return *entry.loops;
+}
+
+const Liveness& AnalysisManager::liveness(const Function& fn) {
+    const CFGInfo& graph = cfg(fn);
+    Entry& entry = entry_for(fn);
+    if (!entry.liveness) {
+        auto start = Clock::now();
+        entry.liveness = std::make_unique<Liveness>(fn, graph);
+        record(AnalysisKind::ANALYSIS_LIVENESS, seconds_since(start));
+    }
+    return *entry.liveness;
+}
+
+void AnalysisManager::invalidate(const Function& fn, const PreservedAnalyses& preserved) {
+    if (preserved.preserves_all()) {
+        return;
+    }
+    Entry& entry = entry_for(fn);
+    if (!preserved.preserves(AnalysisKind::ANALYSIS_CFG)) {
+        entry.cfg.reset();
+        entry.dominators.reset();
+        entry.loops.reset();
+        entry.liveness.reset();
+        return;
+    }
+    if (!preserved.preserves(AnalysisKind::ANALYSIS_DOMINATORS)) {
+        entry.dominators.reset();
+        entry.loops.reset();
+    }
+    if (!preserved.preserves(AnalysisKind::ANALYSIS_LOOPS)) {
+        entry.loops.reset();
+    }
+    if (!preserved.preserves(AnalysisKind::ANALYSIS_LIVENESS)) {
+        entry.liveness.reset();
+    }
+}
+
+void AnalysisManager::invalidate_all(const PreservedAnalyses& preserved) {
+    for (auto& [fn, entry] : cache) {
+        invalidate(*fn, preserved);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Pass manager
+// ---------------------------------------------------------------------------
+
+namespace {
+
+std::size_t timing_slot(std::vector<PassTiming>& timing, const char* name) {
+    for (std::size_t i = 0; i < timing.size(); ++i) {
+        if (timing[i].name == name) {
+            return i;
+        }
+    }
+    timing.push_back({name});
+    return timing.size() - 1;
+}
+
+std::size_t module_instructions(const Module& module) {
+    std::size_t n = 0;
+    for (const auto& fn : module.functions) {
+        n += fn->instruction_count();
+    }
+    return n;
+}
+
+std::size_t module_bytes(const Module& module) {
+    std::size_t n = 0;
+    for (const auto& fn : module.functions) {
+        n += fn->memory_bytes();
+    }
+    return n;
+}
+
+}  // namespace
+
+void PassManager::add(std::unique_ptr<FunctionPass> pass) {
+    Entry entry;
+    entry.timing_index = timing_slot(timing, pass->name());
+    entry.function_pass = std::move(pass);
+    pipeline.push_back(std::move(entry));
+}
+
+void PassManager::add(std::unique_ptr<ModulePass> pass) {
+    Entry entry;
+    entry.timing_index = timing_slot(timing, pass->name());
+    entry.module_pass = std::move(pass);
+    pipeline.push_back(std::move(entry));
+}
+
+bool PassManager::verify(const Module& module, const char* after) {
+    std::string message;
+    if (verify_module(module, &message)) {
+        return true;
+    }
+    failure = std::string("IR verification failed after ") + after + ": " + message;
+    return false;
+}
+
+bool PassManager::run(Module& module) {
+    support::TraceScope trace("optimize");
+    if (trace.active()) {
+        trace.set_items(module_instructions(module));
+    }
+    std::size_t i = 0;
+    while (i < pipeline.size()) {
+        if (pipeline[i].module_pass) {
+            Entry& entry = pipeline[i];
+            PassTiming& t = timing[entry.timing_index];
+            bool measure = options.time_passes || support::tracing();
+            std::size_t insts_before = measure ? module_instructions(module) : 0;
+            std::size_t bytes_before = options.time_passes ? module_bytes(module) : 0;
+            auto start = Clock::now();
+            PreservedAnalyses preserved = PreservedAnalyses::none();
+            {
+                support::TraceScope pass_trace(entry.module_pass->name());
+                pass_trace.set_items(insts_before);
+                preserved = entry.module_pass->run(module, manager);
+            }
+            if (options.time_passes) {
+                t.seconds += seconds_since(start);
+                t.runs++;
+                t.instructions_before += insts_before;
+                t.instructions_after += module_instructions(module);
+                t.ir_bytes_delta += static_cast<std::int64_t>(module_bytes(module)) -
+                                    static_cast<std::int64_t>(bytes_before);
+            }
+            manager.invalidate_all(preserved);
+            if (options.verify_each && !verify(module, entry.module_pass->name())) {
+                return false;
+            }
+            ++i;
+            continue;
+        }
+
+        std::size_t end = i;
+        while (end < pipeline.size() && pipeline[end].function_pass) {
+            ++end;
+        }
+        std::vector<Function*> functions;
+        for (const auto& fn : module.functions) {
+            if (!(fn->flags & FUNCTION_EXTERN)) {
+                functions.push_back(fn.get());
+            }
+        }
+        if (!run_function_passes(functions, i, end)) {
+            return false;
+        }
+        i = end;
+    }
+    return true;
+}
+
+// Each function goes through the whole group on one worker, which uses its own
+// copies of the passes, so functions never share mutable state and the result
+// does not depend on the schedule. Timings are summed per worker and merged
+// afterwards.
+bool PassManager::run_function_passes(const std::vector<Function*>& functions,
+                                      std::size_t first, std::size_t last) {
+    unsigned threads = std::min<std::size_t>(thread_count(options.threads), functions.size());
+    std::vector<std::vector<FunctionPass*>> passes(1);
+    std::vector<std::unique_ptr<FunctionPass>> copies;
+    for (std::size_t k = first; k < last; ++k) {
+        passes[0].push_back(pipeline[k].function_pass.get());
+    }
+    for (unsigned worker = 1; worker < threads; ++worker) {
+        std::vector<FunctionPass*>& own = passes.emplace_back();
+        for (FunctionPass* pass : passes[0]) {
+            copies.push_back(pass->clone());
+            if (!copies.back()) {
+                break;
+            }
+            own.push_back(copies.back().get());
+        }
+        if (own.size() != passes[0].size()) {
+            passes.resize(1);
+            break;
+        }
+    }
+    threads = static_cast<unsigned>(passes.size());
+
+    std::vector<std::vector<PassTiming>> timings(threads,
+                                                 std::vector<PassTiming>(last - first));
+    std::vector<std::string> failures(functions.size());
+    std::atomic<bool> failed{false};
+    parallel_for(functions.size(), threads, [&](std::size_t index, unsigned worker) {
+        // Functions before this one were all started, so the first failure in
+        // module order is always found.
+        if (failed) {
+            return;
+        }
+        Function& fn = *functions[index];
+        for (std::size_t k = 0; k < last - first; ++k) {
+            FunctionPass& pass = *passes[worker][k];
+            PassTiming& t = timings[worker][k];
+            bool measure = options.time_passes || support::tracing();
+            std::size_t insts_before = measure ? fn.instruction_count() : 0;
+            std::size_t bytes_before = options.time_passes ? fn.memory_bytes() : 0;
+            auto start = Clock::now();
+            PreservedAnalyses preserved = PreservedAnalyses::none();
+            {
+                support::TraceScope pass_trace(pass.name(), fn.name);
+                pass_trace.set_items(insts_before);
+                preserved = pass.run(fn, manager);
+            }
+            if (options.time_passes) {
+                t.seconds += seconds_since(start);
+                t.runs++;
+                t.instructions_before += insts_before;
+                t.instructions_after += fn.instruction_count();
+                t.ir_bytes_delta += static_cast<std::int64_t>(fn.memory_bytes()) -
+                                    static_cast<std::int64_t>(bytes_before);
+            }
+            manager.invalidate(fn, preserved);
+            std::string message;
+            if (options.verify_each && !verify_function(fn, &message)) {
+                failures[index] = std::string("IR verification failed after ") + pass.name() +
+                                  ": " + message;
+                failed = true;
+                return;
+            }
+        }
+    });
+
+    for (const std::vector<PassTiming>& own : timings) {
+        for (std::size_t k = 0; k < own.size(); ++k) {
+            PassTiming& t = timing[pipeline[first + k].timing_index];
+            t.seconds += own[k].seconds;
+            t.runs += own[k].runs;
+            t.instructions_before += own[k].instructions_before;
+            t.instructions_after += own[k].instructions_after;
+            t.ir_bytes_delta += own[k].ir_bytes_delta;
+        }
+    }
+    for (const std::string& message : failures) {
+        if (!message.empty()) {
+            failure = message;
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string PassManager::timing_report() const {
+    double total = 0.0;
+    for (const PassTiming& t : timing) {
+        total += t.seconds;
+    }
+    const AnalysisStats& stats = manager.stats();
+    double analysis_total = 0.0;
+    for (std::size_t k = 0; k < kAnalysisCount; ++k) {
+        analysis_total += stats.seconds[k];
+    }
+
+    std::string out;
+    char line[256];
+    out.append("===------------------------------------------------------------===\n");
+    out.append("                   Pass execution timing report\n");
+    out.append("===------------------------------------------------------------===\n");
+    std::snprintf(line, sizeof(line), "  Total pass time: %.3f ms (analyses %.3f ms)\n\n",
+                  total * 1e3, analysis_total * 1e3);
+    out.append(line);
+    unsigned threads = thread_count(options.threads);
+    if (threads > 1) {
+        std::snprintf(line, sizeof(line),
+                      "  Function pass times are summed over up to %u threads.\n\n", threads);
+        out.append(line);
+    }
+    out.append("   Wall (ms)      %   Runs  Insts before  Insts after     Delta  IR bytes  Name\n");
+    for (const PassTiming& t : timing) {
+        double percent = total > 0.0 ? t.seconds * 100.0 / total : 0.0;
+        long long delta = static_cast<long long>(t.instructions_after) -
+                          static_cast<long long>(t.instructions_before);
+        std::snprintf(line, sizeof(line), "  %10.3f %5.1f%% %6zu %13zu %12zu %+9lld %+9lld  %s\n",
+                      t.seconds * 1e3, percent, t.runs, t.instructions_before,
+                      t.instructions_after, delta, static_cast<long long>(t.ir_bytes_delta),
+                      t.name.c_str());
+        out.append(line);
+    }
+    out.append("\n   Wall (ms)  Computed  Analysis\n");
+    for (std::size_t k = 0; k < kAnalysisCount; ++k) {
+        std::snprintf(line, sizeof(line), "  %10.3f %9zu  %s\n", stats.seconds[k] * 1e3,
+                      stats.computed[k], analysis_name(static_cast<AnalysisKind>(k)));
+        out.append(line);
+    }
+    struct rusage usage {};
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        std::snprintf(line, sizeof(line), "\n  Peak resident memory: %ld KiB\n", usage.ru_maxrss);
+        out.append(line);
+    }
+    return out;
+}
+
+// ---------------------------------------------------------------------------
+// Registry
+// ---------------------------------------------------------------------------
+
+namespace {
+
+// Prints the dominator tree and the loop nest of each function.
+class PrintLoopsPass : public FunctionPass {
+  public:
+    const char* name() const override { return "print-loops"; }
+
+    PreservedAnalyses run(Function& fn, AnalysisManager& analyses) override {
+        const DominatorTree& dom = analyses.dominators(fn);
+        const LoopInfo& info = analyses.loops(fn);
+        std::string out = "@" + fn.name + ":\n";
+        for (BlockId b : dom.preorder()) {
+            out.append("  block " + std::to_string(b));
+            if (dom.idom(b) != kNoBlock) {
+                out.append(" idom " + std::to_string(dom.idom(b)));
+            }
+            out.append(" loop depth " + std::to_string(info.depth(b)) + "\n");
+        }
+        for (const Loop& loop : info.loops()) {
+            out.append("  loop header " + std::to_string(loop.header) + ", " +
+                       std::to_string(loop.blocks.size()) + " blocks, depth " +
+                       std::to_string(loop.depth) + "\n");
+        }
+        std::cout << out;
+        return PreservedAnalyses::all();
+    }
+};
+
+// Prints the live-in and live-out sets of each block.
+class PrintLivenessPass : public FunctionPass {
+  public:
+    const char* name() const override { return "print-liveness"; }
+
+    PreservedAnalyses run(Function& fn, AnalysisManager& analyses) override {
+        const Liveness& live = analyses.liveness(fn);
+        std::string out = "@" + fn.name + ":\n";
+        auto list = [](const std::vector<ValueId>& values) {
+            std::string s;
+            for (ValueId v : values) {
+                s.append(" " + std::to_string(v));
+            }
+            return s;
+        };
+        for (BlockId b : fn.block_order()) {
+            out.append("  block " + std::to_string(b) + " in:" + list(live.live_in_values(b)) +
+                       " out:" + list(live.live_out_values(b)) + "\n");
+        }
+        std::cout << out;
+        return PreservedAnalyses::all();
+    }
+};
+
+struct PassInfo {
+    const char* name;
+    std::unique_ptr<FunctionPass> (*make_function_pass)();
+    std::unique_ptr<ModulePass> (*make_module_pass)();
+};
+
+template <typename T>
+std::unique_ptr<FunctionPass> make_function() {
+    return std::make_unique<T>();
+}
+
+const PassInfo kPasses[] = {
+    {"print-loops", make_function<PrintLoopsPass>, nullptr},
+    {"print-liveness", make_function<PrintLivenessPass>, nullptr},
+    {"simplifycfg", create_simplify_cfg_pass, nullptr},
+    {"sccp", create_sccp_pass, nullptr},
+    {"gvn", create_gvn_pass, nullptr},
+    {"adce", create_adce_pass, nullptr},
+    {"inline", nullptr, [] { return create_inline_pass(); }},
+    {"escape", nullptr, create_escape_pass},
+    {"loop-simplify", create_loop_simplify_pass, nullptr},
+    {"bce", [] { return create_bce_pass(); }, nullptr},
+    {"licm", create_licm_pass, nullptr},
+    {"indvars", create_indvars_pass, nullptr},
+    {"loop-reduce", create_loop_reduce_pass, nullptr},
+    {"loop-unroll", create_loop_unroll_pass, nullptr},
+    {"loop-vectorize", create_loop_vectorize_pass, nullptr},
+    {"scalarize", create_scalarize_pass, nullptr},
+    {"profile-layout", create_profile_layout_pass, nullptr},
+};
+
+}  // namespace
+
+bool add_pass_by_name(PassManager& manager, const std::string& name) {
+    for (const PassInfo& info : kPasses) {
+        if (name != info.name) {
+            continue;
+        }
+        if (info.make_function_pass != nullptr) {
+            manager.add(info.make_function_pass());
+        } else {
+            manager.add(info.make_module_pass());
+        }
+        return true;
+    }
+    return false;
+}
+
+std::vector<std::string> registered_passes() {
+    std::vector<std::string> names;
+    for (const PassInfo& info : kPasses) {
+        names.emplace_back(info.name);
+    }
+    return names;
+}
+
+void build_pipeline(PassManager& manager, int opt_level, BoundsCheckReport* bounds_report) {
+    if (opt_level <= 0) {
+        return;
+    }
+    // Inline first so the scalar passes see through calls: only @inline
+    // functions at -O1, the cost model above that.
+    InlineOptions inline_options;
+    inline_options.only_always = opt_level == 1;
+    if (opt_level >= 3) {
+        inline_options.threshold = 100;
+        inline_options.growth_factor = 3.0;
+        inline_options.hot_threshold = 400;
+    }
+    manager.add(create_inline_pass(inline_options));
+    // Clean up the CFG first so the sparse passes see fewer blocks, then fold,
+    // number values and sweep what became dead, and tidy the branches left behind.
+    manager.add(create_simplify_cfg_pass());
+    manager.add(create_sccp_pass());
+    // Allocation sizes are constant after SCCP, and inlining has exposed the
+    // objects that only live in one call; GVN then forwards their fields.
+    manager.add(create_escape_pass());
+    manager.add(create_gvn_pass());
+    manager.add(create_adce_pass());
+    manager.add(create_simplify_cfg_pass());
+    // Loop passes work on the clean CFG once every loop has a preheader.
+    // Bounds checks go first: a check left in a loop blocks vectorization.
+    manager.add(create_loop_simplify_pass());
+    manager.add(create_bce_pass(bounds_report));
+    if (opt_level >= 2) {
+        // Hoist invariants, simplify the induction variables, vectorize, then
+        // unroll what is left small and constant and strength-reduce the
+        // address arithmetic of the rest. The scalar passes run again over the
+        // new blocks.
+        manager.add(create_licm_pass());
+        manager.add(create_indvars_pass());
+        manager.add(create_loop_vectorize_pass());
+        manager.add(create_loop_unroll_pass());
+        manager.add(create_loop_reduce_pass());
+        manager.add(create_sccp_pass());
+        manager.add(create_gvn_pass());
+    }
+    manager.add(create_adce_pass());
+    manager.add(create_simplify_cfg_pass());
+}
+
+}  // namespace pallas::middle
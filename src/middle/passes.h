@@ -0,0 +1,277 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ir.h"
+
+namespace pallas::middle {
+
+enum class AnalysisKind : std::uint8_t {
+    ANALYSIS_CFG,         // predecessors and reverse post-order
+    ANALYSIS_DOMINATORS,  // depends on CFG
+    ANALYSIS_LOOPS,       // depends on dominators
+    ANALYSIS_LIVENESS,    // depends on CFG and on every instruction
+};
+constexpr std::size_t kAnalysisCount = 4;
+
+const char* analysis_name(AnalysisKind kind);
+
+// The analyses a pass left intact. Anything not listed is dropped from the
+// cache after the pass runs; dropping an analysis also drops the ones built on it.
+class PreservedAnalyses {
+  public:
+    static PreservedAnalyses all() { return PreservedAnalyses((1u << kAnalysisCount) - 1); }
+    static PreservedAnalyses none() { return PreservedAnalyses(0); }
+    // The pass changed instructions but not the shape of the CFG.
+    static PreservedAnalyses cfg() {
+        return none()
+            .preserve(AnalysisKind::ANALYSIS_CFG)
+            .preserve(AnalysisKind::ANALYSIS_DOMINATORS)
+            .preserve(AnalysisKind::ANALYSIS_LOOPS);
+    }
+
+    PreservedAnalyses& preserve(AnalysisKind kind) {
+        mask |= 1u << static_cast<unsigned>(kind);
+        return *this;
+    }
+    bool preserves(AnalysisKind kind) const { return (mask & (1u << static_cast<unsigned>(kind))) != 0; }
+    bool preserves_all() const { return mask == (1u << kAnalysisCount) - 1; }
+
+  private:
+    explicit PreservedAnalyses(std::uint32_t mask) : mask(mask) {}
+    std::uint32_t mask = 0;
+};
+
+// Predecessor lists (stored flat) and reverse post-order of the reachable blocks.
+class CFGInfo {
+  public:
+    explicit CFGInfo(const Function& fn);
+
+    std::span<const BlockId> preds(BlockId b) const {
+        return {pred_list.data() + pred_offsets[b], pred_offsets[b + 1] - pred_offsets[b]};
+    }
+    const std::vector<BlockId>& rpo() const { return order; }
+    // Position of the block in rpo(), kNoBlock when unreachable.
+    std::uint32_t rpo_index(BlockId b) const { return index[b]; }
+    bool reachable(BlockId b) const { return index[b] != kNoBlock; }
+
+  private:
+    std::vector<std::uint32_t> pred_offsets;
+    std::vector<BlockId> pred_list;
+    std::vector<BlockId> order;
+    std::vector<std::uint32_t> index;
+};
+
+// Immediate dominators computed with the Cooper-Harvey-Kennedy iteration over
+// reverse post-order. Dominance queries are O(1) using DFS intervals of the tree.
+class DominatorTree {
+  public:
+    DominatorTree(const Function& fn, const CFGInfo& cfg);
+
+    BlockId idom(BlockId b) const { return idoms[b]; }
+    const std::vector<BlockId>& children(BlockId b) const { return kids[b]; }
+    bool dominates(BlockId a, BlockId b) const;
+    bool strictly_dominates(BlockId a, BlockId b) const { return a != b && dominates(a, b); }
+    // True when the definition `def` is available at instruction `user`.
+    bool dominates(const Function& fn, ValueId def, ValueId user) const;
+    // Blocks in dominator-tree pre-order, starting at the entry.
+    const std::vector<BlockId>& preorder() const { return pre; }
+
+  private:
+    std::vector<BlockId> idoms;
+    std::vector<std::vector<BlockId>> kids;
+    std::vector<std::uint32_t> enter;
+    std::vector<std::uint32_t> leave;
+    std::vector<BlockId> pre;
+    std::vector<bool> reachable_mask;
+};
+
+struct Loop {
+    BlockId header = kNoBlock;
+    BlockId preheader = kNoBlock;  // single outside predecessor that only enters the loop
+    std::vector<BlockId> blocks;   // includes the header
+    std::vector<BlockId> latches;  // sources of back edges
+    std::vector<BlockId> exits;    // blocks outside the loop reached from inside
+    std::uint32_t parent = kNoBlock;  // index of the enclosing loop
+    std::uint32_t depth = 1;
+};
+
+// Natural loops from back edges, with nesting.
+class LoopInfo {
+  public:
+    LoopInfo(const Function& fn, const CFGInfo& cfg, const DominatorTree& dom);
+
+    const std::vector<Loop>& loops() const { return all; }
+    // Index of the innermost loop containing the block, kNoBlock if none.
+    std::uint32_t loop_for(BlockId b) const { return innermost[b]; }
+    std::uint32_t depth(BlockId b) const {
+        return innermost[b] == kNoBlock ? 0 : all[innermost[b]].depth;
+    }
+    // Blocks added after the analysis was computed belong to no loop.
+    bool contains(std::uint32_t loop, BlockId b) const;
+    // Loops ordered so inner loops come before the loops that enclose them.
+    std::vector<std::uint32_t> innermost_first() const;
+
+  private:
+    std::vector<Loop> all;
+    std::vector<std::uint32_t> innermost;
+    std::vector<std::vector<bool>> membership;
+};
+
+// Live-in / live-out sets of SSA values per block. A phi operand is live out of
+// the matching predecessor; a phi result is defined on entry to its block.
+class Liveness {
+  public:
+    Liveness(const Function& fn, const CFGInfo& cfg);
+
+    bool live_in(BlockId b, ValueId v) const { return test(ins[b], v); }
+    bool live_out(BlockId b, ValueId v) const { return test(outs[b], v); }
+    std::vector<ValueId> live_in_values(BlockId b) const;
+    std::vector<ValueId> live_out_values(BlockId b) const;
+
+  private:
+    using Bits = std::vector<std::uint64_t>;
+    // The sets hold only values that can cross a block boundary, numbered in
+    // value order: most values die in the block that defines them, and sets
+    // over all values would make the analysis quadratic in long functions.
+    std::vector<std::uint32_t> index;  // per value; kNotTracked for the others
+    std::vector<ValueId> tracked;      // per index
+    std::vector<Bits> ins;
+    std::vector<Bits> outs;
+
+    static constexpr std::uint32_t kNotTracked = ~std::uint32_t{0};
+
+    bool test(const Bits& bits, ValueId v) const {
+        std::uint32_t i = v < index.size() ? index[v] : kNotTracked;
+        return i != kNotTracked && ((bits[i / 64] >> (i % 64)) & 1) != 0;
+    }
+    std::vector<ValueId> collect(const Bits& bits) const;
+};
+
+struct AnalysisStats {
+    std::size_t computed[kAnalysisCount] = {};
+    double seconds[kAnalysisCount] = {};
+};
+
+// Caches analyses per function and recomputes them only after a pass drops them.
+// Function passes running in parallel may use it from several threads, each on
+// its own functions; the cache index and the counters are shared under a lock.
+class AnalysisManager {
+  public:
+    const CFGInfo& cfg(const Function& fn);
+    const DominatorTree& dominators(const Function& fn);
+    const LoopInfo& loops(const Function& fn);
+    const Liveness& liveness(const Function& fn);
+
+    void invalidate(const Function& fn, const PreservedAnalyses& preserved);
+    void invalidate_all(const PreservedAnalyses& preserved);
+    // Forgets a function entirely, e.g. when it is deleted from the module.
+    void clear(const Function& fn) { cache.erase(&fn); }
+    const AnalysisStats& stats() const { return counters; }
+
+  private:
+    struct Entry {
+        std::unique_ptr<CFGInfo> cfg;
+        std::unique_ptr<DominatorTree> dominators;
+        std::unique_ptr<LoopInfo> loops;
+        std::unique_ptr<Liveness> liveness;
+    };
+    std::unordered_map<const Function*, Entry> cache;
+    AnalysisStats counters;
+    std::mutex lock;
+
+    Entry& entry_for(const Function& fn);
+    void record(AnalysisKind kind, double seconds);
+};
+
+class FunctionPass {
+  public:
+    virtual ~FunctionPass() = default;
+    virtual const char* name() const = 0;
+    virtual PreservedAnalyses run(Function& fn, AnalysisManager& analyses) = 0;
+    // A fresh copy for another worker thread. Passes that keep no state shared
+    // between functions return one; the default keeps the pass on one thread.
+    virtual std::unique_ptr<FunctionPass> clone() const { return nullptr; }
+};
+
+class ModulePass {
+  public:
+    virtual ~ModulePass() = default;
+    virtual const char* name() const = 0;
+    virtual PreservedAnalyses run(Module& module, AnalysisManager& analyses) = 0;
+};
+
+struct PassOptions {
+    bool time_passes = false;  // collect per-pass wall time, instruction and memory deltas
+    bool verify_each = false;  // run the IR verifier after every pass
+    // Threads for function passes, 0 for one per hardware thread. The IR
+    // produced is the same for every count.
+    unsigned threads = 1;
+};
+
+struct PassTiming {
+    std::string name;
+    std::size_t runs = 0;
+    double seconds = 0.0;
+    std::size_t instructions_before = 0;
+    std::size_t instructions_after = 0;
+    std::int64_t ir_bytes_delta = 0;
+};
+
+class PassManager {
+  public:
+    explicit PassManager(PassOptions options = {}) : options(options) {}
+
+    void add(std::unique_ptr<FunctionPass> pass);
+    void add(std::unique_ptr<ModulePass> pass);
+    std::size_t size() const { return pipeline.size(); }
+
+    // Runs the pipeline. Consecutive function passes run back to back on each
+    // function before moving to the next one, on several functions at once
+    // when options.threads allows and every pass in the group can be cloned.
+    // Module passes run alone, between the groups. Returns false if
+    // verification after a pass fails; the message is in error(), and names
+    // the first failing function in module order.
+    bool run(Module& module);
+
+    AnalysisManager& analyses() { return manager; }
+    const std::vector<PassTiming>& timings() const { return timing; }
+    const std::string& error() const { return failure; }
+    // Table printed by -time-passes.
+    std::string timing_report() const;
+
+  private:
+    struct Entry {
+        std::unique_ptr<FunctionPass> function_pass;
+        std::unique_ptr<ModulePass> module_pass;
+        std::size_t timing_index = 0;
+    };
+
+    PassOptions options;
+    std::vector<Entry> pipeline;
+    AnalysisManager manager;
+    std::vector<PassTiming> timing;
+    std::string failure;
+
+    bool verify(const Module& module, const char* after);
+    bool run_function_passes(const std::vector<Function*>& functions, std::size_t first,
+                             std::size_t last);
+};
+
+// Adds a registered pass by name (as used by palc --passes=a,b,c).
+bool add_pass_by_name(PassManager& manager, const std::string& name);
+std::vector<std::string> registered_passes();
+struct BoundsCheckReport;
+
+// The standard pipeline for -O0..-O3. Bounds-check elimination records its
+// counts in `bounds_report` when given.
+void build_pipeline(PassManager& manager, int opt_level,
+                    BoundsCheckReport* bounds_report = nullptr);
+
+}  // namespace pallas::middle
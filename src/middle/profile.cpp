@@ -0,0 +1,589 @@
+#include "profile.h"
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include "runtime/heap_profile.h"
+#include "runtime/profile.h"
+#include "transforms.h"
+
+namespace pallas::middle {
+
+namespace {
+
+constexpr std::uint64_t kFnvOffset = 0xcbf29ce484222325ull;
+constexpr std::uint64_t kFnvPrime = 0x100000001b3ull;
+
+const IRType kI32 = IRType::scalar(IRTypeKind::IR_I32);
+const IRType kI64 = IRType::scalar(IRTypeKind::IR_I64);
+const IRType kPtr = IRType::scalar(IRTypeKind::IR_PTR);
+
+class Hasher {
+  public:
+    void add(std::uint64_t value) {
+        for (int i = 0; i < 8; ++i) {
+            hash = (hash ^ ((value >> (8 * i)) & 0xff)) * kFnvPrime;
+        }
+    }
+    void add(const std::string& text) {
+        for (char c : text) {
+            hash = (hash ^ static_cast<std::uint8_t>(c)) * kFnvPrime;
+        }
+        add(text.size());
+    }
+    std::uint64_t value() const { return hash; }
+
+  private:
+    std::uint64_t hash = kFnvOffset;
+};
+
+// The counters of one function, in order: one per block in block order, then
+// one per conditional branch (its first edge) and one per switch edge, with
+// the terminators again in block order.
+struct CounterPlan {
+    std::vector<BlockId> blocks;
+    std::vector<ValueId> branches;
+    std::size_t size = 0;
+};
+
+CounterPlan plan_counters(const Function& fn) {
+    CounterPlan plan;
+    plan.blocks = fn.block_order();
+    plan.size = plan.blocks.size();
+    for (BlockId b : plan.blocks) {
+        ValueId term = fn.terminator(b);
+        if (term == kNoValue) {
+            continue;
+        }
+        if (fn.inst(term).op == Opcode::OP_COND_BR) {
+            plan.branches.push_back(term);
+            plan.size += 1;
+        } else if (fn.inst(term).op == Opcode::OP_SWITCH) {
+            plan.branches.push_back(term);
+            plan.size += fn.targets(term).size();
+        }
+    }
+    return plan;
+}
+
+bool is_definition(const Function& fn) {
+    return (fn.flags & FUNCTION_EXTERN) == 0 && fn.entry() != kNoBlock;
+}
+
+void append_u32(std::string& out, std::uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out.push_back(static_cast<char>(value >> (8 * i)));
+    }
+}
+
+void append_u64(std::string& out, std::uint64_t value) {
+    for (int i = 0; i < 8; ++i) {
+        out.push_back(static_cast<char>(value >> (8 * i)));
+    }
+}
+
+// Adds code that increments counter `index` by `amount` (1 if kNoValue), in
+// front of `before`, or at the end of `b` if `before` is kNoValue.
+void increment(Function& fn, BlockId b, ValueId before, ValueId counters, std::size_t index,
+               ValueId amount = kNoValue) {
+    auto emit = [&](Opcode op, IRType type, std::initializer_list<ValueId> operands) {
+        std::span<const ValueId> list(operands.begin(), operands.size());
+        return before == kNoValue ? fn.append(b, op, type, list)
+                                  : fn.insert_before(before, op, type, list);
+    };
+    if (amount == kNoValue) {
+        amount = fn.constant(kI64, 1);
+    }
+    ValueId slot = emit(Opcode::OP_PTRADD, kPtr, {counters, fn.constant(kI64, 8 * index)});
+    ValueId count = emit(Opcode::OP_LOAD, kI64, {slot});
+    emit(Opcode::OP_STORE, IRType(), {emit(Opcode::OP_ADD, kI64, {count, amount}), slot});
+}
+
+// The declaration of runtime function `name`, added if the module lacks it.
+Function* declare_runtime(Module& module, const std::string& name, IRType ret,
+                          const std::vector<IRType>& params) {
+    Function* fn = module.find_function(name);
+    if (fn == nullptr) {
+        fn = module.add_function(name, ret, params);
+        fn->flags |= FUNCTION_EXTERN;
+    }
+    return fn;
+}
+
+ValueId call_before(Function& fn, ValueId before, const Function& callee,
+                    std::span<const ValueId> args) {
+    ValueId call = fn.insert_before(before, Opcode::OP_CALL, callee.return_type, args);
+    fn.inst(call).aux = fn.module->intern(callee.name);
+    return call;
+}
+
+std::vector<ValueId> returns_of(const Function& fn) {
+    std::vector<ValueId> returns;
+    for (BlockId b : fn.block_order()) {
+        ValueId term = fn.terminator(b);
+        if (term != kNoValue && fn.inst(term).op == Opcode::OP_RET) {
+            returns.push_back(term);
+        }
+    }
+    return returns;
+}
+
+ValueId first_non_phi(const Function& fn, BlockId b) {
+    ValueId v = fn.block(b).first;
+    while (v != kNoValue && fn.inst(v).op == Opcode::OP_PHI) {
+        v = fn.inst(v).next;
+    }
+    return v;
+}
+
+void instrument(Function& fn, const CounterPlan& plan, SymbolId counters_symbol,
+                std::size_t base) {
+    ValueId counters = fn.global(counters_symbol);
+    std::size_t index = base;
+    for (BlockId b : plan.blocks) {
+        increment(fn, b, first_non_phi(fn, b), counters, index++);
+    }
+    for (ValueId term : plan.branches) {
+        BlockId b = fn.inst(term).block;
+        if (fn.inst(term).op == Opcode::OP_COND_BR) {
+            ValueId condition[] = {fn.operand(term, 0)};
+            ValueId taken = fn.insert_before(term, Opcode::OP_ZEXT, kI64, condition);
+            increment(fn, b, term, counters, index++, taken);
+            continue;
+        }
+        // Each switch edge gets a block of its own that counts it.
+        std::vector<BlockId> targets(fn.targets(term).begin(), fn.targets(term).end());
+        for (std::uint32_t i = 0; i < targets.size(); ++i) {
+            BlockId edge = fn.add_block();
+            increment(fn, edge, kNoValue, counters, index++);
+            fn.append(edge, Opcode::OP_BR, IRType(), {}, {&targets[i], 1});
+            fn.set_target(term, i, edge);
+            // Phis have one entry per edge; this edge takes the first one left.
+            for (ValueId phi = fn.block(targets[i]).first;
+                 phi != kNoValue && fn.inst(phi).op == Opcode::OP_PHI; phi = fn.inst(phi).next) {
+                std::span<BlockId> from = fn.targets(phi);
+                auto entry = std::find(from.begin(), from.end(), b);
+                if (entry != from.end()) {
+                    *entry = edge;
+                }
+            }
+        }
+    }
+}
+
+class ProfileGeneratePass : public ModulePass {
+  public:
+    explicit ProfileGeneratePass(std::string path) : path(std::move(path)) {}
+
+    const char* name() const override { return "profile-generate"; }
+
+    PreservedAnalyses run(Module& module, AnalysisManager&) override {
+        std::vector<std::pair<Function*, CounterPlan>> plans;
+        std::string descriptor(runtime::kProfileMagic, sizeof(runtime::kProfileMagic));
+        std::size_t functions = 0;
+        append_u32(descriptor, 0);
+        std::size_t total = 0;
+        for (const auto& fn : module.functions) {
+            if (!is_definition(*fn)) {
+                continue;
+            }
+            CounterPlan plan = plan_counters(*fn);
+            append_u64(descriptor, function_hash(*fn));
+            append_u32(descriptor, static_cast<std::uint32_t>(plan.size));
+            append_u32(descriptor, static_cast<std::uint32_t>(fn->name.size()));
+            descriptor += fn->name;
+            total += plan.size;
+            ++functions;
+            plans.emplace_back(fn.get(), std::move(plan));
+        }
+        Function* main = module.find_function("main");
+        if (plans.empty() || main == nullptr || !is_definition(*main)) {
+            return PreservedAnalyses::all();  // no program to profile
+        }
+        std::size_t at = sizeof(runtime::kProfileMagic);
+        for (int i = 0; i < 4; ++i) {
+            descriptor[at + i] = static_cast<char>(functions >> (8 * i));
+        }
+
+        SymbolId counters = module.add_global("pallas.profile.counters",
+                                              std::string(8 * total, '\0'), false);
+        std::size_t base = 0;
+        for (auto& [fn, plan] : plans) {
+            instrument(*fn, plan, counters, base);
+            base += plan.size;
+        }
+
+        // main saves the counts on its way out.
+        SymbolId path_symbol = module.add_global("pallas.profile.path", path + '\0');
+        SymbolId descriptor_symbol = module.add_global("pallas.profile.descriptor", descriptor);
+        Function* writer = declare_runtime(module, "pallas_profile_write", IRType(),
+                                           {kPtr, kPtr, kI64, kPtr, kI64});
+        for (ValueId ret : returns_of(*main)) {
+            ValueId args[] = {main->global(path_symbol), main->global(descriptor_symbol),
+                              main->constant(kI64, descriptor.size()), main->global(counters),
+                              main->constant(kI64, total)};
+            call_before(*main, ret, *writer, args);
+        }
+        return PreservedAnalyses::none();
+    }
+
+  private:
+    std::string path;
+};
+
+// Numbers the allocation sites left after optimization and routes them
+// through the heap profiler (runtime/heap_profile.h): `new` and `delete` call
+// pallas_heap_new and pallas_heap_delete, arenas are set up by
+// pallas_heap_arena_init, `new` in an arena calls pallas_heap_arena_alloc
+// where it leaves the inline fast path, and main starts the profile on entry
+// and writes it on return. Lowering leaves the source line of arenas and of
+// arena `new` in the imm of the runtime call.
+class HeapProfilePass : public ModulePass {
+  public:
+    HeapProfilePass(std::string path, std::uint64_t rate) : path(std::move(path)), rate(rate) {}
+
+    const char* name() const override { return "heap-profile"; }
+
+    PreservedAnalyses run(Module& module, AnalysisManager&) override {
+        Function* main = module.find_function("main");
+        if (main == nullptr || !is_definition(*main)) {
+            return PreservedAnalyses::all();  // no program to profile
+        }
+        Function* heap_new = declare_runtime(module, "pallas_heap_new", kPtr, {kI64, kI32});
+        Function* heap_delete = declare_runtime(module, "pallas_heap_delete", IRType(), {kPtr});
+        Function* arena_init = declare_runtime(module, "pallas_heap_arena_init", IRType(),
+                                               {kPtr, kI64, kI32});
+        Function* arena_alloc = declare_runtime(module, "pallas_heap_arena_alloc", kPtr,
+                                                {kPtr, kI64, kI64, kI32});
+        SymbolId plain_arena_init = module.intern("pallas_arena_init");
+        SymbolId plain_arena_alloc = module.intern("pallas_arena_alloc");
+        std::string descriptor;
+        std::uint32_t sites = 0;
+        append_u32(descriptor, 0);
+        auto add_site = [&](Function& fn, std::uint32_t line, runtime::HeapSiteKind kind) {
+            append_u32(descriptor, line);
+            descriptor.push_back(static_cast<char>(kind));
+            append_u32(descriptor, static_cast<std::uint32_t>(fn.name.size()));
+            descriptor += fn.name;
+            return fn.constant(kI32, sites++);
+        };
+
+        for (const auto& fn : module.functions) {
+            if (!is_definition(*fn)) {
+                continue;
+            }
+            for (BlockId b : fn->block_order()) {
+                for (ValueId v : fn->block_insts(b)) {
+                    const Inst& inst = fn->inst(v);
+                    ValueId replacement = kNoValue;
+                    if (inst.op == Opcode::OP_NEW) {
+                        ValueId site = add_site(*fn, inst.aux, runtime::HeapSiteKind::NEW);
+                        ValueId args[] = {fn->operand(v, 0), site};
+                        replacement = call_before(*fn, v, *heap_new, args);
+                    } else if (inst.op == Opcode::OP_DELETE) {
+                        ValueId args[] = {fn->operand(v, 0)};
+                        replacement = call_before(*fn, v, *heap_delete, args);
+                    } else if (inst.op == Opcode::OP_CALL && inst.aux == plain_arena_init) {
+                        auto line = static_cast<std::uint32_t>(inst.imm);
+                        ValueId site = add_site(*fn, line, runtime::HeapSiteKind::ARENA);
+                        ValueId args[] = {fn->operand(v, 0), fn->operand(v, 1), site};
+                        replacement = call_before(*fn, v, *arena_init, args);
+                    } else if (inst.op == Opcode::OP_CALL && inst.aux == plain_arena_alloc &&
+                               inst.imm != 0) {
+                        auto line = static_cast<std::uint32_t>(inst.imm);
+                        ValueId site = add_site(*fn, line, runtime::HeapSiteKind::NEW);
+                        ValueId args[] = {fn->operand(v, 0), fn->operand(v, 1),
+                                          fn->operand(v, 2), site};
+                        replacement = call_before(*fn, v, *arena_alloc, args);
+                    } else {
+                        continue;
+                    }
+                    fn->replace_all_uses(v, replacement);
+                    fn->erase(v);
+                }
+            }
+        }
+        for (int i = 0; i < 4; ++i) {
+            descriptor[i] = static_cast<char>(sites >> (8 * i));
+        }
+
+        SymbolId path_symbol = module.add_global("pallas.heap_profile.path", path + '\0');
+        SymbolId descriptor_symbol =
+            module.add_global("pallas.heap_profile.descriptor", descriptor);
+        Function* start = declare_runtime(module, "pallas_heap_profile_start", IRType(),
+                                          {kPtr, kPtr, kI64, kI64});
+        Function* stop = declare_runtime(module, "pallas_heap_profile_stop", IRType(), {});
+        for (ValueId ret : returns_of(*main)) {
+            call_before(*main, ret, *stop, {});
+        }
+        ValueId args[] = {main->global(path_symbol), main->global(descriptor_symbol),
+                          main->constant(kI64, descriptor.size()), main->constant(kI64, rate)};
+        call_before(*main, first_non_phi(*main, main->entry()), *start, args);
+        return PreservedAnalyses::none();
+    }
+
+  private:
+    std::string path;
+    std::uint64_t rate;
+};
+
+// Puts the hottest cases of constant switches first, for backends that test
+// cases in order, and lays blocks out like the backends (code_layout).
+class ProfileLayoutPass : public FunctionPass {
+  public:
+    const char* name() const override { return "profile-layout"; }
+
+    PreservedAnalyses run(Function& fn, AnalysisManager& analyses) override {
+        if (fn.profile.empty()) {
+            return PreservedAnalyses::all();
+        }
+        bool reordered = false;
+        for (BlockId b : fn.block_order()) {
+            ValueId term = fn.terminator(b);
+            if (term != kNoValue && fn.inst(term).op == Opcode::OP_SWITCH) {
+                reordered |= order_cases(fn, term);
+            }
+        }
+        if (reordered) {
+            // Successor order decides the reverse postorder.
+            analyses.invalidate(fn, PreservedAnalyses::none());
+        }
+        const CFGInfo& cfg = analyses.cfg(fn);
+        std::vector<BlockId> order = code_layout(fn, cfg);
+        for (BlockId b : fn.block_order()) {
+            if (!cfg.reachable(b)) {
+                order.push_back(b);
+            }
+        }
+        // The entry stays first, so the analyses survive the new order.
+        fn.set_block_order(std::move(order));
+        return reordered ? PreservedAnalyses::none() : PreservedAnalyses::all();
+    }
+
+    std::unique_ptr<FunctionPass> clone() const override {
+        return std::make_unique<ProfileLayoutPass>();
+    }
+
+  private:
+    // The first equal case wins, so only switches whose cases are distinct
+    // constants can be reordered.
+    static bool order_cases(Function& fn, ValueId term) {
+        auto found = fn.profile.branch_weights.find(term);
+        std::uint32_t count = fn.num_operands(term);
+        if (found == fn.profile.branch_weights.end() || found->second.size() != count ||
+            count < 3) {
+            return false;
+        }
+        std::vector<std::uint64_t> keys;
+        for (std::uint32_t i = 1; i < count; ++i) {
+            const Inst& key = fn.inst(fn.operand(term, i));
+            if (key.op != Opcode::OP_CONST) {
+                return false;
+            }
+            keys.push_back(key.imm);
+        }
+        std::vector<std::uint64_t> sorted_keys = keys;
+        std::sort(sorted_keys.begin(), sorted_keys.end());
+        if (std::adjacent_find(sorted_keys.begin(), sorted_keys.end()) != sorted_keys.end()) {
+            return false;
+        }
+        std::vector<std::uint64_t>& weights = found->second;
+        std::vector<std::uint32_t> order(count - 1);
+        std::iota(order.begin(), order.end(), 1);
+        std::stable_sort(order.begin(), order.end(), [&](std::uint32_t a, std::uint32_t b) {
+            return weights[a] > weights[b];
+        });
+        if (std::is_sorted(order.begin(), order.end())) {
+            return false;
+        }
+        std::vector<ValueId> operands;
+        std::vector<BlockId> targets;
+        std::vector<std::uint64_t> new_weights = {weights[0]};
+        for (std::uint32_t i : order) {
+            operands.push_back(fn.operand(term, i));
+            targets.push_back(fn.targets(term)[i]);
+            new_weights.push_back(weights[i]);
+        }
+        for (std::uint32_t i = 1; i < count; ++i) {
+            fn.set_operand(term, i, operands[i - 1]);
+            fn.set_target(term, i, targets[i - 1]);
+        }
+        weights = std::move(new_weights);
+        return true;
+    }
+};
+
+}  // namespace
+
+std::uint64_t function_hash(const Function& fn) {
+    Hasher hasher;
+    std::vector<std::uint64_t> position(fn.num_blocks(), kNoBlock);
+    for (std::size_t i = 0; i < fn.block_order().size(); ++i) {
+        position[fn.block_order()[i]] = i;
+    }
+    hasher.add(static_cast<std::uint64_t>(fn.return_type.kind));
+    hasher.add(fn.num_args());
+    for (BlockId b : fn.block_order()) {
+        hasher.add(0xb10c);
+        for (ValueId v = fn.block(b).first; v != kNoValue; v = fn.inst(v).next) {
+            const Inst& inst = fn.inst(v);
+            hasher.add(static_cast<std::uint64_t>(inst.op) | std::uint64_t{inst.type.lanes} << 8 |
+                       static_cast<std::uint64_t>(inst.type.kind) << 24);
+            for (std::uint32_t i = 0; i < inst.num_operands; ++i) {
+                ValueId operand = fn.operand(v, i);
+                const Inst& source = fn.inst(operand);
+                // Constants by value: their IDs depend on when they were first used.
+                if (source.op == Opcode::OP_CONST) {
+                    hasher.add(source.imm);
+                } else if (source.op == Opcode::OP_GLOBAL) {
+                    hasher.add(fn.module->symbol_name(source.aux));
+                } else {
+                    hasher.add(operand);
+                }
+            }
+            for (BlockId target : fn.targets(v)) {
+                hasher.add(position[target]);
+            }
+            if (inst.op == Opcode::OP_CALL) {
+                hasher.add(fn.module->symbol_name(inst.aux));
+            } else {
+                hasher.add(inst.aux);
+                hasher.add(inst.imm);
+            }
+        }
+    }
+    return hasher.value();
+}
+
+bool parse_profile(const std::string& bytes, ProfileData* out, std::string* error) {
+    std::size_t at = 0;
+    auto read = [&](std::size_t size, std::uint64_t* value) {
+        if (bytes.size() - at < size) {
+            return false;
+        }
+        *value = 0;
+        for (std::size_t i = 0; i < size; ++i) {
+            *value |= std::uint64_t{static_cast<std::uint8_t>(bytes[at + i])} << (8 * i);
+        }
+        at += size;
+        return true;
+    };
+    if (bytes.size() < sizeof(runtime::kProfileMagic) ||
+        std::memcmp(bytes.data(), runtime::kProfileMagic, sizeof(runtime::kProfileMagic)) != 0) {
+        *error = "not a Pallas profile";
+        return false;
+    }
+    at = sizeof(runtime::kProfileMagic);
+    std::uint64_t functions = 0;
+    if (!read(4, &functions)) {
+        *error = "truncated profile";
+        return false;
+    }
+    std::vector<ProfileData::Entry*> entries;
+    for (std::uint64_t i = 0; i < functions; ++i) {
+        std::uint64_t hash = 0;
+        std::uint64_t counters = 0;
+        std::uint64_t length = 0;
+        if (!read(8, &hash) || !read(4, &counters) || !read(4, &length) ||
+            bytes.size() - at < length) {
+            *error = "truncated profile";
+            return false;
+        }
+        ProfileData::Entry& entry = out->functions[bytes.substr(at, length)];
+        at += length;
+        entry.hash = hash;
+        entry.counters.assign(counters, 0);
+        entries.push_back(&entry);
+    }
+    for (ProfileData::Entry* entry : entries) {
+        for (std::uint64_t& counter : entry->counters) {
+            if (!read(8, &counter)) {
+                *error = "truncated profile";
+                return false;
+            }
+        }
+    }
+    if (at != bytes.size()) {
+        *error = "trailing bytes after the profile";
+        return false;
+    }
+    return true;
+}
+
+ProfileUseReport apply_profile(Module& module, const ProfileData& profile) {
+    ProfileUseReport report;
+    for (const auto& fn : module.functions) {
+        auto found = profile.functions.find(fn->name);
+        if (!is_definition(*fn) || found == profile.functions.end()) {
+            continue;
+        }
+        CounterPlan plan = plan_counters(*fn);
+        const std::vector<std::uint64_t>& counters = found->second.counters;
+        if (found->second.hash != function_hash(*fn) || counters.size() != plan.size) {
+            report.stale.push_back(fn->name);
+            continue;
+        }
+        FunctionProfile& out = fn->profile;
+        out = {};
+        std::size_t index = 0;
+        for (BlockId b : plan.blocks) {
+            out.set_block_count(b, counters[index++]);
+        }
+        out.entry_count = out.block_count(fn->entry());
+        for (ValueId term : plan.branches) {
+            std::vector<std::uint64_t>& weights = out.branch_weights[term];
+            if (fn->inst(term).op == Opcode::OP_COND_BR) {
+                std::uint64_t total = out.block_count(fn->inst(term).block);
+                std::uint64_t taken = counters[index++];
+                weights = {taken, total - std::min(taken, total)};
+            } else {
+                for (std::size_t i = 0; i < fn->targets(term).size(); ++i) {
+                    weights.push_back(counters[index++]);
+                }
+            }
+        }
+        ++report.matched;
+    }
+    return report;
+}
+
+std::vector<BlockId> code_layout(const Function& fn, const CFGInfo& cfg) {
+    if (fn.profile.empty() || fn.profile.entry_count == 0) {
+        return cfg.rpo();
+    }
+    // Children before parents: a block is cold when it never ran and neither
+    // did any block it dominates, so hot code never uses a value defined in
+    // the cold part.
+    DominatorTree dom(fn, cfg);
+    std::vector<bool> cold(fn.num_blocks(), false);
+    const std::vector<BlockId>& preorder = dom.preorder();
+    for (auto it = preorder.rbegin(); it != preorder.rend(); ++it) {
+        bool never = fn.profile.block_count(*it) == 0;
+        for (BlockId child : dom.children(*it)) {
+            never = never && cold[child];
+        }
+        cold[*it] = never;
+    }
+    std::vector<BlockId> order;
+    for (bool part : {false, true}) {
+        for (BlockId b : cfg.rpo()) {
+            if (cold[b] == part) {
+                order.push_back(b);
+            }
+        }
+    }
+    return order;
+}
+
+std::unique_ptr<ModulePass> create_profile_generate_pass(std::string path) {
+    return std::make_unique<ProfileGeneratePass>(std::move(path));
+}
+
+std::unique_ptr<ModulePass> create_heap_profile_pass(std::string path, std::uint64_t rate) {
+    return std::make_unique<HeapProfilePass>(std::move(path), rate);
+}
+
+std::unique_ptr<FunctionPass> create_profile_layout_pass() {
+    return std::make_unique<ProfileLayoutPass>();
+}
+
+}  // namespace pallas::middle
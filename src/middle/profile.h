@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ir.h"
+#include "passes.h"
+
+namespace pallas::middle {
+
+// Profile-guided optimization. An instrumented build (create_profile_generate_pass
+// in transforms.h) counts how often every block runs, how often every
+// conditional branch is taken and which edge every switch takes, and writes
+// the counts when main returns (file format in runtime/profile.h). A later
+// build reads them back with parse_profile and attaches them to the functions
+// with apply_profile, as FunctionProfile; the inliner, the switch ordering and
+// block layout pass and the backends then consult them.
+//
+// Both builds number the counters the same way on the IR fresh from lowering,
+// and each function carries a hash of that IR: a function edited since the
+// profile was collected gets no counts instead of wrong ones.
+
+// Counts read from a profile file, by function name.
+struct ProfileData {
+    struct Entry {
+        std::uint64_t hash = 0;
+        std::vector<std::uint64_t> counters;
+    };
+    std::unordered_map<std::string, Entry> functions;
+};
+
+// Structural hash of a function: instructions, operands, types and the shape of
+// the CFG, in block order. Callees are hashed by name.
+std::uint64_t function_hash(const Function& fn);
+
+// Parses the contents of a profile file.
+bool parse_profile(const std::string& bytes, ProfileData* out, std::string* error);
+
+struct ProfileUseReport {
+    std::size_t matched = 0;
+    std::vector<std::string> stale;  // in the profile, but changed since
+};
+
+// Attaches the counts of `profile` to the functions of a freshly lowered module
+// whose hash still matches.
+ProfileUseReport apply_profile(Module& module, const ProfileData& profile);
+
+// The order in which backends emit blocks: reverse postorder, with the blocks
+// the profile shows never run (and all the blocks they dominate) moved to the
+// end, away from the hot code. Every block still follows its immediate
+// dominator. Without a profile this is just reverse postorder.
+std::vector<BlockId> code_layout(const Function& fn, const CFGInfo& cfg);
+
+}  // namespace pallas::middle
@@ -0,0 +1,213 @@
+#include <unordered_map>
+#include <vector>
+#include "transforms.h"
+
+namespace pallas::middle {
+
+namespace {
+
+// Rewrites one function. Lanes of every vector value are kept as scalar
+// values; the vector instructions are deleted once nothing refers to them.
+class Scalarizer {
+  public:
+    explicit Scalarizer(Function& fn) : fn(fn) {}
+
+    bool run(const CFGInfo& cfg) {
+        std::vector<ValueId> vector_insts;
+        for (BlockId b : cfg.rpo()) {
+            for (ValueId v : fn.block_insts(b)) {
+                if (is_vector_inst(v)) {
+                    vector_insts.push_back(v);
+                }
+            }
+        }
+        for (ValueId v : vector_insts) {
+            scalarize(v);
+        }
+        // Phi entries may come from later blocks, so they are filled last.
+        for (auto& [v, scalar_phis] : phis) {
+            std::span<const BlockId> from = fn.targets(v);
+            std::vector<BlockId> incoming(from.begin(), from.end());
+            for (std::uint32_t i = 0; i < incoming.size(); ++i) {
+                std::vector<ValueId> values = lanes(fn.operand(v, i));
+                for (std::size_t lane = 0; lane < scalar_phis.size(); ++lane) {
+                    fn.add_incoming(scalar_phis[lane], values[lane], incoming[i]);
+                }
+            }
+        }
+        for (auto it = vector_insts.rbegin(); it != vector_insts.rend(); ++it) {
+            fn.erase(*it);
+        }
+        return !vector_insts.empty();
+    }
+
+  private:
+    Function& fn;
+    std::unordered_map<ValueId, std::vector<ValueId>> split;
+    std::vector<std::pair<ValueId, std::vector<ValueId>>> phis;
+
+    bool is_vector_inst(ValueId v) const {
+        if (fn.inst(v).type.is_vector()) {
+            return true;
+        }
+        for (std::uint32_t i = 0; i < fn.num_operands(v); ++i) {
+            if (fn.inst(fn.operand(v, i)).type.is_vector()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::vector<ValueId> lanes(ValueId v) {
+        const Inst& inst = fn.inst(v);
+        if (!inst.type.is_vector()) {
+            return std::vector<ValueId>(1, v);
+        }
+        if (inst.op == Opcode::OP_CONST) {
+            ValueId element = fn.constant(inst.type.element(), inst.imm);
+            return std::vector<ValueId>(inst.type.lanes, element);
+        }
+        if (inst.op == Opcode::OP_UNDEF) {
+            return std::vector<ValueId>(inst.type.lanes, fn.undef(inst.type.element()));
+        }
+        return split.at(v);
+    }
+
+    // Lane `i` of an operand; scalar operands (a select condition, a shift
+    // amount) are shared by all lanes.
+    ValueId lane(ValueId v, std::size_t i) {
+        return fn.inst(v).type.is_vector() ? lanes(v)[i] : v;
+    }
+
+    ValueId lane_offset(std::uint64_t bytes) {
+        return fn.constant(IRType::scalar(IRTypeKind::IR_I64), bytes);
+    }
+
+    // `index == lane ? a : b`, for lane indices only known at run time.
+    ValueId select_lane(ValueId pos, ValueId index, std::size_t lane, ValueId a, ValueId b) {
+        IRType index_type = fn.inst(index).type;
+        ValueId lane_constant = fn.constant(index_type, lane);
+        ValueId is_lane = fn.insert_before(pos, Opcode::OP_ICMP,
+                                           IRType::scalar(IRTypeKind::IR_I1),
+                                           std::vector<ValueId>{index, lane_constant});
+        fn.inst(is_lane).aux = static_cast<std::uint32_t>(CmpPredicate::CMP_EQ);
+        return fn.insert_before(pos, Opcode::OP_SELECT, fn.inst(a).type,
+                                std::vector<ValueId>{is_lane, a, b});
+    }
+
+    void scalarize(ValueId v) {
+        const Inst inst = fn.inst(v);
+        IRType element = inst.type.element();
+        std::vector<ValueId> out;
+        switch (inst.op) {
+            case Opcode::OP_PHI: {
+                for (std::uint16_t i = 0; i < inst.type.lanes; ++i) {
+                    out.push_back(fn.insert_before(v, Opcode::OP_PHI, element));
+                }
+                phis.emplace_back(v, out);
+                break;
+            }
+            case Opcode::OP_SPLAT:
+                out.assign(inst.type.lanes, fn.operand(v, 0));
+                break;
+            case Opcode::OP_EXTRACT: {
+                std::vector<ValueId> values = lanes(fn.operand(v, 0));
+                ValueId index = fn.operand(v, 1);
+                ValueId result = values[0];
+                if (fn.inst(index).op == Opcode::OP_CONST) {
+                    result = values[fn.inst(index).imm];
+                } else {
+                    for (std::size_t i = 1; i < values.size(); ++i) {
+                        result = select_lane(v, index, i, values[i], result);
+                    }
+                }
+                fn.replace_all_uses(v, result);
+                return;
+            }
+            case Opcode::OP_INSERT: {
+                out = lanes(fn.operand(v, 0));
+                ValueId element_value = fn.operand(v, 1);
+                ValueId index = fn.operand(v, 2);
+                if (fn.inst(index).op == Opcode::OP_CONST) {
+                    out[fn.inst(index).imm] = element_value;
+                } else {
+                    for (std::size_t i = 0; i < out.size(); ++i) {
+                        out[i] = select_lane(v, index, i, element_value, out[i]);
+                    }
+                }
+                break;
+            }
+            case Opcode::OP_LOAD: {
+                ValueId base = fn.operand(v, 0);
+                for (std::uint16_t i = 0; i < inst.type.lanes; ++i) {
+                    ValueId address = base;
+                    if (i > 0) {
+                        address = fn.insert_before(
+                            v, Opcode::OP_PTRADD, IRType::scalar(IRTypeKind::IR_PTR),
+                            std::vector<ValueId>{base, lane_offset(i * type_size(element))});
+                    }
+                    out.push_back(fn.insert_before(v, Opcode::OP_LOAD, element,
+                                                   std::vector<ValueId>{address}));
+                }
+                break;
+            }
+            case Opcode::OP_STORE: {
+                ValueId stored = fn.operand(v, 0);
+                ValueId base = fn.operand(v, 1);
+                IRType stored_element = fn.inst(stored).type.element();
+                std::vector<ValueId> values = lanes(stored);
+                for (std::size_t i = 0; i < values.size(); ++i) {
+                    ValueId address = base;
+                    if (i > 0) {
+                        address = fn.insert_before(
+                            v, Opcode::OP_PTRADD, IRType::scalar(IRTypeKind::IR_PTR),
+                            std::vector<ValueId>{base, lane_offset(i * type_size(stored_element))});
+                    }
+                    fn.insert_before(v, Opcode::OP_STORE, IRType::scalar(IRTypeKind::IR_VOID),
+                                     std::vector<ValueId>{values[i], address});
+                }
+                return;
+            }
+            default: {
+                // Element-wise operations: arithmetic, comparisons, casts, select.
+                for (std::uint16_t i = 0; i < inst.type.lanes; ++i) {
+                    std::vector<ValueId> operands;
+                    for (std::uint32_t k = 0; k < inst.num_operands; ++k) {
+                        operands.push_back(lane(fn.operand(v, k), i));
+                    }
+                    ValueId scalar = fn.insert_before(v, inst.op, element, operands);
+                    fn.inst(scalar).aux = inst.aux;
+                    fn.inst(scalar).imm = inst.imm;
+                    fn.inst(scalar).flags = inst.flags;
+                    out.push_back(scalar);
+                }
+                break;
+            }
+        }
+        split[v] = std::move(out);
+    }
+};
+
+class ScalarizePass : public FunctionPass {
+  public:
+    const char* name() const override { return "scalarize"; }
+    std::unique_ptr<FunctionPass> clone() const override {
+        return std::make_unique<ScalarizePass>(*this);
+    }
+
+    PreservedAnalyses run(Function& fn, AnalysisManager& analyses) override {
+        if (fn.entry() == kNoBlock) {
+            return PreservedAnalyses::all();
+        }
+        bool changed = Scalarizer(fn).run(analyses.cfg(fn));
+        return changed ? PreservedAnalyses::cfg() : PreservedAnalyses::all();
+    }
+};
+
+}  // namespace
+
+std::unique_ptr<FunctionPass> create_scalarize_pass() {
+    return std::make_unique<ScalarizePass>();
+}
+
+}  // namespace pallas::middle
@@ -0,0 +1,299 @@
+#include <cstdint>
+#include <unordered_set>
+#include <vector>
+#include "fold.h"
+#include "transforms.h"
+
+namespace pallas::middle {
+
+namespace {
+
+enum class Lattice : std::uint8_t {
+    LATTICE_TOP,       // no information yet (or undef)
+    LATTICE_CONST,     // one known constant
+    LATTICE_BOTTOM,    // overdefined
+};
+
+struct LatticeValue {
+    Lattice state = Lattice::LATTICE_TOP;
+    std::uint64_t bits = 0;
+};
+
+// Wegman-Zadeck: values and CFG edges are discovered together, so a branch on a
+// constant never makes the untaken side executable and its values never pollute
+// the phis they reach. Each value is lowered at most twice and each edge
+// marked once, which keeps the pass linear in the size of the function.
+class SCCPSolver {
+  public:
+    explicit SCCPSolver(Function& fn)
+        : fn(fn), values(fn.num_values()), executable(fn.num_blocks(), false) {}
+
+    void solve() {
+        mark_block(fn.entry());
+        while (!block_work.empty() || !value_work.empty()) {
+            while (!value_work.empty()) {
+                ValueId v = value_work.back();
+                value_work.pop_back();
+                for (UseId u = fn.inst(v).first_use; u != kNoUse; u = fn.use(u).next) {
+                    ValueId user = fn.use(u).user;
+                    if (fn.inst(user).block != kNoBlock && executable[fn.inst(user).block]) {
+                        visit(user);
+                    }
+                }
+            }
+            while (!block_work.empty()) {
+                BlockId b = block_work.back();
+                block_work.pop_back();
+                for (ValueId v = fn.block(b).first; v != kNoValue; v = fn.inst(v).next) {
+                    visit(v);
+                }
+            }
+        }
+    }
+
+    bool rewrite() {
+        bool cfg_changed = false;
+        for (BlockId b : std::vector<BlockId>(fn.block_order())) {
+            if (!executable[b]) {
+                continue;
+            }
+            for (ValueId v : fn.block_insts(b)) {
+                const Inst& inst = fn.inst(v);
+                if (inst.op == Opcode::OP_COND_BR || inst.op == Opcode::OP_SWITCH) {
+                    std::vector<BlockId> live;
+                    for (BlockId s : fn.targets(v)) {
+                        if (edges.count(edge_key(b, s)) != 0) {
+                            live.push_back(s);
+                        }
+                    }
+                    bool single = !live.empty();
+                    for (BlockId s : live) {
+                        single = single && s == live.front();
+                    }
+                    if (single) {
+                        replace_with_branch(fn, b, live.front());
+                        cfg_changed = true;
+                    }
+                    continue;
+                }
+                if (inst.type.kind == IRTypeKind::IR_VOID || inst.op == Opcode::OP_CALL ||
+                    values[v].state != Lattice::LATTICE_CONST) {
+                    continue;
+                }
+                Opcode op = inst.op;
+                fn.replace_all_uses(v, fn.constant(inst.type, values[v].bits));
+                if (!has_side_effects(op)) {
+                    fn.erase(v);
+                }
+                changed_values = true;
+            }
+        }
+        if (remove_unreachable_blocks(fn)) {
+            cfg_changed = true;
+        }
+        return cfg_changed;
+    }
+
+    bool changed() const { return changed_values; }
+
+  private:
+    Function& fn;
+    std::vector<LatticeValue> values;
+    std::vector<bool> executable;
+    std::unordered_set<std::uint64_t> edges;
+    std::vector<BlockId> block_work;
+    std::vector<ValueId> value_work;
+    bool changed_values = false;
+
+    static std::uint64_t edge_key(BlockId from, BlockId to) {
+        return (static_cast<std::uint64_t>(from) << 32) | to;
+    }
+
+    LatticeValue get(ValueId v) const {
+        const Inst& inst = fn.inst(v);
+        switch (inst.op) {
+            case Opcode::OP_CONST:
+                if (inst.type.is_vector()) {
+                    return {Lattice::LATTICE_BOTTOM, 0};
+                }
+                return {Lattice::LATTICE_CONST, inst.imm};
+            case Opcode::OP_UNDEF:
+                return {Lattice::LATTICE_TOP, 0};
+            case Opcode::OP_ARG:
+            case Opcode::OP_GLOBAL:
+                return {Lattice::LATTICE_BOTTOM, 0};
+            default:
+                return values[v];
+        }
+    }
+
+    void lower(ValueId v, LatticeValue to) {
+        LatticeValue& cur = values[v];
+        if (cur.state == Lattice::LATTICE_BOTTOM ||
+            (cur.state == to.state && (to.state != Lattice::LATTICE_CONST || cur.bits == to.bits))) {
+            return;
+        }
+        if (cur.state == Lattice::LATTICE_CONST && to.state == Lattice::LATTICE_CONST) {
+            to.state = Lattice::LATTICE_BOTTOM;  // two different constants
+        }
+        if (to.state == Lattice::LATTICE_TOP) {
+            return;
+        }
+        cur = to;
+        value_work.push_back(v);
+    }
+
+    void mark_block(BlockId b) {
+        if (!executable[b]) {
+            executable[b] = true;
+            block_work.push_back(b);
+        }
+    }
+
+    void mark_edge(BlockId from, BlockId to) {
+        if (!edges.insert(edge_key(from, to)).second) {
+            return;
+        }
+        if (!executable[to]) {
+            mark_block(to);
+            return;
+        }
+        // A new edge into a block already visited only changes its phis.
+        for (ValueId v = fn.block(to).first; v != kNoValue && fn.inst(v).op == Opcode::OP_PHI;
+             v = fn.inst(v).next) {
+            visit(v);
+        }
+    }
+
+    void visit(ValueId v) {
+        const Inst& inst = fn.inst(v);
+        BlockId b = inst.block;
+        switch (inst.op) {
+            case Opcode::OP_PHI: {
+                if (values[v].state == Lattice::LATTICE_BOTTOM) {
+                    return;  // cannot change; skips rescanning a wide phi per new edge
+                }
+                LatticeValue merged;
+                std::span<const BlockId> from = fn.targets(v);
+                for (std::uint32_t i = 0; i < inst.num_operands; ++i) {
+                    if (edges.count(edge_key(from[i], b)) == 0) {
+                        continue;
+                    }
+                    LatticeValue in = get(fn.operand(v, i));
+                    if (in.state == Lattice::LATTICE_TOP) {
+                        continue;
+                    }
+                    if (in.state == Lattice::LATTICE_BOTTOM ||
+                        (merged.state == Lattice::LATTICE_CONST && merged.bits != in.bits)) {
+                        merged.state = Lattice::LATTICE_BOTTOM;
+                        break;
+                    }
+                    merged = in;
+                }
+                lower(v, merged);
+                return;
+            }
+            case Opcode::OP_BR:
+                mark_edge(b, fn.targets(v)[0]);
+                return;
+            case Opcode::OP_COND_BR: {
+                LatticeValue cond = get(fn.operand(v, 0));
+                if (cond.state == Lattice::LATTICE_CONST) {
+                    mark_edge(b, fn.targets(v)[(cond.bits & 1) ? 0 : 1]);
+                } else if (cond.state == Lattice::LATTICE_BOTTOM) {
+                    mark_edge(b, fn.targets(v)[0]);
+                    mark_edge(b, fn.targets(v)[1]);
+                }
+                return;
+            }
+            case Opcode::OP_SWITCH: {
+                LatticeValue cond = get(fn.operand(v, 0));
+                std::span<const BlockId> targets = fn.targets(v);
+                if (cond.state == Lattice::LATTICE_CONST) {
+                    BlockId dest = targets[0];
+                    for (std::uint32_t i = 1; i < inst.num_operands; ++i) {
+                        if (fn.inst(fn.operand(v, i)).imm == cond.bits) {
+                            dest = targets[i];
+                            break;
+                        }
+                    }
+                    mark_edge(b, dest);
+                } else if (cond.state == Lattice::LATTICE_BOTTOM) {
+                    for (BlockId s : std::vector<BlockId>(targets.begin(), targets.end())) {
+                        mark_edge(b, s);
+                    }
+                }
+                return;
+            }
+            case Opcode::OP_RET:
+            case Opcode::OP_UNREACHABLE:
+                return;
+            default:
+                break;
+        }
+        if (inst.type.kind == IRTypeKind::IR_VOID) {
+            return;
+        }
+        if (!is_pure(inst.op) || inst.type.is_vector()) {
+            lower(v, {Lattice::LATTICE_BOTTOM, 0});
+            return;
+        }
+        if (inst.op == Opcode::OP_SELECT) {
+            LatticeValue cond = get(fn.operand(v, 0));
+            if (cond.state == Lattice::LATTICE_CONST) {
+                lower(v, get(fn.operand(v, (cond.bits & 1) ? 1 : 2)));
+                return;
+            }
+        }
+        std::vector<ConstOperand> operands;
+        operands.reserve(inst.num_operands);
+        bool unknown = false;
+        for (std::uint32_t i = 0; i < inst.num_operands; ++i) {
+            ValueId op = fn.operand(v, i);
+            LatticeValue in = get(op);
+            if (in.state == Lattice::LATTICE_BOTTOM) {
+                lower(v, {Lattice::LATTICE_BOTTOM, 0});
+                return;
+            }
+            unknown = unknown || in.state == Lattice::LATTICE_TOP;
+            operands.push_back({fn.inst(op).type, in.bits});
+        }
+        if (unknown) {
+            return;
+        }
+        std::optional<std::uint64_t> folded = fold_operation(inst.op, inst.type, inst.aux, operands);
+        if (folded) {
+            lower(v, {Lattice::LATTICE_CONST, *folded});
+        } else {
+            lower(v, {Lattice::LATTICE_BOTTOM, 0});
+        }
+    }
+};
+
+class SCCPPass : public FunctionPass {
+  public:
+    const char* name() const override { return "sccp"; }
+    std::unique_ptr<FunctionPass> clone() const override {
+        return std::make_unique<SCCPPass>(*this);
+    }
+
+    PreservedAnalyses run(Function& fn, AnalysisManager&) override {
+        if (fn.entry() == kNoBlock) {
+            return PreservedAnalyses::all();
+        }
+        SCCPSolver solver(fn);
+        solver.solve();
+        if (solver.rewrite()) {
+            return PreservedAnalyses::none();
+        }
+        return solver.changed() ? PreservedAnalyses::cfg() : PreservedAnalyses::all();
+    }
+};
+
+}  // namespace
+
+std::unique_ptr<FunctionPass> create_sccp_pass() {
+    return std::make_unique<SCCPPass>();
+}
+
+}  // namespace pallas::middle
@@ -0,0 +1,285 @@
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+#include "transforms.h"
+
+namespace pallas::middle {
+
+void replace_with_branch(Function& fn, BlockId b, BlockId target) {
+    ValueId term = fn.terminator(b);
+    std::vector<BlockId> old(fn.targets(term).begin(), fn.targets(term).end());
+    fn.erase(term);
+    bool kept = false;
+    for (BlockId s : old) {
+        if (s == target && !kept) {
+            kept = true;
+            continue;
+        }
+        fn.remove_predecessor(s, b);
+    }
+    fn.append(b, Opcode::OP_BR, IRType(), {}, {&target, 1});
+}
+
+bool remove_unreachable_blocks(Function& fn) {
+    if (fn.entry() == kNoBlock) {
+        return false;
+    }
+    std::vector<bool> seen(fn.num_blocks(), false);
+    std::vector<BlockId> stack = {fn.entry()};
+    seen[fn.entry()] = true;
+    while (!stack.empty()) {
+        BlockId b = stack.back();
+        stack.pop_back();
+        for (BlockId s : fn.successors(b)) {
+            if (!seen[s]) {
+                seen[s] = true;
+                stack.push_back(s);
+            }
+        }
+    }
+    std::vector<BlockId> dead;
+    for (BlockId b : fn.block_order()) {
+        if (!seen[b]) {
+            dead.push_back(b);
+        }
+    }
+    if (dead.empty()) {
+        return false;
+    }
+    // One pass per phi however many of its predecessors died: a `match` whose
+    // arms all fold away would otherwise cost arms x incoming entries.
+    std::vector<bool> joins(fn.num_blocks(), false);
+    for (BlockId b : dead) {
+        for (BlockId s : fn.successors(b)) {
+            if (seen[s] && !joins[s]) {
+                joins[s] = true;
+                fn.remove_dead_predecessors(s, seen);
+            }
+        }
+    }
+    for (BlockId b : dead) {
+        for (ValueId v : fn.block_insts(b)) {
+            if (fn.has_uses(v)) {
+                IRType type = fn.inst(v).type;
+                fn.replace_all_uses(v, fn.undef(type));
+            }
+        }
+    }
+    for (BlockId b : dead) {
+        fn.erase_block(b);
+    }
+    return true;
+}
+
+namespace {
+
+class SimplifyCFGPass : public FunctionPass {
+  public:
+    const char* name() const override { return "simplifycfg"; }
+    std::unique_ptr<FunctionPass> clone() const override {
+        return std::make_unique<SimplifyCFGPass>(*this);
+    }
+
+    PreservedAnalyses run(Function& fn, AnalysisManager&) override {
+        if (fn.entry() == kNoBlock) {
+            return PreservedAnalyses::all();
+        }
+        bool changed = false;
+        // Each sweep applies every rewrite whose neighbourhood is still untouched
+        // in this sweep, so one sweep is linear and few sweeps are needed.
+        while (sweep(fn)) {
+            changed = true;
+        }
+        return changed ? PreservedAnalyses::none() : PreservedAnalyses::all();
+    }
+
+  private:
+    std::vector<std::vector<BlockId>> preds;
+    std::vector<bool> dirty;
+    // Per phi of a threading target, where each predecessor's incoming entry
+    // is. Built on first use in a sweep and kept in step by thread_empty; other
+    // rewrites that change a block's phis mark it dirty, which retires it.
+    using IncomingIndex = std::vector<std::unordered_map<BlockId, std::uint32_t>>;
+    std::unordered_map<BlockId, IncomingIndex> incoming;
+
+    bool sweep(Function& fn) {
+        bool changed = remove_unreachable_blocks(fn);
+        preds.assign(fn.num_blocks(), {});
+        dirty.assign(fn.num_blocks(), false);
+        incoming.clear();
+        for (BlockId b : fn.block_order()) {
+            for (BlockId s : fn.successors(b)) {
+                preds[s].push_back(b);
+            }
+        }
+        for (BlockId b : std::vector<BlockId>(fn.block_order())) {
+            if (fn.block(b).erased || dirty[b]) {
+                continue;
+            }
+            if (fold_branch(fn, b) || merge_successor(fn, b) || thread_empty(fn, b)) {
+                changed = true;
+            }
+        }
+        return changed;
+    }
+
+    bool touched(std::span<const BlockId> blocks) const {
+        return std::any_of(blocks.begin(), blocks.end(), [&](BlockId b) { return dirty[b]; });
+    }
+
+    void touch(std::span<const BlockId> blocks) {
+        for (BlockId b : blocks) {
+            dirty[b] = true;
+        }
+    }
+
+    // condbr/switch whose outcome is known or whose targets all agree.
+    bool fold_branch(Function& fn, BlockId b) {
+        ValueId term = fn.terminator(b);
+        const Inst& inst = fn.inst(term);
+        if (inst.op != Opcode::OP_COND_BR && inst.op != Opcode::OP_SWITCH) {
+            return false;
+        }
+        std::vector<BlockId> succs(fn.targets(term).begin(), fn.targets(term).end());
+        if (touched(succs)) {
+            return false;
+        }
+        BlockId target = kNoBlock;
+        const Inst& cond = fn.inst(fn.operand(term, 0));
+        if (std::all_of(succs.begin(), succs.end(), [&](BlockId s) { return s == succs[0]; })) {
+            target = succs[0];
+        } else if (cond.op == Opcode::OP_CONST && inst.op == Opcode::OP_COND_BR) {
+            target = succs[(cond.imm & 1) ? 0 : 1];
+        } else if (cond.op == Opcode::OP_CONST) {
+            target = succs[0];
+            for (std::uint32_t i = 1; i < inst.num_operands; ++i) {
+                if (fn.inst(fn.operand(term, i)).imm == cond.imm) {
+                    target = succs[i];
+                    break;
+                }
+            }
+        }
+        if (target == kNoBlock) {
+            return false;
+        }
+        replace_with_branch(fn, b, target);
+        touch(succs);
+        dirty[b] = true;
+        return true;
+    }
+
+    // b: ... br s, where b is the only predecessor of s: splice s into b.
+    bool merge_successor(Function& fn, BlockId b) {
+        ValueId term = fn.terminator(b);
+        if (fn.inst(term).op != Opcode::OP_BR) {
+            return false;
+        }
+        BlockId s = fn.targets(term)[0];
+        if (s == b || s == fn.entry() || dirty[s] || preds[s].size() != 1) {
+            return false;
+        }
+        std::vector<BlockId> next(fn.successors(s).begin(), fn.successors(s).end());
+        if (touched(next)) {
+            return false;
+        }
+        fn.erase(term);
+        for (ValueId v : fn.block_insts(s)) {
+            if (fn.inst(v).op == Opcode::OP_PHI) {
+                fn.replace_all_uses(v, fn.operand(v, 0));
+                fn.erase(v);
+            } else {
+                fn.move_to_end(v, b);
+            }
+        }
+        for (BlockId n : next) {
+            fn.replace_predecessor(n, s, b);
+        }
+        fn.erase_block(s);
+        dirty[b] = true;
+        dirty[s] = true;
+        touch(next);
+        return true;
+    }
+
+    IncomingIndex& incoming_of(Function& fn, BlockId t) {
+        auto [it, fresh] = incoming.try_emplace(t);
+        if (fresh) {
+            for (ValueId v = fn.block(t).first; fn.inst(v).op == Opcode::OP_PHI;
+                 v = fn.inst(v).next) {
+                std::span<const BlockId> in = fn.targets(v);
+                auto& positions = it->second.emplace_back();
+                for (std::uint32_t k = 0; k < in.size(); ++k) {
+                    positions.try_emplace(in[k], k);
+                }
+            }
+        }
+        return it->second;
+    }
+
+    // s holds nothing but `br t`: send every predecessor of s straight to t.
+    bool thread_empty(Function& fn, BlockId s) {
+        ValueId term = fn.terminator(s);
+        if (fn.block(s).first != term || fn.inst(term).op != Opcode::OP_BR || s == fn.entry()) {
+            return false;
+        }
+        BlockId t = fn.targets(term)[0];
+        if (t == s || dirty[t] || preds[s].empty() || touched(preds[s])) {
+            return false;
+        }
+        // Looked up rather than searched: t may be the join of a `match` with
+        // thousands of arms, each of them an empty block like s.
+        IncomingIndex& index = incoming_of(fn, t);
+        std::vector<ValueId> phis;
+        std::vector<ValueId> from_s;
+        for (ValueId v = fn.block(t).first; fn.inst(v).op == Opcode::OP_PHI; v = fn.inst(v).next) {
+            from_s.push_back(fn.operand(v, index[phis.size()].at(s)));
+            phis.push_back(v);
+        }
+        bool threaded = false;
+        for (BlockId p : std::vector<BlockId>(preds[s])) {
+            if (p == s) {
+                continue;
+            }
+            // If p already reaches t, the phis of t must not tell the two edges apart
+            // (entries from one predecessor always agree, so its first one decides).
+            bool conflict = false;
+            for (std::size_t i = 0; i < phis.size() && !conflict; ++i) {
+                auto at = index[i].find(p);
+                conflict = at != index[i].end() && fn.operand(phis[i], at->second) != from_s[i];
+            }
+            if (conflict) {
+                continue;
+            }
+            ValueId pterm = fn.terminator(p);
+            for (std::uint32_t i = 0; i < fn.inst(pterm).num_targets; ++i) {
+                if (fn.targets(pterm)[i] != s) {
+                    continue;
+                }
+                fn.set_target(pterm, i, t);
+                preds[t].push_back(p);
+                for (std::size_t k = 0; k < phis.size(); ++k) {
+                    index[k].try_emplace(p, fn.inst(phis[k]).num_operands);
+                    fn.add_incoming(phis[k], from_s[k], p);
+                }
+            }
+            std::erase(preds[s], p);
+            dirty[p] = true;
+            threaded = true;
+        }
+        // t stays open to rewrites: its predecessor list is kept up to date,
+        // so the other blocks that only branch to t (the arms of a long
+        // `match`) are threaded in the same sweep rather than one per sweep.
+        if (threaded) {
+            dirty[s] = true;
+        }
+        return threaded;
+    }
+};
+
+}  // namespace
+
+std::unique_ptr<FunctionPass> create_simplify_cfg_pass() {
+    return std::make_unique<SimplifyCFGPass>();
+}
+
+}  // namespace pallas::middle
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+#include "passes.h"
+
+namespace pallas::middle {
+
+// Sparse conditional constant propagation (Wegman-Zadeck). Folds values that
+// are constant along every executable path and deletes unreachable code.
+std::unique_ptr<FunctionPass> create_sccp_pass();
+
+// Dominator-scoped global value numbering: removes redundant pure
+// computations, redundant loads and loads of just-stored values.
+std::unique_ptr<FunctionPass> create_gvn_pass();
+
+// Aggressive dead code elimination. Everything is dead until proven live from
+// side effects, including branches no live instruction depends on.
+std::unique_ptr<FunctionPass> create_adce_pass();
+
+// Merges straight-line blocks, threads jumps through empty blocks, folds
+// constant and redundant branches and removes unreachable blocks.
+std::unique_ptr<FunctionPass> create_simplify_cfg_pass();
+
+struct InlineOptions {
+    // Only inline functions marked @inline (the -O1 setting).
+    bool only_always = false;
+    // A call is inlined when the callee's size minus the expected savings is at
+    // most this many instructions.
+    std::int64_t threshold = 40;
+    // A caller may grow to max(min_growth, growth_factor * original size).
+    double growth_factor = 2.0;
+    std::size_t min_growth = 256;
+    // With a profile: calls whose block ran at least 1/hot_ratio as often as
+    // the hottest block of the module use hot_threshold instead, and calls
+    // that never ran are left alone.
+    std::int64_t hot_threshold = 200;
+    std::uint64_t hot_ratio = 100;
+};
+
+// Bottom-up inliner: visits the call graph by strongly connected components,
+// callees first, so a callee is already optimized by inlining when its own
+// callers are considered. Calls within one component (recursion) are never
+// inlined. @inline callees are always inlined, @noinline ones never. The
+// profile counts of a callee are scaled into the caller with its body.
+std::unique_ptr<ModulePass> create_inline_pass(InlineOptions options = {});
+
+// Escape analysis. A `new` of a small constant size whose object provably
+// dies with the function (its address is never stored, returned, merged by a
+// phi or passed to a callee that captures it) is turned into a zeroed stack
+// slot, and the matching `delete`s are removed.
+std::unique_ptr<ModulePass> create_escape_pass();
+
+// Per-function results of bounds-check elimination, in the order the pass
+// visited the functions; with parallel function passes that order varies.
+struct BoundsCheckReport {
+    struct Entry {
+        std::string function;
+        std::size_t removed = 0;    // proven to hold and deleted
+        std::size_t hoisted = 0;    // moved out of a loop
+        std::size_t remaining = 0;  // left in the function, hoisted ones included
+    };
+    std::vector<Entry> functions;
+};
+
+// Bounds-check elimination. Deletes `boundscheck` instructions whose index is
+// in range by value-range analysis (constants, masks, induction variables of
+// counted loops with a known bound) or that repeat a dominating check, and
+// hoists checks that run on every loop iteration into the preheader, where the
+// first and last index are checked once. Counts go to `report` if given.
+std::unique_ptr<FunctionPass> create_bce_pass(BoundsCheckReport* report = nullptr);
+
+// Gives every loop a preheader: a block that only branches to the header and
+// carries all edges entering the loop. The other loop passes rely on it.
+std::unique_ptr<FunctionPass> create_loop_simplify_pass();
+
+// Loop-invariant code motion: hoists pure computations whose operands are
+// defined outside a loop into its preheader, and loads from the header of
+// loops that do not write memory.
+std::unique_ptr<FunctionPass> create_licm_pass();
+
+// Induction variable simplification: merges induction variables that step in
+// lockstep and replaces uses after a loop with the closed-form exit value when
+// the trip count is known.
+std::unique_ptr<FunctionPass> create_indvars_pass();
+
+// Strength reduction: rewrites multiplications of an induction variable by a
+// constant (array offsets) into a second induction variable advanced by addition.
+std::unique_ptr<FunctionPass> create_loop_reduce_pass();
+
+// Fully unrolls innermost loops with a small constant trip count.
+std::unique_ptr<FunctionPass> create_loop_unroll_pass();
+
+// Turns innermost counted loops over contiguous array elements into a vector
+// loop of 256-bit SIMD operations followed by the original loop for the
+// remaining iterations. Integer sum/product/bitwise reductions are vectorized
+// too; pointers that may overlap are checked at run time before the vector
+// loop is entered.
+std::unique_ptr<FunctionPass> create_loop_vectorize_pass();
+
+// Splits vector operations into one scalar operation per lane (loads and
+// stores into one access per element), for targets without SIMD lowering.
+std::unique_ptr<FunctionPass> create_scalarize_pass();
+
+// Instruments every function to count its blocks and branch edges, and main to
+// write the counts to `path` when it returns (see profile.h). Runs on the IR
+// fresh from lowering, before any other pass.
+std::unique_ptr<ModulePass> create_profile_generate_pass(std::string path);
+
+// Routes the heap allocations left after optimization, and the arenas,
+// through the heap profiler, which samples about one allocation per `rate`
+// bytes (every one if 0) and writes a pprof profile to `path` when main
+// returns (see runtime/heap_profile.h). Runs after the optimization pipeline,
+// so that allocations moved to the stack are not counted.
+std::unique_ptr<ModulePass> create_heap_profile_pass(std::string path, std::uint64_t rate);
+
+// With profile counts: orders the cases of constant switches hottest first and
+// lays out blocks with code_layout, cold blocks last.
+std::unique_ptr<FunctionPass> create_profile_layout_pass();
+
+// Helpers shared by the transforms.
+
+// Replaces the terminator of `b` with `br target` and drops the phi entries of
+// the successors that lose their edge from `b`.
+void replace_with_branch(Function& fn, BlockId b, BlockId target);
+// Deletes blocks not reachable from the entry. Returns true if any were removed.
+bool remove_unreachable_blocks(Function& fn);
+
+// True when `v` is computed outside the loop (arguments and constants included).
+bool is_loop_invariant(const Function& fn, const LoopInfo& loops, std::uint32_t loop, ValueId v);
+
+// A header phi that takes `start` on entry and `next = phi + step` on the back
+// edge, for a loop with a preheader and a single latch.
+struct InductionVariable {
+    ValueId phi = kNoValue;
+    ValueId start = kNoValue;
+    ValueId next = kNoValue;
+    std::int64_t step = 0;
+};
+
+std::vector<InductionVariable> find_induction_variables(const Function& fn, const LoopInfo& loops,
+                                                        std::uint32_t loop);
+
+// A loop that is only left from its header, by a conditional branch on
+// `icmp pred iv, bound` with an invariant bound. The predicate is normalized so
+// that the loop runs while `iv pred bound` holds.
+struct CountedLoop {
+    InductionVariable iv;
+    ValueId compare = kNoValue;
+    ValueId bound = kNoValue;
+    CmpPredicate pred = CmpPredicate::CMP_SLT;
+    BlockId body = kNoBlock;  // successor of the header inside the loop
+    BlockId exit = kNoBlock;
+};
+
+std::optional<CountedLoop> analyze_counted_loop(const Function& fn, const LoopInfo& loops,
+                                                std::uint32_t loop);
+
+// Number of times a counted loop enters its body, when start and bound are
+// constants and the induction variable cannot wrap before the test fails.
+std::optional<std::uint64_t> constant_trip_count(const Function& fn, const CountedLoop& counted);
+
+}  // namespace pallas::middle
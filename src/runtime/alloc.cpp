@@ -0,0 +1,41 @@
+#include "alloc.h"
+#include <algorithm>
+#include <cstdlib>
+#include "panic.h"
+
+namespace {
+
+thread_local pallas::runtime::AllocationCounters* counters = nullptr;
+
+}  // namespace
+
+void* pallas_new(std::uint64_t size) {
+    size = std::max<std::uint64_t>(size, 1);
+    void* memory = std::calloc(1, size);
+    if (memory == nullptr) {
+        pallas_alloc_fail(size);
+    }
+    pallas::runtime::note_allocation(size);
+    return memory;
+}
+
+void pallas_delete(void* memory) {
+    std::free(memory);
+}
+
+namespace pallas::runtime {
+
+AllocationCounters* count_allocations(AllocationCounters* next) {
+    AllocationCounters* previous = counters;
+    counters = next;
+    return previous;
+}
+
+void note_allocation(std::uint64_t bytes) {
+    if (counters != nullptr) {
+        counters->allocations++;
+        counters->bytes += bytes;
+    }
+}
+
+}  // namespace pallas::runtime
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+
+// Counters of the heap allocations a thread makes: `new`, string and Vec
+// buffers, and arena chunks. Code generated to be measured (palc bench) calls
+// pallas_new and pallas_delete for `new` and `delete`; other code calls calloc
+// and free directly, which the optimizer knows more about.
+
+extern "C" {
+
+// `size` zeroed bytes; never a null pointer, even for zero bytes. Stops the
+// program when the system is out of memory.
+void* pallas_new(std::uint64_t size);
+void pallas_delete(void* memory);
+
+}  // extern "C"
+
+namespace pallas::runtime {
+
+struct AllocationCounters {
+    std::uint64_t allocations = 0;
+    std::uint64_t bytes = 0;
+};
+
+// Counts the heap allocations of the calling thread into `counters` from now
+// on, or stops counting when it is null. Returns the previous counters.
+AllocationCounters* count_allocations(AllocationCounters* counters);
+
+// Called by the runtime for every heap allocation it makes, resizes included.
+void note_allocation(std::uint64_t bytes);
+
+}  // namespace pallas::runtime
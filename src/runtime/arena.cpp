@@ -0,0 +1,112 @@
+#include "arena.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include "alloc.h"
+#include "heap_profile.h"
+
+using pallas::runtime::chunk_data;
+using pallas::runtime::kArenaAlignment;
+using pallas::runtime::kArenaMinChunk;
+
+namespace {
+
+std::uint64_t round_up(std::uint64_t value, std::uint64_t align) {
+    return (value + align - 1) & ~(align - 1);
+}
+
+PallasArenaChunk* new_chunk(const PallasArena* arena, std::uint64_t size) {
+    void* memory = std::malloc(sizeof(PallasArenaChunk) + size);
+    if (memory == nullptr) {
+        return nullptr;
+    }
+    pallas::runtime::note_allocation(sizeof(PallasArenaChunk) + size);
+    pallas::runtime::profile_arena_chunk(arena, sizeof(PallasArenaChunk) + size);
+    auto* chunk = static_cast<PallasArenaChunk*>(memory);
+    chunk->next = nullptr;
+    chunk->size = size;
+    return chunk;
+}
+
+void enter(PallasArena* arena, PallasArenaChunk* chunk) {
+    arena->current = chunk;
+    arena->cursor = chunk_data(chunk);
+    arena->limit = chunk_data(chunk) + chunk->size;
+}
+
+// Bump allocation within the current chunk, nullptr if it does not fit.
+std::byte* bump(PallasArena* arena, std::uint64_t size, std::uint64_t align) {
+    auto start = reinterpret_cast<std::uintptr_t>(arena->cursor);
+    std::uintptr_t aligned = round_up(start, align);
+    auto limit = reinterpret_cast<std::uintptr_t>(arena->limit);
+    if (aligned > limit || limit - aligned < size) {
+        return nullptr;
+    }
+    auto* result = reinterpret_cast<std::byte*>(aligned);
+    arena->cursor = reinterpret_cast<std::byte*>(round_up(aligned + size, kArenaAlignment));
+    return result;
+}
+
+}  // namespace
+
+extern "C" {
+
+void pallas_arena_init(PallasArena* arena, std::uint64_t capacity) {
+    std::uint64_t size = round_up(std::max(capacity, kArenaMinChunk), kArenaAlignment);
+    *arena = {};
+    arena->first = new_chunk(arena, size);
+    if (arena->first != nullptr) {
+        enter(arena, arena->first);
+    }
+}
+
+void* pallas_arena_alloc(PallasArena* arena, std::uint64_t size, std::uint64_t align) {
+    align = std::max(align, kArenaAlignment);
+    std::byte* result = arena->current != nullptr ? bump(arena, size, align) : nullptr;
+    while (result == nullptr) {
+        PallasArenaChunk* spare = arena->current != nullptr ? arena->current->next : nullptr;
+        if (spare == nullptr || spare->size < size + align) {
+            std::uint64_t last = arena->current != nullptr ? arena->current->size : 0;
+            std::uint64_t grown = std::max({last * 2, size + align, kArenaMinChunk});
+            PallasArenaChunk* chunk = new_chunk(arena, round_up(grown, kArenaAlignment));
+            if (chunk == nullptr) {
+                return nullptr;
+            }
+            chunk->next = spare;  // spares that are too small stay for later
+            if (arena->current != nullptr) {
+                arena->current->next = chunk;
+            } else {
+                arena->first = chunk;
+            }
+            spare = chunk;
+        }
+        enter(arena, spare);
+        result = bump(arena, size, align);
+    }
+    std::memset(result, 0, size);
+    return result;
+}
+
+void pallas_arena_free_all(PallasArena* arena) {
+    pallas::runtime::profile_arena_reset(arena);
+    arena->finalizers = nullptr;
+    if (arena->first != nullptr) {
+        enter(arena, arena->first);
+    }
+}
+
+void pallas_arena_release(PallasArena* arena) {
+    pallas::runtime::profile_arena_release(arena);
+    for (PallasArenaChunk* chunk = arena->first; chunk != nullptr;) {
+        PallasArenaChunk* next = chunk->next;
+        std::free(chunk);
+        chunk = next;
+    }
+    arena->cursor = nullptr;
+    arena->limit = nullptr;
+    arena->first = nullptr;
+    arena->current = nullptr;
+    arena->finalizers = nullptr;
+}
+
+}  // extern "C"
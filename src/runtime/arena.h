@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Runtime support for `arena` blocks and the `Arena` type. Compiled code owns
+// the PallasArena header (a stack slot or an `Arena` variable) and allocates
+// from it inline: it bumps `cursor` and only calls pallas_arena_alloc when the
+// request does not fit before `limit`. The functions use the C ABI so that
+// generated code can call them by name.
+
+extern "C" {
+
+// A block of arena memory; the usable bytes follow the header.
+struct PallasArenaChunk {
+    PallasArenaChunk* next;
+    std::uint64_t size;  // usable bytes
+};
+
+// Field offsets are part of the ABI: compiled code reads and writes
+// `cursor`, `limit` and `finalizers` directly.
+struct PallasArena {
+    std::byte* cursor;          // next free byte in `current`
+    std::byte* limit;           // end of `current`
+    PallasArenaChunk* first;    // oldest chunk; kept by free_all
+    PallasArenaChunk* current;  // chunk being filled; later chunks are spare
+    void* finalizers;           // objects with destructors, newest first
+};
+
+// Prepares an empty arena whose first chunk holds at least `capacity` bytes.
+void pallas_arena_init(PallasArena* arena, std::uint64_t capacity);
+// Slow path: `size` zeroed bytes aligned to `align` (a power of two), moving
+// to a spare chunk or a new one, at least twice the size of the last, when the
+// current chunk is full. Returns nullptr when the system is out of memory.
+void* pallas_arena_alloc(PallasArena* arena, std::uint64_t size, std::uint64_t align);
+// Makes all memory available again without returning chunks to the system.
+// O(1): the cursor goes back to the start of the first chunk.
+void pallas_arena_free_all(PallasArena* arena);
+// Returns every chunk to the system; the arena is empty afterwards.
+void pallas_arena_release(PallasArena* arena);
+
+}  // extern "C"
+
+namespace pallas::runtime {
+
+constexpr std::uint64_t kArenaMinChunk = 256;
+constexpr std::uint64_t kArenaDefaultCapacity = 4096;
+// The inline fast path keeps the cursor at this alignment.
+constexpr std::uint64_t kArenaAlignment = 8;
+constexpr std::uint64_t kArenaCursorOffset = offsetof(PallasArena, cursor);
+constexpr std::uint64_t kArenaLimitOffset = offsetof(PallasArena, limit);
+constexpr std::uint64_t kArenaFinalizersOffset = offsetof(PallasArena, finalizers);
+
+inline std::byte* chunk_data(PallasArenaChunk* chunk) {
+    return reinterpret_cast<std::byte*>(chunk + 1);
+}
+
+}  // namespace pallas::runtime
@@ -0,0 +1,24 @@
+#include "bench.h"
+
+// The empty statements tell the compiler the value may have been changed and
+// memory read or written, in case these are ever inlined.
+
+std::uint64_t pallas_black_box_u64(std::uint64_t value) {
+    asm volatile("" : "+r"(value) : : "memory");
+    return value;
+}
+
+double pallas_black_box_f64(double value) {
+    asm volatile("" : "+m"(value) : : "memory");
+    return value;
+}
+
+float pallas_black_box_f32(float value) {
+    asm volatile("" : "+m"(value) : : "memory");
+    return value;
+}
+
+void* pallas_black_box_ptr(void* value) {
+    asm volatile("" : "+r"(value) : : "memory");
+    return value;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+
+// Runtime support for benchmarks: `black_box(x)` returns x, but the optimizer
+// cannot see that, so it can neither compute the value ahead of time nor drop
+// the code that produced it. The LLVM backend emits an empty inline assembly
+// statement instead of calling these; they are there for the other backends.
+// Integers narrower than 64 bits are widened for the call.
+
+extern "C" {
+
+std::uint64_t pallas_black_box_u64(std::uint64_t value);
+double pallas_black_box_f64(double value);
+float pallas_black_box_f32(float value);
+void* pallas_black_box_ptr(void* value);
+
+}  // extern "C"
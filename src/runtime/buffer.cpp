@@ -0,0 +1,60 @@
+#include "buffer.h"
+#include <cstdlib>
+#include <cstring>
+#include "alloc.h"
+#include "heap_profile.h"
+#include "panic.h"
+
+namespace pallas::runtime {
+
+void* allocate_buffer(PallasArena* arena, std::uint64_t bytes) {
+    std::uint64_t size = sizeof(BufferHeader) + bytes;
+    void* memory = arena != nullptr ? pallas_arena_alloc(arena, size, alignof(BufferHeader))
+                                    : std::malloc(size);
+    if (memory == nullptr) {
+        pallas_alloc_fail(size);
+    }
+    if (arena == nullptr) {
+        note_allocation(size);
+        profile_buffer_allocation(memory, size);
+    }
+    auto* header = static_cast<BufferHeader*>(memory);
+    header->source = arena != nullptr ? reinterpret_cast<std::uintptr_t>(arena) : kBufferHeap;
+    header->bytes = bytes;
+    return header + 1;
+}
+
+void* grow_buffer(void* data, std::uint64_t used, std::uint64_t bytes, PallasArena* arena) {
+    if (data == nullptr) {
+        return allocate_buffer(arena, bytes);
+    }
+    BufferHeader* header = buffer_header(data);
+    if (header->source == kBufferHeap) {
+        // realloc may extend in place; otherwise it moves the bytes for us.
+        profile_free(header);
+        void* memory = std::realloc(header, sizeof(BufferHeader) + bytes);
+        if (memory == nullptr) {
+            pallas_alloc_fail(sizeof(BufferHeader) + bytes);
+        }
+        note_allocation(sizeof(BufferHeader) + bytes);
+        profile_buffer_allocation(memory, sizeof(BufferHeader) + bytes);
+        header = static_cast<BufferHeader*>(memory);
+        header->bytes = bytes;
+        return header + 1;
+    }
+    if (header->source != kBufferInline) {
+        arena = reinterpret_cast<PallasArena*>(header->source);
+    }
+    void* grown = allocate_buffer(arena, bytes);
+    std::memcpy(grown, data, used);
+    return grown;
+}
+
+void free_buffer(void* data) {
+    if (data != nullptr && buffer_header(data)->source == kBufferHeap) {
+        profile_free(buffer_header(data));
+        std::free(buffer_header(data));
+    }
+}
+
+}  // namespace pallas::runtime
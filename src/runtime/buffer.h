@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include "arena.h"
+
+// Out-of-line storage of strings and Vecs. A header in front of the bytes
+// records where they came from, so that a buffer grows in the same place it
+// was allocated and only heap buffers are ever freed: arena buffers go away
+// with their arena, and inline buffers are storage the compiled code provided
+// (a stack slot).
+
+namespace pallas::runtime {
+
+constexpr std::uintptr_t kBufferHeap = 0;
+constexpr std::uintptr_t kBufferInline = 1;  // any other source is a PallasArena*
+
+struct BufferHeader {
+    std::uintptr_t source;
+    std::uint64_t bytes;  // usable bytes after the header
+};
+static_assert(sizeof(BufferHeader) == 16, "buffers stay 16-byte aligned");
+
+inline BufferHeader* buffer_header(void* data) {
+    return static_cast<BufferHeader*>(data) - 1;
+}
+
+// `bytes` usable bytes from `arena`, or from the heap if it is null. Panics
+// when out of memory.
+void* allocate_buffer(PallasArena* arena, std::uint64_t bytes);
+// Grows the buffer at `data` (which may be null) to `bytes`, keeping the first
+// `used` bytes; elements are relocated with a plain byte copy. A buffer with
+// nowhere to grow in place (inline storage) moves to `arena`, or the heap.
+void* grow_buffer(void* data, std::uint64_t used, std::uint64_t bytes, PallasArena* arena);
+// Frees a heap buffer; does nothing for other sources or null.
+void free_buffer(void* data);
+
+}  // namespace pallas::runtime
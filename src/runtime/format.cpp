@@ -0,0 +1,114 @@
+#include "format.h"
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+constexpr std::size_t kOutputBufferBytes = 1 << 14;
+
+struct Output {
+    std::vector<char> buffer = std::vector<char>(kOutputBufferBytes);
+    std::size_t used = 0;
+    std::string* capture = nullptr;
+    bool flush_at_exit = false;
+};
+
+Output& output() {
+    static Output state;
+    return state;
+}
+
+}  // namespace
+
+char* pallas_format_i64(char* out, std::int64_t value) {
+    return std::to_chars(out, out + pallas::runtime::kMaxIntegerChars, value).ptr;
+}
+
+char* pallas_format_u64(char* out, std::uint64_t value) {
+    return std::to_chars(out, out + pallas::runtime::kMaxIntegerChars, value).ptr;
+}
+
+char* pallas_format_u128(char* out, std::uint64_t low, std::uint64_t high) {
+    // std::to_chars has no 128-bit overload: write the digits backwards.
+    unsigned __int128 value = (static_cast<unsigned __int128>(high) << 64) | low;
+    char digits[pallas::runtime::kMaxInt128Chars];
+    char* begin = digits + sizeof(digits);
+    do {
+        *--begin = static_cast<char>('0' + static_cast<int>(value % 10));
+        value /= 10;
+    } while (value != 0);
+    std::size_t length = static_cast<std::size_t>(digits + sizeof(digits) - begin);
+    std::memcpy(out, begin, length);
+    return out + length;
+}
+
+char* pallas_format_i128(char* out, std::uint64_t low, std::uint64_t high) {
+    if (static_cast<std::int64_t>(high) >= 0) {
+        return pallas_format_u128(out, low, high);
+    }
+    // Negate in two's complement; the minimum value maps onto itself as unsigned.
+    unsigned __int128 value = (static_cast<unsigned __int128>(high) << 64) | low;
+    value = ~value + 1;
+    *out = '-';
+    return pallas_format_u128(out + 1, static_cast<std::uint64_t>(value),
+                              static_cast<std::uint64_t>(value >> 64));
+}
+
+char* pallas_format_f64(char* out, double value) {
+    return std::to_chars(out, out + pallas::runtime::kMaxFloatChars, value).ptr;
+}
+
+char* pallas_format_f32(char* out, float value) {
+    return std::to_chars(out, out + pallas::runtime::kMaxFloatChars, value).ptr;
+}
+
+char* pallas_format_string(char* out, const char* text, std::uint64_t length) {
+    std::memcpy(out, text, length);
+    return out + length;
+}
+
+char* pallas_output_reserve(std::uint64_t count) {
+    Output& state = output();
+    if (!state.flush_at_exit) {
+        std::atexit(pallas::runtime::flush_output);
+        state.flush_at_exit = true;
+    }
+    if (state.used + count > state.buffer.size()) {
+        pallas::runtime::flush_output();
+        if (count > state.buffer.size()) {
+            state.buffer.resize(count);
+        }
+    }
+    return state.buffer.data() + state.used;
+}
+
+void pallas_output_commit(char* end) {
+    Output& state = output();
+    state.used = static_cast<std::size_t>(end - state.buffer.data());
+}
+
+namespace pallas::runtime {
+
+void flush_output() {
+    Output& state = output();
+    if (state.used == 0) {
+        return;
+    }
+    if (state.capture != nullptr) {
+        state.capture->append(state.buffer.data(), state.used);
+    } else {
+        std::fwrite(state.buffer.data(), 1, state.used, stdout);
+        std::fflush(stdout);
+    }
+    state.used = 0;
+}
+
+void set_output_capture(std::string* capture) {
+    flush_output();
+    output().capture = capture;
+}
+
+}  // namespace pallas::runtime
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Runtime support for string interpolation and print/println. Compiled code
+// sizes the text before writing any of it: literal fragments by their length,
+// strings by theirs, and formatted numbers by the most characters their type
+// can take (below). It then makes a single allocation, or reserves the bytes
+// in the output buffer, and writes the pieces in place. The pallas_format_*
+// functions return the end of what they wrote.
+
+extern "C" {
+
+char* pallas_format_i64(char* out, std::int64_t value);
+char* pallas_format_u64(char* out, std::uint64_t value);
+// 128-bit integers, passed as their lower and upper 64 bits.
+char* pallas_format_i128(char* out, std::uint64_t low, std::uint64_t high);
+char* pallas_format_u128(char* out, std::uint64_t low, std::uint64_t high);
+// Shortest text that reads back as the same value.
+char* pallas_format_f64(char* out, double value);
+char* pallas_format_f32(char* out, float value);
+// Copies `length` bytes of `text`.
+char* pallas_format_string(char* out, const char* text, std::uint64_t length);
+
+// Space for `count` bytes of output, in a buffer written to stdout when it
+// fills up and when the program exits. The reservation ends with
+// pallas_output_commit(end), which outputs the bytes written before `end`.
+char* pallas_output_reserve(std::uint64_t count);
+void pallas_output_commit(char* end);
+
+}  // extern "C"
+
+namespace pallas::runtime {
+
+constexpr std::uint64_t kMaxIntegerChars = 20;  // "-9223372036854775808"
+constexpr std::uint64_t kMaxInt128Chars = 40;  // "-170141183460469231731687303715884105728"
+constexpr std::uint64_t kMaxFloatChars = 24;    // "-2.2250738585072014e-308"
+
+// Writes out the output buffer.
+void flush_output();
+// Sends output to `capture` instead of stdout (nullptr: back to stdout), for
+// hosts that run compiled code in process. Flushes first. Not thread-safe.
+void set_output_capture(std::string* capture);
+
+}  // namespace pallas::runtime
@@ -0,0 +1,520 @@
+#include "heap_profile.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "alloc.h"
+#include "panic.h"
+
+using pallas::runtime::HeapSiteKind;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Site {
+    std::string function;
+    std::uint32_t line = 0;
+    HeapSiteKind kind = HeapSiteKind::NEW;
+    // Estimated from the samples; exact for arenas.
+    double alloc_objects = 0;
+    double alloc_bytes = 0;
+    double inuse_objects = 0;
+    double inuse_bytes = 0;
+    std::uint64_t freed = 0;  // sampled allocations (or arenas) freed
+    double lifetime_ns = 0;   // their lifetimes added up
+    std::uint64_t high_water = 0;
+    std::uint64_t peak_used = 0;
+};
+
+struct Sample {
+    std::uint32_t site = 0;
+    std::uint64_t size = 0;
+    double weight = 0;
+    Clock::time_point at;
+};
+
+struct TrackedArena {
+    std::uint32_t site = 0;
+    std::uint64_t chunks = 0;
+    std::uint64_t reserved = 0;  // bytes of its chunks
+    Clock::time_point created;
+};
+
+struct Profile {
+    std::mutex mutex;
+    std::string path;
+    std::uint64_t rate = 0;
+    std::vector<Site> sites;  // the last is the buffer site
+    std::unordered_map<const void*, Sample> live;
+    std::unordered_map<const PallasArena*, TrackedArena> arenas;
+    std::chrono::system_clock::time_point started;
+    Clock::time_point started_steady;
+    Clock::time_point stopped;
+};
+
+std::atomic<bool> active{false};
+std::atomic<std::uint64_t> sample_rate{0};
+std::atomic<std::uint32_t> buffer_site{0};
+Profile profile;
+
+// Sampled allocations that are live, counted by a hash of their address, so
+// that most frees do not take the lock.
+std::array<std::atomic<std::uint32_t>, 4096> live_filter;
+
+std::size_t filter_slot(const void* memory) {
+    auto bits = static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(memory));
+    return static_cast<std::size_t>(((bits >> 4) * 0x9e3779b97f4a7c15ull) >> 52);
+}
+
+// Per thread: bytes left until the next sample, and the random state the
+// distances are drawn from.
+struct Sampler {
+    std::int64_t until = 0;
+    bool started = false;
+    std::uint64_t state = 0;
+
+    // Exponentially distributed with mean `rate`.
+    std::int64_t next_gap(std::uint64_t rate) {
+        if (state == 0) {
+            auto seed = reinterpret_cast<std::uintptr_t>(this) ^
+                        static_cast<std::uint64_t>(Clock::now().time_since_epoch().count());
+            state = seed | 1;
+        }
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        std::uint64_t bits = (state * 0x2545f4914f6cdd1dull) >> 11;
+        double uniform = (static_cast<double>(bits) + 1.0) / 9007199254740992.0;  // (0, 1]
+        double gap = -std::log(uniform) * static_cast<double>(rate);
+        return static_cast<std::int64_t>(std::min(gap, 1e15)) + 1;
+    }
+};
+
+thread_local Sampler sampler;
+
+void record(void* memory, std::uint64_t size, std::uint32_t site, std::uint64_t rate) {
+    double weight = 1.0;
+    if (rate != 0) {
+        weight = 1.0 / -std::expm1(-static_cast<double>(size) / static_cast<double>(rate));
+    }
+    std::lock_guard<std::mutex> lock(profile.mutex);
+    if (!active.load(std::memory_order_relaxed) || site >= profile.sites.size()) {
+        return;
+    }
+    Site& s = profile.sites[site];
+    s.alloc_objects += weight;
+    s.alloc_bytes += weight * static_cast<double>(size);
+    s.inuse_objects += weight;
+    s.inuse_bytes += weight * static_cast<double>(size);
+    auto [entry, added] = profile.live.insert_or_assign(memory, Sample{site, size, weight,
+                                                                         Clock::now()});
+    if (added) {
+        live_filter[filter_slot(memory)].fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+// The sampling decision: the fast path is the subtraction and the compare.
+void note(void* memory, std::uint64_t size, std::uint32_t site) {
+    if (!active.load(std::memory_order_relaxed)) {
+        return;
+    }
+    std::uint64_t rate = sample_rate.load(std::memory_order_relaxed);
+    sampler.until -= static_cast<std::int64_t>(size);
+    if (sampler.until > 0) {
+        return;
+    }
+    if (rate != 0 && !sampler.started) {
+        // The count starts at the thread's first allocation.
+        sampler.started = true;
+        sampler.until = sampler.next_gap(rate) - static_cast<std::int64_t>(size);
+        if (sampler.until > 0) {
+            return;
+        }
+    }
+    sampler.until = rate != 0 ? sampler.next_gap(rate) : 0;
+    record(memory, size, site, rate);
+}
+
+double elapsed_ns(Clock::time_point from, Clock::time_point to) {
+    return static_cast<double>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count());
+}
+
+// Bytes handed out by `arena`: its chunks before the current one, and the
+// current one up to the cursor.
+std::uint64_t arena_used(const PallasArena* arena) {
+    std::uint64_t used = 0;
+    for (PallasArenaChunk* chunk = arena->first; chunk != nullptr; chunk = chunk->next) {
+        if (chunk == arena->current) {
+            used += static_cast<std::uint64_t>(arena->cursor -
+                                               pallas::runtime::chunk_data(chunk));
+            break;
+        }
+        used += chunk->size;
+    }
+    return used;
+}
+
+// Minimal protocol buffer encoding: varints and length-delimited fields.
+class ProtoWriter {
+  public:
+    void field(int number, std::uint64_t value) {
+        if (value != 0) {
+            varint(static_cast<std::uint64_t>(number) << 3);
+            varint(value);
+        }
+    }
+    void field(int number, const std::string& bytes) {
+        varint(static_cast<std::uint64_t>(number) << 3 | 2);
+        varint(bytes.size());
+        out += bytes;
+    }
+    void packed(int number, const std::vector<std::uint64_t>& values) {
+        ProtoWriter list;
+        for (std::uint64_t value : values) {
+            list.varint(value);
+        }
+        field(number, list.bytes());
+    }
+    const std::string& bytes() const { return out; }
+
+  private:
+    void varint(std::uint64_t value) {
+        while (value >= 0x80) {
+            out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<char>(value));
+    }
+
+    std::string out;
+};
+
+class StringTable {
+  public:
+    StringTable() { index(""); }
+
+    std::uint64_t index(const std::string& text) {
+        auto [entry, added] = indices.emplace(text, strings.size());
+        if (added) {
+            strings.push_back(text);
+        }
+        return entry->second;
+    }
+    const std::vector<std::string>& all() const { return strings; }
+
+  private:
+    std::unordered_map<std::string, std::uint64_t> indices;
+    std::vector<std::string> strings;
+};
+
+std::uint64_t rounded(double value) {
+    return value <= 0 ? 0 : static_cast<std::uint64_t>(std::llround(value));
+}
+
+// profile.proto, with one location (and one sample) per site.
+std::string encode_locked() {
+    StringTable strings;
+    ProtoWriter out;
+    auto value_type = [&](const char* type, const char* unit) {
+        ProtoWriter message;
+        message.field(1, strings.index(type));
+        message.field(2, strings.index(unit));
+        return message.bytes();
+    };
+    out.field(1, value_type("alloc_objects", "count"));
+    out.field(1, value_type("alloc_space", "bytes"));
+    out.field(1, value_type("inuse_objects", "count"));
+    out.field(1, value_type("inuse_space", "bytes"));
+
+    const char* kind_names[] = {"new", "arena", "buffer"};
+    std::unordered_map<std::string, std::uint64_t> function_ids;
+    ProtoWriter functions;
+    ProtoWriter locations;
+    for (std::size_t i = 0; i < profile.sites.size(); ++i) {
+        const Site& site = profile.sites[i];
+        if (site.alloc_objects <= 0) {
+            continue;
+        }
+        auto [function, added] = function_ids.emplace(site.function, function_ids.size() + 1);
+        if (added) {
+            ProtoWriter message;
+            message.field(1, function->second);
+            message.field(2, strings.index(site.function));
+            message.field(3, strings.index(site.function));
+            functions.field(5, message.bytes());
+        }
+        ProtoWriter line;
+        line.field(1, function->second);
+        line.field(2, site.line);
+        ProtoWriter location;
+        location.field(1, i + 1);
+        location.field(4, line.bytes());
+        locations.field(4, location.bytes());
+
+        ProtoWriter sample;
+        sample.packed(1, {i + 1});
+        sample.packed(2, {rounded(site.alloc_objects), rounded(site.alloc_bytes),
+                          rounded(site.inuse_objects), rounded(site.inuse_bytes)});
+        auto label = [&](const char* key, const std::string* text, std::uint64_t number,
+                         const char* unit) {
+            ProtoWriter message;
+            message.field(1, strings.index(key));
+            if (text != nullptr) {
+                message.field(2, strings.index(*text));
+            } else {
+                message.field(3, number);
+                message.field(4, strings.index(unit));
+            }
+            sample.field(3, message.bytes());
+        };
+        std::string kind = kind_names[static_cast<int>(site.kind)];
+        label("kind", &kind, 0, nullptr);
+        if (site.freed != 0) {
+            label("lifetime", nullptr, rounded(site.lifetime_ns / site.freed), "nanoseconds");
+        }
+        if (site.kind == HeapSiteKind::ARENA) {
+            label("high_water", nullptr, site.high_water, "bytes");
+            label("peak_used", nullptr, site.peak_used, "bytes");
+        }
+        out.field(2, sample.bytes());
+    }
+    std::string result = out.bytes() + locations.bytes() + functions.bytes();
+    ProtoWriter tail;
+    std::uint64_t period_type_index = strings.index("space");
+    std::uint64_t bytes_index = strings.index("bytes");
+    std::uint64_t default_type = strings.index("inuse_space");
+    for (const std::string& text : strings.all()) {
+        tail.field(6, text);
+    }
+    auto since_epoch = profile.started.time_since_epoch();
+    tail.field(9, static_cast<std::uint64_t>(
+                      std::chrono::duration_cast<std::chrono::nanoseconds>(since_epoch).count()));
+    Clock::time_point end = active.load(std::memory_order_relaxed) ? Clock::now()
+                                                                   : profile.stopped;
+    tail.field(10, rounded(elapsed_ns(profile.started_steady, end)));
+    ProtoWriter period_type;
+    period_type.field(1, period_type_index);
+    period_type.field(2, bytes_index);
+    tail.field(11, period_type.bytes());
+    tail.field(12, profile.rate);
+    tail.field(14, default_type);
+    return result + tail.bytes();
+}
+
+void stop_at_exit() {
+    pallas_heap_profile_stop();
+}
+
+std::uint32_t read_u32(const std::uint8_t* bytes) {
+    std::uint32_t value = 0;
+    for (int i = 0; i < 4; ++i) {
+        value |= static_cast<std::uint32_t>(bytes[i]) << (8 * i);
+    }
+    return value;
+}
+
+}  // namespace
+
+extern "C" {
+
+void pallas_heap_profile_start(const char* path, const std::uint8_t* descriptor,
+                               std::uint64_t descriptor_size, std::uint64_t rate) {
+    pallas_heap_profile_stop();  // one left running by an earlier run in this process
+    static std::once_flag registered;
+    std::call_once(registered, [] { std::atexit(stop_at_exit); });
+
+    std::lock_guard<std::mutex> lock(profile.mutex);
+    profile.path = path;
+    profile.rate = rate;
+    profile.sites.clear();
+    profile.live.clear();
+    profile.arenas.clear();
+    for (auto& count : live_filter) {
+        count.store(0, std::memory_order_relaxed);
+    }
+    std::uint64_t at = 4;
+    std::uint32_t count = descriptor_size >= 4 ? read_u32(descriptor) : 0;
+    for (std::uint32_t i = 0; i < count && at + 9 <= descriptor_size; ++i) {
+        Site site;
+        site.line = read_u32(descriptor + at);
+        site.kind = static_cast<HeapSiteKind>(descriptor[at + 4]);
+        std::uint32_t length = read_u32(descriptor + at + 5);
+        at += 9;
+        if (at + length > descriptor_size) {
+            break;
+        }
+        site.function.assign(reinterpret_cast<const char*>(descriptor + at), length);
+        at += length;
+        profile.sites.push_back(std::move(site));
+    }
+    Site buffers;
+    buffers.function = "string and Vec buffers";
+    buffers.kind = HeapSiteKind::BUFFER;
+    profile.sites.push_back(std::move(buffers));
+    buffer_site.store(static_cast<std::uint32_t>(profile.sites.size() - 1),
+                      std::memory_order_relaxed);
+    profile.started = std::chrono::system_clock::now();
+    profile.started_steady = Clock::now();
+    sample_rate.store(rate, std::memory_order_relaxed);
+    active.store(true, std::memory_order_release);
+}
+
+void pallas_heap_profile_stop() {
+    std::lock_guard<std::mutex> lock(profile.mutex);
+    if (!active.load(std::memory_order_relaxed)) {
+        return;
+    }
+    active.store(false, std::memory_order_relaxed);
+    profile.stopped = Clock::now();
+    std::string bytes = encode_locked();
+    std::FILE* out = std::fopen(profile.path.c_str(), "wb");
+    bool ok = out != nullptr && std::fwrite(bytes.data(), 1, bytes.size(), out) == bytes.size();
+    if (out != nullptr) {
+        ok &= std::fclose(out) == 0;
+    }
+    if (!ok) {
+        std::fprintf(stderr, "pallas: cannot write heap profile '%s'\n", profile.path.c_str());
+    }
+}
+
+void* pallas_heap_new(std::uint64_t size, std::uint32_t site) {
+    size = std::max<std::uint64_t>(size, 1);
+    void* memory = std::calloc(1, size);
+    if (memory == nullptr) {
+        pallas_alloc_fail(size);
+    }
+    pallas::runtime::note_allocation(size);
+    note(memory, size, site);
+    return memory;
+}
+
+void pallas_heap_delete(void* memory) {
+    pallas::runtime::profile_free(memory);
+    std::free(memory);
+}
+
+void pallas_heap_arena_init(PallasArena* arena, std::uint64_t capacity, std::uint32_t site) {
+    if (active.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(profile.mutex);
+        if (site < profile.sites.size()) {
+            profile.arenas[arena] = {site, 0, 0, Clock::now()};
+        }
+    }
+    pallas_arena_init(arena, capacity);
+}
+
+void* pallas_heap_arena_alloc(PallasArena* arena, std::uint64_t size, std::uint64_t align,
+                              std::uint32_t site) {
+    void* memory = pallas_arena_alloc(arena, size, align);
+    if (active.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(profile.mutex);
+        if (site < profile.sites.size()) {
+            profile.sites[site].alloc_objects += 1;
+            profile.sites[site].alloc_bytes += static_cast<double>(size);
+        }
+    }
+    return memory;
+}
+
+}  // extern "C"
+
+namespace pallas::runtime {
+
+bool heap_profile_active() {
+    return active.load(std::memory_order_relaxed);
+}
+
+void profile_buffer_allocation(void* memory, std::uint64_t size) {
+    if (active.load(std::memory_order_relaxed)) {
+        note(memory, size, buffer_site.load(std::memory_order_relaxed));
+    }
+}
+
+void profile_free(void* memory) {
+    if (memory == nullptr || !active.load(std::memory_order_relaxed)) {
+        return;
+    }
+    std::atomic<std::uint32_t>& slot = live_filter[filter_slot(memory)];
+    if (slot.load(std::memory_order_relaxed) == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(profile.mutex);
+    auto found = profile.live.find(memory);
+    if (found == profile.live.end()) {
+        return;
+    }
+    const Sample& sample = found->second;
+    Site& site = profile.sites[sample.site];
+    site.inuse_objects -= sample.weight;
+    site.inuse_bytes -= sample.weight * static_cast<double>(sample.size);
+    site.freed++;
+    site.lifetime_ns += elapsed_ns(sample.at, Clock::now());
+    profile.live.erase(found);
+    slot.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void profile_arena_chunk(const PallasArena* arena, std::uint64_t bytes) {
+    if (!active.load(std::memory_order_relaxed)) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(profile.mutex);
+    auto found = profile.arenas.find(arena);
+    if (found == profile.arenas.end()) {
+        return;
+    }
+    TrackedArena& tracked = found->second;
+    tracked.chunks++;
+    tracked.reserved += bytes;
+    Site& site = profile.sites[tracked.site];
+    site.alloc_objects += 1;
+    site.alloc_bytes += static_cast<double>(bytes);
+    site.inuse_objects += 1;
+    site.inuse_bytes += static_cast<double>(bytes);
+    site.high_water = std::max(site.high_water, tracked.reserved);
+}
+
+void profile_arena_reset(const PallasArena* arena) {
+    if (!active.load(std::memory_order_relaxed)) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(profile.mutex);
+    auto found = profile.arenas.find(arena);
+    if (found != profile.arenas.end()) {
+        Site& site = profile.sites[found->second.site];
+        site.peak_used = std::max(site.peak_used, arena_used(arena));
+    }
+}
+
+void profile_arena_release(const PallasArena* arena) {
+    if (!active.load(std::memory_order_relaxed)) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(profile.mutex);
+    auto found = profile.arenas.find(arena);
+    if (found == profile.arenas.end()) {
+        return;
+    }
+    const TrackedArena& tracked = found->second;
+    Site& site = profile.sites[tracked.site];
+    site.peak_used = std::max(site.peak_used, arena_used(arena));
+    site.inuse_objects -= static_cast<double>(tracked.chunks);
+    site.inuse_bytes -= static_cast<double>(tracked.reserved);
+    site.freed++;
+    site.lifetime_ns += elapsed_ns(tracked.created, Clock::now());
+    profile.arenas.erase(found);
+}
+
+std::string encode_heap_profile() {
+    std::lock_guard<std::mutex> lock(profile.mutex);
+    return encode_locked();
+}
+
+}  // namespace pallas::runtime
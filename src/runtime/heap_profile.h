@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include "arena.h"
+
+// Runtime support for heap-profiled programs (palc -fheap-profile). The
+// compiler numbers the allocation sites of the program: every `new` that is
+// still a heap allocation after optimization, and every arena. `new` and
+// `delete` call pallas_heap_new and pallas_heap_delete, and arenas are set up
+// by pallas_heap_arena_init. Buffers of strings and Vecs, which the runtime
+// allocates, count as one more site.
+//
+// `new` in an arena bumps the arena's cursor inline and only calls the runtime
+// when the current chunk is full or the object is large; those calls go to
+// pallas_heap_arena_alloc and are charged to the `new`'s site, exactly and as
+// allocated but not in use (the memory is the arena's). Allocations served
+// inline are not seen: an arena `new` site counts its refills, and the arena's
+// own site the chunks behind all of them.
+//
+// Heap allocations are sampled the way tcmalloc and Go's runtime do it: one
+// is recorded whenever about `rate` bytes have been allocated since the last,
+// the distance drawn from an exponential distribution so that allocations of
+// every size have a fair chance. A recorded allocation of `size` bytes stands
+// for 1 / (1 - exp(-size / rate)) allocations like it. Allocations that are
+// not sampled cost a subtraction and a compare; frees of memory that was not
+// sampled usually a lookup in a small filter. Arenas are few, and every chunk
+// they take from the system is recorded.
+//
+// main calls pallas_heap_profile_start on entry and pallas_heap_profile_stop
+// on return; programs that call exit write the profile from an atexit handler.
+// The profile is in pprof's format (an uncompressed profile.proto, which
+// `pprof` and `go tool pprof` read), with one sample per site:
+//
+//   alloc_objects, alloc_space  allocations made, estimated from the samples
+//   inuse_objects, inuse_space  of those, still live when the profile is written
+//
+// labelled with the site's `kind` (new, buffer or arena) and, where known,
+// `lifetime` (mean nanoseconds from allocation to free of the sampled
+// allocations that were freed, or of the arenas released), and for arenas
+// `high_water` (the most bytes any arena of the site held from the system at
+// once) and `peak_used` (the most it handed out between two resets). The
+// descriptor of the sites is
+//
+//   u32 site count
+//   per site: u32 line (0 if unknown), u8 kind, u32 name length, name bytes
+//
+// little-endian, where the name is the function the site is in.
+
+extern "C" {
+
+void pallas_heap_profile_start(const char* path, const std::uint8_t* descriptor,
+                               std::uint64_t descriptor_size, std::uint64_t rate);
+// Writes the profile and stops recording. Failures are reported on stderr; the
+// program continues.
+void pallas_heap_profile_stop();
+
+// As pallas_new and pallas_delete, for allocation site `site`.
+void* pallas_heap_new(std::uint64_t size, std::uint32_t site);
+void pallas_heap_delete(void* memory);
+// As pallas_arena_init, for the arena of site `site`.
+void pallas_heap_arena_init(PallasArena* arena, std::uint64_t capacity, std::uint32_t site);
+// As pallas_arena_alloc, for the `new` of site `site`.
+void* pallas_heap_arena_alloc(PallasArena* arena, std::uint64_t size, std::uint64_t align,
+                              std::uint32_t site);
+
+}  // extern "C"
+
+namespace pallas::runtime {
+
+// BUFFER is the runtime's own site and does not appear in descriptors.
+enum class HeapSiteKind : std::uint8_t { NEW, ARENA, BUFFER };
+
+constexpr std::uint64_t kDefaultHeapSampleRate = 512 * 1024;
+
+// True while a profile is being recorded.
+bool heap_profile_active();
+
+// Hooks for the runtime's own allocations; they do nothing unless a profile is
+// being recorded. Buffers belong to the buffer site.
+void profile_buffer_allocation(void* memory, std::uint64_t size);
+void profile_free(void* memory);
+void profile_arena_chunk(const PallasArena* arena, std::uint64_t bytes);
+// Before pallas_arena_free_all and pallas_arena_release: record how much of
+// the arena was used, and for release that its chunks are freed.
+void profile_arena_reset(const PallasArena* arena);
+void profile_arena_release(const PallasArena* arena);
+
+// The profile being recorded, or else the last one, encoded as
+// pallas_heap_profile_stop writes it.
+std::string encode_heap_profile();
+
+}  // namespace pallas::runtime
@@ -0,0 +1,56 @@
+#include "panic.h"
+#include <cstdio>
+#include <cstdlib>
+#include "format.h"
+
+namespace {
+
+thread_local pallas::runtime::PanicHandler panic_handler = nullptr;
+
+// Output printed before the panic comes out first.
+[[noreturn]] void panic(const char* message) {
+    pallas::runtime::flush_output();
+    if (panic_handler != nullptr) {
+        panic_handler(message);
+    }
+    std::fflush(stdout);
+    std::fprintf(stderr, "pallas: %s\n", message);
+    std::exit(pallas::runtime::kPanicExitCode);
+}
+
+}  // namespace
+
+// The message is formatted on the stack: a handler may unwind with longjmp,
+// which skips destructors.
+void pallas_bounds_fail(std::uint64_t index, std::uint64_t length) {
+    char message[96];
+    std::snprintf(message, sizeof(message), "index %llu out of bounds for length %llu",
+                  static_cast<unsigned long long>(index),
+                  static_cast<unsigned long long>(length));
+    panic(message);
+}
+
+void pallas_slice_fail(std::uint64_t begin, std::uint64_t end, std::uint64_t length) {
+    char message[128];
+    std::snprintf(message, sizeof(message), "slice [%llu, %llu) out of bounds for length %llu",
+                  static_cast<unsigned long long>(begin), static_cast<unsigned long long>(end),
+                  static_cast<unsigned long long>(length));
+    panic(message);
+}
+
+void pallas_alloc_fail(std::uint64_t size) {
+    char message[64];
+    std::snprintf(message, sizeof(message), "out of memory allocating %llu bytes",
+                  static_cast<unsigned long long>(size));
+    panic(message);
+}
+
+namespace pallas::runtime {
+
+PanicHandler set_panic_handler(PanicHandler handler) {
+    PanicHandler previous = panic_handler;
+    panic_handler = handler;
+    return previous;
+}
+
+}  // namespace pallas::runtime
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+
+// Runtime support for checks that stop the program. Compiled code calls the
+// C-ABI entry points by name; they report the failure and do not return.
+
+extern "C" {
+
+// A bounds check failed: `index` is not below `length`.
+[[noreturn]] void pallas_bounds_fail(std::uint64_t index, std::uint64_t length);
+// A slice [begin, end) does not lie within `length` elements.
+[[noreturn]] void pallas_slice_fail(std::uint64_t begin, std::uint64_t end, std::uint64_t length);
+// A runtime allocation of `size` bytes failed.
+[[noreturn]] void pallas_alloc_fail(std::uint64_t size);
+
+}  // extern "C"
+
+namespace pallas::runtime {
+
+// A failed check exits the process with this status, unless the thread has a
+// panic handler: hosts that run compiled code in process (the JIT) install one
+// that unwinds back to them. A handler that returns exits the process too.
+constexpr int kPanicExitCode = 101;
+using PanicHandler = void (*)(const char* message);
+// Installs `handler` for the calling thread and returns the previous one.
+PanicHandler set_panic_handler(PanicHandler handler);
+
+}  // namespace pallas::runtime
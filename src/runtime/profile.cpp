@@ -0,0 +1,33 @@
+#include "profile.h"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+void pallas_profile_write(const char* path, const std::uint8_t* descriptor,
+                          std::uint64_t descriptor_size, const std::uint64_t* counters,
+                          std::uint64_t count) {
+    std::vector<std::uint64_t> totals(counters, counters + count);
+    if (std::FILE* old = std::fopen(path, "rb")) {
+        std::vector<std::uint8_t> header(descriptor_size);
+        std::vector<std::uint64_t> previous(count);
+        bool same = std::fread(header.data(), 1, header.size(), old) == header.size() &&
+                    std::memcmp(header.data(), descriptor, descriptor_size) == 0 &&
+                    std::fread(previous.data(), sizeof(std::uint64_t), count, old) == count &&
+                    std::fgetc(old) == EOF;
+        std::fclose(old);
+        // A profile of another build is overwritten.
+        for (std::uint64_t i = 0; same && i < count; ++i) {
+            totals[i] += previous[i];
+        }
+    }
+    std::FILE* out = std::fopen(path, "wb");
+    bool ok = out != nullptr &&
+              std::fwrite(descriptor, 1, descriptor_size, out) == descriptor_size &&
+              std::fwrite(totals.data(), sizeof(std::uint64_t), count, out) == count;
+    if (out != nullptr) {
+        ok &= std::fclose(out) == 0;
+    }
+    if (!ok) {
+        std::fprintf(stderr, "pallas: cannot write profile '%s'\n", path);
+    }
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+
+// Runtime support for instrumented programs (palc -fprofile-generate). The
+// compiler lays out a descriptor of the instrumented functions and one 64-bit
+// counter array for the whole module; when main returns, the program calls
+// pallas_profile_write to save them. The file is the descriptor followed by the
+// counters, little-endian:
+//
+//   "PALPROF1"
+//   u32 function count
+//   per function: u64 hash, u32 counter count, u32 name length, name bytes
+//   u64 counters, all functions in order
+//
+// middle/profile.h reads it back.
+
+extern "C" {
+
+// Writes the profile to `path`. If the file already holds a profile with the
+// same descriptor, the counts are added to it, so that several runs
+// accumulate. Failures are reported on stderr; the program continues.
+void pallas_profile_write(const char* path, const std::uint8_t* descriptor,
+                          std::uint64_t descriptor_size, const std::uint64_t* counters,
+                          std::uint64_t count);
+
+}  // extern "C"
+
+namespace pallas::runtime {
+
+constexpr char kProfileMagic[8] = {'P', 'A', 'L', 'P', 'R', 'O', 'F', '1'};
+
+}  // namespace pallas::runtime
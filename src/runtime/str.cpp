@@ -0,0 +1,114 @@
+#include "str.h"
+#include <algorithm>
+#include <cstring>
+#include "buffer.h"
+#include "panic.h"
+
+using pallas::runtime::kStringHeapFlag;
+using pallas::runtime::kStringInlineCapacity;
+using pallas::runtime::kStringTagOffset;
+using pallas::runtime::string_is_inline;
+using pallas::runtime::string_length;
+using pallas::runtime::string_text;
+
+namespace {
+
+char* inline_text(PallasString* s) {
+    return reinterpret_cast<char*>(s);
+}
+
+void set_length(PallasString* s, std::uint64_t length) {
+    if (string_is_inline(s)) {
+        inline_text(s)[length] = '\0';
+        reinterpret_cast<std::uint8_t*>(s)[kStringTagOffset] = static_cast<std::uint8_t>(length);
+    } else {
+        s->data[length] = '\0';
+        s->length = length;
+    }
+}
+
+// Room for `capacity` bytes of text, keeping the current text.
+void reserve(PallasString* s, std::uint64_t capacity, PallasArena* arena) {
+    bool inline_form = string_is_inline(s);
+    if (capacity <= (inline_form ? kStringInlineCapacity : s->capacity & ~kStringHeapFlag)) {
+        return;
+    }
+    std::uint64_t length = string_length(s);
+    char* data = nullptr;
+    if (inline_form) {
+        data = static_cast<char*>(pallas::runtime::allocate_buffer(arena, capacity + 1));
+        std::memcpy(data, inline_text(s), length);
+    } else {
+        data = static_cast<char*>(pallas::runtime::grow_buffer(s->data, length, capacity + 1,
+                                                              arena));
+    }
+    s->data = data;
+    s->length = length;
+    s->capacity = capacity | kStringHeapFlag;
+}
+
+}  // namespace
+
+extern "C" {
+
+void pallas_string_assign(PallasString* s, const char* text, std::uint64_t length,
+                          PallasArena* arena) {
+    bool inline_form = string_is_inline(s);
+    char* current = inline_form ? inline_text(s) : s->data;
+    std::uint64_t capacity = inline_form ? kStringInlineCapacity : s->capacity & ~kStringHeapFlag;
+    if (length > capacity) {
+        // Nothing to keep: `text` cannot be inside a string shorter than itself.
+        set_length(s, 0);
+        reserve(s, length, arena);
+        current = s->data;
+    }
+    std::memmove(current, text, length);
+    set_length(s, length);
+}
+
+void pallas_string_append(PallasString* s, const char* text, std::uint64_t length,
+                          PallasArena* arena) {
+    std::uint64_t old = string_length(s);
+    std::uint64_t needed = old + length;
+    std::uint64_t capacity = string_is_inline(s) ? kStringInlineCapacity
+                                                 : s->capacity & ~kStringHeapFlag;
+    if (needed > capacity) {
+        const char* current = string_text(s);
+        std::ptrdiff_t inside = text >= current && text <= current + old ? text - current : -1;
+        reserve(s, std::max({needed, capacity * 2, pallas::runtime::kStringMinCapacity}), arena);
+        if (inside >= 0) {
+            text = string_text(s) + inside;
+        }
+    }
+    char* data = string_is_inline(s) ? inline_text(s) : s->data;
+    std::memmove(data + old, text, length);
+    set_length(s, needed);
+}
+
+char* pallas_string_prepare(PallasString* s, std::uint64_t capacity, PallasArena* arena) {
+    set_length(s, 0);
+    reserve(s, capacity, arena);
+    return string_is_inline(s) ? inline_text(s) : s->data;
+}
+
+void pallas_string_commit(PallasString* s, char* end) {
+    set_length(s, static_cast<std::uint64_t>(end - string_text(s)));
+}
+
+void pallas_string_slice(PallasString* out, const PallasString* s, std::uint64_t begin,
+                         std::uint64_t end, PallasArena* arena) {
+    std::uint64_t length = string_length(s);
+    if (end > length || begin > end) {
+        pallas_slice_fail(begin, end, length);
+    }
+    pallas_string_assign(out, string_text(s) + begin, end - begin, arena);
+}
+
+void pallas_string_free(PallasString* s) {
+    if (!string_is_inline(s)) {
+        pallas::runtime::free_buffer(s->data);
+    }
+    *s = {};
+}
+
+}  // extern "C"
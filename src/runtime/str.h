@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "arena.h"
+
+// Runtime support for the built-in `string`: 24 bytes that own a
+// NUL-terminated text and cache its length. Texts of up to
+// kStringInlineCapacity bytes are stored in the string itself, with the
+// length in the last byte; a zeroed PallasString is the empty string. Longer
+// texts live in a buffer from the heap or from an arena (see buffer.h), and
+// the string holds the pointer, the length and the capacity, whose top bit
+// marks this form. Compiled code reads the length and the text inline.
+
+extern "C" {
+
+// Field offsets are part of the ABI. Only meaningful when the string is not
+// inline.
+struct PallasString {
+    char* data;
+    std::uint64_t length;
+    std::uint64_t capacity;  // bytes of text the buffer holds, | kStringHeapFlag
+};
+
+// Replaces the text. An inline string that needs a buffer gets it from
+// `arena`, or the heap if it is null; a string with a buffer reuses it, or
+// grows it where it came from. `text` may point into the string itself.
+void pallas_string_assign(PallasString* s, const char* text, std::uint64_t length,
+                          PallasArena* arena);
+// Appends `length` bytes of `text`, growing the buffer geometrically.
+void pallas_string_append(PallasString* s, const char* text, std::uint64_t length,
+                          PallasArena* arena);
+// Empties the string and returns room for `capacity` bytes of text, which
+// compiled code writes directly before calling pallas_string_commit.
+char* pallas_string_prepare(PallasString* s, std::uint64_t capacity, PallasArena* arena);
+// Ends the text written after pallas_string_prepare at `end`.
+void pallas_string_commit(PallasString* s, char* end);
+// Sets `out` (which may be `s`) to bytes [begin, end) of `s`. Slices
+// that fit inline do not allocate. Panics unless begin <= end <= length.
+void pallas_string_slice(PallasString* out, const PallasString* s, std::uint64_t begin,
+                         std::uint64_t end, PallasArena* arena);
+// Frees the buffer if it came from the heap. The string is empty afterwards.
+void pallas_string_free(PallasString* s);
+
+}  // extern "C"
+
+namespace pallas::runtime {
+
+constexpr std::uint64_t kStringInlineCapacity = sizeof(PallasString) - 2;
+constexpr std::uint64_t kStringTagOffset = sizeof(PallasString) - 1;  // inline length
+constexpr std::uint64_t kStringHeapFlag = std::uint64_t{1} << 63;
+constexpr std::uint64_t kStringDataOffset = offsetof(PallasString, data);
+constexpr std::uint64_t kStringLengthOffset = offsetof(PallasString, length);
+// The first buffer holds at least this many bytes of text.
+constexpr std::uint64_t kStringMinCapacity = 32;
+
+// Tests the tag byte rather than `capacity`: it was likely just written as a
+// byte, and a wider load of it would stall on store forwarding.
+inline bool string_is_inline(const PallasString* s) {
+    return (reinterpret_cast<const std::uint8_t*>(s)[kStringTagOffset] & 0x80) == 0;
+}
+
+inline const char* string_text(const PallasString* s) {
+    return string_is_inline(s) ? reinterpret_cast<const char*>(s) : s->data;
+}
+
+inline std::uint64_t string_length(const PallasString* s) {
+    return string_is_inline(s) ? reinterpret_cast<const std::uint8_t*>(s)[kStringTagOffset]
+                               : s->length;
+}
+
+}  // namespace pallas::runtime
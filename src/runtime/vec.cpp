@@ -0,0 +1,78 @@
+#include "vec.h"
+#include <algorithm>
+#include <limits>
+#include "panic.h"
+
+using pallas::runtime::BufferHeader;
+using pallas::runtime::buffer_header;
+using pallas::runtime::kBufferHeap;
+using pallas::runtime::kBufferInline;
+
+namespace {
+
+std::uint64_t buffer_bytes(std::uint64_t capacity, std::uint64_t element_size) {
+    if (element_size != 0 && capacity > std::numeric_limits<std::uint64_t>::max() / element_size) {
+        pallas_alloc_fail(std::numeric_limits<std::uint64_t>::max());
+    }
+    return capacity * element_size;
+}
+
+void move_to(PallasVec* vec, std::uint64_t capacity, std::uint64_t element_size,
+             PallasArena* arena) {
+    vec->data = static_cast<std::byte*>(
+        pallas::runtime::grow_buffer(vec->data, vec->length * element_size,
+                                     buffer_bytes(capacity, element_size), arena));
+    vec->capacity = capacity;
+}
+
+}  // namespace
+
+namespace pallas::runtime {
+
+std::uint64_t vec_grown_capacity(std::uint64_t capacity, std::uint64_t element_size, bool arena) {
+    std::uint64_t size = std::max<std::uint64_t>(element_size, 1);
+    std::uint64_t minimum = std::max(kVecMinCapacity, kVecMinBytes / size);
+    if (capacity < minimum) {
+        return minimum;
+    }
+    if (arena || capacity * size < kVecDoublingLimit) {
+        return capacity * 2;
+    }
+    return capacity + capacity / 2;
+}
+
+}  // namespace pallas::runtime
+
+extern "C" {
+
+void pallas_vec_grow(PallasVec* vec, std::uint64_t element_size, PallasArena* arena) {
+    std::uintptr_t source = vec->data != nullptr ? buffer_header(vec->data)->source
+                                                 : reinterpret_cast<std::uintptr_t>(arena);
+    bool in_arena = source != kBufferHeap && source != kBufferInline;
+    move_to(vec, pallas::runtime::vec_grown_capacity(vec->capacity, element_size, in_arena),
+            element_size, arena);
+}
+
+void pallas_vec_reserve(PallasVec* vec, std::uint64_t element_size, std::uint64_t capacity,
+                        PallasArena* arena) {
+    if (capacity > vec->capacity) {
+        move_to(vec, capacity, element_size, arena);
+    }
+}
+
+void pallas_vec_init_inline(PallasVec* vec, void* storage, std::uint64_t capacity,
+                            std::uint64_t element_size) {
+    auto* header = static_cast<BufferHeader*>(storage);
+    header->source = kBufferInline;
+    header->bytes = capacity * element_size;
+    vec->data = reinterpret_cast<std::byte*>(header + 1);
+    vec->length = 0;
+    vec->capacity = capacity;
+}
+
+void pallas_vec_free(PallasVec* vec) {
+    pallas::runtime::free_buffer(vec->data);
+    *vec = {};
+}
+
+}  // extern "C"
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "arena.h"
+#include "buffer.h"
+
+// Runtime support for the built-in `Vec<T>`. Compiled code owns the 24-byte
+// PallasVec and does the common operations inline: indexing reads `data` and
+// checks `length`, and push stores to data[length] while length < capacity.
+// The runtime is only called to allocate, grow and free, with the element
+// size as an argument. A zeroed PallasVec is empty and owns nothing.
+//
+// Growth is geometric: the capacity doubles while the buffer is small and
+// grows by half once it holds kVecDoublingLimit bytes, where a smaller factor
+// wastes less and realloc can often extend the buffer in place. Arena buffers
+// always double: the arena cannot reuse the buffer left behind, and doubling
+// keeps all of those together smaller than the live one. Pallas values have no
+// move constructors, so elements are relocated with realloc or memcpy.
+
+extern "C" {
+
+// Field offsets are part of the ABI: compiled code reads and writes all three.
+struct PallasVec {
+    std::byte* data;  // preceded by a runtime::BufferHeader; null while empty
+    std::uint64_t length;
+    std::uint64_t capacity;
+};
+
+// Slow path of push: room for at least one more element. A Vec without a
+// buffer takes its first one from `arena`, or the heap if it is null; a Vec
+// with a buffer grows where the buffer came from.
+void pallas_vec_grow(PallasVec* vec, std::uint64_t element_size, PallasArena* arena);
+// Room for at least `capacity` elements, allocated exactly.
+void pallas_vec_reserve(PallasVec* vec, std::uint64_t element_size, std::uint64_t capacity,
+                        PallasArena* arena);
+// Starts an empty Vec on storage the caller provides: kVecInlineHeader bytes,
+// then room for `capacity` elements. The Vec moves out when it outgrows it.
+void pallas_vec_init_inline(PallasVec* vec, void* storage, std::uint64_t capacity,
+                            std::uint64_t element_size);
+// Frees the buffer if it came from the heap. The Vec is empty afterwards.
+void pallas_vec_free(PallasVec* vec);
+
+}  // extern "C"
+
+namespace pallas::runtime {
+
+constexpr std::uint64_t kVecDataOffset = offsetof(PallasVec, data);
+constexpr std::uint64_t kVecLengthOffset = offsetof(PallasVec, length);
+constexpr std::uint64_t kVecCapacityOffset = offsetof(PallasVec, capacity);
+constexpr std::uint64_t kVecInlineHeader = sizeof(BufferHeader);
+// The first buffer holds at least this many elements and this many bytes.
+constexpr std::uint64_t kVecMinCapacity = 4;
+constexpr std::uint64_t kVecMinBytes = 64;
+constexpr std::uint64_t kVecDoublingLimit = 4096;
+// `Vec<T>(n)` with a constant n gets stack storage when the elements fit in
+// this many bytes.
+constexpr std::uint64_t kVecInlineBytes = 256;
+
+// The capacity after growing a buffer of `capacity` elements of
+// `element_size` bytes; `arena` selects the arena policy.
+std::uint64_t vec_grown_capacity(std::uint64_t capacity, std::uint64_t element_size, bool arena);
+
+}  // namespace pallas::runtime
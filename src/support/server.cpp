@@ -0,0 +1,409 @@
+#include "server.h"
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+
+namespace pallas::support {
+
+namespace {
+
+constexpr std::uint32_t kRequestMagic = 0x50414c53;  // "PALS"
+constexpr std::uint32_t kRequestStop = 1;
+
+// The socket serve() listens on, which detached requests do not keep open.
+int listener_fd = -1;
+
+// Sent with the client's descriptors attached; `length` bytes of the working
+// directory and the arguments, each ending in a NUL, follow.
+struct RequestHeader {
+    std::uint32_t magic;
+    std::uint32_t flags;
+    std::uint32_t length;
+};
+
+bool write_all(int fd, const void* data, std::size_t size) {
+    const char* p = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t n = write(fd, p, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        size -= static_cast<std::size_t>(n);
+    }
+    return true;
+}
+
+bool read_all(int fd, void* data, std::size_t size) {
+    char* p = static_cast<char*>(data);
+    while (size > 0) {
+        ssize_t n = read(fd, p, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        size -= static_cast<std::size_t>(n);
+    }
+    return true;
+}
+
+bool socket_address(const std::string& path, sockaddr_un* address, std::string* error) {
+    std::memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address->sun_path)) {
+        *error = "invalid socket path '" + path + "'";
+        return false;
+    }
+    std::memcpy(address->sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+// True when the process at the other end of `fd` runs as this user. Nobody
+// else may have the server run code or receive a client's descriptors.
+bool same_user(int fd) {
+    ucred peer{};
+    socklen_t length = sizeof(peer);
+    return getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &peer, &length) == 0 && peer.uid == getuid();
+}
+
+// The directory of the socket must not let other users replace it: it is
+// created private if missing, and otherwise must belong to this user (or
+// root) and be writable by others only with the sticky bit, like /tmp.
+bool check_directory(const std::string& path, std::string* error) {
+    std::string directory = std::filesystem::path(path).parent_path().string();
+    if (directory.empty()) {
+        directory = ".";
+    }
+    if (mkdir(directory.c_str(), 0700) != 0 && errno != EEXIST) {
+        *error = "cannot create '" + directory + "': " + std::strerror(errno);
+        return false;
+    }
+    struct stat info{};
+    if (lstat(directory.c_str(), &info) != 0 || !S_ISDIR(info.st_mode)) {
+        *error = "'" + directory + "' is not a directory";
+        return false;
+    }
+    bool owned = info.st_uid == getuid() || info.st_uid == 0;
+    bool shared = (info.st_mode & (S_IWGRP | S_IWOTH)) != 0 && (info.st_mode & S_ISVTX) == 0;
+    if (!owned || shared) {
+        *error = "'" + directory + "' is not private: other users could replace the socket";
+        return false;
+    }
+    return true;
+}
+
+int connect_to(const sockaddr_un& address) {
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Reads a request and its descriptors from `connection`. Descriptors that
+// arrive with a malformed request are closed.
+bool receive(int connection, ServerRequest* request) {
+    RequestHeader header{};
+    iovec data{&header, sizeof(header)};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * 3)];
+    msghdr message{};
+    message.msg_iov = &data;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    ssize_t n;
+    do {
+        n = recvmsg(connection, &message, MSG_CMSG_CLOEXEC);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) {
+        return false;
+    }
+    int fd_count = 0;
+    for (cmsghdr* c = CMSG_FIRSTHDR(&message); c != nullptr; c = CMSG_NXTHDR(&message, c)) {
+        if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_RIGHTS) {
+            fd_count = static_cast<int>((c->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+            std::memcpy(request->fds, CMSG_DATA(c), sizeof(int) * std::min(fd_count, 3));
+        }
+    }
+    auto* rest = reinterpret_cast<char*>(&header) + n;
+    std::string payload;
+    bool ok = fd_count == 3 &&
+              read_all(connection, rest, sizeof(header) - static_cast<std::size_t>(n)) &&
+              header.magic == kRequestMagic && header.length < (1u << 24);
+    if (ok) {
+        payload.resize(header.length);
+        ok = read_all(connection, payload.data(), payload.size()) &&
+             (payload.empty() || payload.back() == '\0');
+    }
+    if (!ok) {
+        for (int i = 0; i < std::min(fd_count, 3); ++i) {
+            close(request->fds[i]);
+        }
+        return false;
+    }
+    request->stop = (header.flags & kRequestStop) != 0;
+    std::size_t start = 0;
+    for (std::size_t i = 0; i < payload.size(); ++i) {
+        if (payload[i] == '\0') {
+            std::string part = payload.substr(start, i - start);
+            if (start == 0) {
+                request->directory = std::move(part);
+            } else {
+                request->args.push_back(std::move(part));
+            }
+            start = i + 1;
+        }
+    }
+    return true;
+}
+
+// Runs the handler with the client's directory and descriptors in place of
+// the server's own, which are put back afterwards. Returns its exit status.
+int handle(const ServerRequest& request, const RequestHandler& handler) {
+    std::cout.flush();
+    std::fflush(stdout);
+    std::fflush(stderr);
+    int saved[3];
+    for (int i = 0; i < 3; ++i) {
+        saved[i] = fcntl(i, F_DUPFD_CLOEXEC, 3);
+        dup2(request.fds[i], i);
+    }
+    int status = 1;
+    std::error_code code;
+    std::filesystem::path previous = std::filesystem::current_path(code);
+    std::filesystem::current_path(request.directory, code);
+    if (code) {
+        std::cerr << "palc: server: cannot enter '" << request.directory << "': "
+                  << code.message() << '\n';
+    } else {
+        try {
+            status = handler(request);
+        } catch (const std::exception& e) {
+            std::cerr << "palc: server: " << e.what() << '\n';
+        }
+    }
+    std::cout.flush();
+    std::fflush(stdout);
+    std::fflush(stderr);
+    for (int i = 0; i < 3; ++i) {
+        dup2(saved[i], i);
+        close(saved[i]);
+    }
+    std::filesystem::current_path(previous, code);
+    return status;
+}
+
+}  // namespace
+
+std::string default_server_socket() {
+    if (const char* path = std::getenv("PALC_SERVER_SOCKET"); path != nullptr && *path != '\0') {
+        return path;
+    }
+    const char* runtime = std::getenv("XDG_RUNTIME_DIR");
+    if (runtime != nullptr && *runtime != '\0') {
+        return std::string(runtime) + "/palc.sock";
+    }
+    return "/tmp/palc-" + std::to_string(getuid()) + "/server.sock";
+}
+
+bool serve(const std::string& path, const RequestHandler& handler, std::string* error) {
+    sockaddr_un address;
+    if (!socket_address(path, &address, error) || !check_directory(path, error)) {
+        return false;
+    }
+    // A client that goes away must not take the server with it, and detached
+    // requests are reaped by the system.
+    std::signal(SIGPIPE, SIG_IGN);
+    std::signal(SIGCHLD, SIG_IGN);
+    int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listener < 0) {
+        *error = std::string("cannot create a socket: ") + std::strerror(errno);
+        return false;
+    }
+    auto* generic = reinterpret_cast<const sockaddr*>(&address);
+    // Only this user may connect (and same_user checks who did).
+    mode_t mask = umask(0077);
+    int bound = bind(listener, generic, sizeof(address));
+    if (bound != 0 && errno == EADDRINUSE) {
+        int other = connect_to(address);
+        if (other >= 0) {
+            close(other);
+            close(listener);
+            *error = "a server is already listening on '" + path + "'";
+            return false;
+        }
+        unlink(path.c_str());
+        bound = bind(listener, generic, sizeof(address));
+    }
+    umask(mask);
+    if (bound != 0 || listen(listener, 16) != 0) {
+        *error = "cannot listen on '" + path + "': " + std::strerror(errno);
+        close(listener);
+        return false;
+    }
+    listener_fd = listener;
+    bool stopped = false;
+    for (;;) {
+        int connection = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+        if (connection < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            *error = std::string("accept failed: ") + std::strerror(errno);
+            break;
+        }
+        ServerRequest request;
+        if (!same_user(connection) || !receive(connection, &request)) {
+            close(connection);
+            continue;
+        }
+        request.connection = connection;
+        std::int32_t status = request.stop ? 0 : handle(request, handler);
+        for (int fd : request.fds) {
+            close(fd);
+        }
+        if (status != kDetachedStatus) {
+            write_all(connection, &status, sizeof(status));
+        }
+        close(connection);
+        if (request.stop) {
+            stopped = true;
+            break;
+        }
+    }
+    close(listener);
+    listener_fd = -1;
+    unlink(path.c_str());
+    return stopped;
+}
+
+int detach(const ServerRequest& request, const std::function<int()>& work) {
+    std::cout.flush();
+    std::fflush(stdout);
+    std::fflush(stderr);
+    pid_t reporter = fork();
+    if (reporter < 0) {
+        std::cerr << "palc: server: cannot fork: " << std::strerror(errno) << '\n';
+        return 1;
+    }
+    if (reporter > 0) {
+        return kDetachedStatus;
+    }
+    // The reporter waits for the process that does the work, which may crash,
+    // and sends the reply in its place.
+    std::signal(SIGCHLD, SIG_DFL);
+    if (listener_fd >= 0) {
+        close(listener_fd);
+    }
+    pid_t worker = fork();
+    if (worker == 0) {
+        std::signal(SIGPIPE, SIG_DFL);
+        close(request.connection);
+        int status = 1;
+        try {
+            status = work();
+        } catch (const std::exception& e) {
+            std::cerr << "palc: " << e.what() << '\n';
+        }
+        std::cout.flush();
+        std::fflush(stdout);
+        std::fflush(stderr);
+        _exit(status & 0xff);
+    }
+    std::int32_t status = 1;
+    int raw = 0;
+    pid_t waited;
+    do {
+        waited = worker > 0 ? waitpid(worker, &raw, 0) : -1;
+    } while (waited < 0 && errno == EINTR);
+    if (waited > 0 && WIFEXITED(raw)) {
+        status = WEXITSTATUS(raw);
+    } else if (waited > 0 && WIFSIGNALED(raw)) {
+        status = 128 + WTERMSIG(raw);
+        std::fprintf(stderr, "palc: program terminated by signal %d (%s)\n", WTERMSIG(raw),
+                     strsignal(WTERMSIG(raw)));
+    }
+    write_all(request.connection, &status, sizeof(status));
+    _exit(0);
+}
+
+std::optional<int> send_request(const std::string& path, const ServerRequest& request,
+                                std::string* error) {
+    sockaddr_un address;
+    if (!socket_address(path, &address, error)) {
+        return std::nullopt;
+    }
+    int fd = connect_to(address);
+    if (fd < 0) {
+        *error = "no compile server is listening on '" + path + "'";
+        return std::nullopt;
+    }
+    if (!same_user(fd)) {
+        close(fd);
+        *error = "the compile server on '" + path + "' runs as another user";
+        return 1;
+    }
+    std::string payload = request.directory;
+    payload.push_back('\0');
+    for (const std::string& arg : request.args) {
+        payload.append(arg);
+        payload.push_back('\0');
+    }
+    RequestHeader header{kRequestMagic, request.stop ? kRequestStop : 0,
+                         static_cast<std::uint32_t>(payload.size())};
+    iovec data{&header, sizeof(header)};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * 3)] = {};
+    msghdr message{};
+    message.msg_iov = &data;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    cmsghdr* fds = CMSG_FIRSTHDR(&message);
+    fds->cmsg_level = SOL_SOCKET;
+    fds->cmsg_type = SCM_RIGHTS;
+    fds->cmsg_len = CMSG_LEN(sizeof(int) * 3);
+    std::memcpy(CMSG_DATA(fds), request.fds, sizeof(int) * 3);
+
+    std::int32_t status = 0;
+    ssize_t sent;
+    do {
+        sent = sendmsg(fd, &message, 0);
+    } while (sent < 0 && errno == EINTR);
+    bool ok = sent > 0 &&
+              write_all(fd, reinterpret_cast<char*>(&header) + sent,
+                        sizeof(header) - static_cast<std::size_t>(sent)) &&
+              write_all(fd, payload.data(), payload.size()) &&
+              read_all(fd, &status, sizeof(status));
+    close(fd);
+    if (!ok) {
+        // The request may have run partly, so it is not retried.
+        *error = "the compile server on '" + path + "' dropped the request";
+        return 1;
+    }
+    return status;
+}
+
+}  // namespace pallas::support
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Transport of the compile server (palc --server) and its clients: a local
+// Unix socket carrying one request per connection. A request is the client's
+// working directory and command-line arguments, and its stdin, stdout and
+// stderr travel with it as file descriptors, so whatever the server prints
+// while handling it goes straight to the client's terminal or pipes. The
+// reply is the exit status.
+//
+// Handlers that run the client's program hand that part to detach(): it runs
+// in a child process, so a program that crashes does not take the server down
+// and one that never ends does not hold up other clients.
+
+namespace pallas::support {
+
+struct ServerRequest {
+    std::string directory;
+    std::vector<std::string> args;
+    bool stop = false;  // asks the server to exit after replying
+    int fds[3] = {0, 1, 2};  // stdin, stdout and stderr of the client
+    int connection = -1;     // server side: where the reply goes
+};
+
+// What a handler returns once detach() has taken the request over.
+constexpr int kDetachedStatus = -1;
+
+// Handles a request with the client's directory as the working directory and
+// its descriptors as 0, 1 and 2. Returns the exit status.
+using RequestHandler = std::function<int(const ServerRequest&)>;
+
+// $PALC_SERVER_SOCKET, or else palc.sock in $XDG_RUNTIME_DIR, or else
+// /tmp/palc-<uid>/server.sock.
+std::string default_server_socket();
+
+// Listens on `path` and handles requests one at a time until one asks to
+// stop. A socket left behind by a server that is gone is replaced. The socket
+// is accessible to this user only, and connections from processes of other
+// users are dropped. Its directory is created (mode 0700) if missing, and must
+// not be writable by other users unless it is sticky. Returns false with
+// `error` set when it cannot listen.
+bool serve(const std::string& path, const RequestHandler& handler, std::string* error);
+
+// For handlers: runs `work` in a child process, which keeps the request's
+// directory and descriptors, and returns kDetachedStatus at once. The exit
+// status of `work`, or 128 plus the number of the signal that ended it, is
+// the reply, sent when it finishes while the server handles other requests.
+int detach(const ServerRequest& request, const std::function<int()>& work);
+
+// Sends `request` to the server at `path` and waits for its exit status.
+// Returns nullopt with `error` set when no server is listening, and 1 with
+// `error` set when the server runs as another user (and is sent nothing) or
+// dropped the request, which may have partly run.
+std::optional<int> send_request(const std::string& path, const ServerRequest& request,
+                                std::string* error);
+
+}  // namespace pallas::support
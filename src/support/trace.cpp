@@ -0,0 +1,207 @@
+#include "trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+namespace pallas::support {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+Clock::time_point epoch;
+std::mutex events_mutex;
+std::vector<TraceEvent> events;
+std::atomic<std::uint32_t> next_thread{0};
+int statm = -1;  // /proc/self/statm, kept open while tracing
+
+thread_local TraceScope* current = nullptr;
+
+std::uint32_t thread_index() {
+    thread_local std::uint32_t index = next_thread++;
+    return index;
+}
+
+std::uint64_t now_ns() {
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - epoch).count());
+}
+
+// Resident memory of the process, or 0 where it cannot be read. This is a
+// single read whatever the size of the heap; mallinfo2, which walks the free
+// lists, made tracing of large modules quadratic.
+std::uint64_t resident_bytes() {
+#if defined(__linux__)
+    char text[128];
+    ssize_t n = statm < 0 ? -1 : pread(statm, text, sizeof(text) - 1, 0);
+    if (n <= 0) {
+        return 0;
+    }
+    text[n] = '\0';
+    char* pages = nullptr;
+    std::strtoull(text, &pages, 10);  // total size, then resident pages
+    static const auto page = static_cast<std::uint64_t>(sysconf(_SC_PAGESIZE));
+    return std::strtoull(pages, nullptr, 10) * page;
+#else
+    return 0;
+#endif
+}
+
+// The most memory the process has had resident so far, as the kernel counts
+// it between samples too, or 0 where it cannot be read.
+std::uint64_t peak_resident_bytes() {
+#if defined(__linux__)
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+    return static_cast<std::uint64_t>(usage.ru_maxrss) * 1024;  // reported in KiB
+#else
+    return 0;
+#endif
+}
+
+void append_escaped(std::string& out, std::string_view text) {
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out.push_back('\\');
+            out.push_back(c);
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escape[8];
+            std::snprintf(escape, sizeof(escape), "\\u%04x", c);
+            out.append(escape);
+        } else {
+            out.push_back(c);
+        }
+    }
+}
+
+}  // namespace
+
+void start_tracing() {
+    std::lock_guard<std::mutex> lock(events_mutex);
+    events.clear();
+    epoch = Clock::now();
+#if defined(__linux__)
+    if (statm < 0) {
+        statm = open("/proc/self/statm", O_RDONLY | O_CLOEXEC);
+    }
+#endif
+    tracing_enabled.store(true, std::memory_order_relaxed);
+}
+
+void stop_tracing() {
+    tracing_enabled.store(false, std::memory_order_relaxed);
+}
+
+std::vector<TraceEvent> trace_events() {
+    std::lock_guard<std::mutex> lock(events_mutex);
+    return events;
+}
+
+void TraceScope::begin(const char* phase, std::string_view what) {
+    name = phase;
+    detail = what;
+    parent = current;
+    current = this;
+    peak_start_bytes = peak_resident_bytes();
+    start_ns = now_ns();
+}
+
+void TraceScope::end() {
+    TraceEvent event;
+    event.duration_ns = now_ns() - start_ns;
+    event.resident_bytes = resident_bytes();
+    event.peak_growth_bytes = peak_resident_bytes() - peak_start_bytes;
+    event.name = name;
+    event.detail = std::move(detail);
+    event.thread = thread_index();
+    event.start_ns = start_ns;
+    event.items = items;
+    current = parent;
+    std::lock_guard<std::mutex> lock(events_mutex);
+    events.push_back(std::move(event));
+}
+
+std::string trace_json() {
+    std::vector<TraceEvent> recorded = trace_events();
+    std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    out.append("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,"
+               "\"args\":{\"name\":\"palc\"}}");
+    char number[256];
+    for (const TraceEvent& e : recorded) {
+        out.append(",\n{\"name\":\"");
+        append_escaped(out, e.name);
+        out.append("\",\"cat\":\"pallas\",\"ph\":\"X\",\"pid\":1");
+        std::snprintf(number, sizeof(number), ",\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{",
+                      e.thread, static_cast<double>(e.start_ns) / 1e3,
+                      static_cast<double>(e.duration_ns) / 1e3);
+        out.append(number);
+        if (!e.detail.empty()) {
+            out.append("\"detail\":\"");
+            append_escaped(out, e.detail);
+            out.append("\",");
+        }
+        std::snprintf(number, sizeof(number),
+                      "\"items\":%llu,\"resident_bytes\":%llu,\"peak_growth_bytes\":%llu}}",
+                      static_cast<unsigned long long>(e.items),
+                      static_cast<unsigned long long>(e.resident_bytes),
+                      static_cast<unsigned long long>(e.peak_growth_bytes));
+        out.append(number);
+    }
+    out.append("\n]}\n");
+    return out;
+}
+
+std::string trace_summary() {
+    struct Phase {
+        std::string_view name;
+        std::uint64_t first_start = 0;
+        std::size_t calls = 0;
+        std::uint64_t nanoseconds = 0;
+        std::uint64_t items = 0;
+        std::uint64_t peak_growth_bytes = 0;
+    };
+    std::vector<Phase> phases;
+    for (const TraceEvent& e : trace_events()) {
+        auto it = std::find_if(phases.begin(), phases.end(),
+                               [&](const Phase& p) { return p.name == e.name; });
+        if (it == phases.end()) {
+            it = phases.insert(phases.end(), Phase{e.name, e.start_ns});
+        }
+        it->first_start = std::min(it->first_start, e.start_ns);
+        it->calls++;
+        it->nanoseconds += e.duration_ns;
+        it->items += e.items;
+        it->peak_growth_bytes += e.peak_growth_bytes;
+    }
+    std::stable_sort(phases.begin(), phases.end(), [](const Phase& a, const Phase& b) {
+        return a.first_start < b.first_start;
+    });
+
+    std::string out;
+    char line[256];
+    out.append("===------------------------------------------------------------===\n");
+    out.append("                   Compiler phase report\n");
+    out.append("===------------------------------------------------------------===\n");
+    out.append("  Phases include the phases nested in them.\n\n");
+    out.append("   Wall (ms)   Calls        Items  Peak growth (KiB)  Phase\n");
+    for (const Phase& p : phases) {
+        std::snprintf(line, sizeof(line), "  %10.3f %7zu %12llu %18llu  %.*s\n",
+                      static_cast<double>(p.nanoseconds) / 1e6, p.calls,
+                      static_cast<unsigned long long>(p.items),
+                      static_cast<unsigned long long>(p.peak_growth_bytes / 1024),
+                      static_cast<int>(p.name.size()), p.name.data());
+        out.append(line);
+    }
+    return out;
+}
+
+}  // namespace pallas::support
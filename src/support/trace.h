@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Scoped tracing of the compiler's own phases (palc -ftime-trace). Events are
+// written as a Chrome trace, which chrome://tracing and ui.perfetto.dev load,
+// and summed per phase into a table. Until start_tracing() is called a
+// TraceScope costs one relaxed load and a branch.
+
+namespace pallas::support {
+
+inline std::atomic<bool> tracing_enabled{false};
+
+inline bool tracing() {
+    return tracing_enabled.load(std::memory_order_relaxed);
+}
+
+struct TraceEvent {
+    const char* name = nullptr;  // the phase: "scan", "parse", a pass name, ...
+    std::string detail;          // what it ran on, e.g. a function; may be empty
+    std::uint32_t thread = 0;
+    std::uint64_t start_ns = 0;  // since start_tracing()
+    std::uint64_t duration_ns = 0;
+    std::uint64_t items = 0;           // tokens, nodes or instructions processed
+    std::uint64_t resident_bytes = 0;  // resident memory when the phase ended
+    // How far the phase raised the peak resident memory of the process. Phases
+    // overlapping on other threads share the growth; nested phases count in it.
+    std::uint64_t peak_growth_bytes = 0;
+};
+
+// Starts recording, dropping the events of an earlier trace. Call it before
+// any traced work starts; scopes open at that point are not recorded.
+void start_tracing();
+void stop_tracing();
+// Events recorded so far, in the order the phases ended.
+std::vector<TraceEvent> trace_events();
+// The events as Chrome trace JSON ("X" events, times in microseconds).
+std::string trace_json();
+// Per phase, in the order phases first started: calls, wall time, items and
+// growth of the peak resident memory, each summed over the calls.
+std::string trace_summary();
+
+// Records one phase from construction to destruction. `name` must be a string
+// literal or otherwise outlive the trace; `detail` is copied only when tracing.
+class TraceScope {
+  public:
+    explicit TraceScope(const char* name) {
+        if (tracing()) {
+            begin(name, {});
+        }
+    }
+    TraceScope(const char* name, std::string_view detail) {
+        if (tracing()) {
+            begin(name, detail);
+        }
+    }
+    ~TraceScope() {
+        if (name != nullptr) {
+            end();
+        }
+    }
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+    bool active() const { return name != nullptr; }
+    void set_items(std::uint64_t n) { items = n; }
+
+  private:
+    const char* name = nullptr;  // null when not recording
+    std::string detail;
+    TraceScope* parent = nullptr;  // enclosing scope on this thread
+    std::uint64_t start_ns = 0;
+    std::uint64_t items = 0;
+    std::uint64_t peak_start_bytes = 0;
+
+    void begin(const char* phase, std::string_view what);
+    void end();
+};
+
+}  // namespace pallas::support
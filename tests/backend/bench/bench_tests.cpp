@@ -0,0 +1,165 @@
+#include <catch2/catch_test_macros.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+#include "backend/bench.h"
+#include "backend/codegen.h"
+#include "frontend/diagnostics.h"
+#include "middle/interpreter.h"
+#include "tests/support/compile_helpers.h"
+
+using namespace pallas;
+using namespace pallas::middle;
+using namespace pallas::test;
+
+namespace {
+
+// Quick settings: the tests check what is measured, not how precisely.
+backend::BenchOptions quick() {
+    backend::BenchOptions options;
+    options.samples = 5;
+    options.sample_seconds = 0.001;
+    options.warmup_seconds = 0.002;
+    return options;
+}
+
+}  // namespace
+
+TEST_CASE("bench: samples beyond the fences are dropped as outliers") {
+    backend::BenchResult result;
+    backend::summarize_samples({10.0, 12.0, 10.0, 11.0, 95.0, 11.0, 10.0, 12.0}, &result);
+    REQUIRE(result.samples == 8);
+    REQUIRE(result.outliers == 1);
+    REQUIRE(result.ns_per_op == 76.0 / 7.0);
+    REQUIRE(result.median_ns_per_op == 11.0);
+    REQUIRE(result.min_ns_per_op == 10.0);
+    REQUIRE(result.stddev_ns_per_op > 0.8);
+    REQUIRE(result.stddev_ns_per_op < 0.9);
+}
+
+TEST_CASE("bench: results survive a round trip through JSON") {
+    std::vector<backend::BenchResult> results(2);
+    results[0].name = "sum";
+    results[0].iterations = 81920;
+    results[0].samples = 20;
+    results[0].outliers = 1;
+    results[0].ns_per_op = 121.5;
+    results[0].median_ns_per_op = 120.75;
+    results[0].allocs_per_op = 2;
+    results[0].bytes_per_op = 48;
+    results[1].name = "grow";
+    results[1].ns_per_op = 3.25;
+    std::string json = backend::bench_json(results, "lib.pal", 2);
+    std::vector<backend::BenchResult> read;
+    std::string error;
+    REQUIRE(backend::parse_bench_json(json, &read, &error));
+    REQUIRE(read.size() == 2);
+    REQUIRE(read[0].name == "sum");
+    REQUIRE(read[0].iterations == 81920);
+    REQUIRE(read[0].outliers == 1);
+    REQUIRE(read[0].ns_per_op == 121.5);
+    REQUIRE(read[0].median_ns_per_op == 120.75);
+    REQUIRE(read[0].bytes_per_op == 48);
+    REQUIRE(read[1].ns_per_op == 3.25);
+
+    REQUIRE_FALSE(backend::parse_bench_json("{\"benchmarks\": [{\"name\": 3}]}", &read, &error));
+
+    // Compared with itself after getting 10% slower; new benchmarks say so.
+    std::vector<backend::BenchResult> slower = results;
+    slower[0].ns_per_op *= 1.1;
+    slower[1].name = "other";
+    std::string table = backend::bench_table(slower, &read);
+    REQUIRE(table.find("+10.0%") != std::string::npos);
+    REQUIRE(table.find("new") != std::string::npos);
+}
+
+TEST_CASE("bench: @bench functions take nothing and black_box is the identity") {
+    auto bad = compile(R"CODE(
+        @bench
+        with_args(n: i64): i64 { return n; }
+    )CODE");
+    REQUIRE(bad->diagnostics.all().size() == 1);
+
+    auto c = compile(R"CODE(
+        @bench
+        work(): i64 { return black_box(40) + 2; }
+        main(): i32 {
+            f: f64 = black_box(1.5);
+            b: bool = black_box(true);
+            if (b && f == 1.5) { return (i32) work(); }
+            return 0;
+        }
+    )CODE", 2);
+    REQUIRE(c->diagnostics.all().empty());
+    const Function* work = c->module->find_function("work");
+    REQUIRE((work->flags & FUNCTION_BENCH) != 0);
+    // The optimizer sees through neither the value nor the call.
+    REQUIRE(c->module->find_function("pallas_black_box_u64") != nullptr);
+    Interpreter interpreter(*c->module);
+    ExecutionResult result = interpreter.run("main");
+    REQUIRE(result.ok);
+    REQUIRE(result.value == 42);
+}
+
+#ifdef PALLAS_HAVE_LLVM
+
+TEST_CASE("bench: benchmarks are timed and their allocations counted") {
+    auto c = compile(R"CODE(
+        struct Pair { a: i64; b: i64; }
+        @bench
+        allocate(): void {
+            p: Pair* = new Pair;
+            black_box(p);
+            delete p;
+        }
+        @bench
+        grow(): void {
+            s: string = "";
+            for (i: i32 = 0; i < 4; i++) { s += "0123456789"; }
+            black_box(s.len());
+        }
+        @bench
+        nothing(): i64 { return black_box(1); }
+        main(): i32 { return 0; }
+    )CODE", 2);
+    REQUIRE(c->diagnostics.all().empty());
+    std::vector<backend::BenchResult> results;
+    std::string error;
+    REQUIRE(backend::run_benchmarks(*c->module, quick(), &results, &error));
+    INFO(error);
+    REQUIRE(results.size() == 3);
+    REQUIRE(results[0].name == "allocate");
+    REQUIRE(results[0].allocs_per_op == 1.0);
+    REQUIRE(results[0].bytes_per_op == 16.0);
+    REQUIRE(results[1].allocs_per_op >= 1.0);
+    REQUIRE(results[2].allocs_per_op == 0.0);
+    for (const backend::BenchResult& r : results) {
+        REQUIRE(r.iterations > 0);
+        REQUIRE(r.samples == 5);
+        REQUIRE(r.ns_per_op > 0.0);
+    }
+
+    backend::BenchOptions only = quick();
+    only.filter = "grow";
+    results.clear();
+    REQUIRE(backend::run_benchmarks(*c->module, only, &results, &error));
+    REQUIRE(results.size() == 1);
+}
+
+TEST_CASE("bench: a benchmark failing a runtime check is reported") {
+    auto c = compile(R"CODE(
+        @bench
+        overrun(): i32 {
+            a: i32[4];
+            return a[black_box(7)];
+        }
+    )CODE", 2);
+    REQUIRE(c->diagnostics.all().empty());
+    std::vector<backend::BenchResult> results;
+    std::string error;
+    REQUIRE_FALSE(backend::run_benchmarks(*c->module, quick(), &results, &error));
+    REQUIRE(error.find("@overrun") != std::string::npos);
+    REQUIRE(error.find("out of bounds") != std::string::npos);
+}
+
+#endif  // PALLAS_HAVE_LLVM
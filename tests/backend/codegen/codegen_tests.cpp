@@ -0,0 +1,255 @@
+#include <catch2/catch_test_macros.hpp>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "backend/codegen.h"
+#include "middle/interpreter.h"
+#include "middle/passes.h"
+#include "runtime/format.h"
+#include "tests/support/compile_helpers.h"
+
+#ifdef PALLAS_HAVE_LLVM
+
+using namespace pallas;
+using namespace pallas::middle;
+using namespace pallas::test;
+
+namespace {
+
+const char* const kPrograms[] = {
+    R"CODE(
+        class Node {
+            public:
+                value: i32;
+                next: Node*;
+                Node(v: i32, n: Node*) { value = v; next = n; }
+        }
+        @noinline
+        fib(n: i32): i64 { if (n < 2) { return (i64) n; } return fib(n - 1) + fib(n - 2); }
+        main(): i32 {
+            head: Node* = null;
+            for (i: i32 = 0; i < 10; i++) { head = new Node(i, head); }
+            t: i32 = 0;
+            while (head != null) {
+                t += head.value;
+                next: Node* = head.next;
+                delete head;
+                head = next;
+            }
+            arena(64) {
+                for (i: i32 = 0; i < 100; i++) { t += new Node(i, null).value % 3; }
+            }
+            return t + (i32) (fib(20) % 100);
+        }
+    )CODE",
+    R"CODE(
+        @noinline
+        kind(x: i32): i32 {
+            match (x) {
+                0 => { return 10; }
+                1 => { return 11; }
+                2 => { return 12; }
+                3 => { return 13; }
+                4 => { return 14; }
+                1000 => { return 15; }
+                _ => { return 16; }
+            }
+            return 0;
+        }
+        @noinline
+        word(s: char*): i32 {
+            match (s) {
+                "go" => { return 1; }
+                "pallas" => { return 2; }
+                "arguments" => { return 3; }
+                _ => { return 4; }
+            }
+            return 0;
+        }
+        main(): i32 {
+            s: char* = new char[3];
+            s[0] = 'g'; s[1] = 'o';
+            r: i32 = kind(3) + kind(1000) + kind(-1) + word(s) * 100 + word(null) * 50;
+            delete s;
+            return r;
+        }
+    )CODE",
+    R"CODE(
+        main(): i32 {
+            a: i8[300];
+            b: i8[300];
+            for (i: i32 = 0; i < 300; i++) { a[i] = (i8)i; b[i] = (i8)(3 * i); }
+            for (i: i32 = 0; i < 300; i++) { a[i] = a[i] + b[i] ^ (i8)5; }
+            total: i32 = 0;
+            for (x : a) { total += (i32)x; }
+            return total;
+        }
+    )CODE",
+    R"CODE(
+        main(): i32 {
+            a: f32[400];
+            b: f64[400];
+            for (i: i32 = 0; i < 400; i++) { a[i] = (f32)i * 0.5; b[i] = (f64)i / 3.0; }
+            for (i: i32 = 0; i < 400; i++) { a[i] = a[i] * 1.25 + 2.0; b[i] = b[i] - 1.0; }
+            return (i32)a[399] + (i32)a[17] + (i32)b[300];
+        }
+    )CODE",
+};
+
+}  // namespace
+
+TEST_CASE("codegen: JIT-compiled programs return what the interpreter computes") {
+    REQUIRE(backend::llvm_available());
+    for (const char* code : kPrograms) {
+        for (int level = 0; level <= 3; ++level) {
+            auto c = compile(code, level);
+            Interpreter interpreter(*c->module);
+            ExecutionResult expected = interpreter.run("main");
+            REQUIRE(expected.ok);
+            backend::CodegenOptions options;
+            options.opt_level = level;
+            backend::RunResult result = backend::run_jit(*c->module, options);
+            INFO(result.error);
+            REQUIRE(result.ok);
+            REQUIRE(result.value == expected.value);
+        }
+    }
+}
+
+TEST_CASE("codegen: switches, split blocks and phis translate from textual IR") {
+    // Two cases share a target and one case is not a constant; the phi has one
+    // entry per edge.
+    auto module = parse_module(
+        "func @pick(i32 %x, i32 %y) -> i32 {\n"
+        "entry:\n"
+        "  switch %x, default [i32 1, one] [i32 2, two] [i32 1, two] [%y, other]\n"
+        "one:\n"
+        "  br join\n"
+        "two:\n"
+        "  br join\n"
+        "other:\n"
+        "  br join\n"
+        "default:\n"
+        "  br join\n"
+        "join:\n"
+        "  %r = phi i32 [i32 10, one], [i32 20, two], [i32 30, other], [i32 40, default]\n"
+        "  ret %r\n"
+        "}\n"
+        "func @main() -> i32 {\n"
+        "entry:\n"
+        "  %a = call i32 @pick(i32 1, i32 7)\n"
+        "  %b = call i32 @pick(i32 2, i32 7)\n"
+        "  %c = call i32 @pick(i32 7, i32 7)\n"
+        "  %d = call i32 @pick(i32 9, i32 7)\n"
+        "  %s = add i32 %a, %b\n"
+        "  %t = add i32 %s, %c\n"
+        "  %u = add i32 %t, %d\n"
+        "  ret %u\n"
+        "}\n",
+        nullptr);
+    REQUIRE(module != nullptr);
+    REQUIRE(verify_module(*module, nullptr));
+    std::string error;
+    std::string text = backend::emit_llvm_ir(*module, {}, &error);
+    INFO(error);
+    REQUIRE(text.find("define i32 @pick(i32 %0, i32 %1)") != std::string::npos);
+    backend::RunResult result = backend::run_jit(*module, {});
+    INFO(result.error);
+    REQUIRE(result.ok);
+    REQUIRE(result.value == 10 + 20 + 30 + 40);
+}
+
+TEST_CASE("codegen: a failed bounds check ends the JIT call, not the process") {
+    auto c = compile(R"CODE(
+        @noinline
+        get(i: i32): i32 { a: i32[4]; a[1] = 5; return a[i]; }
+        main(): i32 { return get(1) + get(9); }
+    )CODE", 2);
+    backend::RunResult failed = backend::run_jit(*c->module, {});
+    REQUIRE_FALSE(failed.ok);
+    REQUIRE(failed.error == "index 9 out of bounds for length 4");
+
+    auto ok = compile("main(): i32 { a: i32[4]; a[3] = 7; return a[3]; }", 0);
+    backend::RunResult result = backend::run_jit(*ok->module, {});
+    REQUIRE(result.ok);
+    REQUIRE(result.value == 7);
+}
+
+TEST_CASE("codegen: a slice out of bounds fails like it does in the interpreter") {
+    auto c = compile(R"CODE(
+        @noinline
+        cut(begin: i64, end: i64): i64 {
+            s: string = "abc";
+            t: string = s.slice(begin, end);
+            return t.len();
+        }
+        main(): i32 { n: i64 = cut(1, 3) + cut(2, 1); return 0; }
+    )CODE", 2);
+    backend::RunResult compiled = backend::run_jit(*c->module, {});
+    REQUIRE_FALSE(compiled.ok);
+    REQUIRE(compiled.error == "slice [2, 1) out of bounds for length 3");
+    Interpreter interpreter(*c->module);
+    ExecutionResult interpreted = interpreter.run("main");
+    REQUIRE_FALSE(interpreted.ok);
+    REQUIRE(interpreted.error == compiled.error);
+}
+
+TEST_CASE("codegen: 128-bit integers are formatted in full in string interpolation") {
+    auto c = compile(R"CODE(
+        main(): i32 {
+            one: i128 = 1;
+            big: i128 = (one << 127) - 1;
+            small: i128 = -big - 1;
+            top: u128 = (u128) 0 - (u128) 1;
+            println("${big} ${small} ${top} ${(i128) -42} ${(u128) 0}");
+            return 0;
+        }
+    )CODE", 2);
+    std::string printed;
+    runtime::set_output_capture(&printed);
+    backend::RunResult result = backend::run_jit(*c->module, {});
+    runtime::set_output_capture(nullptr);
+    INFO(result.error);
+    REQUIRE(result.ok);
+    REQUIRE(printed ==
+            "170141183460469231731687303715884105727 -170141183460469231731687303715884105728 "
+            "340282366920938463463374607431768211455 -42 0\n");
+}
+
+TEST_CASE("codegen: large modules are split into objects generated in parallel") {
+    std::string code;
+    std::string sum = "0";
+    for (int i = 0; i < 40; ++i) {
+        code += "@noinline\nfn" + std::to_string(i) + "(x: i32): i32 { return x * " +
+                std::to_string(i) + "; }\n";
+        sum += " + fn" + std::to_string(i) + "(1)";
+    }
+    code += "main(): i32 { return " + sum + "; }\n";
+    auto c = compile(code, 1);
+
+    std::filesystem::path dir = std::filesystem::temp_directory_path() / "pallas_codegen_tests";
+    std::filesystem::create_directories(dir);
+    for (unsigned partitions : {1u, 4u, 64u}) {
+        backend::CodegenOptions options;
+        options.opt_level = 2;
+        options.partitions = partitions;
+        std::vector<std::string> written;
+        std::string error;
+        REQUIRE(backend::emit_object(*c->module, (dir / "out.o").string(), options, &written,
+                                     &error));
+        // At most one partition per kMinFunctionsPerPartition functions.
+        REQUIRE(written.size() == (partitions == 1 ? 1 : partitions == 4 ? 4 : 5));
+        REQUIRE(written[0] == (dir / "out.o").string());
+        for (const std::string& path : written) {
+            std::ifstream object(path, std::ios::binary);
+            char magic[4] = {};
+            object.read(magic, 4);
+            REQUIRE(std::string(magic, 4) == "\x7f" "ELF");
+        }
+    }
+    std::filesystem::remove_all(dir);
+}
+
+#endif  // PALLAS_HAVE_LLVM
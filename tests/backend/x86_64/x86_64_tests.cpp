@@ -0,0 +1,322 @@
+#include <catch2/catch_test_macros.hpp>
+#include <memory>
+#include <string>
+#include "backend/codegen.h"
+#include "backend/x86_64.h"
+#include "middle/interpreter.h"
+#include "middle/passes.h"
+#include "tests/support/compile_helpers.h"
+
+using namespace pallas;
+using namespace pallas::middle;
+using namespace pallas::test;
+
+namespace {
+
+// compile() at -O`level`, then scalarized as palc does for this backend.
+std::unique_ptr<Compiled> scalarized(const std::string& code, int level) {
+    auto out = compile(code, level);
+    PassManager manager;
+    REQUIRE(add_pass_by_name(manager, "scalarize"));
+    REQUIRE(manager.run(*out->module));
+    return out;
+}
+
+std::string emit(const Module& module) {
+    std::string error;
+    std::string object = backend::emit_x86_object(module, &error);
+    INFO(error);
+    REQUIRE(!object.empty());
+    return object;
+}
+
+const char* const kPrograms[] = {
+    R"CODE(
+        class Node {
+            public:
+                value: i32;
+                next: Node*;
+                Node(v: i32, n: Node*) { value = v; next = n; }
+        }
+        @noinline
+        fib(n: i32): i64 { if (n < 2) { return (i64) n; } return fib(n - 1) + fib(n - 2); }
+        main(): i32 {
+            head: Node* = null;
+            for (i: i32 = 0; i < 10; i++) { head = new Node(i, head); }
+            t: i32 = 0;
+            while (head != null) {
+                t += head.value;
+                next: Node* = head.next;
+                delete head;
+                head = next;
+            }
+            arena(64) {
+                for (i: i32 = 0; i < 100; i++) { t += new Node(i, null).value % 3; }
+            }
+            return t + (i32) (fib(20) % 100);
+        }
+    )CODE",
+    R"CODE(
+        @noinline
+        kind(x: i32): i32 {
+            match (x) {
+                0 => { return 10; }
+                1 => { return 11; }
+                2 => { return 12; }
+                3 => { return 13; }
+                1000 => { return 15; }
+                _ => { return 16; }
+            }
+            return 0;
+        }
+        @noinline
+        word(s: char*): i32 {
+            match (s) {
+                "go" => { return 1; }
+                "pallas" => { return 2; }
+                _ => { return 4; }
+            }
+            return 0;
+        }
+        main(): i32 {
+            s: char* = new char[3];
+            s[0] = 'g'; s[1] = 'o';
+            r: i32 = kind(3) + kind(1000) + kind(-1) + word(s) * 100 + word(null) * 50;
+            delete s;
+            return r;
+        }
+    )CODE",
+    // Vectorized at -O2 and up, then scalarized again.
+    R"CODE(
+        main(): i32 {
+            a: i8[300];
+            b: i8[300];
+            for (i: i32 = 0; i < 300; i++) { a[i] = (i8)i; b[i] = (i8)(3 * i); }
+            for (i: i32 = 0; i < 300; i++) { a[i] = a[i] + b[i] ^ (i8)5; }
+            total: i32 = 0;
+            for (x : a) { total += (i32)x; }
+            return total;
+        }
+    )CODE",
+    R"CODE(
+        main(): i32 {
+            a: f32[400];
+            b: f64[400];
+            for (i: i32 = 0; i < 400; i++) { a[i] = (f32)i * 0.5; b[i] = (f64)i / 3.0; }
+            for (i: i32 = 0; i < 400; i++) { a[i] = a[i] * 1.25 + 2.0; b[i] = b[i] - 1.0; }
+            return (i32)a[399] + (i32)a[17] + (i32)b[300];
+        }
+    )CODE",
+    // Stack arguments, signed arithmetic and more live values than registers.
+    R"CODE(
+        @noinline
+        mix(a: i32, b: i64, c: f64, d: i8, e: i16, f: f32, g: i32, h: i64, i: i32, j: f64): i64 {
+            return (i64)a - b + (i64)c + (i64)d * (i64)e + (i64)f - (i64)g / 3 + h % 7 + (i64)i
+                   + (i64)j;
+        }
+        @noinline
+        divide(a: i32, b: i32): i32 { return a / b + a % b + (a >> 2) + (a << 3); }
+        main(): i32 {
+            x: i64 = mix(-5, 12, 2.75, (i8)-3, (i16)7, 1.5, -100, 1000003, 9, -4.5);
+            y: i32 = divide(-17, 4) + divide(23, -5);
+            s0: i64 = 1; s1: i64 = 2; s2: i64 = 3; s3: i64 = 4; s4: i64 = 5; s5: i64 = 6;
+            s6: i64 = 7; s7: i64 = 8; s8: i64 = 9; s9: i64 = 10; s10: i64 = 11; s11: i64 = 12;
+            for (k: i32 = 0; k < 20; k++) {
+                s0 = s0 * 3 + s11; s1 = s1 + s0; s2 = s2 ^ s1; s3 = s3 + s2 % 11;
+                s4 = s4 - s3; s5 = s5 + s4 * 2; s6 = s6 + s5; s7 = s7 ^ s6;
+                s8 = s8 + s7 % 13; s9 = s9 - s8; s10 = s10 + s9; s11 = s11 % 1000 + s10 % 17;
+            }
+            t: i64 = s0 + s1 + s2 + s3 + s4 + s5 + s6 + s7 + s8 + s9 + s10 + s11;
+            u: u64 = (u64)t * 2654435761;
+            f: f64 = (f64)(u >> 1) / 1000.0;
+            return (i32)(x + (i64)y + t % 1000 + (i64)(f < 0.0) + (i64)(u % 97));
+        }
+    )CODE",
+    // Interpolated text is written with 64-bit constant stores.
+    R"CODE(
+        @noinline
+        label(n: i32, ok: bool): char* { return "n=${n} ok=${ok} big=${(i64)n * 1000000007}!"; }
+        main(): i32 {
+            s: char* = label(-42, false);
+            h: i64 = 0;
+            for (i: i32 = 0; (i32)s[i] != 0; i++) { h = h * 31 + (i64)s[i]; }
+            delete s;
+            return (i32)((h ^ 81985529216486895) % 100000);
+        }
+    )CODE",
+    // Strings and Vecs call the runtime to grow and read their fields inline.
+    R"CODE(
+        main(): i32 {
+            v: Vec<i64> = Vec<i64>(4);
+            s: string = "";
+            for (i: i32 = 0; i < 300; i++) {
+                v.push((i64)i * 7);
+                s += "${i % 10}";
+            }
+            t: string = s.slice(5, 40);
+            h: i64 = 0;
+            for (x : v) { h = h * 31 + x; }
+            for (c : t) { h = h * 31 + (i64)c; }
+            return (i32)((h ^ v.pop()) % 100000) + (i32)s.len();
+        }
+    )CODE",
+};
+
+}  // namespace
+
+#ifdef PALLAS_HAVE_LLVM
+
+TEST_CASE("x86_64: compiled programs return what the interpreter computes") {
+    for (const char* code : kPrograms) {
+        for (int level = 0; level <= 3; ++level) {
+            auto c = scalarized(code, level);
+            Interpreter interpreter(*c->module);
+            ExecutionResult expected = interpreter.run("main");
+            INFO(expected.error);
+            REQUIRE(expected.ok);
+            backend::RunResult result = backend::run_object(*c->module, emit(*c->module));
+            INFO("level " << level << ": " << result.error);
+            REQUIRE(result.ok);
+            REQUIRE(result.value == expected.value);
+        }
+    }
+}
+
+TEST_CASE("x86_64: phis, switches and parallel moves from textual IR") {
+    // The loop swaps its phis every iteration, so the edge moves form a cycle.
+    auto module = parse_module(
+        "func @pick(i32 %x, i32 %y) -> i32 {\n"
+        "entry:\n"
+        "  switch %x, default [i32 1, one] [i32 2, two] [i32 1, two] [%y, other]\n"
+        "one:\n"
+        "  br join\n"
+        "two:\n"
+        "  br join\n"
+        "other:\n"
+        "  br join\n"
+        "default:\n"
+        "  br join\n"
+        "join:\n"
+        "  %r = phi i32 [i32 10, one], [i32 20, two], [i32 30, other], [i32 40, default]\n"
+        "  ret %r\n"
+        "}\n"
+        "func @swap(i64 %n) -> i64 {\n"
+        "entry:\n"
+        "  br loop\n"
+        "loop:\n"
+        "  %a = phi i64 [i64 1, entry], [%b, loop]\n"
+        "  %b = phi i64 [i64 100, entry], [%a, loop]\n"
+        "  %i = phi i64 [i64 0, entry], [%j, loop]\n"
+        "  %j = add i64 %i, i64 1\n"
+        "  %c = icmp ult %j, %n\n"
+        "  condbr %c, loop, exit\n"
+        "exit:\n"
+        "  %r = mul i64 %a, i64 1000\n"
+        "  %s = add i64 %r, %b\n"
+        "  ret %s\n"
+        "}\n"
+        "func @main() -> i64 {\n"
+        "entry:\n"
+        "  %a = call i32 @pick(i32 1, i32 7)\n"
+        "  %b = call i32 @pick(i32 2, i32 7)\n"
+        "  %c = call i32 @pick(i32 7, i32 7)\n"
+        "  %d = call i32 @pick(i32 9, i32 7)\n"
+        "  %s = add i32 %a, %b\n"
+        "  %t = add i32 %s, %c\n"
+        "  %u = add i32 %t, %d\n"
+        "  %w = zext i64 %u\n"
+        "  %x = call i64 @swap(i64 5)\n"
+        "  %y = mul i64 %w, i64 1000000\n"
+        "  %z = add i64 %y, %x\n"
+        "  ret %z\n"
+        "}\n",
+        nullptr);
+    REQUIRE(module != nullptr);
+    REQUIRE(verify_module(*module, nullptr));
+    backend::RunResult result = backend::run_object(*module, emit(*module));
+    INFO(result.error);
+    REQUIRE(result.ok);
+    // Four swaps leave the phis as they started.
+    REQUIRE(result.value == 100 * 1000000 + 1 * 1000 + 100);
+    REQUIRE(result.value == Interpreter(*module).run("main").value);
+}
+
+TEST_CASE("x86_64: a failed bounds check ends the call, not the process") {
+    auto c = scalarized(R"CODE(
+        @noinline
+        get(i: i32): i32 { a: i32[4]; a[1] = 5; return a[i]; }
+        main(): i32 { return get(1) + get(9); }
+    )CODE", 0);
+    backend::RunResult failed = backend::run_object(*c->module, emit(*c->module));
+    REQUIRE_FALSE(failed.ok);
+    REQUIRE(failed.error == "index 9 out of bounds for length 4");
+}
+
+#endif  // PALLAS_HAVE_LLVM
+
+TEST_CASE("x86_64: registers assigned on several threads give the same object") {
+    std::string code;
+    std::string sum = "0";
+    for (int i = 0; i < 24; ++i) {
+        code += "@noinline\nfn" + std::to_string(i) + "(x: i32, y: f64): i32 { return x * " +
+                std::to_string(i) + " + (i32) (y * 1.5); }\n";
+        sum += " + fn" + std::to_string(i) + "(1, 2.0)";
+    }
+    code += "main(): i32 { return " + sum + "; }\n";
+    auto c = scalarized(code, 1);
+    std::string serial = emit(*c->module);
+    for (unsigned threads : {0u, 4u}) {
+        std::string error;
+        INFO(threads);
+        REQUIRE(backend::emit_x86_object(*c->module, &error, threads) == serial);
+    }
+    // The first failing function in module order is reported, whichever
+    // thread planned it.
+    auto vectors = parse_module(
+        "func @a() -> i32 {\n"
+        "entry:\n"
+        "  %v = splat <4 x i32> i32 1\n"
+        "  %e = extract i32 %v, i32 0\n"
+        "  ret %e\n"
+        "}\n"
+        "func @b() -> i32 {\n"
+        "entry:\n"
+        "  %v = splat <2 x i64> i64 1\n"
+        "  %e = extract i64 %v, i32 0\n"
+        "  %t = trunc i32 %e\n"
+        "  ret %t\n"
+        "}\n",
+        nullptr);
+    REQUIRE(vectors != nullptr);
+    std::string error;
+    REQUIRE(backend::emit_x86_object(*vectors, &error, 4).empty());
+    REQUIRE(error.find("'@a'") != std::string::npos);
+}
+
+TEST_CASE("x86_64: objects are ELF relocatables with global and local symbols") {
+    auto c = scalarized(R"CODE(
+        @noinline
+        twice(x: i32): i32 { return x * 2; }
+        main(): i32 { return twice(21); }
+    )CODE", 1);
+    std::string object = emit(*c->module);
+    REQUIRE(object.substr(0, 4) == "\x7f" "ELF");
+    REQUIRE(object[4] == 2);    // 64-bit
+    REQUIRE(object[16] == 1);   // ET_REL
+    REQUIRE(object[18] == 62);  // EM_X86_64
+    REQUIRE(object.find(std::string("twice\0", 6)) != std::string::npos);
+    REQUIRE(object.find(".rela.text") != std::string::npos);
+
+    auto vectors = parse_module(
+        "func @main() -> i32 {\n"
+        "entry:\n"
+        "  %v = splat <4 x i32> i32 1\n"
+        "  %e = extract i32 %v, i32 0\n"
+        "  ret %e\n"
+        "}\n",
+        nullptr);
+    REQUIRE(vectors != nullptr);
+    std::string error;
+    REQUIRE(backend::emit_x86_object(*vectors, &error).empty());
+    REQUIRE(error.find("scalarize") != std::string::npos);
+}
@@ -0,0 +1,127 @@
+#include <catch2/catch_test_macros.hpp>
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+
+namespace {
+
+// Runs a shell command and returns what it printed on stdout.
+std::string output_of(const std::string& command) {
+    std::string text;
+    FILE* pipe = popen(command.c_str(), "r");
+    REQUIRE(pipe != nullptr);
+    char buffer[256];
+    for (std::size_t n; (n = std::fread(buffer, 1, sizeof(buffer), pipe)) > 0;) {
+        text.append(buffer, n);
+    }
+    pclose(pipe);
+    return text;
+}
+
+// A compile server on a socket in a directory of its own, stopped and removed
+// however the test ends.
+class Server {
+  public:
+    explicit Server(const std::string& name)
+        : directory(std::filesystem::temp_directory_path() /
+                    (name + '_' + std::to_string(getpid()))),
+          palc(PALC_PATH) {
+        std::filesystem::remove_all(directory);
+        std::filesystem::create_directories(directory);
+        socket = directory / "server.sock";
+        client = "cd '" + directory.string() + "' && '" + palc + "' --client='" +
+                 socket.string() + "' ";
+    }
+
+    ~Server() {
+        std::system(("'" + palc + "' --stop-server='" + socket.string() + "' 2>/dev/null").c_str());
+        std::filesystem::remove_all(directory);
+    }
+
+    void start() {
+        std::string server = "'" + palc + "' --server='" + socket.string() + "'";
+        REQUIRE(std::system((server + " </dev/null >/dev/null 2>&1 &").c_str()) == 0);
+        // A client compiles by itself until the server listens.
+        for (int attempt = 0; attempt < 500 && !std::filesystem::exists(socket); ++attempt) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        REQUIRE(std::filesystem::exists(socket));
+    }
+
+    std::filesystem::path directory;
+    std::string palc;
+    std::filesystem::path socket;
+    std::string client;  // command prefix to compile through the server
+};
+
+}  // namespace
+
+TEST_CASE("server cache: -flto is part of the key of a cached module") {
+    Server server("pallas_server_cache_tests");
+    std::ofstream(server.directory / "lt.pal") << R"CODE(
+        unused(x: i32): i32 { return x * 3; }
+        @noinline
+        helper(x: i32): i32 { return x + 1; }
+        main(): i32 { return helper(4); }
+    )CODE";
+    server.start();
+    const std::string& client = server.client;
+
+    std::string plain = output_of(client + "-O2 --emit-ir lt.pal");
+    REQUIRE(plain.find("@unused") != std::string::npos);
+    for (int round = 0; round < 2; ++round) {
+        std::string lto = output_of(client + "-O2 -flto --emit-ir lt.pal");
+        REQUIRE(lto.find("@main") != std::string::npos);
+        REQUIRE(lto.find("@unused") == std::string::npos);
+    }
+    REQUIRE(output_of(client + "-O2 --emit-ir lt.pal") == plain);
+}
+
+TEST_CASE("server cache: modules of a program with imports are rebuilt when a file changes") {
+    Server server("pallas_server_import_tests");
+    auto write = [&](const std::string& name, const std::string& code) {
+        std::ofstream(server.directory / name) << code;
+    };
+    write("lib.pal", R"CODE(
+        @noinline
+        value(x: i32): i32 {
+            match (x) {
+                1 => { return 40; }
+                1 => { return 2; }
+                other => { return 41; }
+            }
+        }
+    )CODE");
+    write("main.pal", R"CODE(
+        import "lib";
+        main(): i32 { return value(3); }
+    )CODE");
+    server.start();
+    std::string compile = server.client + "-O2 --emit-ir main.pal 2>&1";
+
+    std::string first = output_of(compile);
+    REQUIRE(first.find("ret i32 41") != std::string::npos);
+    REQUIRE(first.find("lib.pal:6:17: warning: unreachable match arm") != std::string::npos);
+    // From the cached modules: the same IR, and the warning again.
+    REQUIRE(output_of(compile) == first);
+
+    write("lib.pal", R"CODE(
+        @noinline
+        value(x: i32): i32 { return x + 43; }
+    )CODE");
+    std::string edited = output_of(compile);
+    REQUIRE(edited.find("ret i32 41") == std::string::npos);
+    REQUIRE(edited.find("warning") == std::string::npos);
+    REQUIRE(edited.find("add i32") != std::string::npos);
+
+    write("main.pal", R"CODE(
+        import "lib";
+        main(): i32 { return value(7) - 50; }
+    )CODE");
+    REQUIRE(std::system((server.client + "run -O2 main.pal").c_str()) == 0);
+}
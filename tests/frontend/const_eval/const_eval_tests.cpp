@@ -0,0 +1,179 @@
+#include <catch2/catch_test_macros.hpp>
+#include <memory>
+#include <optional>
+#include <string>
+#include "frontend/const_eval.h"
+#include "frontend/parser.h"
+#include "frontend/scanner.h"
+
+using namespace pallas::frontend;
+
+static std::unique_ptr<ModuleAST> parse(const std::string& code) {
+    Scanner scanner(code);
+    Parser parser(scanner.get_tokens());
+    return parser.parse_module();
+}
+
+TEST_CASE("const eval: arithmetic and references to other constants") {
+    auto module = parse(R"CODE(
+        const A: i64 = 16;
+        const B: i64 = A * 4 + 2;
+        const C: u8 = 200 + 55;
+        const NAME: string = "Pal" + "las";
+        const HALF: f64 = 1.0 / 2.0;
+    )CODE");
+    Diagnostics diag;
+    ConstEvaluator eval(*module, &diag);
+
+    REQUIRE(eval.evaluate_const("B")->as_signed() == 66);
+    REQUIRE(eval.evaluate_const("C")->as_unsigned() == 255);
+    REQUIRE(eval.evaluate_const("NAME")->text == "Pallas");
+    REQUIRE(eval.evaluate_const("HALF")->real == 0.5);
+    REQUIRE(diag.size() == 0);
+}
+
+TEST_CASE("const eval: overflow is exact for every integer width") {
+    auto module = parse(R"CODE(
+        const A: u8 = 255 + 1;
+        const B: i8 = -128;
+        const C: i8 = -128 - 1;
+        const D: i128 = 170141183460469231731687303715884105727;
+        const E: i128 = D + 1;
+        const F: u128 = 340282366920938463463374607431768211455;
+        const G: i32 = -2147483648 / -1;
+    )CODE");
+    Diagnostics diag;
+    ConstEvaluator eval(*module, &diag);
+
+    REQUIRE_FALSE(eval.evaluate_const("A").has_value());
+    REQUIRE(diag.all().back().code == ErrorCode::E302_CONST_OVERFLOW);
+    REQUIRE(eval.evaluate_const("B")->as_signed() == -128);
+    REQUIRE_FALSE(eval.evaluate_const("C").has_value());
+    REQUIRE(eval.evaluate_const("D").has_value());
+    REQUIRE_FALSE(eval.evaluate_const("E").has_value());
+    REQUIRE(eval.evaluate_const("F")->as_unsigned() == ~static_cast<u128>(0));
+    REQUIRE_FALSE(eval.evaluate_const("G").has_value());
+}
+
+TEST_CASE("const eval: calls to pure functions are evaluated and memoized") {
+    auto module = parse(R"CODE(
+        square(n: i64): i64 { return n * n; }
+        fib(n: u64): u64 {
+            if (n < 2) { return n; }
+            return fib(n - 1) + fib(n - 2);
+        }
+        sum_to(n: i32): i32 {
+            total: i32 = 0;
+            for (i: i32 = 1; i <= n; i++) { total += i; }
+            return total;
+        }
+        const SQ: i64 = square(12);
+        const FIB: u64 = fib(90);
+        const SUM: i32 = sum_to(100);
+    )CODE");
+    Diagnostics diag;
+    ConstEvaluator eval(*module, &diag);
+
+    REQUIRE(eval.evaluate_const("SQ")->as_signed() == 144);
+    REQUIRE(eval.evaluate_const("FIB")->as_unsigned() == 2880067194370816120ULL);
+    REQUIRE(eval.evaluate_const("SUM")->as_signed() == 5050);
+    REQUIRE(eval.stats().call_cache_hits > 0);
+
+    // A second lookup is served from the per-symbol cache.
+    std::uint64_t steps = eval.stats().steps;
+    REQUIRE(eval.evaluate_const("FIB").has_value());
+    REQUIRE(eval.stats().steps == steps);
+    REQUIRE(diag.size() == 0);
+}
+
+TEST_CASE("const eval: budgets stop runaway evaluation") {
+    auto module = parse(R"CODE(
+        spin(): i32 { while (true) { } return 0; }
+        deep(n: i64): i64 { return deep(n + 1); }
+        const A: i32 = spin();
+        const B: i64 = deep(0);
+    )CODE");
+
+    Diagnostics diag;
+    ConstEvalLimits limits;
+    limits.max_steps = 10000;
+    ConstEvaluator eval(*module, &diag, limits);
+    REQUIRE_FALSE(eval.evaluate_const("A").has_value());
+    REQUIRE(diag.all().back().code == ErrorCode::E305_CONST_BUDGET_EXCEEDED);
+
+    Diagnostics diag2;
+    ConstEvaluator eval2(*module, &diag2);
+    REQUIRE_FALSE(eval2.evaluate_const("B").has_value());
+    REQUIRE(diag2.all().back().code == ErrorCode::E305_CONST_BUDGET_EXCEEDED);
+}
+
+TEST_CASE("const eval: cycles and non-constant initializers are rejected") {
+    auto module = parse(R"CODE(
+        const A: i32 = B + 1;
+        const B: i32 = A + 1;
+        const C: i32 = runtime_value;
+        const D: i32 = 1 / 0;
+        const E: i64 = (i64)3 + (i32)4;
+    )CODE");
+    Diagnostics diag;
+    ConstEvaluator eval(*module, &diag);
+
+    REQUIRE_FALSE(eval.evaluate_const("A").has_value());
+    REQUIRE(diag.all().back().code == ErrorCode::E304_CONST_CYCLE);
+    REQUIRE_FALSE(eval.evaluate_const("C").has_value());
+    REQUIRE(diag.all().back().code == ErrorCode::E301_NOT_CONSTANT);
+    REQUIRE_FALSE(eval.evaluate_const("D").has_value());
+    REQUIRE(diag.all().back().code == ErrorCode::E303_CONST_DIVISION_BY_ZERO);
+    REQUIRE_FALSE(eval.evaluate_const("E").has_value());
+    REQUIRE(diag.all().back().code == ErrorCode::E307_CONST_TYPE_MISMATCH);
+}
+
+TEST_CASE("const eval: null initializes pointers and nothing else") {
+    auto module = parse(R"CODE(
+        struct Pt { x: i32; }
+        g: Pt* = null;
+        h: i32 = null;
+    )CODE");
+    Diagnostics diag;
+    ConstEvaluator eval(*module, &diag);
+    const auto& g = static_cast<const VarDeclAST&>(*module->decls[1]);
+    const auto& h = static_cast<const VarDeclAST&>(*module->decls[2]);
+
+    std::optional<ConstValue> pointer = eval.evaluate(*g.init, g.type.get());
+    REQUIRE(pointer.has_value());
+    REQUIRE(pointer->type == TypeKind::TYPE_POINTER);
+    REQUIRE(pointer->bits == 0);
+    REQUIRE(pointer->to_string() == "null");
+    REQUIRE(diag.size() == 0);
+    REQUIRE_FALSE(eval.evaluate(*h.init, h.type.get()).has_value());
+    REQUIRE(diag.all().back().code == ErrorCode::E307_CONST_TYPE_MISMATCH);
+}
+
+TEST_CASE("const eval: array sizes become known statically") {
+    auto module = parse(R"CODE(
+        const BUFSZ: i64 = 16;
+        arr: i32[BUFSZ];
+        struct Grid { cells: u8[BUFSZ * BUFSZ]; }
+        main(): void {
+            const N: i32 = 4;
+            local: f32[N];
+            bad: i32[BUFSZ - 20];
+        }
+    )CODE");
+    Diagnostics diag;
+    ConstEvaluator eval(*module, &diag);
+    eval.resolve_array_sizes(*module);
+
+    const auto& arr = static_cast<const VarDeclAST&>(*module->decls[1]);
+    REQUIRE(arr.type->size_known);
+    REQUIRE(arr.type->array_size == 16);
+
+    const auto& grid = static_cast<const StructDeclAST&>(*module->decls[2]);
+    REQUIRE(grid.fields[0].type->array_size == 256);
+
+    const auto& body = static_cast<const FunctionAST&>(*module->decls[3]).body->statements;
+    REQUIRE(static_cast<const VarDeclAST&>(*body[1]).type->array_size == 4);
+    REQUIRE_FALSE(static_cast<const VarDeclAST&>(*body[2]).type->size_known);
+    REQUIRE(diag.size() == 1);
+    REQUIRE(diag.all()[0].code == ErrorCode::E306_INVALID_ARRAY_SIZE);
+}
@@ -0,0 +1,183 @@
+#include <catch2/catch_test_macros.hpp>
+#include <memory>
+#include <string>
+#include "frontend/parser.h"
+#include "frontend/scanner.h"
+
+using namespace pallas::frontend;
+
+static std::unique_ptr<ModuleAST> parse(const std::string& code, Diagnostics* diag = nullptr) {
+    Scanner scanner(code, diag);
+    Parser parser(scanner.get_tokens(), diag);
+    return parser.parse_module();
+}
+
+TEST_CASE("parser: top-level declarations") {
+    Diagnostics diag;
+    auto module = parse(R"CODE(
+        import "std/io";
+        const BUFSZ: i64 = 16;
+        arr: i32[BUFSZ];
+        type IntVec = Vec<i32>;
+        struct Vector3 { x: f32; y: f32; z: f32; }
+        add(a: i32, b: i32): i32 { return a + b; }
+    )CODE",
+                        &diag);
+
+    REQUIRE(diag.size() == 0);
+    REQUIRE(module->decls.size() == 6);
+    REQUIRE(module->decls[0]->kind == NodeType::NODE_IMPORT);
+    REQUIRE(module->decls[1]->kind == NodeType::NODE_CONST);
+    REQUIRE(module->decls[2]->kind == NodeType::NODE_VAR_DECL);
+    REQUIRE(module->decls[3]->kind == NodeType::NODE_TYPE_ALIAS);
+    REQUIRE(module->decls[4]->kind == NodeType::NODE_STRUCT);
+    REQUIRE(module->decls[5]->kind == NodeType::NODE_FUNCTION);
+
+    const auto& arr = static_cast<const VarDeclAST&>(*module->decls[2]);
+    REQUIRE(arr.type->kind == TypeKind::TYPE_ARRAY);
+    REQUIRE(arr.type->element->kind == TypeKind::TYPE_I32);
+    REQUIRE(arr.type->size_expr->kind == ExprKind::EXPR_VARIABLE);
+
+    const auto& vec = static_cast<const StructDeclAST&>(*module->decls[4]);
+    REQUIRE(vec.fields.size() == 3);
+    REQUIRE(vec.fields[2].name == "z");
+
+    const auto& add = static_cast<const FunctionAST&>(*module->decls[5]);
+    REQUIRE(add.proto->get_name() == "add");
+    REQUIRE(add.proto->params.size() == 2);
+    REQUIRE(add.proto->return_type->kind == TypeKind::TYPE_I32);
+}
+
+TEST_CASE("parser: class members and visibility sections") {
+    Diagnostics diag;
+    auto module = parse(R"CODE(
+        class Person {
+            public:
+                name: string;
+                age: i32;
+                Person(n: string, a: i32) { name = n; age = a; }
+                ~Person() { }
+                greet(): void { }
+            private:
+                ssn: string;
+        }
+    )CODE",
+                        &diag);
+
+    REQUIRE(diag.size() == 0);
+    const auto& person = static_cast<const StructDeclAST&>(*module->decls[0]);
+    REQUIRE(person.is_class);
+    REQUIRE(person.fields.size() == 3);
+    REQUIRE(person.fields[2].visibility == Visibility::VISIBILITY_PRIVATE);
+    REQUIRE(person.methods.size() == 3);
+    REQUIRE(person.methods[0]->proto->function_kind == FunctionKind::FUNCTION_CONSTRUCTOR);
+    REQUIRE(person.methods[1]->proto->function_kind == FunctionKind::FUNCTION_DESTRUCTOR);
+    REQUIRE(person.methods[2]->proto->function_kind == FunctionKind::FUNCTION_METHOD);
+}
+
+TEST_CASE("parser: operator precedence") {
+    Scanner scanner("a + b * c == d && !e");
+    Parser parser(scanner.get_tokens());
+    auto expr = parser.parse_expression();
+
+    REQUIRE(expr->kind == ExprKind::EXPR_BINARY);
+    const auto& land = static_cast<const BinaryExprAST&>(*expr);
+    REQUIRE(land.op == TokenType::TOKEN_LOGICAL_AND);
+    REQUIRE(land.rhs->kind == ExprKind::EXPR_UNARY);
+    const auto& eq = static_cast<const BinaryExprAST&>(*land.lhs);
+    REQUIRE(eq.op == TokenType::TOKEN_EQUAL);
+    const auto& plus = static_cast<const BinaryExprAST&>(*eq.lhs);
+    REQUIRE(plus.op == TokenType::TOKEN_PLUS);
+    REQUIRE(static_cast<const BinaryExprAST&>(*plus.rhs).op == TokenType::TOKEN_STAR);
+}
+
+TEST_CASE("parser: generic calls, casts and nested type arguments") {
+    Diagnostics diag;
+    auto module = parse(R"CODE(
+        main(): void {
+            n: i32 = identity<i32>(42);
+            m: i64 = (i64)n;
+            v: Vec<Vec<i32>> = Vec<Vec<i32>>();
+            b: bool = n < m;
+        }
+    )CODE",
+                        &diag);
+
+    REQUIRE(diag.size() == 0);
+    const auto& fn = static_cast<const FunctionAST&>(*module->decls[0]);
+    const auto& stmts = fn.body->statements;
+    REQUIRE(stmts.size() == 4);
+
+    const auto& n = static_cast<const VarDeclAST&>(*stmts[0]);
+    REQUIRE(n.init->kind == ExprKind::EXPR_CALL);
+    REQUIRE(static_cast<const CallExprAST&>(*n.init).type_args.size() == 1);
+
+    const auto& m = static_cast<const VarDeclAST&>(*stmts[1]);
+    REQUIRE(m.init->kind == ExprKind::EXPR_CAST);
+
+    const auto& v = static_cast<const VarDeclAST&>(*stmts[2]);
+    REQUIRE(v.type->args.size() == 1);
+    REQUIRE(v.type->args[0]->args.size() == 1);
+
+    const auto& b = static_cast<const VarDeclAST&>(*stmts[3]);
+    REQUIRE(b.init->kind == ExprKind::EXPR_BINARY);
+}
+
+TEST_CASE("parser: control flow statements") {
+    Diagnostics diag;
+    auto module = parse(R"CODE(
+        main(): void {
+            for (i: i32 = 0; i < 10; i++) { }
+            for (v : a) { }
+            while (counter < n) { counter++; }
+            match (x) {
+                1 => { }
+                name => { }
+                _ => { }
+            }
+            arena(4096) {
+                buf: i32* = new i32[64];
+            }
+            p: Foo* = new(arena) Foo(1, 2);
+            delete p;
+        }
+    )CODE",
+                        &diag);
+
+    REQUIRE(diag.size() == 0);
+    const auto& stmts = static_cast<const FunctionAST&>(*module->decls[0]).body->statements;
+    REQUIRE(stmts.size() == 7);
+    REQUIRE(stmts[0]->kind == NodeType::NODE_FOR);
+    REQUIRE(stmts[1]->kind == NodeType::NODE_RANGE_FOR);
+    REQUIRE(stmts[2]->kind == NodeType::NODE_WHILE);
+    REQUIRE(stmts[3]->kind == NodeType::NODE_MATCH);
+    REQUIRE(stmts[4]->kind == NodeType::NODE_ARENA);
+
+    const auto& match = static_cast<const MatchStmtAST&>(*stmts[3]);
+    REQUIRE(match.arms.size() == 3);
+    REQUIRE(match.arms[0].pattern == PatternKind::PATTERN_LITERAL);
+    REQUIRE(match.arms[1].pattern == PatternKind::PATTERN_IDENTIFIER);
+    REQUIRE(match.arms[2].pattern == PatternKind::PATTERN_WILDCARD);
+
+    const auto& arena = static_cast<const ArenaStmtAST&>(*stmts[4]);
+    const auto& buf = static_cast<const VarDeclAST&>(*arena.body->statements[0]);
+    const auto& alloc = static_cast<const NewExprAST&>(*buf.init);
+    REQUIRE(alloc.allocated->kind == TypeKind::TYPE_I32);
+    REQUIRE(alloc.count != nullptr);
+
+    const auto& p = static_cast<const VarDeclAST&>(*stmts[5]);
+    REQUIRE(static_cast<const NewExprAST&>(*p.init).arena != nullptr);
+}
+
+TEST_CASE("parser: errors are reported and parsing recovers") {
+    Diagnostics diag;
+    auto module = parse(R"CODE(
+        broken(): i32 { x: i32 = ; return 1; }
+        fine(): i32 { return 2; }
+    )CODE",
+                        &diag);
+
+    REQUIRE(diag.size() >= 1);
+    REQUIRE(diag.all()[0].code == ErrorCode::E202_EXPECTED_EXPRESSION);
+    REQUIRE(module->decls.size() == 2);
+}
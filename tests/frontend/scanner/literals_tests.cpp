@@ -75,4 +75,12 @@ TEST_CASE("string escapes preserved in lexeme") {
     REQUIRE(toks[0].lexeme.find("\\n") != std::string::npos);
     REQUIRE(toks[0].lexeme.find("\\t") != std::string::npos);
     REQUIRE(toks[0].lexeme.find("\\\"") != std::string::npos);
-}
\ No newline at end of file
+}
+TEST_CASE("interpolated parts may hold strings and braces") {
+    std::string code = "\"a ${f(\"}\", '{')} b ${ {1} } \\${c}\" x";
+    Scanner s(code);
+    auto toks = non_eof_tokens(s.get_tokens());
+    REQUIRE(toks.size() == 2);
+    REQUIRE(toks[0].type == TokenType::TOKEN_STRING_LITERAL);
+    REQUIRE(toks[1].lexeme == "x");
+}
@@ -0,0 +1,272 @@
+#include <catch2/catch_test_macros.hpp>
+#include <memory>
+#include <string>
+#include "frontend/diagnostics.h"
+#include "middle/interpreter.h"
+#include "middle/passes.h"
+#include "middle/transforms.h"
+#include "tests/support/compile_helpers.h"
+
+using namespace pallas;
+using namespace pallas::middle;
+using namespace pallas::test;
+
+namespace {
+
+ExecutionResult run(const Module& module) {
+    Interpreter interpreter(module);
+    ExecutionResult result = interpreter.run("main");
+    INFO(result.error);
+    REQUIRE(result.ok);
+    return result;
+}
+
+std::size_t count_calls(const Function& fn) {
+    std::size_t calls = 0;
+    for (BlockId b : fn.block_order()) {
+        for (ValueId v : fn.block_insts(b)) {
+            calls += fn.inst(v).op == Opcode::OP_CALL;
+        }
+    }
+    return calls;
+}
+
+// Microbenchmarks dominated by calls to small functions.
+const char* const kBenchmarks[] = {
+    R"CODE(
+        struct Vec2 { x: i64; y: i64; }
+        dot(a: Vec2, b: Vec2): i64 { return a.x * b.x + a.y * b.y; }
+        main(): i32 {
+            a: Vec2;
+            b: Vec2;
+            total: i64 = 0;
+            for (i: i64 = 0; i < 1000; i++) {
+                a.x = i; a.y = i + 1; b.x = 2; b.y = 3;
+                total += dot(a, b);
+            }
+            return (i32)(total % 251);
+        }
+    )CODE",
+    R"CODE(
+        clamp(v: i32, lo: i32, hi: i32): i32 {
+            if (v < lo) { return lo; }
+            if (v > hi) { return hi; }
+            return v;
+        }
+        main(): i32 {
+            total: i32 = 0;
+            for (i: i32 = 0; i < 2000; i++) { total += clamp(i % 300, 10, 200); }
+            return total % 251;
+        }
+    )CODE",
+    R"CODE(
+        abs(v: i64): i64 { if (v < 0) { return -v; } return v; }
+        dist(a: i64, b: i64): i64 { return abs(a - b); }
+        main(): i32 {
+            sum: i64 = 0;
+            for (i: i64 = 0; i < 1500; i++) { sum += dist(i * 7 % 101, 50); }
+            return (i32)(sum % 251);
+        }
+    )CODE",
+};
+
+}  // namespace
+
+TEST_CASE("lower: loops, structs and arrays run in the interpreter") {
+    auto c = compile(R"CODE(
+        struct Point { x: i32; y: i32; }
+        const N: i32 = 4;
+        counter: i32 = 5;
+        sq(n: i32): i32 { return n * n; }
+        manhattan(p: Point): i32 { return p.x + p.y; }
+        fib(n: i32): i32 { if (n < 2) { return n; } return fib(n - 1) + fib(n - 2); }
+        main(): i32 {
+            total: i32 = 0;
+            for (i: i32 = 0; i < 10; i++) {
+                total += sq(i);
+                if (total > 100 && i != 3) { total -= 1; }
+            }
+            p: Point;
+            p.x = 3;
+            p.y = 4;
+            arr: i32[N] = [1, 2, 3, 4];
+            j: i32 = 0;
+            while (j < N) { total += arr[j]; j++; }
+            counter += 1;
+            return total + manhattan(p) + fib(10) + counter - 300;
+        }
+    )CODE");
+    REQUIRE(c->diagnostics.all().empty());
+    std::string error;
+    REQUIRE(verify_module(*c->module, &error));
+    REQUIRE(run(*c->module).value == 60);
+}
+
+TEST_CASE("lower: constant operands take the type of the other side, on either side") {
+    auto c = compile_clean(R"CODE(
+        @noinline
+        f(): i32 { return 4; }
+        main(): i32 {
+            x: u32 = 7;
+            b: u8 = 200;
+            t: i32 = 0;
+            if ((2 + 3) < x) { t += 1; }
+            if (x > (2 + 3)) { t += 2; }
+            if (-(1 << 2) + f() == 0) { t += 4; }
+            if ((b & ~(15)) == (128 | 64)) { t += 8; }
+            return t + ((46 * 58) + f()) - (f() + (46 * 58)) + (f() * (3 - 1)) * 100;
+        }
+    )CODE");
+    REQUIRE(run(*c->module).value == 815);
+}
+
+TEST_CASE("lower: pointer globals start out null") {
+    auto c = compile_clean(R"CODE(
+        struct Pt { x: i32; }
+        head: Pt* = null;
+        main(): i32 {
+            if (head != null) { return 1; }
+            head = new Pt;
+            head.x = 5;
+            return head.x;
+        }
+    )CODE");
+    REQUIRE(run(*c->module).value == 5);
+}
+
+TEST_CASE("lower: unsupported constructs are reported and their function dropped") {
+    auto c = compile(R"CODE(
+        greet(): string { return "hi"; }
+        main(): i32 { return 0; }
+    )CODE");
+    REQUIRE(c->diagnostics.all().size() == 1);
+    REQUIRE(c->diagnostics.all()[0].code == frontend::ErrorCode::E502_UNSUPPORTED_LOWERING);
+    REQUIRE(c->module->find_function("greet") == nullptr);
+    REQUIRE(c->module->find_function("main") != nullptr);
+}
+
+TEST_CASE("inline: bottom-up inlining removes the calls in a chain") {
+    auto c = compile(R"CODE(
+        leaf(x: i32): i32 { return x + 1; }
+        mid(x: i32): i32 { return leaf(x) * 2; }
+        top(x: i32): i32 { return mid(x) - leaf(x); }
+        main(): i32 { return top(20); }
+    )CODE");
+    optimize(*c->module, 2);
+    const Function& main_fn = *c->module->find_function("main");
+    REQUIRE(count_calls(main_fn) == 0);
+    REQUIRE(main_fn.instruction_count() == 1);  // folded to `ret i32 21` after inlining
+    REQUIRE(run(*c->module).value == 21);
+}
+
+TEST_CASE("inline: attributes, recursion and the growth budget") {
+    const char* code = R"CODE(
+        @noinline
+        tiny(x: i32): i32 { return x + 1; }
+        @inline
+        big(x: i32): i32 {
+            y: i32 = x;
+            for (i: i32 = 0; i < 3; i++) { y = y * 3 + i; y = y % 1000; y = y - 7; }
+            return y;
+        }
+        fact(n: i32): i32 { if (n <= 1) { return 1; } return n * fact(n - 1); }
+        main(): i32 { return tiny(1) + big(2) + fact(5); }
+    )CODE";
+    auto c = compile(code);
+    ExecutionResult before = run(*c->module);
+    optimize(*c->module, 1);
+    const Function& main_fn = *c->module->find_function("main");
+    // -O1 inlines only @inline; recursion and @noinline stay calls.
+    REQUIRE(count_calls(main_fn) == 2);
+    REQUIRE(count_calls(*c->module->find_function("fact")) == 1);
+    REQUIRE(run(*c->module).value == before.value);
+
+    // A caller that may not grow at all keeps calls the cost model would take.
+    auto d = compile("add1(x: i32): i32 { return x + 1; } main(): i32 { return add1(4); }");
+    InlineOptions options;
+    options.threshold = 1000;
+    options.min_growth = 0;
+    options.growth_factor = 1.0;
+    PassManager manager;
+    manager.add(create_inline_pass(options));
+    REQUIRE(manager.run(*d->module));
+    REQUIRE(count_calls(*d->module->find_function("main")) == 1);
+}
+
+TEST_CASE("inline: constant arguments pay for larger callees") {
+    const char* code = R"CODE(
+        select_op(op: i32, a: i32, b: i32): i32 {
+            if (op == 0) { return a + b; }
+            if (op == 1) { return a - b; }
+            if (op == 2) { return a * b; }
+            if (op == 3) { return a / b; }
+            if (op == 4) { return a % b; }
+            return a & b;
+        }
+        main(): i32 {
+            x: i32 = 0;
+            for (i: i32 = 1; i < 50; i++) { x += select_op(2, i, 3); }
+            return x % 251;
+        }
+        other(a: i32, b: i32, op: i32): i32 { return select_op(op, a, b); }
+    )CODE";
+    auto c = compile(code);
+    InlineOptions options;
+    options.threshold = 10;
+    PassManager manager;
+    manager.add(create_inline_pass(options));
+    REQUIRE(manager.run(*c->module));
+    REQUIRE(count_calls(*c->module->find_function("main")) == 0);
+    REQUIRE(count_calls(*c->module->find_function("other")) == 1);
+}
+
+TEST_CASE("inline: microbenchmarks keep their results and execute fewer instructions") {
+    for (const char* code : kBenchmarks) {
+        auto baseline = compile(code);
+        auto inlined = compile(code);
+        REQUIRE(baseline->diagnostics.all().empty());
+        PassManager scalar_only;
+        scalar_only.add(create_simplify_cfg_pass());
+        scalar_only.add(create_sccp_pass());
+        scalar_only.add(create_gvn_pass());
+        scalar_only.add(create_adce_pass());
+        scalar_only.add(create_simplify_cfg_pass());
+        REQUIRE(scalar_only.run(*baseline->module));
+        optimize(*inlined->module, 2);
+        ExecutionResult before = run(*baseline->module);
+        ExecutionResult after = run(*inlined->module);
+        REQUIRE(after.value == before.value);
+        REQUIRE(after.stats.calls == 1);
+        REQUIRE(after.stats.instructions < before.stats.instructions);
+    }
+}
+
+TEST_CASE("inline: methods, constructors and void callees") {
+    const char* code = R"CODE(
+        class Counter {
+            count: i64;
+            step: i64;
+            Counter(s: i64) { step = s; count = 0; }
+            bump(): void { count += step; }
+            get(): i64 { return this.count; }
+        }
+        scale(p: f64*, n: i64, k: f64): void {
+            for (i: i64 = 0; i < n; i++) { p[i] = p[i] * k; }
+        }
+        main(): i32 {
+            c: Counter = Counter(3);
+            for (i: i32 = 0; i < 5; i++) { c.bump(); }
+            xs: f64[3] = [1.5, 2.0, 4.0];
+            scale((f64*)xs, 3, 2.0);
+            u: u8 = (u8)250;
+            u += (u8)10;
+            return (i32)c.get() + (i32)xs[2] + (i32)u;
+        }
+    )CODE";
+    auto c = compile(code);
+    REQUIRE(c->diagnostics.all().empty());
+    REQUIRE(run(*c->module).value == 27);
+    optimize(*c->module, 2);
+    REQUIRE(count_calls(*c->module->find_function("main")) == 0);
+    REQUIRE(run(*c->module).value == 27);
+}
@@ -0,0 +1,173 @@
+#include <catch2/catch_test_macros.hpp>
+#include <string>
+#include <vector>
+#include "middle/ir.h"
+
+using namespace pallas::middle;
+
+static const IRType kI32 = IRType::scalar(IRTypeKind::IR_I32);
+static const IRType kI1 = IRType::scalar(IRTypeKind::IR_I1);
+
+TEST_CASE("ir: building and printing a function") {
+    Module module;
+    Function* fn = module.add_function("max", kI32, {kI32, kI32});
+    BlockId entry = fn->add_block();
+    BlockId then_block = fn->add_block();
+    BlockId join = fn->add_block();
+
+    ValueId a = fn->arg(0);
+    ValueId b = fn->arg(1);
+    std::vector<ValueId> cmp_ops = {a, b};
+    ValueId cmp = fn->append(entry, Opcode::OP_ICMP, kI1, cmp_ops);
+    fn->inst(cmp).aux = static_cast<std::uint32_t>(CmpPredicate::CMP_SGT);
+    std::vector<ValueId> br_ops = {cmp};
+    std::vector<BlockId> br_targets = {then_block, join};
+    fn->append(entry, Opcode::OP_COND_BR, {}, br_ops, br_targets);
+
+    std::vector<ValueId> add_ops = {a, fn->constant(kI32, 1)};
+    ValueId sum = fn->append(then_block, Opcode::OP_ADD, kI32, add_ops);
+    std::vector<BlockId> jump = {join};
+    fn->append(then_block, Opcode::OP_BR, {}, {}, jump);
+
+    ValueId phi = fn->append(join, Opcode::OP_PHI, kI32);
+    fn->add_incoming(phi, b, entry);
+    fn->add_incoming(phi, sum, then_block);
+    std::vector<ValueId> ret_ops = {phi};
+    fn->append(join, Opcode::OP_RET, {}, ret_ops);
+
+    std::string error;
+    REQUIRE(verify_function(*fn, &error));
+    REQUIRE(print_function(*fn) ==
+            "func @max(i32 %0, i32 %1) -> i32 {\n"
+            "bb0:\n"
+            "  %2 = icmp sgt %0, %1\n"
+            "  condbr %2, bb1, bb2\n"
+            "bb1:\n"
+            "  %3 = add i32 %0, i32 1\n"
+            "  br bb2\n"
+            "bb2:\n"
+            "  %4 = phi i32 [%1, bb0], [%3, bb1]\n"
+            "  ret %4\n"
+            "}\n");
+    REQUIRE(fn->instruction_count() == 6);
+}
+
+TEST_CASE("ir: textual form round-trips through the parser") {
+    const std::string text =
+        "global @greeting = \"hi\\0a\"\n"
+        "\n"
+        "declare @puts(ptr) -> i32\n"
+        "\n"
+        "func @sum(ptr %0, i64 %1) -> f64 noinline {\n"
+        "bb0:\n"
+        "  %2 = alloca 16, align 8\n"
+        "  br bb1\n"
+        "bb1:\n"
+        "  %3 = phi i64 [i64 0, bb0], [%8, bb2]\n"
+        "  %4 = phi f64 [f64 0.0, bb0], [%7, bb2]\n"
+        "  %5 = icmp slt %3, %1\n"
+        "  condbr %5, bb2, bb3\n"
+        "bb2:\n"
+        "  %6 = load f64 %0\n"
+        "  %7 = fadd f64 %4, %6\n"
+        "  %8 = add i64 %3, i64 1\n"
+        "  br bb1\n"
+        "bb3:\n"
+        "  %9 = call i32 @puts(@greeting)\n"
+        "  switch %1, bb4 [i64 -1, bb4] [i64 7, bb4]\n"
+        "bb4:\n"
+        "  ret %4\n"
+        "}\n";
+    pallas::frontend::Diagnostics diag;
+    auto module = parse_module(text, &diag);
+    REQUIRE(module != nullptr);
+    REQUIRE(diag.size() == 0);
+    std::string error;
+    REQUIRE(verify_module(*module, &error));
+    REQUIRE(print_module(*module) == text);
+    REQUIRE(module->find_function("sum")->flags == FUNCTION_NOINLINE);
+    REQUIRE(module->find_global(module->find_symbol("greeting"))->bytes == "hi\n");
+}
+
+TEST_CASE("ir: parser accepts arbitrary names and forward references") {
+    auto module = parse_module(
+        "func @f(i32 %x) -> i32 {\n"
+        "entry:\n"
+        "  br loop\n"
+        "loop:\n"
+        "  %i = phi i32 [%x, entry], [%next, loop]\n"
+        "  %next = sub i32 %i, i32 1\n"
+        "  %done = icmp eq %next, i32 0\n"
+        "  condbr %done, exit, loop\n"
+        "exit:\n"
+        "  ret %next\n"
+        "}\n",
+        nullptr);
+    REQUIRE(module != nullptr);
+    REQUIRE(print_function(*module->functions[0]).find("%1 = phi i32 [%0, bb0], [%2, bb1]") !=
+            std::string::npos);
+
+    pallas::frontend::Diagnostics diag;
+    REQUIRE(parse_module("func @g() -> void {\nbb0:\n  %a = frob i32 %b\n}\n", nullptr) == nullptr);
+    REQUIRE(parse_module("func @g() -> void {\nbb0:\n  br nowhere\n}\n", &diag) == nullptr);
+    REQUIRE(diag.size() == 1);
+    REQUIRE(diag[0].code == pallas::frontend::ErrorCode::E501_INVALID_IR);
+    REQUIRE(diag[0].line == 3);
+}
+
+TEST_CASE("ir: use lists, replacement and erasure") {
+    auto module = parse_module(
+        "func @f(i32 %a) -> i32 {\n"
+        "bb0:\n"
+        "  %x = mul i32 %a, i32 2\n"
+        "  %y = add i32 %x, %x\n"
+        "  %z = add i32 %y, %x\n"
+        "  ret %z\n"
+        "}\n",
+        nullptr);
+    Function& fn = *module->functions[0];
+    std::vector<ValueId> insts = fn.block_insts(fn.entry());
+    ValueId x = insts[0];
+    ValueId y = insts[1];
+    REQUIRE(fn.count_uses(x) == 3);
+    REQUIRE(fn.users(x).size() == 2);
+
+    fn.replace_all_uses(y, fn.arg(0));
+    REQUIRE_FALSE(fn.has_uses(y));
+    fn.erase(y);
+    REQUIRE(fn.count_uses(x) == 1);
+    REQUIRE(fn.instruction_count() == 3);
+    REQUIRE(fn.constant(kI32, 2) == fn.operand(x, 1));
+
+    std::string error;
+    REQUIRE(verify_function(fn, &error));
+    fn.erase(x);
+    REQUIRE_FALSE(verify_function(fn, &error));
+    REQUIRE(error.find("erased") != std::string::npos);
+}
+
+TEST_CASE("ir: verifier rejects malformed control flow") {
+    auto module = parse_module(
+        "func @f(i1 %c) -> void {\n"
+        "bb0:\n"
+        "  condbr %c, bb1, bb2\n"
+        "bb1:\n"
+        "  br bb2\n"
+        "bb2:\n"
+        "  %p = phi i32 [i32 1, bb0]\n"
+        "  ret\n"
+        "}\n",
+        nullptr);
+    REQUIRE(module != nullptr);
+    std::string error;
+    REQUIRE_FALSE(verify_module(*module, &error));
+    REQUIRE(error.find("predecessors") != std::string::npos);
+
+    Function& fn = *module->functions[0];
+    ValueId phi = fn.block(fn.block_order()[2]).first;
+    fn.add_incoming(phi, fn.constant(kI32, 2), fn.block_order()[1]);
+    REQUIRE(verify_module(*module, &error));
+    fn.remove_incoming(phi, 0);
+    REQUIRE(fn.targets(phi)[0] == fn.block_order()[1]);
+    REQUIRE_FALSE(verify_module(*module, &error));
+}
@@ -0,0 +1,197 @@
+#include <catch2/catch_test_macros.hpp>
+#include <memory>
+#include <string>
+#include "frontend/const_eval.h"
+#include "frontend/parser.h"
+#include "frontend/scanner.h"
+#include "middle/layout.h"
+
+using namespace pallas::frontend;
+using pallas::middle::LayoutEngine;
+using pallas::middle::LayoutOptions;
+using pallas::middle::TypeLayout;
+
+static std::unique_ptr<ModuleAST> parse(const std::string& code) {
+    Scanner scanner(code);
+    Parser parser(scanner.get_tokens());
+    auto module = parser.parse_module();
+    ConstEvaluator eval(*module, nullptr);
+    eval.resolve_array_sizes(*module);
+    return module;
+}
+
+static const pallas::middle::FieldLayout* field(const TypeLayout* layout, const std::string& name) {
+    for (const auto& f : layout->fields) {
+        if (f.name == name) {
+            return &f;
+        }
+    }
+    return nullptr;
+}
+
+TEST_CASE("layout: primitive fields follow the C ABI") {
+    auto module = parse(R"CODE(
+        struct Vector3 { x: f32; y: f32; z: f32; }
+        struct Mixed { a: bool; b: i64; c: u8; }
+    )CODE");
+    Diagnostics diag;
+    LayoutEngine engine(*module, &diag);
+
+    const TypeLayout* v = engine.layout_of("Vector3");
+    REQUIRE(v->size == 12);
+    REQUIRE(v->align == 4);
+    REQUIRE(v->padding == 0);
+
+    const TypeLayout* m = engine.layout_of("Mixed");
+    REQUIRE(m->size == 24);
+    REQUIRE(m->align == 8);
+    REQUIRE(m->padding == 14);
+    REQUIRE(m->tail_padding == 7);
+    REQUIRE(field(m, "b")->offset == 8);
+    REQUIRE(m->optimal_size == 16);
+    REQUIRE_FALSE(m->reordered);
+    REQUIRE(diag.size() == 0);
+}
+
+TEST_CASE("layout: @reorder and --reorder-fields remove interior padding") {
+    auto module = parse(R"CODE(
+        @reorder
+        struct Packet { flag: bool; id: u64; kind: u8; len: u32; }
+        struct Plain { flag: bool; id: u64; }
+    )CODE");
+    Diagnostics diag;
+    LayoutEngine engine(*module, &diag);
+    const TypeLayout* p = engine.layout_of("Packet");
+    REQUIRE(p->size == 16);
+    REQUIRE(p->reordered);
+    REQUIRE(field(p, "id")->offset == 0);
+    REQUIRE(field(p, "len")->offset == 8);
+    REQUIRE(engine.layout_of("Plain")->size == 16);
+    REQUIRE(engine.report().find("padding") != std::string::npos);
+
+    LayoutOptions options;
+    options.reorder_all = true;
+    LayoutEngine all(*module, &diag, options);
+    REQUIRE(field(all.layout_of("Plain"), "id")->offset == 0);
+    REQUIRE(diag.size() == 0);
+}
+
+TEST_CASE("layout: alignment attributes and hot/cold placement") {
+    auto module = parse(R"CODE(
+        @cache_aligned
+        struct Counter { value: u64; }
+
+        @align(32)
+        struct Wide { a: u8; }
+
+        @cache_aligned
+        struct Node {
+            @cold name: string;
+            @hot next: Node*;
+            count: u32;
+        }
+
+        struct Bad { @align(3) x: u8; }
+    )CODE");
+    Diagnostics diag;
+    LayoutEngine engine(*module, &diag);
+    REQUIRE(engine.layout_of("Counter")->size == 64);
+    REQUIRE(engine.layout_of("Wide")->align == 32);
+
+    const TypeLayout* node = engine.layout_of("Node");
+    REQUIRE(node->fields.front().name == "next");
+    REQUIRE(node->fields.back().name == "name");
+    REQUIRE(field(node, "name")->offset == 64);
+    REQUIRE(node->size == 128);
+
+    engine.layout_of("Bad");
+    REQUIRE(diag.size() == 1);
+    REQUIRE(diag[0].code == ErrorCode::E403_INVALID_ATTRIBUTE);
+}
+
+TEST_CASE("layout: arrays, generics and aliases") {
+    auto module = parse(R"CODE(
+        const N: i64 = 4;
+        type Id = u32;
+        struct Pair<A, B = i16> { first: A; second: B; }
+        struct Holder { ids: Id[N]; pair: Pair<u8>; items: Vec<i32>; big: Pair<i128, bool>; }
+    )CODE");
+    Diagnostics diag;
+    LayoutEngine engine(*module, &diag);
+    const TypeLayout* h = engine.layout_of("Holder");
+    REQUIRE(field(h, "ids")->size == 16);
+    REQUIRE(field(h, "pair")->size == 4);
+    REQUIRE(field(h, "items")->offset == 24);
+    REQUIRE(field(h, "big")->offset == 48);
+    REQUIRE(field(h, "big")->size == 32);
+    REQUIRE(h->size == 80);
+    REQUIRE(diag.size() == 0);
+}
+
+TEST_CASE("layout: recursive and unknown types are errors") {
+    auto module = parse(R"CODE(
+        struct List { value: i32; next: List; }
+        struct Tree { left: Tree*; right: Tree*; }
+        struct Broken { thing: Missing; }
+    )CODE");
+    Diagnostics diag;
+    LayoutEngine engine(*module, &diag);
+    REQUIRE(engine.layout_of("List") == nullptr);
+    REQUIRE(engine.layout_of("Tree")->size == 16);
+    engine.layout_of("Broken");
+    REQUIRE(diag.size() == 2);
+    REQUIRE(diag[0].code == ErrorCode::E402_RECURSIVE_TYPE);
+    REQUIRE(diag[1].code == ErrorCode::E401_UNKNOWN_TYPE);
+}
+
+TEST_CASE("layout: @soa arrays store one array per field") {
+    auto module = parse(R"CODE(
+        @soa
+        struct Particle { alive: bool; x: f64; id: i32; }
+        struct Pt { x: i32; y: i8; }
+        struct World { ps: Particle[3]; pts: @soa Pt[5]; plain: Pt[5]; }
+    )CODE");
+    Diagnostics diag;
+    LayoutEngine engine(*module, &diag);
+    const TypeLayout* w = engine.layout_of("World");
+    // alive at 0, x at 8 (after 3 bytes, aligned), id at 32: 44 rounded to 48.
+    REQUIRE(field(w, "ps")->size == 48);
+    REQUIRE(field(w, "ps")->align == 8);
+    // x at 0, y at 20: 25 rounded to 28, where Pt[5] takes 40.
+    REQUIRE(field(w, "pts")->size == 28);
+    REQUIRE(field(w, "plain")->size == 40);
+
+    auto array = make_type(TypeKind::TYPE_ARRAY);
+    array->element = make_type(TypeKind::TYPE_UNKNOWN, "Particle");
+    array->array_size = 3;
+    array->size_known = true;
+    REQUIRE(engine.is_soa(*array));
+    const pallas::middle::SoaLayout* soa = engine.soa_layout_of(*array);
+    REQUIRE(soa->fields.size() == 3);
+    REQUIRE(soa->fields[1].name == "x");
+    REQUIRE(soa->fields[1].offset == 8);
+    REQUIRE(soa->fields[1].stride == 8);
+    REQUIRE(soa->fields[2].offset == 32);
+    array->element = make_type(TypeKind::TYPE_UNKNOWN, "Pt");
+    REQUIRE_FALSE(engine.is_soa(*array));
+    REQUIRE(engine.soa_layout_of(*array) == nullptr);
+    REQUIRE(diag.size() == 0);
+}
+
+TEST_CASE("layout: the report lists the field arrays of @soa arrays") {
+    auto module = parse(R"CODE(
+        struct Pt { x: i32; y: i8; }
+        main(): i32 {
+            if (true) { pts: @soa Pt[5]; }
+            return 0;
+        }
+    )CODE");
+    Diagnostics diag;
+    LayoutEngine engine(*module, &diag);
+    std::string report = engine.report();
+    REQUIRE(report.find("@soa Pt[5]: size 28, align 4\n"
+                        "  offset stride  field\n"
+                        "       0      4  x\n"
+                        "      20      1  y\n") != std::string::npos);
+    REQUIRE(diag.size() == 0);
+}
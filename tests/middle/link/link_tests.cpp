@@ -0,0 +1,211 @@
+#include <catch2/catch_test_macros.hpp>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "frontend/ast.h"
+#include "frontend/const_eval.h"
+#include "frontend/diagnostics.h"
+#include "frontend/parser.h"
+#include "frontend/scanner.h"
+#include "middle/interpreter.h"
+#include "middle/layout.h"
+#include "middle/link.h"
+#include "middle/lower.h"
+#include "middle/passes.h"
+#include "runtime/format.h"
+
+using namespace pallas;
+using namespace pallas::middle;
+
+namespace {
+
+std::unique_ptr<frontend::ModuleAST> parse(const std::string& code,
+                                           frontend::Diagnostics& diagnostics) {
+    frontend::Scanner scanner(code, &diagnostics);
+    frontend::Parser parser(scanner.get_tokens(), &diagnostics);
+    return parser.parse_module();
+}
+
+// Compiles every file on its own, with the declarations of all the others, the
+// way palc compiles a program whose files import each other.
+std::vector<LinkUnit> compile(const std::vector<std::pair<std::string, std::string>>& files) {
+    std::vector<LinkUnit> units;
+    for (std::size_t i = 0; i < files.size(); ++i) {
+        frontend::Diagnostics diagnostics;
+        auto ast = parse(files[i].second, diagnostics);
+        LowerOptions options;
+        for (std::size_t j = 0; j < files.size(); ++j) {
+            if (j != i) {
+                auto other = parse(files[j].second, diagnostics);
+                frontend::import_declarations(*ast, *other, options.imported);
+            }
+        }
+        frontend::ConstEvaluator consts(*ast, &diagnostics);
+        consts.resolve_array_sizes(*ast);
+        LayoutEngine layout(*ast, &diagnostics);
+        auto module = lower_module(*ast, consts, layout, &diagnostics, options);
+        INFO(files[i].first);
+        REQUIRE(diagnostics.all().empty());
+
+        PassOptions pass_options;
+        pass_options.verify_each = true;
+        PassManager manager(pass_options);
+        build_pipeline(manager, 2);
+        REQUIRE(manager.run(*module));
+        ModuleSummary summary = summarize_module(*module, files[i].first);
+        units.push_back({std::move(module), std::move(summary)});
+    }
+    return units;
+}
+
+std::unique_ptr<Module> link(std::vector<LinkUnit> units, bool whole_program,
+                             LinkStats* stats = nullptr) {
+    LinkOptions options;
+    options.whole_program = whole_program;
+    options.verify_each = true;
+    std::string error;
+    auto module = link_modules(std::move(units), options, &error, stats);
+    INFO(error);
+    REQUIRE(module != nullptr);
+    std::string invalid;
+    INFO(invalid);
+    REQUIRE(verify_module(*module, &invalid));
+    return module;
+}
+
+std::string output_of(Module& module) {
+    std::string printed;
+    runtime::set_output_capture(&printed);
+    Interpreter interpreter(module);
+    ExecutionResult result = interpreter.run("main");
+    runtime::set_output_capture(nullptr);
+    INFO(result.error);
+    REQUIRE(result.ok);
+    return printed;
+}
+
+std::size_t count_calls(const Module& module, const Function& fn, const std::string& callee) {
+    std::size_t count = 0;
+    for (BlockId b : fn.block_order()) {
+        for (ValueId v : fn.block_insts(b)) {
+            const Inst& inst = fn.inst(v);
+            count += inst.op == Opcode::OP_CALL && module.symbol_name(inst.aux) == callee;
+        }
+    }
+    return count;
+}
+
+const std::pair<std::string, std::string> kMath = {"math.pal", R"CODE(
+    scale: i64 = 3;
+    limit: i64 = 0;
+    square(n: i64): i64 { return n * n; }
+    scaled(n: i64): i64 { return n * scale; }
+    unused(n: i64): i64 { return n + 1; }
+    set_limit(n: i64): void { limit = n; }
+    get_limit(): i64 { return limit; }
+    shout(): void { println("math"); }
+)CODE"};
+
+const std::pair<std::string, std::string> kMain = {"main.pal", R"CODE(
+    main(): i32 {
+        t: i64 = 0;
+        for (i: i64 = 0; i < 10; i++) {
+            t += square(i) + scaled(i);
+        }
+        set_limit(t);
+        shout();
+        println("main ${t} ${get_limit()}");
+        return 0;
+    }
+)CODE"};
+
+}  // namespace
+
+TEST_CASE("link: modules are merged and calls across them stay calls") {
+    auto module = link(compile({kMain, kMath}), false);
+    const Function* main = module->find_function("main");
+    REQUIRE(count_calls(*module, *main, "square") > 0);
+    REQUIRE(module->find_function("unused") != nullptr);
+    REQUIRE((module->find_function("square")->flags & FUNCTION_INTERNAL) == 0);
+    REQUIRE(output_of(*module) == "math\nmain 420 420\n");
+}
+
+TEST_CASE("link: whole-program optimization inlines across modules and drops dead code") {
+    LinkStats stats;
+    auto module = link(compile({kMain, kMath}), true, &stats);
+    const Function* main = module->find_function("main");
+    REQUIRE(count_calls(*module, *main, "square") == 0);
+    REQUIRE(count_calls(*module, *main, "scaled") == 0);
+    REQUIRE(module->find_function("unused") == nullptr);
+    REQUIRE(stats.imported > 0);
+    REQUIRE(stats.removed > 0);
+    for (const auto& fn : module->functions) {
+        if (fn->name != "main" && fn->entry() != kNoBlock) {
+            INFO(fn->name);
+            REQUIRE((fn->flags & FUNCTION_INTERNAL) != 0);
+        }
+    }
+    REQUIRE(output_of(*module) == "math\nmain 420 420\n");
+}
+
+TEST_CASE("link: globals nothing writes are folded into their loads") {
+    LinkStats stats;
+    auto module = link(compile({kMain, kMath}), true, &stats);
+    // scale is only read; limit is written by set_limit.
+    REQUIRE(stats.constant_globals == 1);
+    bool loads_limit = false;
+    for (const Global& global : module->globals) {
+        REQUIRE(module->symbol_name(global.symbol) != "scale");
+        loads_limit |= module->symbol_name(global.symbol) == "limit";
+    }
+    REQUIRE(loads_limit);
+}
+
+TEST_CASE("link: module-private names do not clash") {
+    // Both modules have a `pallas.str.0` literal and a global `count`.
+    std::pair<std::string, std::string> a = {"a.pal", R"CODE(
+        count: i64 = 1;
+        @noinline
+        from_a(): void { count += 1; println("from a ${count}"); }
+    )CODE"};
+    std::pair<std::string, std::string> b = {"b.pal", R"CODE(
+        count: i64 = 10;
+        main(): i32 {
+            from_a();
+            count += 5;
+            println("from b ${count}");
+            return 0;
+        }
+    )CODE"};
+    for (bool whole_program : {false, true}) {
+        auto module = link(compile({b, a}), whole_program);
+        REQUIRE(output_of(*module) == "from a 2\nfrom b 15\n");
+    }
+}
+
+TEST_CASE("link: a function defined by two modules is an error") {
+    std::pair<std::string, std::string> other = {"other.pal", R"CODE(
+        square(n: i64): i64 { return n; }
+    )CODE"};
+    std::vector<LinkUnit> units;
+    for (auto& unit : compile({kMath})) {
+        units.push_back(std::move(unit));
+    }
+    for (auto& unit : compile({other})) {
+        units.push_back(std::move(unit));
+    }
+    std::string error;
+    REQUIRE(link_modules(std::move(units), LinkOptions(), &error) == nullptr);
+    REQUIRE(error == "'@square' is defined in both 'math.pal' and 'other.pal'");
+}
+
+TEST_CASE("link: summaries list calls, sizes and written globals") {
+    auto units = compile({kMain, kMath});
+    std::string main = print_summary(units[0].summary);
+    REQUIRE(main.starts_with("module main.pal\nfunc @main "));
+    REQUIRE(main.find("calls @square*") != std::string::npos);
+    std::string math = print_summary(units[1].summary);
+    REQUIRE(math.find("global @limit 8 written") != std::string::npos);
+    REQUIRE(math.find("global @scale 8\n") != std::string::npos);
+}
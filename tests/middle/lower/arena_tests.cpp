@@ -0,0 +1,135 @@
+#include <catch2/catch_test_macros.hpp>
+#include <memory>
+#include <string>
+#include "frontend/diagnostics.h"
+#include "middle/interpreter.h"
+#include "middle/passes.h"
+#include "tests/support/compile_helpers.h"
+
+using namespace pallas;
+using namespace pallas::middle;
+using namespace pallas::test;
+
+namespace {
+
+ExecutionResult run(const std::string& code, int level) {
+    auto c = compile(code);
+    REQUIRE(c->diagnostics.all().empty());
+    PassOptions options;
+    options.verify_each = true;
+    PassManager manager(options);
+    build_pipeline(manager, level);
+    REQUIRE(manager.run(*c->module));
+    Interpreter interpreter(*c->module);
+    return interpreter.run("main");
+}
+
+const char* const kNodes = R"CODE(
+    live: i32 = 0;
+    class Node {
+        public:
+            value: i32;
+            next: Node*;
+            Node(v: i32, n: Node*) { value = v; next = n; live += 1; }
+            ~Node() { live -= 1; }
+    }
+    struct Point { x: i32; y: i32; }
+)CODE";
+
+}  // namespace
+
+TEST_CASE("arena lowering: new inside an arena block bumps the arena, never the heap") {
+    const std::string code = std::string(kNodes) + R"CODE(
+        @noinline
+        build(n: i32): i32 {
+            total: i32 = 0;
+            arena(1024) {
+                head: Node* = null;
+                for (i: i32 = 0; i < n; i++) {
+                    head = new Node(i, head);
+                    p: Point* = new Point;
+                    p.x = i;
+                    total += p.x;
+                }
+                buf: i32* = new i32[n];
+                buf[n - 1] = 7;
+                total += buf[n - 1] + live;
+            }
+            return total + live;
+        }
+        main(): i32 { return build(100) % 256; }
+    )CODE";
+    for (int level = 0; level <= 2; ++level) {
+        ExecutionResult result = run(code, level);
+        REQUIRE(result.ok);
+        // 100 nodes are live inside the block; their destructors run at its end.
+        REQUIRE(result.value == (4950 + 7 + 100) % 256);
+        REQUIRE(result.stats.allocations == 0);
+        REQUIRE(result.stats.arena_refills > 0);
+    }
+}
+
+TEST_CASE("arena lowering: early exits release every enclosing arena") {
+    const std::string code = std::string(kNodes) + R"CODE(
+        @noinline
+        find(n: i32): i32 {
+            arena() {
+                for (i: i32 = 0; i < n; i++) {
+                    arena(256) {
+                        t: Node* = new Node(i, null);
+                        if (t.value == 5) { return live; }
+                        if (t.value == 2) { continue; }
+                        if (t.value == 9) { break; }
+                    }
+                }
+            }
+            return -1;
+        }
+        main(): i32 { return find(10) * 10 + live; }
+    )CODE";
+    for (int level = 0; level <= 2; ++level) {
+        ExecutionResult result = run(code, level);
+        REQUIRE(result.ok);
+        REQUIRE(result.value == 10);
+    }
+}
+
+TEST_CASE("arena lowering: Arena variables allocate with new(arena) and free_all") {
+    const std::string code = std::string(kNodes) + R"CODE(
+        main(): i32 {
+            a: Arena = Arena(256);
+            t: i32 = 0;
+            for (round: i32 = 0; round < 3; round++) {
+                for (i: i32 = 0; i < 10; i++) {
+                    q: Node* = new(a) Node(i, null);
+                    t += q.value;
+                }
+                t += live;
+                a.free_all();
+            }
+            return t + live;
+        }
+    )CODE";
+    for (int level = 0; level <= 2; ++level) {
+        ExecutionResult result = run(code, level);
+        REQUIRE(result.ok);
+        // free_all runs the destructors of the round's nodes.
+        REQUIRE(result.value == 3 * (45 + 10));
+        REQUIRE(result.stats.allocations == 0);
+    }
+}
+
+TEST_CASE("arena lowering: arenas cannot be copied or heap allocated") {
+    auto c = compile(R"CODE(
+        take(a: Arena*): i32 { return 0; }
+        byvalue(a: Arena): i32 { return 0; }
+        main(): i32 {
+            a: Arena = Arena(64);
+            b: Arena = Arena();
+            a = b;
+            p: i32* = new Arena;
+            return byvalue(a);
+        }
+    )CODE");
+    REQUIRE(c->diagnostics.all().size() == 3);
+}
@@ -0,0 +1,201 @@
+#include <catch2/catch_test_macros.hpp>
+#include <memory>
+#include <string>
+#include "frontend/diagnostics.h"
+#include "tests/support/compile_helpers.h"
+
+using namespace pallas;
+using namespace pallas::middle;
+using namespace pallas::test;
+
+namespace {
+
+std::size_t count_calls(const Module& module, const Function& fn, const std::string& name) {
+    std::size_t count = 0;
+    for (BlockId b : fn.block_order()) {
+        for (ValueId v : fn.block_insts(b)) {
+            const Inst& inst = fn.inst(v);
+            count += inst.op == Opcode::OP_CALL && module.symbol_name(inst.aux) == name;
+        }
+    }
+    return count;
+}
+
+bool has_error(const frontend::Diagnostics& diagnostics, frontend::ErrorCode code) {
+    for (const auto& d : diagnostics.all()) {
+        if (d.code == code) {
+            return true;
+        }
+    }
+    return false;
+}
+
+}  // namespace
+
+TEST_CASE("collections: Vec push, pop, indexing and range-for") {
+    const std::string code = R"CODE(
+        class P { public: x: i32; y: i32; P(v: i32) { x = v; y = v * 2; } }
+        sum(v: Vec<i64>*): i64 {
+            t: i64 = 0;
+            for (x : v) {
+                t += x;
+            }
+            return t;
+        }
+        main(): i32 {
+            v: Vec<i64> = Vec<i64>();
+            for (i: i32 = 0; i < 1000; i++) {
+                v.push((i64)i * 3);
+            }
+            v[1] = 7;
+            println("${v.len()} ${v.capacity() >= 1000} ${sum(v)} ${v[999]}");
+            points: Vec<P> = Vec<P>();
+            for (i: i32 = 0; i < 5; i++) {
+                points.push(P(i));
+            }
+            points.push(points[4]);
+            last: P = points.pop();
+            println("${points.len()} ${last.x} ${last.y} ${points[2].y}");
+            v.clear();
+            v.reserve(10);
+            println("${v.len()}");
+            return 0;
+        }
+    )CODE";
+    for (int level : {0, 2}) {
+        auto c = compile(code);
+        REQUIRE(c->diagnostics.all().empty());
+        REQUIRE(output_of(*c->module, level) == "1000 true 1498504 2997\n5 4 8 4\n0\n");
+    }
+}
+
+TEST_CASE("collections: a small constant capacity is reserved on the stack") {
+    const std::string code = R"CODE(
+        main(): i32 {
+            t: i32 = 0;
+            for (round: i32 = 0; round < 100; round++) {
+                v: Vec<i32> = Vec<i32>(8);
+                for (i: i32 = 0; i < 8; i++) {
+                    v.push(i * round);
+                }
+                t += v[7];
+            }
+            big: Vec<i32> = Vec<i32>(4);
+            for (i: i32 = 0; i < 100; i++) {
+                big.push(i);
+            }
+            println("${t} ${big[99]}");
+            return 0;
+        }
+    )CODE";
+    auto c = compile(code);
+    REQUIRE(c->diagnostics.all().empty());
+    const Function& main = *c->module->find_function("main");
+    REQUIRE(count_calls(*c->module, main, "pallas_vec_init_inline") == 2);
+    REQUIRE(count_calls(*c->module, main, "pallas_vec_reserve") == 0);
+    REQUIRE(output_of(*c->module, 2) == "34650 99\n");
+}
+
+TEST_CASE("collections: strings assign, append, slice and format in place") {
+    const std::string code = R"CODE(
+        shout(s: string*): void {
+            s.append('!');
+        }
+        main(): i32 {
+            s: string = "hello";
+            s += ", world";
+            n: i32 = 42;
+            s.append(" n=${n}");
+            shout(s);
+            t: string = s.slice(7, 12);
+            println("[${t}] ${t.len()} ${s} ${s[0]}");
+            long: string = "a string that is too long to be stored inline: ${n}";
+            long = long.slice(2, 8);
+            s = "${s} / ${long} / ${s.len()}";
+            println(s);
+            vowels: i32 = 0;
+            for (c : s) {
+                if (c == 'o' || c == 'e') {
+                    vowels++;
+                }
+            }
+            copy: string = s;
+            s = s;
+            copy += copy;
+            println("${vowels} ${copy.len()} ${s.c_str()}");
+            return 0;
+        }
+    )CODE";
+    for (int level : {0, 2}) {
+        auto c = compile(code);
+        REQUIRE(c->diagnostics.all().empty());
+        REQUIRE(output_of(*c->module, level) ==
+                "[world] 5 hello, world n=42! h\n"
+                "hello, world n=42! / string / 18\n"
+                "3 64 hello, world n=42! / string / 18\n");
+    }
+}
+
+TEST_CASE("collections: strings and Vecs in an arena block take their buffers from it") {
+    const std::string code = R"CODE(
+        main(): i32 {
+            outside: string = "";
+            arena(256) {
+                v: Vec<i32> = Vec<i32>(4);
+                s: string = "";
+                for (i: i32 = 0; i < 500; i++) {
+                    v.push(i);
+                    s += "ab";
+                    outside += "c";
+                }
+                println("${v[499]} ${s.len()}");
+            }
+            println("${outside.len()}");
+            return 0;
+        }
+    )CODE";
+    auto c = compile(code);
+    REQUIRE(c->diagnostics.all().empty());
+    // Inside an arena the capacity is reserved from the arena, not the stack.
+    const Function& main = *c->module->find_function("main");
+    REQUIRE(count_calls(*c->module, main, "pallas_vec_init_inline") == 0);
+    REQUIRE(output_of(*c->module, 2) == "499 1000\n500\n");
+}
+
+TEST_CASE("collections: indexes and slices past the end fail") {
+    for (const char* body : {"v: Vec<i32> = Vec<i32>(); v.push(1); return v[1];",
+                             "v: Vec<i32> = Vec<i32>(); v.pop(); return 0;",
+                             "s: string = \"abc\"; return (i32)s[3];",
+                             "s: string = \"abc\"; t: string = s.slice(2, 4); return 0;"}) {
+        auto c = compile(std::string("main(): i32 { ") + body + " }");
+        REQUIRE(c->diagnostics.all().empty());
+        bool ok = true;
+        std::string error = output_of(*c->module, 0, &ok);
+        INFO(body);
+        REQUIRE_FALSE(ok);
+        REQUIRE(error.find("out of bounds") != std::string::npos);
+    }
+}
+
+TEST_CASE("collections: copies, by-value parameters and misplaced slices are errors") {
+    auto c = compile(R"CODE(
+        take(s: string): i32 { return 0; }
+        main(): i32 {
+            v: Vec<i32> = Vec<i32>();
+            w: Vec<i32> = v;
+            s: string = 5;
+            s.slice(0, 1);
+            p: string* = new string;
+            x: Vec<string> = Vec<string>();
+            y: i32 = Vec<i32>();
+            return 0;
+        }
+    )CODE");
+    REQUIRE(has_error(c->diagnostics, frontend::ErrorCode::E405_TYPE_MISMATCH));
+    REQUIRE(has_error(c->diagnostics, frontend::ErrorCode::E502_UNSUPPORTED_LOWERING));
+    std::size_t errors = 0;
+    for (const auto& d : c->diagnostics.all()) {
+        errors += d.severity == frontend::Severity::Error;
+    }
+    REQUIRE(errors == 7);
+}
@@ -0,0 +1,270 @@
+#include <catch2/catch_test_macros.hpp>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "frontend/diagnostics.h"
+#include "middle/interpreter.h"
+#include "middle/match.h"
+#include "middle/passes.h"
+#include "tests/support/compile_helpers.h"
+
+using namespace pallas;
+using namespace pallas::middle;
+using namespace pallas::test;
+
+namespace {
+
+ExecutionResult run(const std::string& code, int level) {
+    auto c = compile(code);
+    REQUIRE(c->diagnostics.all().empty());
+    PassOptions options;
+    options.verify_each = true;
+    PassManager manager(options);
+    build_pipeline(manager, level);
+    REQUIRE(manager.run(*c->module));
+    Interpreter interpreter(*c->module);
+    return interpreter.run("main");
+}
+
+std::size_t count_ops(const Function& fn, Opcode op) {
+    std::size_t count = 0;
+    for (BlockId b : fn.block_order()) {
+        for (ValueId v : fn.block_insts(b)) {
+            count += fn.inst(v).op == op;
+        }
+    }
+    return count;
+}
+
+}  // namespace
+
+TEST_CASE("match: dense runs become jump tables, the rest single comparisons") {
+    std::vector<std::uint64_t> keys = {1, 2, 3, 5, 6, 100, 1000, 1001, 1002, 1003, 5000};
+    std::vector<CaseCluster> clusters = cluster_cases(keys);
+    REQUIRE(clusters.size() == 4);
+    REQUIRE(clusters[0].jump_table);
+    REQUIRE(clusters[0].count == 5);
+    REQUIRE_FALSE(clusters[1].jump_table);
+    REQUIRE(keys[clusters[1].first] == 100);
+    REQUIRE(clusters[2].jump_table);
+    REQUIRE(clusters[2].count == 4);
+    REQUIRE_FALSE(clusters[3].jump_table);
+
+    std::vector<std::uint64_t> sparse = {1, 10, 100, 1000};
+    for (const CaseCluster& cluster : cluster_cases(sparse)) {
+        REQUIRE_FALSE(cluster.jump_table);
+    }
+}
+
+TEST_CASE("match: integer arms select in constant or logarithmic time") {
+    std::string dense = "@noinline\nop(x: i32): i32 {\n    match (x) {\n";
+    std::string sparse = "@noinline\nkey(x: i64): i32 {\n    match (x) {\n";
+    for (int i = 0; i < 64; ++i) {
+        dense += "        " + std::to_string(i - 8) + " => { return " + std::to_string(i) +
+                 "; }\n";
+        sparse += "        " + std::to_string(i * i * 7919 - 50000) + " => { return " +
+                  std::to_string(i) + "; }\n";
+    }
+    dense += "        _ => { return -1; }\n    }\n    return -2;\n}\n";
+    sparse += "        _ => { return -1; }\n    }\n    return -2;\n}\n";
+    const std::string code = dense + sparse + R"CODE(
+        main(): i32 {
+            t: i32 = op(-8) + op(55) + op(56) + op(-9);
+            t += key(-50000) + key(31380511) + key(3);
+            return t;
+        }
+    )CODE";
+    auto c = compile(code);
+    REQUIRE(c->diagnostics.all().empty());
+    REQUIRE(count_ops(*c->module->find_function("op"), Opcode::OP_SWITCH) == 1);
+    REQUIRE(count_ops(*c->module->find_function("key"), Opcode::OP_SWITCH) == 0);
+    for (int level = 0; level <= 2; ++level) {
+        ExecutionResult result = run(code, level);
+        REQUIRE(result.ok);
+        REQUIRE(result.value == 0 + 63 - 1 - 1 + 0 + 63 - 1);
+        // A chain of 64 comparisons per call would take several hundred.
+        REQUIRE(result.stats.instructions < 150);
+    }
+}
+
+TEST_CASE("match: signed, char and bool scrutinees, bindings and fallthrough") {
+    const std::string code = R"CODE(
+        @noinline
+        sign(x: i8): i32 {
+            r: i32 = 0;
+            match (x) {
+                -128 => { r = 1; }
+                -1 => { r = 2; }
+                0 => { r = 3; }
+                127 => { r = 4; }
+                other => { r = (i32) other * 10; }
+            }
+            return r;
+        }
+        @noinline
+        vowel(c: char): bool {
+            match (c) {
+                'a' => { return true; }
+                'e' => { return true; }
+                'i' => { return true; }
+                'o' => { return true; }
+                'u' => { return true; }
+            }
+            return false;
+        }
+        @noinline
+        flag(b: bool): i32 {
+            match (b) {
+                true => { return 7; }
+                false => { return 9; }
+            }
+            return 0;
+        }
+        main(): i32 {
+            lo: i8 = (i8) -127 - (i8) 1;
+            t: i32 = sign(lo) + sign((i8) -1) + sign((i8) 0) + sign((i8) 127);
+            t += sign((i8) 5);
+            if (vowel('e') && !vowel('x')) { t += 100; }
+            return t + flag(true) * flag(false);
+        }
+    )CODE";
+    for (int level = 0; level <= 2; ++level) {
+        ExecutionResult result = run(code, level);
+        REQUIRE(result.ok);
+        REQUIRE(result.value == 1 + 2 + 3 + 4 + 50 + 100 + 63);
+    }
+}
+
+TEST_CASE("match: strings dispatch on length, packed bytes and hash") {
+    const std::string code = R"CODE(
+        @noinline
+        word(s: char*): i32 {
+            match (s) {
+                "" => { return 1; }
+                "if" => { return 2; }
+                "while" => { return 3; }
+                "continue" => { return 4; }
+                "interface" => { return 5; }
+                "implements" => { return 6; }
+                "deprecated" => { return 7; }
+                "attributes" => { return 8; }
+                _ => { return 0; }
+            }
+            return -1;
+        }
+        @noinline
+        text(n: i32, a: char, b: char, c: char, d: char): char* {
+            s: char* = new char[n + 1];
+            for (i: i32 = 0; i < n; i++) { s[i] = c; }
+            if (n > 0) { s[0] = a; }
+            if (n > 1) { s[1] = b; }
+            if (n > 2) { s[n - 1] = d; }
+            return s;
+        }
+        main(): i32 {
+            t: i32 = word(text(0, 'x', 'x', 'x', 'x')) * 10000000;
+            t += word(text(2, 'i', 'f', 'x', 'x')) * 1000000;
+            t += word(text(2, 'i', 'g', 'x', 'x')) * 100000;
+            t += word(text(10, 'd', 'e', 'p', 'd'));
+            t += word(text(10, 'a', 't', 't', 's')) * 10;
+            t += word(null) * 100;
+            return t;
+        }
+    )CODE";
+    for (int level = 0; level <= 2; ++level) {
+        ExecutionResult result = run(code, level);
+        REQUIRE(result.ok);
+        // "depppppppd" and "atttttttts" have a pattern's length but no pattern's bytes.
+        REQUIRE(result.value == 12000000);
+    }
+
+    const std::string exact = R"CODE(
+        @noinline
+        word(s: char*): i32 {
+            match (s) {
+                "implements" => { return 6; }
+                "deprecated" => { return 7; }
+                "attributes" => { return 8; }
+                _ => { return 0; }
+            }
+            return -1;
+        }
+        main(): i32 {
+            s: char* = new char[11];
+            s[0] = 'd'; s[1] = 'e'; s[2] = 'p'; s[3] = 'r'; s[4] = 'e';
+            s[5] = 'c'; s[6] = 'a'; s[7] = 't'; s[8] = 'e'; s[9] = 'd';
+            t: i32 = word(s);
+            s[5] = 'k';
+            return t * 10 + word(s);
+        }
+    )CODE";
+    ExecutionResult result = run(exact, 1);
+    REQUIRE(result.ok);
+    REQUIRE(result.value == 70);
+}
+
+TEST_CASE("match: string scrutinees dispatch on their stored length and text") {
+    const std::string code = R"CODE(
+        main(): i32 {
+            s: string = "";
+            t: i32 = 0;
+            for (i: i32 = 0; i < 5; i++) {
+                if (i == 1) { s += "if"; }
+                if (i == 2) { s = "deprecated"; }
+                if (i == 3) { s = "a keyword too long to be stored inline"; }
+                if (i == 4) { s = s.slice(0, 4); }
+                match (s) {
+                    "" => { t = t * 10 + 1; }
+                    "if" => { t = t * 10 + 2; }
+                    "continue" => { t = t * 10 + 3; }
+                    "implements" => { t = t * 10 + 4; }
+                    "deprecated" => { t = t * 10 + 5; }
+                    "a keyword too long to be stored inline" => { t = t * 10 + 6; }
+                    other => {
+                        other += "!";
+                        t = t * 100 + 10 + (i32) other.len();
+                    }
+                }
+            }
+            println("${t} ${s}");
+            return 0;
+        }
+    )CODE";
+    for (int level = 0; level <= 2; ++level) {
+        auto c = compile(code);
+        REQUIRE(c->diagnostics.all().empty());
+        REQUIRE(output_of(*c->module, level) == "125615 a ke\n");
+    }
+}
+
+TEST_CASE("match: unreachable arms are warnings, mismatched patterns errors") {
+    auto c = compile(R"CODE(
+        f(x: i32): i32 {
+            match (x) {
+                1 => { return 1; }
+                1 => { return 2; }
+                _ => { return 3; }
+                2 => { return 4; }
+            }
+            return 0;
+        }
+    )CODE");
+    REQUIRE(c->diagnostics.all().size() == 2);
+    for (const frontend::Info& d : c->diagnostics.all()) {
+        REQUIRE(d.severity == frontend::Severity::Warning);
+        REQUIRE(d.code == frontend::ErrorCode::E407_UNREACHABLE_PATTERN);
+    }
+    REQUIRE(c->module->find_function("f") != nullptr);
+
+    auto bad = compile(R"CODE(
+        struct P { x: i32; }
+        f(x: i32, p: P): i32 {
+            match (x) { "one" => { return 1; } }
+            match (p) { _ => { return 2; } }
+            return 0;
+        }
+    )CODE");
+    REQUIRE(bad->diagnostics.all().size() == 2);
+    REQUIRE(bad->diagnostics.all()[0].code == frontend::ErrorCode::E405_TYPE_MISMATCH);
+}
@@ -0,0 +1,122 @@
+#include <catch2/catch_test_macros.hpp>
+#include <memory>
+#include <string>
+#include "frontend/diagnostics.h"
+#include "tests/support/compile_helpers.h"
+
+using namespace pallas;
+using namespace pallas::middle;
+using namespace pallas::test;
+
+namespace {
+
+// Loads of vectors in `fn`.
+std::size_t vector_loads(const Function& fn) {
+    std::size_t count = 0;
+    for (BlockId b : fn.block_order()) {
+        for (ValueId v : fn.block_insts(b)) {
+            const Inst& inst = fn.inst(v);
+            count += inst.op == Opcode::OP_LOAD && inst.type.is_vector();
+        }
+    }
+    return count;
+}
+
+}  // namespace
+
+TEST_CASE("soa: elements of @soa arrays read and write like any other") {
+    const std::string code = R"CODE(
+        @soa
+        struct Particle { alive: bool; x: f64; y: f64; id: i32; }
+        struct Pt {
+            x: i32;
+            y: i32;
+            Pt(a: i32, b: i32) { x = a; y = b; }
+            shift(d: i32) { x += d; }
+        }
+        @noinline
+        norm(p: Particle): f64 { return p.x + p.y; }
+        main(): i32 {
+            ps: Particle[40];
+            for (i: i32 = 0; i < 40; i++) {
+                ps[i].x = (f64)i;
+                ps[i].y = 2.0;
+                ps[i].id = i;
+                ps[i].alive = i % 2 == 0;
+            }
+            sum: f64 = 0.0;
+            for (p : ps) {
+                sum += p.x * p.y;
+            }
+            alive: i32 = 0;
+            for (p : ps) {
+                if (p.alive) {
+                    alive += 1;
+                }
+                p.id = 0;
+            }
+            qs: Particle[40] = ps;
+            qs[3] = ps[5];
+            q: Particle = qs[3];
+            small: @soa Pt[3] = [Pt(1, 2), Pt(3, 4)];
+            small[1].shift(10);
+            t: i32 = 0;
+            for (s : small) {
+                t += s.x * 10 + s.y;
+            }
+            println("${sum} ${alive} ${q.id} ${norm(qs[7])} ${qs[39].id} ${t} ${small[2].y}");
+            return 0;
+        }
+    )CODE";
+    for (int level : {0, 2}) {
+        auto c = compile(code);
+        REQUIRE(c->diagnostics.all().empty());
+        REQUIRE(output_of(*c->module, level) == "1560 20 5 9 39 146 0\n");
+    }
+}
+
+TEST_CASE("soa: a loop over one field of a @soa array is vectorized") {
+    auto c = compile(R"CODE(
+        @soa
+        struct P { x: i32; y: i32; z: i32; w: i32; }
+        struct Q { x: i32; y: i32; z: i32; w: i32; }
+        @noinline
+        total(ps: P[256]): i32 {
+            s: i32 = 0;
+            for (p : ps) {
+                s += p.x;
+            }
+            return s;
+        }
+        @noinline
+        total_aos(qs: Q[256]): i32 {
+            s: i32 = 0;
+            for (q : qs) {
+                s += q.x;
+            }
+            return s;
+        }
+        main(): i32 {
+            ps: P[256];
+            qs: Q[256];
+            for (i: i32 = 0; i < 256; i++) {
+                ps[i].x = i;
+                qs[i].x = i;
+            }
+            println("${total(ps)} ${total_aos(qs)}");
+            return 0;
+        }
+    )CODE");
+    REQUIRE(c->diagnostics.all().empty());
+    REQUIRE(output_of(*c->module, 2) == "32640 32640\n");
+    REQUIRE(vector_loads(*c->module->find_function("total")) > 0);
+    REQUIRE(vector_loads(*c->module->find_function("total_aos")) == 0);
+}
+
+TEST_CASE("soa: @soa needs an array of structs") {
+    for (const char* decl : {"a: @soa i32[4];", "a: @packed i32[4];"}) {
+        auto c = compile(std::string("main(): i32 { ") + decl + " return 0; }");
+        REQUIRE_FALSE(c->diagnostics.all().empty());
+        REQUIRE(c->diagnostics.all()[0].code == frontend::ErrorCode::E403_INVALID_ATTRIBUTE);
+    }
+}
@@ -0,0 +1,114 @@
+#include <catch2/catch_test_macros.hpp>
+#include <memory>
+#include <string>
+#include "frontend/diagnostics.h"
+#include "tests/support/compile_helpers.h"
+
+using namespace pallas;
+using namespace pallas::middle;
+using namespace pallas::test;
+
+namespace {
+
+std::size_t count_ops(const Function& fn, Opcode op) {
+    std::size_t count = 0;
+    for (BlockId b : fn.block_order()) {
+        for (ValueId v : fn.block_insts(b)) {
+            count += fn.inst(v).op == op;
+        }
+    }
+    return count;
+}
+
+bool has_error(const frontend::Diagnostics& diagnostics, frontend::ErrorCode code) {
+    for (const auto& d : diagnostics.all()) {
+        if (d.code == code) {
+            return true;
+        }
+    }
+    return false;
+}
+
+}  // namespace
+
+TEST_CASE("strings: interpolation formats every part into one allocation") {
+    const std::string code = R"CODE(
+        @noinline
+        describe(name: char*, n: i32, big: u64, ok: bool, c: char, x: f64, y: f32): char* {
+            return "${name}: n=${n} big=${big} ok=${ok}/${!ok} c=${c} x=${x} y=${y} \${n}";
+        }
+        main(): i32 {
+            s: char* = describe("pallas", -42, 18446744073709551615, true, 'q', 0.25, 1.5);
+            println(s);
+            delete s;
+            return 0;
+        }
+    )CODE";
+    for (int level : {0, 2}) {
+        auto c = compile(code);
+        REQUIRE(c->diagnostics.all().empty());
+        const Function& describe = *c->module->find_function("describe");
+        REQUIRE(count_ops(describe, Opcode::OP_NEW) == 1);
+        REQUIRE(output_of(*c->module, level) ==
+                "pallas: n=-42 big=18446744073709551615 ok=true/false c=q x=0.25 y=1.5 ${n}\n");
+    }
+}
+
+TEST_CASE("strings: print and println write to the output buffer without allocating") {
+    const std::string code = R"CODE(
+        main(): i32 {
+            total: i64 = 0;
+            for (i: i32 = 0; i < 3; i++) {
+                total += (i64)i * 1000000000000;
+                print("[${i}] ${total}");
+                println();
+            }
+            println("nested ${"inner ${total}"} done");
+            println(7);
+            println("plain");
+            arena(128) {
+                s: char* = "in arena ${total}";
+                println(s);
+            }
+            return 0;
+        }
+    )CODE";
+    auto c = compile(code);
+    REQUIRE(c->diagnostics.all().empty());
+    // Only the nested literal, which is a char* in its own right, allocates.
+    REQUIRE(count_ops(*c->module->find_function("main"), Opcode::OP_NEW) == 1);
+    REQUIRE(output_of(*c->module, 2) == "[0] 0\n[1] 1000000000000\n[2] 3000000000000\n"
+                                        "nested inner 3000000000000 done\n7\nplain\n"
+                                        "in arena 3000000000000\n");
+}
+
+TEST_CASE("strings: values that cannot be formatted and malformed parts are errors") {
+    auto c = compile(R"CODE(
+        class Point { public: x: i32; Point(v: i32) { x = v; } }
+        main(): i32 {
+            p: Point* = new Point(1);
+            s: char* = "at ${p}";
+            println(1, 2);
+            return 0;
+        }
+    )CODE");
+    REQUIRE(has_error(c->diagnostics, frontend::ErrorCode::E405_TYPE_MISMATCH));
+    REQUIRE(has_error(c->diagnostics, frontend::ErrorCode::E406_WRONG_ARGUMENT_COUNT));
+
+    for (const char* part : {"${}", "${1 2}", "${(}"}) {
+        auto bad = compile(std::string("main(): i32 { s: char* = \"a ") + part + "\"; return 0; }");
+        INFO(part);
+        REQUIRE(has_error(bad->diagnostics, frontend::ErrorCode::E202_EXPECTED_EXPRESSION));
+    }
+}
+
+TEST_CASE("strings: deleting a string literal is an error") {
+    for (const char* body : {"delete \"abc\";", "s: char* = \"abc\"; delete s;"}) {
+        auto c = compile(std::string("main(): i32 { ") + body + " return 0; }");
+        INFO(body);
+        REQUIRE(c->diagnostics.all().size() == 1);
+        REQUIRE(c->diagnostics.all()[0].message == "cannot delete a string literal");
+    }
+    auto fresh = compile("main(): i32 { s: char* = \"abc ${1}\"; delete s; return 0; }");
+    REQUIRE(fresh->diagnostics.all().empty());
+}
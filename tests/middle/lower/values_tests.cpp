@@ -0,0 +1,208 @@
+#include <catch2/catch_test_macros.hpp>
+#include <memory>
+#include <string>
+#include "frontend/diagnostics.h"
+#include "tests/support/compile_helpers.h"
+
+using namespace pallas;
+using namespace pallas::middle;
+using namespace pallas::test;
+
+namespace {
+
+std::size_t count_ops(const Function& fn, Opcode op) {
+    std::size_t count = 0;
+    for (BlockId b : fn.block_order()) {
+        for (ValueId v : fn.block_insts(b)) {
+            count += fn.inst(v).op == op;
+        }
+    }
+    return count;
+}
+
+// Calls to `callee` in `fn`.
+std::size_t count_calls(const Module& module, const Function& fn, const std::string& callee) {
+    std::size_t count = 0;
+    for (BlockId b : fn.block_order()) {
+        for (ValueId v : fn.block_insts(b)) {
+            const Inst& inst = fn.inst(v);
+            count += inst.op == Opcode::OP_CALL && module.symbol_name(inst.aux) == callee;
+        }
+    }
+    return count;
+}
+
+const std::string kRes = R"CODE(
+    created: i32 = 0;
+    destroyed: i32 = 0;
+    class Res {
+        public:
+            id: i32;
+            pad: i64;
+            more: i64;
+            Res(i: i32) { id = i; created += 1; }
+            ~Res() { destroyed += 1; }
+    }
+)CODE";
+
+}  // namespace
+
+TEST_CASE("values: small records travel as fields, others through the caller's slot") {
+    auto values = compile(R"CODE(
+        struct Vector3 { x: f32; y: f32; z: f32; }
+        struct Meters { v: f64; }
+        struct Big { a: i64; b: i64; c: i64; d: i64; e: i64; }
+        @noinline
+        add(a: Vector3, b: Vector3): Vector3 {
+            r: Vector3;
+            r.x = a.x + b.x;
+            r.y = a.y + b.y;
+            r.z = a.z + b.z;
+            return r;
+        }
+        @noinline
+        twice(m: Meters): Meters {
+            r: Meters;
+            r.v = m.v * 2.0;
+            return r;
+        }
+        @noinline
+        make_big(n: i64): Big {
+            b: Big;
+            b.a = n;
+            b.e = n + 4;
+            return b;
+        }
+        @noinline
+        sum(b: Big): i64 { return b.a + b.e; }
+        main(): i32 {
+            p: Vector3;
+            p.x = 1.0;
+            p.y = 2.0;
+            p.z = 3.0;
+            v: Vector3 = add(p, p);
+            h: Meters;
+            h.v = 1.25;
+            m: Meters = twice(h);
+            b: Big = make_big(10);
+            println("${v.x} ${v.y} ${v.z} ${m.v} ${sum(b)}");
+            return 0;
+        }
+    )CODE");
+    REQUIRE(values->diagnostics.all().empty());
+    const Module& module = *values->module;
+
+    // Vector3: six floats in, the result through a slot.
+    const Function* add = module.find_function("add");
+    REQUIRE(add != nullptr);
+    REQUIRE(add->num_args() == 7);
+    REQUIRE(add->return_type.kind == IRTypeKind::IR_VOID);
+    // The local every return names is the result slot itself.
+    REQUIRE(count_ops(*add, Opcode::OP_ALLOCA) == 2);  // a and b, put back together
+
+    // A record of one field comes back as that field.
+    const Function* twice = module.find_function("twice");
+    REQUIRE(twice->num_args() == 1);
+    REQUIRE(twice->return_type.kind == IRTypeKind::IR_F64);
+
+    // Big records go by pointer; the local returned is built in the slot.
+    const Function* make_big = module.find_function("make_big");
+    REQUIRE(make_big->num_args() == 2);
+    REQUIRE(count_ops(*make_big, Opcode::OP_ALLOCA) == 0);
+    // main initializes b in place and hands it to sum without a copy.
+    const Function* main = module.find_function("main");
+    REQUIRE(count_ops(*main, Opcode::OP_ALLOCA) == 5);  // p, v, h, m, b
+
+    REQUIRE(output_of(*values->module, 0) == "2 4 6 2.5 24\n");
+}
+
+TEST_CASE("values: moved-from objects are neither copied nor destroyed") {
+    const std::string code = kRes + R"CODE(
+        @noinline
+        take(r: Res): i32 { return r.id; }
+        @noinline
+        peek(r: Res): i32 { return r.id * 2; }
+        @noinline
+        pass_on(r: Res): Res { return r; }
+        @noinline
+        pick(c: bool): Res {
+            a: Res = Res(1);
+            if (c) { return a; }
+            b: Res = Res(2);
+            return b;
+        }
+        @noinline
+        moves(): i32 {
+            x: Res = Res(1);
+            return take(x);
+        }
+        body(): i32 {
+            t: i32 = 0;
+            x: Res = Res(1);
+            if (t == 0) { t += take(x); }
+            y: Res = Res(2);
+            t += peek(y);
+            t += y.id;
+            for (i: i32 = 0; i < 3; i++) {
+                z: Res = Res(i);
+                t += take(z);
+                t += peek(y);
+            }
+            w: Res = pass_on(Res(9));
+            v: Res = w;
+            v = pass_on(Res(4));
+            t += v.id + pick(true).id + pick(false).id + moves();
+            println("t=${t} created=${created} destroyed=${destroyed}");
+            return t;
+        }
+        main(): i32 {
+            t: i32 = body();
+            println("after: ${destroyed}");
+            return 0;
+        }
+    )CODE";
+    auto c = compile(code);
+    REQUIRE(c->diagnostics.all().empty());
+    // The unconditional move leaves nothing to destroy and nothing to copy.
+    const Function* moves = c->module->find_function("moves");
+    REQUIRE(count_calls(*c->module, *moves, "Res.$dtor") == 0);
+    REQUIRE(count_ops(*moves, Opcode::OP_ALLOCA) == 1);
+    // Only the object not returned is destroyed, and only on that path.
+    const Function* pick = c->module->find_function("pick");
+    REQUIRE(count_calls(*c->module, *pick, "Res.$dtor") == 1);
+
+    // Copies are destroyed by the callee, moved objects once by whoever
+    // ends up with them.
+    const std::string expected = "t=30 created=11 destroyed=10\nafter: 14\n";
+    REQUIRE(output_of(*c->module, 0) == expected);
+    auto optimized = compile(code);
+    REQUIRE(output_of(*optimized->module, 2) == expected);
+}
+
+TEST_CASE("values: destructors run on every way out of a scope") {
+    const std::string code = kRes + R"CODE(
+        @noinline
+        find(limit: i32): i32 {
+            for (i: i32 = 0; i < 10; i++) {
+                r: Res = Res(i);
+                if (i == limit) { return r.id; }
+                if (i > 6) { break; }
+            }
+            return -1;
+        }
+        main(): i32 {
+            t: i32 = find(3) + find(20);
+            {
+                a: Res = Res(5);
+                t += a.id;
+            }
+            println("t=${t} destroyed=${destroyed}");
+            return 0;
+        }
+    )CODE";
+    auto c = compile(code);
+    REQUIRE(c->diagnostics.all().empty());
+    REQUIRE(output_of(*c->module, 0) == "t=7 destroyed=13\n");
+    auto optimized = compile(code);
+    REQUIRE(output_of(*optimized->module, 2) == "t=7 destroyed=13\n");
+}
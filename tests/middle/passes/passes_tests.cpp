@@ -0,0 +1,231 @@
+#include <algorithm>
+#include <atomic>
+#include <catch2/catch_test_macros.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+#include "middle/ir.h"
+#include "middle/parallel.h"
+#include "middle/passes.h"
+
+using namespace pallas::middle;
+
+static std::unique_ptr<Module> parse(const std::string& text) {
+    auto module = parse_module(text, nullptr);
+    REQUIRE(module != nullptr);
+    return module;
+}
+
+// Two nested counted loops; the inner one accumulates into %acc.
+static const char* kNested =
+    "func @f(i32 %n) -> i32 {\n"
+    "entry:\n"
+    "  br outer\n"
+    "outer:\n"
+    "  %i = phi i32 [i32 0, entry], [%i.next, outer.latch]\n"
+    "  %acc = phi i32 [i32 0, entry], [%acc.inner, outer.latch]\n"
+    "  br inner\n"
+    "inner:\n"
+    "  %j = phi i32 [i32 0, outer], [%j.next, inner]\n"
+    "  %acc.inner = phi i32 [%acc, outer], [%sum, inner]\n"
+    "  %sum = add i32 %acc.inner, %j\n"
+    "  %j.next = add i32 %j, i32 1\n"
+    "  %c = icmp slt %j.next, %n\n"
+    "  condbr %c, inner, outer.latch\n"
+    "outer.latch:\n"
+    "  %i.next = add i32 %i, i32 1\n"
+    "  %d = icmp slt %i.next, %n\n"
+    "  condbr %d, outer, exit\n"
+    "exit:\n"
+    "  ret %acc.inner\n"
+    "}\n";
+
+TEST_CASE("passes: dominator tree of a diamond") {
+    auto module = parse(
+        "func @f(i1 %c) -> void {\n"
+        "a:\n"
+        "  condbr %c, b, c\n"
+        "b:\n"
+        "  br d\n"
+        "c:\n"
+        "  br d\n"
+        "d:\n"
+        "  ret\n"
+        "e:\n"
+        "  br d\n"
+        "}\n");
+    Function& fn = *module->functions[0];
+    AnalysisManager analyses;
+    const CFGInfo& cfg = analyses.cfg(fn);
+    const DominatorTree& dom = analyses.dominators(fn);
+    const auto& order = fn.block_order();
+    BlockId a = order[0], b = order[1], c = order[2], d = order[3], e = order[4];
+
+    REQUIRE(cfg.preds(d).size() == 3);
+    REQUIRE(cfg.rpo().size() == 4);
+    REQUIRE_FALSE(cfg.reachable(e));
+    REQUIRE(dom.idom(b) == a);
+    REQUIRE(dom.idom(c) == a);
+    REQUIRE(dom.idom(d) == a);
+    REQUIRE(dom.dominates(a, d));
+    REQUIRE_FALSE(dom.dominates(b, d));
+    REQUIRE_FALSE(dom.dominates(c, d));
+    REQUIRE(dom.strictly_dominates(a, b));
+    REQUIRE_FALSE(dom.strictly_dominates(a, a));
+}
+
+TEST_CASE("passes: loop nest with preheaders and exits") {
+    auto module = parse(kNested);
+    Function& fn = *module->functions[0];
+    AnalysisManager analyses;
+    const LoopInfo& info = analyses.loops(fn);
+    const auto& order = fn.block_order();
+    BlockId entry = order[0], outer = order[1], inner = order[2], latch = order[3], exit = order[4];
+
+    REQUIRE(info.loops().size() == 2);
+    const Loop& outer_loop = info.loops()[info.loop_for(outer)];
+    const Loop& inner_loop = info.loops()[info.loop_for(inner)];
+    REQUIRE(outer_loop.header == outer);
+    REQUIRE(outer_loop.blocks.size() == 3);
+    REQUIRE(outer_loop.preheader == entry);
+    REQUIRE(outer_loop.exits == std::vector<BlockId>{exit});
+    REQUIRE(inner_loop.header == inner);
+    REQUIRE(inner_loop.latches == std::vector<BlockId>{inner});
+    REQUIRE(inner_loop.preheader == outer);
+    REQUIRE(inner_loop.depth == 2);
+    REQUIRE(info.depth(latch) == 1);
+    REQUIRE(info.depth(exit) == 0);
+    REQUIRE(info.loops()[info.innermost_first()[0]].header == inner);
+}
+
+TEST_CASE("passes: liveness across loops and phis") {
+    auto module = parse(kNested);
+    Function& fn = *module->functions[0];
+    AnalysisManager analyses;
+    const Liveness& live = analyses.liveness(fn);
+    const auto& order = fn.block_order();
+    BlockId outer = order[1], inner = order[2], latch = order[3], exit = order[4];
+    ValueId n = fn.arg(0);
+    ValueId i = fn.block(outer).first;
+    ValueId acc_inner = fn.inst(fn.block(inner).first).next;
+    ValueId sum = fn.inst(acc_inner).next;
+    ValueId c = fn.inst(fn.inst(sum).next).next;
+
+    REQUIRE(live.live_in(inner, n));
+    REQUIRE(live.live_in(inner, i));
+    REQUIRE(live.live_out(inner, acc_inner));
+    REQUIRE(live.live_in(exit, acc_inner));
+    REQUIRE_FALSE(live.live_in(outer, i));  // defined by a phi on entry
+    REQUIRE_FALSE(live.live_out(exit, n));
+    REQUIRE(live.live_in(latch, acc_inner));
+    REQUIRE(live.live_out(inner, sum));  // flows into a phi of its own block
+    REQUIRE_FALSE(live.live_out(inner, c));  // used only where it is defined
+    REQUIRE(live.live_in_values(latch) == std::vector<ValueId>{n, i, acc_inner});
+}
+
+namespace {
+
+class CountingPass : public FunctionPass {
+  public:
+    CountingPass(const char* label, PreservedAnalyses preserved) : label(label), preserved(preserved) {}
+    const char* name() const override { return label; }
+    PreservedAnalyses run(Function& fn, AnalysisManager& analyses) override {
+        analyses.dominators(fn);
+        analyses.liveness(fn);
+        return preserved;
+    }
+
+  private:
+    const char* label;
+    PreservedAnalyses preserved;
+};
+
+// Deletes the return of every function, which the verifier must catch.
+class BreakingPass : public FunctionPass {
+  public:
+    const char* name() const override { return "break"; }
+    PreservedAnalyses run(Function& fn, AnalysisManager&) override {
+        fn.erase(fn.terminator(fn.block_order().back()));
+        return PreservedAnalyses::none();
+    }
+};
+
+}  // namespace
+
+TEST_CASE("passes: analyses are cached until a pass invalidates them") {
+    auto module = parse(kNested);
+    PassOptions options;
+    options.time_passes = true;
+    PassManager manager(options);
+    manager.add(std::make_unique<CountingPass>("keep-all", PreservedAnalyses::all()));
+    manager.add(std::make_unique<CountingPass>("keep-cfg", PreservedAnalyses::cfg()));
+    manager.add(std::make_unique<CountingPass>("keep-all", PreservedAnalyses::all()));
+    manager.add(std::make_unique<CountingPass>("keep-none", PreservedAnalyses::none()));
+    manager.add(std::make_unique<CountingPass>("keep-all", PreservedAnalyses::all()));
+    REQUIRE(manager.run(*module));
+
+    const AnalysisStats& stats = manager.analyses().stats();
+    REQUIRE(stats.computed[static_cast<int>(AnalysisKind::ANALYSIS_DOMINATORS)] == 2);
+    REQUIRE(stats.computed[static_cast<int>(AnalysisKind::ANALYSIS_LIVENESS)] == 3);
+    REQUIRE(stats.computed[static_cast<int>(AnalysisKind::ANALYSIS_CFG)] == 2);
+
+    REQUIRE(manager.timings().size() == 3);
+    REQUIRE(manager.timings()[0].name == "keep-all");
+    REQUIRE(manager.timings()[0].runs == 3);
+    REQUIRE(manager.timings()[0].instructions_before == 3 * 14);
+    std::string report = manager.timing_report();
+    REQUIRE(report.find("keep-none") != std::string::npos);
+    REQUIRE(report.find("dominators") != std::string::npos);
+}
+
+TEST_CASE("passes: verify-each names the pass that broke the IR") {
+    auto module = parse(kNested);
+    PassOptions options;
+    options.verify_each = true;
+    PassManager manager(options);
+    manager.add(std::make_unique<BreakingPass>());
+    REQUIRE_FALSE(manager.run(*module));
+    REQUIRE(manager.error().find("after break") != std::string::npos);
+
+    PassManager by_name;
+    REQUIRE(add_pass_by_name(by_name, "print-loops"));
+    REQUIRE_FALSE(add_pass_by_name(by_name, "no-such-pass"));
+}
+
+TEST_CASE("passes: function passes on several threads give the serial result") {
+    std::string text;
+    for (int i = 0; i < 24; ++i) {
+        std::string fn = kNested;
+        fn.replace(fn.find("@f"), 2, "@f" + std::to_string(i));
+        text += fn;
+    }
+    std::string serial;
+    for (unsigned threads : {1u, 4u}) {
+        auto module = parse(text);
+        PassOptions options;
+        options.threads = threads;
+        options.time_passes = true;
+        options.verify_each = true;
+        PassManager manager(options);
+        build_pipeline(manager, 2);
+        REQUIRE(manager.run(*module));
+        REQUIRE(manager.timings()[1].name == "simplifycfg");
+        REQUIRE(manager.timings()[1].runs >= 2 * 24);
+        if (threads == 1) {
+            serial = print_module(*module);
+        } else {
+            REQUIRE(print_module(*module) == serial);
+        }
+    }
+
+    std::vector<std::atomic<int>> visits(1000);
+    std::atomic<unsigned> max_worker{0};
+    parallel_for(visits.size(), 8, [&](std::size_t i, unsigned worker) {
+        visits[i] += 1;
+        max_worker = std::max(max_worker.load(), worker);
+    });
+    REQUIRE(max_worker < 8);
+    for (const std::atomic<int>& count : visits) {
+        REQUIRE(count == 1);
+    }
+}
@@ -0,0 +1,278 @@
+#include <catch2/catch_test_macros.hpp>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include "middle/interpreter.h"
+#include "middle/passes.h"
+#include "middle/profile.h"
+#include "middle/transforms.h"
+#include "tests/support/compile_helpers.h"
+
+using namespace pallas;
+using namespace pallas::middle;
+using namespace pallas::test;
+
+namespace {
+
+// Runs an instrumented build of `code` and returns the profile it wrote.
+ProfileData collect(const std::string& code, std::uint64_t expected) {
+    std::filesystem::path path = std::filesystem::temp_directory_path() / "pallas_profile_tests";
+    std::filesystem::remove(path);
+    auto c = compile_clean(code);
+    PassOptions options;
+    options.verify_each = true;
+    PassManager manager(options);
+    manager.add(create_profile_generate_pass(path.string()));
+    REQUIRE(manager.run(*c->module));
+    for (int run = 0; run < 2; ++run) {  // a second run adds to the counts
+        Interpreter interpreter(*c->module);
+        ExecutionResult result = interpreter.run("main");
+        INFO(result.error);
+        REQUIRE(result.ok);
+        REQUIRE(result.value == expected);
+    }
+    std::ifstream file(path, std::ios::binary);
+    std::stringstream bytes;
+    bytes << file.rdbuf();
+    std::filesystem::remove(path);
+    ProfileData profile;
+    std::string error;
+    bool parsed = parse_profile(bytes.str(), &profile, &error);
+    INFO(error);
+    REQUIRE(parsed);
+    return profile;
+}
+
+ValueId find_op(const Function& fn, Opcode op) {
+    for (BlockId b : fn.block_order()) {
+        for (ValueId v : fn.block_insts(b)) {
+            if (fn.inst(v).op == op) {
+                return v;
+            }
+        }
+    }
+    return kNoValue;
+}
+
+std::size_t count_calls(const Function& fn) {
+    std::size_t calls = 0;
+    for (BlockId b : fn.block_order()) {
+        for (ValueId v : fn.block_insts(b)) {
+            calls += fn.inst(v).op == Opcode::OP_CALL;
+        }
+    }
+    return calls;
+}
+
+const std::string kClassify = R"CODE(
+    @noinline
+    classify(x: i32): i32 {
+        if (x % 100 == 0) {
+            return 7;
+        }
+        match (x % 4) {
+            0 => { return 1; }
+            1 => { return 2; }
+            2 => { return 5; }
+            3 => { return 3; }
+        }
+        return 0;
+    }
+)CODE";
+
+const std::string kClassifyMain = R"CODE(
+    main(): i32 {
+        t: i32 = 0;
+        for (i: i32 = 0; i < 1000; i++) {
+            t += classify(i * 4 + 3);
+        }
+        return t % 256;
+    }
+)CODE";
+
+}  // namespace
+
+TEST_CASE("profile: an instrumented run counts blocks, branches and switch edges") {
+    ProfileData profile = collect(kClassify + kClassifyMain, 3000 % 256);
+    REQUIRE(profile.functions.size() == 2);
+
+    auto c = compile_clean(kClassify + kClassifyMain);
+    ProfileUseReport report = apply_profile(*c->module, profile);
+    REQUIRE(report.matched == 2);
+    REQUIRE(report.stale.empty());
+
+    const Function& classify = *c->module->find_function("classify");
+    REQUIRE(classify.profile.entry_count == 2000);
+    REQUIRE(c->module->find_function("main")->profile.entry_count == 2);
+    ValueId branch = find_op(classify, Opcode::OP_COND_BR);
+    REQUIRE(classify.profile.branch_weights.at(branch) == std::vector<std::uint64_t>{0, 2000});
+    // Default, then the cases in source order: only `3` ever matched.
+    ValueId dispatch = find_op(classify, Opcode::OP_SWITCH);
+    REQUIRE(classify.profile.branch_weights.at(dispatch) ==
+            std::vector<std::uint64_t>{0, 0, 0, 0, 2000});
+    REQUIRE(classify.profile.block_count(classify.targets(branch)[0]) == 0);
+}
+
+TEST_CASE("profile: functions changed since the profile was collected get no counts") {
+    ProfileData profile = collect(kClassify + kClassifyMain, 3000 % 256);
+    std::string edited = kClassify;
+    edited.replace(edited.find("return 5"), 8, "return 6");
+    auto c = compile_clean(edited + kClassifyMain);
+    ProfileUseReport report = apply_profile(*c->module, profile);
+    REQUIRE(report.matched == 1);
+    REQUIRE(report.stale == std::vector<std::string>{"classify"});
+    REQUIRE(c->module->find_function("classify")->profile.empty());
+    REQUIRE_FALSE(c->module->find_function("main")->profile.empty());
+
+    ProfileData garbage;
+    std::string error;
+    REQUIRE_FALSE(parse_profile("PALPROF1\x01", &garbage, &error));
+    REQUIRE_FALSE(parse_profile("not a profile", &garbage, &error));
+}
+
+TEST_CASE("profile: hot switch cases go first and blocks that never ran go last") {
+    ProfileData profile = collect(kClassify + kClassifyMain, 3000 % 256);
+    auto c = compile_clean(kClassify + kClassifyMain);
+    apply_profile(*c->module, profile);
+    PassOptions options;
+    options.verify_each = true;
+    PassManager manager(options);
+    build_pipeline(manager, 2);
+    manager.add(create_profile_layout_pass());
+    REQUIRE(manager.run(*c->module));
+
+    const Function& classify = *c->module->find_function("classify");
+    ValueId dispatch = find_op(classify, Opcode::OP_SWITCH);
+    REQUIRE(classify.inst(classify.operand(dispatch, 1)).imm == 3);
+    REQUIRE(classify.profile.branch_weights.at(dispatch)[1] == 2000);
+    // `return 7` and the cases that never matched follow the hot path.
+    BlockId hot = classify.targets(dispatch)[1];
+    std::size_t hot_position = 0;
+    for (std::size_t i = 0; i < classify.block_order().size(); ++i) {
+        BlockId b = classify.block_order()[i];
+        if (b == hot) {
+            hot_position = i;
+        } else if (b != classify.entry() && classify.profile.block_count(b) == 0) {
+            REQUIRE(i > hot_position);
+        }
+    }
+    REQUIRE(hot_position > 0);
+
+    Interpreter interpreter(*c->module);
+    ExecutionResult result = interpreter.run("main");
+    REQUIRE(result.ok);
+    REQUIRE(result.value == 3000 % 256);
+}
+
+TEST_CASE("profile: hot calls are inlined past the threshold, calls that never ran are not") {
+    std::string callee = "mix(x: i32): i32 {\n";
+    for (int i = 0; i < 20; ++i) {
+        callee += "    x = (x ^ " + std::to_string(i + 5) + ") * 7 + 3;\n";
+    }
+    callee += "    return x;\n}\n";
+    const std::string code = callee + R"CODE(
+        main(): i32 {
+            t: i32 = 0;
+            for (i: i32 = 0; i < 100; i++) {
+                t += mix(i);
+                if (i > 1000) {
+                    t += mix(t);
+                }
+            }
+            return t & 255;
+        }
+    )CODE";
+    std::uint64_t expected = 0;
+    {
+        auto c = compile_clean(code);
+        PassManager manager;
+        build_pipeline(manager, 2);
+        REQUIRE(manager.run(*c->module));
+        // Too large for the default threshold.
+        REQUIRE(count_calls(*c->module->find_function("main")) == 2);
+        Interpreter interpreter(*c->module);
+        ExecutionResult result = interpreter.run("main");
+        REQUIRE(result.ok);
+        expected = result.value;
+    }
+    ProfileData profile = collect(code, expected);
+    auto c = compile_clean(code);
+    apply_profile(*c->module, profile);
+    PassOptions options;
+    options.verify_each = true;
+    PassManager manager(options);
+    build_pipeline(manager, 2);
+    REQUIRE(manager.run(*c->module));
+    const Function& main = *c->module->find_function("main");
+    REQUIRE(count_calls(main) == 1);
+    // The inlined copy carries the call's counts.
+    REQUIRE(main.profile.entry_count == 2);
+    Interpreter interpreter(*c->module);
+    ExecutionResult result = interpreter.run("main");
+    REQUIRE(result.ok);
+    REQUIRE(result.value == expected);
+}
+
+TEST_CASE("profile: heap profiling numbers the allocation sites and brackets main") {
+    const std::string code = R"CODE(
+        struct Pair {
+            a: i64;
+            b: i64;
+        }
+
+        @noinline
+        make(): Pair* {
+            return new Pair;
+        }
+
+        main(): i32 {
+            p: Pair* = make();
+            arena(512) {
+                q: Pair* = new Pair;
+                q.a = 1;
+            }
+            delete p;
+            return 0;
+        }
+    )CODE";
+    auto c = compile_clean(code);
+    PassOptions options;
+    options.verify_each = true;
+    PassManager manager(options);
+    manager.add(create_heap_profile_pass("heap.pprof", 4096));
+    REQUIRE(manager.run(*c->module));
+
+    std::vector<std::string> calls;
+    for (const auto& fn : c->module->functions) {
+        REQUIRE(find_op(*fn, Opcode::OP_NEW) == kNoValue);
+        REQUIRE(find_op(*fn, Opcode::OP_DELETE) == kNoValue);
+    }
+    const Function& main = *c->module->find_function("main");
+    for (BlockId b : main.block_order()) {
+        for (ValueId v : main.block_insts(b)) {
+            if (main.inst(v).op == Opcode::OP_CALL) {
+                calls.push_back(c->module->symbol_name(main.inst(v).aux));
+            }
+        }
+    }
+    REQUIRE(calls.front() == "pallas_heap_profile_start");
+    REQUIRE(calls.back() == "pallas_heap_profile_stop");
+    REQUIRE(std::count(calls.begin(), calls.end(), "pallas_heap_arena_init") == 1);
+    REQUIRE(std::count(calls.begin(), calls.end(), "pallas_heap_delete") == 1);
+    REQUIRE(std::count(calls.begin(), calls.end(), "pallas_arena_init") == 0);
+    REQUIRE(std::count(calls.begin(), calls.end(), "pallas_heap_arena_alloc") == 1);
+    REQUIRE(std::count(calls.begin(), calls.end(), "pallas_arena_alloc") == 0);
+
+    // Three sites: `new` in make, on line 9, the arena in main on line 14, and
+    // the refills of the `new` in it on line 15.
+    SymbolId symbol = c->module->find_symbol("pallas.heap_profile.descriptor");
+    const std::string& descriptor = c->module->find_global(symbol)->bytes;
+    std::string expected("\3\0\0\0", 4);
+    expected += std::string("\x09\0\0\0\0\x04\0\0\0", 9) + "make";
+    expected += std::string("\x0e\0\0\0\1\x04\0\0\0", 9) + "main";
+    expected += std::string("\x0f\0\0\0\0\x04\0\0\0", 9) + "main";
+    REQUIRE(descriptor == expected);
+}
@@ -0,0 +1,171 @@
+#include <catch2/catch_test_macros.hpp>
+#include <memory>
+#include <string>
+#include "middle/interpreter.h"
+#include "middle/lower.h"
+#include "middle/passes.h"
+#include "middle/transforms.h"
+#include "tests/support/compile_helpers.h"
+
+using namespace pallas;
+using namespace pallas::middle;
+using namespace pallas::test;
+
+namespace {
+
+BoundsCheckReport optimize_with_report(Module& module, int level) {
+    PassOptions options;
+    options.verify_each = true;
+    PassManager manager(options);
+    BoundsCheckReport report;
+    build_pipeline(manager, level, &report);
+    REQUIRE(manager.run(module));
+    return report;
+}
+
+const BoundsCheckReport::Entry& entry_for(const BoundsCheckReport& report,
+                                          const std::string& function) {
+    for (const BoundsCheckReport::Entry& entry : report.functions) {
+        if (entry.function == function) {
+            return entry;
+        }
+    }
+    FAIL("no bounds-check report for @" << function);
+    return report.functions.front();
+}
+
+ExecutionResult run(const Module& module) {
+    Interpreter interpreter(module);
+    return interpreter.run("main");
+}
+
+}  // namespace
+
+TEST_CASE("bce: checks proven by loop bounds, masks and earlier checks are removed") {
+    auto c = compile_clean(R"CODE(
+        const N: i32 = 32;
+        main(): i32 {
+            a: i32[N];
+            for (i: i32 = 0; i < N; i++) { a[i] = 3 * i; }
+            t: i32 = 0;
+            for (x : a) { t += x; }
+            for (i: i32 = N - 1; i >= 0; i--) { t -= a[i] / 3; }
+            k: i32 = t & 15;
+            t += a[k] + a[k];
+            return t;
+        }
+    )CODE");
+    ExecutionResult before = run(*c->module);
+    REQUIRE(before.ok);
+    REQUIRE(before.stats.bounds_checks == 32 * 3 + 2);
+    BoundsCheckReport report = optimize_with_report(*c->module, 1);
+    const BoundsCheckReport::Entry& main_entry = entry_for(report, "main");
+    REQUIRE(main_entry.removed == 5);
+    REQUIRE(main_entry.hoisted == 0);
+    REQUIRE(main_entry.remaining == 0);
+    ExecutionResult after = run(*c->module);
+    REQUIRE(after.ok);
+    REQUIRE(after.value == before.value);
+    REQUIRE(after.stats.bounds_checks == 0);
+}
+
+TEST_CASE("bce: checks against a run-time bound are hoisted out of the loop") {
+    auto c = compile_clean(R"CODE(
+        @noinline
+        prefix(n: i32, k: i32): i32 {
+            a: i32[100];
+            for (i: i32 = 0; i < 100; i++) { a[i] = i; }
+            t: i32 = 0;
+            for (i: i32 = 0; i < n; i++) { t += a[i] + a[k]; }
+            return t;
+        }
+        main(): i32 { return prefix(50, 7) % 256; }
+    )CODE");
+    ExecutionResult before = run(*c->module);
+    REQUIRE(before.ok);
+    BoundsCheckReport report = optimize_with_report(*c->module, 2);
+    const BoundsCheckReport::Entry& entry = entry_for(report, "prefix");
+    REQUIRE(entry.removed == 1);
+    REQUIRE(entry.hoisted == 2);
+    ExecutionResult after = run(*c->module);
+    REQUIRE(after.ok);
+    REQUIRE(after.value == before.value);
+    // Only the hoisted checks run, once per call, instead of twice per iteration.
+    REQUIRE(after.stats.bounds_checks == entry.remaining);
+    REQUIRE(after.stats.bounds_checks < 4);
+}
+
+TEST_CASE("bce: out-of-range indices still stop the program at every level") {
+    const char* const programs[] = {
+        R"CODE(
+            fill(n: i32): i32 {
+                a: i32[16];
+                for (i: i32 = 0; i < n; i++) { a[i] = i; }
+                return a[3];
+            }
+            main(): i32 { return fill(17); }
+        )CODE",
+        R"CODE(
+            main(): i32 {
+                a: i32[8];
+                t: i32 = 0;
+                for (i: i32 = 7; i >= -1; i--) { t += a[i]; }
+                return t;
+            }
+        )CODE",
+        R"CODE(
+            pick(k: i32): i32 {
+                a: i32[4] = [1, 2, 3, 4];
+                return a[k & 7];
+            }
+            main(): i32 { return pick(5); }
+        )CODE",
+    };
+    for (const char* code : programs) {
+        for (int level = 0; level <= 3; ++level) {
+            auto c = compile_clean(code);
+            optimize_with_report(*c->module, level);
+            ExecutionResult result = run(*c->module);
+            REQUIRE_FALSE(result.ok);
+            REQUIRE(result.error.find("out of bounds for length") != std::string::npos);
+        }
+    }
+}
+
+TEST_CASE("bce: a loop that makes calls keeps its checks in place") {
+    auto c = compile_clean(R"CODE(
+        counter: i32 = 0;
+        @noinline
+        tick(): void { counter += 1; }
+        main(): i32 {
+            a: i32[8];
+            n: i32 = 6 + counter;
+            for (i: i32 = 0; i < n; i++) { tick(); a[i] = i; }
+            return a[5] + counter;
+        }
+    )CODE");
+    BoundsCheckReport report = optimize_with_report(*c->module, 2);
+    REQUIRE(entry_for(report, "main").hoisted == 0);
+    REQUIRE(entry_for(report, "main").remaining == 1);
+    ExecutionResult result = run(*c->module);
+    REQUIRE(result.ok);
+    REQUIRE(result.value == 11);
+}
+
+TEST_CASE("bce: lowering without bounds checks emits none") {
+    LowerOptions options;
+    options.bounds_checks = false;
+    auto c = compile_clean(R"CODE(
+        main(): i32 {
+            a: i32[4] = [1, 2, 3, 4];
+            t: i32 = 0;
+            for (x : a) { t += x; }
+            return t + a[2];
+        }
+    )CODE",
+                     options);
+    ExecutionResult result = run(*c->module);
+    REQUIRE(result.ok);
+    REQUIRE(result.value == 13);
+    REQUIRE(result.stats.bounds_checks == 0);
+}
@@ -0,0 +1,120 @@
+#include <catch2/catch_test_macros.hpp>
+#include <memory>
+#include <string>
+#include "middle/interpreter.h"
+#include "tests/support/compile_helpers.h"
+
+using namespace pallas;
+using namespace pallas::middle;
+using namespace pallas::test;
+
+namespace {
+
+ExecutionResult run(const Module& module) {
+    Interpreter interpreter(module);
+    return interpreter.run("main");
+}
+
+const char* const kPeople = R"CODE(
+    counter: i32 = 0;
+    class Person {
+        public:
+            age: i32;
+            weight: i32;
+            Person(a: i32) { age = a; weight = 70; }
+            ~Person() { counter += 1; }
+            older(): i32 { return age + 1; }
+    }
+)CODE";
+
+}  // namespace
+
+TEST_CASE("escape: new and delete run constructors, destructors and count allocations") {
+    auto c = compile_clean(std::string(kPeople) + R"CODE(
+        main(): i32 {
+            p: Person* = new Person(41);
+            t: i32 = p.older() + p.weight;
+            delete p;
+            q: Person* = null;
+            delete q;
+            n: i32 = 5;
+            xs: i64* = new i64[n];
+            for (i: i32 = 0; i < n; i++) { xs[i] = (i64) i; }
+            x: i32* = new i32(7);
+            t += (i32) xs[4] + x[0] + counter;
+            delete xs;
+            delete x;
+            return t;
+        }
+    )CODE");
+    ExecutionResult result = run(*c->module);
+    REQUIRE(result.ok);
+    REQUIRE(result.value == 42 + 70 + 4 + 7 + 1);
+    REQUIRE(result.stats.allocations == 3);
+    REQUIRE(result.stats.frees == 3);
+}
+
+TEST_CASE("escape: allocations that die with the function move to the stack") {
+    const std::string code = std::string(kPeople) + R"CODE(
+        @noinline
+        sum(n: i32): i32 {
+            t: i32 = 0;
+            for (i: i32 = 0; i < n; i++) {
+                p: Person* = new Person(i);
+                t += p.older() + p.weight;
+                delete p;
+            }
+            return t;
+        }
+        main(): i32 {
+            scratch: i32* = new i32[4];
+            scratch[2] = 9;
+            r: i32 = sum(100) + scratch[2];
+            delete scratch;
+            return (r + counter) % 256;
+        }
+    )CODE";
+    ExecutionResult before = run(*compile_clean(code)->module);
+    REQUIRE(before.ok);
+    REQUIRE(before.stats.allocations == 101);
+    for (int level = 1; level <= 2; ++level) {
+        auto c = compile_clean(code);
+        optimize(*c->module, level);
+        ExecutionResult after = run(*c->module);
+        REQUIRE(after.ok);
+        REQUIRE(after.value == before.value);
+        REQUIRE(after.stats.allocations == 0);
+        REQUIRE(after.stats.frees == 0);
+    }
+}
+
+TEST_CASE("escape: allocations that outlive the function stay on the heap") {
+    auto c = compile_clean(std::string(kPeople) + R"CODE(
+        @noinline
+        make(n: i32): Person* { return new Person(n); }
+        @noinline
+        release(p: Person*): void { delete p; }
+        @noinline
+        link(slot: Person**, p: Person*): void { slot[0] = p; }
+        main(): i32 {
+            a: Person* = make(3);
+            b: Person* = new Person(4);
+            release(b);
+            slots: Person** = new Person*[1];
+            c: Person* = new Person(5);
+            link(slots, c);
+            t: i32 = a.age + slots[0].age;
+            delete a;
+            delete slots[0];
+            delete slots;
+            return t + counter;
+        }
+    )CODE");
+    optimize(*c->module, 2);
+    ExecutionResult result = run(*c->module);
+    REQUIRE(result.ok);
+    REQUIRE(result.value == 3 + 5 + 3);
+    // `slots` is only written through, so it is the one allocation promoted.
+    REQUIRE(result.stats.allocations == 3);
+    REQUIRE(result.stats.frees == 3);
+}
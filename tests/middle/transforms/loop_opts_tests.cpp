@@ -0,0 +1,368 @@
+#include <catch2/catch_test_macros.hpp>
+#include <memory>
+#include <string>
+#include "middle/interpreter.h"
+#include "middle/passes.h"
+#include "middle/transforms.h"
+#include "tests/support/compile_helpers.h"
+
+using namespace pallas;
+using namespace pallas::middle;
+using namespace pallas::test;
+
+namespace {
+
+std::string run_passes(Module& module, std::initializer_list<const char*> passes) {
+    PassOptions options;
+    options.verify_each = true;
+    PassManager manager(options);
+    for (const char* name : passes) {
+        REQUIRE(add_pass_by_name(manager, name));
+    }
+    REQUIRE(manager.run(module));
+    return print_module(module);
+}
+
+ExecutionResult run(const Module& module) {
+    Interpreter interpreter(module);
+    ExecutionResult result = interpreter.run("main");
+    INFO(result.error);
+    REQUIRE(result.ok);
+    return result;
+}
+
+std::size_t count_ops(const Function& fn, bool (*match)(const Inst&)) {
+    std::size_t count = 0;
+    for (BlockId b : fn.block_order()) {
+        for (ValueId v : fn.block_insts(b)) {
+            count += match(fn.inst(v));
+        }
+    }
+    return count;
+}
+
+bool is_vector_op(const Inst& inst) {
+    return inst.type.is_vector() && inst.op != Opcode::OP_CONST;
+}
+
+// Element-wise loops over arrays of each element type, and a reduction.
+const char* const kVectorLoops[] = {
+    R"CODE(
+        main(): i32 {
+            a: i8[300];
+            b: i8[300];
+            for (i: i32 = 0; i < 300; i++) { a[i] = (i8)i; b[i] = (i8)(3 * i); }
+            for (i: i32 = 0; i < 300; i++) { a[i] = a[i] + b[i] ^ (i8)5; }
+            total: i32 = 0;
+            for (x : a) { total += (i32)x; }
+            return total;
+        }
+    )CODE",
+    R"CODE(
+        main(): i32 {
+            a: i32[1000];
+            b: i32[1000];
+            for (i: i32 = 0; i < 1000; i++) { a[i] = i; b[i] = 2 * i; }
+            for (i: i32 = 0; i < 1000; i++) { a[i] = a[i] * 3 + b[i]; }
+            s: i32 = 0;
+            for (i: i32 = 0; i < 1000; i++) { s += a[i]; }
+            return s % 256;
+        }
+    )CODE",
+    R"CODE(
+        main(): i32 {
+            a: i64[500];
+            for (i: i64 = 0; i < 500; i++) { a[i] = i * i - 7; }
+            x: i64 = 0;
+            for (v : a) { x = x ^ v; }
+            return (i32)(x % 1000);
+        }
+    )CODE",
+    R"CODE(
+        main(): i32 {
+            a: f32[400];
+            b: f32[400];
+            for (i: i32 = 0; i < 400; i++) { a[i] = (f32)i * 0.5; b[i] = 1.25; }
+            for (i: i32 = 0; i < 400; i++) { a[i] = a[i] * b[i] + 2.0; }
+            return (i32)a[399] + (i32)a[17];
+        }
+    )CODE",
+    R"CODE(
+        main(): i32 {
+            a: f64[257];
+            for (i: i32 = 0; i < 257; i++) { a[i] = (f64)i / 4.0; }
+            for (i: i32 = 0; i < 257; i++) { a[i] = a[i] - 1.0; }
+            return (i32)a[256] + (i32)a[3];
+        }
+    )CODE",
+};
+
+}  // namespace
+
+TEST_CASE("loops: range-based for iterates over a copy of each element") {
+    auto c = compile_clean(R"CODE(
+        struct Pair { a: i32; b: i32; }
+        main(): i32 {
+            xs: i32[5] = [1, 2, 3, 4, 5];
+            total: i32 = 0;
+            for (x : xs) { total += x; x = 100; }
+            ps: Pair[3];
+            for (i: i32 = 0; i < 3; i++) { ps[i].a = i; ps[i].b = 10 * i; }
+            for (p : ps) { total += p.a + p.b; }
+            return total + xs[0];
+        }
+    )CODE");
+    REQUIRE(run(*c->module).value == 49);
+    optimize(*c->module, 2);
+    REQUIRE(run(*c->module).value == 49);
+}
+
+TEST_CASE("loops: adce keeps loops it cannot prove to end, whatever they compute") {
+    // w becomes 0 on every iteration: the loop never ends, at any level.
+    const char* endless = R"CODE(
+        @noinline
+        wait(p: i32): i32 {
+            w: i32 = 0;
+            while (w < 5) { w++; w = p / 9; }
+            return 7;
+        }
+        main(): i32 { return wait(3); }
+    )CODE";
+    for (int level = 0; level <= 3; ++level) {
+        INFO(level);
+        auto c = compile(endless, level);
+        InterpreterOptions options;
+        options.max_instructions = 100'000;
+        Interpreter interpreter(*c->module, options);
+        ExecutionResult result = interpreter.run("main");
+        REQUIRE_FALSE(result.ok);
+        REQUIRE(result.error == "instruction limit exceeded");
+    }
+    // A counted loop whose result is dead still goes.
+    auto counted = compile(R"CODE(
+        @noinline
+        spin(n: i32): i32 { t: i32 = 0; for (i: i32 = 0; i < n; i++) { t += i; } return 7; }
+        main(): i32 { return spin(1000); }
+    )CODE", 2);
+    const Function* spin = counted->module->find_function("spin");
+    REQUIRE(count_ops(*spin, [](const Inst& i) { return i.op == Opcode::OP_COND_BR; }) == 0);
+    REQUIRE(run(*counted->module).value == 7);
+}
+
+TEST_CASE("loops: licm hoists invariant code and leaves guarded division in place") {
+    auto module = parse_module(
+        "func @f(i32 %n, i32 %x, i32 %d) -> i32 {\n"
+        "entry:\n"
+        "  br loop\n"
+        "loop:\n"
+        "  %i = phi i32 [i32 0, entry], [%next, body]\n"
+        "  %s = phi i32 [i32 0, entry], [%t, body]\n"
+        "  %c = icmp slt %i, %n\n"
+        "  condbr %c, body, done\n"
+        "body:\n"
+        "  %k = mul i32 %x, i32 7\n"
+        "  %q = sdiv i32 %x, %d\n"
+        "  %u = add i32 %k, %q\n"
+        "  %t = add i32 %s, %u\n"
+        "  %next = add i32 %i, i32 1\n"
+        "  br loop\n"
+        "done:\n"
+        "  ret %s\n"
+        "}\n",
+        nullptr);
+    REQUIRE(module != nullptr);
+    std::string out = run_passes(*module, {"licm"});
+    // The multiplication moves to the entry block; the division by an unknown
+    // value must not run when the loop does not.
+    REQUIRE(out.find("bb0:\n  %3 = mul i32 %1, i32 7\n  br bb1\n") != std::string::npos);
+    REQUIRE(out.find("bb2:\n  %7 = sdiv i32 %1, %2\n") != std::string::npos);
+}
+
+TEST_CASE("loops: indvars computes exit values and unrolling removes small loops") {
+    auto c = compile_clean(R"CODE(
+        main(): i32 {
+            i: i32 = 0;
+            sum: i32 = 0;
+            while (i < 10) { sum += i * i; i += 2; }
+            xs: i32[4] = [5, 6, 7, 8];
+            for (k: i32 = 0; k < 4; k++) { sum += xs[k] * k; }
+            return sum + i;
+        }
+    )CODE");
+    REQUIRE(run(*c->module).value == 174);
+    optimize(*c->module, 2);
+    const Function& main_fn = *c->module->find_function("main");
+    // Both loops had constant trip counts: everything folds to the result.
+    REQUIRE(main_fn.block_order().size() == 1);
+    REQUIRE(run(*c->module).value == 174);
+}
+
+TEST_CASE("loops: strength reduction turns scaled indices into additions") {
+    auto module = parse_module(
+        "func @f(ptr %p, i64 %n) -> void {\n"
+        "entry:\n"
+        "  br loop\n"
+        "loop:\n"
+        "  %i = phi i64 [i64 0, entry], [%next, body]\n"
+        "  %c = icmp slt %i, %n\n"
+        "  condbr %c, body, done\n"
+        "body:\n"
+        "  %off = mul i64 %i, i64 8\n"
+        "  %a = ptradd ptr %p, %off\n"
+        "  store %i, %a\n"
+        "  %next = add i64 %i, i64 1\n"
+        "  br loop\n"
+        "done:\n"
+        "  ret\n"
+        "}\n",
+        nullptr);
+    REQUIRE(module != nullptr);
+    std::string out = run_passes(*module, {"loop-reduce"});
+    // The offset starts at 0 * 8 and grows by 8 on every trip.
+    REQUIRE(out ==
+            "func @f(ptr %0, i64 %1) -> void {\n"
+            "bb0:\n"
+            "  %2 = mul i64 i64 0, i64 8\n"
+            "  br bb1\n"
+            "bb1:\n"
+            "  %3 = phi i64 [%2, bb0], [%8, bb2]\n"
+            "  %4 = phi i64 [i64 0, bb0], [%7, bb2]\n"
+            "  %5 = icmp slt %4, %1\n"
+            "  condbr %5, bb2, bb3\n"
+            "bb2:\n"
+            "  %6 = ptradd ptr %0, %3\n"
+            "  store %4, %6\n"
+            "  %7 = add i64 %4, i64 1\n"
+            "  %8 = add i64 %3, i64 8\n"
+            "  br bb1\n"
+            "bb3:\n"
+            "  ret\n"
+            "}\n");
+}
+
+TEST_CASE("loops: vectorized loops keep their results and execute fewer instructions") {
+    for (const char* code : kVectorLoops) {
+        auto scalar = compile_clean(code);
+        auto vector = compile_clean(code);
+        PassManager scalar_only;
+        scalar_only.add(create_simplify_cfg_pass());
+        scalar_only.add(create_sccp_pass());
+        scalar_only.add(create_gvn_pass());
+        scalar_only.add(create_adce_pass());
+        scalar_only.add(create_simplify_cfg_pass());
+        REQUIRE(scalar_only.run(*scalar->module));
+        optimize(*vector->module, 2);
+        REQUIRE(count_ops(*vector->module->find_function("main"), is_vector_op) > 0);
+        ExecutionResult before = run(*scalar->module);
+        ExecutionResult after = run(*vector->module);
+        REQUIRE(after.value == before.value);
+        REQUIRE(after.stats.instructions * 2 < before.stats.instructions);
+    }
+}
+
+TEST_CASE("loops: overlapping pointers fall back to the scalar loop") {
+    auto c = compile_clean(R"CODE(
+        @noinline
+        carry(dst: i32*, src: i32*, n: i64): void {
+            for (i: i64 = 0; i < n; i++) { dst[i + 1] = src[i] + 1; }
+        }
+        main(): i32 {
+            xs: i32[100];
+            ys: i32[101];
+            xs[0] = 7;
+            carry((i32*)xs, (i32*)xs, 99);
+            for (i: i32 = 0; i < 100; i++) { xs[i] = i; }
+            carry((i32*)ys, (i32*)xs, 100);
+            return xs[99] + ys[100];
+        }
+    )CODE");
+    // The first call is a loop-carried chain through one array: xs[99] = 7 + 99
+    // before xs is reset, then ys[100] = xs[99] + 1 with separate arrays.
+    REQUIRE(run(*c->module).value == 99 + 100);
+    optimize(*c->module, 2);
+    REQUIRE(count_ops(*c->module->find_function("carry"), is_vector_op) > 0);
+    REQUIRE(run(*c->module).value == 99 + 100);
+
+    auto chain = compile_clean(R"CODE(
+        @noinline
+        carry(dst: i32*, src: i32*, n: i64): void {
+            for (i: i64 = 0; i < n; i++) { dst[i + 1] = src[i] + 1; }
+        }
+        main(): i32 {
+            xs: i32[100];
+            xs[0] = 7;
+            carry((i32*)xs, (i32*)xs, 99);
+            return xs[99];
+        }
+    )CODE");
+    optimize(*chain->module, 2);
+    REQUIRE(run(*chain->module).value == 7 + 99);
+}
+
+TEST_CASE("loops: the interpreter executes vector instructions lane by lane") {
+    auto module = parse_module(
+        "func @main() -> i32 {\n"
+        "entry:\n"
+        "  %p = alloca 32, align 4\n"
+        "  %s = splat <8 x i32> i32 3\n"
+        "  %v = insert <8 x i32> %s, i32 10, i32 5\n"
+        "  %w = mul <8 x i32> %v, <8 x i32> 2\n"
+        "  store %w, %p\n"
+        "  %q = ptradd ptr %p, i64 20\n"
+        "  %x = load i32 %q\n"
+        "  %l = load <8 x i32> %p\n"
+        "  %c = icmp sgt %l, <8 x i32> 6\n"
+        "  %z = zext <8 x i32> %c\n"
+        "  %e = extract i32 %z, i32 5\n"
+        "  %f = extract i32 %w, i32 0\n"
+        "  %r = add i32 %x, %e\n"
+        "  %t = add i32 %r, %f\n"
+        "  ret %t\n"
+        "}\n",
+        nullptr);
+    REQUIRE(module != nullptr);
+    std::string error;
+    REQUIRE(verify_module(*module, &error));
+    ExecutionResult result = run(*module);
+    REQUIRE(result.value == 20 + 1 + 6);
+    REQUIRE(result.stats.loads == 2);
+    REQUIRE(result.stats.stores == 1);
+}
+
+TEST_CASE("loops: scalarize splits vector instructions into one per lane") {
+    auto module = parse_module(
+        "func @main(i32 %i) -> i32 {\n"
+        "entry:\n"
+        "  %p = alloca 32, align 4\n"
+        "  %s = splat <8 x i32> i32 3\n"
+        "  %v = insert <8 x i32> %s, i32 10, %i\n"
+        "  %w = mul <8 x i32> %v, <8 x i32> 2\n"
+        "  store %w, %p\n"
+        "  %l = load <8 x i32> %p\n"
+        "  %c = icmp sgt %l, <8 x i32> 6\n"
+        "  %z = zext <8 x i32> %c\n"
+        "  %e = extract i32 %z, %i\n"
+        "  %f = extract i32 %w, i32 0\n"
+        "  %r = add i32 %e, %f\n"
+        "  ret %r\n"
+        "}\n",
+        nullptr);
+    REQUIRE(module != nullptr);
+    Function& fn = *module->functions[0];
+    PassManager manager;
+    manager.add(create_scalarize_pass());
+    REQUIRE(manager.run(*module));
+    std::string error;
+    REQUIRE(verify_module(*module, &error));
+    for (BlockId b : fn.block_order()) {
+        for (ValueId v : fn.block_insts(b)) {
+            REQUIRE_FALSE(fn.inst(v).type.is_vector());
+        }
+    }
+    Interpreter interpreter(*module);
+    const std::uint64_t args[] = {5};
+    ExecutionResult result = interpreter.run("main", args);
+    INFO(result.error);
+    REQUIRE(result.ok);
+    REQUIRE(result.value == 1 + 6);
+}
@@ -0,0 +1,218 @@
+#include <catch2/catch_test_macros.hpp>
+#include <memory>
+#include <string>
+#include "middle/ir.h"
+#include "middle/passes.h"
+#include "middle/transforms.h"
+
+using namespace pallas::middle;
+
+static std::unique_ptr<Module> parse(const std::string& text) {
+    auto module = parse_module(text, nullptr);
+    REQUIRE(module != nullptr);
+    return module;
+}
+
+// Runs the given passes with verification after each and returns the printed IR.
+static std::string optimize(Module& module, std::initializer_list<const char*> passes) {
+    PassOptions options;
+    options.verify_each = true;
+    PassManager manager(options);
+    for (const char* name : passes) {
+        REQUIRE(add_pass_by_name(manager, name));
+    }
+    REQUIRE(manager.run(module));
+    return print_module(module);
+}
+
+TEST_CASE("transforms: sccp folds through phis and drops the untaken branch") {
+    auto module = parse(
+        "func @f(i32 %x) -> i32 {\n"
+        "entry:\n"
+        "  %a = add i32 i32 2, i32 3\n"
+        "  %c = icmp sgt %a, i32 4\n"
+        "  condbr %c, then, else\n"
+        "then:\n"
+        "  br join\n"
+        "else:\n"
+        "  %y = mul i32 %x, i32 7\n"
+        "  br join\n"
+        "join:\n"
+        "  %p = phi i32 [%a, then], [%y, else]\n"
+        "  %r = shl i32 %p, i32 1\n"
+        "  ret %r\n"
+        "}\n");
+    std::string out = optimize(*module, {"sccp"});
+    REQUIRE(out ==
+            "func @f(i32 %0) -> i32 {\n"
+            "bb0:\n"
+            "  br bb1\n"
+            "bb1:\n"
+            "  br bb2\n"
+            "bb2:\n"
+            "  ret i32 10\n"
+            "}\n");
+}
+
+TEST_CASE("transforms: sccp proves a loop-carried value constant") {
+    // %v stays 1 on every trip because the only update multiplies by 1.
+    auto module = parse(
+        "func @f(i32 %n) -> i32 {\n"
+        "entry:\n"
+        "  br loop\n"
+        "loop:\n"
+        "  %i = phi i32 [i32 0, entry], [%i.next, loop]\n"
+        "  %v = phi i32 [i32 1, entry], [%v.next, loop]\n"
+        "  %v.next = mul i32 %v, i32 1\n"
+        "  %i.next = add i32 %i, i32 1\n"
+        "  %c = icmp slt %i.next, %n\n"
+        "  condbr %c, loop, exit\n"
+        "exit:\n"
+        "  ret %v\n"
+        "}\n");
+    std::string out = optimize(*module, {"sccp"});
+    REQUIRE(out.find("ret i32 1") != std::string::npos);
+    REQUIRE(out.find("mul") == std::string::npos);
+}
+
+TEST_CASE("transforms: gvn removes redundant expressions and loads") {
+    auto module = parse(
+        "func @f(i32 %a, i32 %b, ptr %p) -> i32 {\n"
+        "entry:\n"
+        "  %x = add i32 %a, %b\n"
+        "  %y = add i32 %b, %a\n"
+        "  %z = mul i32 %x, %y\n"
+        "  store %z, %p\n"
+        "  %l1 = load i32 %p\n"
+        "  %l2 = load i32 %p\n"
+        "  %s = sub i32 %l1, %l2\n"
+        "  %t = add i32 %s, %z\n"
+        "  ret %t\n"
+        "}\n");
+    std::string out = optimize(*module, {"gvn"});
+    REQUIRE(out ==
+            "func @f(i32 %0, i32 %1, ptr %2) -> i32 {\n"
+            "bb0:\n"
+            "  %3 = add i32 %0, %1\n"
+            "  %4 = mul i32 %3, %3\n"
+            "  store %4, %2\n"
+            "  ret %4\n"
+            "}\n");
+}
+
+TEST_CASE("transforms: gvn does not reuse loads across a clobber or a merge") {
+    auto module = parse(
+        "declare @g(ptr) -> void\n"
+        "func @f(ptr %p, i1 %c) -> i32 {\n"
+        "entry:\n"
+        "  %a = load i32 %p\n"
+        "  call void @g(%p)\n"
+        "  %b = load i32 %p\n"
+        "  condbr %c, left, join\n"
+        "left:\n"
+        "  store i32 0, %p\n"
+        "  br join\n"
+        "join:\n"
+        "  %d = load i32 %p\n"
+        "  %s = add i32 %a, %b\n"
+        "  %t = add i32 %s, %d\n"
+        "  ret %t\n"
+        "}\n");
+    std::string out = optimize(*module, {"gvn"});
+    std::size_t loads = 0;
+    for (std::size_t at = out.find("load"); at != std::string::npos; at = out.find("load", at + 1)) {
+        ++loads;
+    }
+    REQUIRE(loads == 3);
+}
+
+TEST_CASE("transforms: adce removes dead code and branches nothing depends on") {
+    auto module = parse(
+        "func @f(i32 %x, ptr %p) -> void {\n"
+        "entry:\n"
+        "  %dead = mul i32 %x, %x\n"
+        "  %c = icmp slt %x, i32 0\n"
+        "  condbr %c, neg, join\n"
+        "neg:\n"
+        "  %u = sub i32 i32 0, %x\n"
+        "  br join\n"
+        "join:\n"
+        "  store %x, %p\n"
+        "  ret\n"
+        "}\n");
+    std::string out = optimize(*module, {"adce"});
+    REQUIRE(out ==
+            "func @f(i32 %0, ptr %1) -> void {\n"
+            "bb0:\n"
+            "  br bb1\n"
+            "bb1:\n"
+            "  store %0, %1\n"
+            "  ret\n"
+            "}\n");
+}
+
+TEST_CASE("transforms: simplifycfg merges chains and threads empty blocks") {
+    auto module = parse(
+        "func @f(i1 %c, i32 %x) -> i32 {\n"
+        "entry:\n"
+        "  condbr %c, hop, other\n"
+        "hop:\n"
+        "  br join\n"
+        "other:\n"
+        "  %y = add i32 %x, i32 1\n"
+        "  br tail\n"
+        "tail:\n"
+        "  br join\n"
+        "join:\n"
+        "  %p = phi i32 [%x, hop], [%y, tail]\n"
+        "  ret %p\n"
+        "}\n");
+    std::string out = optimize(*module, {"simplifycfg"});
+    REQUIRE(out ==
+            "func @f(i1 %0, i32 %1) -> i32 {\n"
+            "bb0:\n"
+            "  condbr %0, bb2, bb1\n"
+            "bb1:\n"
+            "  %2 = add i32 %1, i32 1\n"
+            "  br bb2\n"
+            "bb2:\n"
+            "  %3 = phi i32 [%2, bb1], [%1, bb0]\n"
+            "  ret %3\n"
+            "}\n");
+}
+
+TEST_CASE("transforms: the -O1 pipeline shrinks the IR") {
+    auto module = parse(
+        "func @f(i32 %n) -> i32 {\n"
+        "entry:\n"
+        "  %k = add i32 i32 1, i32 1\n"
+        "  %z = icmp eq %k, i32 3\n"
+        "  condbr %z, never, loop\n"
+        "never:\n"
+        "  br loop\n"
+        "loop:\n"
+        "  %i = phi i32 [i32 0, entry], [i32 0, never], [%i.next, body]\n"
+        "  %c = icmp slt %i, %n\n"
+        "  condbr %c, body, exit\n"
+        "body:\n"
+        "  %t1 = mul i32 %i, %k\n"
+        "  %t2 = mul i32 %i, %k\n"
+        "  %unused = add i32 %t1, %t2\n"
+        "  %i.next = add i32 %i, i32 1\n"
+        "  br loop\n"
+        "exit:\n"
+        "  ret %i\n"
+        "}\n");
+    Function& fn = *module->functions[0];
+    std::size_t before = fn.instruction_count();
+    PassOptions options;
+    options.verify_each = true;
+    PassManager manager(options);
+    build_pipeline(manager, 1);
+    REQUIRE(manager.size() > 0);
+    REQUIRE(manager.run(*module));
+    REQUIRE(fn.instruction_count() < before);
+    std::string out = print_module(*module);
+    REQUIRE(out.find("mul") == std::string::npos);
+    REQUIRE(fn.block_order().size() == 4);
+}
@@ -0,0 +1,50 @@
+#include <catch2/catch_test_macros.hpp>
+#include <cstdint>
+#include "runtime/arena.h"
+
+using namespace pallas::runtime;
+
+TEST_CASE("arena: allocations are zeroed, aligned and grow into new chunks") {
+    PallasArena arena;
+    pallas_arena_init(&arena, 64);
+    REQUIRE(arena.first != nullptr);
+    REQUIRE(arena.first->size == kArenaMinChunk);
+
+    auto* a = static_cast<std::uint8_t*>(pallas_arena_alloc(&arena, 3, 1));
+    auto* b = static_cast<std::uint8_t*>(pallas_arena_alloc(&arena, 16, 16));
+    REQUIRE(a[0] == 0);
+    REQUIRE(reinterpret_cast<std::uintptr_t>(b) % 16 == 0);
+    REQUIRE(b > a);
+    REQUIRE(reinterpret_cast<std::uintptr_t>(arena.cursor) % kArenaAlignment == 0);
+
+    // Does not fit in the first chunk: a larger one is linked after it.
+    void* big = pallas_arena_alloc(&arena, 1000, 8);
+    REQUIRE(big != nullptr);
+    REQUIRE(arena.current != arena.first);
+    REQUIRE(arena.first->next == arena.current);
+    REQUIRE(arena.current->size >= 1000);
+    pallas_arena_release(&arena);
+    REQUIRE(arena.first == nullptr);
+    REQUIRE(arena.cursor == nullptr);
+}
+
+TEST_CASE("arena: free_all keeps the chunks and reuses them") {
+    PallasArena arena;
+    pallas_arena_init(&arena, kArenaMinChunk);
+    void* first = pallas_arena_alloc(&arena, 8, 8);
+    pallas_arena_alloc(&arena, 512, 8);
+    PallasArenaChunk* spare = arena.current;
+    arena.finalizers = first;
+
+    pallas_arena_free_all(&arena);
+    REQUIRE(arena.current == arena.first);
+    REQUIRE(arena.finalizers == nullptr);
+    auto* again = static_cast<std::uint64_t*>(pallas_arena_alloc(&arena, 8, 8));
+    REQUIRE(again == first);
+    REQUIRE(*again == 0);
+    // The second chunk is picked up again instead of allocating a third.
+    pallas_arena_alloc(&arena, 512, 8);
+    REQUIRE(arena.current == spare);
+    REQUIRE(spare->next == nullptr);
+    pallas_arena_release(&arena);
+}
@@ -0,0 +1,226 @@
+#include <catch2/catch_test_macros.hpp>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+#include "runtime/buffer.h"
+#include "runtime/heap_profile.h"
+
+using namespace pallas::runtime;
+
+namespace {
+
+// Enough of a protocol buffer reader for the fields the profiler writes.
+class ProtoReader {
+  public:
+    explicit ProtoReader(std::string bytes) : bytes(std::move(bytes)) {}
+
+    bool next(int* number, std::uint64_t* value, std::string* field) {
+        if (at >= bytes.size()) {
+            return false;
+        }
+        std::uint64_t key = varint();
+        *number = static_cast<int>(key >> 3);
+        if ((key & 7) == 2) {
+            std::uint64_t size = varint();
+            *field = bytes.substr(at, size);
+            at += size;
+        } else {
+            *value = varint();
+        }
+        return true;
+    }
+
+    std::uint64_t varint() {
+        std::uint64_t value = 0;
+        for (int shift = 0; at < bytes.size(); shift += 7) {
+            auto byte = static_cast<std::uint8_t>(bytes[at++]);
+            value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) {
+                break;
+            }
+        }
+        return value;
+    }
+
+  private:
+    std::string bytes;
+    std::size_t at = 0;
+};
+
+struct SiteSample {
+    std::vector<std::uint64_t> values;  // alloc_objects, alloc_space, inuse_objects, inuse_space
+    std::map<std::string, std::string> strings;
+    std::map<std::string, std::uint64_t> numbers;
+};
+
+// Samples by the name of their function.
+std::map<std::string, SiteSample> decode(const std::string& profile) {
+    std::vector<std::string> strings;
+    std::vector<std::string> samples;
+    std::map<std::uint64_t, std::uint64_t> location_function;
+    std::map<std::uint64_t, std::uint64_t> function_name;
+    ProtoReader reader(profile);
+    int number = 0;
+    std::uint64_t value = 0;
+    std::string field;
+    while (reader.next(&number, &value, &field)) {
+        if (number == 2) {
+            samples.push_back(field);
+        } else if (number == 4 || number == 5) {
+            ProtoReader inner(field);
+            std::uint64_t id = 0;
+            int n = 0;
+            std::uint64_t v = 0;
+            std::string f;
+            while (inner.next(&n, &v, &f)) {
+                if (n == 1) {
+                    id = v;
+                } else if (number == 4 && n == 4) {
+                    ProtoReader line(f);
+                    line.next(&n, &v, &f);
+                    location_function[id] = v;
+                } else if (number == 5 && n == 2) {
+                    function_name[id] = v;
+                }
+            }
+        } else if (number == 6) {
+            strings.push_back(field);
+        }
+    }
+    std::map<std::string, SiteSample> out;
+    for (const std::string& bytes : samples) {
+        ProtoReader reader(bytes);
+        SiteSample sample;
+        std::uint64_t location = 0;
+        while (reader.next(&number, &value, &field)) {
+            ProtoReader inner(field);
+            if (number == 1) {
+                location = inner.varint();
+            } else if (number == 2) {
+                for (int i = 0; i < 4; ++i) {
+                    sample.values.push_back(inner.varint());
+                }
+            } else if (number == 3) {
+                std::uint64_t key = 0;
+                std::uint64_t text = 0;
+                std::uint64_t num = 0;
+                int n = 0;
+                std::uint64_t v = 0;
+                std::string f;
+                while (inner.next(&n, &v, &f)) {
+                    (n == 1 ? key : n == 2 ? text : n == 3 ? num : v) = v;
+                }
+                if (text != 0) {
+                    sample.strings[strings[key]] = strings[text];
+                } else {
+                    sample.numbers[strings[key]] = num;
+                }
+            }
+        }
+        out[strings[function_name[location_function[location]]]] = sample;
+    }
+    return out;
+}
+
+std::string descriptor(const std::vector<std::pair<std::string, HeapSiteKind>>& sites) {
+    std::string out(4, '\0');
+    out[0] = static_cast<char>(sites.size());
+    for (const auto& [name, kind] : sites) {
+        out += std::string("\x07\0\0\0", 4);
+        out.push_back(static_cast<char>(kind));
+        out += std::string(1, static_cast<char>(name.size())) + std::string(3, '\0') + name;
+    }
+    return out;
+}
+
+void start(const std::string& path, const std::string& sites, std::uint64_t rate) {
+    pallas_heap_profile_start(path.c_str(), reinterpret_cast<const std::uint8_t*>(sites.data()),
+                              sites.size(), rate);
+}
+
+}  // namespace
+
+TEST_CASE("heap profile: allocations, frees, buffers and arenas are attributed to sites") {
+    std::filesystem::path path = std::filesystem::temp_directory_path() / "pallas_heap_tests";
+    start(path.string(),
+          descriptor({{"nodes", HeapSiteKind::NEW},
+                      {"scratch", HeapSiteKind::ARENA},
+                      {"cells", HeapSiteKind::NEW}}),
+          0);
+    REQUIRE(heap_profile_active());
+    void* kept = pallas_heap_new(24, 0);
+    for (int i = 0; i < 3; ++i) {
+        pallas_heap_delete(pallas_heap_new(24, 0));
+    }
+    free_buffer(grow_buffer(allocate_buffer(nullptr, 16), 16, 100, nullptr));
+
+    PallasArena arena;
+    pallas_heap_arena_init(&arena, 300, 1);
+    pallas_arena_alloc(&arena, 200, 8);
+    pallas_arena_alloc(&arena, 400, 8);  // a second chunk
+    pallas_arena_free_all(&arena);
+    pallas_heap_arena_alloc(&arena, 40, 8, 2);
+    pallas_arena_release(&arena);
+    pallas_heap_profile_stop();
+    REQUIRE_FALSE(heap_profile_active());
+    pallas_heap_delete(kept);
+    REQUIRE(std::filesystem::exists(path));
+    std::filesystem::remove(path);
+
+    std::map<std::string, SiteSample> samples = decode(encode_heap_profile());
+    REQUIRE(samples.size() == 4);
+    const SiteSample& nodes = samples.at("nodes");
+    REQUIRE(nodes.values == std::vector<std::uint64_t>{4, 96, 1, 24});
+    REQUIRE(nodes.strings.at("kind") == "new");
+    REQUIRE(nodes.numbers.count("lifetime") == 1);
+
+    // Growing a buffer frees the old allocation and makes a new one.
+    const SiteSample& buffers = samples.at("string and Vec buffers");
+    REQUIRE(buffers.values[0] == 2);
+    REQUIRE(buffers.values[2] == 0);
+    REQUIRE(buffers.strings.at("kind") == "buffer");
+
+    const SiteSample& scratch = samples.at("scratch");
+    REQUIRE(scratch.values[0] == 2);
+    REQUIRE(scratch.values[2] == 0);
+    REQUIRE(scratch.strings.at("kind") == "arena");
+    REQUIRE(scratch.numbers.at("high_water") == scratch.values[1]);
+    // Both allocations before free_all, with the first chunk's unused tail.
+    REQUIRE(scratch.numbers.at("peak_used") >= 600);
+    REQUIRE(scratch.numbers.at("peak_used") < scratch.values[1]);
+
+    // Arena memory is the arena's: a `new` in one is allocated, never in use.
+    const SiteSample& cells = samples.at("cells");
+    REQUIRE(cells.values == std::vector<std::uint64_t>{1, 40, 0, 0});
+    REQUIRE(cells.strings.at("kind") == "new");
+}
+
+TEST_CASE("heap profile: sampled allocations are scaled up to an estimate of all of them") {
+    std::filesystem::path path =
+        std::filesystem::temp_directory_path() / "pallas_heap_sampling_tests";
+    start(path.string(), descriptor({{"small", HeapSiteKind::NEW}}), 4096);
+    std::vector<void*> live;
+    for (int i = 0; i < 20000; ++i) {
+        void* p = pallas_heap_new(64, 0);
+        if (i % 2 == 0) {
+            live.push_back(p);
+        } else {
+            pallas_heap_delete(p);
+        }
+    }
+    pallas_heap_profile_stop();
+    for (void* p : live) {
+        pallas_heap_delete(p);
+    }
+    std::filesystem::remove(path);
+
+    std::map<std::string, SiteSample> samples = decode(encode_heap_profile());
+    const SiteSample& small = samples.at("small");
+    // About 300 samples: the estimates are well within 30% of the truth.
+    REQUIRE(small.values[1] > 20000 * 64 * 7 / 10);
+    REQUIRE(small.values[1] < 20000 * 64 * 13 / 10);
+    REQUIRE(small.values[3] > 10000 * 64 * 6 / 10);
+    REQUIRE(small.values[3] < 10000 * 64 * 14 / 10);
+}
@@ -0,0 +1,113 @@
+#include <catch2/catch_test_macros.hpp>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include "runtime/arena.h"
+#include "runtime/buffer.h"
+#include "runtime/str.h"
+
+using namespace pallas::runtime;
+
+namespace {
+
+std::string text_of(const PallasString& s) {
+    REQUIRE(string_text(&s)[string_length(&s)] == '\0');
+    return std::string(string_text(&s), string_length(&s));
+}
+
+void assign(PallasString* s, const std::string& text, PallasArena* arena = nullptr) {
+    pallas_string_assign(s, text.data(), text.size(), arena);
+}
+
+}  // namespace
+
+TEST_CASE("str: short texts are stored inline and zeroed memory is empty") {
+    PallasString s{};
+    REQUIRE(string_is_inline(&s));
+    REQUIRE(text_of(s).empty());
+
+    std::string fits(kStringInlineCapacity, 'x');
+    assign(&s, fits);
+    REQUIRE(string_is_inline(&s));
+    REQUIRE(text_of(s) == fits);
+
+    assign(&s, fits + "y");
+    REQUIRE_FALSE(string_is_inline(&s));
+    REQUIRE(text_of(s) == fits + "y");
+    REQUIRE(buffer_header(s.data)->source == kBufferHeap);
+    // A shorter text reuses the buffer.
+    char* data = s.data;
+    assign(&s, "ab");
+    REQUIRE(s.data == data);
+    REQUIRE(text_of(s) == "ab");
+    pallas_string_free(&s);
+    REQUIRE(string_is_inline(&s));
+    REQUIRE(text_of(s).empty());
+}
+
+TEST_CASE("str: append grows geometrically and may append the string to itself") {
+    PallasString s{};
+    std::string expected;
+    std::uint64_t reallocations = 0;
+    const char* previous = string_text(&s);
+    for (int i = 0; i < 500; ++i) {
+        std::string piece = std::to_string(i) + ",";
+        pallas_string_append(&s, piece.data(), piece.size(), nullptr);
+        expected += piece;
+        reallocations += string_text(&s) != previous;
+        previous = string_text(&s);
+    }
+    REQUIRE(text_of(s) == expected);
+    REQUIRE(reallocations < 10);
+
+    PallasString small{};
+    assign(&small, "abc");
+    for (int i = 0; i < 4; ++i) {
+        pallas_string_append(&small, string_text(&small), string_length(&small), nullptr);
+    }
+    std::string doubled;
+    for (int i = 0; i < 16; ++i) {
+        doubled += "abc";
+    }
+    REQUIRE(text_of(small) == doubled);
+    pallas_string_free(&small);
+    pallas_string_free(&s);
+}
+
+TEST_CASE("str: slices copy the range and stay inline when short") {
+    PallasString s{};
+    assign(&s, "the quick brown fox jumps over the lazy dog");
+    PallasString slice{};
+    pallas_string_slice(&slice, &s, 4, 9, nullptr);
+    REQUIRE(string_is_inline(&slice));
+    REQUIRE(text_of(slice) == "quick");
+    pallas_string_slice(&slice, &s, 10, 43, nullptr);
+    REQUIRE(text_of(slice) == "brown fox jumps over the lazy dog");
+    // Slicing a string into itself.
+    pallas_string_slice(&s, &s, 16, 19, nullptr);
+    REQUIRE(text_of(s) == "fox");
+    pallas_string_slice(&slice, &s, 3, 3, nullptr);
+    REQUIRE(text_of(slice).empty());
+    pallas_string_free(&slice);
+    pallas_string_free(&s);
+}
+
+TEST_CASE("str: prepared text is committed in place, from an arena inside one") {
+    PallasArena arena;
+    pallas_arena_init(&arena, kArenaDefaultCapacity);
+    PallasString s{};
+    char* out = pallas_string_prepare(&s, 100, &arena);
+    REQUIRE(buffer_header(s.data)->source == reinterpret_cast<std::uintptr_t>(&arena));
+    std::memcpy(out, "prepared", 8);
+    pallas_string_commit(&s, out + 8);
+    REQUIRE(text_of(s) == "prepared");
+
+    PallasString short_text{};
+    out = pallas_string_prepare(&short_text, 5, &arena);
+    std::memcpy(out, "tiny", 4);
+    pallas_string_commit(&short_text, out + 4);
+    REQUIRE(string_is_inline(&short_text));
+    REQUIRE(text_of(short_text) == "tiny");
+    pallas_string_free(&s);  // arena buffers are left to the arena
+    pallas_arena_release(&arena);
+}
@@ -0,0 +1,108 @@
+#include <catch2/catch_test_macros.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "runtime/arena.h"
+#include "runtime/vec.h"
+
+using namespace pallas::runtime;
+
+namespace {
+
+void push(PallasVec* vec, std::uint64_t value, PallasArena* arena) {
+    if (vec->length == vec->capacity) {
+        pallas_vec_grow(vec, sizeof(value), arena);
+    }
+    std::memcpy(vec->data + vec->length++ * sizeof(value), &value, sizeof(value));
+}
+
+std::uint64_t at(const PallasVec& vec, std::uint64_t i) {
+    std::uint64_t value = 0;
+    std::memcpy(&value, vec.data + i * sizeof(value), sizeof(value));
+    return value;
+}
+
+}  // namespace
+
+TEST_CASE("vec: growth doubles small buffers and slows down for large ones") {
+    REQUIRE(vec_grown_capacity(0, 8, false) == kVecMinBytes / 8);
+    REQUIRE(vec_grown_capacity(0, 100, false) == kVecMinCapacity);
+    REQUIRE(vec_grown_capacity(64, 8, false) == 128);
+    std::uint64_t large = kVecDoublingLimit / 8;
+    REQUIRE(vec_grown_capacity(large, 8, false) == large + large / 2);
+    REQUIRE(vec_grown_capacity(large, 8, true) == large * 2);
+
+    PallasVec vec{};
+    for (std::uint64_t i = 0; i < 10000; ++i) {
+        push(&vec, i * 3, nullptr);
+    }
+    REQUIRE(vec.length == 10000);
+    REQUIRE(vec.capacity >= 10000);
+    REQUIRE(buffer_header(vec.data)->source == kBufferHeap);
+    for (std::uint64_t i = 0; i < 10000; i += 997) {
+        REQUIRE(at(vec, i) == i * 3);
+    }
+    pallas_vec_free(&vec);
+    REQUIRE(vec.data == nullptr);
+    REQUIRE(vec.length == 0);
+}
+
+TEST_CASE("vec: reserve allocates exactly and never shrinks") {
+    PallasVec vec{};
+    pallas_vec_reserve(&vec, 8, 1000, nullptr);
+    REQUIRE(vec.capacity == 1000);
+    std::byte* data = vec.data;
+    for (std::uint64_t i = 0; i < 1000; ++i) {
+        push(&vec, i, nullptr);
+    }
+    REQUIRE(vec.data == data);
+    pallas_vec_reserve(&vec, 8, 10, nullptr);
+    REQUIRE(vec.capacity == 1000);
+    pallas_vec_free(&vec);
+}
+
+TEST_CASE("vec: inline storage is used until it is outgrown") {
+    alignas(16) std::byte storage[kVecInlineHeader + 4 * 8];
+    PallasVec vec{};
+    pallas_vec_init_inline(&vec, storage, 4, 8);
+    REQUIRE(vec.capacity == 4);
+    REQUIRE(vec.data == storage + kVecInlineHeader);
+    for (std::uint64_t i = 0; i < 4; ++i) {
+        push(&vec, i + 1, nullptr);
+    }
+    REQUIRE(vec.data == storage + kVecInlineHeader);
+    push(&vec, 5, nullptr);
+    REQUIRE(vec.data != storage + kVecInlineHeader);
+    REQUIRE(buffer_header(vec.data)->source == kBufferHeap);
+    for (std::uint64_t i = 0; i < 5; ++i) {
+        REQUIRE(at(vec, i) == i + 1);
+    }
+    pallas_vec_free(&vec);
+
+    // Freeing a Vec that never left its storage frees nothing.
+    pallas_vec_init_inline(&vec, storage, 4, 8);
+    push(&vec, 1, nullptr);
+    pallas_vec_free(&vec);
+    REQUIRE(vec.data == nullptr);
+}
+
+TEST_CASE("vec: arena buffers grow in their arena and are not freed") {
+    PallasArena arena;
+    pallas_arena_init(&arena, kArenaDefaultCapacity);
+    PallasVec vec{};
+    for (std::uint64_t i = 0; i < 3000; ++i) {
+        push(&vec, i, &arena);
+    }
+    REQUIRE(buffer_header(vec.data)->source == reinterpret_cast<std::uintptr_t>(&arena));
+    REQUIRE(at(vec, 2999) == 2999);
+    // A Vec that already has a buffer grows where it came from.
+    PallasVec heap{};
+    push(&heap, 1, nullptr);
+    for (std::uint64_t i = 0; i < 100; ++i) {
+        push(&heap, i, &arena);
+    }
+    REQUIRE(buffer_header(heap.data)->source == kBufferHeap);
+    pallas_vec_free(&heap);
+    pallas_vec_free(&vec);
+    pallas_arena_release(&arena);
+}
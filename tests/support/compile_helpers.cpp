@@ -0,0 +1,62 @@
+#include "compile_helpers.h"
+#include <catch2/catch_test_macros.hpp>
+#include "frontend/const_eval.h"
+#include "frontend/parser.h"
+#include "frontend/scanner.h"
+#include "middle/interpreter.h"
+#include "middle/layout.h"
+#include "middle/passes.h"
+#include "runtime/format.h"
+
+namespace pallas::test {
+
+std::unique_ptr<Compiled> compile(const std::string& code, middle::LowerOptions options) {
+    auto out = std::make_unique<Compiled>();
+    frontend::Scanner scanner(code, &out->diagnostics);
+    frontend::Parser parser(scanner.get_tokens(), &out->diagnostics);
+    out->ast = parser.parse_module();
+    frontend::ConstEvaluator consts(*out->ast, &out->diagnostics);
+    consts.resolve_array_sizes(*out->ast);
+    middle::LayoutEngine layout(*out->ast, &out->diagnostics);
+    out->module = middle::lower_module(*out->ast, consts, layout, &out->diagnostics,
+                                       std::move(options));
+    return out;
+}
+
+std::unique_ptr<Compiled> compile_clean(const std::string& code, middle::LowerOptions options) {
+    auto out = compile(code, std::move(options));
+    REQUIRE(out->diagnostics.all().empty());
+    return out;
+}
+
+std::unique_ptr<Compiled> compile(const std::string& code, int level) {
+    auto out = compile_clean(code);
+    optimize(*out->module, level);
+    return out;
+}
+
+void optimize(middle::Module& module, int level) {
+    middle::PassOptions options;
+    options.verify_each = true;
+    middle::PassManager manager(options);
+    middle::build_pipeline(manager, level);
+    REQUIRE(manager.run(module));
+}
+
+std::string output_of(middle::Module& module, int level, bool* ok) {
+    optimize(module, level);
+    std::string printed;
+    runtime::set_output_capture(&printed);
+    middle::Interpreter interpreter(module);
+    middle::ExecutionResult result = interpreter.run("main");
+    runtime::set_output_capture(nullptr);
+    if (ok != nullptr) {
+        *ok = result.ok;
+        return result.ok ? printed : result.error;
+    }
+    INFO(result.error);
+    REQUIRE(result.ok);
+    return printed;
+}
+
+}  // namespace pallas::test
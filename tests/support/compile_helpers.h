@@ -0,0 +1,37 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include "frontend/ast.h"
+#include "frontend/diagnostics.h"
+#include "middle/ir.h"
+#include "middle/lower.h"
+
+// Shared by the tests that compile Pallas source in process: the front end and
+// lowering, the -O pipelines and running main in the interpreter.
+
+namespace pallas::test {
+
+// A lowered program, with the syntax tree and diagnostics it came from.
+struct Compiled {
+    std::unique_ptr<frontend::ModuleAST> ast;
+    std::unique_ptr<middle::Module> module;
+    frontend::Diagnostics diagnostics;
+};
+
+// Scans, parses and lowers `code`. Diagnostics are left for the test to check.
+std::unique_ptr<Compiled> compile(const std::string& code, middle::LowerOptions options = {});
+// compile() for code that must lower without diagnostics.
+std::unique_ptr<Compiled> compile_clean(const std::string& code,
+                                        middle::LowerOptions options = {});
+// compile_clean(), then the -O`level` pipeline.
+std::unique_ptr<Compiled> compile(const std::string& code, int level);
+
+// Runs the -O`level` pipeline with the verifier after every pass.
+void optimize(middle::Module& module, int level);
+
+// Optimizes at -O`level`, runs main and returns what it printed. The run must
+// succeed unless `ok` is given; then a failed run returns its error.
+std::string output_of(middle::Module& module, int level, bool* ok = nullptr);
+
+}  // namespace pallas::test
@@ -0,0 +1,205 @@
+#include <catch2/catch_test_macros.hpp>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <csignal>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <thread>
+#include "support/server.h"
+
+using namespace pallas;
+
+namespace {
+
+std::string socket_path() {
+    return (std::filesystem::temp_directory_path() /
+            ("pallas_server_tests_" + std::to_string(getpid()) + ".sock"))
+        .string();
+}
+
+// Sends `request` with a pipe as its stdout and returns what the server wrote,
+// or nullopt when no server is listening.
+std::optional<std::string> send(const std::string& path, support::ServerRequest request,
+                                int* status) {
+    int out[2];
+    REQUIRE(pipe(out) == 0);
+    request.fds[1] = out[1];
+    std::string error;
+    std::optional<int> result = support::send_request(path, request, &error);
+    close(out[1]);
+    if (!result.has_value()) {
+        close(out[0]);
+        return std::nullopt;
+    }
+    *status = *result;
+    std::string text;
+    char buffer[256];
+    for (ssize_t n; (n = read(out[0], buffer, sizeof(buffer))) > 0;) {
+        text.append(buffer, static_cast<std::size_t>(n));
+    }
+    close(out[0]);
+    return text;
+}
+
+}  // namespace
+
+TEST_CASE("server: requests run in the client's directory with its output") {
+    std::string path = socket_path();
+    std::filesystem::path directory = std::filesystem::temp_directory_path();
+    std::filesystem::path before = std::filesystem::current_path();
+    int handled = 0;
+    bool served = false;
+    std::thread server([&] {
+        std::string error;
+        served = support::serve(path, [&](const support::ServerRequest& request) {
+            handled++;
+            std::cout << std::filesystem::current_path().string() << ':';
+            for (const std::string& arg : request.args) {
+                std::cout << ' ' << arg;
+            }
+            std::cout << '\n';
+            return static_cast<int>(request.args.size());
+        }, &error);
+    });
+
+    support::ServerRequest request;
+    request.directory = directory.string();
+    request.args = {"-O2", "--run", "a file.pal"};
+    int status = 0;
+    std::optional<std::string> printed;
+    // The server may not be listening yet.
+    for (int attempt = 0; attempt < 500 && !printed; ++attempt) {
+        printed = send(path, request, &status);
+        if (!printed) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+    std::string expected = std::filesystem::canonical(directory).string() + ":";
+    REQUIRE(printed == expected + " -O2 --run a file.pal\n");
+    REQUIRE(status == 3);
+
+    request.args.clear();
+    REQUIRE(send(path, request, &status) == expected + "\n");
+    REQUIRE(status == 0);
+
+    support::ServerRequest stop;
+    stop.stop = true;
+    REQUIRE(send(path, stop, &status) == "");
+    server.join();
+    REQUIRE(served);
+    REQUIRE(handled == 2);
+    REQUIRE(std::filesystem::current_path() == before);
+    REQUIRE_FALSE(std::filesystem::exists(path));
+
+    std::string error;
+    REQUIRE_FALSE(support::send_request(path, request, &error).has_value());
+    REQUIRE_FALSE(error.empty());
+}
+
+TEST_CASE("server: a detached request that crashes or hangs does not stop the server") {
+    std::string path = socket_path();
+    int started[2];
+    int gate[2];
+    REQUIRE(pipe(started) == 0);
+    REQUIRE(pipe(gate) == 0);
+    std::thread server([&] {
+        std::string error;
+        support::serve(path, [&](const support::ServerRequest& request) {
+            if (request.args.empty()) {
+                return 7;
+            }
+            return support::detach(request, [&]() -> int {
+                if (request.args[0] == "crash") {
+                    kill(getpid(), SIGKILL);
+                }
+                // "wait": runs until the test opens the gate.
+                char byte = 0;
+                write(started[1], &byte, 1);
+                return read(gate[0], &byte, 1) == 1 ? 3 : 4;
+            });
+        }, &error);
+    });
+
+    support::ServerRequest request;
+    request.directory = std::filesystem::temp_directory_path().string();
+    request.args = {"crash"};
+    int status = 0;
+    std::optional<std::string> printed;
+    for (int attempt = 0; attempt < 500 && !printed; ++attempt) {
+        printed = send(path, request, &status);
+        if (!printed) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+    REQUIRE(printed.has_value());
+    REQUIRE(status == 128 + SIGKILL);
+
+    // A request that does not finish yet, and one served meanwhile.
+    int waited_status = 0;
+    std::thread waiting([&] {
+        support::ServerRequest wait = request;
+        wait.args = {"wait"};
+        send(path, wait, &waited_status);
+    });
+    char byte = 0;
+    REQUIRE(read(started[0], &byte, 1) == 1);
+    request.args.clear();
+    REQUIRE(send(path, request, &status) == "");
+    REQUIRE(status == 7);
+    REQUIRE(write(gate[1], &byte, 1) == 1);
+    waiting.join();
+    REQUIRE(waited_status == 3);
+    for (int fd : {started[0], started[1], gate[0], gate[1]}) {
+        close(fd);
+    }
+
+    support::ServerRequest stop;
+    stop.stop = true;
+    REQUIRE(send(path, stop, &status) == "");
+    server.join();
+}
+
+TEST_CASE("server: the socket is private to the user") {
+    std::filesystem::path directory =
+        std::filesystem::temp_directory_path() /
+        ("pallas_server_private_" + std::to_string(getpid()));
+    std::filesystem::remove_all(directory);
+    std::string path = (directory / "server.sock").string();
+    mode_t mask = umask(0002);
+    std::thread server([&] {
+        std::string error;
+        support::serve(path, [](const support::ServerRequest&) { return 0; }, &error);
+    });
+    support::ServerRequest request;
+    request.directory = std::filesystem::temp_directory_path().string();
+    int status = 0;
+    std::optional<std::string> printed;
+    for (int attempt = 0; attempt < 500 && !printed; ++attempt) {
+        printed = send(path, request, &status);
+        if (!printed) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+    umask(mask);
+    REQUIRE(printed.has_value());
+    struct stat info{};
+    REQUIRE(stat(directory.c_str(), &info) == 0);
+    REQUIRE((info.st_mode & 0777) == 0700);
+    REQUIRE(stat(path.c_str(), &info) == 0);
+    REQUIRE((info.st_mode & 0077) == 0);
+    support::ServerRequest stop;
+    stop.stop = true;
+    REQUIRE(send(path, stop, &status) == "");
+    server.join();
+
+    // A directory others can write to is refused.
+    std::filesystem::permissions(directory, std::filesystem::perms::group_write,
+                                 std::filesystem::perm_options::add);
+    std::string error;
+    REQUIRE_FALSE(support::serve(path, [](const support::ServerRequest&) { return 0; }, &error));
+    REQUIRE(error.find("not private") != std::string::npos);
+    std::filesystem::remove_all(directory);
+}
@@ -0,0 +1,131 @@
+#include <catch2/catch_test_macros.hpp>
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string>
+#include "frontend/const_eval.h"
+#include "frontend/diagnostics.h"
+#include "frontend/parser.h"
+#include "frontend/scanner.h"
+#include "middle/layout.h"
+#include "middle/lower.h"
+#include "middle/passes.h"
+#include "support/trace.h"
+
+using namespace pallas;
+
+namespace {
+
+const std::string kProgram = R"CODE(
+    square(x: i32): i32 { return x * x; }
+    cube(x: i32): i32 { return x * square(x); }
+    main(): i32 {
+        t: i32 = 0;
+        for (i: i32 = 0; i < 10; i++) {
+            t += cube(i);
+        }
+        return t;
+    }
+)CODE";
+
+std::size_t compile(const std::string& code, unsigned threads) {
+    frontend::Diagnostics diagnostics;
+    frontend::Scanner scanner(code, &diagnostics);
+    std::vector<frontend::Token> tokens = scanner.get_tokens();
+    frontend::Parser parser(tokens, &diagnostics);
+    auto ast = parser.parse_module();
+    frontend::ConstEvaluator consts(*ast, &diagnostics);
+    consts.evaluate_all();
+    consts.resolve_array_sizes(*ast);
+    middle::LayoutEngine layout(*ast, &diagnostics);
+    layout.compute_all();
+    auto module = middle::lower_module(*ast, consts, layout, &diagnostics);
+    REQUIRE(diagnostics.all().empty());
+    middle::PassOptions options;
+    options.threads = threads;
+    middle::PassManager manager(options);
+    middle::build_pipeline(manager, 2);
+    REQUIRE(manager.run(*module));
+    return tokens.size();
+}
+
+const support::TraceEvent* find(const std::vector<support::TraceEvent>& events,
+                                const std::string& name, const std::string& detail = "") {
+    auto it = std::find_if(events.begin(), events.end(), [&](const support::TraceEvent& e) {
+        return e.name == name && (detail.empty() || e.detail == detail);
+    });
+    return it == events.end() ? nullptr : &*it;
+}
+
+}  // namespace
+
+TEST_CASE("trace: nothing is recorded unless tracing was started") {
+    support::start_tracing();
+    support::stop_tracing();
+    compile(kProgram, 1);
+    {
+        support::TraceScope scope("outside");
+        REQUIRE_FALSE(scope.active());
+    }
+    REQUIRE(support::trace_events().empty());
+}
+
+TEST_CASE("trace: every phase is recorded with its work, per function for passes") {
+    support::start_tracing();
+    std::size_t tokens = compile(kProgram, 2);
+    support::stop_tracing();
+    std::vector<support::TraceEvent> events = support::trace_events();
+
+    const support::TraceEvent* scan = find(events, "scan");
+    REQUIRE(scan != nullptr);
+    REQUIRE(scan->items == tokens);
+    for (const char* phase : {"parse", "const-eval", "layout", "lower", "optimize"}) {
+        INFO(phase);
+        REQUIRE(find(events, phase) != nullptr);
+    }
+    for (const char* function : {"square", "cube", "main"}) {
+        INFO(function);
+        REQUIRE(find(events, "lower-function", function) != nullptr);
+        const support::TraceEvent* gvn = find(events, "gvn", function);
+        REQUIRE(gvn != nullptr);
+        REQUIRE(gvn->items > 0);
+    }
+
+    // Passes nest inside optimize: in its time span, and in its peak growth.
+    const support::TraceEvent* optimize = find(events, "optimize");
+    const support::TraceEvent* gvn = find(events, "gvn", "main");
+    REQUIRE(gvn->start_ns >= optimize->start_ns);
+    REQUIRE(gvn->start_ns + gvn->duration_ns <= optimize->start_ns + optimize->duration_ns);
+    REQUIRE(optimize->peak_growth_bytes >= gvn->peak_growth_bytes);
+    REQUIRE(optimize->resident_bytes > 0);
+
+    std::string json = support::trace_json();
+    REQUIRE(json.rfind("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", 0) == 0);
+    REQUIRE(json.find("\"name\":\"gvn\",\"cat\":\"pallas\",\"ph\":\"X\"") != std::string::npos);
+    REQUIRE(json.find("\"detail\":\"cube\"") != std::string::npos);
+    std::string summary = support::trace_summary();
+    REQUIRE(summary.find("Compiler phase report") != std::string::npos);
+    REQUIRE(summary.find(" scan\n") < summary.find(" parse\n"));
+}
+
+TEST_CASE("trace: peak growth counts memory a phase held only until it ended") {
+    constexpr std::size_t kMiB = 1 << 20;
+    support::start_tracing();
+    {
+        support::TraceScope scope("large");
+        auto block = std::make_unique<char[]>(64 * kMiB);
+        std::memset(block.get(), 1, 64 * kMiB);
+    }
+    {
+        // Back below the peak: touching memory again does not raise it.
+        support::TraceScope scope("smaller");
+        auto block = std::make_unique<char[]>(16 * kMiB);
+        std::memset(block.get(), 1, 16 * kMiB);
+    }
+    support::stop_tracing();
+    std::vector<support::TraceEvent> events = support::trace_events();
+    const support::TraceEvent* large = find(events, "large");
+    const support::TraceEvent* smaller = find(events, "smaller");
+    REQUIRE(large->peak_growth_bytes >= 48 * kMiB);
+    REQUIRE(smaller->peak_growth_bytes < 8 * kMiB);
+}